@@ -21,6 +21,7 @@
 
 #include <cairo.h>
 #include <gegl.h>
+#include <gegl-buffer-backend.h>
 #include <gdk-pixbuf/gdk-pixbuf.h>
 
 #include "libgimpbase/gimpbase.h"
@@ -29,10 +30,63 @@
 
 #include "core-types.h"
 
+#include "gegl/gimptilehandlervalidate.h"
+
 #include "gimp-memsize.h"
 #include "gimpparamspecs.h"
 
 
+/*  While a shared-tiles scope is open on the current thread, each
+ *  cached tile is counted only once, no matter how many buffers share
+ *  it copy-on-write (duplicated images, undo steps, ...).  Tiles that
+ *  aren't cached are counted in full, as before.
+ */
+typedef struct
+{
+  GHashTable *tiles;
+  gint        count;
+} SharedTiles;
+
+
+static void     gimp_memsize_shared_tiles_free     (SharedTiles *shared);
+
+static gint64   gimp_gegl_buffer_get_tiles_memsize (GeglBuffer  *buffer,
+                                                    GHashTable  *tiles);
+
+
+static GPrivate shared_tiles = G_PRIVATE_INIT ((GDestroyNotify)
+                                               gimp_memsize_shared_tiles_free);
+
+
+/*  public functions  */
+
+void
+gimp_memsize_shared_tiles_begin (void)
+{
+  SharedTiles *shared = g_private_get (&shared_tiles);
+
+  if (! shared)
+    {
+      shared = g_slice_new0 (SharedTiles);
+
+      g_private_set (&shared_tiles, shared);
+    }
+
+  if (shared->count++ == 0)
+    shared->tiles = g_hash_table_new (NULL, NULL);
+}
+
+void
+gimp_memsize_shared_tiles_end (void)
+{
+  SharedTiles *shared = g_private_get (&shared_tiles);
+
+  g_return_if_fail (shared != NULL && shared->count > 0);
+
+  if (--shared->count == 0)
+    g_clear_pointer (&shared->tiles, g_hash_table_unref);
+}
+
 gint64
 gimp_g_type_instance_get_memsize (GTypeInstance *instance)
 {
@@ -309,7 +363,14 @@ gimp_gegl_buffer_get_memsize (GeglBuffer *buffer)
 {
   if (buffer)
     {
-      const Babl *format = gegl_buffer_get_format (buffer);
+      const Babl  *format = gegl_buffer_get_format (buffer);
+      SharedTiles *shared = g_private_get (&shared_tiles);
+
+      if (shared && shared->tiles)
+        {
+          return (gimp_gegl_buffer_get_tiles_memsize (buffer, shared->tiles) +
+                  gimp_g_object_get_memsize (G_OBJECT (buffer)));
+        }
 
       return ((gint64) babl_format_get_bytes_per_pixel (format) *
               (gint64) gegl_buffer_get_width (buffer) *
@@ -357,3 +418,97 @@ gimp_parasite_get_memsize (GimpParasite *parasite,
 
   return 0;
 }
+
+
+/*  private functions  */
+
+static void
+gimp_memsize_shared_tiles_free (SharedTiles *shared)
+{
+  g_clear_pointer (&shared->tiles, g_hash_table_unref);
+
+  g_slice_free (SharedTiles, shared);
+}
+
+static gint64
+gimp_gegl_buffer_get_tiles_memsize (GeglBuffer *buffer,
+                                    GHashTable *tiles)
+{
+  GeglTileSource      *source = GEGL_TILE_SOURCE (buffer);
+  const GeglRectangle *extent = gegl_buffer_get_extent (buffer);
+  gint                 bpp;
+  gint                 shift_x;
+  gint                 shift_y;
+  gint                 tile_width;
+  gint                 tile_height;
+  gint                 x1, y1;
+  gint                 x2, y2;
+  gint                 x, y;
+  gint64               memsize = 0;
+
+  if (gegl_rectangle_is_empty (extent))
+    return 0;
+
+  bpp = babl_format_get_bytes_per_pixel (gegl_buffer_get_format (buffer));
+
+  /*  GEGL_TILE_GET goes through the whole handler chain, and a validate
+   *  handler would render invalid tiles to answer it, with the buffer
+   *  locked.  Don't look at the tiles of such buffers, like the
+   *  projection's, and count them in full
+   */
+  if (gimp_tile_handler_validate_get_assigned (buffer))
+    return (gint64) extent->width * extent->height * bpp;
+
+  g_object_get (buffer,
+                "shift-x",     &shift_x,
+                "shift-y",     &shift_y,
+                "tile-width",  &tile_width,
+                "tile-height", &tile_height,
+                NULL);
+
+  x1 = floor ((gdouble) (extent->x + shift_x) / tile_width);
+  y1 = floor ((gdouble) (extent->y + shift_y) / tile_height);
+  x2 = floor ((gdouble) (extent->x + extent->width  - 1 + shift_x) /
+              tile_width);
+  y2 = floor ((gdouble) (extent->y + extent->height - 1 + shift_y) /
+              tile_height);
+
+  gegl_tile_handler_lock (GEGL_TILE_HANDLER (buffer));
+
+  for (y = y1; y <= y2; y++)
+    {
+      for (x = x1; x <= x2; x++)
+        {
+          GeglRectangle  rect;
+          GeglTile      *tile = NULL;
+
+          gegl_rectangle_intersect (&rect,
+                                    GEGL_RECTANGLE (x * tile_width  - shift_x,
+                                                    y * tile_height - shift_y,
+                                                    tile_width, tile_height),
+                                    extent);
+
+          /*  don't bring in tiles from the swap just to look at them  */
+          if (gegl_tile_source_command (source, GEGL_TILE_IS_CACHED,
+                                        x, y, 0, NULL))
+            {
+              tile = gegl_tile_source_command (source, GEGL_TILE_GET,
+                                               x, y, 0, NULL);
+            }
+
+          /*  copy-on-write clones share their data until written to  */
+          if (! tile ||
+              g_hash_table_add (tiles, gegl_tile_get_data (tile)))
+            {
+              memsize += (gint64) rect.width * rect.height * bpp;
+            }
+
+          if (tile)
+            gegl_tile_unref (tile);
+        }
+    }
+
+  gegl_tile_handler_unlock (GEGL_TILE_HANDLER (buffer));
+
+  return memsize;
+}
@@ -19,6 +19,9 @@
 #define __APP_GIMP_MEMSIZE_H__
 
 
+void     gimp_memsize_shared_tiles_begin       (void);
+void     gimp_memsize_shared_tiles_end         (void);
+
 gint64   gimp_g_type_instance_get_memsize      (GTypeInstance   *instance);
 gint64   gimp_g_object_get_memsize             (GObject         *object);
 
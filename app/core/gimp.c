@@ -474,6 +474,9 @@ gimp_get_memsize (GimpObject *object,
   Gimp   *gimp    = GIMP (object);
   gint64  memsize = 0;
 
+  /*  count tiles shared between images and buffers only once  */
+  gimp_memsize_shared_tiles_begin ();
+
   memsize += gimp_g_list_get_memsize (gimp->user_units, 0 /* FIXME */);
 
   memsize += gimp_object_get_memsize (GIMP_OBJECT (gimp->parasites),
@@ -525,6 +528,8 @@ gimp_get_memsize (GimpObject *object,
   memsize += gimp_object_get_memsize (GIMP_OBJECT (gimp->user_context),
                                       gui_size);
 
+  gimp_memsize_shared_tiles_end ();
+
   return memsize + GIMP_OBJECT_CLASS (parent_class)->get_memsize (object,
                                                                   gui_size);
 }
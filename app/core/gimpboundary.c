@@ -32,6 +32,12 @@
 /* GimpBoundSeg array growth parameter */
 #define MAX_SEGS_INC  2048
 
+/* number of scanlines scanned, and cached, as a unit */
+#define BAND_HEIGHT            64
+
+/* minimal number of mask pixels scanned by a single thread */
+#define MIN_PIXELS_PER_THREAD  (256 * 256)
+
 
 typedef struct _GimpBoundary GimpBoundary;
 
@@ -44,14 +50,61 @@ struct _GimpBoundary
 
   /*  The array of vertical segments  */
   gint         *vert_segs;
+};
 
-  /*  The empty segment arrays */
-  gint         *empty_segs_n;
-  gint         *empty_segs_c;
-  gint         *empty_segs_l;
-  gint          max_empty_segs;
+struct _GimpBoundaryCache
+{
+  GMutex            mutex;
+
+  /*  the parameters the cached bands were scanned with  */
+  GeglBuffer       *buffer;
+  GeglRectangle     region;
+  const Babl       *format;
+  GimpBoundaryType  type;
+  gint              x1;
+  gint              y1;
+  gint              x2;
+  gint              y2;
+  gfloat            threshold;
+
+  /*  the range of scanlines, in bands of BAND_HEIGHT scanlines  */
+  gint              start;
+  gint              end;
+  gint              n_bands;
+
+  /*  the horizontal segments found in each band, and whether the
+   *  band has to be scanned again
+   */
+  GArray          **horiz_segs;
+  gboolean         *dirty;
 };
 
+typedef struct
+{
+  GimpBoundaryCache *cache;
+
+  /*  the bands to scan  */
+  const gint        *bands;
+  gint               n_bands;
+} GenerateBoundaryData;
+
+typedef struct
+{
+  gint x;
+  gint y;
+  gint head;
+} SegmentLink;
+
+typedef struct
+{
+  /*  open-addressing table of segment end points  */
+  SegmentLink *links;
+  guint        mask;
+
+  /*  per end point chains, two nodes per segment, ordered by segment  */
+  gint        *next;
+} SegmentIndex;
+
 
 /*  local function prototypes  */
 
@@ -84,44 +137,31 @@ static void           process_horiz_seg        (GimpBoundary        *boundary,
                                                 gint                 x2,
                                                 gint                 y2,
                                                 gboolean             open);
-static void           make_horiz_segs          (GimpBoundary        *boundary,
+static void           make_horiz_segs          (GArray              *horiz_segs,
                                                 gint                 start,
                                                 gint                 end,
                                                 gint                 scanline,
                                                 gint                 empty[],
                                                 gint                 num_empty,
                                                 gint                 top);
-static GimpBoundary * generate_boundary        (GeglBuffer          *buffer,
-                                                const GeglRectangle *region,
-                                                const Babl          *format,
-                                                GimpBoundaryType     type,
-                                                gint                 x1,
-                                                gint                 y1,
-                                                gint                 x2,
-                                                gint                 y2,
-                                                gfloat               threshold);
-
-static gint       cmp_segptr_xy1_addr     (const GimpBoundSeg **seg_ptr_a,
-                                           const GimpBoundSeg **seg_ptr_b);
-static gint       cmp_segptr_xy2_addr     (const GimpBoundSeg **seg_ptr_a,
-                                           const GimpBoundSeg **seg_ptr_b);
-
-static gint       cmp_segptr_xy1          (const GimpBoundSeg **seg_ptr_a,
-                                           const GimpBoundSeg **seg_ptr_b);
-static gint       cmp_segptr_xy2          (const GimpBoundSeg **seg_ptr_a,
-                                           const GimpBoundSeg **seg_ptr_b);
-
-static const GimpBoundSeg * find_segment  (const GimpBoundSeg **segs_by_xy1,
-                                           const GimpBoundSeg **segs_by_xy2,
-                                           gint                 num_segs,
+static GArray       * generate_boundary_band   (GimpBoundaryCache   *cache,
+                                                gint                 band);
+static void           generate_boundary_bands  (gint                 i,
+                                                gint                 n,
+                                                GenerateBoundaryData *data);
+static GimpBoundary * generate_boundary        (GimpBoundaryCache   *cache);
+
+static void           gimp_boundary_cache_reset (GimpBoundaryCache   *cache);
+
+static void       segment_index_init      (SegmentIndex        *seg_index,
+                                           const GimpBoundSeg  *segs,
+                                           gint                 num_segs);
+static void       segment_index_free      (SegmentIndex        *seg_index);
+static const GimpBoundSeg * find_segment  (const SegmentIndex  *seg_index,
+                                           const GimpBoundSeg  *segs,
                                            gint                 x,
                                            gint                 y);
 
-static const GimpBoundSeg * find_segment_with_func (const GimpBoundSeg **segs,
-                                                    gint                 num_segs,
-                                                    const GimpBoundSeg  *search_seg,
-                                                    GCompareFunc         cmp_func);
-
 static void       simplify_subdivide  (const GimpBoundSeg  *segs,
                                        gint                 start_idx,
                                        gint                 end_idx,
@@ -163,10 +203,123 @@ gimp_boundary_find (GeglBuffer          *buffer,
                     int                  y2,
                     gfloat               threshold,
                     int                 *num_segs)
+{
+  GimpBoundaryCache *cache;
+  GimpBoundSeg      *segs;
+
+  cache = gimp_boundary_cache_new ();
+
+  segs = gimp_boundary_cache_find (cache, buffer, region, format, type,
+                                   x1, y1, x2, y2, threshold, num_segs);
+
+  gimp_boundary_cache_free (cache);
+
+  return segs;
+}
+
+/**
+ * gimp_boundary_cache_new:
+ *
+ * Creates a cache for gimp_boundary_cache_find(), which keeps the
+ * horizontal segments found in each band of scanlines, so that
+ * finding the boundary again only scans the bands which changed.
+ *
+ * Returns: a new #GimpBoundaryCache.
+ **/
+GimpBoundaryCache *
+gimp_boundary_cache_new (void)
+{
+  GimpBoundaryCache *cache = g_slice_new0 (GimpBoundaryCache);
+
+  g_mutex_init (&cache->mutex);
+
+  return cache;
+}
+
+void
+gimp_boundary_cache_free (GimpBoundaryCache *cache)
+{
+  g_return_if_fail (cache != NULL);
+
+  gimp_boundary_cache_reset (cache);
+
+  g_mutex_clear (&cache->mutex);
+
+  g_slice_free (GimpBoundaryCache, cache);
+}
+
+/**
+ * gimp_boundary_cache_invalidate:
+ * @cache: a #GimpBoundaryCache
+ * @rect:  (nullable): the area of the buffer which changed, or %NULL
+ *         if all of it did
+ *
+ * Marks the bands of scanlines whose horizontal segments depend on the
+ * pixels in @rect for scanning again.  May be called from any thread.
+ **/
+void
+gimp_boundary_cache_invalidate (GimpBoundaryCache   *cache,
+                                const GeglRectangle *rect)
+{
+  gint band;
+
+  g_return_if_fail (cache != NULL);
+
+  g_mutex_lock (&cache->mutex);
+
+  for (band = 0; band < cache->n_bands; band++)
+    {
+      gint band_start = cache->start + band * BAND_HEIGHT;
+      gint band_end   = MIN (band_start + BAND_HEIGHT, cache->end);
+
+      /*  a band's segments depend on the scanlines above and below it  */
+      if (! rect ||
+          (band_start <= rect->y + rect->height && band_end >= rect->y))
+        {
+          cache->dirty[band] = TRUE;
+        }
+    }
+
+  g_mutex_unlock (&cache->mutex);
+}
+
+/**
+ * gimp_boundary_cache_find:
+ * @cache:     a #GimpBoundaryCache
+ * @buffer:    a #GeglBuffer
+ * @region:    (nullable): the area of @buffer to analyze
+ * @format:    a #Babl float format representing the component to analyze
+ * @type:      type of bounds
+ * @x1:        left side of bounds
+ * @y1:        top side of bounds
+ * @x2:        right side of bounds
+ * @y2:        bottom side of bounds
+ * @threshold: pixel value of boundary line
+ * @num_segs:  number of returned #GimpBoundSeg's
+ *
+ * Like gimp_boundary_find(), but only scans the bands of scanlines
+ * which were invalidated since the last call with the same
+ * parameters.  Any other parameters scan all of @buffer again.
+ *
+ * Returns: the boundary array.
+ **/
+GimpBoundSeg *
+gimp_boundary_cache_find (GimpBoundaryCache   *cache,
+                          GeglBuffer          *buffer,
+                          const GeglRectangle *region,
+                          const Babl          *format,
+                          GimpBoundaryType     type,
+                          gint                 x1,
+                          gint                 y1,
+                          gint                 x2,
+                          gint                 y2,
+                          gfloat               threshold,
+                          gint                *num_segs)
 {
   GimpBoundary  *boundary;
   GeglRectangle  rect = { 0, };
 
+  g_return_val_if_fail (cache != NULL, NULL);
   g_return_val_if_fail (GEGL_IS_BUFFER (buffer), NULL);
   g_return_val_if_fail (num_segs != NULL, NULL);
   g_return_val_if_fail (format != NULL, NULL);
@@ -183,14 +336,84 @@ gimp_boundary_find (GeglBuffer          *buffer,
       rect.height = gegl_buffer_get_height (buffer);
     }
 
-  boundary = generate_boundary (buffer, &rect, format, type,
-                                x1, y1, x2, y2, threshold);
+  g_mutex_lock (&cache->mutex);
+
+  if (buffer    != cache->buffer                         ||
+      ! gegl_rectangle_equal (&rect, &cache->region)     ||
+      format    != cache->format                         ||
+      type      != cache->type                           ||
+      x1        != cache->x1                             ||
+      y1        != cache->y1                             ||
+      x2        != cache->x2                             ||
+      y2        != cache->y2                             ||
+      threshold != cache->threshold                      ||
+      ! cache->horiz_segs)
+    {
+      gint band;
+
+      gimp_boundary_cache_reset (cache);
+
+      cache->buffer    = buffer;
+      cache->region    = rect;
+      cache->format    = format;
+      cache->type      = type;
+      cache->x1        = x1;
+      cache->y1        = y1;
+      cache->x2        = x2;
+      cache->y2        = y2;
+      cache->threshold = threshold;
+
+      if (type == GIMP_BOUNDARY_WITHIN_BOUNDS)
+        {
+          cache->start = y1;
+          cache->end   = y2;
+        }
+      else if (type == GIMP_BOUNDARY_IGNORE_BOUNDS)
+        {
+          cache->start = rect.y;
+          cache->end   = rect.y + rect.height;
+        }
+
+      if (cache->end > cache->start)
+        cache->n_bands = ((cache->end - cache->start + BAND_HEIGHT - 1) /
+                          BAND_HEIGHT);
+
+      cache->horiz_segs = g_new0 (GArray *, cache->n_bands);
+      cache->dirty      = g_new (gboolean, cache->n_bands);
+
+      for (band = 0; band < cache->n_bands; band++)
+        cache->dirty[band] = TRUE;
+    }
+
+  g_mutex_unlock (&cache->mutex);
+
+  boundary = generate_boundary (cache);
 
   *num_segs = boundary->num_segs;
 
   return gimp_boundary_free (boundary, FALSE);
 }
 
+gint64
+gimp_boundary_cache_get_memsize (GimpBoundaryCache *cache)
+{
+  gint64 memsize;
+  gint   band;
+
+  g_return_val_if_fail (cache != NULL, 0);
+
+  memsize = sizeof (GimpBoundaryCache) +
+            cache->n_bands * (sizeof (GArray *) + sizeof (gboolean));
+
+  for (band = 0; band < cache->n_bands; band++)
+    {
+      if (cache->horiz_segs[band])
+        memsize += cache->horiz_segs[band]->len * sizeof (GimpBoundSeg);
+    }
+
+  return memsize;
+}
+
 /**
  * gimp_boundary_sort:
  * @segs:       unsorted input segs.
@@ -209,12 +432,11 @@ gimp_boundary_sort (const GimpBoundSeg *segs,
                     gint                num_segs,
                     gint               *num_groups)
 {
-  GimpBoundary        *boundary;
-  const GimpBoundSeg **segs_ptrs_by_xy1;
-  const GimpBoundSeg **segs_ptrs_by_xy2;
-  gint                 index;
-  gint                 x, y;
-  gint                 startx, starty;
+  GimpBoundary *boundary;
+  SegmentIndex  seg_index;
+  gint          index;
+  gint          x, y;
+  gint          startx, starty;
 
   g_return_val_if_fail ((segs == NULL && num_segs == 0) ||
                         (segs != NULL && num_segs >  0), NULL);
@@ -225,22 +447,10 @@ gimp_boundary_sort (const GimpBoundSeg *segs,
   if (num_segs == 0)
     return NULL;
 
-  /* prepare arrays with GimpBoundSeg pointers sorted by xy1 and xy2
-   * accordingly
+  /* index the segments by their end points, so that chaining them
+   * is a constant-time lookup per segment
    */
-  segs_ptrs_by_xy1 = g_new (const GimpBoundSeg *, num_segs);
-  segs_ptrs_by_xy2 = g_new (const GimpBoundSeg *, num_segs);
-
-  for (index = 0; index < num_segs; index++)
-    {
-      segs_ptrs_by_xy1[index] = segs + index;
-      segs_ptrs_by_xy2[index] = segs + index;
-    }
-
-  qsort (segs_ptrs_by_xy1, num_segs, sizeof (GimpBoundSeg *),
-         (GCompareFunc) cmp_segptr_xy1_addr);
-  qsort (segs_ptrs_by_xy2, num_segs, sizeof (GimpBoundSeg *),
-         (GCompareFunc) cmp_segptr_xy2_addr);
+  segment_index_init (&seg_index, segs, num_segs);
 
   for (index = 0; index < num_segs; index++)
     ((GimpBoundSeg *) segs)[index].visited = FALSE;
@@ -266,8 +476,7 @@ gimp_boundary_sort (const GimpBoundSeg *segs,
       x = segs[index].x2;
       y = segs[index].y2;
 
-      while ((cur_seg = find_segment (segs_ptrs_by_xy1, segs_ptrs_by_xy2,
-                                      num_segs, x, y)) != NULL)
+      while ((cur_seg = find_segment (&seg_index, segs, x, y)) != NULL)
         {
           /*  make sure ordering is correct  */
           if (x == cur_seg->x1 && y == cur_seg->y1)
@@ -300,8 +509,7 @@ gimp_boundary_sort (const GimpBoundSeg *segs,
       gimp_boundary_add_seg (boundary, -1, -1, -1, -1, 0);
   }
 
-  g_free (segs_ptrs_by_xy1);
-  g_free (segs_ptrs_by_xy2);
+  segment_index_free (&seg_index);
 
   return gimp_boundary_free (boundary, FALSE);
 }
@@ -427,15 +635,6 @@ gimp_boundary_new (const GeglRectangle *region)
 
       for (i = 0; i <= (region->width + region->x); i++)
         boundary->vert_segs[i] = -1;
-
-      /*  find the maximum possible number of empty segments
-       *  given the current mask
-       */
-      boundary->max_empty_segs = region->width + 3;
-
-      boundary->empty_segs_n = g_new (gint, boundary->max_empty_segs);
-      boundary->empty_segs_c = g_new (gint, boundary->max_empty_segs);
-      boundary->empty_segs_l = g_new (gint, boundary->max_empty_segs);
     }
 
   return boundary;
@@ -453,9 +652,6 @@ gimp_boundary_free (GimpBoundary *boundary,
     segs = boundary->segs;
 
   g_free (boundary->vert_segs);
-  g_free (boundary->empty_segs_n);
-  g_free (boundary->empty_segs_c);
-  g_free (boundary->empty_segs_l);
 
   g_slice_free (GimpBoundary, boundary);
 
@@ -632,309 +828,381 @@ process_horiz_seg (GimpBoundary *boundary,
 }
 
 static void
-make_horiz_segs (GimpBoundary *boundary,
-                 gint          start,
-                 gint          end,
-                 gint          scanline,
-                 gint          empty[],
-                 gint          num_empty,
-                 gint          top)
+make_horiz_segs (GArray *horiz_segs,
+                 gint    start,
+                 gint    end,
+                 gint    scanline,
+                 gint    empty[],
+                 gint    num_empty,
+                 gint    top)
 {
   gint empty_index;
   gint e_s, e_e;    /* empty segment start and end values */
 
   for (empty_index = 0; empty_index < num_empty; empty_index += 2)
     {
+      GimpBoundSeg seg = { 0, };
+
       e_s = *empty++;
       e_e = *empty++;
 
       if (e_s <= start && e_e >= end)
         {
-          process_horiz_seg (boundary,
-                             start, scanline, end, scanline, top);
+          seg.x1 = start;
+          seg.x2 = end;
         }
       else if ((e_s > start && e_s < end) ||
                (e_e < end && e_e > start))
         {
-          process_horiz_seg (boundary,
-                             MAX (e_s, start), scanline,
-                             MIN (e_e, end), scanline, top);
+          seg.x1 = MAX (e_s, start);
+          seg.x2 = MIN (e_e, end);
+        }
+      else
+        {
+          continue;
         }
+
+      seg.y1   = scanline;
+      seg.y2   = scanline;
+      seg.open = top;
+
+      g_array_append_val (horiz_segs, seg);
     }
 }
 
-static GimpBoundary *
-generate_boundary (GeglBuffer          *buffer,
-                   const GeglRectangle *region,
-                   const Babl          *format,
-                   GimpBoundaryType     type,
-                   gint                 x1,
-                   gint                 y1,
-                   gint                 x2,
-                   gint                 y2,
-                   gfloat               threshold)
+static GArray *
+generate_boundary_band (GimpBoundaryCache *cache,
+                        gint               band)
 {
-  GimpBoundary  *boundary;
-  GeglRectangle  line_rect = { 0, };
-  gfloat        *line_data;
-  gint           scanline;
-  gint           i;
-  gint           start, end;
-  gint          *tmp_segs;
-
-  gint          num_empty_n = 0;
-  gint          num_empty_c = 0;
-  gint          num_empty_l = 0;
-
-  boundary = gimp_boundary_new (region);
-
-  line_rect.width  = gegl_buffer_get_width (buffer);
+  const GeglRectangle *region = &cache->region;
+  GArray              *horiz_segs;
+  GeglRectangle        line_rect = { 0, };
+  gfloat              *line_data;
+  gint                 scanline;
+  gint                 band_start;
+  gint                 band_end;
+  gint                 max_empty_segs;
+  gint                *empty_segs_n;
+  gint                *empty_segs_c;
+  gint                *empty_segs_l;
+  gint                *tmp_segs;
+  gint                 num_empty_n = 0;
+  gint                 num_empty_c = 0;
+  gint                 num_empty_l = 0;
+  gint                 j;
+
+  band_start = cache->start + band * BAND_HEIGHT;
+  band_end   = MIN (band_start + BAND_HEIGHT, cache->end);
+
+  horiz_segs = g_array_new (FALSE, FALSE, sizeof (GimpBoundSeg));
+
+  line_rect.width  = gegl_buffer_get_width (cache->buffer);
   line_rect.height = 1;
 
-  line_data = g_alloca (sizeof (gfloat) * line_rect.width);
+  line_data = g_new (gfloat, line_rect.width);
 
-  start = 0;
-  end   = 0;
+  /*  find the maximum possible number of empty segments
+   *  given the current mask
+   */
+  max_empty_segs = region->width + 3;
 
-  if (type == GIMP_BOUNDARY_WITHIN_BOUNDS)
-    {
-      start = y1;
-      end   = y2;
-    }
-  else if (type == GIMP_BOUNDARY_IGNORE_BOUNDS)
+  empty_segs_n = g_new (gint, max_empty_segs);
+  empty_segs_c = g_new (gint, max_empty_segs);
+  empty_segs_l = g_new (gint, max_empty_segs);
+
+  /*  Find the empty segments for the previous and current scanlines.
+   *  the scanline above the first band is outside of the processed
+   *  area, and therefore empty; other bands need to look at the
+   *  scanline above them.
+   */
+  if (band_start > cache->start)
     {
-      start = region->y;
-      end   = region->y + region->height;
+      line_rect.y = band_start - 1;
+      gegl_buffer_get (cache->buffer, &line_rect, 1.0, cache->format,
+                       line_data, GEGL_AUTO_ROWSTRIDE,
+                       GEGL_ABYSS_NONE);
     }
 
-  /*  Find the empty segments for the previous and current scanlines  */
-  find_empty_segs (region, NULL,
-                   start - 1, boundary->empty_segs_l,
-                   boundary->max_empty_segs, &num_empty_l,
-                   type, x1, y1, x2, y2,
-                   threshold);
+  find_empty_segs (region, band_start > cache->start ? line_data : NULL,
+                   band_start - 1, empty_segs_l,
+                   max_empty_segs, &num_empty_l,
+                   cache->type, cache->x1, cache->y1, cache->x2, cache->y2,
+                   cache->threshold);
 
-  line_rect.y = start;
-  gegl_buffer_get (buffer, &line_rect, 1.0, format,
+  line_rect.y = band_start;
+  gegl_buffer_get (cache->buffer, &line_rect, 1.0, cache->format,
                    line_data, GEGL_AUTO_ROWSTRIDE,
                    GEGL_ABYSS_NONE);
 
   find_empty_segs (region, line_data,
-                   start, boundary->empty_segs_c,
-                   boundary->max_empty_segs, &num_empty_c,
-                   type, x1, y1, x2, y2,
-                   threshold);
+                   band_start, empty_segs_c,
+                   max_empty_segs, &num_empty_c,
+                   cache->type, cache->x1, cache->y1, cache->x2, cache->y2,
+                   cache->threshold);
 
-  for (scanline = start; scanline < end; scanline++)
+  for (scanline = band_start; scanline < band_end; scanline++)
     {
+      const gfloat *next_line_data = line_data;
+
       /*  find the empty segment list for the next scanline  */
       line_rect.y = scanline + 1;
-      if (scanline + 1 == end)
-        line_data = NULL;
+      if (scanline + 1 == cache->end)
+        next_line_data = NULL;
       else
-        gegl_buffer_get (buffer, &line_rect, 1.0, format,
+        gegl_buffer_get (cache->buffer, &line_rect, 1.0, cache->format,
                          line_data, GEGL_AUTO_ROWSTRIDE,
                          GEGL_ABYSS_NONE);
 
-      find_empty_segs (region, line_data,
-                       scanline + 1, boundary->empty_segs_n,
-                       boundary->max_empty_segs, &num_empty_n,
-                       type, x1, y1, x2, y2,
-                       threshold);
+      find_empty_segs (region, next_line_data,
+                       scanline + 1, empty_segs_n,
+                       max_empty_segs, &num_empty_n,
+                       cache->type, cache->x1, cache->y1,
+                       cache->x2, cache->y2, cache->threshold);
 
       /*  process the segments on the current scanline  */
-      for (i = 1; i < num_empty_c - 1; i += 2)
+      for (j = 1; j < num_empty_c - 1; j += 2)
         {
-          make_horiz_segs (boundary,
-                           boundary->empty_segs_c [i],
-                           boundary->empty_segs_c [i+1],
+          make_horiz_segs (horiz_segs,
+                           empty_segs_c [j],
+                           empty_segs_c [j+1],
                            scanline,
-                           boundary->empty_segs_l, num_empty_l, 1);
-          make_horiz_segs (boundary,
-                           boundary->empty_segs_c [i],
-                           boundary->empty_segs_c [i+1],
+                           empty_segs_l, num_empty_l, 1);
+          make_horiz_segs (horiz_segs,
+                           empty_segs_c [j],
+                           empty_segs_c [j+1],
                            scanline + 1,
-                           boundary->empty_segs_n, num_empty_n, 0);
+                           empty_segs_n, num_empty_n, 0);
         }
 
       /*  get the next scanline of empty segments, swap others  */
-      tmp_segs               = boundary->empty_segs_l;
-      boundary->empty_segs_l = boundary->empty_segs_c;
-      num_empty_l            = num_empty_c;
-      boundary->empty_segs_c = boundary->empty_segs_n;
-      num_empty_c            = num_empty_n;
-      boundary->empty_segs_n = tmp_segs;
+      tmp_segs     = empty_segs_l;
+      empty_segs_l = empty_segs_c;
+      num_empty_l  = num_empty_c;
+      empty_segs_c = empty_segs_n;
+      num_empty_c  = num_empty_n;
+      empty_segs_n = tmp_segs;
     }
 
-  return boundary;
-}
+  g_free (empty_segs_n);
+  g_free (empty_segs_c);
+  g_free (empty_segs_l);
+  g_free (line_data);
 
-/*  sorting utility functions  */
+  return horiz_segs;
+}
 
-static inline gint
-cmp_xy (const gint ax,
-        const gint ay,
-        const gint bx,
-        const gint by)
+static void
+generate_boundary_bands (gint                  i,
+                         gint                  n,
+                         GenerateBoundaryData *data)
 {
-  if (ay < by)
-    {
-      return -1;
-    }
-  else if (ay > by)
+  GimpBoundaryCache *cache = data->cache;
+  gint               first = (gint64) data->n_bands * i       / n;
+  gint               last  = (gint64) data->n_bands * (i + 1) / n;
+  gint               j;
+
+  for (j = first; j < last; j++)
     {
-      return 1;
+      gint band = data->bands[j];
+
+      /*  each band is only ever scanned by one thread at a time  */
+      if (cache->horiz_segs[band])
+        g_array_free (cache->horiz_segs[band], TRUE);
+
+      cache->horiz_segs[band] = generate_boundary_band (cache, band);
     }
-  else if (ax < bx)
+}
+
+
+static GimpBoundary *
+generate_boundary (GimpBoundaryCache *cache)
+{
+  GimpBoundary         *boundary;
+  GenerateBoundaryData  data;
+  gint                 *bands;
+  gint                  n_bands = 0;
+  gint                  n_threads;
+  gint                  band;
+
+  boundary = gimp_boundary_new (&cache->region);
+
+  bands = g_new (gint, cache->n_bands);
+
+  g_mutex_lock (&cache->mutex);
+
+  for (band = 0; band < cache->n_bands; band++)
     {
-      return -1;
+      if (cache->dirty[band])
+        {
+          bands[n_bands++]   = band;
+          cache->dirty[band] = FALSE;
+        }
     }
-  else if (ax > bx)
+
+  g_mutex_unlock (&cache->mutex);
+
+  /*  scanning the mask for horizontal segments is independent per
+   *  band of scanlines, so scan the bands which changed in parallel,
+   *  then connect the horizontal segments of all bands with vertical
+   *  ones in scanline order, which yields exactly the same segments as
+   *  a single sequential pass.  Bands are only invalidated by whole
+   *  scanlines, as a scanline's segments depend on all of it.
+   */
+  if (n_bands > 0)
     {
-      return 1;
+      data.cache   = cache;
+      data.bands   = bands;
+      data.n_bands = n_bands;
+
+      n_threads = (gint64) n_bands * BAND_HEIGHT * cache->region.width /
+                  MIN_PIXELS_PER_THREAD;
+      n_threads = CLAMP (n_threads, 1, n_bands);
+
+      gegl_parallel_distribute (n_threads,
+                                (GeglParallelDistributeFunc) generate_boundary_bands,
+                                &data);
     }
-  else
+
+  g_free (bands);
+
+  for (band = 0; band < cache->n_bands; band++)
     {
-      return 0;
+      GArray *horiz_segs = cache->horiz_segs[band];
+      gint    j;
+
+      for (j = 0; j < horiz_segs->len; j++)
+        {
+          const GimpBoundSeg *seg = &g_array_index (horiz_segs,
+                                                    GimpBoundSeg, j);
+
+          process_horiz_seg (boundary,
+                             seg->x1, seg->y1, seg->x2, seg->y2, seg->open);
+        }
     }
-}
 
+  return boundary;
+}
 
-/*
- * Compares (x1, y1) pairs in specified segments, using their addresses if
- * (x1, y1) pairs are equal.
- */
-static gint
-cmp_segptr_xy1_addr (const GimpBoundSeg **seg_ptr_a,
-                     const GimpBoundSeg **seg_ptr_b)
+static void
+gimp_boundary_cache_reset (GimpBoundaryCache *cache)
 {
-  const GimpBoundSeg *seg_a = *seg_ptr_a;
-  const GimpBoundSeg *seg_b = *seg_ptr_b;
-
-  gint result = cmp_xy (seg_a->x1, seg_a->y1, seg_b->x1, seg_b->y1);
+  gint band;
 
-  if (result == 0)
+  for (band = 0; band < cache->n_bands; band++)
     {
-      if (seg_a < seg_b)
-        result = -1;
-      else if (seg_a > seg_b)
-        result = 1;
+      if (cache->horiz_segs[band])
+        g_array_free (cache->horiz_segs[band], TRUE);
     }
 
-  return result;
+  g_clear_pointer (&cache->horiz_segs, g_free);
+  g_clear_pointer (&cache->dirty,      g_free);
+
+  cache->buffer  = NULL;
+  cache->start   = 0;
+  cache->end     = 0;
+  cache->n_bands = 0;
 }
 
-/*
- * Compares (x2, y2) pairs in specified segments, using their addresses if
- * (x2, y2) pairs are equal.
- */
-static gint
-cmp_segptr_xy2_addr (const GimpBoundSeg **seg_ptr_a,
-                     const GimpBoundSeg **seg_ptr_b)
+/*  sorting utility functions  */
+
+static inline guint
+segment_index_hash (gint x,
+                    gint y)
 {
-  const GimpBoundSeg *seg_a = *seg_ptr_a;
-  const GimpBoundSeg *seg_b = *seg_ptr_b;
+  return ((guint) x * 73856093u) ^ ((guint) y * 19349663u);
+}
 
-  gint result = cmp_xy (seg_a->x2, seg_a->y2, seg_b->x2, seg_b->y2);
+static SegmentLink *
+segment_index_lookup (const SegmentIndex *seg_index,
+                      gint                x,
+                      gint                y)
+{
+  guint i = segment_index_hash (x, y) & seg_index->mask;
 
-  if (result == 0)
+  /*  linear probing; the table is never more than half full  */
+  while (seg_index->links[i].head >= 0 &&
+         (seg_index->links[i].x != x || seg_index->links[i].y != y))
     {
-      if (seg_a < seg_b)
-        result = -1;
-      else if (seg_a > seg_b)
-        result = 1;
+      i = (i + 1) & seg_index->mask;
     }
 
-  return result;
+  return &seg_index->links[i];
 }
 
-
-/*
- * Compares (x1, y1) pairs in specified segments.
- */
-static gint
-cmp_segptr_xy1 (const GimpBoundSeg **seg_ptr_a,
-                const GimpBoundSeg **seg_ptr_b)
+static void
+segment_index_init (SegmentIndex       *seg_index,
+                    const GimpBoundSeg *segs,
+                    gint                num_segs)
 {
-  const GimpBoundSeg *seg_a = *seg_ptr_a, *seg_b = *seg_ptr_b;
+  guint size = 1;
+  guint j;
+  gint  i;
 
-  return cmp_xy (seg_a->x1, seg_a->y1, seg_b->x1, seg_b->y1);
-}
+  while (size < 4 * (guint) num_segs)
+    size <<= 1;
 
-/*
- * Compares (x2, y2) pairs in specified segments.
- */
-static gint
-cmp_segptr_xy2 (const GimpBoundSeg **seg_ptr_a,
-                const GimpBoundSeg **seg_ptr_b)
-{
-  const GimpBoundSeg *seg_a = *seg_ptr_a;
-  const GimpBoundSeg *seg_b = *seg_ptr_b;
+  seg_index->links = g_new (SegmentLink, size);
+  seg_index->mask  = size - 1;
+  seg_index->next  = g_new (gint, 2 * num_segs);
 
-  return cmp_xy (seg_a->x2, seg_a->y2, seg_b->x2, seg_b->y2);
-}
+  for (j = 0; j < size; j++)
+    seg_index->links[j].head = -1;
 
+  /*  node (2 * i) is the (x1, y1) end of segment i, node (2 * i + 1)
+   *  its (x2, y2) end.  we insert the nodes in reverse order, so that
+   *  each chain lists its segments in ascending order, which makes
+   *  find_segment() pick the same segment as a search over the
+   *  segment addresses would.
+   */
+  for (i = 2 * num_segs - 1; i >= 0; i--)
+    {
+      const GimpBoundSeg *seg = &segs[i / 2];
+      SegmentLink        *link;
+      gint                x   = (i & 1) ? seg->x2 : seg->x1;
+      gint                y   = (i & 1) ? seg->y2 : seg->y1;
 
-static const GimpBoundSeg *
-find_segment (const GimpBoundSeg **segs_by_xy1,
-              const GimpBoundSeg **segs_by_xy2,
-              gint                 num_segs,
-              gint                 x,
-              gint                 y)
-{
-  const GimpBoundSeg *segptr_xy1;
-  const GimpBoundSeg *segptr_xy2;
-  GimpBoundSeg        search_seg;
-
-  search_seg.x1 = search_seg.x2 = x;
-  search_seg.y1 = search_seg.y2 = y;
-
-  segptr_xy1 = find_segment_with_func (segs_by_xy1, num_segs, &search_seg,
-                                       (GCompareFunc) cmp_segptr_xy1);
-  segptr_xy2 = find_segment_with_func (segs_by_xy2, num_segs, &search_seg,
-                                       (GCompareFunc) cmp_segptr_xy2);
-
-  /* return segment with smaller address */
-  if (segptr_xy1 != NULL && segptr_xy2 != NULL)
-    return MIN(segptr_xy1, segptr_xy2);
-  else if (segptr_xy1 != NULL)
-    return segptr_xy1;
-  else if (segptr_xy2 != NULL)
-    return segptr_xy2;
+      link = segment_index_lookup (seg_index, x, y);
 
-  return NULL;
+      if (link->head < 0)
+        {
+          link->x = x;
+          link->y = y;
+
+          seg_index->next[i] = -1;
+        }
+      else
+        {
+          seg_index->next[i] = link->head;
+        }
+
+      link->head = i;
+    }
 }
 
+static void
+segment_index_free (SegmentIndex *seg_index)
+{
+  g_free (seg_index->links);
+  g_free (seg_index->next);
+}
 
 static const GimpBoundSeg *
-find_segment_with_func (const GimpBoundSeg **segs,
-                        gint                 num_segs,
-                        const GimpBoundSeg  *search_seg,
-                        GCompareFunc         cmp_func)
+find_segment (const SegmentIndex *seg_index,
+              const GimpBoundSeg *segs,
+              gint                x,
+              gint                y)
 {
-  const GimpBoundSeg **seg;
-  const GimpBoundSeg *found_seg = NULL;
+  const SegmentLink *link = segment_index_lookup (seg_index, x, y);
+  gint               node;
 
-  seg = bsearch (&search_seg, segs, num_segs, sizeof (GimpBoundSeg *), cmp_func);
-
-  if (seg != NULL)
+  /*  return the first non-visited segment ending at (x, y)  */
+  for (node = link->head; node >= 0; node = seg_index->next[node])
     {
-      /* find first matching segment */
-      while (seg > segs && cmp_func (seg - 1, &search_seg) == 0)
-        seg--;
-
-      /* find first non-visited segment */
-      while (seg != segs + num_segs && cmp_func (seg, &search_seg) == 0)
-        if (!(*seg)->visited)
-          {
-            found_seg = *seg;
-            break;
-          }
-        else
-          seg++;
+      if (! segs[node / 2].visited)
+        return &segs[node / 2];
     }
 
-    return found_seg;
+  return NULL;
 }
 
 
@@ -44,6 +44,7 @@
 #include "gimpcontainer.h"
 #include "gimperror.h"
 #include "gimpimage.h"
+#include "gimpimage-executor.h"
 #include "gimpimage-quick-mask.h"
 #include "gimpimage-undo.h"
 #include "gimpimage-undo-push.h"
@@ -314,6 +315,8 @@ gimp_channel_init (GimpChannel *channel)
   channel->segs_out       = NULL;
   channel->num_segs_in    = 0;
   channel->num_segs_out   = 0;
+  channel->segs_in_cache  = gimp_boundary_cache_new ();
+  channel->segs_out_cache = gimp_boundary_cache_new ();
   channel->empty          = FALSE;
   channel->bounds_known   = FALSE;
   channel->x1             = 0;
@@ -335,6 +338,8 @@ gimp_channel_finalize (GObject *object)
 
   g_clear_pointer (&channel->segs_in,  g_free);
   g_clear_pointer (&channel->segs_out, g_free);
+  g_clear_pointer (&channel->segs_in_cache,  gimp_boundary_cache_free);
+  g_clear_pointer (&channel->segs_out_cache, gimp_boundary_cache_free);
   g_clear_object (&channel->color);
 
   G_OBJECT_CLASS (parent_class)->finalize (object);
@@ -348,6 +353,8 @@ gimp_channel_get_memsize (GimpObject *object,
 
   *gui_size += channel->num_segs_in  * sizeof (GimpBoundSeg);
   *gui_size += channel->num_segs_out * sizeof (GimpBoundSeg);
+  *gui_size += gimp_boundary_cache_get_memsize (channel->segs_in_cache);
+  *gui_size += gimp_boundary_cache_get_memsize (channel->segs_out_cache);
 
   return GIMP_OBJECT_CLASS (parent_class)->get_memsize (object, gui_size);
 }
@@ -901,29 +908,30 @@ gimp_channel_convert_type (GimpDrawable     *drawable,
 {
   GeglBuffer *dest_buffer;
 
+  /*  an image-wide conversion may have done the work already  */
   dest_buffer =
-    gegl_buffer_new (GEGL_RECTANGLE (0, 0,
-                                     gimp_item_get_width  (GIMP_ITEM (drawable)),
-                                     gimp_item_get_height (GIMP_ITEM (drawable))),
-                     new_format);
+    gimp_image_executor_take (gimp_item_get_image (GIMP_ITEM (drawable)),
+                              drawable,
+                              gimp_item_get_width  (GIMP_ITEM (drawable)),
+                              gimp_item_get_height (GIMP_ITEM (drawable)),
+                              new_format);
 
-  if (mask_dither_type == GEGL_DITHER_NONE)
+  if (dest_buffer)
     {
-      gimp_gegl_buffer_copy (gimp_drawable_get_buffer (drawable), NULL,
-                             GEGL_ABYSS_NONE,
-                             dest_buffer, NULL);
+      gimp_drawable_set_buffer (drawable, push_undo, NULL, dest_buffer);
+      g_object_unref (dest_buffer);
+
+      return;
     }
-  else
-    {
-      gint bits;
 
-      bits = (babl_format_get_bytes_per_pixel (new_format) * 8 /
-              babl_format_get_n_components (new_format));
+  dest_buffer =
+    gegl_buffer_new (GEGL_RECTANGLE (0, 0,
+                                     gimp_item_get_width  (GIMP_ITEM (drawable)),
+                                     gimp_item_get_height (GIMP_ITEM (drawable))),
+                     new_format);
 
-      gimp_gegl_apply_dither (gimp_drawable_get_buffer (drawable),
-                              NULL, NULL,
-                              dest_buffer, 1 << bits, mask_dither_type);
-    }
+  gimp_channel_convert_buffer (gimp_drawable_get_buffer (drawable),
+                               dest_buffer, mask_dither_type);
 
   gimp_drawable_set_buffer (drawable, push_undo, NULL, dest_buffer);
   g_object_unref (dest_buffer);
@@ -964,6 +972,9 @@ gimp_channel_set_buffer (GimpDrawable        *drawable,
                                             channel);
     }
 
+  gimp_boundary_cache_invalidate (channel->segs_in_cache,  NULL);
+  gimp_boundary_cache_invalidate (channel->segs_out_cache, NULL);
+
   GIMP_DRAWABLE_CLASS (parent_class)->set_buffer (drawable,
                                                   push_undo, undo_desc,
                                                   buffer, bounds);
@@ -1042,12 +1053,17 @@ gimp_channel_real_boundary (GimpChannel         *channel,
 
           buffer = gimp_drawable_get_buffer (GIMP_DRAWABLE (channel));
 
-          channel->segs_out = gimp_boundary_find (buffer, &rect,
-                                                  babl_format ("Y float"),
-                                                  GIMP_BOUNDARY_IGNORE_BOUNDS,
-                                                  x1, y1, x2, y2,
-                                                  GIMP_BOUNDARY_HALF_WAY,
-                                                  &channel->num_segs_out);
+          /*  only the scanlines which changed since the last time
+           *  are scanned again, as long as the bounds are the same
+           */
+          channel->segs_out =
+            gimp_boundary_cache_find (channel->segs_out_cache,
+                                      buffer, &rect,
+                                      babl_format ("Y float"),
+                                      GIMP_BOUNDARY_IGNORE_BOUNDS,
+                                      x1, y1, x2, y2,
+                                      GIMP_BOUNDARY_HALF_WAY,
+                                      &channel->num_segs_out);
           x1 = MAX (x1, x3);
           y1 = MAX (y1, y3);
           x2 = MIN (x2, x4);
@@ -1055,12 +1071,14 @@ gimp_channel_real_boundary (GimpChannel         *channel,
 
           if (x2 > x1 && y2 > y1)
             {
-              channel->segs_in = gimp_boundary_find (buffer, NULL,
-                                                     babl_format ("Y float"),
-                                                     GIMP_BOUNDARY_WITHIN_BOUNDS,
-                                                     x1, y1, x2, y2,
-                                                     GIMP_BOUNDARY_HALF_WAY,
-                                                     &channel->num_segs_in);
+              channel->segs_in =
+                gimp_boundary_cache_find (channel->segs_in_cache,
+                                          buffer, NULL,
+                                          babl_format ("Y float"),
+                                          GIMP_BOUNDARY_WITHIN_BOUNDS,
+                                          x1, y1, x2, y2,
+                                          GIMP_BOUNDARY_HALF_WAY,
+                                          &channel->num_segs_in);
             }
           else
             {
@@ -1506,6 +1524,9 @@ gimp_channel_buffer_changed (GeglBuffer          *buffer,
                              const GeglRectangle *rect,
                              GimpChannel         *channel)
 {
+  gimp_boundary_cache_invalidate (channel->segs_in_cache,  rect);
+  gimp_boundary_cache_invalidate (channel->segs_out_cache, rect);
+
   gimp_drawable_invalidate_boundary (GIMP_DRAWABLE (channel));
 }
 
@@ -1638,6 +1659,43 @@ gimp_channel_new_from_component (GimpImage       *image,
   return channel;
 }
 
+/**
+ * gimp_channel_convert_buffer:
+ * @src_buffer:  the channel's pixels
+ * @dest_buffer: the buffer to write the converted pixels to
+ * @dither_type: the dither method to reduce @src_buffer to the bit
+ *               depth of @dest_buffer with
+ *
+ * Converts a channel's pixels to the format of @dest_buffer, the way
+ * gimp_drawable_convert_type() converts a channel.  Doesn't touch any
+ * item, so it may run on a worker thread.
+ **/
+void
+gimp_channel_convert_buffer (GeglBuffer       *src_buffer,
+                             GeglBuffer       *dest_buffer,
+                             GeglDitherMethod  dither_type)
+{
+  g_return_if_fail (GEGL_IS_BUFFER (src_buffer));
+  g_return_if_fail (GEGL_IS_BUFFER (dest_buffer));
+
+  if (dither_type == GEGL_DITHER_NONE)
+    {
+      gimp_gegl_buffer_copy (src_buffer, NULL, GEGL_ABYSS_NONE,
+                             dest_buffer, NULL);
+    }
+  else
+    {
+      const Babl *format = gegl_buffer_get_format (dest_buffer);
+      gint        bits;
+
+      bits = (babl_format_get_bytes_per_pixel (format) * 8 /
+              babl_format_get_n_components (format));
+
+      gimp_gegl_apply_dither (src_buffer, NULL, NULL,
+                              dest_buffer, 1 << bits, dither_type);
+    }
+}
+
 GimpChannel *
 gimp_channel_get_parent (GimpChannel *channel)
 {
@@ -33,26 +33,28 @@ typedef struct _GimpChannelClass GimpChannelClass;
 
 struct _GimpChannel
 {
-  GimpDrawable  parent_instance;
+  GimpDrawable       parent_instance;
 
-  GeglColor    *color;             /*  Also stores the opacity        */
-  gboolean      show_masked;       /*  Show masked areas--as          */
-                                   /*  opposed to selected areas      */
+  GeglColor         *color;          /*  Also stores the opacity        */
+  gboolean           show_masked;    /*  Show masked areas--as          */
+                                     /*  opposed to selected areas      */
 
-  GeglNode     *color_node;
-  GeglNode     *invert_node;
-  GeglNode     *mask_node;
+  GeglNode          *color_node;
+  GeglNode          *invert_node;
+  GeglNode          *mask_node;
 
   /*  Selection mask variables  */
-  gboolean      boundary_known;    /*  is the current boundary valid  */
-  GimpBoundSeg *segs_in;           /*  outline of selected region     */
-  GimpBoundSeg *segs_out;          /*  outline of selected region     */
-  gint          num_segs_in;       /*  number of lines in boundary    */
-  gint          num_segs_out;      /*  number of lines in boundary    */
-  gboolean      empty;             /*  is the region empty?           */
-  gboolean      bounds_known;      /*  recalculate the bounds?        */
-  gint          x1, y1;            /*  coordinates for bounding box   */
-  gint          x2, y2;            /*  lower right hand coordinate    */
+  gboolean           boundary_known; /*  is the current boundary valid  */
+  GimpBoundSeg      *segs_in;        /*  outline of selected region     */
+  GimpBoundSeg      *segs_out;       /*  outline of selected region     */
+  gint               num_segs_in;    /*  number of lines in boundary    */
+  gint               num_segs_out;   /*  number of lines in boundary    */
+  GimpBoundaryCache *segs_in_cache;  /*  scanned scanlines of segs_in   */
+  GimpBoundaryCache *segs_out_cache; /*  scanned scanlines of segs_out  */
+  gboolean           empty;          /*  is the region empty?           */
+  gboolean           bounds_known;   /*  recalculate the bounds?        */
+  gint               x1, y1;         /*  coordinates for bounding box   */
+  gint               x2, y2;         /*  lower right hand coordinate    */
 };
 
 struct _GimpChannelClass
@@ -141,6 +143,10 @@ GimpChannel * gimp_channel_new_from_component (GimpImage         *image,
                                                const gchar       *name,
                                                GeglColor         *color);
 
+void          gimp_channel_convert_buffer     (GeglBuffer        *src_buffer,
+                                               GeglBuffer        *dest_buffer,
+                                               GeglDitherMethod   dither_type);
+
 GimpChannel * gimp_channel_get_parent         (GimpChannel       *channel);
 
 gdouble       gimp_channel_get_opacity        (GimpChannel       *channel);
@@ -32,6 +32,7 @@
 #include "operations/layer-modes/gimp-layer-modes.h"
 
 #include "gimp.h"
+#include "gimp-memsize.h"
 #include "gimpchannel.h"
 #include "gimpcontext.h"
 #include "gimpdrawable-gradient.h"
@@ -42,6 +43,40 @@
 #include "gimp-intl.h"
 
 
+#define SHAPEBURST_CACHE_KEY "gimp-drawable-gradient-shapeburst-cache"
+
+
+/*  the last distance map of a drawable, so that repeated shapeburst
+ *  gradients, and the gradient tool's preview, don't recompute it.  it
+ *  is a single full-size float buffer, counted in the drawable's
+ *  memsize, and it is dropped as soon as its source changes or the
+ *  drawable is removed from its image.
+ */
+typedef struct
+{
+  GimpDrawable       *drawable;
+  GimpChannel        *mask;
+  GeglRectangle       region;
+  gint                off_x;
+  gint                off_y;
+  GeglDistanceMetric  metric;
+  GeglBuffer         *dist_buffer;
+} ShapeburstCache;
+
+
+/*  local function prototypes  */
+
+static ShapeburstCache *
+             gimp_drawable_gradient_shapeburst_cache_new  (GimpDrawable        *drawable,
+                                                           GimpChannel         *mask,
+                                                           const GeglRectangle *region,
+                                                           gint                 off_x,
+                                                           gint                 off_y,
+                                                           gboolean             use_alpha);
+static void  gimp_drawable_gradient_shapeburst_cache_free (ShapeburstCache     *cache);
+static void  gimp_drawable_gradient_shapeburst_cache_drop (ShapeburstCache     *cache);
+
+
 /*  public functions  */
 
 void
@@ -154,88 +189,105 @@ gimp_drawable_gradient_shapeburst_distmap (GimpDrawable        *drawable,
                                            const GeglRectangle *region,
                                            GimpProgress        *progress)
 {
-  GimpChannel *mask;
-  GimpImage   *image;
-  GeglBuffer  *dist_buffer;
-  GeglBuffer  *temp_buffer;
-  GeglNode    *shapeburst;
+  ShapeburstCache *cache;
+  GimpChannel     *mask;
+  GimpImage       *image;
+  GeglBuffer      *dist_buffer;
+  GeglBuffer      *src_buffer = NULL;
+  GeglRectangle    src_rect   = *region;
+  const Babl      *src_format = NULL;
+  gboolean         use_alpha  = FALSE;
+  gint             off_x, off_y;
 
   g_return_val_if_fail (GIMP_IS_DRAWABLE (drawable), NULL);
   g_return_val_if_fail (gimp_item_is_attached (GIMP_ITEM (drawable)), NULL);
   g_return_val_if_fail (progress == NULL || GIMP_IS_PROGRESS (progress), NULL);
 
   image = gimp_item_get_image (GIMP_ITEM (drawable));
+  mask  = gimp_image_get_mask (image);
 
-  /*  allocate the distance map  */
-  dist_buffer = gegl_buffer_new (region, babl_format ("Y float"));
+  gimp_item_get_offset (GIMP_ITEM (drawable), &off_x, &off_y);
 
-  /*  allocate the selection mask copy  */
-  temp_buffer = gegl_buffer_new (region, babl_format ("Y float"));
+  cache = g_object_get_data (G_OBJECT (drawable), SHAPEBURST_CACHE_KEY);
 
-  mask = gimp_image_get_mask (image);
+  if (cache                                         &&
+      (cache->mask != mask                          ||
+       ! gegl_rectangle_equal (&cache->region, region) ||
+       cache->off_x != off_x                        ||
+       cache->off_y != off_y))
+    {
+      g_object_set_data (G_OBJECT (drawable), SHAPEBURST_CACHE_KEY, NULL);
+      cache = NULL;
+    }
+
+  if (cache && cache->metric == metric)
+    return g_object_ref (cache->dist_buffer);
 
   /*  If the image mask is not empty, use it as the shape burst source  */
   if (! gimp_channel_is_empty (mask))
     {
       gint x, y, width, height;
-      gint off_x, off_y;
 
       gimp_item_mask_intersect (GIMP_ITEM (drawable), &x, &y, &width, &height);
-      gimp_item_get_offset (GIMP_ITEM (drawable), &off_x, &off_y);
 
-      /*  copy the mask to the temp mask  */
-      gimp_gegl_buffer_copy (
-        gimp_drawable_get_buffer (GIMP_DRAWABLE (mask)),
-        GEGL_RECTANGLE (x + off_x, y + off_y, width, height),
-        GEGL_ABYSS_NONE, temp_buffer, region);
+      src_buffer = gimp_drawable_get_buffer (GIMP_DRAWABLE (mask));
+      gegl_rectangle_set (&src_rect, x + off_x, y + off_y, width, height);
     }
-  else
+  /*  If the intended drawable has an alpha channel, use that  */
+  else if (gimp_drawable_has_alpha (drawable))
     {
-      /*  If the intended drawable has an alpha channel, use that  */
-      if (gimp_drawable_has_alpha (drawable))
-        {
-          const Babl *component_format;
-
-          component_format = babl_format ("A float");
-
-          /*  extract the alpha into the temp mask  */
-          gegl_buffer_set_format (temp_buffer, component_format);
-          gimp_gegl_buffer_copy (gimp_drawable_get_buffer (drawable), region,
-                                 GEGL_ABYSS_NONE,
-                                 temp_buffer, region);
-          gegl_buffer_set_format (temp_buffer, NULL);
-        }
-      else
-        {
-          GeglColor *white = gegl_color_new ("white");
-
-          /*  Otherwise, just fill the shapeburst to white  */
-          gegl_buffer_set_color (temp_buffer, NULL, white);
-          g_object_unref (white);
-        }
+      src_buffer = gimp_drawable_get_buffer (drawable);
+      src_format = babl_format ("A float");
+      use_alpha  = TRUE;
     }
+  /*  Otherwise, the whole region is the shapeburst source  */
 
-  shapeburst = gegl_node_new_child (NULL,
-                                    "operation", "gegl:distance-transform",
-                                    "normalize", TRUE,
-                                    "metric",    metric,
-                                    NULL);
+  /*  allocate the distance map  */
+  dist_buffer = gegl_buffer_new (region, babl_format ("Y float"));
 
   if (progress)
-    gimp_gegl_progress_connect (shapeburst, progress,
-                                _("Calculating distance map"));
+    {
+      if (gimp_progress_is_active (progress))
+        gimp_progress_set_text (progress, "%s", _("Calculating distance map"));
+      else
+        gimp_progress_start (progress, FALSE, "%s", _("Calculating distance map"));
+    }
 
-  gimp_gegl_apply_operation (temp_buffer, NULL, NULL,
-                             shapeburst,
-                             dist_buffer, region, FALSE);
+  gimp_gegl_distance_transform (src_buffer, &src_rect, src_format,
+                                dist_buffer, region,
+                                metric, TRUE, progress);
+
+  if (progress)
+    gimp_progress_end (progress);
 
-  g_object_unref (shapeburst);
+  if (! cache)
+    cache = gimp_drawable_gradient_shapeburst_cache_new (drawable, mask,
+                                                         region,
+                                                         off_x, off_y,
+                                                         use_alpha);
 
-  g_object_unref (temp_buffer);
+  /*  keep only the map of the last metric  */
+  g_set_object (&cache->dist_buffer, dist_buffer);
+  cache->metric = metric;
 
   return dist_buffer;
 }
 
+gint64
+gimp_drawable_gradient_get_memsize (GimpDrawable *drawable)
+{
+  ShapeburstCache *cache;
+
+  g_return_val_if_fail (GIMP_IS_DRAWABLE (drawable), 0);
+
+  cache = g_object_get_data (G_OBJECT (drawable), SHAPEBURST_CACHE_KEY);
+
+  if (cache)
+    return gimp_gegl_buffer_get_memsize (cache->dist_buffer);
+
+  return 0;
+}
+
 void
 gimp_drawable_gradient_adjust_coords (GimpDrawable        *drawable,
                                       GimpGradientType     gradient_type,
@@ -311,3 +363,75 @@ gimp_drawable_gradient_adjust_coords (GimpDrawable        *drawable,
       break;
     }
 }
+
+
+/*  private functions  */
+
+static ShapeburstCache *
+gimp_drawable_gradient_shapeburst_cache_new (GimpDrawable        *drawable,
+                                             GimpChannel         *mask,
+                                             const GeglRectangle *region,
+                                             gint                 off_x,
+                                             gint                 off_y,
+                                             gboolean             use_alpha)
+{
+  ShapeburstCache *cache = g_slice_new0 (ShapeburstCache);
+
+  cache->drawable = drawable;
+  cache->mask     = mask;
+  cache->region   = *region;
+  cache->off_x    = off_x;
+  cache->off_y    = off_y;
+
+  g_object_add_weak_pointer (G_OBJECT (mask), (gpointer) &cache->mask);
+
+  /*  any change of the selection may change the source  */
+  g_signal_connect_swapped (mask, "update",
+                            G_CALLBACK (gimp_drawable_gradient_shapeburst_cache_drop),
+                            cache);
+
+  g_signal_connect_swapped (drawable, "alpha-changed",
+                            G_CALLBACK (gimp_drawable_gradient_shapeburst_cache_drop),
+                            cache);
+  g_signal_connect_swapped (drawable, "removed",
+                            G_CALLBACK (gimp_drawable_gradient_shapeburst_cache_drop),
+                            cache);
+
+  /*  the drawable's pixels only matter when its alpha is the source  */
+  if (use_alpha)
+    g_signal_connect_swapped (drawable, "update",
+                              G_CALLBACK (gimp_drawable_gradient_shapeburst_cache_drop),
+                              cache);
+
+  g_object_set_data_full (G_OBJECT (drawable), SHAPEBURST_CACHE_KEY, cache,
+                          (GDestroyNotify) gimp_drawable_gradient_shapeburst_cache_free);
+
+  return cache;
+}
+
+static void
+gimp_drawable_gradient_shapeburst_cache_free (ShapeburstCache *cache)
+{
+  g_signal_handlers_disconnect_by_func (cache->drawable,
+                                        gimp_drawable_gradient_shapeburst_cache_drop,
+                                        cache);
+
+  if (cache->mask)
+    {
+      g_signal_handlers_disconnect_by_func (cache->mask,
+                                            gimp_drawable_gradient_shapeburst_cache_drop,
+                                            cache);
+      g_object_remove_weak_pointer (G_OBJECT (cache->mask),
+                                    (gpointer) &cache->mask);
+    }
+
+  g_clear_object (&cache->dist_buffer);
+
+  g_slice_free (ShapeburstCache, cache);
+}
+
+static void
+gimp_drawable_gradient_shapeburst_cache_drop (ShapeburstCache *cache)
+{
+  g_object_set_data (G_OBJECT (cache->drawable), SHAPEBURST_CACHE_KEY, NULL);
+}
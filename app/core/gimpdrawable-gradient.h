@@ -45,6 +45,8 @@ GeglBuffer * gimp_drawable_gradient_shapeburst_distmap (GimpDrawable
                                                         const GeglRectangle         *region,
                                                         GimpProgress                *progress);
 
+gint64       gimp_drawable_gradient_get_memsize        (GimpDrawable                *drawable);
+
 void         gimp_drawable_gradient_adjust_coords      (GimpDrawable                *drawable,
                                                         GimpGradientType             gradient_type,
                                                         const GeglRectangle         *region,
@@ -226,12 +226,13 @@ gimp_drawable_get_sub_preview (GimpDrawable *drawable,
   scaled_x = RINT ((gdouble) src_x * scale);
   scaled_y = RINT ((gdouble) src_y * scale);
 
-  gegl_buffer_get (buffer,
-                   GEGL_RECTANGLE (scaled_x, scaled_y, dest_width, dest_height),
-                   scale,
-                   gimp_temp_buf_get_format (preview),
-                   gimp_temp_buf_get_data (preview),
-                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_CLAMP);
+  gimp_gegl_buffer_get_scaled (buffer,
+                               GEGL_RECTANGLE (scaled_x, scaled_y,
+                                               dest_width, dest_height),
+                               scale,
+                               gimp_temp_buf_get_format (preview),
+                               gimp_temp_buf_get_data (preview),
+                               GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_CLAMP);
   g_object_unref (buffer);
 
   return preview;
@@ -295,13 +296,13 @@ gimp_drawable_get_sub_pixbuf (GimpDrawable *drawable,
       temp_buf = gimp_temp_buf_new (dest_width, dest_height,
                                     gimp_drawable_get_format (drawable));
 
-      gegl_buffer_get (buffer,
-                       GEGL_RECTANGLE (scaled_x, scaled_y,
-                                       dest_width, dest_height),
-                       scale,
-                       gimp_temp_buf_get_format (temp_buf),
-                       gimp_temp_buf_get_data (temp_buf),
-                       GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_CLAMP);
+      gimp_gegl_buffer_get_scaled (buffer,
+                                   GEGL_RECTANGLE (scaled_x, scaled_y,
+                                                   dest_width, dest_height),
+                                   scale,
+                                   gimp_temp_buf_get_format (temp_buf),
+                                   gimp_temp_buf_get_data (temp_buf),
+                                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_CLAMP);
 
       src_buf  = gimp_temp_buf_create_buffer (temp_buf);
       dest_buf = gimp_pixbuf_create_buffer (pixbuf);
@@ -320,14 +321,14 @@ gimp_drawable_get_sub_pixbuf (GimpDrawable *drawable,
     }
   else
     {
-      gegl_buffer_get (buffer,
-                       GEGL_RECTANGLE (scaled_x, scaled_y,
-                                       dest_width, dest_height),
-                       scale,
-                       gimp_pixbuf_get_format (pixbuf),
-                       gdk_pixbuf_get_pixels (pixbuf),
-                       gdk_pixbuf_get_rowstride (pixbuf),
-                       GEGL_ABYSS_CLAMP);
+      gimp_gegl_buffer_get_scaled (buffer,
+                                   GEGL_RECTANGLE (scaled_x, scaled_y,
+                                                   dest_width, dest_height),
+                                   scale,
+                                   gimp_pixbuf_get_format (pixbuf),
+                                   gdk_pixbuf_get_pixels (pixbuf),
+                                   gdk_pixbuf_get_rowstride (pixbuf),
+                                   GEGL_ABYSS_CLAMP);
     }
 
   g_object_unref (buffer);
@@ -389,10 +390,10 @@ gimp_drawable_get_sub_preview_async_func (GimpAsync      *async,
       data->iter = NULL;
     }
 
-  gegl_buffer_get (data->buffer, &data->rect, data->scale,
-                   gimp_temp_buf_get_format (preview),
-                   gimp_temp_buf_get_data (preview),
-                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_CLAMP);
+  gimp_gegl_buffer_get_scaled (data->buffer, &data->rect, data->scale,
+                               gimp_temp_buf_get_format (preview),
+                               gimp_temp_buf_get_data (preview),
+                               GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_CLAMP);
 
   sub_preview_data_free (data);
 
@@ -408,7 +409,8 @@ gimp_drawable_get_sub_preview_async (GimpDrawable *drawable,
                                      gint          src_width,
                                      gint          src_height,
                                      gint          dest_width,
-                                     gint          dest_height)
+                                     gint          dest_height,
+                                     gint          priority)
 {
   GimpItem       *item;
   GimpImage      *image;
@@ -485,7 +487,7 @@ gimp_drawable_get_sub_preview_async (GimpDrawable *drawable,
   else
     {
       return gimp_parallel_run_async_full (
-        +1,
+        priority,
         (GimpRunAsyncFunc) gimp_drawable_get_sub_preview_async_func,
         data,
         (GDestroyNotify) sub_preview_data_free);
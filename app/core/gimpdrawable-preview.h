@@ -57,7 +57,8 @@ GimpAsync   * gimp_drawable_get_sub_preview_async (GimpDrawable *drawable,
                                                    gint          src_width,
                                                    gint          src_height,
                                                    gint          dest_width,
-                                                   gint          dest_height);
+                                                   gint          dest_height,
+                                                   gint          priority);
 
 
 #endif /* __GIMP_DRAWABLE__PREVIEW_H__ */
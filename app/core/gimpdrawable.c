@@ -41,6 +41,7 @@
 #include "gimpdrawable-fill.h"
 #include "gimpdrawable-filters.h"
 #include "gimpdrawable-floating-selection.h"
+#include "gimpdrawable-gradient.h"
 #include "gimpdrawable-preview.h"
 #include "gimpdrawable-private.h"
 #include "gimpdrawable-shadow.h"
@@ -49,6 +50,7 @@
 #include "gimpfilterstack.h"
 #include "gimpimage.h"
 #include "gimpimage-colormap.h"
+#include "gimpimage-executor.h"
 #include "gimpimage-undo-push.h"
 #include "gimplayer.h"
 #include "gimpmarshal.h"
@@ -434,6 +436,7 @@ gimp_drawable_get_memsize (GimpObject *object,
 
   memsize += gimp_gegl_buffer_get_memsize (gimp_drawable_get_buffer (drawable));
   memsize += gimp_gegl_buffer_get_memsize (drawable->private->shadow);
+  memsize += gimp_drawable_gradient_get_memsize (drawable);
 
   return memsize + GIMP_OBJECT_CLASS (parent_class)->get_memsize (object,
                                                                   gui_size);
@@ -550,18 +553,26 @@ gimp_drawable_scale (GimpItem              *item,
   GimpDrawable *drawable = GIMP_DRAWABLE (item);
   GeglBuffer   *new_buffer;
 
-  new_buffer = gegl_buffer_new (GEGL_RECTANGLE (0, 0,
-                                                new_width, new_height),
-                                gimp_drawable_get_format (drawable));
+  /*  an image-wide scale may have done the work already  */
+  new_buffer = gimp_image_executor_take (gimp_item_get_image (item), drawable,
+                                         new_width, new_height,
+                                         gimp_drawable_get_format (drawable));
 
-  gimp_gegl_apply_scale (gimp_drawable_get_buffer (drawable),
-                         progress, C_("undo-type", "Scale"),
-                         new_buffer,
-                         interpolation_type,
-                         ((gdouble) new_width /
-                          gimp_item_get_width  (item)),
-                         ((gdouble) new_height /
-                          gimp_item_get_height (item)));
+  if (! new_buffer)
+    {
+      new_buffer = gegl_buffer_new (GEGL_RECTANGLE (0, 0,
+                                                    new_width, new_height),
+                                    gimp_drawable_get_format (drawable));
+
+      gimp_gegl_apply_scale (gimp_drawable_get_buffer (drawable),
+                             progress, C_("undo-type", "Scale"),
+                             new_buffer,
+                             interpolation_type,
+                             ((gdouble) new_width /
+                              gimp_item_get_width  (item)),
+                             ((gdouble) new_height /
+                              gimp_item_get_height (item)));
+    }
 
   gimp_drawable_set_buffer_full (drawable, gimp_item_is_attached (item), NULL,
                                  new_buffer,
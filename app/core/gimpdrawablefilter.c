@@ -46,6 +46,16 @@
 #include "gimpimage.h"
 #include "gimplayer.h"
 #include "gimpprogress.h"
+#include "gimpprojection.h"
+
+#include "gimp-priorities.h"
+
+
+/*  the pixel count above which a progressive preview is first rendered
+ *  at a reduced level, and the lowest level it is rendered at
+ */
+#define PREVIEW_MAX_PIXELS (512 * 512)
+#define PREVIEW_MAX_LEVEL  3
 
 
 enum
@@ -90,12 +100,19 @@ struct _GimpDrawableFilter
 
   gboolean                override_constraints;
 
+  gboolean                progressive;
+  gint                    preview_level;
+  GeglRectangle           refine_area;
+  guint                   refine_idle_id;
+
   GeglRectangle           filter_area;
   gboolean                filter_clip;
 
   GeglNode               *translate;
   GeglNode               *crop_before;
   GeglNode               *cast_before;
+  GeglNode               *scale_before;
+  GeglNode               *scale_after;
   GeglNode               *cast_after;
   GeglNode               *crop_after;
   GimpApplicator         *applicator;
@@ -130,12 +147,24 @@ static void       gimp_drawable_filter_sync_affect           (GimpDrawableFilter
 static void       gimp_drawable_filter_sync_format           (GimpDrawableFilter  *filter);
 static void       gimp_drawable_filter_sync_mask             (GimpDrawableFilter  *filter);
 static void       gimp_drawable_filter_sync_gamma_hack       (GimpDrawableFilter  *filter);
+static void       gimp_drawable_filter_sync_preview_level    (GimpDrawableFilter  *filter);
 
 static gboolean   gimp_drawable_filter_is_added              (GimpDrawableFilter  *filter);
 static gboolean   gimp_drawable_filter_is_active             (GimpDrawableFilter  *filter);
 static gboolean   gimp_drawable_filter_add_filter            (GimpDrawableFilter  *filter);
 static gboolean   gimp_drawable_filter_remove_filter         (GimpDrawableFilter  *filter);
 
+static gboolean   gimp_drawable_filter_get_update_area       (GimpDrawableFilter  *filter,
+                                                              const GeglRectangle *area,
+                                                              GeglRectangle       *update_area);
+static void       gimp_drawable_filter_update_rect           (GimpDrawableFilter  *filter,
+                                                              const GeglRectangle *rect);
+static void       gimp_drawable_filter_update_progressive    (GimpDrawableFilter  *filter,
+                                                              const GeglRectangle *area);
+static void       gimp_drawable_filter_set_preview_level     (GimpDrawableFilter  *filter,
+                                                              gint                 level);
+static void       gimp_drawable_filter_stop_refine           (GimpDrawableFilter  *filter);
+static gboolean   gimp_drawable_filter_refine_idle           (GimpDrawableFilter  *filter);
 static void       gimp_drawable_filter_update_drawable       (GimpDrawableFilter  *filter,
                                                               const GeglRectangle *area);
 
@@ -250,6 +279,8 @@ gimp_drawable_filter_dispose (GObject *object)
 {
   GimpDrawableFilter *drawable_filter = GIMP_DRAWABLE_FILTER (object);
 
+  gimp_drawable_filter_stop_refine (drawable_filter);
+
   if (drawable_filter->drawable)
     gimp_drawable_filter_remove_filter (drawable_filter);
 
@@ -325,14 +356,23 @@ gimp_drawable_filter_new (GimpDrawable *drawable,
                                                  "operation", "gegl:nop",
                                                  NULL);
 
+      filter->scale_before = gegl_node_new_child (node,
+                                                  "operation", "gegl:nop",
+                                                  NULL);
+
       gegl_node_link_many (input,
                            filter->translate,
                            filter->crop_before,
                            filter->cast_before,
+                           filter->scale_before,
                            filter->operation,
                            NULL);
     }
 
+  filter->scale_after = gegl_node_new_child (node,
+                                             "operation", "gegl:nop",
+                                             NULL);
+
   filter->cast_after = gegl_node_new_child (node,
                                             "operation", "gegl:nop",
                                             NULL);
@@ -342,6 +382,7 @@ gimp_drawable_filter_new (GimpDrawable *drawable,
                                             NULL);
 
   gegl_node_link_many (filter->operation,
+                       filter->scale_after,
                        filter->cast_after,
                        filter->crop_after,
                        NULL);
@@ -755,6 +796,31 @@ gimp_drawable_filter_set_override_constraints (GimpDrawableFilter *filter,
     }
 }
 
+/* In progressive mode, gimp_drawable_filter_apply() first renders the
+ * visible part of large areas at a reduced level, then refines the
+ * whole area at full resolution once the projection is idle.
+ */
+void
+gimp_drawable_filter_set_progressive (GimpDrawableFilter *filter,
+                                      gboolean            progressive)
+{
+  g_return_if_fail (GIMP_IS_DRAWABLE_FILTER (filter));
+
+  if (progressive != filter->progressive)
+    {
+      filter->progressive = progressive;
+
+      if (! progressive && filter->preview_level > 0)
+        {
+          gimp_drawable_filter_stop_refine (filter);
+          gimp_drawable_filter_set_preview_level (filter, 0);
+
+          if (gimp_drawable_filter_is_active (filter))
+            gimp_drawable_filter_update_drawable (filter, NULL);
+        }
+    }
+}
+
 const Babl *
 gimp_drawable_filter_get_format (GimpDrawableFilter *filter)
 {
@@ -784,7 +850,10 @@ gimp_drawable_filter_apply (GimpDrawableFilter  *filter,
     {
       gimp_drawable_update_bounding_box (filter->drawable);
 
-      gimp_drawable_filter_update_drawable (filter, area);
+      if (filter->progressive && filter->has_input)
+        gimp_drawable_filter_update_progressive (filter, area);
+      else
+        gimp_drawable_filter_update_drawable (filter, area);
     }
 }
 
@@ -846,6 +915,10 @@ gimp_drawable_filter_commit (GimpDrawableFilter *filter,
       g_object_add_weak_pointer (G_OBJECT (filter), (gpointer) &filter);
       format = gimp_drawable_filter_get_format (filter);
 
+      /* never commit a reduced level preview */
+      gimp_drawable_filter_stop_refine (filter);
+      gimp_drawable_filter_set_preview_level (filter, 0);
+
       gimp_drawable_filter_set_preview_split (filter, FALSE,
                                               filter->preview_split_alignment,
                                               filter->preview_split_position);
@@ -1361,6 +1434,39 @@ gimp_drawable_filter_sync_gamma_hack (GimpDrawableFilter *filter)
     }
 }
 
+static void
+gimp_drawable_filter_sync_preview_level (GimpDrawableFilter *filter)
+{
+  if (filter->preview_level > 0)
+    {
+      gdouble factor = 1 << filter->preview_level;
+
+      gegl_node_set (filter->scale_before,
+                     "operation", "gegl:scale-ratio",
+                     "x",         1.0 / factor,
+                     "y",         1.0 / factor,
+                     "sampler",   GEGL_SAMPLER_LINEAR,
+                     NULL);
+
+      gegl_node_set (filter->scale_after,
+                     "operation", "gegl:scale-ratio",
+                     "x",         factor,
+                     "y",         factor,
+                     "sampler",   GEGL_SAMPLER_LINEAR,
+                     NULL);
+    }
+  else
+    {
+      gegl_node_set (filter->scale_before,
+                     "operation", "gegl:nop",
+                     NULL);
+
+      gegl_node_set (filter->scale_after,
+                     "operation", "gegl:nop",
+                     NULL);
+    }
+}
+
 static gboolean
 gimp_drawable_filter_is_added (GimpDrawableFilter *filter)
 {
@@ -1444,6 +1550,9 @@ gimp_drawable_filter_remove_filter (GimpDrawableFilter *filter)
       GimpImage    *image    = gimp_item_get_image (GIMP_ITEM (filter->drawable));
       GimpDrawable *drawable = filter->drawable;
 
+      gimp_drawable_filter_stop_refine (filter);
+      gimp_drawable_filter_set_preview_level (filter, 0);
+
       if (GIMP_IS_LAYER (drawable))
         g_signal_handlers_disconnect_by_func (drawable,
                                               gimp_drawable_filter_lock_alpha_changed,
@@ -1476,21 +1585,21 @@ gimp_drawable_filter_remove_filter (GimpDrawableFilter *filter)
   return FALSE;
 }
 
-static void
-gimp_drawable_filter_update_drawable (GimpDrawableFilter  *filter,
-                                      const GeglRectangle *area)
+static gboolean
+gimp_drawable_filter_get_update_area (GimpDrawableFilter  *filter,
+                                      const GeglRectangle *area,
+                                      GeglRectangle       *update_area)
 {
   GeglRectangle bounding_box;
-  GeglRectangle update_area;
 
   bounding_box = gimp_drawable_get_bounding_box (filter->drawable);
 
   if (area)
     {
-      if (! gegl_rectangle_intersect (&update_area,
+      if (! gegl_rectangle_intersect (update_area,
                                       area, &bounding_box))
         {
-          return;
+          return FALSE;
         }
     }
   else
@@ -1501,28 +1610,150 @@ gimp_drawable_filter_update_drawable (GimpDrawableFilter  *filter,
                                           filter->preview_split_enabled,
                                           filter->preview_split_alignment,
                                           filter->preview_split_position,
-                                          &update_area);
+                                          update_area);
+
+      if (! gegl_rectangle_intersect (update_area,
+                                      update_area, &bounding_box))
+        {
+          return FALSE;
+        }
+    }
+
+  return update_area->width > 0 && update_area->height > 0;
+}
 
-      if (! gegl_rectangle_intersect (&update_area,
-                                      &update_area, &bounding_box))
+static void
+gimp_drawable_filter_update_rect (GimpDrawableFilter  *filter,
+                                  const GeglRectangle *rect)
+{
+  gimp_drawable_update (filter->drawable,
+                        rect->x,
+                        rect->y,
+                        rect->width,
+                        rect->height);
+
+  g_signal_emit (filter, drawable_filter_signals[FLUSH], 0);
+}
+
+static void
+gimp_drawable_filter_update_progressive (GimpDrawableFilter  *filter,
+                                         const GeglRectangle *area)
+{
+  GimpImage     *image = gimp_item_get_image (GIMP_ITEM (filter->drawable));
+  GeglRectangle  update_area;
+  GeglRectangle  visible_area;
+  GeglRectangle  priority_rect;
+  gint           level = 0;
+
+  if (! gimp_drawable_filter_get_update_area (filter, area, &update_area))
+    return;
+
+  visible_area = update_area;
+
+  /*  the priority rect is the viewport, in image coordinates  */
+  if (gimp_projection_get_priority_rect (gimp_image_get_projection (image),
+                                         &priority_rect))
+    {
+      gint off_x, off_y;
+
+      gimp_item_get_offset (GIMP_ITEM (filter->drawable), &off_x, &off_y);
+
+      priority_rect.x -= off_x;
+      priority_rect.y -= off_y;
+
+      if (! gegl_rectangle_intersect (&visible_area,
+                                      &visible_area, &priority_rect))
         {
-          return;
+          visible_area.width  = 0;
+          visible_area.height = 0;
         }
     }
 
-  if (update_area.width  > 0 &&
-      update_area.height > 0)
+  while (level < PREVIEW_MAX_LEVEL &&
+         (gint64) (visible_area.width  >> level) *
+                  (visible_area.height >> level) > PREVIEW_MAX_PIXELS)
     {
-      gimp_drawable_update (filter->drawable,
-                            update_area.x,
-                            update_area.y,
-                            update_area.width,
-                            update_area.height);
+      level++;
+    }
+
+  /*  a pending refine covers the areas of the previous applies  */
+  if (filter->refine_idle_id)
+    gegl_rectangle_bounding_box (&update_area,
+                                 &update_area, &filter->refine_area);
+
+  gimp_drawable_filter_stop_refine (filter);
+
+  if (level > 0)
+    {
+      gimp_drawable_filter_set_preview_level (filter, level);
+
+      if (visible_area.width > 0 && visible_area.height > 0)
+        gimp_drawable_filter_update_rect (filter, &visible_area);
+
+      /*  the projection renders the visible area in chunks, and merges
+       *  chunks not rendered yet with the next update, so a refine
+       *  superseded by a new apply is never rendered
+       */
+      filter->refine_area    = update_area;
+      filter->refine_idle_id =
+        g_idle_add_full (GIMP_PRIORITY_DRAWABLE_FILTER_REFINE_IDLE,
+                         (GSourceFunc) gimp_drawable_filter_refine_idle,
+                         filter, NULL);
+    }
+  else
+    {
+      gimp_drawable_filter_set_preview_level (filter, 0);
 
-      g_signal_emit (filter, drawable_filter_signals[FLUSH], 0);
+      gimp_drawable_filter_update_rect (filter, &update_area);
     }
 }
 
+static void
+gimp_drawable_filter_set_preview_level (GimpDrawableFilter *filter,
+                                        gint                level)
+{
+  if (level != filter->preview_level)
+    {
+      filter->preview_level = level;
+
+      if (filter->has_input)
+        gimp_drawable_filter_sync_preview_level (filter);
+    }
+}
+
+static void
+gimp_drawable_filter_stop_refine (GimpDrawableFilter *filter)
+{
+  if (filter->refine_idle_id)
+    {
+      g_source_remove (filter->refine_idle_id);
+      filter->refine_idle_id = 0;
+    }
+}
+
+static gboolean
+gimp_drawable_filter_refine_idle (GimpDrawableFilter *filter)
+{
+  filter->refine_idle_id = 0;
+
+  gimp_drawable_filter_set_preview_level (filter, 0);
+
+  if (gimp_drawable_filter_is_active (filter))
+    gimp_drawable_filter_update_rect (filter, &filter->refine_area);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+gimp_drawable_filter_update_drawable (GimpDrawableFilter  *filter,
+                                      const GeglRectangle *area)
+{
+  GeglRectangle update_area;
+
+  if (gimp_drawable_filter_get_update_area (filter, area, &update_area))
+    gimp_drawable_filter_update_rect (filter, &update_area);
+}
+
 static void
 gimp_drawable_filter_affect_changed (GimpImage          *image,
                                      GimpChannelType     channel,
@@ -109,6 +109,9 @@ void       gimp_drawable_filter_set_gamma_hack (GimpDrawableFilter  *filter,
 void       gimp_drawable_filter_set_override_constraints
                                                (GimpDrawableFilter  *filter,
                                                 gboolean             override_constraints);
+void       gimp_drawable_filter_set_progressive
+                                               (GimpDrawableFilter  *filter,
+                                                gboolean             progressive);
 
 const Babl *
            gimp_drawable_filter_get_format     (GimpDrawableFilter  *filter);
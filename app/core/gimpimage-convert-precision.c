@@ -30,6 +30,7 @@
 #include "core-types.h"
 
 #include "gegl/gimp-babl.h"
+#include "gegl/gimp-gegl-apply-operation.h"
 #include "gegl/gimp-gegl-loops.h"
 
 #include "gimpchannel.h"
@@ -38,8 +39,10 @@
 #include "gimpimage.h"
 #include "gimpimage-color-profile.h"
 #include "gimpimage-convert-precision.h"
+#include "gimpimage-executor.h"
 #include "gimpimage-undo.h"
 #include "gimpimage-undo-push.h"
+#include "gimplayer.h"
 #include "gimpobjectqueue.h"
 #include "gimpprogress.h"
 
@@ -48,6 +51,36 @@
 #include "gimp-intl.h"
 
 
+typedef struct
+{
+  gboolean          layer;
+  GeglDitherMethod  dither_type;
+  GimpColorProfile *profile;
+} ConvertJob;
+
+
+/*  local function prototypes  */
+
+static void   gimp_image_convert_precision_add_jobs (GimpImage         *image,
+                                                     GimpImageExecutor *executor,
+                                                     GimpPrecision      precision,
+                                                     GimpColorProfile  *profile,
+                                                     GeglDitherMethod   layer_dither_type,
+                                                     GeglDitherMethod   mask_dither_type);
+static void   gimp_image_convert_precision_add_job  (GimpImageExecutor *executor,
+                                                     GimpDrawable      *drawable,
+                                                     const Babl        *new_format,
+                                                     gboolean           layer,
+                                                     GeglDitherMethod   dither_type,
+                                                     GimpColorProfile  *profile);
+static void   gimp_image_convert_precision_run_job  (GeglBuffer        *src_buffer,
+                                                     GeglBuffer        *dest_buffer,
+                                                     ConvertJob        *job);
+static void   gimp_image_convert_precision_job_free (ConvertJob        *job);
+
+
+/*  public functions  */
+
 void
 gimp_image_convert_precision (GimpImage        *image,
                               GimpPrecision     precision,
@@ -56,13 +89,14 @@ gimp_image_convert_precision (GimpImage        *image,
                               GeglDitherMethod  mask_dither_type,
                               GimpProgress     *progress)
 {
-  GimpColorProfile *profile;
-  GimpObjectQueue  *queue;
-  GimpProgress     *sub_progress;
-  GList            *layers;
-  GimpDrawable     *drawable;
-  const gchar      *enum_desc;
-  gchar            *undo_desc = NULL;
+  GimpColorProfile  *profile;
+  GimpObjectQueue   *queue;
+  GimpImageExecutor *executor;
+  GimpProgress      *sub_progress;
+  GList             *layers;
+  GimpDrawable      *drawable;
+  const gchar       *enum_desc;
+  gchar             *undo_desc = NULL;
 
   g_return_if_fail (GIMP_IS_IMAGE (image));
   g_return_if_fail (precision != gimp_image_get_precision (image));
@@ -110,6 +144,14 @@ gimp_image_convert_precision (GimpImage        *image,
   /*  Set the new precision  */
   g_object_set (image, "precision", precision, NULL);
 
+  /*  Start converting the drawables' pixels concurrently; the items
+   *  below pick up the results as the queue gets to them
+   */
+  executor = gimp_image_executor_new (image);
+
+  gimp_image_convert_precision_add_jobs (image, executor, precision, profile,
+                                         layer_dither_type, mask_dither_type);
+
   while ((drawable = gimp_object_queue_pop (queue)))
     {
       if (drawable == GIMP_DRAWABLE (gimp_image_get_mask (image)))
@@ -119,14 +161,22 @@ gimp_image_convert_precision (GimpImage        *image,
           gimp_image_undo_push_mask_precision (image, NULL,
                                                GIMP_CHANNEL (drawable));
 
-          buffer = gegl_buffer_new (GEGL_RECTANGLE (0, 0,
-                                                    gimp_image_get_width  (image),
-                                                    gimp_image_get_height (image)),
-                                    gimp_image_get_mask_format (image));
+          buffer = gimp_image_executor_take (image, drawable,
+                                             gimp_image_get_width  (image),
+                                             gimp_image_get_height (image),
+                                             gimp_image_get_mask_format (image));
 
-          gimp_gegl_buffer_copy (gimp_drawable_get_buffer (drawable), NULL,
-                                 GEGL_ABYSS_NONE,
-                                 buffer, NULL);
+          if (! buffer)
+            {
+              buffer = gegl_buffer_new (GEGL_RECTANGLE (0, 0,
+                                                        gimp_image_get_width  (image),
+                                                        gimp_image_get_height (image)),
+                                        gimp_image_get_mask_format (image));
+
+              gimp_gegl_buffer_copy (gimp_drawable_get_buffer (drawable), NULL,
+                                     GEGL_ABYSS_NONE,
+                                     buffer, NULL);
+            }
 
           gimp_drawable_set_buffer (drawable, FALSE, NULL, buffer);
           g_object_unref (buffer);
@@ -153,6 +203,8 @@ gimp_image_convert_precision (GimpImage        *image,
         }
     }
 
+  gimp_image_executor_free (executor);
+
   gimp_color_managed_profile_changed (GIMP_COLOR_MANAGED (image));
 
   gimp_image_set_converting (image, FALSE);
@@ -228,3 +280,146 @@ gimp_image_convert_dither_u8 (GimpImage    *image,
       g_object_unref (dither);
     }
 }
+
+
+/*  private functions  */
+
+static void
+gimp_image_convert_precision_add_jobs (GimpImage         *image,
+                                       GimpImageExecutor *executor,
+                                       GimpPrecision      precision,
+                                       GimpColorProfile  *profile,
+                                       GeglDitherMethod   layer_dither_type,
+                                       GeglDitherMethod   mask_dither_type)
+{
+  const Babl *space = NULL;
+  GList      *layers;
+  GList      *list;
+
+  /*  same as gimp_layer_convert_type()  */
+  if (profile)
+    space = gimp_color_profile_get_space (profile,
+                                          GIMP_COLOR_RENDERING_INTENT_RELATIVE_COLORIMETRIC,
+                                          NULL);
+
+  layers = gimp_image_get_layer_list (image);
+
+  for (list = layers; list; list = g_list_next (list))
+    {
+      GimpDrawable *drawable = list->data;
+      GimpLayer    *layer    = list->data;
+
+      /*  group layers convert their own way, and unmodified text
+       *  layers are rendered again instead of being converted
+       */
+      if (! gimp_viewable_get_children (GIMP_VIEWABLE (layer)) &&
+          ! gimp_item_is_text_layer (GIMP_ITEM (layer)))
+        {
+          const Babl *format;
+
+          format = gimp_image_get_format (image,
+                                          gimp_drawable_get_base_type (drawable),
+                                          precision,
+                                          gimp_drawable_has_alpha (drawable),
+                                          NULL);
+          format = babl_format_with_space ((const gchar *) format, space);
+
+          gimp_image_convert_precision_add_job (executor, drawable, format,
+                                                TRUE, layer_dither_type,
+                                                profile);
+        }
+
+      if (gimp_layer_get_mask (layer))
+        {
+          drawable = GIMP_DRAWABLE (gimp_layer_get_mask (layer));
+
+          gimp_image_convert_precision_add_job (
+            executor, drawable,
+            gimp_image_get_format (image, GIMP_GRAY, precision,
+                                   gimp_drawable_has_alpha (drawable),
+                                   NULL),
+            FALSE, mask_dither_type, NULL);
+        }
+    }
+
+  g_list_free (layers);
+
+  gimp_image_convert_precision_add_job (executor,
+                                        GIMP_DRAWABLE (gimp_image_get_mask (image)),
+                                        gimp_image_get_mask_format (image),
+                                        FALSE, GEGL_DITHER_NONE, NULL);
+
+  for (list = gimp_image_get_channel_iter (image);
+       list;
+       list = g_list_next (list))
+    {
+      GimpDrawable *drawable = list->data;
+
+      gimp_image_convert_precision_add_job (
+        executor, drawable,
+        gimp_image_get_format (image,
+                               gimp_drawable_get_base_type (drawable),
+                               precision,
+                               gimp_drawable_has_alpha (drawable),
+                               NULL),
+        FALSE, mask_dither_type, NULL);
+    }
+}
+
+static void
+gimp_image_convert_precision_add_job (GimpImageExecutor *executor,
+                                      GimpDrawable      *drawable,
+                                      const Babl        *new_format,
+                                      gboolean           layer,
+                                      GeglDitherMethod   dither_type,
+                                      GimpColorProfile  *profile)
+{
+  const Babl *old_format = gimp_drawable_get_format (drawable);
+  ConvertJob *job;
+  gint        old_bits;
+  gint        new_bits;
+
+  /*  same as gimp_drawable_convert_type()  */
+  old_bits = (babl_format_get_bytes_per_pixel (old_format) * 8 /
+              babl_format_get_n_components (old_format));
+  new_bits = (babl_format_get_bytes_per_pixel (new_format) * 8 /
+              babl_format_get_n_components (new_format));
+
+  if (old_bits <= new_bits || new_bits > 16)
+    dither_type = GEGL_DITHER_NONE;
+
+  job = g_slice_new (ConvertJob);
+
+  job->layer       = layer;
+  job->dither_type = dither_type;
+  job->profile     = profile ? g_object_ref (profile) : NULL;
+
+  gimp_image_executor_add (executor, drawable,
+                           gimp_item_get_width  (GIMP_ITEM (drawable)),
+                           gimp_item_get_height (GIMP_ITEM (drawable)),
+                           new_format,
+                           (GimpImageExecutorFunc) gimp_image_convert_precision_run_job,
+                           job,
+                           (GDestroyNotify) gimp_image_convert_precision_job_free);
+}
+
+static void
+gimp_image_convert_precision_run_job (GeglBuffer *src_buffer,
+                                      GeglBuffer *dest_buffer,
+                                      ConvertJob *job)
+{
+  if (job->layer)
+    gimp_layer_convert_buffer (src_buffer, job->profile,
+                               dest_buffer, job->profile,
+                               job->dither_type, NULL);
+  else
+    gimp_channel_convert_buffer (src_buffer, dest_buffer, job->dither_type);
+}
+
+static void
+gimp_image_convert_precision_job_free (ConvertJob *job)
+{
+  g_clear_object (&job->profile);
+
+  g_slice_free (ConvertJob, job);
+}
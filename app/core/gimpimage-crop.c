@@ -111,7 +111,13 @@ gimp_image_crop (GimpImage    *image,
                     context, GIMP_FILL_TRANSPARENT,
                     width, height, -x, -y);
 
-  /*  crop all layers  */
+  /*  crop all layers
+   *
+   *  unlike scaling and precision conversion, this is not run through
+   *  GimpImageExecutor: resizing a drawable only fills the new area
+   *  with a constant and copies the kept tiles copy-on-write, so
+   *  there is no per-pixel work to spread over threads.
+   */
   list = gimp_image_get_layer_iter (image);
 
   while (list)
@@ -121,7 +121,11 @@ gimp_image_duplicate (GimpImage *image)
   /*  Copy the colormap if necessary  */
   gimp_image_duplicate_colormap (image, new_image);
 
-  /*  Copy the layers  */
+  /*  Copy the layers.  Drawable buffers are duplicated with
+   *  gimp_gegl_buffer_dup(), which shares all tiles copy-on-write
+   *  with the original, so this costs no pixel memory until either
+   *  image is modified.
+   */
   active_layers = gimp_image_duplicate_layers (image, new_image);
 
   /*  Copy the channels  */
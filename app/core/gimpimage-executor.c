@@ -0,0 +1,326 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimpimage-executor.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <gdk-pixbuf/gdk-pixbuf.h>
+#include <gegl.h>
+
+#include "core-types.h"
+
+#include "config/gimpgeglconfig.h"
+
+#include "gimp.h"
+#include "gimp-parallel.h"
+#include "gimpasync.h"
+#include "gimpdrawable.h"
+#include "gimpimage.h"
+#include "gimpimage-executor.h"
+#include "gimpimage-private.h"
+#include "gimpwaitable.h"
+
+
+/* GimpImageExecutor computes the new pixels of an image-wide operation's
+ * drawables ahead of time, on worker threads, while the operation itself
+ * still walks its items in order on the main thread.
+ *
+ * The operation adds a job for each drawable it is going to process,
+ * in processing order, naming the size and format of the buffer the
+ * drawable will end up with.  When the drawable's own code gets to
+ * that point, it calls gimp_image_executor_take(), which returns the
+ * precomputed buffer if the job matches, waiting for it if necessary.
+ * Undo pushes, signal emission and progress reporting all remain on
+ * the main thread, in the same order as before.
+ *
+ * Finished buffers that weren't taken yet count against a memory
+ * budget; no more jobs are started while the budget is exhausted,
+ * except that there is always at least one job in flight.
+ */
+
+
+typedef struct
+{
+  GimpDrawable          *drawable;
+  GeglBuffer            *src_buffer;
+  GeglBuffer            *dest_buffer;
+  gint64                 memsize;
+
+  GimpImageExecutorFunc  func;
+  gpointer               data;
+  GDestroyNotify         data_destroy_func;
+
+  GimpAsync             *async;
+} Job;
+
+struct _GimpImageExecutor
+{
+  GimpImage *image;
+
+  GQueue     pending;
+  GQueue     active;
+
+  gint       max_active;
+  gint64     memsize;
+  gint64     max_memsize;
+};
+
+
+/*  local function prototypes  */
+
+static GList * gimp_image_executor_find     (GQueue            *queue,
+                                             GimpDrawable      *drawable);
+static void    gimp_image_executor_schedule (GimpImageExecutor *executor);
+
+static void    gimp_image_executor_run_job  (GimpAsync         *async,
+                                             Job               *job);
+static void    gimp_image_executor_job_free (Job               *job);
+
+
+/*  public functions  */
+
+GimpImageExecutor *
+gimp_image_executor_new (GimpImage *image)
+{
+  GimpImagePrivate  *private;
+  GimpImageExecutor *executor;
+  GimpGeglConfig    *config;
+
+  g_return_val_if_fail (GIMP_IS_IMAGE (image), NULL);
+
+  private = GIMP_IMAGE_GET_PRIVATE (image);
+
+  g_return_val_if_fail (private->executor == NULL, NULL);
+
+  config = GIMP_GEGL_CONFIG (image->gimp->config);
+
+  executor = g_slice_new0 (GimpImageExecutor);
+
+  executor->image       = image;
+  executor->max_active  = MAX (config->num_processors, 1);
+  executor->max_memsize = config->tile_cache_size / 2;
+
+  g_queue_init (&executor->pending);
+  g_queue_init (&executor->active);
+
+  private->executor = executor;
+
+  return executor;
+}
+
+void
+gimp_image_executor_free (GimpImageExecutor *executor)
+{
+  GimpImagePrivate *private;
+  Job              *job;
+
+  g_return_if_fail (executor != NULL);
+
+  private = GIMP_IMAGE_GET_PRIVATE (executor->image);
+
+  g_return_if_fail (private->executor == executor);
+
+  while ((job = g_queue_pop_head (&executor->pending)))
+    gimp_image_executor_job_free (job);
+
+  while ((job = g_queue_pop_head (&executor->active)))
+    gimp_image_executor_job_free (job);
+
+  private->executor = NULL;
+
+  g_slice_free (GimpImageExecutor, executor);
+}
+
+void
+gimp_image_executor_add (GimpImageExecutor     *executor,
+                         GimpDrawable          *drawable,
+                         gint                   width,
+                         gint                   height,
+                         const Babl            *format,
+                         GimpImageExecutorFunc  func,
+                         gpointer               data,
+                         GDestroyNotify         data_destroy_func)
+{
+  Job *job;
+
+  g_return_if_fail (executor != NULL);
+  g_return_if_fail (GIMP_IS_DRAWABLE (drawable));
+  g_return_if_fail (width > 0 && height > 0);
+  g_return_if_fail (format != NULL);
+  g_return_if_fail (func != NULL);
+
+  job = g_slice_new0 (Job);
+
+  job->drawable          = g_object_ref (drawable);
+  job->src_buffer        = g_object_ref (gimp_drawable_get_buffer (drawable));
+  job->dest_buffer       = gegl_buffer_new (GEGL_RECTANGLE (0, 0,
+                                                            width, height),
+                                            format);
+  job->memsize           = (gint64) width * height *
+                           babl_format_get_bytes_per_pixel (format);
+  job->func              = func;
+  job->data              = data;
+  job->data_destroy_func = data_destroy_func;
+
+  g_queue_push_tail (&executor->pending, job);
+
+  gimp_image_executor_schedule (executor);
+}
+
+GeglBuffer *
+gimp_image_executor_take (GimpImage    *image,
+                          GimpDrawable *drawable,
+                          gint          width,
+                          gint          height,
+                          const Babl   *format)
+{
+  GimpImageExecutor *executor;
+  GQueue            *queue;
+  GList             *list;
+  Job               *job;
+  GeglBuffer        *buffer;
+
+  g_return_val_if_fail (GIMP_IS_IMAGE (image), NULL);
+  g_return_val_if_fail (GIMP_IS_DRAWABLE (drawable), NULL);
+
+  executor = GIMP_IMAGE_GET_PRIVATE (image)->executor;
+
+  if (! executor)
+    return NULL;
+
+  queue = &executor->active;
+  list  = gimp_image_executor_find (queue, drawable);
+
+  if (! list)
+    {
+      queue = &executor->pending;
+      list  = gimp_image_executor_find (queue, drawable);
+    }
+
+  if (! list)
+    return NULL;
+
+  job = list->data;
+
+  g_queue_delete_link (queue, list);
+
+  if (job->async)
+    executor->memsize -= job->memsize;
+
+  if (gegl_buffer_get_width  (job->dest_buffer) != width  ||
+      gegl_buffer_get_height (job->dest_buffer) != height ||
+      gegl_buffer_get_format (job->dest_buffer) != format ||
+      gimp_drawable_get_buffer (drawable)       != job->src_buffer)
+    {
+      /*  the drawable's own code decided differently, or the drawable
+       *  changed since the job was added; let the caller do its thing
+       */
+      gimp_image_executor_job_free (job);
+      gimp_image_executor_schedule (executor);
+
+      return NULL;
+    }
+
+  if (job->async)
+    gimp_waitable_wait (GIMP_WAITABLE (job->async));
+  else
+    job->func (job->src_buffer, job->dest_buffer, job->data);
+
+  buffer = g_steal_pointer (&job->dest_buffer);
+
+  gimp_image_executor_job_free (job);
+  gimp_image_executor_schedule (executor);
+
+  return buffer;
+}
+
+
+/*  private functions  */
+
+static GList *
+gimp_image_executor_find (GQueue       *queue,
+                          GimpDrawable *drawable)
+{
+  GList *list;
+
+  for (list = queue->head; list; list = g_list_next (list))
+    {
+      Job *job = list->data;
+
+      if (job->drawable == drawable)
+        return list;
+    }
+
+  return NULL;
+}
+
+static void
+gimp_image_executor_schedule (GimpImageExecutor *executor)
+{
+  Job *job;
+
+  while ((job = g_queue_peek_head (&executor->pending)))
+    {
+      if (! g_queue_is_empty (&executor->active))
+        {
+          if (executor->active.length >= executor->max_active ||
+              executor->memsize + job->memsize > executor->max_memsize)
+            {
+              break;
+            }
+        }
+
+      g_queue_push_tail (&executor->active,
+                         g_queue_pop_head (&executor->pending));
+
+      executor->memsize += job->memsize;
+
+      job->async = gimp_parallel_run_async (
+        (GimpRunAsyncFunc) gimp_image_executor_run_job,
+        job);
+    }
+}
+
+static void
+gimp_image_executor_run_job (GimpAsync *async,
+                             Job       *job)
+{
+  job->func (job->src_buffer, job->dest_buffer, job->data);
+
+  gimp_async_finish (async, NULL);
+}
+
+static void
+gimp_image_executor_job_free (Job *job)
+{
+  if (job->async)
+    {
+      gimp_waitable_wait (GIMP_WAITABLE (job->async));
+
+      g_object_unref (job->async);
+    }
+
+  if (job->data_destroy_func)
+    job->data_destroy_func (job->data);
+
+  g_clear_object (&job->dest_buffer);
+  g_object_unref (job->src_buffer);
+  g_object_unref (job->drawable);
+
+  g_slice_free (Job, job);
+}
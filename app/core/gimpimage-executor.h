@@ -0,0 +1,48 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimpimage-executor.h
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GIMP_IMAGE_EXECUTOR_H__
+#define __GIMP_IMAGE_EXECUTOR_H__
+
+
+typedef void (* GimpImageExecutorFunc) (GeglBuffer *src_buffer,
+                                        GeglBuffer *dest_buffer,
+                                        gpointer    data);
+
+
+GimpImageExecutor * gimp_image_executor_new    (GimpImage             *image);
+void                gimp_image_executor_free   (GimpImageExecutor     *executor);
+
+void                gimp_image_executor_add    (GimpImageExecutor     *executor,
+                                                GimpDrawable          *drawable,
+                                                gint                   width,
+                                                gint                   height,
+                                                const Babl            *format,
+                                                GimpImageExecutorFunc  func,
+                                                gpointer               data,
+                                                GDestroyNotify         data_destroy_func);
+
+GeglBuffer        * gimp_image_executor_take   (GimpImage             *image,
+                                                GimpDrawable          *drawable,
+                                                gint                   width,
+                                                gint                   height,
+                                                const Babl            *format);
+
+
+#endif /* __GIMP_IMAGE_EXECUTOR_H__ */
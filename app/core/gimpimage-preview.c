@@ -138,12 +138,12 @@ gimp_image_get_new_preview (GimpViewable *viewable,
 
   buf = gimp_temp_buf_new (width, height, format);
 
-  gegl_buffer_get (gimp_pickable_get_buffer (GIMP_PICKABLE (image)),
-                   GEGL_RECTANGLE (0, 0, width, height),
-                   MIN (scale_x, scale_y),
-                   gimp_temp_buf_get_format (buf),
-                   gimp_temp_buf_get_data (buf),
-                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_CLAMP);
+  gimp_gegl_buffer_get_scaled (gimp_pickable_get_buffer (GIMP_PICKABLE (image)),
+                               GEGL_RECTANGLE (0, 0, width, height),
+                               MIN (scale_x, scale_y),
+                               gimp_temp_buf_get_format (buf),
+                               gimp_temp_buf_get_data (buf),
+                               GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_CLAMP);
 
   return buf;
 }
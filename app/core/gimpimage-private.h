@@ -71,6 +71,8 @@ struct _GimpImagePrivate
 
   gboolean           converting;            /*  color model or profile in middle of conversion?  */
 
+  GimpImageExecutor *executor;              /*  concurrent item processing   */
+
   /*  Cached color transforms: from layer to sRGB u8 and double, and back    */
   gboolean            color_transforms_created;
   GimpColorTransform *transform_to_srgb_u8;
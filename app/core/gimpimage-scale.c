@@ -20,13 +20,17 @@
 #include <gdk-pixbuf/gdk-pixbuf.h>
 #include <gegl.h>
 
+#include "libgimpmath/gimpmath.h"
+
 #include "core-types.h"
 
 #include "gimp.h"
+#include "gimpchannel.h"
 #include "gimpcontainer.h"
 #include "gimpguide.h"
 #include "gimpgrouplayer.h"
 #include "gimpimage.h"
+#include "gimpimage-executor.h"
 #include "gimpimage-guides.h"
 #include "gimpimage-sample-points.h"
 #include "gimpimage-scale.h"
@@ -38,10 +42,40 @@
 #include "gimpprojection.h"
 #include "gimpsamplepoint.h"
 
+#include "gegl/gimp-gegl-apply-operation.h"
+
 #include "gimp-log.h"
 #include "gimp-intl.h"
 
 
+typedef struct
+{
+  GimpInterpolationType interpolation_type;
+  gdouble               x_factor;
+  gdouble               y_factor;
+} ScaleJob;
+
+
+/*  local function prototypes  */
+
+static void   gimp_image_scale_add_jobs  (GimpImage             *image,
+                                          GimpImageExecutor     *executor,
+                                          gdouble                w_factor,
+                                          gdouble                h_factor,
+                                          GimpInterpolationType  interpolation_type);
+static void   gimp_image_scale_add_job   (GimpImageExecutor     *executor,
+                                          GimpDrawable          *drawable,
+                                          gdouble                w_factor,
+                                          gdouble                h_factor,
+                                          GimpInterpolationType  interpolation_type);
+static void   gimp_image_scale_run_job   (GeglBuffer            *src_buffer,
+                                          GeglBuffer            *dest_buffer,
+                                          ScaleJob              *job);
+static void   gimp_image_scale_job_free  (ScaleJob              *job);
+
+
+/*  public functions  */
+
 void
 gimp_image_scale (GimpImage             *image,
                   gint                   new_width,
@@ -49,15 +83,16 @@ gimp_image_scale (GimpImage             *image,
                   GimpInterpolationType  interpolation_type,
                   GimpProgress          *progress)
 {
-  GimpObjectQueue *queue;
-  GimpItem        *item;
-  GList           *list;
-  gint             old_width;
-  gint             old_height;
-  gint             offset_x;
-  gint             offset_y;
-  gdouble          img_scale_w = 1.0;
-  gdouble          img_scale_h = 1.0;
+  GimpObjectQueue   *queue;
+  GimpImageExecutor *executor;
+  GimpItem          *item;
+  GList             *list;
+  gint               old_width;
+  gint               old_height;
+  gint               offset_x;
+  gint               offset_y;
+  gdouble            img_scale_w = 1.0;
+  gdouble            img_scale_h = 1.0;
 
   g_return_if_fail (GIMP_IS_IMAGE (image));
   g_return_if_fail (new_width > 0 && new_height > 0);
@@ -86,6 +121,14 @@ gimp_image_scale (GimpImage             *image,
   offset_x = (old_width  - new_width)  / 2;
   offset_y = (old_height - new_height) / 2;
 
+  /*  Start scaling the drawables' pixels concurrently; the items
+   *  below pick up the results as the queue gets to them
+   */
+  executor = gimp_image_executor_new (image);
+
+  gimp_image_scale_add_jobs (image, executor,
+                             img_scale_w, img_scale_h, interpolation_type);
+
   /*  Push the image size to the stack  */
   gimp_image_undo_push_image_size (image,
                                    NULL,
@@ -166,6 +209,7 @@ gimp_image_scale (GimpImage             *image,
 
   gimp_image_undo_group_end (image);
 
+  gimp_image_executor_free (executor);
   g_object_unref (queue);
 
   gimp_image_size_changed_detailed (image,
@@ -209,7 +253,6 @@ gimp_image_scale_check (GimpImage *image,
   GList  *list;
   gint64  current_size;
   gint64  undo_size;
-  gint64  redo_size;
   gint64  new_size;
 
   g_return_val_if_fail (GIMP_IS_IMAGE (image), GIMP_IMAGE_SCALE_TOO_SMALL);
@@ -221,11 +264,13 @@ gimp_image_scale_check (GimpImage *image,
                                           gimp_image_get_component_type (image),
                                           new_width, new_height);
 
-  undo_size = gimp_object_get_memsize (GIMP_OBJECT (gimp_image_get_undo_stack (image)), NULL);
-  redo_size = gimp_object_get_memsize (GIMP_OBJECT (gimp_image_get_redo_stack (image)), NULL);
+  /*  counted as part of current_size, i.e. without the tiles the
+   *  undo and redo stacks share with the drawables
+   */
+  undo_size = gimp_image_get_undo_memsize (image);
 
-  current_size -= undo_size + redo_size;
-  new_size     -= undo_size + redo_size;
+  current_size -= undo_size;
+  new_size     -= undo_size;
 
   GIMP_LOG (IMAGE_SCALE,
             "old_size = %"G_GINT64_FORMAT"  new_size = %"G_GINT64_FORMAT,
@@ -258,3 +303,120 @@ gimp_image_scale_check (GimpImage *image,
 
   return GIMP_IMAGE_SCALE_OK;
 }
+
+
+/*  private functions  */
+
+static void
+gimp_image_scale_add_jobs (GimpImage             *image,
+                           GimpImageExecutor     *executor,
+                           gdouble                w_factor,
+                           gdouble                h_factor,
+                           GimpInterpolationType  interpolation_type)
+{
+  GList *layers;
+  GList *list;
+
+  /*  add the jobs in the order the items are scaled below: layers
+   *  (and their masks), the selection mask, then the channels
+   */
+  layers = gimp_image_get_layer_list (image);
+
+  for (list = layers; list; list = g_list_next (list))
+    {
+      GimpLayer *layer = list->data;
+
+      /*  group layers are scaled through their children  */
+      if (! gimp_viewable_get_children (GIMP_VIEWABLE (layer)))
+        gimp_image_scale_add_job (executor, GIMP_DRAWABLE (layer),
+                                  w_factor, h_factor, interpolation_type);
+
+      if (gimp_layer_get_mask (layer))
+        gimp_image_scale_add_job (executor,
+                                  GIMP_DRAWABLE (gimp_layer_get_mask (layer)),
+                                  w_factor, h_factor, interpolation_type);
+    }
+
+  g_list_free (layers);
+
+  gimp_image_scale_add_job (executor,
+                            GIMP_DRAWABLE (gimp_image_get_mask (image)),
+                            w_factor, h_factor, interpolation_type);
+
+  for (list = gimp_image_get_channel_iter (image);
+       list;
+       list = g_list_next (list))
+    {
+      gimp_image_scale_add_job (executor, list->data,
+                                w_factor, h_factor, interpolation_type);
+    }
+}
+
+static void
+gimp_image_scale_add_job (GimpImageExecutor     *executor,
+                          GimpDrawable          *drawable,
+                          gdouble                w_factor,
+                          gdouble                h_factor,
+                          GimpInterpolationType  interpolation_type)
+{
+  GimpItem *item = GIMP_ITEM (drawable);
+  ScaleJob *job;
+  gint      offset_x;
+  gint      offset_y;
+  gint      new_offset_x;
+  gint      new_offset_y;
+  gint      new_width;
+  gint      new_height;
+
+  /*  empty channels aren't scaled at all, see gimp_channel_scale()  */
+  if (GIMP_IS_CHANNEL (drawable) &&
+      GIMP_CHANNEL (drawable)->bounds_known &&
+      GIMP_CHANNEL (drawable)->empty)
+    return;
+
+  /*  same as gimp_item_scale_by_factors()  */
+  gimp_item_get_offset (item, &offset_x, &offset_y);
+
+  new_offset_x = SIGNED_ROUND (w_factor * offset_x);
+  new_offset_y = SIGNED_ROUND (h_factor * offset_y);
+  new_width    = SIGNED_ROUND (w_factor * (offset_x +
+                                           gimp_item_get_width (item))) -
+                 new_offset_x;
+  new_height   = SIGNED_ROUND (h_factor * (offset_y +
+                                           gimp_item_get_height (item))) -
+                 new_offset_y;
+
+  if (new_width <= 0 || new_height <= 0)
+    return;
+
+  job = g_slice_new (ScaleJob);
+
+  job->interpolation_type = interpolation_type;
+  job->x_factor           = (gdouble) new_width  / gimp_item_get_width  (item);
+  job->y_factor           = (gdouble) new_height / gimp_item_get_height (item);
+
+  gimp_image_executor_add (executor, drawable,
+                           new_width, new_height,
+                           gimp_drawable_get_format (drawable),
+                           (GimpImageExecutorFunc) gimp_image_scale_run_job,
+                           job,
+                           (GDestroyNotify) gimp_image_scale_job_free);
+}
+
+static void
+gimp_image_scale_run_job (GeglBuffer *src_buffer,
+                          GeglBuffer *dest_buffer,
+                          ScaleJob   *job)
+{
+  gimp_gegl_apply_scale (src_buffer, NULL, NULL,
+                         dest_buffer,
+                         job->interpolation_type,
+                         job->x_factor,
+                         job->y_factor);
+}
+
+static void
+gimp_image_scale_job_free (ScaleJob *job)
+{
+  g_slice_free (ScaleJob, job);
+}
@@ -171,6 +171,9 @@ static void     gimp_image_finalize              (GObject           *object);
 static void     gimp_image_name_changed          (GimpObject        *object);
 static gint64   gimp_image_get_memsize           (GimpObject        *object,
                                                   gint64            *gui_size);
+static gint64   gimp_image_get_content_memsize   (GimpImage         *image,
+                                                  gint64            *gui_size);
+static gint64   gimp_image_get_buffers_memsize   (GimpDrawable      *drawable);
 
 static gboolean gimp_image_get_size              (GimpViewable      *viewable,
                                                   gint              *width,
@@ -1265,6 +1268,34 @@ gimp_image_get_memsize (GimpObject *object,
   GimpImagePrivate *private = GIMP_IMAGE_GET_PRIVATE (image);
   gint64            memsize = 0;
 
+  /*  count tiles shared between drawables, undo steps and
+   *  duplicated images only once
+   */
+  gimp_memsize_shared_tiles_begin ();
+
+  memsize += gimp_image_get_content_memsize (image, gui_size);
+
+  memsize += gimp_object_get_memsize (GIMP_OBJECT (private->undo_stack),
+                                      gui_size);
+  memsize += gimp_object_get_memsize (GIMP_OBJECT (private->redo_stack),
+                                      gui_size);
+
+  gimp_memsize_shared_tiles_end ();
+
+  return memsize + GIMP_OBJECT_CLASS (parent_class)->get_memsize (object,
+                                                                  gui_size);
+}
+
+/*  everything but the undo and redo stacks, which come after it, so that
+ *  tiles they share with the drawables are counted as the drawables'
+ */
+static gint64
+gimp_image_get_content_memsize (GimpImage *image,
+                                gint64    *gui_size)
+{
+  GimpImagePrivate *private = GIMP_IMAGE_GET_PRIVATE (image);
+  gint64            memsize = 0;
+
   memsize += gimp_object_get_memsize (GIMP_OBJECT (private->palette),
                                       gui_size);
 
@@ -1294,13 +1325,28 @@ gimp_image_get_memsize (GimpObject *object,
   memsize += gimp_object_get_memsize (GIMP_OBJECT (private->parasites),
                                       gui_size);
 
-  memsize += gimp_object_get_memsize (GIMP_OBJECT (private->undo_stack),
-                                      gui_size);
-  memsize += gimp_object_get_memsize (GIMP_OBJECT (private->redo_stack),
-                                      gui_size);
+  return memsize;
+}
 
-  return memsize + GIMP_OBJECT_CLASS (parent_class)->get_memsize (object,
-                                                                  gui_size);
+/*  the pixels of a drawable, and of its mask for a layer  */
+static gint64
+gimp_image_get_buffers_memsize (GimpDrawable *drawable)
+{
+  GeglBuffer *buffer = gimp_drawable_get_buffer (drawable);
+  gint64      memsize;
+
+  memsize = gimp_gegl_buffer_get_memsize (buffer);
+
+  if (GIMP_IS_LAYER (drawable) && gimp_layer_get_mask (GIMP_LAYER (drawable)))
+    {
+      GimpLayerMask *mask = gimp_layer_get_mask (GIMP_LAYER (drawable));
+
+      buffer = gimp_drawable_get_buffer (GIMP_DRAWABLE (mask));
+
+      memsize += gimp_gegl_buffer_get_memsize (buffer);
+    }
+
+  return memsize;
 }
 
 static gboolean
@@ -2116,6 +2162,7 @@ gimp_image_estimate_memsize (GimpImage         *image,
   gint64  current_size;
   gint64  scalable_size = 0;
   gint64  scaled_size   = 0;
+  gint64  shared_size   = 0;
   gint64  new_size;
 
   g_return_val_if_fail (GIMP_IS_IMAGE (image), 0);
@@ -2158,6 +2205,32 @@ gimp_image_estimate_memsize (GimpImage         *image,
 
   g_list_free (drawables);
 
+  /*  the image's memsize counts tiles that drawables share copy-on-write
+   *  only once, while the estimates above count them for each drawable.
+   *  Take what they share out of the scalable size, the scaled drawables
+   *  get their own tiles
+   */
+  drawables = gimp_image_item_list_get_list (image,
+                                             GIMP_ITEM_TYPE_LAYERS |
+                                             GIMP_ITEM_TYPE_CHANNELS,
+                                             GIMP_ITEM_SET_ALL);
+
+  drawables = g_list_prepend (drawables, gimp_image_get_mask (image));
+
+  for (list = drawables; list; list = g_list_next (list))
+    shared_size += gimp_image_get_buffers_memsize (list->data);
+
+  gimp_memsize_shared_tiles_begin ();
+
+  for (list = drawables; list; list = g_list_next (list))
+    shared_size -= gimp_image_get_buffers_memsize (list->data);
+
+  gimp_memsize_shared_tiles_end ();
+
+  g_list_free (drawables);
+
+  scalable_size -= shared_size;
+
   scalable_size +=
     gimp_projection_estimate_memsize (gimp_image_get_base_type (image),
                                       gimp_image_get_component_type (image),
@@ -2178,6 +2251,45 @@ gimp_image_estimate_memsize (GimpImage         *image,
   return new_size;
 }
 
+/**
+ * gimp_image_get_undo_memsize:
+ * @image: A #GimpImage.
+ *
+ * Returns the part of the memory size of @image, as returned by
+ * gimp_object_get_memsize(), that its undo and redo stacks hold.
+ * Tiles the stacks share copy-on-write with the image's drawables are
+ * counted as the drawables', not as the stacks'.
+ *
+ * Returns: the memory size of the undo and redo stacks.
+ **/
+gint64
+gimp_image_get_undo_memsize (GimpImage *image)
+{
+  GimpImagePrivate *private;
+  gint64            gui_size = 0;
+  gint64            memsize  = 0;
+
+  g_return_val_if_fail (GIMP_IS_IMAGE (image), 0);
+
+  private = GIMP_IMAGE_GET_PRIVATE (image);
+
+  /*  count the rest of the image first, in the same shared-tiles scope,
+   *  as gimp_image_get_memsize() does
+   */
+  gimp_memsize_shared_tiles_begin ();
+
+  gimp_image_get_content_memsize (image, &gui_size);
+
+  memsize += gimp_object_get_memsize (GIMP_OBJECT (private->undo_stack),
+                                      NULL);
+  memsize += gimp_object_get_memsize (GIMP_OBJECT (private->redo_stack),
+                                      NULL);
+
+  gimp_memsize_shared_tiles_end ();
+
+  return memsize;
+}
+
 GimpImageBaseType
 gimp_image_get_base_type (GimpImage *image)
 {
@@ -120,6 +120,7 @@ gint64          gimp_image_estimate_memsize      (GimpImage          *image,
                                                   GimpComponentType   component_type,
                                                   gint                width,
                                                   gint                height);
+gint64          gimp_image_get_undo_memsize      (GimpImage          *image);
 
 GimpImageBaseType  gimp_image_get_base_type      (GimpImage          *image);
 GimpComponentType  gimp_image_get_component_type (GimpImage          *image);
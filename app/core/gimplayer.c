@@ -49,6 +49,7 @@
 #include "gimpimage-undo.h"
 #include "gimpimage.h"
 #include "gimpimage-color-profile.h"
+#include "gimpimage-executor.h"
 #include "gimplayer-floating-selection.h"
 #include "gimplayer.h"
 #include "gimplayermask.h"
@@ -1734,29 +1735,22 @@ gimp_layer_real_convert_type (GimpLayer        *layer,
                               GimpProgress     *progress)
 {
   GimpDrawable *drawable = GIMP_DRAWABLE (layer);
-  GeglBuffer   *src_buffer;
   GeglBuffer   *dest_buffer;
 
-  if (layer_dither_type == GEGL_DITHER_NONE)
-    {
-      src_buffer = g_object_ref (gimp_drawable_get_buffer (drawable));
-    }
-  else
-    {
-      gint bits;
-
-      src_buffer =
-        gegl_buffer_new (GEGL_RECTANGLE (0, 0,
-                                         gimp_item_get_width  (GIMP_ITEM (layer)),
-                                         gimp_item_get_height (GIMP_ITEM (layer))),
-                         gimp_drawable_get_format (drawable));
+  /*  an image-wide conversion may have done the work already  */
+  dest_buffer =
+    gimp_image_executor_take (gimp_item_get_image (GIMP_ITEM (layer)),
+                              drawable,
+                              gimp_item_get_width  (GIMP_ITEM (layer)),
+                              gimp_item_get_height (GIMP_ITEM (layer)),
+                              new_format);
 
-      bits = (babl_format_get_bytes_per_pixel (new_format) * 8 /
-              babl_format_get_n_components (new_format));
+  if (dest_buffer)
+    {
+      gimp_drawable_set_buffer (drawable, push_undo, NULL, dest_buffer);
+      g_object_unref (dest_buffer);
 
-      gimp_gegl_apply_dither (gimp_drawable_get_buffer (drawable),
-                              NULL, NULL,
-                              src_buffer, 1 << bits, layer_dither_type);
+      return;
     }
 
   dest_buffer =
@@ -1765,26 +1759,15 @@ gimp_layer_real_convert_type (GimpLayer        *layer,
                                      gimp_item_get_height (GIMP_ITEM (layer))),
                      new_format);
 
-  if (dest_profile)
-    {
-      if (! src_profile)
-        src_profile =
-          gimp_color_managed_get_color_profile (GIMP_COLOR_MANAGED (layer));
+  if (dest_profile && ! src_profile)
+    src_profile =
+      gimp_color_managed_get_color_profile (GIMP_COLOR_MANAGED (layer));
 
-      gimp_gegl_convert_color_profile (src_buffer,  NULL, src_profile,
-                                       dest_buffer, NULL, dest_profile,
-                                       GIMP_COLOR_RENDERING_INTENT_PERCEPTUAL,
-                                       TRUE, progress);
-    }
-  else
-    {
-      gimp_gegl_buffer_copy (src_buffer, NULL, GEGL_ABYSS_NONE,
-                             dest_buffer, NULL);
-    }
+  gimp_layer_convert_buffer (gimp_drawable_get_buffer (drawable), src_profile,
+                             dest_buffer, dest_profile,
+                             layer_dither_type, progress);
 
   gimp_drawable_set_buffer (drawable, push_undo, NULL, dest_buffer);
-
-  g_object_unref (src_buffer);
   g_object_unref (dest_buffer);
 }
 
@@ -1860,6 +1843,72 @@ gimp_layer_fix_format_space (GimpLayer *layer,
     }
 }
 
+/**
+ * gimp_layer_convert_buffer:
+ * @src_buffer:   the layer's pixels
+ * @src_profile:  the profile of @src_buffer
+ * @dest_buffer:  the buffer to write the converted pixels to
+ * @dest_profile: (nullable): the profile of @dest_buffer, or %NULL to
+ *                convert without color management
+ * @dither_type:  the dither method to reduce @src_buffer to the bit
+ *                depth of @dest_buffer with
+ * @progress:     (nullable): a #GimpProgress
+ *
+ * Converts a layer's pixels to the format of @dest_buffer, the way
+ * gimp_drawable_convert_type() converts a layer.  Doesn't touch any
+ * item, so it may run on a worker thread.
+ **/
+void
+gimp_layer_convert_buffer (GeglBuffer       *src_buffer,
+                           GimpColorProfile *src_profile,
+                           GeglBuffer       *dest_buffer,
+                           GimpColorProfile *dest_profile,
+                           GeglDitherMethod  dither_type,
+                           GimpProgress     *progress)
+{
+  GeglBuffer *buffer;
+
+  g_return_if_fail (GEGL_IS_BUFFER (src_buffer));
+  g_return_if_fail (GEGL_IS_BUFFER (dest_buffer));
+  g_return_if_fail (dest_profile == NULL ||
+                    GIMP_IS_COLOR_PROFILE (src_profile));
+  g_return_if_fail (progress == NULL || GIMP_IS_PROGRESS (progress));
+
+  if (dither_type == GEGL_DITHER_NONE)
+    {
+      buffer = g_object_ref (src_buffer);
+    }
+  else
+    {
+      const Babl *format = gegl_buffer_get_format (dest_buffer);
+      gint        bits;
+
+      buffer = gegl_buffer_new (gegl_buffer_get_extent (src_buffer),
+                                gegl_buffer_get_format (src_buffer));
+
+      bits = (babl_format_get_bytes_per_pixel (format) * 8 /
+              babl_format_get_n_components (format));
+
+      gimp_gegl_apply_dither (src_buffer, NULL, NULL,
+                              buffer, 1 << bits, dither_type);
+    }
+
+  if (dest_profile)
+    {
+      gimp_gegl_convert_color_profile (buffer,      NULL, src_profile,
+                                       dest_buffer, NULL, dest_profile,
+                                       GIMP_COLOR_RENDERING_INTENT_PERCEPTUAL,
+                                       TRUE, progress);
+    }
+  else
+    {
+      gimp_gegl_buffer_copy (buffer, NULL, GEGL_ABYSS_NONE,
+                             dest_buffer, NULL);
+    }
+
+  g_object_unref (buffer);
+}
+
 GimpLayer *
 gimp_layer_get_parent (GimpLayer *layer)
 {
@@ -151,6 +151,12 @@ GType           gimp_layer_get_type            (void) G_GNUC_CONST;
 void            gimp_layer_fix_format_space    (GimpLayer            *layer,
                                                 gboolean              copy_buffer,
                                                 gboolean              push_undo);
+void            gimp_layer_convert_buffer      (GeglBuffer           *src_buffer,
+                                                GimpColorProfile     *src_profile,
+                                                GeglBuffer           *dest_buffer,
+                                                GimpColorProfile     *dest_profile,
+                                                GeglDitherMethod      dither_type,
+                                                GimpProgress         *progress);
 
 GimpLayer     * gimp_layer_get_parent          (GimpLayer            *layer);
 
@@ -485,6 +485,18 @@ gimp_projection_set_priority_rect (GimpProjection *proj,
   gimp_projection_update_priority_rect (proj);
 }
 
+gboolean
+gimp_projection_get_priority_rect (GimpProjection *proj,
+                                   GeglRectangle  *rect)
+{
+  g_return_val_if_fail (GIMP_IS_PROJECTION (proj), FALSE);
+  g_return_val_if_fail (rect != NULL, FALSE);
+
+  *rect = proj->priv->priority_rect;
+
+  return ! gegl_rectangle_is_empty (rect);
+}
+
 void
 gimp_projection_stop_rendering (GimpProjection *proj)
 {
@@ -66,6 +66,8 @@ void             gimp_projection_set_priority_rect (GimpProjection    *proj,
                                                     gint               y,
                                                     gint               width,
                                                     gint               height);
+gboolean         gimp_projection_get_priority_rect (GimpProjection    *proj,
+                                                    GeglRectangle     *rect);
 
 void             gimp_projection_stop_rendering    (GimpProjection    *proj);
 
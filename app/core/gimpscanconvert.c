@@ -34,6 +34,10 @@
 #include "gimpscanconvert.h"
 
 
+#define PIXELS_PER_THREAD \
+  (/* each thread costs as much as */ 64.0 * 64.0 /* pixels */)
+
+
 struct _GimpScanConvert
 {
   gdouble         ratio_xy;
@@ -56,6 +60,33 @@ struct _GimpScanConvert
   GArray         *path_data;
 };
 
+typedef struct
+{
+  GimpScanConvert *sc;
+  GeglBuffer      *buffer;
+  const Babl      *format;
+  cairo_path_t     path;
+  gint             off_x;
+  gint             off_y;
+  gboolean         replace;
+  gboolean         antialias;
+  gdouble          value;
+} RenderData;
+
+
+/*  local function prototypes  */
+
+static void     gimp_scan_convert_setup       (GimpScanConvert     *sc,
+                                               cairo_t             *cr,
+                                               const cairo_path_t  *path,
+                                               gboolean             antialias);
+static gboolean gimp_scan_convert_get_extents (GimpScanConvert     *sc,
+                                               const cairo_path_t  *path,
+                                               gboolean             antialias,
+                                               GeglRectangle       *extents);
+static void     gimp_scan_convert_render_area (const GeglRectangle *area,
+                                               const RenderData    *data);
+
 
 /*  public functions  */
 
@@ -496,49 +527,237 @@ gimp_scan_convert_render_full (GimpScanConvert *sc,
                                gboolean         antialias,
                                gdouble          value)
 {
-  const Babl         *format;
-  guchar             *shared_buf      = NULL;
-  gsize               shared_buf_size = 0;
-  GeglBufferIterator *iter;
-  GeglRectangle      *roi;
-  cairo_t            *cr;
-  cairo_surface_t    *surface;
-  cairo_path_t        path;
-  gint                bpp;
-  gint                x, y;
-  gint                width, height;
+  RenderData    data;
+  GeglRectangle render_rect;
+  GeglRectangle path_rect;
 
   g_return_if_fail (sc != NULL);
   g_return_if_fail (GEGL_IS_BUFFER (buffer));
 
-  x      = gegl_buffer_get_x      (buffer);
-  y      = gegl_buffer_get_y      (buffer);
-  width  = gegl_buffer_get_width  (buffer);
-  height = gegl_buffer_get_height (buffer);
+  render_rect = *gegl_buffer_get_extent (buffer);
 
-  if (sc->clip && ! gimp_rectangle_intersect (x, y, width, height,
+  if (sc->clip && ! gimp_rectangle_intersect (render_rect.x,
+                                              render_rect.y,
+                                              render_rect.width,
+                                              render_rect.height,
                                               sc->clip_x, sc->clip_y,
                                               sc->clip_w, sc->clip_h,
-                                              &x, &y, &width, &height))
+                                              &render_rect.x,
+                                              &render_rect.y,
+                                              &render_rect.width,
+                                              &render_rect.height))
     return;
 
-  path.status   = CAIRO_STATUS_SUCCESS;
-  path.data     = (cairo_path_data_t *) sc->path_data->data;
-  path.num_data = sc->path_data->len;
+  data.sc            = sc;
+  data.buffer        = buffer;
+  data.format        = babl_format ("Y u8");
+  data.path.status   = CAIRO_STATUS_SUCCESS;
+  data.path.data     = (cairo_path_data_t *) sc->path_data->data;
+  data.path.num_data = sc->path_data->len;
+  data.off_x         = off_x;
+  data.off_y         = off_y;
+  data.replace       = replace;
+  data.antialias     = antialias;
+  data.value         = value;
+
+  /*  only the tiles intersecting the path's extents need to be
+   *  rasterized.  when replacing, everything else is simply cleared,
+   *  which lets GEGL share empty tiles instead of allocating them.
+   */
+  if (! gimp_scan_convert_get_extents (sc, &data.path, antialias,
+                                       &path_rect))
+    {
+      if (replace)
+        gegl_buffer_clear (buffer, &render_rect);
+
+      return;
+    }
+
+  path_rect.x -= off_x;
+  path_rect.y -= off_y;
 
-  format = babl_format ("Y u8");
-  bpp    = babl_format_get_bytes_per_pixel (format);
+  if (! gegl_rectangle_intersect (&path_rect, &path_rect, &render_rect))
+    {
+      if (replace)
+        gegl_buffer_clear (buffer, &render_rect);
+
+      return;
+    }
+
+  if (replace)
+    {
+      /*  align the area we rasterize to the tile grid, so that the
+       *  area we clear covers whole tiles only
+       */
+      gegl_rectangle_align_to_buffer (&path_rect, &path_rect, buffer,
+                                      GEGL_RECTANGLE_ALIGNMENT_SUPERSET);
+
+      gegl_rectangle_intersect (&path_rect, &path_rect, &render_rect);
+
+      if (! gegl_rectangle_equal (&path_rect, &render_rect))
+        {
+          GeglRectangle rects[4];
+          gint          i;
+
+          /*  above, below, left of and right of the path's extents  */
+          gegl_rectangle_set (&rects[0],
+                              render_rect.x, render_rect.y,
+                              render_rect.width,
+                              path_rect.y - render_rect.y);
+          gegl_rectangle_set (&rects[1],
+                              render_rect.x, path_rect.y + path_rect.height,
+                              render_rect.width,
+                              render_rect.y + render_rect.height -
+                              (path_rect.y + path_rect.height));
+          gegl_rectangle_set (&rects[2],
+                              render_rect.x, path_rect.y,
+                              path_rect.x - render_rect.x,
+                              path_rect.height);
+          gegl_rectangle_set (&rects[3],
+                              path_rect.x + path_rect.width, path_rect.y,
+                              render_rect.x + render_rect.width -
+                              (path_rect.x + path_rect.width),
+                              path_rect.height);
+
+          for (i = 0; i < G_N_ELEMENTS (rects); i++)
+            {
+              if (! gegl_rectangle_is_empty (&rects[i]))
+                gegl_buffer_clear (buffer, &rects[i]);
+            }
+        }
+    }
 
-  iter = gegl_buffer_iterator_new (buffer, NULL, 0, format,
-                                   GEGL_ACCESS_READWRITE, GEGL_ABYSS_NONE, 1);
+  gegl_parallel_distribute_area (
+    &path_rect, PIXELS_PER_THREAD, GEGL_SPLIT_STRATEGY_AUTO,
+    (GeglParallelDistributeAreaFunc) gimp_scan_convert_render_area,
+    &data);
+}
+
+
+/*  private functions  */
+
+static void
+gimp_scan_convert_setup (GimpScanConvert    *sc,
+                         cairo_t            *cr,
+                         const cairo_path_t *path,
+                         gboolean            antialias)
+{
+  cairo_append_path (cr, path);
+
+  cairo_set_antialias (cr, antialias ?
+                       CAIRO_ANTIALIAS_GRAY : CAIRO_ANTIALIAS_NONE);
+  cairo_set_miter_limit (cr, sc->miter);
+
+  if (sc->do_stroke)
+    {
+      cairo_set_line_cap (cr,
+                          sc->cap == GIMP_CAP_BUTT ? CAIRO_LINE_CAP_BUTT :
+                          sc->cap == GIMP_CAP_ROUND ? CAIRO_LINE_CAP_ROUND :
+                          CAIRO_LINE_CAP_SQUARE);
+      cairo_set_line_join (cr,
+                           sc->join == GIMP_JOIN_MITER ? CAIRO_LINE_JOIN_MITER :
+                           sc->join == GIMP_JOIN_ROUND ? CAIRO_LINE_JOIN_ROUND :
+                           CAIRO_LINE_JOIN_BEVEL);
+
+      cairo_set_line_width (cr, sc->width);
+
+      if (sc->dash_info)
+        cairo_set_dash (cr,
+                        (double *) sc->dash_info->data,
+                        sc->dash_info->len,
+                        sc->dash_offset);
+
+      cairo_scale (cr, 1.0, sc->ratio_xy);
+    }
+  else
+    {
+      cairo_set_fill_rule (cr, CAIRO_FILL_RULE_EVEN_ODD);
+    }
+}
+
+static gboolean
+gimp_scan_convert_get_extents (GimpScanConvert    *sc,
+                               const cairo_path_t *path,
+                               gboolean            antialias,
+                               GeglRectangle      *extents)
+{
+  cairo_surface_t *surface;
+  cairo_t         *cr;
+  gdouble          x1, y1;
+  gdouble          x2, y2;
+  gdouble          xs[4];
+  gdouble          ys[4];
+  gint             i;
+
+  if (path->num_data == 0)
+    return FALSE;
+
+  surface = cairo_image_surface_create (CAIRO_FORMAT_A8, 1, 1);
+  cr      = cairo_create (surface);
+
+  gimp_scan_convert_setup (sc, cr, path, antialias);
+
+  if (sc->do_stroke)
+    cairo_stroke_extents (cr, &x1, &y1, &x2, &y2);
+  else
+    cairo_fill_extents (cr, &x1, &y1, &x2, &y2);
+
+  /*  the extents are in user space, which is scaled when stroking  */
+  xs[0] = x1; ys[0] = y1;
+  xs[1] = x2; ys[1] = y1;
+  xs[2] = x1; ys[2] = y2;
+  xs[3] = x2; ys[3] = y2;
+
+  for (i = 0; i < 4; i++)
+    cairo_user_to_device (cr, &xs[i], &ys[i]);
+
+  x1 = MIN (MIN (xs[0], xs[1]), MIN (xs[2], xs[3]));
+  y1 = MIN (MIN (ys[0], ys[1]), MIN (ys[2], ys[3]));
+  x2 = MAX (MAX (xs[0], xs[1]), MAX (xs[2], xs[3]));
+  y2 = MAX (MAX (ys[0], ys[1]), MAX (ys[2], ys[3]));
+
+  cairo_destroy (cr);
+  cairo_surface_destroy (surface);
+
+  if (x1 >= x2 || y1 >= y2)
+    return FALSE;
+
+  /*  leave a pixel of slack for antialiasing and rounding  */
+  extents->x      = floor (x1) - 1;
+  extents->y      = floor (y1) - 1;
+  extents->width  = ceil (x2) + 1 - extents->x;
+  extents->height = ceil (y2) + 1 - extents->y;
+
+  return TRUE;
+}
+
+static void
+gimp_scan_convert_render_area (const GeglRectangle *area,
+                               const RenderData    *data)
+{
+  GimpScanConvert    *sc              = data->sc;
+  guchar             *shared_buf      = NULL;
+  gsize               shared_buf_size = 0;
+  GeglBufferIterator *iter;
+  GeglRectangle      *roi;
+  cairo_t            *cr;
+  cairo_surface_t    *surface;
+  gint                bpp;
+
+  bpp = babl_format_get_bytes_per_pixel (data->format);
+
+  iter = gegl_buffer_iterator_new (data->buffer, area, 0, data->format,
+                                   data->replace ?
+                                     GEGL_ACCESS_WRITE : GEGL_ACCESS_READWRITE,
+                                   GEGL_ABYSS_NONE, 1);
   roi = &iter->items[0].roi;
 
   while (gegl_buffer_iterator_next (iter))
     {
-      guchar     *data    = iter->items[0].data;
-      guchar     *tmp_buf = NULL;
-      const gint  stride  = cairo_format_stride_for_width (CAIRO_FORMAT_A8,
-                                                           roi->width);
+      guchar     *data_ptr = iter->items[0].data;
+      guchar     *tmp_buf  = NULL;
+      const gint  stride   = cairo_format_stride_for_width (CAIRO_FORMAT_A8,
+                                                            roi->width);
 
       /*  cairo rowstrides are always multiples of 4, whereas
        *  maskPR.rowstride can be anything, so to be able to create an
@@ -555,9 +774,9 @@ gimp_scan_convert_render_full (GimpScanConvert *sc,
             }
           tmp_buf = shared_buf;
 
-          if (! replace)
+          if (! data->replace)
             {
-              const guchar *src  = data;
+              const guchar *src  = data_ptr;
               guchar       *dest = tmp_buf;
               gint          i;
 
@@ -572,57 +791,31 @@ gimp_scan_convert_render_full (GimpScanConvert *sc,
         }
 
       surface = cairo_image_surface_create_for_data (tmp_buf ?
-                                                     tmp_buf : data,
+                                                     tmp_buf : data_ptr,
                                                      CAIRO_FORMAT_A8,
                                                      roi->width, roi->height,
                                                      stride);
 
       cairo_surface_set_device_offset (surface,
-                                       -off_x - roi->x,
-                                       -off_y - roi->y);
+                                       -data->off_x - roi->x,
+                                       -data->off_y - roi->y);
       cr = cairo_create (surface);
       cairo_set_operator (cr, CAIRO_OPERATOR_SOURCE);
 
-      if (replace)
+      if (data->replace)
         {
           cairo_set_source_rgba (cr, 0, 0, 0, 0);
           cairo_paint (cr);
         }
 
-      cairo_set_source_rgba (cr, 0, 0, 0, value);
-      cairo_append_path (cr, &path);
+      cairo_set_source_rgba (cr, 0, 0, 0, data->value);
 
-      cairo_set_antialias (cr, antialias ?
-                           CAIRO_ANTIALIAS_GRAY : CAIRO_ANTIALIAS_NONE);
-      cairo_set_miter_limit (cr, sc->miter);
+      gimp_scan_convert_setup (sc, cr, &data->path, data->antialias);
 
       if (sc->do_stroke)
-        {
-          cairo_set_line_cap (cr,
-                              sc->cap == GIMP_CAP_BUTT ? CAIRO_LINE_CAP_BUTT :
-                              sc->cap == GIMP_CAP_ROUND ? CAIRO_LINE_CAP_ROUND :
-                              CAIRO_LINE_CAP_SQUARE);
-          cairo_set_line_join (cr,
-                               sc->join == GIMP_JOIN_MITER ? CAIRO_LINE_JOIN_MITER :
-                               sc->join == GIMP_JOIN_ROUND ? CAIRO_LINE_JOIN_ROUND :
-                               CAIRO_LINE_JOIN_BEVEL);
-
-          cairo_set_line_width (cr, sc->width);
-
-          if (sc->dash_info)
-            cairo_set_dash (cr,
-                            (double *) sc->dash_info->data,
-                            sc->dash_info->len,
-                            sc->dash_offset);
-
-          cairo_scale (cr, 1.0, sc->ratio_xy);
-          cairo_stroke (cr);
-        }
+        cairo_stroke (cr);
       else
-        {
-          cairo_set_fill_rule (cr, CAIRO_FILL_RULE_EVEN_ODD);
-          cairo_fill (cr);
-        }
+        cairo_fill (cr);
 
       cairo_destroy (cr);
       cairo_surface_destroy (surface);
@@ -630,7 +823,7 @@ gimp_scan_convert_render_full (GimpScanConvert *sc,
       if (tmp_buf)
         {
           const guchar *src  = tmp_buf;
-          guchar       *dest = data;
+          guchar       *dest = data_ptr;
           gint          i;
 
           for (i = 0; i < roi->height; i++)
@@ -140,6 +140,48 @@ gimp_gegl_buffer_copy (GeglBuffer          *src_buffer,
     }
 }
 
+void
+gimp_gegl_buffer_get_scaled (GeglBuffer          *buffer,
+                             const GeglRectangle *rect,
+                             gdouble              scale,
+                             const Babl          *format,
+                             gpointer             dest,
+                             gint                 rowstride,
+                             GeglAbyssPolicy      abyss_policy)
+{
+  gint bpp;
+
+  g_return_if_fail (GEGL_IS_BUFFER (buffer));
+  g_return_if_fail (rect != NULL);
+  g_return_if_fail (scale > 0.0);
+  g_return_if_fail (format != NULL);
+  g_return_if_fail (dest != NULL);
+
+  bpp = babl_format_get_bytes_per_pixel (format);
+
+  if (rowstride == GEGL_AUTO_ROWSTRIDE)
+    rowstride = rect->width * bpp;
+
+  /* each destination pixel is sampled from (1 / scale)^2 source pixels,
+   * at least as long as the buffer's mipmap levels are not yet populated,
+   * so weight the per-thread cost accordingly.
+   */
+  gegl_parallel_distribute_area (
+    rect, PIXELS_PER_THREAD * MIN (scale * scale, 1.0),
+    GEGL_SPLIT_STRATEGY_HORIZONTAL,
+    [=] (const GeglRectangle *area)
+    {
+      guchar *d = (guchar *) dest;
+
+      d += (area->y - rect->y) * rowstride;
+      d += (area->x - rect->x) * bpp;
+
+      gegl_buffer_get (buffer, area, scale,
+                       format, d, rowstride,
+                       abyss_policy);
+    });
+}
+
 void
 gimp_gegl_clear (GeglBuffer          *buffer,
                  const GeglRectangle *rect)
@@ -1187,3 +1229,312 @@ gimp_gegl_average_color (GeglBuffer          *buffer,
 }
 
 } /* extern "C" */
+
+
+/*  the distance transform of Meijster, Roerdink and Hesselink, "A
+ *  general algorithm for computing distance transforms in linear
+ *  time", which, like Felzenszwalb and Huttenlocher's, computes the
+ *  lower envelope of the per-column distances along each row.  the
+ *  metric only enters through dist() and sep() below.
+ */
+
+#define DISTANCE_THRESHOLD 0.0001f
+
+static inline gint64
+floor_div (gint64 a,
+           gint64 b)
+{
+  return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+template <class Dist,
+          class Sep,
+          class Output>
+static void
+gimp_gegl_distance_transform_rows (gfloat *dist,
+                                   gfloat *row_max,
+                                   gint    width,
+                                   gint    height,
+                                   Dist    dist_func,
+                                   Sep     sep_func,
+                                   Output  output_func)
+{
+  gegl_parallel_distribute_range (
+    height, MAX (PIXELS_PER_THREAD / width, 1),
+    [=] (gint y0, gint n_rows)
+    {
+      /* the row, with a background pixel on either side */
+      const gint  n = width + 2;
+      gint64     *g = g_new (gint64, n);
+      gint64     *s = g_new (gint64, n);
+      gint64     *t = g_new (gint64, n);
+      gint        y;
+
+      for (y = y0; y < y0 + n_rows; y++)
+        {
+          gfloat *row = dist + (gsize) y * width;
+          gfloat  max = 0.0f;
+          gint    q   = 0;
+          gint    u;
+
+          g[0]     = 0;
+          g[n - 1] = 0;
+
+          for (u = 0; u < width; u++)
+            g[u + 1] = row[u];
+
+          s[0] = 0;
+          t[0] = 0;
+
+          for (u = 1; u < n; u++)
+            {
+              while (q >= 0 &&
+                     dist_func (g, t[q], s[q]) > dist_func (g, t[q], u))
+                {
+                  q--;
+                }
+
+              if (q < 0)
+                {
+                  q    = 0;
+                  s[0] = u;
+                }
+              else
+                {
+                  gint64 w = 1 + sep_func (g, s[q], u);
+
+                  if (w < n)
+                    {
+                      q++;
+                      s[q] = u;
+                      t[q] = w;
+                    }
+                }
+            }
+
+          for (u = n - 1; u >= 0; u--)
+            {
+              if (u > 0 && u <= width)
+                {
+                  row[u - 1] = output_func (dist_func (g, u, s[q]));
+
+                  max = MAX (max, row[u - 1]);
+                }
+
+              if (u == t[q])
+                q--;
+            }
+
+          row_max[y] = max;
+        }
+
+      g_free (g);
+      g_free (s);
+      g_free (t);
+    });
+}
+
+
+/*  the templates above can't have C linkage, so the public function
+ *  gets its own extern "C" block.
+ */
+extern "C"
+{
+
+void
+gimp_gegl_distance_transform (GeglBuffer          *src_buffer,
+                              const GeglRectangle *src_rect,
+                              const Babl          *src_format,
+                              GeglBuffer          *dest_buffer,
+                              const GeglRectangle *dest_rect,
+                              GeglDistanceMetric   metric,
+                              gboolean             normalize,
+                              GimpProgress        *progress)
+{
+  gfloat *dist;
+  gfloat *row_max;
+  gfloat  max = 0.0f;
+  gint    width;
+  gint    height;
+  gint    y;
+
+  g_return_if_fail (src_buffer == NULL || GEGL_IS_BUFFER (src_buffer));
+  g_return_if_fail (GEGL_IS_BUFFER (dest_buffer));
+  g_return_if_fail (progress == NULL || GIMP_IS_PROGRESS (progress));
+
+  if (! dest_rect)
+    dest_rect = gegl_buffer_get_extent (dest_buffer);
+
+  if (src_buffer && ! src_rect)
+    src_rect = gegl_buffer_get_extent (src_buffer);
+
+  if (! src_format)
+    src_format = babl_format ("Y float");
+
+  width  = dest_rect->width;
+  height = dest_rect->height;
+
+  if (width <= 0 || height <= 0)
+    return;
+
+  dist    = g_new (gfloat, (gsize) width * height);
+  row_max = g_new (gfloat, height);
+
+  if (src_buffer)
+    {
+      gegl_parallel_distribute_area (
+        GEGL_RECTANGLE (0, 0, width, height), PIXELS_PER_THREAD,
+        [=] (const GeglRectangle *area)
+        {
+          gegl_buffer_get (src_buffer,
+                           GEGL_RECTANGLE (src_rect->x + area->x,
+                                           src_rect->y + area->y,
+                                           area->width,
+                                           area->height),
+                           1.0, src_format,
+                           dist + (gsize) area->y * width + area->x,
+                           width * sizeof (gfloat),
+                           GEGL_ABYSS_NONE);
+        });
+    }
+  else
+    {
+      gsize i;
+
+      for (i = 0; i < (gsize) width * height; i++)
+        dist[i] = 1.0f;
+    }
+
+  /* replace each pixel by the distance to the nearest background pixel
+   * in its column, counting the rows above and below as background
+   */
+  gegl_parallel_distribute_range (
+    width, MAX (PIXELS_PER_THREAD / height, 1),
+    [=] (gint x0, gint n_columns)
+    {
+      gfloat *col = dist + x0;
+      gfloat *last;
+      gint    x;
+      gint    y;
+
+      for (x = 0; x < n_columns; x++)
+        col[x] = col[x] > DISTANCE_THRESHOLD ? 1.0f : 0.0f;
+
+      for (y = 1; y < height; y++)
+        {
+          const gfloat *prev = col + (gsize) (y - 1) * width;
+          gfloat       *cur  = col + (gsize) y * width;
+
+          for (x = 0; x < n_columns; x++)
+            cur[x] = cur[x] > DISTANCE_THRESHOLD ? prev[x] + 1.0f : 0.0f;
+        }
+
+      last = col + (gsize) (height - 1) * width;
+
+      for (x = 0; x < n_columns; x++)
+        last[x] = MIN (last[x], 1.0f);
+
+      for (y = height - 2; y >= 0; y--)
+        {
+          const gfloat *next = col + (gsize) (y + 1) * width;
+          gfloat       *cur  = col + (gsize) y * width;
+
+          for (x = 0; x < n_columns; x++)
+            cur[x] = MIN (cur[x], next[x] + 1.0f);
+        }
+    });
+
+  if (progress)
+    gimp_progress_set_value (progress, 0.5);
+
+  switch (metric)
+    {
+    case GEGL_DISTANCE_METRIC_EUCLIDEAN:
+      gimp_gegl_distance_transform_rows (
+        dist, row_max, width, height,
+        [] (const gint64 *g, gint64 x, gint64 i) -> gint64
+        {
+          return (x - i) * (x - i) + g[i] * g[i];
+        },
+        [] (const gint64 *g, gint64 i, gint64 u) -> gint64
+        {
+          return floor_div (u * u - i * i + g[u] * g[u] - g[i] * g[i],
+                            2 * (u - i));
+        },
+        [] (gint64 d) -> gfloat
+        {
+          return sqrt ((gdouble) d);
+        });
+      break;
+
+    case GEGL_DISTANCE_METRIC_MANHATTAN:
+      gimp_gegl_distance_transform_rows (
+        dist, row_max, width, height,
+        [] (const gint64 *g, gint64 x, gint64 i) -> gint64
+        {
+          return ABS (x - i) + g[i];
+        },
+        [] (const gint64 *g, gint64 i, gint64 u) -> gint64
+        {
+          if (g[u] >= g[i] + u - i)
+            return G_MAXINT;
+          else if (g[i] > g[u] + u - i)
+            return -G_MAXINT;
+          else
+            return floor_div (g[u] - g[i] + u + i, 2);
+        },
+        [] (gint64 d) -> gfloat
+        {
+          return d;
+        });
+      break;
+
+    case GEGL_DISTANCE_METRIC_CHEBYSHEV:
+      gimp_gegl_distance_transform_rows (
+        dist, row_max, width, height,
+        [] (const gint64 *g, gint64 x, gint64 i) -> gint64
+        {
+          return MAX (ABS (x - i), g[i]);
+        },
+        [] (const gint64 *g, gint64 i, gint64 u) -> gint64
+        {
+          if (g[i] <= g[u])
+            return MAX (i + g[u], floor_div (i + u, 2));
+          else
+            return MIN (u - g[i], floor_div (i + u, 2));
+        },
+        [] (gint64 d) -> gfloat
+        {
+          return d;
+        });
+      break;
+    }
+
+  for (y = 0; y < height; y++)
+    max = MAX (max, row_max[y]);
+
+  if (normalize && max > 0.0f)
+    {
+      gegl_parallel_distribute_range (
+        (gsize) width * height, PIXELS_PER_THREAD,
+        [=] (gsize offset, gsize size)
+        {
+          gfloat *d = dist + offset;
+          gsize   i;
+
+          for (i = 0; i < size; i++)
+            d[i] /= max;
+        });
+    }
+
+  gegl_buffer_set (dest_buffer, dest_rect, 0, babl_format ("Y float"),
+                   dist, width * sizeof (gfloat));
+
+  if (progress)
+    gimp_progress_set_value (progress, 1.0);
+
+  g_free (row_max);
+  g_free (dist);
+}
+
+} /* extern "C" */
@@ -28,6 +28,15 @@ void   gimp_gegl_buffer_copy           (GeglBuffer               *src_buffer,
                                         GeglBuffer               *dest_buffer,
                                         const GeglRectangle      *dest_rect);
 
+/*  a parallel gegl_buffer_get() for scaled-down reads, used for previews  */
+void   gimp_gegl_buffer_get_scaled     (GeglBuffer               *buffer,
+                                        const GeglRectangle      *rect,
+                                        gdouble                   scale,
+                                        const Babl               *format,
+                                        gpointer                  dest,
+                                        gint                      rowstride,
+                                        GeglAbyssPolicy           abyss_policy);
+
 void   gimp_gegl_clear                 (GeglBuffer               *buffer,
                                         const GeglRectangle      *rect);
 
@@ -114,5 +123,18 @@ void   gimp_gegl_average_color         (GeglBuffer               *buffer,
                                         const Babl               *format,
                                         gpointer                  color);
 
+/*  an exact, linear-time distance transform of a single-component
+ *  mask, with the region's surroundings counting as background.  a
+ *  NULL @src_buffer is treated as fully opaque.
+ */
+void   gimp_gegl_distance_transform    (GeglBuffer               *src_buffer,
+                                        const GeglRectangle      *src_rect,
+                                        const Babl               *src_format,
+                                        GeglBuffer               *dest_buffer,
+                                        const GeglRectangle      *dest_rect,
+                                        GeglDistanceMetric        metric,
+                                        gboolean                  normalize,
+                                        GimpProgress             *progress);
+
 
 #endif /* __GIMP_GEGL_LOOPS_H__ */
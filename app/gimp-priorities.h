@@ -34,6 +34,9 @@
 /*  just a bit less than GDK_PRIORITY_REDRAW   */
 #define GIMP_PRIORITY_PROJECTION_IDLE (G_PRIORITY_HIGH_IDLE + 22)
 
+/*  after projection construction, so the coarse preview is done first  */
+#define GIMP_PRIORITY_DRAWABLE_FILTER_REFINE_IDLE (G_PRIORITY_HIGH_IDLE + 23)
+
 /* #define G_PRIORITY_DEFAULT_IDLE 200 */
 
 #define GIMP_PRIORITY_VIEWABLE_IDLE (G_PRIORITY_LOW)
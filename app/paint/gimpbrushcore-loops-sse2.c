@@ -0,0 +1,90 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "config.h"
+
+#include <glib.h>
+
+#include "gimpbrushcore-loops-sse2.h"
+
+
+#if COMPILE_SSE2_INTRINISICS
+
+#include <emmintrin.h>
+
+
+/*  accum[i] += mask[i] * coeff, for 0 <= i < count.
+ *
+ *  the additions happen in the same order, and with the same rounding,
+ *  as in the scalar loop of gimp_brush_core_subsample_mask_impl(), as
+ *  long as the caller processes the kernel columns from right to left.
+ */
+void
+gimp_brush_core_subsample_accumulate_sse2 (gfloat       *accum,
+                                           const gfloat *mask,
+                                           gint          count,
+                                           gfloat        coeff)
+{
+  const __m128 v_coeff = _mm_set1_ps (coeff);
+
+  for (; count >= 4; count -= 4)
+    {
+      __m128 v_accum = _mm_loadu_ps (accum);
+      __m128 v_mask  = _mm_loadu_ps (mask);
+
+      v_accum = _mm_add_ps (v_accum, _mm_mul_ps (v_mask, v_coeff));
+
+      _mm_storeu_ps (accum, v_accum);
+
+      accum += 4;
+      mask  += 4;
+    }
+
+  for (; count; count--)
+    *accum++ += *mask++ * coeff;
+}
+
+/*  dest[i] = MIN (scale * mask[i], 1), for 0 <= i < count  */
+void
+gimp_brush_core_pressurize_simple_sse2 (const gfloat *mask,
+                                        gfloat       *dest,
+                                        gint          count,
+                                        gfloat        scale)
+{
+  const __m128 v_scale = _mm_set1_ps (scale);
+  const __m128 v_one   = _mm_set1_ps (1.0f);
+
+  for (; count >= 4; count -= 4)
+    {
+      __m128 v_mask = _mm_loadu_ps (mask);
+
+      _mm_storeu_ps (dest, _mm_min_ps (_mm_mul_ps (v_mask, v_scale), v_one));
+
+      mask += 4;
+      dest += 4;
+    }
+
+  for (; count; count--)
+    {
+      gfloat v = scale * *mask++;
+
+      *dest++ = MIN (v, 1.0f);
+    }
+}
+
+#endif /* COMPILE_SSE2_INTRINISICS */
@@ -0,0 +1,38 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef __GIMP_BRUSH_CORE_LOOPS_SSE2_H__
+#define __GIMP_BRUSH_CORE_LOOPS_SSE2_H__
+
+
+#if COMPILE_SSE2_INTRINISICS
+
+void   gimp_brush_core_subsample_accumulate_sse2 (gfloat       *accum,
+                                                  const gfloat *mask,
+                                                  gint          count,
+                                                  gfloat        coeff);
+
+void   gimp_brush_core_pressurize_simple_sse2    (const gfloat *mask,
+                                                  gfloat       *dest,
+                                                  gint          count,
+                                                  gfloat        scale);
+
+#endif /* COMPILE_SSE2_INTRINISICS */
+
+
+#endif /* __GIMP_BRUSH_CORE_LOOPS_SSE2_H__ */
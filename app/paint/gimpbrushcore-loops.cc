@@ -22,6 +22,7 @@
 #include <gegl.h>
 #include <gdk-pixbuf/gdk-pixbuf.h>
 
+#include "libgimpbase/gimpbase.h"
 #include "libgimpmath/gimpmath.h"
 
 extern "C"
@@ -33,6 +34,7 @@ extern "C"
 
 #include "gimpbrushcore.h"
 #include "gimpbrushcore-loops.h"
+#include "gimpbrushcore-loops-sse2.h"
 
 } /* extern "C" */
 
@@ -108,6 +110,52 @@ rotate_pointers (T    **p,
   p[i] = tmp;
 }
 
+#if COMPILE_SSE2_INTRINISICS
+
+/* accumulates a mask row into the accum buffers using SSE2, returning
+ * FALSE for mask types that have no SSE2 path.
+ */
+template <class T>
+static inline gboolean
+subsample_accumulate_row_sse2 (typename Subsample<T>::accum_type        **accum,
+                               const typename Subsample<T>::value_type   *m,
+                               gint                                       mask_width,
+                               const typename Subsample<T>::kernel_type  *kernel,
+                               gint                                       dest_offset_x)
+{
+  return FALSE;
+}
+
+template <>
+inline gboolean
+subsample_accumulate_row_sse2<gfloat> (gfloat       **accum,
+                                       const gfloat  *m,
+                                       gint           mask_width,
+                                       const gfloat  *kernel,
+                                       gint           dest_offset_x)
+{
+  gint r, s;
+
+  /* process the kernel columns from right to left, so that each accum
+   * element receives its terms in the same order as in the scalar loop.
+   */
+  for (r = 0; r < KERNEL_HEIGHT; r++)
+    {
+      for (s = KERNEL_WIDTH - 1; s >= 0; s--)
+        {
+          gimp_brush_core_subsample_accumulate_sse2 (
+            accum[r] + dest_offset_x + s,
+            m,
+            mask_width,
+            kernel[r * KERNEL_WIDTH + s]);
+        }
+    }
+
+  return TRUE;
+}
+
+#endif /* COMPILE_SSE2_INTRINISICS */
+
 template <class T>
 static void
 gimp_brush_core_subsample_mask_impl (const GimpTempBuf *mask,
@@ -127,6 +175,10 @@ gimp_brush_core_subsample_mask_impl (const GimpTempBuf *mask,
   gint               mask_height = gimp_temp_buf_get_height (mask);
   gint               dest_width  = gimp_temp_buf_get_width  (dest);
   gint               dest_height = gimp_temp_buf_get_height (dest);
+#if COMPILE_SSE2_INTRINISICS
+  gboolean           sse2        = (gimp_cpu_accel_get_support () &
+                                    GIMP_CPU_ACCEL_X86_SSE2);
+#endif
 
   gegl_parallel_distribute_range (
     mask_height, PIXELS_PER_THREAD / mask_width,
@@ -170,17 +222,28 @@ gimp_brush_core_subsample_mask_impl (const GimpTempBuf *mask,
 
       for (i = y; i < y + height; i++)
         {
-          for (j = 0; j < mask_width; j++)
+#if COMPILE_SSE2_INTRINISICS
+          if (sse2 &&
+              subsample_accumulate_row_sse2<T> (accum, m, mask_width,
+                                                kernel, dest_offset_x))
+            {
+              m += mask_width;
+            }
+          else
+#endif
             {
-              k = kernel;
-              for (r = 0; r < KERNEL_HEIGHT; r++)
+              for (j = 0; j < mask_width; j++)
                 {
-                  offs = j + dest_offset_x;
-                  s = KERNEL_WIDTH;
-                  while (s--)
-                    accum[r][offs++] += *m * *k++;
+                  k = kernel;
+                  for (r = 0; r < KERNEL_HEIGHT; r++)
+                    {
+                      offs = j + dest_offset_x;
+                      s = KERNEL_WIDTH;
+                      while (s--)
+                        accum[r][offs++] += *m * *k++;
+                    }
+                  m++;
                 }
-              m++;
             }
 
           /* store the accum buffer into the destination mask */
@@ -517,6 +580,27 @@ gimp_brush_core_pressurize_mask (GimpBrushCore     *core,
                                                     CachedPressure<guchar> (
                                                       Pressure (pressure)));
     }
+#if COMPILE_SSE2_INTRINISICS && ! defined (FANCY_PRESSURE)
+  else if (subsample_mask_format == babl_format ("Y float") &&
+           (gimp_cpu_accel_get_support () & GIMP_CPU_ACCEL_X86_SSE2))
+    {
+      const gfloat *src   = (const gfloat *)
+                            gimp_temp_buf_get_data (subsample_mask);
+      gfloat       *dest  = (gfloat *)
+                            gimp_temp_buf_get_data (core->pressure_brush);
+      gfloat        scale = 2.0 * pressure;
+
+      gegl_parallel_distribute_range (
+        gimp_temp_buf_get_width (subsample_mask) *
+        gimp_temp_buf_get_height (subsample_mask),
+        PIXELS_PER_THREAD,
+        [=] (gint offset, gint size)
+        {
+          gimp_brush_core_pressurize_simple_sse2 (src + offset, dest + offset,
+                                                  size, scale);
+        });
+    }
+#endif
   else if (subsample_mask_format == babl_format ("Y float"))
     {
       gimp_brush_core_pressurize_mask_impl<gfloat> (subsample_mask,
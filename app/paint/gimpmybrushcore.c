@@ -331,6 +331,9 @@ gimp_mybrush_core_motion (GimpPaintCore    *paint_core,
       x2 = coords.x + radius;
       y2 = coords.y + radius;
 
+      /* render the queued dabs before the buffer may be replaced */
+      gimp_mypaint_surface_flush (mybrush->private->surface);
+
       expanded = gimp_paint_core_expand_drawable (paint_core, drawable, paint_options,
                                                   x1, x2, y1, y2,
                                                   &offset_change_x, &offset_change_y);
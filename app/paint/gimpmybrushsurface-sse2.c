@@ -0,0 +1,235 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "config.h"
+
+#include <glib.h>
+
+#include "gimpmybrushsurface-sse2.h"
+
+
+#if COMPILE_SSE2_INTRINISICS
+
+#include <emmintrin.h>
+
+
+static inline __m128
+pixel_x (gint   ix,
+         gfloat x)
+{
+  /* ix + 0.5f - x, for four consecutive pixels */
+  __m128 v_ix = _mm_cvtepi32_ps (_mm_add_epi32 (_mm_set1_epi32 (ix),
+                                                _mm_set_epi32 (3, 2, 1, 0)));
+
+  return _mm_sub_ps (_mm_add_ps (v_ix, _mm_set1_ps (0.5f)),
+                     _mm_set1_ps (x));
+}
+
+static inline __m128
+select_ps (__m128 mask,
+           __m128 a,
+           __m128 b)
+{
+  return _mm_or_ps (_mm_and_ps (mask, a), _mm_andnot_ps (mask, b));
+}
+
+/*  the normal-mode part of gimp_mypaint_surface_draw_dab(), for dabs
+ *  of radius >= 3.0, without colorize and with all components writable.
+ *  Processes pixels in groups of four, and returns the number of
+ *  processed pixels; the caller handles the rest.
+ */
+gint
+gimp_mybrush_surface_draw_dab_row_sse2 (gfloat       *pixel,
+                                        const gfloat *mask,
+                                        gint          ix,
+                                        gint          count,
+                                        gfloat        x,
+                                        gfloat        yy,
+                                        gfloat        aspect_ratio,
+                                        gfloat        sn,
+                                        gfloat        cs,
+                                        gfloat        one_over_radius2,
+                                        gfloat        hardness,
+                                        gfloat        slope1,
+                                        gfloat        slope2,
+                                        gfloat        normal_mode,
+                                        const gfloat *color,
+                                        gboolean      no_erasing)
+{
+  const __m128 v_one         = _mm_set1_ps (1.0f);
+  const __m128 v_zero        = _mm_setzero_ps ();
+  const __m128 v_yy_cs       = _mm_set1_ps (yy * cs);
+  const __m128 v_yy_sn       = _mm_set1_ps (yy * sn);
+  const __m128 v_sn          = _mm_set1_ps (sn);
+  const __m128 v_cs          = _mm_set1_ps (cs);
+  const __m128 v_aspect      = _mm_set1_ps (aspect_ratio);
+  const __m128 v_one_over_r2 = _mm_set1_ps (one_over_radius2);
+  const __m128 v_hardness    = _mm_set1_ps (hardness);
+  const __m128 v_slope1      = _mm_set1_ps (slope1);
+  const __m128 v_slope2      = _mm_set1_ps (slope2);
+  const __m128 v_normal_mode = _mm_set1_ps (normal_mode);
+  const __m128 v_color_r     = _mm_set1_ps (color[0]);
+  const __m128 v_color_g     = _mm_set1_ps (color[1]);
+  const __m128 v_color_b     = _mm_set1_ps (color[2]);
+  const __m128 v_color_a     = _mm_set1_ps (color[3]);
+  gint         n;
+
+  for (n = 0; n + 4 <= count; n += 4, ix += 4)
+    {
+      __m128 v_xx = pixel_x (ix, x);
+      __m128 v_yyr;
+      __m128 v_xxr;
+      __m128 v_rr;
+      __m128 v_alpha;
+      __m128 v_r, v_g, v_b, v_a;
+      __m128 v_new_a;
+      __m128 v_src_term;
+      __m128 v_dst_term;
+
+      /* calculate_rr() */
+      v_yyr = _mm_mul_ps (_mm_sub_ps (v_yy_cs, _mm_mul_ps (v_xx, v_sn)),
+                          v_aspect);
+      v_xxr = _mm_add_ps (v_yy_sn, _mm_mul_ps (v_xx, v_cs));
+      v_rr  = _mm_mul_ps (_mm_add_ps (_mm_mul_ps (v_yyr, v_yyr),
+                                      _mm_mul_ps (v_xxr, v_xxr)),
+                          v_one_over_r2);
+
+      /* calculate_alpha_for_rr() */
+      v_alpha = select_ps (_mm_cmple_ps (v_rr, v_hardness),
+                           _mm_add_ps (v_one, _mm_mul_ps (v_rr, v_slope1)),
+                           _mm_sub_ps (_mm_mul_ps (v_rr, v_slope2), v_slope2));
+      v_alpha = _mm_andnot_ps (_mm_cmpgt_ps (v_rr, v_one), v_alpha);
+
+      v_alpha = _mm_mul_ps (v_alpha, v_normal_mode);
+
+      if (mask)
+        v_alpha = _mm_mul_ps (v_alpha, _mm_loadu_ps (mask + n));
+
+      v_r = _mm_loadu_ps (pixel + 0);
+      v_g = _mm_loadu_ps (pixel + 4);
+      v_b = _mm_loadu_ps (pixel + 8);
+      v_a = _mm_loadu_ps (pixel + 12);
+
+      _MM_TRANSPOSE4_PS (v_r, v_g, v_b, v_a);
+
+      v_new_a = _mm_add_ps (_mm_mul_ps (v_alpha, _mm_sub_ps (v_color_a, v_a)),
+                            v_a);
+
+      v_src_term = _mm_div_ps (_mm_mul_ps (v_alpha, v_color_a), v_new_a);
+      v_src_term = _mm_and_ps (_mm_cmpgt_ps (v_new_a, v_zero), v_src_term);
+      v_dst_term = _mm_sub_ps (v_one, v_src_term);
+
+      v_r = _mm_add_ps (_mm_mul_ps (v_color_r, v_src_term),
+                        _mm_mul_ps (v_r, v_dst_term));
+      v_g = _mm_add_ps (_mm_mul_ps (v_color_g, v_src_term),
+                        _mm_mul_ps (v_g, v_dst_term));
+      v_b = _mm_add_ps (_mm_mul_ps (v_color_b, v_src_term),
+                        _mm_mul_ps (v_b, v_dst_term));
+
+      if (no_erasing)
+        v_a = _mm_max_ps (v_new_a, v_a);
+      else
+        v_a = v_new_a;
+
+      _MM_TRANSPOSE4_PS (v_r, v_g, v_b, v_a);
+
+      _mm_storeu_ps (pixel + 0,  v_r);
+      _mm_storeu_ps (pixel + 4,  v_g);
+      _mm_storeu_ps (pixel + 8,  v_b);
+      _mm_storeu_ps (pixel + 12, v_a);
+
+      pixel += 16;
+    }
+
+  return n;
+}
+
+/*  the weighted sum of gimp_mypaint_surface_get_color(), over
+ *  premultiplied pixels.  Accumulates R, G, B, A and the total weight
+ *  into sum[0..4], and returns the number of processed pixels.
+ */
+gint
+gimp_mybrush_surface_get_color_row_sse2 (const gfloat *pixel,
+                                         const gfloat *mask,
+                                         gint          ix,
+                                         gint          count,
+                                         gfloat        x,
+                                         gfloat        yy,
+                                         gfloat        one_over_radius2,
+                                         gfloat       *sum)
+{
+  const __m128 v_one         = _mm_set1_ps (1.0f);
+  const __m128 v_yy2         = _mm_set1_ps (yy * yy);
+  const __m128 v_one_over_r2 = _mm_set1_ps (one_over_radius2);
+  __m128       v_sum         = _mm_setzero_ps ();
+  __m128       v_sum_weight  = _mm_setzero_ps ();
+  gfloat       weight[4];
+  gint         n;
+
+  for (n = 0; n + 4 <= count; n += 4, ix += 4)
+    {
+      __m128 v_xx = pixel_x (ix, x);
+      __m128 v_rr;
+      __m128 v_weight;
+
+      v_rr = _mm_mul_ps (_mm_add_ps (v_yy2, _mm_mul_ps (v_xx, v_xx)),
+                         v_one_over_r2);
+
+      v_weight = _mm_and_ps (_mm_cmple_ps (v_rr, v_one),
+                             _mm_sub_ps (v_one, v_rr));
+
+      if (mask)
+        v_weight = _mm_mul_ps (v_weight, _mm_loadu_ps (mask + n));
+
+      v_sum_weight = _mm_add_ps (v_sum_weight, v_weight);
+
+      v_sum = _mm_add_ps (v_sum,
+                          _mm_mul_ps (_mm_loadu_ps (pixel + 0),
+                                      _mm_shuffle_ps (v_weight, v_weight,
+                                                      _MM_SHUFFLE (0, 0, 0, 0))));
+      v_sum = _mm_add_ps (v_sum,
+                          _mm_mul_ps (_mm_loadu_ps (pixel + 4),
+                                      _mm_shuffle_ps (v_weight, v_weight,
+                                                      _MM_SHUFFLE (1, 1, 1, 1))));
+      v_sum = _mm_add_ps (v_sum,
+                          _mm_mul_ps (_mm_loadu_ps (pixel + 8),
+                                      _mm_shuffle_ps (v_weight, v_weight,
+                                                      _MM_SHUFFLE (2, 2, 2, 2))));
+      v_sum = _mm_add_ps (v_sum,
+                          _mm_mul_ps (_mm_loadu_ps (pixel + 12),
+                                      _mm_shuffle_ps (v_weight, v_weight,
+                                                      _MM_SHUFFLE (3, 3, 3, 3))));
+
+      pixel += 16;
+    }
+
+  _mm_storeu_ps (weight, v_sum_weight);
+
+  sum[0] += _mm_cvtss_f32 (v_sum);
+  sum[1] += _mm_cvtss_f32 (_mm_shuffle_ps (v_sum, v_sum,
+                                           _MM_SHUFFLE (1, 1, 1, 1)));
+  sum[2] += _mm_cvtss_f32 (_mm_shuffle_ps (v_sum, v_sum,
+                                           _MM_SHUFFLE (2, 2, 2, 2)));
+  sum[3] += _mm_cvtss_f32 (_mm_shuffle_ps (v_sum, v_sum,
+                                           _MM_SHUFFLE (3, 3, 3, 3)));
+  sum[4] += weight[0] + weight[1] + weight[2] + weight[3];
+
+  return n;
+}
+
+#endif /* COMPILE_SSE2_INTRINISICS */
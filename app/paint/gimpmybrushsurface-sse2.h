@@ -0,0 +1,54 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef __GIMP_MYBRUSH_SURFACE_SSE2_H__
+#define __GIMP_MYBRUSH_SURFACE_SSE2_H__
+
+
+#if COMPILE_SSE2_INTRINISICS
+
+gint   gimp_mybrush_surface_draw_dab_row_sse2  (gfloat       *pixel,
+                                                const gfloat *mask,
+                                                gint          ix,
+                                                gint          count,
+                                                gfloat        x,
+                                                gfloat        yy,
+                                                gfloat        aspect_ratio,
+                                                gfloat        sn,
+                                                gfloat        cs,
+                                                gfloat        one_over_radius2,
+                                                gfloat        hardness,
+                                                gfloat        slope1,
+                                                gfloat        slope2,
+                                                gfloat        normal_mode,
+                                                const gfloat *color,
+                                                gboolean      no_erasing);
+
+gint   gimp_mybrush_surface_get_color_row_sse2 (const gfloat *pixel,
+                                                const gfloat *mask,
+                                                gint          ix,
+                                                gint          count,
+                                                gfloat        x,
+                                                gfloat        yy,
+                                                gfloat        one_over_radius2,
+                                                gfloat       *sum);
+
+#endif /* COMPILE_SSE2_INTRINISICS */
+
+
+#endif /* __GIMP_MYBRUSH_SURFACE_SSE2_H__ */
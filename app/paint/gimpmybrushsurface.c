@@ -22,6 +22,7 @@
 
 #include "paint-types.h"
 
+#include "libgimpbase/gimpbase.h"
 #include "libgimpmath/gimpmath.h"
 
 #include <cairo.h>
@@ -30,8 +31,46 @@
 
 #include "gimpmybrushoptions.h"
 #include "gimpmybrushsurface.h"
+#include "gimpmybrushsurface-sse2.h"
 
 
+#define PIXELS_PER_THREAD \
+  (/* each thread costs as much as */ 64.0 * 64.0 /* pixels */)
+
+
+typedef struct
+{
+  GeglRectangle rect;  /* clipped to the buffer */
+  float         x;
+  float         y;
+  float         radius;
+  float         one_over_radius2;
+  float         cs;
+  float         sn;
+  float         hardness;
+  float         segment1_slope;
+  float         segment2_slope;
+  float         aspect_ratio;
+  float         r_aa_start;
+  float         normal_mode;
+  float         colorize;
+  float         color[4];
+  float         color_hsl[3];
+} GimpMybrushDab;
+
+typedef struct
+{
+  GeglRectangle  rect;  /* the part of the tile touched by its dabs */
+  GArray        *dabs;  /* indices into the surface's dabs          */
+} GimpMybrushTile;
+
+typedef struct
+{
+  GimpMybrushSurface  *surface;
+  GimpMybrushTile    **tiles;
+  gint                 n_tiles;
+} RenderTilesData;
+
 struct _GimpMybrushSurface
 {
   MyPaintSurface      surface;
@@ -44,6 +83,11 @@ struct _GimpMybrushSurface
   GeglRectangle       dirty;
   GimpComponentMask   component_mask;
   GimpMybrushOptions *options;
+
+  GArray             *dabs;  /* queued GimpMybrushDab, in drawing order */
+  const Babl         *rgb_to_hsl_fish;
+  const Babl         *hsl_to_rgb_fish;
+  gboolean            use_sse2;
 };
 
 /* --- Taken from mypaint-tiled-surface.c --- */
@@ -244,6 +288,9 @@ gimp_mypaint_surface_get_color (MyPaintSurface *base_surface,
   GimpMybrushSurface *surface = (GimpMybrushSurface *)base_surface;
   GeglRectangle dabRect;
 
+  /* the sample has to see the dabs queued so far */
+  gimp_mypaint_surface_flush (surface);
+
   if (radius < 1.0f)
     radius = 1.0f;
 
@@ -257,11 +304,9 @@ gimp_mypaint_surface_get_color (MyPaintSurface *base_surface,
   if (dabRect.width > 0 || dabRect.height > 0)
   {
     const float one_over_radius2 = 1.0f / (radius * radius);
-    float sum_weight = 0.0f;
-    float sum_r = 0.0f;
-    float sum_g = 0.0f;
-    float sum_b = 0.0f;
-    float sum_a = 0.0f;
+    /* R, G, B, A, weight */
+    float sum[5] = { 0.0f, };
+    float sum_weight, sum_r, sum_g, sum_b, sum_a;
 
      /* Read in clamp mode to avoid transparency bleeding in at the edges */
     GeglBufferIterator *iter = gegl_buffer_iterator_new (surface->buffer, &dabRect, 0,
@@ -292,7 +337,28 @@ gimp_mypaint_surface_get_color (MyPaintSurface *base_surface,
         for (iy = iter->items[0].roi.y; iy < iter->items[0].roi.y + iter->items[0].roi.height; iy++)
           {
             float yy = (iy + 0.5f - y);
-            for (ix = iter->items[0].roi.x; ix < iter->items[0].roi.x +  iter->items[0].roi.width; ix++)
+
+            ix = iter->items[0].roi.x;
+
+#if COMPILE_SSE2_INTRINISICS
+            if (surface->use_sse2)
+              {
+                int n;
+
+                n = gimp_mybrush_surface_get_color_row_sse2 (pixel, mask, ix,
+                                                             iter->items[0].roi.width,
+                                                             x, yy,
+                                                             one_over_radius2,
+                                                             sum);
+
+                ix    += n;
+                pixel += 4 * n;
+                if (mask)
+                  mask += n;
+              }
+#endif
+
+            for (; ix < iter->items[0].roi.x +  iter->items[0].roi.width; ix++)
               {
                 /* pixel_weight == a standard dab with hardness = 0.5, aspect_ratio = 1.0, and angle = 0.0 */
                 float xx = (ix + 0.5f - x);
@@ -303,11 +369,11 @@ gimp_mypaint_surface_get_color (MyPaintSurface *base_surface,
                 if (mask)
                   pixel_weight *= *mask;
 
-                sum_r += pixel_weight * pixel[RED];
-                sum_g += pixel_weight * pixel[GREEN];
-                sum_b += pixel_weight * pixel[BLUE];
-                sum_a += pixel_weight * pixel[ALPHA];
-                sum_weight += pixel_weight;
+                sum[0] += pixel_weight * pixel[RED];
+                sum[1] += pixel_weight * pixel[GREEN];
+                sum[2] += pixel_weight * pixel[BLUE];
+                sum[3] += pixel_weight * pixel[ALPHA];
+                sum[4] += pixel_weight;
 
                 pixel += 4;
                 if (mask)
@@ -316,6 +382,12 @@ gimp_mypaint_surface_get_color (MyPaintSurface *base_surface,
           }
       }
 
+    sum_r      = sum[0];
+    sum_g      = sum[1];
+    sum_b      = sum[2];
+    sum_a      = sum[3];
+    sum_weight = sum[4];
+
     if (sum_a > 0.0f && sum_weight > 0.0f)
       {
         sum_r /= sum_weight;
@@ -354,52 +426,218 @@ gimp_mypaint_surface_draw_dab (MyPaintSurface *base_surface,
                                float           colorize)
 {
   GimpMybrushSurface *surface = (GimpMybrushSurface *)base_surface;
-  GeglBufferIterator *iter;
-  GeglRectangle       dabRect;
-  GimpComponentMask   component_mask  = surface->component_mask;
-  /* XXX What spaces should we be working from and to? */
-  const Babl         *rgb_to_hsl_fish = babl_fish (babl_format ("R'G'B' float"), babl_format ("HSL float"));
-  const Babl         *hsl_to_rgb_fish = babl_fish (babl_format ("HSL float"), babl_format ("R'G'B' float"));
+  GimpMybrushDab      dab;
 
-  const float one_over_radius2 = 1.0f / (radius * radius);
   const double angle_rad = angle / 360 * 2 * M_PI;
-  const float cs = cos(angle_rad);
-  const float sn = sin(angle_rad);
-  float normal_mode;
-  float segment1_slope;
-  float segment2_slope;
-  float r_aa_start;
-
-  hardness = CLAMP (hardness, 0.0f, 1.0f);
-  segment1_slope = -(1.0f / hardness - 1.0f);
-  segment2_slope = -hardness / (1.0f - hardness);
-  aspect_ratio = MAX (1.0f, aspect_ratio);
-
-  r_aa_start = radius - 1.0f;
-  r_aa_start = MAX (r_aa_start, 0);
-  r_aa_start = (r_aa_start * r_aa_start) / aspect_ratio;
-
-  normal_mode = opaque * (1.0f - colorize);
-  colorize = opaque * colorize;
 
   /* FIXME: This should use the real matrix values to trim aspect_ratio dabs */
   x += surface->off_x;
   y += surface->off_y;
-  dabRect = calculate_dab_roi (x, y, radius);
-  gegl_rectangle_intersect (&dabRect, &dabRect, gegl_buffer_get_extent (surface->buffer));
+  dab.rect = calculate_dab_roi (x, y, radius);
+  gegl_rectangle_intersect (&dab.rect, &dab.rect, gegl_buffer_get_extent (surface->buffer));
 
-  if (dabRect.width <= 0 || dabRect.height <= 0)
+  if (dab.rect.width <= 0 || dab.rect.height <= 0)
     return 0;
 
-  gegl_rectangle_bounding_box (&surface->dirty, &surface->dirty, &dabRect);
+  gegl_rectangle_bounding_box (&surface->dirty, &surface->dirty, &dab.rect);
+
+  dab.x                = x;
+  dab.y                = y;
+  dab.radius           = radius;
+  dab.one_over_radius2 = 1.0f / (radius * radius);
+  dab.cs               = cos (angle_rad);
+  dab.sn               = sin (angle_rad);
+
+  dab.hardness       = CLAMP (hardness, 0.0f, 1.0f);
+  dab.segment1_slope = -(1.0f / dab.hardness - 1.0f);
+  dab.segment2_slope = -dab.hardness / (1.0f - dab.hardness);
+  dab.aspect_ratio   = MAX (1.0f, aspect_ratio);
+
+  dab.r_aa_start = radius - 1.0f;
+  dab.r_aa_start = MAX (dab.r_aa_start, 0);
+  dab.r_aa_start = (dab.r_aa_start * dab.r_aa_start) / dab.aspect_ratio;
+
+  dab.normal_mode = opaque * (1.0f - colorize);
+  dab.colorize    = opaque * colorize;
+
+  dab.color[0] = color_r;
+  dab.color[1] = color_g;
+  dab.color[2] = color_b;
+  dab.color[3] = color_a;
+
+  if (dab.colorize > 0.0f)
+    {
+      /* Here I am completely unsure if the conversion are
+       * right, regarding color spaces. What is the color space
+       * of color_r/g/b arguments?
+       * TODO: this code should be double-checked.
+       */
+      babl_process (surface->rgb_to_hsl_fish, dab.color, dab.color_hsl, 1);
+    }
+
+  /* The dab is only queued here; dabs are rendered in order, per
+   * tile, when the surface is flushed, see gimp_mypaint_surface_flush().
+   */
+  g_array_append_val (surface->dabs, dab);
+
+  return 1;
+}
+
+static void
+gimp_mypaint_surface_render_dab_row (GimpMybrushSurface   *surface,
+                                     const GimpMybrushDab *dab,
+                                     float                *pixel,
+                                     const float          *mask,
+                                     int                   x0,
+                                     int                   iy,
+                                     int                   width,
+                                     float                *scratch)
+{
+  GimpComponentMask  component_mask = surface->component_mask;
+  float             *row_rgb        = scratch;
+  float             *row_hsl        = row_rgb + 3 * width;
+  float             *row_out        = row_hsl + 3 * width;
+  float             *row_a          = row_out + 3 * width;
+  float             *row_base_alpha = row_a + width;
+  float             *row_dst_alpha  = row_base_alpha + width;
+  int                n;
+
+  for (n = 0; n < width; n++)
+    {
+      const float *p = pixel + 4 * n;
+      int          ix = x0 + n;
+      float        rr, base_alpha, alpha, dst_alpha, r, g, b, a;
+
+      if (dab->radius < 3.0f)
+        rr = calculate_rr_antialiased (ix, iy, dab->x, dab->y, dab->aspect_ratio,
+                                       dab->sn, dab->cs, dab->one_over_radius2,
+                                       dab->r_aa_start);
+      else
+        rr = calculate_rr (ix, iy, dab->x, dab->y, dab->aspect_ratio,
+                           dab->sn, dab->cs, dab->one_over_radius2);
+      base_alpha = calculate_alpha_for_rr (rr, dab->hardness,
+                                           dab->segment1_slope,
+                                           dab->segment2_slope);
+      alpha = base_alpha * dab->normal_mode;
+      if (mask)
+        alpha *= mask[n];
+      dst_alpha = p[ALPHA];
+      /* a = alpha * color_a + dst_alpha * (1.0f - alpha);
+       * which converts to: */
+      a = alpha * (dab->color[3] - dst_alpha) + dst_alpha;
+      r = p[RED];
+      g = p[GREEN];
+      b = p[BLUE];
+
+      if (a > 0.0f)
+        {
+          /* By definition the ratio between each color[] and pixel[] component in a non-pre-multipled blend always sums to 1.0f.
+           * Originally this would have been "(color[n] * alpha * color_a + pixel[n] * dst_alpha * (1.0f - alpha)) / a",
+           * instead we only calculate the cheaper term. */
+          float src_term = (alpha * dab->color[3]) / a;
+          float dst_term = 1.0f - src_term;
+          r = dab->color[0] * src_term + r * dst_term;
+          g = dab->color[1] * src_term + g * dst_term;
+          b = dab->color[2] * src_term + b * dst_term;
+        }
+
+      row_rgb[3 * n + 0] = r;
+      row_rgb[3 * n + 1] = g;
+      row_rgb[3 * n + 2] = b;
+      row_a[n]           = a;
+      row_base_alpha[n]  = base_alpha;
+      row_dst_alpha[n]   = dst_alpha;
+    }
+
+  if (dab->colorize > 0.0f)
+    {
+      /* take the brush color's hue and saturation and the blended
+       * pixel's lightness, converting the whole row at once
+       */
+      babl_process (surface->rgb_to_hsl_fish, row_rgb, row_hsl, width);
+
+      for (n = 0; n < width; n++)
+        {
+          row_hsl[3 * n + 0] = dab->color_hsl[0];
+          row_hsl[3 * n + 1] = dab->color_hsl[1];
+        }
+
+      babl_process (surface->hsl_to_rgb_fish, row_hsl, row_out, width);
+
+      for (n = 0; n < width; n++)
+        {
+          float base_alpha = row_base_alpha[n];
+          float dst_alpha  = row_dst_alpha[n];
+          float alpha, a;
+
+          if (base_alpha <= 0.0f)
+            continue;
+
+          alpha = base_alpha * dab->colorize;
+          a = alpha + dst_alpha - alpha * dst_alpha;
+          if (a > 0.0f)
+            {
+              float src_term = alpha / a;
+              float dst_term = 1.0f - src_term;
+
+              row_rgb[3 * n + 0] = row_out[3 * n + 0] * src_term + row_rgb[3 * n + 0] * dst_term;
+              row_rgb[3 * n + 1] = row_out[3 * n + 1] * src_term + row_rgb[3 * n + 1] * dst_term;
+              row_rgb[3 * n + 2] = row_out[3 * n + 2] * src_term + row_rgb[3 * n + 2] * dst_term;
+            }
+          row_a[n] = a;
+        }
+    }
+
+  for (n = 0; n < width; n++)
+    {
+      float r = row_rgb[3 * n + 0];
+      float g = row_rgb[3 * n + 1];
+      float b = row_rgb[3 * n + 2];
+      float a = row_a[n];
+
+      if (surface->options->no_erasing)
+        a = MAX (a, pixel[ALPHA]);
+
+      if (component_mask != GIMP_COMPONENT_MASK_ALL)
+        {
+          if (component_mask & GIMP_COMPONENT_MASK_RED)
+            pixel[RED]   = r;
+          if (component_mask & GIMP_COMPONENT_MASK_GREEN)
+            pixel[GREEN] = g;
+          if (component_mask & GIMP_COMPONENT_MASK_BLUE)
+            pixel[BLUE]  = b;
+          if (component_mask & GIMP_COMPONENT_MASK_ALPHA)
+            pixel[ALPHA] = a;
+        }
+      else
+        {
+          pixel[RED]   = r;
+          pixel[GREEN] = g;
+          pixel[BLUE]  = b;
+          pixel[ALPHA] = a;
+        }
+
+      pixel += 4;
+    }
+}
 
-  iter = gegl_buffer_iterator_new (surface->buffer, &dabRect, 0,
+static void
+gimp_mypaint_surface_render_tile (GimpMybrushSurface *surface,
+                                  GimpMybrushTile    *tile)
+{
+  const GimpMybrushDab *dabs = (const GimpMybrushDab *) surface->dabs->data;
+  GeglBufferIterator   *iter;
+  float                *scratch;
+
+  scratch = g_new (float, 12 * tile->rect.width);
+
+  iter = gegl_buffer_iterator_new (surface->buffer, &tile->rect, 0,
                                    babl_format ("R'G'B'A float"),
                                    GEGL_BUFFER_READWRITE,
                                    GEGL_ABYSS_NONE, 2);
   if (surface->paint_mask)
     {
-      GeglRectangle mask_roi = dabRect;
+      GeglRectangle mask_roi = tile->rect;
       mask_roi.x -= surface->paint_mask_x;
       mask_roi.y -= surface->paint_mask_y;
       gegl_buffer_iterator_add (iter, surface->paint_mask, &mask_roi, 0,
@@ -409,108 +647,89 @@ gimp_mypaint_surface_draw_dab (MyPaintSurface *base_surface,
 
   while (gegl_buffer_iterator_next (iter))
     {
-      float *pixel = (float *)iter->items[0].data;
-      float *mask;
-      int iy, ix;
+      const GeglRectangle *roi = &iter->items[0].roi;
+      float               *data = (float *)iter->items[0].data;
+      float               *mask_data;
+      guint                i;
 
       if (surface->paint_mask)
-        mask = iter->items[1].data;
+        mask_data = iter->items[1].data;
       else
-        mask = NULL;
+        mask_data = NULL;
 
-      for (iy = iter->items[0].roi.y; iy < iter->items[0].roi.y + iter->items[0].roi.height; iy++)
+      /* all of the tile's dabs, in the order they were drawn */
+      for (i = 0; i < tile->dabs->len; i++)
         {
-          for (ix = iter->items[0].roi.x; ix < iter->items[0].roi.x +  iter->items[0].roi.width; ix++)
+          const GimpMybrushDab *dab = &dabs[g_array_index (tile->dabs, guint, i)];
+          GeglRectangle         rect;
+          int                   iy;
+#if COMPILE_SSE2_INTRINISICS
+          gboolean              use_sse2;
+
+          /* the vectorized row covers the common case only */
+          use_sse2 = surface->use_sse2                            &&
+                     dab->radius >= 3.0f                          &&
+                     dab->colorize <= 0.0f                        &&
+                     surface->component_mask == GIMP_COMPONENT_MASK_ALL;
+#endif
+
+          if (! gegl_rectangle_intersect (&rect, &dab->rect, roi))
+            continue;
+
+          for (iy = rect.y; iy < rect.y + rect.height; iy++)
             {
-              float rr, base_alpha, alpha, dst_alpha, r, g, b, a;
-              if (radius < 3.0f)
-                rr = calculate_rr_antialiased (ix, iy, x, y, aspect_ratio, sn, cs, one_over_radius2, r_aa_start);
-              else
-                rr = calculate_rr (ix, iy, x, y, aspect_ratio, sn, cs, one_over_radius2);
-              base_alpha = calculate_alpha_for_rr (rr, hardness, segment1_slope, segment2_slope);
-              alpha = base_alpha * normal_mode;
-              if (mask)
-                alpha *= *mask;
-              dst_alpha = pixel[ALPHA];
-              /* a = alpha * color_a + dst_alpha * (1.0f - alpha);
-               * which converts to: */
-              a = alpha * (color_a - dst_alpha) + dst_alpha;
-              r = pixel[RED];
-              g = pixel[GREEN];
-              b = pixel[BLUE];
-
-              if (a > 0.0f)
-                {
-                  /* By definition the ratio between each color[] and pixel[] component in a non-pre-multipled blend always sums to 1.0f.
-                   * Originally this would have been "(color[n] * alpha * color_a + pixel[n] * dst_alpha * (1.0f - alpha)) / a",
-                   * instead we only calculate the cheaper term. */
-                  float src_term = (alpha * color_a) / a;
-                  float dst_term = 1.0f - src_term;
-                  r = color_r * src_term + r * dst_term;
-                  g = color_g * src_term + g * dst_term;
-                  b = color_b * src_term + b * dst_term;
-                }
-
-              if (colorize > 0.0f && base_alpha > 0.0f)
+              gint   offset = (iy - roi->y) * roi->width + (rect.x - roi->x);
+              float *pixel  = data + 4 * offset;
+              float *mask   = mask_data ? mask_data + offset : NULL;
+              int    ix     = rect.x;
+              int    width  = rect.width;
+
+#if COMPILE_SSE2_INTRINISICS
+              if (use_sse2)
                 {
-                  alpha = base_alpha * colorize;
-                  a = alpha + dst_alpha - alpha * dst_alpha;
-                  if (a > 0.0f)
-                    {
-                      float pixel_hsl[3], out_hsl[3];
-                      float pixel_rgb[3] = {color_r, color_g, color_b};
-                      float out_rgb[3]   = {r, g, b};
-                      float src_term     = alpha / a;
-                      float dst_term     = 1.0f - src_term;
-
-                      /* Here I am completely unsure if the conversion are
-                       * right, regarding color spaces. What is the color space
-                       * of color_r/g/b arguments?
-                       * TODO: this code should be double-checked.
-                       */
-                      babl_process (rgb_to_hsl_fish, pixel_rgb, pixel_hsl, 1);
-                      babl_process (rgb_to_hsl_fish, out_rgb, out_hsl, 1);
-
-                      out_hsl[0] = pixel_hsl[0];
-                      out_hsl[1] = pixel_hsl[1];
-                      babl_process (hsl_to_rgb_fish, out_hsl, out_rgb, 1);
-
-                      r = (float)out_rgb[0] * src_term + r * dst_term;
-                      g = (float)out_rgb[1] * src_term + g * dst_term;
-                      b = (float)out_rgb[2] * src_term + b * dst_term;
-                    }
+                  int n;
+
+                  n = gimp_mybrush_surface_draw_dab_row_sse2 (
+                    pixel, mask, ix, width,
+                    dab->x, iy + 0.5f - dab->y,
+                    dab->aspect_ratio, dab->sn, dab->cs,
+                    dab->one_over_radius2,
+                    dab->hardness, dab->segment1_slope, dab->segment2_slope,
+                    dab->normal_mode, dab->color,
+                    surface->options->no_erasing);
+
+                  ix    += n;
+                  width -= n;
+                  pixel += 4 * n;
+                  if (mask)
+                    mask += n;
                 }
+#endif
 
-              if (surface->options->no_erasing)
-                a = MAX (a, pixel[ALPHA]);
-
-              if (component_mask != GIMP_COMPONENT_MASK_ALL)
-                {
-                  if (component_mask & GIMP_COMPONENT_MASK_RED)
-                    pixel[RED]   = r;
-                  if (component_mask & GIMP_COMPONENT_MASK_GREEN)
-                    pixel[GREEN] = g;
-                  if (component_mask & GIMP_COMPONENT_MASK_BLUE)
-                    pixel[BLUE]  = b;
-                  if (component_mask & GIMP_COMPONENT_MASK_ALPHA)
-                    pixel[ALPHA] = a;
-                }
-              else
+              if (width > 0)
                 {
-                  pixel[RED]   = r;
-                  pixel[GREEN] = g;
-                  pixel[BLUE]  = b;
-                  pixel[ALPHA] = a;
+                  gimp_mypaint_surface_render_dab_row (surface, dab,
+                                                       pixel, mask,
+                                                       ix, iy, width,
+                                                       scratch);
                 }
-
-              pixel += 4;
-              if (mask)
-                mask += 1;
             }
         }
     }
 
-  return 1;
+  g_free (scratch);
+}
+
+static void
+gimp_mypaint_surface_render_tiles (gint     i,
+                                   gint     n,
+                                   gpointer user_data)
+{
+  RenderTilesData *data = user_data;
+  gint             t;
+
+  for (t = i; t < data->n_tiles; t += n)
+    gimp_mypaint_surface_render_tile (data->surface, data->tiles[t]);
 }
 
 static void
@@ -525,6 +744,8 @@ gimp_mypaint_surface_end_atomic (MyPaintSurface   *base_surface,
 {
   GimpMybrushSurface *surface = (GimpMybrushSurface *)base_surface;
 
+  gimp_mypaint_surface_flush (surface);
+
   roi->x         = surface->dirty.x;
   roi->y         = surface->dirty.y;
   roi->width     = surface->dirty.width;
@@ -537,8 +758,11 @@ gimp_mypaint_surface_destroy (MyPaintSurface *base_surface)
 {
   GimpMybrushSurface *surface = (GimpMybrushSurface *)base_surface;
 
+  gimp_mypaint_surface_flush (surface);
+
   g_clear_object (&surface->buffer);
   g_clear_object (&surface->paint_mask);
+  g_array_free (surface->dabs, TRUE);
   g_free (surface);
 }
 
@@ -572,6 +796,20 @@ gimp_mypaint_surface_new (GeglBuffer         *buffer,
   surface->off_x                = 0;
   surface->off_y                = 0;
 
+  surface->dabs                 = g_array_new (FALSE, FALSE,
+                                               sizeof (GimpMybrushDab));
+
+  /* XXX What spaces should we be working from and to? */
+  surface->rgb_to_hsl_fish      = babl_fish (babl_format ("R'G'B' float"),
+                                             babl_format ("HSL float"));
+  surface->hsl_to_rgb_fish      = babl_fish (babl_format ("HSL float"),
+                                             babl_format ("R'G'B' float"));
+
+#if COMPILE_SSE2_INTRINISICS
+  surface->use_sse2             = (gimp_cpu_accel_get_support () &
+                                   GIMP_CPU_ACCEL_X86_SSE2) != 0;
+#endif
+
   return surface;
 }
 
@@ -581,6 +819,8 @@ gimp_mypaint_surface_set_buffer (GimpMybrushSurface *surface,
                                  gint                paint_mask_x,
                                  gint                paint_mask_y)
 {
+  gimp_mypaint_surface_flush (surface);
+
   g_object_unref (surface->buffer);
 
   surface->buffer = g_object_ref (buffer);
@@ -606,3 +846,112 @@ gimp_mypaint_surface_get_offset (GimpMybrushSurface *surface,
   *off_x = surface->off_x;
   *off_y = surface->off_y;
 }
+
+/* Renders the queued dabs.  The dabs are sorted into per-tile lists,
+ * keeping their drawing order, and the touched tiles are rendered in
+ * parallel, so that each tile is fetched once per batch rather than
+ * once per dab.
+ */
+void
+gimp_mypaint_surface_flush (GimpMybrushSurface *surface)
+{
+  const GimpMybrushDab  *dabs;
+  GimpMybrushTile       *grid;
+  GimpMybrushTile      **tiles;
+  GeglRectangle          bounds   = { 0, };
+  gint                   tile_width;
+  gint                   tile_height;
+  gint                   tx0, ty0;
+  gint                   n_tx, n_ty;
+  gint                   n_tiles = 0;
+  gdouble                n_pixels = 0.0;
+  guint                  i;
+  gint                   t;
+
+  if (surface->dabs->len == 0)
+    return;
+
+  dabs = (const GimpMybrushDab *) surface->dabs->data;
+
+  for (i = 0; i < surface->dabs->len; i++)
+    gegl_rectangle_bounding_box (&bounds, &bounds, &dabs[i].rect);
+
+  g_object_get (surface->buffer,
+                "tile-width",  &tile_width,
+                "tile-height", &tile_height,
+                NULL);
+
+  tx0  = floor ((gdouble) bounds.x / tile_width);
+  ty0  = floor ((gdouble) bounds.y / tile_height);
+  n_tx = ceil ((gdouble) (bounds.x + bounds.width) / tile_width)  - tx0;
+  n_ty = ceil ((gdouble) (bounds.y + bounds.height) / tile_height) - ty0;
+
+  grid  = g_new0 (GimpMybrushTile, n_tx * n_ty);
+  tiles = g_new (GimpMybrushTile *, n_tx * n_ty);
+
+  for (i = 0; i < surface->dabs->len; i++)
+    {
+      const GeglRectangle *rect = &dabs[i].rect;
+      gint                 x1   = floor ((gdouble) rect->x / tile_width) - tx0;
+      gint                 y1   = floor ((gdouble) rect->y / tile_height) - ty0;
+      gint                 x2   = floor ((gdouble) (rect->x + rect->width - 1) /
+                                         tile_width) - tx0;
+      gint                 y2   = floor ((gdouble) (rect->y + rect->height - 1) /
+                                         tile_height) - ty0;
+      gint                 tx, ty;
+
+      for (ty = y1; ty <= y2; ty++)
+        {
+          for (tx = x1; tx <= x2; tx++)
+            {
+              GimpMybrushTile *tile = &grid[ty * n_tx + tx];
+              GeglRectangle    piece;
+
+              gegl_rectangle_set (&piece,
+                                  (tx0 + tx) * tile_width,
+                                  (ty0 + ty) * tile_height,
+                                  tile_width,
+                                  tile_height);
+              gegl_rectangle_intersect (&piece, &piece, rect);
+
+              if (! tile->dabs)
+                {
+                  tile->dabs = g_array_new (FALSE, FALSE, sizeof (guint));
+                  tile->rect = piece;
+
+                  tiles[n_tiles++] = tile;
+                }
+              else
+                {
+                  gegl_rectangle_bounding_box (&tile->rect, &tile->rect, &piece);
+                }
+
+              g_array_append_val (tile->dabs, i);
+            }
+        }
+    }
+
+  for (t = 0; t < n_tiles; t++)
+    n_pixels += (gdouble) tiles[t]->rect.width * tiles[t]->rect.height;
+
+  {
+    RenderTilesData data;
+
+    data.surface = surface;
+    data.tiles   = tiles;
+    data.n_tiles = n_tiles;
+
+    gegl_parallel_distribute (CLAMP ((gint) (n_pixels / PIXELS_PER_THREAD),
+                                     1, n_tiles),
+                              gimp_mypaint_surface_render_tiles,
+                              &data);
+  }
+
+  for (t = 0; t < n_tiles; t++)
+    g_array_free (tiles[t]->dabs, TRUE);
+
+  g_free (tiles);
+  g_free (grid);
+
+  g_array_set_size (surface->dabs, 0);
+}
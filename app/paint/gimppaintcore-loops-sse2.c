@@ -0,0 +1,74 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "config.h"
+
+#include <glib.h>
+
+#include "gimppaintcore-loops-sse2.h"
+
+
+#if COMPILE_SSE2_INTRINISICS
+
+#include <emmintrin.h>
+
+
+/*  the non-stipple COMBINE_PAINT_MASK_TO_CANVAS_BUFFER kernel, for
+ *  float paint masks:
+ *
+ *    if (opacity > canvas)
+ *      canvas += (opacity - canvas) * mask * opacity;
+ */
+void
+gimp_paint_core_loops_combine_paint_mask_sse2 (gfloat       *canvas,
+                                               const gfloat *mask,
+                                               gint          count,
+                                               gfloat        opacity)
+{
+  const __m128 v_opacity = _mm_set1_ps (opacity);
+
+  for (; count >= 4; count -= 4)
+    {
+      __m128 v_canvas = _mm_loadu_ps (canvas);
+      __m128 v_mask   = _mm_loadu_ps (mask);
+      __m128 v_below  = _mm_cmpgt_ps (v_opacity, v_canvas);
+      __m128 v_delta;
+
+      v_delta = _mm_mul_ps (_mm_mul_ps (_mm_sub_ps (v_opacity, v_canvas),
+                                        v_mask),
+                            v_opacity);
+
+      v_canvas = _mm_add_ps (v_canvas, _mm_and_ps (v_delta, v_below));
+
+      _mm_storeu_ps (canvas, v_canvas);
+
+      canvas += 4;
+      mask   += 4;
+    }
+
+  for (; count; count--)
+    {
+      if (opacity > *canvas)
+        *canvas += (opacity - *canvas) * *mask * opacity;
+
+      canvas++;
+      mask++;
+    }
+}
+
+#endif /* COMPILE_SSE2_INTRINISICS */
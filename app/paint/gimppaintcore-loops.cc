@@ -22,6 +22,8 @@
 extern "C"
 {
 
+#include "libgimpbase/gimpbase.h"
+
 #include "paint-types.h"
 
 #include "gegl/gimp-babl.h"
@@ -35,6 +37,7 @@ extern "C"
 #include "operations/layer-modes/gimpoperationlayermode.h"
 
 #include "gimppaintcore-loops.h"
+#include "gimppaintcore-loops-sse2.h"
 
 } /* extern "C" */
 
@@ -229,6 +232,71 @@ static inline gfloat
 value_to_float (T value) = delete;
 
 
+/* combine_paint_mask_row():
+ *
+ * Combines a row of the paint mask into the canvas buffer, as done by the
+ * non-stipple COMBINE_PAINT_MASK_TO_CANVAS_BUFFER algorithm.  Float paint
+ * masks use a SIMD kernel, when available.
+ */
+
+template <class T>
+static inline void
+combine_paint_mask_row_generic (const GimpPaintCoreLoopsParams *params,
+                                gfloat                         *canvas_pixel,
+                                const T                        *mask_pixel,
+                                gint                            width)
+{
+  gint x;
+
+  for (x = 0; x < width; x++)
+    {
+      if (params->paint_opacity > canvas_pixel[0])
+        {
+          canvas_pixel[0] += (params->paint_opacity - canvas_pixel[0]) *
+                             value_to_float (*mask_pixel)               *
+                             params->paint_opacity;
+        }
+
+      mask_pixel   += 1;
+      canvas_pixel += 1;
+    }
+}
+
+template <class T>
+static inline void
+combine_paint_mask_row (const GimpPaintCoreLoopsParams *params,
+                        gfloat                         *canvas_pixel,
+                        const T                        *mask_pixel,
+                        gint                            width)
+{
+  combine_paint_mask_row_generic (params, canvas_pixel, mask_pixel, width);
+}
+
+static inline void
+combine_paint_mask_row (const GimpPaintCoreLoopsParams *params,
+                        gfloat                         *canvas_pixel,
+                        const gfloat                   *mask_pixel,
+                        gint                            width)
+{
+#if COMPILE_SSE2_INTRINISICS
+  static const gboolean sse2 = (gimp_cpu_accel_get_support () &
+                                GIMP_CPU_ACCEL_X86_SSE2);
+
+  if (sse2)
+    {
+      gimp_paint_core_loops_combine_paint_mask_sse2 (canvas_pixel,
+                                                     mask_pixel,
+                                                     width,
+                                                     params->paint_opacity);
+
+      return;
+    }
+#endif /* COMPILE_SSE2_INTRINISICS */
+
+  combine_paint_mask_row_generic (params, canvas_pixel, mask_pixel, width);
+}
+
+
 /* AlgorithmBase:
  *
  * The base class of the algorithm hierarchy.
@@ -1205,24 +1273,28 @@ struct CombinePaintMaskToCanvasBufferToPaintBufAlpha : Base
     gfloat          *paint_pixel  = &this->paint_data[paint_offset];
     gint             x;
 
-    for (x = 0; x < rect->width; x++)
+    if (! Base::stipple)
       {
-        if (Base::stipple)
-          {
-            state->canvas_pixel[0] += (1.0 - state->canvas_pixel[0])  *
-                                      value_to_float (*mask_pixel)    *
-                                      params->paint_opacity;
-          }
-        else
+        combine_paint_mask_row (params, state->canvas_pixel, mask_pixel,
+                                rect->width);
+
+        for (x = 0; x < rect->width; x++)
           {
-            if (params->paint_opacity > state->canvas_pixel[0])
-              {
-                state->canvas_pixel[0] += (params->paint_opacity - state->canvas_pixel[0]) *
-                                           value_to_float (*mask_pixel)                    *
-                                           params->paint_opacity;
-              }
+            paint_pixel[3] *= state->canvas_pixel[0];
+
+            state->canvas_pixel += 1;
+            paint_pixel         += 4;
           }
 
+        return;
+      }
+
+    for (x = 0; x < rect->width; x++)
+      {
+        state->canvas_pixel[0] += (1.0 - state->canvas_pixel[0])  *
+                                  value_to_float (*mask_pixel)    *
+                                  params->paint_opacity;
+
         paint_pixel[3] *= state->canvas_pixel[0];
 
         mask_pixel          += 1;
@@ -1303,23 +1375,21 @@ struct CombinePaintMaskToCanvasBuffer : Base
     const mask_type *mask_pixel  = &this->mask_data[mask_offset];
     gint             x;
 
+    if (! Base::stipple)
+      {
+        combine_paint_mask_row (params, state->canvas_pixel, mask_pixel,
+                                rect->width);
+
+        state->canvas_pixel += rect->width;
+
+        return;
+      }
+
     for (x = 0; x < rect->width; x++)
       {
-        if (Base::stipple)
-          {
-            state->canvas_pixel[0] += (1.0 - state->canvas_pixel[0]) *
-                                      value_to_float (*mask_pixel)   *
-                                      params->paint_opacity;
-          }
-        else
-          {
-            if (params->paint_opacity > state->canvas_pixel[0])
-              {
-                state->canvas_pixel[0] += (params->paint_opacity - state->canvas_pixel[0]) *
-                                          value_to_float (*mask_pixel)                     *
-                                          params->paint_opacity;
-              }
-          }
+        state->canvas_pixel[0] += (1.0 - state->canvas_pixel[0]) *
+                                  value_to_float (*mask_pixel)   *
+                                  params->paint_opacity;
 
         mask_pixel          += 1;
         state->canvas_pixel += 1;
@@ -53,6 +53,7 @@
 #include "plug-in/gimppluginmanager.h"
 
 #include "gimppdb.h"
+#include "gimppdberror.h"
 #include "gimppdb-utils.h"
 #include "gimppdbcontext.h"
 #include "gimpprocedure.h"
@@ -61,6 +62,26 @@
 #include "gimp-intl.h"
 
 
+static const Babl *
+drawable_pixels_format (GimpDrawable  *drawable,
+                        const gchar   *format,
+                        GError       **error)
+{
+  const Babl *drawable_format = gimp_drawable_get_format (drawable);
+
+  if (! format || ! *format)
+    return drawable_format;
+
+  if (! babl_format_exists (format))
+    {
+      g_set_error (error, GIMP_PDB_ERROR, GIMP_PDB_ERROR_INVALID_ARGUMENT,
+                   _("'%s' is not a valid pixel format."), format);
+      return NULL;
+    }
+
+  return babl_format_with_space (format, drawable_format);
+}
+
 static GimpValueArray *
 drawable_get_format_invoker (GimpProcedure         *procedure,
                              Gimp                  *gimp,
@@ -215,6 +236,166 @@ drawable_set_pixel_invoker (GimpProcedure         *procedure,
                                            error ? *error : NULL);
 }
 
+static GimpValueArray *
+drawable_get_pixels_invoker (GimpProcedure         *procedure,
+                             Gimp                  *gimp,
+                             GimpContext           *context,
+                             GimpProgress          *progress,
+                             const GimpValueArray  *args,
+                             GError               **error)
+{
+  gboolean success = TRUE;
+  GimpValueArray *return_vals;
+  GimpDrawable *drawable;
+  gint x;
+  gint y;
+  gint width;
+  gint height;
+  const gchar *format;
+  GBytes *pixels = NULL;
+
+  drawable = g_value_get_object (gimp_value_array_index (args, 0));
+  x = g_value_get_int (gimp_value_array_index (args, 1));
+  y = g_value_get_int (gimp_value_array_index (args, 2));
+  width = g_value_get_int (gimp_value_array_index (args, 3));
+  height = g_value_get_int (gimp_value_array_index (args, 4));
+  format = g_value_get_string (gimp_value_array_index (args, 5));
+
+  if (success)
+    {
+      const Babl *pixel_format;
+
+      pixel_format = drawable_pixels_format (drawable, format, error);
+
+      if (pixel_format &&
+          ((gint64) x + width  > gimp_item_get_width  (GIMP_ITEM (drawable)) ||
+           (gint64) y + height > gimp_item_get_height (GIMP_ITEM (drawable))))
+        {
+          g_set_error (error, GIMP_PDB_ERROR, GIMP_PDB_ERROR_INVALID_ARGUMENT,
+                       _("The region (%d, %d) %d x %d is not within the "
+                         "bounds of drawable '%s'."),
+                       x, y, width, height,
+                       gimp_object_get_name (drawable));
+          success = FALSE;
+        }
+      else if (pixel_format)
+        {
+          gsize   rowstride = (gsize) width *
+                              babl_format_get_bytes_per_pixel (pixel_format);
+          gsize   size      = rowstride * height;
+          guchar *data      = NULL;
+
+          if (size <= G_MAXUINT32)
+            data = g_try_malloc (size);
+
+          if (data)
+            {
+              gegl_buffer_get (gimp_drawable_get_buffer (drawable),
+                               GEGL_RECTANGLE (x, y, width, height), 1.0,
+                               pixel_format, data, rowstride,
+                               GEGL_ABYSS_NONE);
+
+              pixels = g_bytes_new_take (data, size);
+            }
+          else
+            {
+              g_set_error_literal (error,
+                                   GIMP_PDB_ERROR,
+                                   GIMP_PDB_ERROR_INVALID_ARGUMENT,
+                                   _("The region is too large."));
+              success = FALSE;
+            }
+        }
+      else
+        success = FALSE;
+    }
+
+  return_vals = gimp_procedure_get_return_values (procedure, success,
+                                                  error ? *error : NULL);
+
+  if (success)
+    g_value_take_boxed (gimp_value_array_index (return_vals, 1), pixels);
+
+  return return_vals;
+}
+
+static GimpValueArray *
+drawable_set_pixels_invoker (GimpProcedure         *procedure,
+                             Gimp                  *gimp,
+                             GimpContext           *context,
+                             GimpProgress          *progress,
+                             const GimpValueArray  *args,
+                             GError               **error)
+{
+  gboolean success = TRUE;
+  GimpDrawable *drawable;
+  gint x;
+  gint y;
+  gint width;
+  gint height;
+  const gchar *format;
+  GBytes *pixels;
+
+  drawable = g_value_get_object (gimp_value_array_index (args, 0));
+  x = g_value_get_int (gimp_value_array_index (args, 1));
+  y = g_value_get_int (gimp_value_array_index (args, 2));
+  width = g_value_get_int (gimp_value_array_index (args, 3));
+  height = g_value_get_int (gimp_value_array_index (args, 4));
+  format = g_value_get_string (gimp_value_array_index (args, 5));
+  pixels = g_value_get_boxed (gimp_value_array_index (args, 6));
+
+  if (success)
+    {
+      const Babl *pixel_format = NULL;
+
+      if (gimp_pdb_item_is_modifiable (GIMP_ITEM (drawable),
+                                       GIMP_PDB_ITEM_CONTENT, error) &&
+          gimp_pdb_item_is_not_group (GIMP_ITEM (drawable), error))
+        pixel_format = drawable_pixels_format (drawable, format, error);
+
+      if (pixel_format &&
+          ((gint64) x + width  > gimp_item_get_width  (GIMP_ITEM (drawable)) ||
+           (gint64) y + height > gimp_item_get_height (GIMP_ITEM (drawable))))
+        {
+          g_set_error (error, GIMP_PDB_ERROR, GIMP_PDB_ERROR_INVALID_ARGUMENT,
+                       _("The region (%d, %d) %d x %d is not within the "
+                         "bounds of drawable '%s'."),
+                       x, y, width, height,
+                       gimp_object_get_name (drawable));
+          success = FALSE;
+        }
+      else if (pixel_format)
+        {
+          gsize rowstride = (gsize) width *
+                            babl_format_get_bytes_per_pixel (pixel_format);
+
+          if (g_bytes_get_size (pixels) == rowstride * height)
+            {
+              gegl_buffer_set (gimp_drawable_get_buffer (drawable),
+                               GEGL_RECTANGLE (x, y, width, height), 0,
+                               pixel_format,
+                               g_bytes_get_data (pixels, NULL), rowstride);
+
+              gimp_drawable_update (drawable, x, y, width, height);
+            }
+          else
+            {
+              g_set_error_literal (error,
+                                   GIMP_PDB_ERROR,
+                                   GIMP_PDB_ERROR_INVALID_ARGUMENT,
+                                   _("The size of the pixel data does not "
+                                     "match the region and format."));
+              success = FALSE;
+            }
+        }
+      else
+        success = FALSE;
+    }
+
+  return gimp_procedure_get_return_values (procedure, success,
+                                           error ? *error : NULL);
+}
+
 static GimpValueArray *
 drawable_type_invoker (GimpProcedure         *procedure,
                        Gimp                  *gimp,
@@ -1143,6 +1324,129 @@ register_drawable_procs (GimpPDB *pdb)
   gimp_pdb_register_procedure (pdb, procedure);
   g_object_unref (procedure);
 
+  /*
+   * gimp-drawable-get-pixels
+   */
+  procedure = gimp_procedure_new (drawable_get_pixels_invoker);
+  gimp_object_set_static_name (GIMP_OBJECT (procedure),
+                               "gimp-drawable-get-pixels");
+  gimp_procedure_set_static_help (procedure,
+                                  "Gets the pixels of a region of the drawable.",
+                                  "This procedure gets the pixels of the rectangular region at the specified coordinates, as @height rows of @width pixels in the specified format, without any padding between rows.\n"
+                                  "\n"
+                                  "The format is the name of a Babl encoding, such as \"R'G'B'A u8\", and is used in the color space of the drawable. An empty format gets the pixels in the drawable's own format, as returned by 'gimp-drawable-get-format'.",
+                                  NULL);
+  gimp_procedure_set_static_attribution (procedure,
+                                         "Spencer Kimball & Peter Mattis",
+                                         "Spencer Kimball & Peter Mattis",
+                                         "1995-1996");
+  gimp_procedure_add_argument (procedure,
+                               gimp_param_spec_drawable ("drawable",
+                                                         "drawable",
+                                                         "The drawable",
+                                                         FALSE,
+                                                         GIMP_PARAM_READWRITE));
+  gimp_procedure_add_argument (procedure,
+                               g_param_spec_int ("x",
+                                                 "x",
+                                                 "The x coordinate of the region",
+                                                 0, G_MAXINT32, 0,
+                                                 GIMP_PARAM_READWRITE));
+  gimp_procedure_add_argument (procedure,
+                               g_param_spec_int ("y",
+                                                 "y",
+                                                 "The y coordinate of the region",
+                                                 0, G_MAXINT32, 0,
+                                                 GIMP_PARAM_READWRITE));
+  gimp_procedure_add_argument (procedure,
+                               g_param_spec_int ("width",
+                                                 "width",
+                                                 "The width of the region",
+                                                 1, G_MAXINT32, 1,
+                                                 GIMP_PARAM_READWRITE));
+  gimp_procedure_add_argument (procedure,
+                               g_param_spec_int ("height",
+                                                 "height",
+                                                 "The height of the region",
+                                                 1, G_MAXINT32, 1,
+                                                 GIMP_PARAM_READWRITE));
+  gimp_procedure_add_argument (procedure,
+                               gimp_param_spec_string ("format",
+                                                       "format",
+                                                       "The Babl encoding of the pixels",
+                                                       FALSE, TRUE, FALSE,
+                                                       NULL,
+                                                       GIMP_PARAM_READWRITE));
+  gimp_procedure_add_return_value (procedure,
+                                   g_param_spec_boxed ("pixels",
+                                                       "pixels",
+                                                       "The pixels of the region",
+                                                       G_TYPE_BYTES,
+                                                       GIMP_PARAM_READWRITE));
+  gimp_pdb_register_procedure (pdb, procedure);
+  g_object_unref (procedure);
+
+  /*
+   * gimp-drawable-set-pixels
+   */
+  procedure = gimp_procedure_new (drawable_set_pixels_invoker);
+  gimp_object_set_static_name (GIMP_OBJECT (procedure),
+                               "gimp-drawable-set-pixels");
+  gimp_procedure_set_static_help (procedure,
+                                  "Sets the pixels of a region of the drawable.",
+                                  "This procedure sets the pixels of the rectangular region at the specified coordinates from @height rows of @width pixels in the specified format, without any padding between rows. See 'gimp-drawable-get-pixels' for the format.\n"
+                                  "Note that this function is not undoable, you should use it only on drawables you just created yourself.",
+                                  NULL);
+  gimp_procedure_set_static_attribution (procedure,
+                                         "Spencer Kimball & Peter Mattis",
+                                         "Spencer Kimball & Peter Mattis",
+                                         "1995-1996");
+  gimp_procedure_add_argument (procedure,
+                               gimp_param_spec_drawable ("drawable",
+                                                         "drawable",
+                                                         "The drawable",
+                                                         FALSE,
+                                                         GIMP_PARAM_READWRITE));
+  gimp_procedure_add_argument (procedure,
+                               g_param_spec_int ("x",
+                                                 "x",
+                                                 "The x coordinate of the region",
+                                                 0, G_MAXINT32, 0,
+                                                 GIMP_PARAM_READWRITE));
+  gimp_procedure_add_argument (procedure,
+                               g_param_spec_int ("y",
+                                                 "y",
+                                                 "The y coordinate of the region",
+                                                 0, G_MAXINT32, 0,
+                                                 GIMP_PARAM_READWRITE));
+  gimp_procedure_add_argument (procedure,
+                               g_param_spec_int ("width",
+                                                 "width",
+                                                 "The width of the region",
+                                                 1, G_MAXINT32, 1,
+                                                 GIMP_PARAM_READWRITE));
+  gimp_procedure_add_argument (procedure,
+                               g_param_spec_int ("height",
+                                                 "height",
+                                                 "The height of the region",
+                                                 1, G_MAXINT32, 1,
+                                                 GIMP_PARAM_READWRITE));
+  gimp_procedure_add_argument (procedure,
+                               gimp_param_spec_string ("format",
+                                                       "format",
+                                                       "The Babl encoding of the pixels",
+                                                       FALSE, TRUE, FALSE,
+                                                       NULL,
+                                                       GIMP_PARAM_READWRITE));
+  gimp_procedure_add_argument (procedure,
+                               g_param_spec_boxed ("pixels",
+                                                   "pixels",
+                                                   "The pixels of the region",
+                                                   G_TYPE_BYTES,
+                                                   GIMP_PARAM_READWRITE));
+  gimp_pdb_register_procedure (pdb, procedure);
+  g_object_unref (procedure);
+
   /*
    * gimp-drawable-type
    */
@@ -63,8 +63,16 @@ static void gimp_plug_in_handle_tile_put         (GimpPlugIn      *plug_in,
                                                   GPTileReq       *request);
 static void gimp_plug_in_handle_tile_get         (GimpPlugIn      *plug_in,
                                                   GPTileReq       *request);
+static GimpValueArray *
+            gimp_plug_in_execute_proc_run        (GimpPlugIn      *plug_in,
+                                                  GPProcRun       *proc_run,
+                                                  GPProcBatchRef  *refs,
+                                                  guint            n_refs,
+                                                  GimpValueArray **results);
 static void gimp_plug_in_handle_proc_run         (GimpPlugIn      *plug_in,
                                                   GPProcRun       *proc_run);
+static void gimp_plug_in_handle_proc_batch       (GimpPlugIn      *plug_in,
+                                                  GPProcBatch     *proc_batch);
 static void gimp_plug_in_handle_proc_return      (GimpPlugIn      *plug_in,
                                                   GPProcReturn    *proc_return);
 static void gimp_plug_in_handle_temp_proc_return (GimpPlugIn      *plug_in,
@@ -160,6 +168,19 @@ gimp_plug_in_handle_message (GimpPlugIn      *plug_in,
     case GP_HAS_INIT:
       gimp_plug_in_handle_has_init (plug_in);
       break;
+
+    case GP_PROC_BATCH:
+      gimp_plug_in_handle_proc_batch (plug_in, msg->data);
+      break;
+
+    case GP_PROC_BATCH_RETURN:
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "Plug-in \"%s\"\n(%s)\n\n"
+                    "sent a PROC_BATCH_RETURN message.  This should not happen.",
+                    gimp_object_get_name (plug_in),
+                    gimp_file_get_utf8_name (plug_in->file));
+      gimp_plug_in_close (plug_in, TRUE);
+      break;
     }
 }
 
@@ -496,9 +517,15 @@ gimp_plug_in_handle_proc_error (GimpPlugIn          *plug_in,
     }
 }
 
-static void
-gimp_plug_in_handle_proc_run (GimpPlugIn *plug_in,
-                              GPProcRun  *proc_run)
+/*  Executes @proc_run.  For calls of a batch, @refs replace arguments
+ *  by return values of the batch's earlier calls, which are @results.
+ */
+static GimpValueArray *
+gimp_plug_in_execute_proc_run (GimpPlugIn      *plug_in,
+                               GPProcRun       *proc_run,
+                               GPProcBatchRef  *refs,
+                               guint            n_refs,
+                               GimpValueArray **results)
 {
   GimpPlugInProcFrame *proc_frame;
   gchar               *canonical;
@@ -507,9 +534,7 @@ gimp_plug_in_handle_proc_run (GimpPlugIn *plug_in,
   GimpValueArray      *args        = NULL;
   GimpValueArray      *return_vals = NULL;
   GError              *error       = NULL;
-
-  g_return_if_fail (proc_run != NULL);
-  g_return_if_fail (proc_run->name != NULL);
+  guint                i;
 
   canonical = gimp_canonicalize_identifier (proc_run->name);
 
@@ -576,20 +601,80 @@ gimp_plug_in_handle_proc_run (GimpPlugIn *plug_in,
                                          proc_run->n_params,
                                          FALSE);
 
-  /*  Execute the procedure even if gimp_pdb_lookup_procedure()
-   *  returned NULL, gimp_pdb_execute_procedure_by_name_args() will
-   *  return appropriate error return_vals.
-   */
-  gimp_plug_in_manager_plug_in_push (plug_in->manager, plug_in);
-  return_vals = gimp_pdb_execute_procedure_by_name_args (plug_in->manager->gimp->pdb,
-                                                         proc_frame->context_stack ?
-                                                         proc_frame->context_stack->data :
-                                                         proc_frame->main_context,
-                                                         proc_frame->progress,
-                                                         &error,
-                                                         proc_name,
-                                                         args);
-  gimp_plug_in_manager_plug_in_pop (plug_in->manager);
+  for (i = 0; i < n_refs && procedure && ! error; i++)
+    {
+      GimpValueArray *result = results[refs[i].call];
+      GValue         *src;
+      GValue         *dest;
+
+      /*  The indices are 0-based, like the value arrays, where return
+       *  value 0 is the status.  Messages number arguments from 1, as
+       *  gimp_procedure_validate_args() does, which makes return value
+       *  #1 the first actual one.
+       */
+      if (refs[i].param >= procedure->num_args ||
+          refs[i].param >= gimp_value_array_length (args))
+        {
+          g_set_error (&error, GIMP_PDB_ERROR, GIMP_PDB_ERROR_INVALID_ARGUMENT,
+                       _("Procedure '%s' has no argument #%d"),
+                       proc_name, refs[i].param + 1);
+          break;
+        }
+
+      if (refs[i].value >= gimp_value_array_length (result))
+        {
+          g_set_error (&error, GIMP_PDB_ERROR, GIMP_PDB_ERROR_INVALID_ARGUMENT,
+                       _("Procedure '%s' has been called with return "
+                         "value #%d of call #%d of the batch for argument "
+                         "'%s' (#%d), but that call has no such return "
+                         "value"),
+                       proc_name, refs[i].value, refs[i].call + 1,
+                       g_param_spec_get_name (procedure->args[refs[i].param]),
+                       refs[i].param + 1);
+          break;
+        }
+
+      src  = gimp_value_array_index (result, refs[i].value);
+      dest = gimp_value_array_index (args,   refs[i].param);
+
+      if (g_value_type_compatible (G_VALUE_TYPE (src), G_VALUE_TYPE (dest)))
+        {
+          g_value_copy (src, dest);
+        }
+      else if (! g_value_type_transformable (G_VALUE_TYPE (src),
+                                             G_VALUE_TYPE (dest)) ||
+               ! g_value_transform (src, dest))
+        {
+          g_set_error (&error, GIMP_PDB_ERROR, GIMP_PDB_ERROR_INVALID_ARGUMENT,
+                       _("Procedure '%s' has been called with a value of "
+                         "type %s for argument '%s' (#%d, type %s)"),
+                       proc_name, g_type_name (G_VALUE_TYPE (src)),
+                       g_param_spec_get_name (procedure->args[refs[i].param]),
+                       refs[i].param + 1, g_type_name (G_VALUE_TYPE (dest)));
+        }
+    }
+
+  if (error)
+    {
+      return_vals = gimp_procedure_get_return_values (procedure, FALSE, error);
+    }
+  else
+    {
+      /*  Execute the procedure even if gimp_pdb_lookup_procedure()
+       *  returned NULL, gimp_pdb_execute_procedure_by_name_args() will
+       *  return appropriate error return_vals.
+       */
+      gimp_plug_in_manager_plug_in_push (plug_in->manager, plug_in);
+      return_vals = gimp_pdb_execute_procedure_by_name_args (plug_in->manager->gimp->pdb,
+                                                             proc_frame->context_stack ?
+                                                             proc_frame->context_stack->data :
+                                                             proc_frame->main_context,
+                                                             proc_frame->progress,
+                                                             &error,
+                                                             proc_name,
+                                                             args);
+      gimp_plug_in_manager_plug_in_pop (plug_in->manager);
+    }
 
   gimp_value_array_unref (args);
 
@@ -602,6 +687,21 @@ gimp_plug_in_handle_proc_run (GimpPlugIn *plug_in,
 
   g_free (canonical);
 
+  return return_vals;
+}
+
+static void
+gimp_plug_in_handle_proc_run (GimpPlugIn *plug_in,
+                              GPProcRun  *proc_run)
+{
+  GimpValueArray *return_vals;
+
+  g_return_if_fail (proc_run != NULL);
+  g_return_if_fail (proc_run->name != NULL);
+
+  return_vals = gimp_plug_in_execute_proc_run (plug_in, proc_run,
+                                               NULL, 0, NULL);
+
   /*  Don't bother to send the return value if executing the procedure
    *  closed the plug-in (e.g. if the procedure is gimp-quit)
    */
@@ -630,6 +730,102 @@ gimp_plug_in_handle_proc_run (GimpPlugIn *plug_in,
   gimp_value_array_unref (return_vals);
 }
 
+static void
+gimp_plug_in_handle_proc_batch (GimpPlugIn  *plug_in,
+                                GPProcBatch *proc_batch)
+{
+  GimpValueArray **results;
+  guint            n_results = 0;
+  guint            i;
+
+  g_return_if_fail (proc_batch != NULL);
+
+  results = g_new0 (GimpValueArray *, proc_batch->n_calls);
+
+  /*  Run the calls in order, and stop at the first one that fails,
+   *  later calls may depend on it.
+   */
+  while (n_results < proc_batch->n_calls && plug_in->open)
+    {
+      GPProcBatchCall *call = &proc_batch->calls[n_results];
+      GimpValueArray  *return_vals;
+
+      for (i = 0; i < call->n_refs; i++)
+        {
+          if (call->refs[i].call >= n_results)
+            break;
+        }
+
+      if (i < call->n_refs)
+        {
+          GError *error;
+
+          error = g_error_new (GIMP_PDB_ERROR, GIMP_PDB_ERROR_INVALID_ARGUMENT,
+                               _("Call #%d of the batch, to procedure '%s', "
+                                 "refers to the return values of call #%d, "
+                                 "which is not an earlier one"),
+                               n_results + 1, call->proc_run.name,
+                               call->refs[i].call + 1);
+
+          return_vals = gimp_procedure_get_return_values (NULL, FALSE, error);
+
+          g_error_free (error);
+        }
+      else
+        {
+          return_vals = gimp_plug_in_execute_proc_run (plug_in,
+                                                       &call->proc_run,
+                                                       call->refs,
+                                                       call->n_refs,
+                                                       results);
+        }
+
+      results[n_results++] = return_vals;
+
+      if (g_value_get_enum (gimp_value_array_index (return_vals, 0)) !=
+          GIMP_PDB_SUCCESS)
+        break;
+    }
+
+  /*  See gimp_plug_in_handle_proc_run()  */
+  if (plug_in->open)
+    {
+      GPProcBatchReturn proc_batch_return;
+
+      proc_batch_return.n_returns = n_results;
+      proc_batch_return.returns   = g_new0 (GPProcReturn, n_results);
+
+      for (i = 0; i < n_results; i++)
+        {
+          GPProcReturn *proc_return = &proc_batch_return.returns[i];
+
+          proc_return->name     = proc_batch->calls[i].proc_run.name;
+          proc_return->n_params = gimp_value_array_length (results[i]);
+          proc_return->params   = _gimp_value_array_to_gp_params (results[i],
+                                                                  FALSE);
+        }
+
+      if (! gp_proc_batch_return_write (plug_in->my_write,
+                                        &proc_batch_return, plug_in))
+        {
+          gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                        "%s: ERROR", G_STRFUNC);
+          gimp_plug_in_close (plug_in, TRUE);
+        }
+
+      for (i = 0; i < n_results; i++)
+        _gimp_gp_params_free (proc_batch_return.returns[i].params,
+                              proc_batch_return.returns[i].n_params, FALSE);
+
+      g_free (proc_batch_return.returns);
+    }
+
+  for (i = 0; i < n_results; i++)
+    gimp_value_array_unref (results[i]);
+
+  g_free (results);
+}
+
 static void
 gimp_plug_in_handle_proc_return (GimpPlugIn   *plug_in,
                                  GPProcReturn *proc_return)
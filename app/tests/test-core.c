@@ -18,6 +18,8 @@
 #include <gegl.h>
 #include <gtk/gtk.h>
 
+#include "libgimpmath/gimpmath.h"
+
 #include "widgets/widgets-types.h"
 
 #include "widgets/gimpuimanager.h"
@@ -27,6 +29,7 @@
 #include "core/gimpimage.h"
 #include "core/gimplayer.h"
 #include "core/gimplayer-new.h"
+#include "core/gimpscanconvert.h"
 
 #include "operations/gimplevelsconfig.h"
 
@@ -263,6 +266,70 @@ white_graypoint_in_red_levels (GimpTestFixture *fixture,
   g_clear_object (&white);
 }
 
+/**
+ * scan_convert_offset:
+ * @fixture:
+ * @data:
+ *
+ * Makes sure that rendering a path with an offset into a buffer gives
+ * the same pixels as rendering it without one, shifted by the offset,
+ * including the pixels a replacing render clears.
+ **/
+static void
+scan_convert_offset (GimpTestFixture *fixture,
+                     gconstpointer    data)
+{
+  const GimpVector2   points[] = { {  80.0,  60.0 },
+                                   { 330.0, 100.0 },
+                                   { 250.0, 330.0 },
+                                   { 100.0, 270.0 } };
+  const gint          off_x    = 60;
+  const gint          off_y    = 40;
+  const Babl         *format   = babl_format ("Y u8");
+  GimpScanConvert    *sc;
+  GeglBuffer         *unoffset;
+  GeglBuffer         *offset;
+  GeglBufferIterator *iter;
+  guchar              value    = 255;
+
+  unoffset = gegl_buffer_new (GEGL_RECTANGLE (0, 0, 400, 400), format);
+  offset   = gegl_buffer_new (GEGL_RECTANGLE (0, 0, 300, 300), format);
+
+  /*  a replacing render has to clear what the path doesn't cover  */
+  gegl_buffer_set_color_from_pixel (unoffset, NULL, &value, format);
+  gegl_buffer_set_color_from_pixel (offset,   NULL, &value, format);
+
+  sc = gimp_scan_convert_new ();
+  gimp_scan_convert_add_polyline (sc, G_N_ELEMENTS (points), points, TRUE);
+  gimp_scan_convert_render_full (sc, unoffset, 0, 0, TRUE, TRUE, 1.0);
+  gimp_scan_convert_free (sc);
+
+  sc = gimp_scan_convert_new ();
+  gimp_scan_convert_add_polyline (sc, G_N_ELEMENTS (points), points, TRUE);
+  gimp_scan_convert_render_full (sc, offset, off_x, off_y, TRUE, TRUE, 1.0);
+  gimp_scan_convert_free (sc);
+
+  /*  the buffer's pixel (x, y) is the path's (x + off_x, y + off_y)  */
+  iter = gegl_buffer_iterator_new (offset, NULL, 0, format,
+                                   GEGL_ACCESS_READ, GEGL_ABYSS_NONE, 2);
+  gegl_buffer_iterator_add (iter, unoffset,
+                            GEGL_RECTANGLE (off_x, off_y, 300, 300), 0,
+                            format, GEGL_ACCESS_READ, GEGL_ABYSS_NONE);
+
+  while (gegl_buffer_iterator_next (iter))
+    {
+      const guchar *o = iter->items[0].data;
+      const guchar *u = iter->items[1].data;
+      gint          i;
+
+      for (i = 0; i < iter->length; i++)
+        g_assert_cmpint (o[i], ==, u[i]);
+    }
+
+  g_object_unref (offset);
+  g_object_unref (unoffset);
+}
+
 int
 main (int    argc,
       char **argv)
@@ -283,6 +350,7 @@ main (int    argc,
   ADD_IMAGE_TEST (remove_layer);
   ADD_IMAGE_TEST (rotate_non_overlapping);
   ADD_TEST (white_graypoint_in_red_levels);
+  ADD_TEST (scan_convert_offset);
 
   /* Run the tests */
   result = g_test_run ();
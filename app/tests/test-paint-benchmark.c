@@ -0,0 +1,495 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+
+#include <gegl.h>
+#include <gtk/gtk.h>
+
+#include "libgimpbase/gimpbase.h"
+
+#include "widgets/widgets-types.h"
+
+#include "core/gimp.h"
+#include "core/gimpcontainer.h"
+#include "core/gimpcontext.h"
+#include "core/gimpdrawable-fill.h"
+#include "core/gimpimage.h"
+#include "core/gimplayer.h"
+#include "core/gimplayer-new.h"
+#include "core/gimppaintinfo.h"
+
+#include "paint/gimppaintcore.h"
+#include "paint/gimppaintoptions.h"
+
+#include "tests.h"
+
+#include "gimp-app-test-utils.h"
+
+
+/* Replays recorded tablet strokes through the paint cores, without
+ * any display, and reports dab throughput and per-event latency.
+ *
+ * The strokes are read from app/tests/files/paint-strokes.txt, or from
+ * the file named by GIMP_PAINT_BENCHMARK_STROKES.  The results are
+ * written as JSON to GIMP_PAINT_BENCHMARK_OUTPUT, or to
+ * paint-benchmark.json in the build's app/tests directory.
+ */
+
+
+#define GIMP_TEST_IMAGE_SIZE 512
+#define N_ITERATIONS         3
+
+#define ADD_TEST(paint_info_name) \
+  g_test_add_data_func ("/gimp-paint-benchmark/" paint_info_name, \
+                        paint_info_name, \
+                        benchmark_paint_core);
+
+
+typedef void (* GimpPaintCorePaintFunc) (GimpPaintCore    *core,
+                                         GList            *drawables,
+                                         GimpPaintOptions *paint_options,
+                                         GimpSymmetry     *sym,
+                                         GimpPaintState    paint_state,
+                                         guint32           time);
+
+
+static Gimp                   *gimp                 = NULL;
+static GArray                 *benchmark_strokes    = NULL;
+static GString                *benchmark_results    = NULL;
+static GimpPaintCorePaintFunc  benchmark_orig_paint = NULL;
+static gint                    benchmark_n_dabs     = 0;
+
+
+static void
+benchmark_count_paint (GimpPaintCore    *core,
+                       GList            *drawables,
+                       GimpPaintOptions *paint_options,
+                       GimpSymmetry     *sym,
+                       GimpPaintState    paint_state,
+                       guint32           time)
+{
+  if (paint_state == GIMP_PAINT_STATE_MOTION)
+    benchmark_n_dabs++;
+
+  benchmark_orig_paint (core, drawables, paint_options, sym,
+                        paint_state, time);
+}
+
+/**
+ * benchmark_load_strokes:
+ * @filename:
+ *
+ * Loads recorded strokes, one event per line, as
+ * "x y pressure xtilt ytilt velocity".  Empty lines separate strokes,
+ * lines starting with '#' are ignored.
+ *
+ * Returns: an array of GArrays of GimpCoords.
+ **/
+static GArray *
+benchmark_load_strokes (const gchar *filename)
+{
+  const GimpCoords   default_coords = GIMP_COORDS_DEFAULT_VALUES;
+  GArray            *strokes;
+  GArray            *stroke = NULL;
+  gchar             *contents;
+  gchar            **lines;
+  GError            *error  = NULL;
+  gint               i;
+
+  g_file_get_contents (filename, &contents, NULL, &error);
+  g_assert_no_error (error);
+
+  strokes = g_array_new (FALSE, FALSE, sizeof (GArray *));
+  lines   = g_strsplit (contents, "\n", -1);
+
+  for (i = 0; lines[i]; i++)
+    {
+      GimpCoords coords = default_coords;
+      gchar     *line   = g_strstrip (lines[i]);
+
+      if (line[0] == '#')
+        continue;
+
+      if (line[0] == '\0')
+        {
+          stroke = NULL;
+          continue;
+        }
+
+      if (sscanf (line, "%lf %lf %lf %lf %lf %lf",
+                  &coords.x, &coords.y, &coords.pressure,
+                  &coords.xtilt, &coords.ytilt, &coords.velocity) != 6)
+        {
+          g_error ("%s:%d: malformed event '%s'", filename, i + 1, line);
+        }
+
+      if (! stroke)
+        {
+          stroke = g_array_new (FALSE, FALSE, sizeof (GimpCoords));
+
+          g_array_append_val (strokes, stroke);
+        }
+
+      g_array_append_val (stroke, coords);
+    }
+
+  g_strfreev (lines);
+  g_free (contents);
+
+  g_assert_cmpint (strokes->len, >, 0);
+
+  return strokes;
+}
+
+static gint
+benchmark_compare_latency (gconstpointer a,
+                           gconstpointer b)
+{
+  gint64 latency_a = *(const gint64 *) a;
+  gint64 latency_b = *(const gint64 *) b;
+
+  return (latency_a > latency_b) - (latency_a < latency_b);
+}
+
+static gint64
+benchmark_percentile (GArray  *latencies,
+                      gdouble  percentile)
+{
+  gint i = CLAMP ((gint) ((latencies->len - 1) * percentile / 100.0),
+                  0, (gint) latencies->len - 1);
+
+  return g_array_index (latencies, gint64, i);
+}
+
+static gboolean
+benchmark_replay_stroke (GimpPaintCore     *core,
+                         GList             *drawables,
+                         GimpPaintOptions  *options,
+                         GArray            *stroke,
+                         GArray            *latencies,
+                         GError           **error)
+{
+  GimpCoords *coords = (GimpCoords *) stroke->data;
+  gint64      start;
+  gint        i;
+
+  start = g_get_monotonic_time ();
+
+  if (! gimp_paint_core_start (core, drawables, options, &coords[0], error))
+    return FALSE;
+
+  core->last_coords = coords[0];
+
+  gimp_paint_core_paint (core, drawables, options,
+                         GIMP_PAINT_STATE_INIT, 0);
+  gimp_paint_core_paint (core, drawables, options,
+                         GIMP_PAINT_STATE_MOTION, 0);
+
+  for (i = 1; i < stroke->len; i++)
+    {
+      gint64 latency = g_get_monotonic_time () - start;
+
+      g_array_append_val (latencies, latency);
+
+      start = g_get_monotonic_time ();
+
+      gimp_paint_core_interpolate (core, drawables, options,
+                                   &coords[i], i);
+    }
+
+  gimp_paint_core_paint (core, drawables, options,
+                         GIMP_PAINT_STATE_FINISH, 0);
+  gimp_paint_core_finish (core, drawables, FALSE);
+  gimp_paint_core_cleanup (core);
+
+  {
+    gint64 latency = g_get_monotonic_time () - start;
+
+    g_array_append_val (latencies, latency);
+  }
+
+  return TRUE;
+}
+
+/**
+ * benchmark_paint_core:
+ * @data: the name of the paint info to benchmark
+ *
+ * Replays all loaded strokes N_ITERATIONS times with a paint core,
+ * and appends its numbers to the JSON results.
+ **/
+static void
+benchmark_paint_core (gconstpointer data)
+{
+  const gchar        *name = data;
+  GimpPaintInfo      *paint_info;
+  GimpPaintCoreClass *core_class;
+  GimpPaintCore      *core;
+  GimpPaintOptions   *options;
+  GimpImage          *image;
+  GimpLayer          *layer;
+  GList              *drawables;
+  GArray             *latencies;
+  GError             *error   = NULL;
+  gint64              total   = 0;
+  gboolean            success = TRUE;
+  gint                iter;
+  gint                i;
+
+  paint_info = GIMP_PAINT_INFO (
+    gimp_container_get_child_by_name (gimp->paint_info_list, name));
+  g_assert_nonnull (paint_info);
+
+  image = gimp_image_new (gimp,
+                          GIMP_TEST_IMAGE_SIZE,
+                          GIMP_TEST_IMAGE_SIZE,
+                          GIMP_RGB,
+                          GIMP_PRECISION_U8_NON_LINEAR);
+
+  layer = gimp_layer_new (image,
+                          GIMP_TEST_IMAGE_SIZE,
+                          GIMP_TEST_IMAGE_SIZE,
+                          babl_format ("R'G'B'A u8"),
+                          "Benchmark Layer",
+                          GIMP_OPACITY_OPAQUE,
+                          GIMP_LAYER_MODE_NORMAL);
+
+  gimp_image_add_layer (image, layer, GIMP_IMAGE_ACTIVE_PARENT, 0, FALSE);
+
+  /* smudge, clone and heal need something to pick up */
+  gimp_drawable_fill (GIMP_DRAWABLE (layer),
+                      gimp_get_user_context (gimp),
+                      GIMP_FILL_FOREGROUND);
+
+  drawables = g_list_prepend (NULL, layer);
+
+  options = gimp_paint_options_new (paint_info);
+
+  gimp_context_define_properties (GIMP_CONTEXT (options),
+                                  GIMP_CONTEXT_PROP_MASK_PAINT,
+                                  FALSE);
+  gimp_context_set_parent (GIMP_CONTEXT (options),
+                           gimp_get_user_context (gimp));
+
+  if (g_object_class_find_property (G_OBJECT_GET_CLASS (options),
+                                    "src-drawables"))
+    {
+      g_object_set (options,
+                    "src-drawables", drawables,
+                    "src-x",         GIMP_TEST_IMAGE_SIZE / 4,
+                    "src-y",         GIMP_TEST_IMAGE_SIZE / 4,
+                    NULL);
+    }
+
+  core = g_object_new (paint_info->paint_type,
+                       "undo-desc", paint_info->blurb,
+                       NULL);
+
+  /* count dabs by intercepting the MOTION paints of this core's class */
+  core_class = GIMP_PAINT_CORE_GET_CLASS (core);
+
+  benchmark_orig_paint = core_class->paint;
+  benchmark_n_dabs     = 0;
+  core_class->paint    = benchmark_count_paint;
+
+  latencies = g_array_new (FALSE, FALSE, sizeof (gint64));
+
+  for (iter = 0; success && iter < N_ITERATIONS; iter++)
+    {
+      for (i = 0; success && i < benchmark_strokes->len; i++)
+        {
+          GArray *stroke = g_array_index (benchmark_strokes, GArray *, i);
+
+          success = benchmark_replay_stroke (core, drawables, options,
+                                             stroke, latencies, &error);
+        }
+    }
+
+  core_class->paint = benchmark_orig_paint;
+
+  if (success)
+    {
+      gdouble seconds;
+
+      for (i = 0; i < latencies->len; i++)
+        total += g_array_index (latencies, gint64, i);
+
+      seconds = MAX (total, 1) / (gdouble) G_TIME_SPAN_SECOND;
+
+      g_array_sort (latencies, benchmark_compare_latency);
+
+      if (benchmark_results->len > 0)
+        g_string_append (benchmark_results, ",\n");
+
+      g_string_append_printf (benchmark_results,
+                              "    {\n"
+                              "      \"paint-info\": \"%s\",\n"
+                              "      \"iterations\": %d,\n"
+                              "      \"events\": %u,\n"
+                              "      \"dabs\": %d,\n"
+                              "      \"total-us\": %" G_GINT64_FORMAT ",\n"
+                              "      \"dabs-per-second\": %.1f,\n"
+                              "      \"events-per-second\": %.1f,\n"
+                              "      \"latency-us\": {\n"
+                              "        \"p50\": %" G_GINT64_FORMAT ",\n"
+                              "        \"p90\": %" G_GINT64_FORMAT ",\n"
+                              "        \"p99\": %" G_GINT64_FORMAT ",\n"
+                              "        \"max\": %" G_GINT64_FORMAT "\n"
+                              "      }\n"
+                              "    }",
+                              name,
+                              N_ITERATIONS,
+                              latencies->len,
+                              benchmark_n_dabs,
+                              total,
+                              benchmark_n_dabs / seconds,
+                              latencies->len / seconds,
+                              benchmark_percentile (latencies, 50.0),
+                              benchmark_percentile (latencies, 90.0),
+                              benchmark_percentile (latencies, 99.0),
+                              benchmark_percentile (latencies, 100.0));
+
+      g_test_message ("%s: %.1f dabs/s, p50 %" G_GINT64_FORMAT " us, "
+                      "p99 %" G_GINT64_FORMAT " us",
+                      name,
+                      benchmark_n_dabs / seconds,
+                      benchmark_percentile (latencies, 50.0),
+                      benchmark_percentile (latencies, 99.0));
+    }
+  else
+    {
+      /* e.g. no brush or MyPaint brush available in the test gimpdir */
+      g_test_skip (error ? error->message : "paint core failed to start");
+      g_clear_error (&error);
+    }
+
+  g_array_free (latencies, TRUE);
+  g_object_unref (core);
+  g_object_unref (options);
+  g_list_free (drawables);
+  g_object_unref (image);
+}
+
+static void
+benchmark_write_results (const gchar *filename)
+{
+  GString *json  = g_string_new (NULL);
+  GError  *error = NULL;
+
+  g_string_append_printf (json,
+                          "{\n"
+                          "  \"image-size\": %d,\n"
+                          "  \"strokes\": %u,\n"
+                          "  \"results\": [\n"
+                          "%s\n"
+                          "  ]\n"
+                          "}\n",
+                          GIMP_TEST_IMAGE_SIZE,
+                          benchmark_strokes->len,
+                          benchmark_results->str);
+
+  if (! g_file_set_contents (filename, json->str, json->len, &error))
+    {
+      g_printerr ("Failed to write '%s': %s\n", filename, error->message);
+      g_clear_error (&error);
+    }
+  else
+    {
+      g_print ("Wrote paint benchmark results to '%s'\n", filename);
+    }
+
+  g_string_free (json, TRUE);
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  const gchar *strokes_file;
+  const gchar *output_file;
+  gchar       *default_strokes_file = NULL;
+  gchar       *default_output_file  = NULL;
+  int          result;
+  gint         i;
+
+  g_test_init (&argc, &argv, NULL);
+
+  gimp_test_utils_set_gimp3_directory ("GIMP_TESTING_ABS_TOP_SRCDIR",
+                                       "app/tests/gimpdir");
+
+  /* We share the same application instance across all tests */
+  gimp = gimp_init_for_testing ();
+
+  strokes_file = g_getenv ("GIMP_PAINT_BENCHMARK_STROKES");
+
+  if (! strokes_file)
+    {
+      default_strokes_file =
+        g_build_filename (g_getenv ("GIMP_TESTING_ABS_TOP_SRCDIR"),
+                          "app", "tests", "files", "paint-strokes.txt",
+                          NULL);
+      strokes_file = default_strokes_file;
+    }
+
+  output_file = g_getenv ("GIMP_PAINT_BENCHMARK_OUTPUT");
+
+  if (! output_file)
+    {
+      default_output_file =
+        g_build_filename (g_getenv ("GIMP_TESTING_ABS_TOP_BUILDDIR"),
+                          "app", "tests", "paint-benchmark.json",
+                          NULL);
+      output_file = default_output_file;
+    }
+
+  benchmark_strokes = benchmark_load_strokes (strokes_file);
+  benchmark_results = g_string_new (NULL);
+
+  /* Add tests */
+  ADD_TEST ("gimp-paintbrush");
+  ADD_TEST ("gimp-airbrush");
+  ADD_TEST ("gimp-smudge");
+  ADD_TEST ("gimp-clone");
+  ADD_TEST ("gimp-heal");
+  ADD_TEST ("gimp-ink");
+  ADD_TEST ("gimp-mybrush");
+
+  /* Run the tests */
+  result = g_test_run ();
+
+  benchmark_write_results (output_file);
+
+  for (i = 0; i < benchmark_strokes->len; i++)
+    g_array_free (g_array_index (benchmark_strokes, GArray *, i), TRUE);
+
+  g_array_free (benchmark_strokes, TRUE);
+  g_string_free (benchmark_results, TRUE);
+  g_free (default_strokes_file);
+  g_free (default_output_file);
+
+  /* Don't write files to the source dir */
+  gimp_test_utils_set_gimp3_directory ("GIMP_TESTING_ABS_TOP_BUILDDIR",
+                                       "app/tests/gimpdir-output");
+
+  /* Exit so we don't break script-fu plug-in wire */
+  gimp_exit (gimp, TRUE);
+
+  return result;
+}
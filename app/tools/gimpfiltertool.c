@@ -1523,6 +1523,9 @@ gimp_filter_tool_create_filter (GimpFilterTool *filter_tool)
                                                   filter_tool->operation,
                                                   gimp_tool_get_icon_name (tool));
 
+  /*  keep dragging the tool's sliders responsive on large images  */
+  gimp_drawable_filter_set_progressive (filter_tool->filter, TRUE);
+
   gimp_filter_tool_update_filter (filter_tool);
 
   g_signal_connect (filter_tool->filter, "flush",
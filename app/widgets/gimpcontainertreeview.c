@@ -117,6 +117,11 @@ static gboolean      gimp_container_tree_view_button            (GtkWidget
 static gboolean      gimp_container_tree_view_scroll            (GtkWidget                   *widget,
                                                                  GdkEventScroll              *event,
                                                                  GimpContainerTreeView       *tree_view);
+static void          gimp_container_tree_view_update_on_screen  (GimpContainerTreeView       *tree_view);
+static gboolean      gimp_container_tree_view_on_screen_foreach (GtkTreeModel                *model,
+                                                                 GtkTreePath                 *path,
+                                                                 GtkTreeIter                 *iter,
+                                                                 gpointer                     data);
 static gboolean      gimp_container_tree_view_tooltip           (GtkWidget                   *widget,
                                                                  gint                         x,
                                                                  gint                         y,
@@ -349,6 +354,19 @@ gimp_container_tree_view_constructed (GObject *object)
                     G_CALLBACK (gimp_container_tree_view_scroll),
                     tree_view);
 
+  /*  keep track of which rows are scrolled into view, so their
+   *  previews can be rendered ahead of the others
+   */
+  g_signal_connect_object (gtk_scrolled_window_get_vadjustment (GTK_SCROLLED_WINDOW (box->scrolled_win)),
+                           "value-changed",
+                           G_CALLBACK (gimp_container_tree_view_update_on_screen),
+                           tree_view,
+                           G_CONNECT_SWAPPED | G_CONNECT_AFTER);
+  g_signal_connect_object (tree_view->view, "size-allocate",
+                           G_CALLBACK (gimp_container_tree_view_update_on_screen),
+                           tree_view,
+                           G_CONNECT_SWAPPED | G_CONNECT_AFTER);
+
   tree_view->priv->zoom_gesture = gtk_gesture_zoom_new (GTK_WIDGET (tree_view->view));
   gtk_event_controller_set_propagation_phase (GTK_EVENT_CONTROLLER (tree_view->priv->zoom_gesture),
                                               GTK_PHASE_CAPTURE);
@@ -1738,6 +1756,49 @@ gimp_container_tree_view_scroll (GtkWidget             *widget,
   return TRUE;
 }
 
+static void
+gimp_container_tree_view_update_on_screen (GimpContainerTreeView *tree_view)
+{
+  GtkTreePath *range[2] = { NULL, NULL };
+
+  if (! tree_view->model)
+    return;
+
+  /*  with no visible range, all rows are marked as off screen  */
+  gtk_tree_view_get_visible_range (tree_view->view, &range[0], &range[1]);
+
+  gtk_tree_model_foreach (tree_view->model,
+                          gimp_container_tree_view_on_screen_foreach,
+                          range);
+
+  g_clear_pointer (&range[0], gtk_tree_path_free);
+  g_clear_pointer (&range[1], gtk_tree_path_free);
+}
+
+static gboolean
+gimp_container_tree_view_on_screen_foreach (GtkTreeModel *model,
+                                            GtkTreePath  *path,
+                                            GtkTreeIter  *iter,
+                                            gpointer      data)
+{
+  GtkTreePath      **range = data;
+  GimpViewRenderer  *renderer;
+
+  renderer = gimp_container_tree_store_get_renderer (GIMP_CONTAINER_TREE_STORE (model), iter);
+
+  if (renderer)
+    {
+      gimp_view_renderer_set_on_screen (renderer,
+                                        range[0]                                    &&
+                                        range[1]                                    &&
+                                        gtk_tree_path_compare (path, range[0]) >= 0 &&
+                                        gtk_tree_path_compare (path, range[1]) <= 0);
+      g_object_unref (renderer);
+    }
+
+  return FALSE;
+}
+
 static gboolean
 gimp_container_tree_view_tooltip (GtkWidget             *widget,
                                   gint                   x,
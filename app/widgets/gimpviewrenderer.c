@@ -72,6 +72,8 @@ struct _GimpViewRendererPrivate
 
   gboolean            needs_render;
   guint               idle_id;
+
+  gboolean            on_screen;
 };
 
 
@@ -166,6 +168,7 @@ gimp_view_renderer_init (GimpViewRenderer *renderer)
   renderer->size         = -1;
 
   renderer->priv->needs_render = TRUE;
+  renderer->priv->on_screen    = TRUE;
 }
 
 static void
@@ -553,6 +556,32 @@ gimp_view_renderer_get_color_config (GimpViewRenderer *renderer)
   return renderer->priv->color_config;
 }
 
+/**
+ * gimp_view_renderer_set_on_screen:
+ * @renderer:  a #GimpViewRenderer
+ * @on_screen: whether the renderer's view is currently scrolled into view
+ *
+ * Lets views which share one widget between many renderers, like the
+ * rows of a #GimpContainerTreeView, tell which of them are actually
+ * visible, so that their previews can be rendered first.
+ **/
+void
+gimp_view_renderer_set_on_screen (GimpViewRenderer *renderer,
+                                  gboolean          on_screen)
+{
+  g_return_if_fail (GIMP_IS_VIEW_RENDERER (renderer));
+
+  renderer->priv->on_screen = on_screen ? TRUE : FALSE;
+}
+
+gboolean
+gimp_view_renderer_get_on_screen (GimpViewRenderer *renderer)
+{
+  g_return_val_if_fail (GIMP_IS_VIEW_RENDERER (renderer), FALSE);
+
+  return renderer->priv->on_screen;
+}
+
 void
 gimp_view_renderer_invalidate (GimpViewRenderer *renderer)
 {
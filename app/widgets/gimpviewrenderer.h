@@ -127,6 +127,10 @@ void   gimp_view_renderer_set_color_config (GimpViewRenderer   *renderer,
                                             GimpColorConfig    *color_config);
 GimpColorConfig *
        gimp_view_renderer_get_color_config (GimpViewRenderer   *renderer);
+void   gimp_view_renderer_set_on_screen    (GimpViewRenderer   *renderer,
+                                            gboolean            on_screen);
+gboolean
+       gimp_view_renderer_get_on_screen    (GimpViewRenderer   *renderer);
 
 void   gimp_view_renderer_invalidate       (GimpViewRenderer   *renderer);
 void   gimp_view_renderer_update           (GimpViewRenderer   *renderer);
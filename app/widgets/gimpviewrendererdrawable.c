@@ -280,10 +280,18 @@ gimp_view_renderer_drawable_render (GimpViewRenderer *renderer,
 
   if (! empty)
     {
+      /* previews which are actually on screen get to jump ahead of
+       * previews in unmapped widgets, e.g. in a hidden dockable, and
+       * of tree view rows which are scrolled out of view.
+       */
+      gint priority = (gtk_widget_get_mapped (widget) &&
+                       gimp_view_renderer_get_on_screen (renderer)) ? +1 : +2;
+
       async = gimp_drawable_get_sub_preview_async (drawable,
                                                    src_x, src_y,
                                                    src_width, src_height,
-                                                   dst_width, dst_height);
+                                                   dst_width, dst_height,
+                                                   priority);
     }
   else
     {
@@ -61,6 +61,7 @@
 #include <libgimp/gimppath.h>
 #include <libgimp/gimppattern.h>
 #include <libgimp/gimppdb.h>
+#include <libgimp/gimppdbbatch.h>
 #include <libgimp/gimpplugin.h>
 #include <libgimp/gimpprocedureconfig.h>
 #include <libgimp/gimpprocedure-params.h>
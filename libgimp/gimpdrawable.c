@@ -31,6 +31,44 @@ G_DEFINE_ABSTRACT_TYPE (GimpDrawable, gimp_drawable, GIMP_TYPE_ITEM)
 #define parent_class gimp_drawable_parent_class
 
 
+typedef struct
+{
+  GeglBuffer *buffer;
+  const Babl *format;
+  guchar     *pixels;
+  gint        y;
+  gint        n_rows;
+} GimpDrawableBand;
+
+typedef struct
+{
+  GimpDrawableBand  bands[2];
+  gint              height;
+  gint              band_height;
+  gint              n_bands;
+  gboolean          bottom_up;
+
+  /*  the bands to read into, and the bands which were read  */
+  GAsyncQueue      *free_bands;
+  GAsyncQueue      *read_bands;
+
+  /*  held while talking to GIMP, so reads and progress updates don't
+   *  interleave on the wire
+   */
+  GMutex            wire_mutex;
+
+  gint              stop;
+} GimpDrawableBandReader;
+
+
+static gboolean   gimp_drawable_pixels_use_pdb (GimpDrawable     *drawable,
+                                                gint              width,
+                                                gint              height,
+                                                const Babl      **format);
+static gpointer   gimp_drawable_band_reader    (gpointer          data);
+static void       gimp_drawable_read_band      (GimpDrawableBand *band);
+
+
 static void
 gimp_drawable_class_init (GimpDrawableClass *klass)
 {
@@ -433,3 +471,327 @@ gimp_drawable_get_thumbnail_format (GimpDrawable *drawable)
 
   return format;
 }
+
+/**
+ * gimp_drawable_get_pixels:
+ * @drawable: the drawable
+ * @x:        the x coordinate of the region
+ * @y:        the y coordinate of the region
+ * @width:    the width of the region
+ * @height:   the height of the region
+ * @format: (nullable): the format of the pixels, or %NULL for the
+ *          drawable's format
+ *
+ * Gets the pixels of a rectangular region of @drawable, as @height
+ * rows of @width pixels in @format, without any padding between rows.
+ *
+ * Small regions are transferred in a single PDB call, large regions
+ * through the drawable's #GeglBuffer, whose tiles are transferred
+ * through the shared memory segment between GIMP and the plug-in.
+ *
+ * Returns: (transfer full) (nullable): the pixels, or %NULL if the
+ *          region is not inside @drawable.
+ *
+ * Since: 3.0
+ **/
+GBytes *
+gimp_drawable_get_pixels (GimpDrawable *drawable,
+                          gint          x,
+                          gint          y,
+                          gint          width,
+                          gint          height,
+                          const Babl   *format)
+{
+  GeglBuffer *buffer;
+  guchar     *data;
+  gsize       rowstride;
+  gsize       size;
+
+  g_return_val_if_fail (GIMP_IS_DRAWABLE (drawable), NULL);
+  g_return_val_if_fail (width > 0 && height > 0, NULL);
+
+  if (gimp_drawable_pixels_use_pdb (drawable, width, height, &format))
+    return _gimp_drawable_get_pixels (drawable, x, y, width, height,
+                                      format ?
+                                      babl_format_get_encoding (format) :
+                                      NULL);
+
+  if (x < 0 || (gint64) x + width  > gimp_drawable_get_width  (drawable) ||
+      y < 0 || (gint64) y + height > gimp_drawable_get_height (drawable))
+    return NULL;
+
+  rowstride = (gsize) width * babl_format_get_bytes_per_pixel (format);
+  size      = rowstride * height;
+  data      = g_try_malloc (size);
+
+  if (! data)
+    return NULL;
+
+  buffer = gimp_drawable_get_buffer (drawable);
+
+  gegl_buffer_get (buffer, GEGL_RECTANGLE (x, y, width, height), 1.0,
+                   format, data, rowstride, GEGL_ABYSS_NONE);
+
+  g_object_unref (buffer);
+
+  return g_bytes_new_take (data, size);
+}
+
+/**
+ * gimp_drawable_set_pixels:
+ * @drawable: the drawable
+ * @x:        the x coordinate of the region
+ * @y:        the y coordinate of the region
+ * @width:    the width of the region
+ * @height:   the height of the region
+ * @format: (nullable): the format of the pixels, or %NULL for the
+ *          drawable's format
+ * @pixels:   the pixels
+ *
+ * Sets the pixels of a rectangular region of @drawable from @height
+ * rows of @width pixels in @format, without any padding between rows,
+ * and updates the region. See gimp_drawable_get_pixels() for how the
+ * pixels are transferred.
+ *
+ * Note that this function is not undoable, you should use it only on
+ * drawables you just created yourself.
+ *
+ * Returns: %TRUE on success.
+ *
+ * Since: 3.0
+ **/
+gboolean
+gimp_drawable_set_pixels (GimpDrawable *drawable,
+                          gint          x,
+                          gint          y,
+                          gint          width,
+                          gint          height,
+                          const Babl   *format,
+                          GBytes       *pixels)
+{
+  GeglBuffer *buffer;
+  gsize       rowstride;
+
+  g_return_val_if_fail (GIMP_IS_DRAWABLE (drawable), FALSE);
+  g_return_val_if_fail (width > 0 && height > 0, FALSE);
+  g_return_val_if_fail (pixels != NULL, FALSE);
+
+  if (gimp_drawable_pixels_use_pdb (drawable, width, height, &format))
+    return _gimp_drawable_set_pixels (drawable, x, y, width, height,
+                                      format ?
+                                      babl_format_get_encoding (format) :
+                                      NULL,
+                                      pixels);
+
+  rowstride = (gsize) width * babl_format_get_bytes_per_pixel (format);
+
+  if (x < 0 || (gint64) x + width  > gimp_drawable_get_width  (drawable) ||
+      y < 0 || (gint64) y + height > gimp_drawable_get_height (drawable) ||
+      g_bytes_get_size (pixels) != rowstride * height)
+    return FALSE;
+
+  buffer = gimp_drawable_get_buffer (drawable);
+
+  gegl_buffer_set (buffer, GEGL_RECTANGLE (x, y, width, height), 0,
+                   format, g_bytes_get_data (pixels, NULL), rowstride);
+
+  /* unreffing the buffer flushes its tiles to the core */
+  g_object_unref (buffer);
+
+  return gimp_drawable_update (drawable, x, y, width, height);
+}
+
+/**
+ * gimp_drawable_foreach_band:
+ * @drawable:  the drawable
+ * @format: (nullable): the format of the pixels, or %NULL for the
+ *            drawable's format
+ * @bottom_up: whether to visit the bands from the bottom of @drawable
+ * @func: (scope call): the function to call for each band
+ * @user_data: (closure func): the data to pass to @func
+ *
+ * Calls @func for each band of gimp_tile_height() rows of @drawable,
+ * with the pixels of the band in @format, from the top of @drawable or,
+ * if @bottom_up is %TRUE, from its bottom. The rows within a band are
+ * always passed top to bottom.
+ *
+ * This is meant for exporters which encode a drawable as a stream of
+ * rows: only two bands are in memory at any time, whatever the size of
+ * @drawable, and the next band is read while @func encodes the current
+ * one. Since that read talks to GIMP, @func must not call any
+ * procedure itself, not even gimp_progress_update():
+ * gimp_drawable_foreach_band() updates the progress from the calling
+ * thread as bands are done.
+ *
+ * Returns: %TRUE if @func was called for all of the bands, %FALSE if
+ *          it stopped early.
+ *
+ * Since: 3.0
+ **/
+gboolean
+gimp_drawable_foreach_band (GimpDrawable         *drawable,
+                            const Babl           *format,
+                            gboolean              bottom_up,
+                            GimpDrawableBandFunc  func,
+                            gpointer              user_data)
+{
+  GimpDrawableBandReader  reader;
+  GeglBuffer             *buffer;
+  GThread                *thread;
+  gint                    width;
+  gsize                   band_size;
+  gboolean                success = TRUE;
+  gint                    b;
+
+  g_return_val_if_fail (GIMP_IS_DRAWABLE (drawable), FALSE);
+  g_return_val_if_fail (func != NULL, FALSE);
+
+  if (! format)
+    format = gimp_drawable_get_format (drawable);
+
+  buffer = gimp_drawable_get_buffer (drawable);
+
+  width              = gimp_drawable_get_width  (drawable);
+  reader.height      = gimp_drawable_get_height (drawable);
+  reader.band_height = gimp_tile_height ();
+  reader.n_bands     = ((reader.height + reader.band_height - 1) /
+                        reader.band_height);
+  reader.bottom_up   = bottom_up;
+  reader.free_bands  = g_async_queue_new ();
+  reader.read_bands  = g_async_queue_new ();
+  reader.stop        = FALSE;
+
+  g_mutex_init (&reader.wire_mutex);
+
+  band_size = ((gsize) width * reader.band_height *
+               babl_format_get_bytes_per_pixel (format));
+
+  for (b = 0; b < 2; b++)
+    {
+      reader.bands[b].buffer = buffer;
+      reader.bands[b].format = format;
+      reader.bands[b].pixels = g_malloc (band_size);
+
+      g_async_queue_push (reader.free_bands, &reader.bands[b]);
+    }
+
+  /*  one thread reads all of the bands, one ahead of @func  */
+  thread = g_thread_new ("band-reader", gimp_drawable_band_reader, &reader);
+
+  for (b = 0; b < reader.n_bands && success; b++)
+    {
+      GimpDrawableBand *band = g_async_queue_pop (reader.read_bands);
+
+      success = func (band->pixels, band->y, width, band->n_rows, user_data);
+
+      if (success)
+        {
+          g_mutex_lock (&reader.wire_mutex);
+          gimp_progress_update ((gdouble) (b + 1) / reader.n_bands);
+          g_mutex_unlock (&reader.wire_mutex);
+        }
+      else
+        {
+          /*  the reader checks for a stop after getting a band back  */
+          g_atomic_int_set (&reader.stop, TRUE);
+        }
+
+      g_async_queue_push (reader.free_bands, band);
+    }
+
+  g_thread_join (thread);
+
+  g_mutex_clear (&reader.wire_mutex);
+  g_async_queue_unref (reader.free_bands);
+  g_async_queue_unref (reader.read_bands);
+  g_free (reader.bands[0].pixels);
+  g_free (reader.bands[1].pixels);
+  g_object_unref (buffer);
+
+  return success;
+}
+
+
+/*  private functions  */
+
+/* Decides whether the pixels of a region are transferred in a PDB
+ * call or through the drawable's buffer. When they go through the
+ * buffer, *format is set to the actual format.
+ */
+static gboolean
+gimp_drawable_pixels_use_pdb (GimpDrawable  *drawable,
+                              gint           width,
+                              gint           height,
+                              const Babl   **format)
+{
+  const Babl *drawable_format;
+  gsize       max_size;
+
+  /* a payload which fits in the shared memory segment is cheaper to
+   * send in one message than tile by tile
+   */
+  max_size = (gsize) gimp_tile_width () * gimp_tile_height () * 32;
+
+  if (! *format)
+    {
+      if ((gsize) width * height * gimp_drawable_get_bpp (drawable) <= max_size)
+        return TRUE;
+
+      *format = gimp_drawable_get_format (drawable);
+
+      return FALSE;
+    }
+
+  if ((gsize) width * height * babl_format_get_bytes_per_pixel (*format) >
+      max_size ||
+      babl_format_is_palette (*format))
+    return FALSE;
+
+  /* the PDB procedure only receives the encoding, and uses the space
+   * of the drawable
+   */
+  drawable_format = gimp_drawable_get_format (drawable);
+
+  return (babl_format_get_space (*format) ==
+          babl_format_get_space (drawable_format));
+}
+
+static gpointer
+gimp_drawable_band_reader (gpointer data)
+{
+  GimpDrawableBandReader *reader = data;
+  gint                    b;
+
+  for (b = 0; b < reader->n_bands; b++)
+    {
+      GimpDrawableBand *band = g_async_queue_pop (reader->free_bands);
+      gint              row;
+
+      if (g_atomic_int_get (&reader->stop))
+        break;
+
+      row = reader->bottom_up ? reader->n_bands - 1 - b : b;
+
+      band->y      = row * reader->band_height;
+      band->n_rows = MIN (reader->band_height, reader->height - band->y);
+
+      g_mutex_lock (&reader->wire_mutex);
+      gimp_drawable_read_band (band);
+      g_mutex_unlock (&reader->wire_mutex);
+
+      g_async_queue_push (reader->read_bands, band);
+    }
+
+  return NULL;
+}
+
+static void
+gimp_drawable_read_band (GimpDrawableBand *band)
+{
+  gegl_buffer_get (band->buffer,
+                   GEGL_RECTANGLE (0, band->y,
+                                   gegl_buffer_get_width (band->buffer),
+                                   band->n_rows),
+                   1.0, band->format, band->pixels,
+                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+}
@@ -37,6 +37,31 @@ G_BEGIN_DECLS
 G_DECLARE_DERIVABLE_TYPE (GimpDrawable, gimp_drawable, GIMP, DRAWABLE, GimpItem)
 
 
+/**
+ * GimpDrawableBandFunc:
+ * @pixels:    the pixels of the band
+ * @y:         the first row of the band
+ * @width:     the width of the band
+ * @n_rows:    the number of rows in the band
+ * @user_data: (closure): the data passed to gimp_drawable_foreach_band()
+ *
+ * The function called by gimp_drawable_foreach_band() for each band of
+ * a drawable. @pixels holds @n_rows rows, top to bottom, of @width
+ * pixels, without any padding between rows. The function may modify
+ * them in place, for instance to swap bytes, but they are only valid
+ * until it returns.
+ *
+ * Returns: %TRUE to continue with the next band, %FALSE to stop.
+ *
+ * Since: 3.0
+ **/
+typedef gboolean (* GimpDrawableBandFunc) (guchar   *pixels,
+                                           gint      y,
+                                           gint      width,
+                                           gint      n_rows,
+                                           gpointer  user_data);
+
+
 struct _GimpDrawableClass
 {
   GimpItemClass parent_class;
@@ -63,6 +88,26 @@ GeglBuffer   * gimp_drawable_get_shadow_buffer      (GimpDrawable  *drawable) G_
 const Babl   * gimp_drawable_get_format             (GimpDrawable  *drawable);
 const Babl   * gimp_drawable_get_thumbnail_format   (GimpDrawable  *drawable);
 
+GBytes       * gimp_drawable_get_pixels             (GimpDrawable  *drawable,
+                                                     gint           x,
+                                                     gint           y,
+                                                     gint           width,
+                                                     gint           height,
+                                                     const Babl    *format);
+gboolean       gimp_drawable_set_pixels             (GimpDrawable  *drawable,
+                                                     gint           x,
+                                                     gint           y,
+                                                     gint           width,
+                                                     gint           height,
+                                                     const Babl    *format,
+                                                     GBytes        *pixels);
+
+gboolean       gimp_drawable_foreach_band           (GimpDrawable  *drawable,
+                                                     const Babl    *format,
+                                                     gboolean       bottom_up,
+                                                     GimpDrawableBandFunc func,
+                                                     gpointer       user_data);
+
 GBytes       * gimp_drawable_get_thumbnail_data     (GimpDrawable  *drawable,
                                                      gint           width,
                                                      gint           height,
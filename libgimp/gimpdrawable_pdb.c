@@ -199,6 +199,122 @@ gimp_drawable_set_pixel (GimpDrawable *drawable,
   return success;
 }
 
+/**
+ * _gimp_drawable_get_pixels:
+ * @drawable: The drawable.
+ * @x: The x coordinate of the region.
+ * @y: The y coordinate of the region.
+ * @width: The width of the region.
+ * @height: The height of the region.
+ * @format: The Babl encoding of the pixels.
+ *
+ * Gets the pixels of a region of the drawable.
+ *
+ * This procedure gets the pixels of the rectangular region at the
+ * specified coordinates, as @height rows of @width pixels in the
+ * specified format, without any padding between rows.
+ *
+ * The format is the name of a Babl encoding, such as \"R'G'B'A u8\",
+ * and is used in the color space of the drawable. An empty format gets
+ * the pixels in the drawable's own format, as returned by
+ * gimp_drawable_get_format().
+ *
+ * Returns: (transfer full): The pixels of the region.
+ *
+ * Since: 3.0
+ **/
+GBytes *
+_gimp_drawable_get_pixels (GimpDrawable *drawable,
+                           gint          x,
+                           gint          y,
+                           gint          width,
+                           gint          height,
+                           const gchar  *format)
+{
+  GimpValueArray *args;
+  GimpValueArray *return_vals;
+  GBytes *pixels = NULL;
+
+  args = gimp_value_array_new_from_types (NULL,
+                                          GIMP_TYPE_DRAWABLE, drawable,
+                                          G_TYPE_INT, x,
+                                          G_TYPE_INT, y,
+                                          G_TYPE_INT, width,
+                                          G_TYPE_INT, height,
+                                          G_TYPE_STRING, format,
+                                          G_TYPE_NONE);
+
+  return_vals = _gimp_pdb_run_procedure_array (gimp_get_pdb (),
+                                               "gimp-drawable-get-pixels",
+                                               args);
+  gimp_value_array_unref (args);
+
+  if (GIMP_VALUES_GET_ENUM (return_vals, 0) == GIMP_PDB_SUCCESS)
+    pixels = GIMP_VALUES_DUP_BYTES (return_vals, 1);
+
+  gimp_value_array_unref (return_vals);
+
+  return pixels;
+}
+
+/**
+ * _gimp_drawable_set_pixels:
+ * @drawable: The drawable.
+ * @x: The x coordinate of the region.
+ * @y: The y coordinate of the region.
+ * @width: The width of the region.
+ * @height: The height of the region.
+ * @format: The Babl encoding of the pixels.
+ * @pixels: The pixels of the region.
+ *
+ * Sets the pixels of a region of the drawable.
+ *
+ * This procedure sets the pixels of the rectangular region at the
+ * specified coordinates from @height rows of @width pixels in the
+ * specified format, without any padding between rows. See
+ * gimp_drawable_get_pixels() for the format.
+ * Note that this function is not undoable, you should use it only on
+ * drawables you just created yourself.
+ *
+ * Returns: TRUE on success.
+ *
+ * Since: 3.0
+ **/
+gboolean
+_gimp_drawable_set_pixels (GimpDrawable *drawable,
+                           gint          x,
+                           gint          y,
+                           gint          width,
+                           gint          height,
+                           const gchar  *format,
+                           GBytes       *pixels)
+{
+  GimpValueArray *args;
+  GimpValueArray *return_vals;
+  gboolean success = TRUE;
+
+  args = gimp_value_array_new_from_types (NULL,
+                                          GIMP_TYPE_DRAWABLE, drawable,
+                                          G_TYPE_INT, x,
+                                          G_TYPE_INT, y,
+                                          G_TYPE_INT, width,
+                                          G_TYPE_INT, height,
+                                          G_TYPE_STRING, format,
+                                          G_TYPE_BYTES, pixels,
+                                          G_TYPE_NONE);
+
+  return_vals = _gimp_pdb_run_procedure_array (gimp_get_pdb (),
+                                               "gimp-drawable-set-pixels",
+                                               args);
+  gimp_value_array_unref (args);
+
+  success = GIMP_VALUES_GET_ENUM (return_vals, 0) == GIMP_PDB_SUCCESS;
+
+  gimp_value_array_unref (return_vals);
+
+  return success;
+}
+
 /**
  * gimp_drawable_type:
  * @drawable: The drawable.
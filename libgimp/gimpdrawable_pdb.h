@@ -41,6 +41,19 @@ gboolean                 gimp_drawable_set_pixel             (GimpDrawable
                                                               gint                        x_coord,
                                                               gint                        y_coord,
                                                               GeglColor                  *color);
+G_GNUC_INTERNAL GBytes*  _gimp_drawable_get_pixels           (GimpDrawable               *drawable,
+                                                              gint                        x,
+                                                              gint                        y,
+                                                              gint                        width,
+                                                              gint                        height,
+                                                              const gchar                *format);
+G_GNUC_INTERNAL gboolean _gimp_drawable_set_pixels           (GimpDrawable               *drawable,
+                                                              gint                        x,
+                                                              gint                        y,
+                                                              gint                        width,
+                                                              gint                        height,
+                                                              const gchar                *format,
+                                                              GBytes                     *pixels);
 GimpImageType            gimp_drawable_type                  (GimpDrawable               *drawable);
 GimpImageType            gimp_drawable_type_with_alpha       (GimpDrawable               *drawable);
 gboolean                 gimp_drawable_has_alpha             (GimpDrawable               *drawable);
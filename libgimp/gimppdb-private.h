@@ -45,6 +45,10 @@ G_GNUC_INTERNAL GimpPDB        * _gimp_pdb_new                 (GimpPlugIn
 
 G_GNUC_INTERNAL GimpPlugIn     * _gimp_pdb_get_plug_in         (GimpPDB               *pdb);
 
+G_GNUC_INTERNAL gint             _gimp_pdb_run_batch           (GimpPDB               *pdb,
+                                                                struct _GPProcBatch   *proc_batch,
+                                                                GimpValueArray      ***results);
+
 gboolean                         gimp_pdb_get_data             (const gchar           *identifier,
                                                                 GBytes               **data);
 gboolean                         gimp_pdb_set_data             (const gchar           *identifier,
@@ -479,6 +479,66 @@ _gimp_pdb_run_procedure_array (GimpPDB              *pdb,
   return return_values;
 }
 
+/**
+ * _gimp_pdb_run_batch:
+ * @pdb:        the #GimpPDB object.
+ * @proc_batch: the calls to run.
+ * @results:    (out) (transfer full): return location for the return
+ *              values of the calls that ran.
+ *
+ * Runs the calls of @proc_batch in a single round trip. The core stops
+ * at the first call that fails, so there may be fewer @results than
+ * calls.
+ *
+ * Returns: the number of @results.
+ *
+ * Since: 3.0
+ */
+gint
+_gimp_pdb_run_batch (GimpPDB          *pdb,
+                     GPProcBatch      *proc_batch,
+                     GimpValueArray ***results)
+{
+  GPProcBatchReturn *proc_batch_return;
+  GimpWireMessage    msg;
+  gint               n_results;
+  gint               i;
+
+  g_return_val_if_fail (GIMP_IS_PDB (pdb), 0);
+  g_return_val_if_fail (proc_batch != NULL, 0);
+  g_return_val_if_fail (results != NULL, 0);
+
+  if (! gp_proc_batch_write (_gimp_plug_in_get_write_channel (pdb->plug_in),
+                             proc_batch, pdb->plug_in))
+    gimp_quit ();
+
+  _gimp_plug_in_read_expect_msg (pdb->plug_in, &msg, GP_PROC_BATCH_RETURN);
+
+  proc_batch_return = msg.data;
+
+  n_results = proc_batch_return->n_returns;
+  *results  = g_new0 (GimpValueArray *, n_results);
+
+  for (i = 0; i < n_results; i++)
+    {
+      GPProcReturn *proc_return = &proc_batch_return->returns[i];
+
+      (*results)[i] =
+        _gimp_gp_params_to_value_array (NULL,
+                                        NULL, 0,
+                                        proc_return->params,
+                                        proc_return->n_params,
+                                        TRUE);
+    }
+
+  gimp_wire_destroy (&msg);
+
+  if (n_results > 0)
+    gimp_pdb_set_error (pdb, (*results)[n_results - 1]);
+
+  return n_results;
+}
+
 
 /*  private functions  */
 
@@ -0,0 +1,395 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimppdbbatch.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include "gimp.h"
+
+#include "libgimpbase/gimpprotocol.h"
+
+#include "gimpgpparams.h"
+#include "gimppdb-private.h"
+#include "gimpprocedureconfig-private.h"
+
+
+/**
+ * GimpPDBBatch:
+ *
+ * A sequence of procedure calls which are sent to the core together,
+ * and run there one after the other.
+ *
+ * Calling procedures one by one costs a round trip to the core each.
+ * Scripts which call many cheap procedures, e.g. to set properties on
+ * thousands of layers, spend most of their time waiting for these.
+ * A batch needs a single round trip for all of its calls.
+ *
+ * An argument of a call may refer to a return value of an earlier call
+ * of the same batch, see [method@PDBBatch.add_reference]; the value is
+ * then filled in by the core.
+ *
+ * Since: 3.0
+ */
+
+
+typedef struct
+{
+  GimpProcedure  *procedure;
+  GimpValueArray *args;
+  GArray         *refs;
+} BatchCall;
+
+struct _GimpPDBBatch
+{
+  GObject          parent_instance;
+
+  GimpPDB         *pdb;
+
+  GArray          *calls;
+  GimpValueArray **results;
+  gint             n_results;
+};
+
+
+static void   gimp_pdb_batch_finalize      (GObject      *object);
+
+static void   gimp_pdb_batch_clear_results (GimpPDBBatch *batch);
+static void   batch_call_clear             (BatchCall    *call);
+
+
+G_DEFINE_TYPE (GimpPDBBatch, gimp_pdb_batch, G_TYPE_OBJECT)
+
+#define parent_class gimp_pdb_batch_parent_class
+
+
+static void
+gimp_pdb_batch_class_init (GimpPDBBatchClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = gimp_pdb_batch_finalize;
+}
+
+static void
+gimp_pdb_batch_init (GimpPDBBatch *batch)
+{
+  batch->calls = g_array_new (FALSE, TRUE, sizeof (BatchCall));
+
+  g_array_set_clear_func (batch->calls, (GDestroyNotify) batch_call_clear);
+}
+
+static void
+gimp_pdb_batch_finalize (GObject *object)
+{
+  GimpPDBBatch *batch = GIMP_PDB_BATCH (object);
+
+  gimp_pdb_batch_clear_results (batch);
+
+  g_clear_pointer (&batch->calls, g_array_unref);
+  g_clear_object (&batch->pdb);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+
+/*  public functions  */
+
+/**
+ * gimp_pdb_batch_new:
+ * @pdb: the #GimpPDB object.
+ *
+ * Creates an empty batch of procedure calls.
+ *
+ * Returns: (transfer full): the new #GimpPDBBatch.
+ *
+ * Since: 3.0
+ **/
+GimpPDBBatch *
+gimp_pdb_batch_new (GimpPDB *pdb)
+{
+  GimpPDBBatch *batch;
+
+  g_return_val_if_fail (GIMP_IS_PDB (pdb), NULL);
+
+  batch = g_object_new (GIMP_TYPE_PDB_BATCH, NULL);
+
+  batch->pdb = g_object_ref (pdb);
+
+  return batch;
+}
+
+/**
+ * gimp_pdb_batch_add:
+ * @batch:  a #GimpPDBBatch.
+ * @config: the arguments of the call.
+ *
+ * Appends a call of the procedure of @config, with the current values
+ * of @config, to @batch. Later changes to @config don't affect the
+ * call.
+ *
+ * Returns: the index of the call in @batch.
+ *
+ * Since: 3.0
+ **/
+gint
+gimp_pdb_batch_add (GimpPDBBatch        *batch,
+                    GimpProcedureConfig *config)
+{
+  BatchCall    call = { 0, };
+  GParamSpec **arg_specs;
+  gint         n_arg_specs;
+  gint         i;
+
+  g_return_val_if_fail (GIMP_IS_PDB_BATCH (batch), -1);
+  g_return_val_if_fail (GIMP_IS_PROCEDURE_CONFIG (config), -1);
+
+  call.procedure = g_object_ref (gimp_procedure_config_get_procedure (config));
+  call.refs      = g_array_new (FALSE, FALSE, sizeof (GPProcBatchRef));
+
+  arg_specs = gimp_procedure_get_arguments (call.procedure, &n_arg_specs);
+
+  call.args = gimp_value_array_new (n_arg_specs);
+
+  for (i = 0; i < n_arg_specs; i++)
+    {
+      GValue value = G_VALUE_INIT;
+
+      g_value_init (&value, G_PARAM_SPEC_VALUE_TYPE (arg_specs[i]));
+      gimp_value_array_append (call.args, &value);
+      g_value_unset (&value);
+    }
+
+  _gimp_procedure_config_get_values (config, call.args);
+
+  g_array_append_val (batch->calls, call);
+
+  return batch->calls->len - 1;
+}
+
+/**
+ * gimp_pdb_batch_add_reference:
+ * @batch:        a #GimpPDBBatch.
+ * @call:         the index of a call in @batch.
+ * @arg_name:     the name of an argument of @call.
+ * @source_call:  the index of an earlier call in @batch.
+ * @source_value: the index of a return value of @source_call, as in the
+ *                array returned by [method@Procedure.run], i.e. 0 is
+ *                the status and 1 the first actual value.
+ *
+ * Makes @call use a return value of @source_call for its argument
+ * @arg_name, instead of the value it was added with. This allows e.g.
+ * to create a layer and set its properties in the same batch.
+ *
+ * Returns: %TRUE if the reference was added.
+ *
+ * Since: 3.0
+ **/
+gboolean
+gimp_pdb_batch_add_reference (GimpPDBBatch *batch,
+                              gint          call,
+                              const gchar  *arg_name,
+                              gint          source_call,
+                              gint          source_value)
+{
+  BatchCall       *batch_call;
+  GParamSpec     **arg_specs;
+  gint             n_arg_specs;
+  GPProcBatchRef   ref;
+  gint             i;
+
+  g_return_val_if_fail (GIMP_IS_PDB_BATCH (batch), FALSE);
+  g_return_val_if_fail (call >= 0 && call < batch->calls->len, FALSE);
+  g_return_val_if_fail (arg_name != NULL, FALSE);
+  g_return_val_if_fail (source_call >= 0 && source_call < call, FALSE);
+  g_return_val_if_fail (source_value >= 0, FALSE);
+
+  batch_call = &g_array_index (batch->calls, BatchCall, call);
+
+  arg_specs = gimp_procedure_get_arguments (batch_call->procedure,
+                                            &n_arg_specs);
+
+  for (i = 0; i < n_arg_specs; i++)
+    {
+      if (! strcmp (arg_specs[i]->name, arg_name))
+        break;
+    }
+
+  if (i == n_arg_specs)
+    {
+      g_warning ("%s: procedure '%s' has no argument named '%s'",
+                 G_STRFUNC,
+                 gimp_procedure_get_name (batch_call->procedure),
+                 arg_name);
+      return FALSE;
+    }
+
+  ref.param = i;
+  ref.call  = source_call;
+  ref.value = source_value;
+
+  g_array_append_val (batch_call->refs, ref);
+
+  return TRUE;
+}
+
+/**
+ * gimp_pdb_batch_get_n_calls:
+ * @batch: a #GimpPDBBatch.
+ *
+ * Returns: the number of calls added to @batch since it last ran.
+ *
+ * Since: 3.0
+ **/
+gint
+gimp_pdb_batch_get_n_calls (GimpPDBBatch *batch)
+{
+  g_return_val_if_fail (GIMP_IS_PDB_BATCH (batch), 0);
+
+  return batch->calls->len;
+}
+
+/**
+ * gimp_pdb_batch_run:
+ * @batch: a #GimpPDBBatch.
+ *
+ * Runs the calls of @batch, in order, in a single round trip to the
+ * core. The calls after the first one that fails are not run.
+ *
+ * Afterwards, @batch is empty again and can be reused; the return
+ * values of the calls that ran are available with
+ * [method@PDBBatch.get_return_values] until it runs again. The status
+ * and error message of the last call that ran are available with
+ * [method@PDB.get_last_status] and [method@PDB.get_last_error].
+ *
+ * Returns: %TRUE if all calls ran successfully.
+ *
+ * Since: 3.0
+ **/
+gboolean
+gimp_pdb_batch_run (GimpPDBBatch *batch)
+{
+  GPProcBatch proc_batch;
+  gint        n_calls;
+  gint        i;
+
+  g_return_val_if_fail (GIMP_IS_PDB_BATCH (batch), FALSE);
+
+  gimp_pdb_batch_clear_results (batch);
+
+  n_calls = batch->calls->len;
+
+  if (n_calls == 0)
+    return TRUE;
+
+  proc_batch.n_calls = n_calls;
+  proc_batch.calls   = g_new0 (GPProcBatchCall, n_calls);
+
+  for (i = 0; i < n_calls; i++)
+    {
+      BatchCall       *call       = &g_array_index (batch->calls, BatchCall, i);
+      GPProcBatchCall *proc_call  = &proc_batch.calls[i];
+
+      proc_call->proc_run.name     = (gchar *) gimp_procedure_get_name (call->procedure);
+      proc_call->proc_run.n_params = gimp_value_array_length (call->args);
+      proc_call->proc_run.params   = _gimp_value_array_to_gp_params (call->args,
+                                                                     FALSE);
+      proc_call->n_refs            = call->refs->len;
+      proc_call->refs              = (GPProcBatchRef *) call->refs->data;
+    }
+
+  batch->n_results = _gimp_pdb_run_batch (batch->pdb, &proc_batch,
+                                          &batch->results);
+
+  for (i = 0; i < n_calls; i++)
+    _gimp_gp_params_free (proc_batch.calls[i].proc_run.params,
+                          proc_batch.calls[i].proc_run.n_params, FALSE);
+
+  g_free (proc_batch.calls);
+
+  g_array_set_size (batch->calls, 0);
+
+  return (batch->n_results == n_calls &&
+          gimp_pdb_get_last_status (batch->pdb) == GIMP_PDB_SUCCESS);
+}
+
+/**
+ * gimp_pdb_batch_get_n_results:
+ * @batch: a #GimpPDBBatch.
+ *
+ * Returns: the number of calls which ran the last time @batch ran.
+ *
+ * Since: 3.0
+ **/
+gint
+gimp_pdb_batch_get_n_results (GimpPDBBatch *batch)
+{
+  g_return_val_if_fail (GIMP_IS_PDB_BATCH (batch), 0);
+
+  return batch->n_results;
+}
+
+/**
+ * gimp_pdb_batch_get_return_values:
+ * @batch: a #GimpPDBBatch.
+ * @call:  the index the call had in @batch.
+ *
+ * Returns the return values of a call the last time @batch ran, in
+ * the same form as [method@Procedure.run].
+ *
+ * Returns: (nullable) (transfer none): the return values, or %NULL if
+ *          @call didn't run.
+ *
+ * Since: 3.0
+ **/
+GimpValueArray *
+gimp_pdb_batch_get_return_values (GimpPDBBatch *batch,
+                                  gint          call)
+{
+  g_return_val_if_fail (GIMP_IS_PDB_BATCH (batch), NULL);
+  g_return_val_if_fail (call >= 0, NULL);
+
+  if (call >= batch->n_results)
+    return NULL;
+
+  return batch->results[call];
+}
+
+
+/*  private functions  */
+
+static void
+gimp_pdb_batch_clear_results (GimpPDBBatch *batch)
+{
+  gint i;
+
+  for (i = 0; i < batch->n_results; i++)
+    gimp_value_array_unref (batch->results[i]);
+
+  g_clear_pointer (&batch->results, g_free);
+  batch->n_results = 0;
+}
+
+static void
+batch_call_clear (BatchCall *call)
+{
+  g_clear_object (&call->procedure);
+  g_clear_pointer (&call->args, gimp_value_array_unref);
+  g_clear_pointer (&call->refs, g_array_unref);
+}
@@ -1370,6 +1370,11 @@ gimp_plug_in_loop (GimpPlugIn *plug_in)
         case GP_HAS_INIT:
           g_warning ("unexpected has init message received (should not happen)");
           break;
+
+        case GP_PROC_BATCH:
+        case GP_PROC_BATCH_RETURN:
+          g_warning ("unexpected proc batch message received (should not happen)");
+          break;
         }
 
       gimp_wire_destroy (&msg);
@@ -1428,6 +1433,10 @@ gimp_plug_in_process_message (GimpPlugIn      *plug_in,
     case GP_HAS_INIT:
       g_warning ("unexpected has init message received (should not happen)");
       break;
+    case GP_PROC_BATCH:
+    case GP_PROC_BATCH_RETURN:
+      g_warning ("unexpected proc batch message received (should not happen)");
+      break;
     }
 }
 
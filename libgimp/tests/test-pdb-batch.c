@@ -0,0 +1,163 @@
+static GimpProcedureConfig *
+create_config (const gchar *procedure_name)
+{
+  GimpProcedure *procedure;
+
+  procedure = gimp_pdb_lookup_procedure (gimp_get_pdb (), procedure_name);
+
+  return gimp_procedure_create_config (procedure);
+}
+
+static gint
+add_set_name (GimpPDBBatch *batch,
+              GimpItem     *item,
+              const gchar  *name)
+{
+  GimpProcedureConfig *config = create_config ("gimp-item-set-name");
+  gint                 call;
+
+  g_object_set (config,
+                "item", item,
+                "name", name,
+                NULL);
+  call = gimp_pdb_batch_add (batch, config);
+  g_object_unref (config);
+
+  return call;
+}
+
+static GimpValueArray *
+gimp_c_test_run (GimpProcedure        *procedure,
+                 GimpRunMode           run_mode,
+                 GimpImage            *image,
+                 GimpDrawable        **drawables,
+                 GimpProcedureConfig  *config,
+                 gpointer              run_data)
+{
+  GimpImage           *new_image;
+  GimpPDBBatch        *batch;
+  GimpProcedureConfig *call_config;
+  GimpValueArray      *values;
+  GimpLayer           *layer = NULL;
+  GimpLayer          **layers;
+  gint                 new_call;
+  gint                 insert_call;
+  gint                 name_call;
+  gchar               *name;
+
+  new_image = gimp_image_new (32, 32, GIMP_RGB);
+  batch     = gimp_pdb_batch_new (gimp_get_pdb ());
+
+  GIMP_TEST_START("gimp_pdb_batch_run() of an empty batch");
+  GIMP_TEST_END(gimp_pdb_batch_run (batch) &&
+                gimp_pdb_batch_get_n_results (batch) == 0);
+
+  /* A layer is created, inserted and renamed in one round trip, the
+   * last two calls referring to the return value of the first.
+   */
+  call_config = create_config ("gimp-layer-new");
+  g_object_set (call_config,
+                "image",   new_image,
+                "width",   16,
+                "height",  8,
+                "type",    GIMP_RGBA_IMAGE,
+                "name",    "layer",
+                "opacity", 100.0,
+                NULL);
+  new_call = gimp_pdb_batch_add (batch, call_config);
+  g_object_unref (call_config);
+
+  call_config = create_config ("gimp-image-insert-layer");
+  g_object_set (call_config,
+                "image",    new_image,
+                "position", 0,
+                NULL);
+  insert_call = gimp_pdb_batch_add (batch, call_config);
+  g_object_unref (call_config);
+
+  name_call = add_set_name (batch, NULL, "batched");
+
+  GIMP_TEST_START("gimp_pdb_batch_add() returns the index of the call");
+  GIMP_TEST_END(new_call == 0 && insert_call == 1 && name_call == 2 &&
+                gimp_pdb_batch_get_n_calls (batch) == 3);
+
+  GIMP_TEST_START("gimp_pdb_batch_add_reference()");
+  GIMP_TEST_END(gimp_pdb_batch_add_reference (batch, insert_call, "layer",
+                                              new_call, 1) &&
+                gimp_pdb_batch_add_reference (batch, name_call, "item",
+                                              new_call, 1));
+
+  GIMP_TEST_START("gimp_pdb_batch_run() with references");
+  GIMP_TEST_END(gimp_pdb_batch_run (batch) &&
+                gimp_pdb_batch_get_n_results (batch) == 3 &&
+                gimp_pdb_batch_get_n_calls (batch) == 0);
+
+  GIMP_TEST_START("gimp_pdb_batch_get_return_values()");
+  values = gimp_pdb_batch_get_return_values (batch, new_call);
+  if (values && gimp_value_array_length (values) == 2)
+    layer = GIMP_VALUES_GET_LAYER (values, 1);
+  GIMP_TEST_END(GIMP_IS_LAYER (layer) &&
+                GIMP_VALUES_GET_ENUM (values, 0) == GIMP_PDB_SUCCESS);
+
+  GIMP_TEST_START("the batched calls ran in order");
+  layers = gimp_image_get_layers (new_image);
+  name   = gimp_item_get_name (GIMP_ITEM (layer));
+  GIMP_TEST_END(layers[0] == layer && layers[1] == NULL &&
+                gimp_drawable_get_width (GIMP_DRAWABLE (layer)) == 16 &&
+                g_strcmp0 (name, "batched") == 0);
+  g_free (layers);
+  g_free (name);
+
+  /* The second call fails, as the layer is in the image already: the
+   * first call takes effect, the third doesn't run.
+   */
+  add_set_name (batch, GIMP_ITEM (layer), "first");
+
+  call_config = create_config ("gimp-image-insert-layer");
+  g_object_set (call_config,
+                "image",    new_image,
+                "layer",    layer,
+                "position", 0,
+                NULL);
+  gimp_pdb_batch_add (batch, call_config);
+  g_object_unref (call_config);
+
+  add_set_name (batch, GIMP_ITEM (layer), "third");
+
+  GIMP_TEST_START("gimp_pdb_batch_run() with a failing call");
+  GIMP_TEST_END(! gimp_pdb_batch_run (batch) &&
+                gimp_pdb_batch_get_n_results (batch) == 2 &&
+                gimp_pdb_get_last_status (gimp_get_pdb ()) != GIMP_PDB_SUCCESS);
+
+  GIMP_TEST_START("gimp_pdb_batch_get_return_values() of the failed call");
+  values = gimp_pdb_batch_get_return_values (batch, 1);
+  GIMP_TEST_END(values != NULL &&
+                GIMP_VALUES_GET_ENUM (values, 0) != GIMP_PDB_SUCCESS &&
+                gimp_pdb_batch_get_return_values (batch, 2) == NULL);
+
+  GIMP_TEST_START("the calls after the failing call did not run");
+  name = gimp_item_get_name (GIMP_ITEM (layer));
+  GIMP_TEST_END(g_strcmp0 (name, "first") == 0);
+  g_free (name);
+
+  /* A reference to a return value the call doesn't have fails the
+   * call in the core.
+   */
+  name_call = add_set_name (batch, GIMP_ITEM (layer), "fourth");
+  add_set_name (batch, GIMP_ITEM (layer), "fifth");
+  gimp_pdb_batch_add_reference (batch, 1, "item", name_call, 1);
+
+  GIMP_TEST_START("gimp_pdb_batch_run() with a missing return value");
+  GIMP_TEST_END(! gimp_pdb_batch_run (batch) &&
+                gimp_pdb_batch_get_n_results (batch) == 2);
+
+  GIMP_TEST_START("the call with the missing return value did not run");
+  name = gimp_item_get_name (GIMP_ITEM (layer));
+  GIMP_TEST_END(g_strcmp0 (name, "fourth") == 0);
+  g_free (name);
+
+  g_object_unref (batch);
+  gimp_image_delete (new_image);
+
+  GIMP_TEST_RETURN
+}
@@ -0,0 +1,99 @@
+#!/usr/bin/env python3
+
+def create_config(procedure_name):
+  proc = Gimp.get_pdb().lookup_procedure(procedure_name)
+  return proc.create_config()
+
+def add_set_name(batch, item, name):
+  config = create_config('gimp-item-set-name')
+  config.set_property('item', item)
+  config.set_property('name', name)
+  return batch.add(config)
+
+image = Gimp.Image.new(32, 32, Gimp.ImageBaseType.RGB)
+batch = Gimp.PDBBatch.new(Gimp.get_pdb())
+
+gimp_assert('Gimp.PDBBatch.run() of an empty batch',
+            batch.run() and batch.get_n_results() == 0)
+
+# A layer is created, inserted and renamed in one round trip, the last
+# two calls referring to the return value of the first.
+
+config = create_config('gimp-layer-new')
+config.set_property('image', image)
+config.set_property('width', 16)
+config.set_property('height', 8)
+config.set_property('type', Gimp.ImageType.RGBA_IMAGE)
+config.set_property('name', 'layer')
+config.set_property('opacity', 100.0)
+new_call = batch.add(config)
+
+config = create_config('gimp-image-insert-layer')
+config.set_property('image', image)
+config.set_property('position', 0)
+insert_call = batch.add(config)
+
+name_call = add_set_name(batch, None, 'batched')
+
+gimp_assert('Gimp.PDBBatch.add() returns the index of the call',
+            new_call == 0 and insert_call == 1 and name_call == 2 and
+            batch.get_n_calls() == 3)
+
+gimp_assert('Gimp.PDBBatch.add_reference()',
+            batch.add_reference(insert_call, 'layer', new_call, 1) and
+            batch.add_reference(name_call, 'item', new_call, 1))
+
+gimp_assert('Gimp.PDBBatch.run() with references',
+            batch.run() and batch.get_n_results() == 3 and
+            batch.get_n_calls() == 0)
+
+values = batch.get_return_values(new_call)
+gimp_assert('Gimp.PDBBatch.get_return_values()',
+            values.length() == 2 and
+            values.index(0) == Gimp.PDBStatusType.SUCCESS and
+            type(values.index(1)) == Gimp.Layer)
+
+layer = values.index(1)
+gimp_assert('the batched calls ran in order',
+            image.get_layers() == [layer] and
+            layer.get_width() == 16 and
+            layer.get_name() == 'batched')
+
+# The second call fails, as the layer is in the image already: the first
+# call takes effect, the third doesn't run.
+
+add_set_name(batch, layer, 'first')
+
+config = create_config('gimp-image-insert-layer')
+config.set_property('image', image)
+config.set_property('layer', layer)
+config.set_property('position', 0)
+batch.add(config)
+
+add_set_name(batch, layer, 'third')
+
+gimp_assert('Gimp.PDBBatch.run() with a failing call',
+            not batch.run() and batch.get_n_results() == 2 and
+            Gimp.get_pdb().get_last_status() != Gimp.PDBStatusType.SUCCESS)
+
+gimp_assert('Gimp.PDBBatch.get_return_values() of the failed call',
+            batch.get_return_values(1).index(0) != Gimp.PDBStatusType.SUCCESS and
+            batch.get_return_values(2) is None)
+
+gimp_assert('the calls after the failing call did not run',
+            layer.get_name() == 'first')
+
+# A reference to a return value the call doesn't have fails the call in
+# the core.
+
+name_call = add_set_name(batch, layer, 'fourth')
+add_set_name(batch, layer, 'fifth')
+batch.add_reference(1, 'item', name_call, 1)
+
+gimp_assert('Gimp.PDBBatch.run() with a missing return value',
+            not batch.run() and batch.get_n_results() == 2)
+
+gimp_assert('the call with the missing return value did not run',
+            layer.get_name() == 'fourth')
+
+image.delete()
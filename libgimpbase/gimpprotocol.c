@@ -146,6 +146,22 @@ static void _gp_has_init_write           (GIOChannel       *channel,
                                           gpointer          user_data);
 static void _gp_has_init_destroy         (GimpWireMessage  *msg);
 
+static void _gp_proc_batch_read          (GIOChannel       *channel,
+                                          GimpWireMessage  *msg,
+                                          gpointer          user_data);
+static void _gp_proc_batch_write         (GIOChannel       *channel,
+                                          GimpWireMessage  *msg,
+                                          gpointer          user_data);
+static void _gp_proc_batch_destroy       (GimpWireMessage  *msg);
+
+static void _gp_proc_batch_return_read    (GIOChannel       *channel,
+                                           GimpWireMessage  *msg,
+                                           gpointer          user_data);
+static void _gp_proc_batch_return_write   (GIOChannel       *channel,
+                                           GimpWireMessage  *msg,
+                                           gpointer          user_data);
+static void _gp_proc_batch_return_destroy (GimpWireMessage  *msg);
+
 
 
 void
@@ -203,6 +219,14 @@ gp_init (void)
                       _gp_has_init_read,
                       _gp_has_init_write,
                       _gp_has_init_destroy);
+  gimp_wire_register (GP_PROC_BATCH,
+                      _gp_proc_batch_read,
+                      _gp_proc_batch_write,
+                      _gp_proc_batch_destroy);
+  gimp_wire_register (GP_PROC_BATCH_RETURN,
+                      _gp_proc_batch_return_read,
+                      _gp_proc_batch_return_write,
+                      _gp_proc_batch_return_destroy);
 }
 
 /* public writing API */
@@ -450,6 +474,44 @@ gp_has_init_write (GIOChannel *channel,
   return TRUE;
 }
 
+gboolean
+gp_proc_batch_write (GIOChannel  *channel,
+                     GPProcBatch *proc_batch,
+                     gpointer     user_data)
+{
+  GimpWireMessage msg;
+
+  msg.type = GP_PROC_BATCH;
+  msg.data = proc_batch;
+
+  if (! gimp_wire_write_msg (channel, &msg, user_data))
+    return FALSE;
+
+  if (! gimp_wire_flush (channel, user_data))
+    return FALSE;
+
+  return TRUE;
+}
+
+gboolean
+gp_proc_batch_return_write (GIOChannel        *channel,
+                            GPProcBatchReturn *proc_batch_return,
+                            gpointer           user_data)
+{
+  GimpWireMessage msg;
+
+  msg.type = GP_PROC_BATCH_RETURN;
+  msg.data = proc_batch_return;
+
+  if (! gimp_wire_write_msg (channel, &msg, user_data))
+    return FALSE;
+
+  if (! gimp_wire_flush (channel, user_data))
+    return FALSE;
+
+  return TRUE;
+}
+
 /*  quit  */
 
 static void
@@ -2456,3 +2518,238 @@ static void
 _gp_has_init_destroy (GimpWireMessage *msg)
 {
 }
+
+/*  proc_batch  */
+
+static void
+_gp_proc_batch_read (GIOChannel      *channel,
+                     GimpWireMessage *msg,
+                     gpointer         user_data)
+{
+  GPProcBatch *proc_batch = g_slice_new0 (GPProcBatch);
+  guint32      n_calls;
+  guint        i;
+
+  msg->data = proc_batch;
+
+  if (! _gimp_wire_read_int32 (channel, &n_calls, 1, user_data))
+    goto cleanup;
+
+  if (n_calls == 0)
+    return;
+
+  /* We may read crap on the wire, see _gp_params_read() */
+  proc_batch->calls = g_try_new0 (GPProcBatchCall, n_calls);
+
+  if (! proc_batch->calls)
+    goto cleanup;
+
+  for (i = 0; i < n_calls; i++)
+    {
+      GPProcBatchCall *call = &proc_batch->calls[i];
+      guint            j;
+
+      if (! _gimp_wire_read_string (channel,
+                                    &call->proc_run.name, 1, user_data))
+        goto cleanup;
+
+      proc_batch->n_calls++;
+
+      _gp_params_read (channel,
+                       &call->proc_run.params,
+                       (guint *) &call->proc_run.n_params,
+                       user_data);
+
+      if (! _gimp_wire_read_int32 (channel, &call->n_refs, 1, user_data))
+        goto cleanup;
+
+      if (call->n_refs == 0)
+        continue;
+
+      call->refs = g_try_new0 (GPProcBatchRef, call->n_refs);
+
+      if (! call->refs)
+        {
+          call->n_refs = 0;
+          goto cleanup;
+        }
+
+      for (j = 0; j < call->n_refs; j++)
+        {
+          if (! _gimp_wire_read_int32 (channel,
+                                       &call->refs[j].param, 1, user_data) ||
+              ! _gimp_wire_read_int32 (channel,
+                                       &call->refs[j].call, 1, user_data) ||
+              ! _gimp_wire_read_int32 (channel,
+                                       &call->refs[j].value, 1, user_data))
+            goto cleanup;
+        }
+    }
+
+  return;
+
+ cleanup:
+  _gp_proc_batch_destroy (msg);
+  msg->data = NULL;
+}
+
+static void
+_gp_proc_batch_write (GIOChannel      *channel,
+                      GimpWireMessage *msg,
+                      gpointer         user_data)
+{
+  GPProcBatch *proc_batch = msg->data;
+  guint        i;
+
+  if (! _gimp_wire_write_int32 (channel,
+                                &proc_batch->n_calls, 1, user_data))
+    return;
+
+  for (i = 0; i < proc_batch->n_calls; i++)
+    {
+      GPProcBatchCall *call = &proc_batch->calls[i];
+      guint            j;
+
+      if (! _gimp_wire_write_string (channel,
+                                     &call->proc_run.name, 1, user_data))
+        return;
+
+      _gp_params_write (channel,
+                        call->proc_run.params, call->proc_run.n_params,
+                        user_data);
+
+      if (! _gimp_wire_write_int32 (channel, &call->n_refs, 1, user_data))
+        return;
+
+      for (j = 0; j < call->n_refs; j++)
+        {
+          if (! _gimp_wire_write_int32 (channel,
+                                        &call->refs[j].param, 1, user_data) ||
+              ! _gimp_wire_write_int32 (channel,
+                                        &call->refs[j].call, 1, user_data) ||
+              ! _gimp_wire_write_int32 (channel,
+                                        &call->refs[j].value, 1, user_data))
+            return;
+        }
+    }
+}
+
+static void
+_gp_proc_batch_destroy (GimpWireMessage *msg)
+{
+  GPProcBatch *proc_batch = msg->data;
+
+  if (proc_batch)
+    {
+      guint i;
+
+      for (i = 0; i < proc_batch->n_calls; i++)
+        {
+          GPProcBatchCall *call = &proc_batch->calls[i];
+
+          _gp_params_destroy (call->proc_run.params, call->proc_run.n_params);
+
+          g_free (call->proc_run.name);
+          g_free (call->refs);
+        }
+
+      g_free (proc_batch->calls);
+      g_slice_free (GPProcBatch, proc_batch);
+    }
+}
+
+/*  proc_batch_return  */
+
+static void
+_gp_proc_batch_return_read (GIOChannel      *channel,
+                            GimpWireMessage *msg,
+                            gpointer         user_data)
+{
+  GPProcBatchReturn *proc_batch_return = g_slice_new0 (GPProcBatchReturn);
+  guint32            n_returns;
+  guint              i;
+
+  msg->data = proc_batch_return;
+
+  if (! _gimp_wire_read_int32 (channel, &n_returns, 1, user_data))
+    goto cleanup;
+
+  if (n_returns == 0)
+    return;
+
+  proc_batch_return->returns = g_try_new0 (GPProcReturn, n_returns);
+
+  if (! proc_batch_return->returns)
+    goto cleanup;
+
+  for (i = 0; i < n_returns; i++)
+    {
+      GPProcReturn *proc_return = &proc_batch_return->returns[i];
+
+      if (! _gimp_wire_read_string (channel,
+                                    &proc_return->name, 1, user_data))
+        goto cleanup;
+
+      proc_batch_return->n_returns++;
+
+      _gp_params_read (channel,
+                       &proc_return->params,
+                       (guint *) &proc_return->n_params,
+                       user_data);
+    }
+
+  return;
+
+ cleanup:
+  _gp_proc_batch_return_destroy (msg);
+  msg->data = NULL;
+}
+
+static void
+_gp_proc_batch_return_write (GIOChannel      *channel,
+                             GimpWireMessage *msg,
+                             gpointer         user_data)
+{
+  GPProcBatchReturn *proc_batch_return = msg->data;
+  guint              i;
+
+  if (! _gimp_wire_write_int32 (channel,
+                                &proc_batch_return->n_returns, 1, user_data))
+    return;
+
+  for (i = 0; i < proc_batch_return->n_returns; i++)
+    {
+      GPProcReturn *proc_return = &proc_batch_return->returns[i];
+
+      if (! _gimp_wire_write_string (channel,
+                                     &proc_return->name, 1, user_data))
+        return;
+
+      _gp_params_write (channel,
+                        proc_return->params, proc_return->n_params,
+                        user_data);
+    }
+}
+
+static void
+_gp_proc_batch_return_destroy (GimpWireMessage *msg)
+{
+  GPProcBatchReturn *proc_batch_return = msg->data;
+
+  if (proc_batch_return)
+    {
+      guint i;
+
+      for (i = 0; i < proc_batch_return->n_returns; i++)
+        {
+          GPProcReturn *proc_return = &proc_batch_return->returns[i];
+
+          _gp_params_destroy (proc_return->params, proc_return->n_params);
+
+          g_free (proc_return->name);
+        }
+
+      g_free (proc_batch_return->returns);
+      g_slice_free (GPProcBatchReturn, proc_batch_return);
+    }
+}
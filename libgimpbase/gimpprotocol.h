@@ -26,7 +26,7 @@ G_BEGIN_DECLS
 
 /* Increment every time the protocol changes
  */
-#define GIMP_PROTOCOL_VERSION  0x0114
+#define GIMP_PROTOCOL_VERSION  0x0115
 
 
 enum
@@ -43,7 +43,9 @@ enum
   GP_PROC_INSTALL,
   GP_PROC_UNINSTALL,
   GP_EXTENSION_ACK,
-  GP_HAS_INIT
+  GP_HAS_INIT,
+  GP_PROC_BATCH,
+  GP_PROC_BATCH_RETURN
 };
 
 typedef enum
@@ -110,6 +112,10 @@ typedef struct _GPProcRun                GPProcRun;
 typedef struct _GPProcReturn             GPProcReturn;
 typedef struct _GPProcInstall            GPProcInstall;
 typedef struct _GPProcUninstall          GPProcUninstall;
+typedef struct _GPProcBatchRef           GPProcBatchRef;
+typedef struct _GPProcBatchCall          GPProcBatchCall;
+typedef struct _GPProcBatch              GPProcBatch;
+typedef struct _GPProcBatchReturn        GPProcBatchReturn;
 
 
 struct _GPConfig
@@ -358,6 +364,32 @@ struct _GPProcUninstall
   gchar *name;
 };
 
+struct _GPProcBatchRef
+{
+  guint32 param;  /* the argument of the call to replace, from 0   */
+  guint32 call;   /* an earlier call of the batch, from 0          */
+  guint32 value;  /* its return value to use, 0 is the status      */
+};
+
+struct _GPProcBatchCall
+{
+  GPProcRun       proc_run;
+  guint32         n_refs;
+  GPProcBatchRef *refs;
+};
+
+struct _GPProcBatch
+{
+  guint32          n_calls;
+  GPProcBatchCall *calls;
+};
+
+struct _GPProcBatchReturn
+{
+  guint32       n_returns;
+  GPProcReturn *returns;
+};
+
 
 void      gp_init                   (void);
 
@@ -396,6 +428,12 @@ gboolean  gp_extension_ack_write    (GIOChannel      *channel,
                                      gpointer         user_data);
 gboolean  gp_has_init_write         (GIOChannel      *channel,
                                      gpointer         user_data);
+gboolean  gp_proc_batch_write       (GIOChannel      *channel,
+                                     GPProcBatch     *proc_batch,
+                                     gpointer         user_data);
+gboolean  gp_proc_batch_return_write (GIOChannel        *channel,
+                                      GPProcBatchReturn *proc_batch_return,
+                                      gpointer           user_data);
 
 
 G_END_DECLS
@@ -87,6 +87,11 @@ static gboolean         export_image              (GFile                 *file,
                                                    GimpImage             *image,
                                                    GimpDrawable          *drawable,
                                                    GError               **error);
+static gboolean         export_band               (guchar                *pixels,
+                                                   gint                   y,
+                                                   gint                   width,
+                                                   gint                   n_rows,
+                                                   gpointer               user_data);
 
 
 G_DEFINE_TYPE (Farbfeld, farbfeld, GIMP_TYPE_PLUG_IN)
@@ -335,14 +340,13 @@ export_image (GFile         *file,
               GError       **error)
 {
   FILE       *fp;
-  GeglBuffer *buffer;
-  guint16    *pixels;
   const Babl *format = babl_format ("R'G'B'A u16");
   gchar      *magic_number;
   guint32     image_width;
   guint32     image_height;
   guint32     export_width;
   guint32     export_height;
+  gboolean    success;
 
   gimp_progress_init_printf (_("Exporting '%s'"),
                              gimp_file_get_utf8_name (file));
@@ -357,10 +361,8 @@ export_image (GFile         *file,
       return FALSE;
     }
 
-  buffer = gimp_drawable_get_buffer (drawable);
-
-  image_width = gegl_buffer_get_width (buffer);
-  image_height = gegl_buffer_get_height (buffer);
+  image_width = gimp_drawable_get_width (drawable);
+  image_height = gimp_drawable_get_height (drawable);
   /* Farbfeld values are Big-Endian */
   export_width = GUINT32_TO_BE (image_width);
   export_height = GUINT32_TO_BE (image_height);
@@ -373,30 +375,38 @@ export_image (GFile         *file,
   fwrite ((gchar *) &export_height, 1, 4, fp);
 
   /* Write pixel data */
-  for (gint i = 0; i < image_height; i++)
-    {
-      pixels = g_malloc (image_width * sizeof (guint16) * 4);
-
-      gegl_buffer_get (buffer, GEGL_RECTANGLE (0, i, image_width, 1),
-                       1.0, format, pixels,
-                       GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+  success = gimp_drawable_foreach_band (drawable, format, FALSE,
+                                        export_band, fp);
 
-      for (gint j = 0; j < (image_width * 4); j++)
-        {
-          pixels[j] = GUINT16_TO_BE (pixels[j]);
-          fwrite ((gchar *) &pixels[j], 1, 2, fp);
-        }
+  if (fclose (fp) != 0)
+    success = FALSE;
 
-      g_free (pixels);
-      gimp_progress_update (i / (gdouble) image_height);
+  if (! success)
+    {
+      g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
+                   _("Writing to file '%s' failed: %s"),
+                   gimp_file_get_utf8_name (file), g_strerror (errno));
+      return FALSE;
     }
 
-  gimp_progress_update (1.0);
+  return TRUE;
+}
 
-  fclose (fp);
+static gboolean
+export_band (guchar   *pixels,
+             gint      y,
+             gint      width,
+             gint      n_rows,
+             gpointer  user_data)
+{
+  FILE    *fp     = user_data;
+  guint16 *values = (guint16 *) pixels;
+  gsize    n_values;
 
-  if (buffer)
-    g_object_unref (buffer);
+  n_values = (gsize) width * n_rows * 4;
 
-  return TRUE;
+  for (gsize i = 0; i < n_values; i++)
+    values[i] = GUINT16_TO_BE (values[i]);
+
+  return fwrite (values, sizeof (guint16), n_values, fp) == n_values;
 }
@@ -114,9 +114,6 @@ GIMP_MAIN (GIF_TYPE)
 DEFINE_STD_SET_I18N
 
 
-static gint Interlace; /* For compression code */
-
-
 static void
 gif_class_init (GifClass *klass)
 {
@@ -387,10 +384,80 @@ gif_export (GimpProcedure        *procedure,
 #define MAXCOLORS 256
 
 /*
- * Pointer to function returning an int
+ * General DEFINEs
+ */
+
+#define GIF_BITS   12
+
+#define HSIZE    5003                /* 80% occupancy */
+
+/* The number of frames compressed at once per processor, and so the
+ * number of frames in memory.
  */
-typedef gint (* ifunptr) (gint x,
-                          gint y);
+#define FRAMES_PER_THREAD 2
+
+
+/*
+ * Everything the LZW encoder needs for one frame, so that the frames of
+ * a window are compressed in parallel, into memory.
+ */
+typedef struct
+{
+  /* the frame */
+  const guchar *pixels;
+  gint          width;
+  gint          height;
+  gint          interlace;
+
+  /* the next pixel, see bump_pixel () */
+  gint          curx;
+  gint          cury;
+  glong         count_down;
+  gint          pass;
+
+  /* the code table */
+  gint          n_bits;                /* number of bits/code */
+  gint          maxcode;               /* maximum code, given n_bits */
+  gint          free_ent;              /* first unused entry */
+  gint          clear_flg;
+  glong         in_count;              /* length of input */
+  glong         out_count;             /* # of codes output (for debugging) */
+  glong         htab[HSIZE];
+  gushort       codetab[HSIZE];
+
+  gint          g_init_bits;
+  gint          ClearCode;
+  gint          EOFCode;
+
+  /* the output */
+  gulong        cur_accum;
+  gint          cur_bits;
+  gint          a_count;               /* characters so far in this 'packet' */
+  guchar        accum[256];            /* the packet accumulator */
+  GByteArray   *data;                  /* the packets, in order */
+} GifCompressor;
+
+/* A layer of the window, ready to be written once it is compressed */
+typedef struct
+{
+  guchar        *pixels;
+  gint           cols;
+  gint           rows;
+  gint           offset_x;
+  gint           offset_y;
+  gint           transparent;
+  gint           bpp;
+  gint           disposal;
+  gint           delay;
+  gint           interlace;
+  GifCompressor *compressor;
+} GifFrame;
+
+typedef struct
+{
+  GifFrame *frames;
+  gint      n_frames;
+} GifWindow;
 
 
 static gint find_unused_ia_color           (const guchar  *pixels,
@@ -404,10 +471,15 @@ static void special_flatten_indexed_alpha  (guchar        *pixels,
 
 static gint colors_to_bpp                  (gint           colors);
 static gint bpp_to_colors                  (gint           bpp);
-static gint get_pixel                      (gint           x,
-                                            gint           y);
-static gint gif_next_pixel                 (ifunptr        getpixel);
-static void bump_pixel                     (void);
+
+static void compress_frames                (gint           i,
+                                            gint           n,
+                                            GifWindow     *window);
+static gboolean write_frames               (GOutputStream *output,
+                                            GifWindow     *window,
+                                            gboolean       is_gif89,
+                                            gint           n_frames,
+                                            GError       **error);
 
 static gboolean gif_encode_header              (GOutputStream  *output,
                                                 gboolean        gif89,
@@ -418,26 +490,21 @@ static gboolean gif_encode_header              (GOutputStream  *output,
                                                 gint           *red,
                                                 gint           *green,
                                                 gint           *blue,
-                                                ifunptr         get_pixel,
                                                 GError        **error);
 static gboolean gif_encode_graphic_control_ext (GOutputStream  *output,
                                                 gint            disposal,
                                                 gint            delay89,
                                                 gint            n_frames,
-                                                gint            width,
-                                                gint            height,
                                                 gint            transparent,
-                                                gint            bpp,
-                                                ifunptr         get_pixel,
                                                 GError        **error);
 static gboolean gif_encode_image_data          (GOutputStream  *output,
                                                 gint            width,
                                                 gint            height,
                                                 gint            interlace,
                                                 gint            bpp,
-                                                ifunptr         get_pixel,
                                                 gint            offset_x,
                                                 gint            offset_y,
+                                                GifCompressor  *compressor,
                                                 GError        **error);
 static gboolean gif_encode_close               (GOutputStream  *output,
                                                 GError        **error);
@@ -448,27 +515,22 @@ static gboolean gif_encode_comment_ext         (GOutputStream  *output,
                                                 const gchar    *comment,
                                                 GError        **error);
 
-static gint     rowstride;
-static guchar  *pixels;
-static gint     cur_progress;
-static gint     max_progress;
-
-static gboolean compress        (GOutputStream *output,
-                                 gint           init_bits,
-                                 ifunptr        ReadValue,
-                                 GError        **error);
-static gboolean no_compress     (GOutputStream *output,
-                                 gint           init_bits,
-                                 ifunptr        ReadValue,
-                                 GError        **error);
-static gboolean rle_compress    (GOutputStream *output,
-                                 gint           init_bits,
-                                 ifunptr        ReadValue,
-                                 GError        **error);
-static gboolean normal_compress (GOutputStream *output,
-                                 gint           init_bits,
-                                 ifunptr        ReadValue,
-                                 GError        **error);
+static GifCompressor * gif_compressor_new  (const guchar  *pixels,
+                                            gint           width,
+                                            gint           height,
+                                            gint           interlace);
+static void     gif_compressor_free (GifCompressor *c);
+static gint     gif_next_pixel      (GifCompressor *c);
+static void     bump_pixel          (GifCompressor *c);
+
+static void     compress            (GifCompressor *c,
+                                     gint           init_bits);
+static void     no_compress         (GifCompressor *c,
+                                     gint           init_bits);
+static void     rle_compress        (GifCompressor *c,
+                                     gint           init_bits);
+static void     normal_compress     (GifCompressor *c,
+                                     gint           init_bits);
 
 static gboolean put_byte        (GOutputStream  *output,
                                  guchar          b,
@@ -479,19 +541,16 @@ static gboolean put_word        (GOutputStream  *output,
 static gboolean put_string      (GOutputStream  *output,
                                  const gchar    *s,
                                  GError        **error);
-static gboolean output_code     (GOutputStream  *output,
-                                 gint            code,
-                                 GError        **error);
-static gboolean cl_block        (GOutputStream  *output,
-                                 GError        **error);
-static void     cl_hash         (glong           hsize);
+static void     output_code     (GifCompressor  *c,
+                                 gint            code);
+static void     cl_block        (GifCompressor  *c);
+static void     cl_hash         (GifCompressor  *c,
+                                 glong           hsize);
 
-static void     char_init       (void);
-static gboolean char_out        (GOutputStream  *output,
-                                 gint            c,
-                                 GError        **error);
-static gboolean char_flush      (GOutputStream  *output,
-                                 GError        **error);
+static void     char_init       (GifCompressor  *c);
+static void     char_out        (GifCompressor  *c,
+                                 gint            ch);
+static void     char_flush      (GifCompressor  *c);
 
 
 static gint
@@ -753,6 +812,7 @@ export_image (GFile         *file,
   gint           Blue[MAXCOLORS];
   guchar        *cmap;
   guint          rows, cols;
+  guchar        *pixels;
   gint           BitsPerPixel;
   gint           liberalBPP = 0;
   gint           useBPP     = 0;
@@ -764,6 +824,8 @@ export_image (GFile         *file,
   GList         *layers;
   GList         *list;
   gint           nlayers;
+  GifWindow      window;
+  gint           window_size;
 
   gboolean       is_gif89 = FALSE;
 
@@ -987,9 +1049,8 @@ export_image (GFile         *file,
 
   cols = gimp_image_get_width (image);
   rows = gimp_image_get_height (image);
-  Interlace = config_interlace;
   if (! gif_encode_header (output, is_gif89, cols, rows, bgindex,
-                           BitsPerPixel, Red, Green, Blue, get_pixel,
+                           BitsPerPixel, Red, Green, Blue,
                            error))
     return FALSE;
 
@@ -1019,16 +1080,22 @@ export_image (GFile         *file,
   /*** Now for each layer in the image, save an image in a compound GIF ***/
   /************************************************************************/
 
-  cur_progress = 0;
-  max_progress = nlayers * rows;
+  /* The layers are read, and their transparency and timing worked out,
+   * in order; then the window of layers is compressed in parallel, and
+   * written in order.
+   */
+  window_size     = MAX (1, gimp_get_num_processors ()) * FRAMES_PER_THREAD;
+  window.frames   = g_new0 (GifFrame, window_size);
+  window.n_frames = 0;
 
   layers = g_list_reverse (layers);
 
   for (list = layers, i = nlayers - 1;
        list && i >= 0;
-       list = g_list_next (list), i--, cur_progress = (nlayers - i) * rows)
+       list = g_list_next (list), i--)
     {
       GimpDrawable *drawable = list->data;
+      GifFrame     *frame    = &window.frames[window.n_frames++];
 
       drawable_type = gimp_drawable_type (drawable);
       if (drawable_type == GIMP_GRAYA_IMAGE)
@@ -1044,7 +1111,6 @@ export_image (GFile         *file,
       gimp_drawable_get_offsets (drawable, &offset_x, &offset_y);
       cols = gimp_drawable_get_width (drawable);
       rows = gimp_drawable_get_height (drawable);
-      rowstride = cols;
 
       pixels = g_new (guchar, (cols * rows *
                                (((drawable_type == GIMP_INDEXEDA_IMAGE) ||
@@ -1054,6 +1120,8 @@ export_image (GFile         *file,
                        format, pixels,
                        GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
 
+      g_object_unref (buffer);
+
       /* sort out whether we need to do transparency jiggery-pokery */
       if ((drawable_type == GIMP_INDEXEDA_IMAGE) ||
           (drawable_type == GIMP_GRAYA_IMAGE))
@@ -1099,6 +1167,9 @@ export_image (GFile         *file,
 
       useBPP = (BitsPerPixel > liberalBPP) ? BitsPerPixel : liberalBPP;
 
+      Disposal = 0;
+      Delay89  = 0;
+
       if (is_gif89)
         {
           if (i > 0 && ! config_use_default_dispose)
@@ -1136,32 +1207,39 @@ export_image (GFile         *file,
 
               Delay89 = 1;
             }
-
-          if (! gif_encode_graphic_control_ext (output,
-                                                Disposal, Delay89, nlayers,
-                                                cols, rows,
-                                                transparent,
-                                                useBPP,
-                                                get_pixel,
-                                                error))
-            return FALSE;
         }
 
-      if (! gif_encode_image_data (output, cols, rows,
-                                   (rows > 4) ? config_interlace : 0,
-                                   useBPP,
-                                   get_pixel,
-                                   offset_x, offset_y,
-                                   error))
-        return FALSE;
+      frame->pixels      = pixels;
+      frame->cols        = cols;
+      frame->rows        = rows;
+      frame->offset_x    = offset_x;
+      frame->offset_y    = offset_y;
+      frame->transparent = transparent;
+      frame->bpp         = useBPP;
+      frame->disposal    = Disposal;
+      frame->delay       = Delay89;
+      frame->interlace   = (rows > 4) ? config_interlace : 0;
+
+      if (window.n_frames == window_size || i == 0)
+        {
+          gegl_parallel_distribute (window.n_frames,
+                                    (GeglParallelDistributeFunc) compress_frames,
+                                    &window);
 
-      gimp_progress_update (1.0);
+          if (! write_frames (output, &window, is_gif89, nlayers, error))
+            {
+              g_free (window.frames);
+              g_list_free (layers);
+              return FALSE;
+            }
 
-      g_object_unref (buffer);
+          window.n_frames = 0;
 
-      g_free (pixels);
+          gimp_progress_update ((gdouble) (nlayers - i) / (gdouble) nlayers);
+        }
     }
 
+  g_free (window.frames);
   g_list_free (layers);
 
   if (! gif_encode_close (output, error))
@@ -1170,6 +1248,78 @@ export_image (GFile         *file,
   return TRUE;
 }
 
+/* Compresses the frames of the window, on as many threads as GEGL
+ * gives, each frame with a compressor of its own.
+ */
+static void
+compress_frames (gint       i,
+                 gint       n,
+                 GifWindow *window)
+{
+  gint f;
+
+  for (f = i; f < window->n_frames; f += n)
+    {
+      GifFrame      *frame = &window->frames[f];
+      GifCompressor *c;
+      gint           init_code_size;
+
+      c = gif_compressor_new (frame->pixels, frame->cols, frame->rows,
+                              frame->interlace);
+
+      /*
+       * The initial code size
+       */
+      if (frame->bpp <= 1)
+        init_code_size = 2;
+      else
+        init_code_size = frame->bpp;
+
+      compress (c, init_code_size + 1);
+
+      frame->compressor = c;
+    }
+}
+
+/* Writes the compressed frames of the window in order, and frees them */
+static gboolean
+write_frames (GOutputStream  *output,
+              GifWindow      *window,
+              gboolean        is_gif89,
+              gint            n_frames,
+              GError        **error)
+{
+  gboolean success = TRUE;
+  gint     f;
+
+  for (f = 0; f < window->n_frames; f++)
+    {
+      GifFrame *frame = &window->frames[f];
+
+      if (success && is_gif89)
+        success = gif_encode_graphic_control_ext (output,
+                                                  frame->disposal,
+                                                  frame->delay,
+                                                  n_frames,
+                                                  frame->transparent,
+                                                  error);
+
+      if (success)
+        success = gif_encode_image_data (output,
+                                         frame->cols, frame->rows,
+                                         frame->interlace,
+                                         frame->bpp,
+                                         frame->offset_x, frame->offset_y,
+                                         frame->compressor,
+                                         error);
+
+      g_clear_pointer (&frame->compressor, gif_compressor_free);
+      g_clear_pointer (&frame->pixels, g_free);
+    }
+
+  return success;
+}
+
 static GimpExportCapabilities
 export_edit_options (GimpProcedure        *procedure,
                      GimpProcedureConfig  *config,
@@ -1460,14 +1610,6 @@ bpp_to_colors (gint bpp)
 
 
 
-static gint
-get_pixel (gint x,
-           gint y)
-{
-  return *(pixels + (rowstride * (long) y) + (long) x);
-}
-
-
 /*****************************************************************************
  *
  * GIFENCODE.C    - GIF Image compression interface
@@ -1477,72 +1619,102 @@ get_pixel (gint x,
  *
  *****************************************************************************/
 
-static gint  Width, Height;
-static gint  curx, cury;
-static glong CountDown;
-static gint  Pass = 0;
+static GifCompressor *
+gif_compressor_new (const guchar *pixels,
+                    gint          width,
+                    gint          height,
+                    gint          interlace)
+{
+  GifCompressor *c = g_new0 (GifCompressor, 1);
+
+  c->pixels    = pixels;
+  c->width     = width;
+  c->height    = height;
+  c->interlace = interlace;
+
+  /*
+   * Calculate number of bits we are expecting
+   */
+  c->count_down = (glong) width * (glong) height;
+
+  /*
+   * Indicate which pass we are on (if interlace)
+   */
+  c->pass = 0;
+
+  /*
+   * Set up the current x and y position
+   */
+  c->curx = c->cury = 0;
+
+  c->data = g_byte_array_new ();
+
+  return c;
+}
+
+static void
+gif_compressor_free (GifCompressor *c)
+{
+  g_byte_array_unref (c->data);
+  g_free (c);
+}
 
 /*
  * Bump the 'curx' and 'cury' to point to the next pixel
  */
 static void
-bump_pixel (void)
+bump_pixel (GifCompressor *c)
 {
   /*
    * Bump the current X position
    */
-  curx++;
+  c->curx++;
 
   /*
    * If we are at the end of a scan line, set curx back to the beginning
    * If we are interlaced, bump the cury to the appropriate spot,
    * otherwise, just increment it.
    */
-  if (curx == Width)
+  if (c->curx == c->width)
     {
-      cur_progress++;
+      c->curx = 0;
 
-      if ((cur_progress % 20) == 0)
-        gimp_progress_update ((gdouble) cur_progress / (gdouble) max_progress);
-
-      curx = 0;
-
-      if (! Interlace)
-        ++cury;
+      if (! c->interlace)
+        ++c->cury;
       else
         {
-          switch (Pass)
+          switch (c->pass)
             {
 
             case 0:
-              cury += 8;
-              if (cury >= Height)
+              c->cury += 8;
+              if (c->cury >= c->height)
                 {
-                  Pass++;
-                  cury = 4;
+                  c->pass++;
+                  c->cury = 4;
                 }
               break;
 
             case 1:
-              cury += 8;
-              if (cury >= Height)
+              c->cury += 8;
+              if (c->cury >= c->height)
                 {
-                  Pass++;
-                  cury = 2;
+                  c->pass++;
+                  c->cury = 2;
                 }
               break;
 
             case 2:
-              cury += 4;
-              if (cury >= Height)
+              c->cury += 4;
+              if (c->cury >= c->height)
                 {
-                  Pass++;
-                  cury = 1;
+                  c->pass++;
+                  c->cury = 1;
                 }
               break;
 
             case 3:
-              cury += 2;
+              c->cury += 2;
               break;
             }
         }
@@ -1553,18 +1725,18 @@ bump_pixel (void)
  * Return the next pixel from the image
  */
 static gint
-gif_next_pixel (ifunptr getpixel)
+gif_next_pixel (GifCompressor *c)
 {
   gint r;
 
-  if (CountDown == 0)
+  if (c->count_down == 0)
     return EOF;
 
-  --CountDown;
+  --c->count_down;
 
-  r = (*getpixel) (curx, cury);
+  r = c->pixels[(glong) c->width * c->cury + c->curx];
 
-  bump_pixel ();
+  bump_pixel (c);
 
   return r;
 }
@@ -1581,7 +1753,6 @@ gif_encode_header (GOutputStream *output,
                    gint           Red[],
                    gint           Green[],
                    gint           Blue[],
-                   ifunptr        get_pixel,
                    GError       **error)
 {
   gint B;
@@ -1592,26 +1763,11 @@ gif_encode_header (GOutputStream *output,
 
   ColorMapSize = 1 << BitsPerPixel;
 
-  RWidth = Width = GWidth;
-  RHeight = Height = GHeight;
+  RWidth = GWidth;
+  RHeight = GHeight;
 
   Resolution = BitsPerPixel;
 
-  /*
-   * Calculate number of bits we are expecting
-   */
-  CountDown = (long) Width *(long) Height;
-
-  /*
-   * Indicate which pass we are on (if interlace)
-   */
-  Pass = 0;
-
-  /*
-   * Set up the current x and y position
-   */
-  curx = cury = 0;
-
   /*
    * Write the Magic header
    */
@@ -1678,31 +1834,9 @@ gif_encode_graphic_control_ext (GOutputStream *output,
                                 int            Disposal,
                                 int            Delay89,
                                 int            NumFramesInImage,
-                                int            GWidth,
-                                int            GHeight,
                                 int            Transparent,
-                                int            BitsPerPixel,
-                                ifunptr        get_pixel,
                                 GError       **error)
 {
-  Width = GWidth;
-  Height = GHeight;
-
-  /*
-   * Calculate number of bits we are expecting
-   */
-  CountDown = (long) Width *(long) Height;
-
-  /*
-   * Indicate which pass we are on (if interlace)
-   */
-  Pass = 0;
-
-  /*
-   * Set up the current x and y position
-   */
-  curx = cury = 0;
-
   /*
    * Write out extension for transparent color index, if necessary.
    */
@@ -1746,37 +1880,24 @@ gif_encode_graphic_control_ext (GOutputStream *output,
 }
 
 
+/* Writes the image descriptor, and the data the compressor has packed */
 static gboolean
 gif_encode_image_data (GOutputStream *output,
                        int            GWidth,
                        int            GHeight,
                        int            GInterlace,
                        int            BitsPerPixel,
-                       ifunptr        get_pixel,
                        gint           offset_x,
                        gint           offset_y,
+                       GifCompressor *compressor,
                        GError       **error)
 {
   gint LeftOfs, TopOfs;
   gint InitCodeSize;
 
-  Interlace = GInterlace;
-
-  Width   = GWidth;
-  Height  = GHeight;
   LeftOfs = (gint) offset_x;
   TopOfs  = (gint) offset_y;
 
-  /*
-   * Calculate number of bits we are expecting
-   */
-  CountDown = (long) Width * (long) Height;
-
-  /*
-   * Indicate which pass we are on (if interlace)
-   */
-  Pass = 0;
-
   /*
    * The initial code size
    */
@@ -1785,11 +1906,6 @@ gif_encode_image_data (GOutputStream *output,
   else
     InitCodeSize = BitsPerPixel;
 
-  /*
-   * Set up the current x and y position
-   */
-  curx = cury = 0;
-
   /*
    * Write an Image separator
    */
@@ -1802,14 +1918,14 @@ gif_encode_image_data (GOutputStream *output,
 
   if (! put_word (output, LeftOfs, error) ||
       ! put_word (output, TopOfs,  error) ||
-      ! put_word (output, Width,   error) ||
-      ! put_word (output, Height,  error))
+      ! put_word (output, GWidth,  error) ||
+      ! put_word (output, GHeight, error))
     return FALSE;
 
   /*
    * Write out whether or not the image is interlaced
    */
-  if (Interlace)
+  if (GInterlace)
     {
       if (! put_byte (output, 0x40, error))
         return FALSE;
@@ -1827,9 +1943,12 @@ gif_encode_image_data (GOutputStream *output,
     return FALSE;
 
   /*
-   * Go and actually compress the data
+   * Write the compressed data
    */
-  if (! compress (output, InitCodeSize + 1, get_pixel, error))
+  if (! g_output_stream_write_all (output,
+                                   compressor->data->data,
+                                   compressor->data->len,
+                                   NULL, NULL, error))
     return FALSE;
 
   /*
@@ -1838,28 +1957,6 @@ gif_encode_image_data (GOutputStream *output,
   if (! put_byte (output, 0, error))
     return FALSE;
 
-#if 0
-  /***************************/
-  Interlace = GInterlace;
-  Width = GWidth;
-  Height = GHeight;
-  LeftOfs = TopOfs = 0;
-
-  CountDown = (long) Width *(long) Height;
-  Pass = 0;
-  /*
-   * The initial code size
-   */
-  if (BitsPerPixel <= 1)
-    InitCodeSize = 2;
-  else
-    InitCodeSize = BitsPerPixel;
-  /*
-   * Set up the current x and y position
-   */
-  curx = cury = 0;
-#endif
-
   return TRUE;
 }
 
@@ -1962,14 +2059,6 @@ put_string (GOutputStream  *output,
  *
  ***************************************************************************/
 
-/*
- * General DEFINEs
- */
-
-#define GIF_BITS   12
-
-#define HSIZE    5003                /* 80% occupancy */
-
 /*
  * GIF Image compression - modified 'compress'
  *
@@ -1982,40 +2071,25 @@ put_string (GOutputStream  *output,
  *              James A. Woods          (decvax!ihnp4!ames!jaw)
  *              Joe Orost               (decvax!vax135!petsd!joe)
  *
+ * The state of the compression is in the GifCompressor of the frame.
  */
 
-static gint n_bits;                /* number of bits/code */
-static gint maxbits = GIF_BITS;    /* user settable max # bits/code */
-static gint maxcode;               /* maximum code, given n_bits */
-static gint maxmaxcode = (gint) 1 << GIF_BITS;        /* should NEVER generate this code */
+static const gint maxbits = GIF_BITS;    /* user settable max # bits/code */
+static const gint maxmaxcode = (gint) 1 << GIF_BITS;        /* should NEVER generate this code */
 #ifdef COMPATIBLE                /* But wrong! */
 #define MAXCODE(Mn_bits)        ((gint) 1 << (Mn_bits) - 1)
 #else /*COMPATIBLE */
 #define MAXCODE(Mn_bits)        (((gint) 1 << (Mn_bits)) - 1)
 #endif /*COMPATIBLE */
 
-static glong   htab[HSIZE];
-static gushort codetab[HSIZE];
-#define HashTabOf(i)       htab[i]
-#define CodeTabOf(i)    codetab[i]
+#define HashTabOf(i)       c->htab[i]
+#define CodeTabOf(i)    c->codetab[i]
 
 static const gint hsize = HSIZE; /* the original reason for this being
                                     variable was "for dynamic table sizing",
                                     but since it was never actually changed
                                     I made it const   --Adam. */
 
-static gint free_ent = 0;        /* first unused entry */
-
-/*
- * block compression parameters -- after all codes are used up,
- * and compression rate changes, start over.
- */
-static gint  clear_flg = 0;
-
-static gint  offset;
-static glong in_count  = 1;        /* length of input */
-static glong out_count = 0;        /* # of codes output (for debugging) */
-
 /*
  * compress stdin to stdout
  *
@@ -2032,15 +2106,7 @@ static glong out_count = 0;        /* # of codes output (for debugging) */
  * questions about this implementation to ames!jaw.
  */
 
-static gint g_init_bits;
-
-static gint ClearCode;
-static gint EOFCode;
-
-static gulong cur_accum;
-static gint   cur_bits;
-
-static gulong masks[] =
+static const gulong masks[] =
 {
   0x0000, 0x0001, 0x0003, 0x0007,
   0x000F, 0x001F, 0x003F, 0x007F,
@@ -2050,29 +2116,25 @@ static gulong masks[] =
 };
 
 
-static gboolean
-compress (GOutputStream  *output,
-          gint            init_bits,
-          ifunptr         ReadValue,
-          GError        **error)
+static void
+compress (GifCompressor *c,
+          gint           init_bits)
 {
   if (FALSE)
-    return no_compress (output, init_bits, ReadValue, error);
+    no_compress (c, init_bits);
   else if (FALSE)
-    return rle_compress (output, init_bits, ReadValue, error);
+    rle_compress (c, init_bits);
   else
-    return normal_compress (output, init_bits, ReadValue, error);
+    normal_compress (c, init_bits);
 }
 
-static gboolean
-no_compress (GOutputStream  *output,
-             gint            init_bits,
-             ifunptr         ReadValue,
-             GError        **error)
+static void
+no_compress (GifCompressor *c,
+             gint           init_bits)
 {
   glong fcode;
   gint  i /* = 0 */ ;
-  gint  c;
+  gint  ch;
   gint  ent;
   gint  hsize_reg;
   gint  hshift;
@@ -2080,32 +2142,31 @@ no_compress (GOutputStream  *output,
   /*
    * Set up the globals:  g_init_bits - initial number of bits
    */
-  g_init_bits = init_bits;
+  c->g_init_bits = init_bits;
 
-  cur_bits = 0;
-  cur_accum = 0;
+  c->cur_bits = 0;
+  c->cur_accum = 0;
 
   /*
    * Set up the necessary values
    */
-  offset = 0;
-  out_count = 0;
-  clear_flg = 0;
-  in_count = 1;
+  c->out_count = 0;
+  c->clear_flg = 0;
+  c->in_count = 1;
 
-  ClearCode = (1 << (init_bits - 1));
-  EOFCode = ClearCode + 1;
-  free_ent = ClearCode + 2;
+  c->ClearCode = (1 << (init_bits - 1));
+  c->EOFCode = c->ClearCode + 1;
+  c->free_ent = c->ClearCode + 2;
 
 
   /* Had some problems here... should be okay now.  --Adam */
-  n_bits = g_init_bits;
-  maxcode = MAXCODE (n_bits);
+  c->n_bits = c->g_init_bits;
+  c->maxcode = MAXCODE (c->n_bits);
 
 
-  char_init();
+  char_init (c);
 
-  ent = gif_next_pixel (ReadValue);
+  ent = gif_next_pixel (c);
 
   hshift = 0;
   for (fcode = (long) hsize; fcode < 65536L; fcode *= 2L)
@@ -2113,59 +2174,50 @@ no_compress (GOutputStream  *output,
   hshift = 8 - hshift;                /* set hash code range bound */
 
   hsize_reg = hsize;
-  cl_hash ((glong) hsize_reg);        /* clear hash table */
+  cl_hash (c, (glong) hsize_reg);        /* clear hash table */
 
-  if (! output_code (output, (gint) ClearCode, error))
-    return FALSE;
+  output_code (c, (gint) c->ClearCode);
 
-  while ((c = gif_next_pixel (ReadValue)) != EOF)
+  while ((ch = gif_next_pixel (c)) != EOF)
     {
-      ++in_count;
+      ++c->in_count;
 
-      fcode = (long) (((long) c << maxbits) + ent);
-      i = (((gint) c << hshift) ^ ent);        /* xor hashing */
+      fcode = (long) (((long) ch << maxbits) + ent);
+      i = (((gint) ch << hshift) ^ ent);        /* xor hashing */
 
-      if (! output_code (output, (gint) ent, error))
-        return FALSE;
+      output_code (c, (gint) ent);
 
-      ++out_count;
-      ent = c;
+      ++c->out_count;
+      ent = ch;
 
-      if (free_ent < maxmaxcode)
+      if (c->free_ent < maxmaxcode)
         {
-          CodeTabOf (i) = free_ent++;        /* code -> hashtable */
+          CodeTabOf (i) = c->free_ent++;        /* code -> hashtable */
           HashTabOf (i) = fcode;
         }
       else
         {
-          if (! cl_block (output, error))
-            return FALSE;
+          cl_block (c);
         }
     }
 
   /*
    * Put out the final code.
    */
-  if (! output_code (output, (gint) ent, error))
-    return FALSE;
+  output_code (c, (gint) ent);
 
-  ++out_count;
+  ++c->out_count;
 
-  if (! output_code (output, (gint) EOFCode, error))
-    return FALSE;
-
-  return TRUE;
+  output_code (c, (gint) c->EOFCode);
 }
 
-static gboolean
-rle_compress (GOutputStream  *output,
-              gint            init_bits,
-              ifunptr         ReadValue,
-              GError        **error)
+static void
+rle_compress (GifCompressor *c,
+              gint           init_bits)
 {
   glong fcode;
   gint  i /* = 0 */ ;
-  gint  c, last;
+  gint  ch, last;
   gint  ent;
   gint  disp;
   gint  hsize_reg;
@@ -2174,32 +2226,31 @@ rle_compress (GOutputStream  *output,
   /*
    * Set up the globals:  g_init_bits - initial number of bits
    */
-  g_init_bits = init_bits;
+  c->g_init_bits = init_bits;
 
-  cur_bits = 0;
-  cur_accum = 0;
+  c->cur_bits = 0;
+  c->cur_accum = 0;
 
   /*
    * Set up the necessary values
    */
-  offset = 0;
-  out_count = 0;
-  clear_flg = 0;
-  in_count = 1;
+  c->out_count = 0;
+  c->clear_flg = 0;
+  c->in_count = 1;
 
-  ClearCode = (1 << (init_bits - 1));
-  EOFCode = ClearCode + 1;
-  free_ent = ClearCode + 2;
+  c->ClearCode = (1 << (init_bits - 1));
+  c->EOFCode = c->ClearCode + 1;
+  c->free_ent = c->ClearCode + 2;
 
 
   /* Had some problems here... should be okay now.  --Adam */
-  n_bits = g_init_bits;
-  maxcode = MAXCODE (n_bits);
+  c->n_bits = c->g_init_bits;
+  c->maxcode = MAXCODE (c->n_bits);
 
 
-  char_init ();
+  char_init (c);
 
-  last = ent = gif_next_pixel (ReadValue);
+  last = ent = gif_next_pixel (c);
 
   hshift = 0;
   for (fcode = (long) hsize; fcode < 65536L; fcode *= 2L)
@@ -2207,21 +2258,20 @@ rle_compress (GOutputStream  *output,
   hshift = 8 - hshift;                /* set hash code range bound */
 
   hsize_reg = hsize;
-  cl_hash ((glong) hsize_reg);        /* clear hash table */
+  cl_hash (c, (glong) hsize_reg);        /* clear hash table */
 
-  if (! output_code (output, (gint) ClearCode, error))
-    return FALSE;
+  output_code (c, (gint) c->ClearCode);
 
 
-  while ((c = gif_next_pixel (ReadValue)) != EOF)
+  while ((ch = gif_next_pixel (c)) != EOF)
     {
-      ++in_count;
+      ++c->in_count;
 
-      fcode = (long) (((long) c << maxbits) + ent);
-      i = (((gint) c << hshift) ^ ent);        /* xor hashing */
+      fcode = (long) (((long) ch << maxbits) + ent);
+      i = (((gint) ch << hshift) ^ ent);        /* xor hashing */
 
 
-      if (last == c) {
+      if (last == ch) {
         if (HashTabOf (i) == fcode)
           {
             ent = CodeTabOf (i);
@@ -2245,46 +2295,38 @@ rle_compress (GOutputStream  *output,
           goto probe;
         }
     nomatch:
-      if (! output_code (output, (gint) ent, error))
-        return FALSE;
+      output_code (c, (gint) ent);
 
-      ++out_count;
-      last = ent = c;
-      if (free_ent < maxmaxcode)
+      ++c->out_count;
+      last = ent = ch;
+      if (c->free_ent < maxmaxcode)
         {
-          CodeTabOf (i) = free_ent++;        /* code -> hashtable */
+          CodeTabOf (i) = c->free_ent++;        /* code -> hashtable */
           HashTabOf (i) = fcode;
         }
       else
         {
-          if (! cl_block (output, error))
-            return FALSE;
+          cl_block (c);
         }
     }
 
   /*
    * Put out the final code.
    */
-  if (! output_code (output, (gint) ent, error))
-    return FALSE;
+  output_code (c, (gint) ent);
 
-  ++out_count;
-
-  if (! output_code (output, (gint) EOFCode, error))
-    return FALSE;
+  ++c->out_count;
 
-  return TRUE;
+  output_code (c, (gint) c->EOFCode);
 }
 
-static gboolean
-normal_compress (GOutputStream  *output,
-                 gint            init_bits,
-                 ifunptr         ReadValue,
-                 GError        **error)
+static void
+normal_compress (GifCompressor *c,
+                 gint           init_bits)
 {
   glong fcode;
   gint  i /* = 0 */ ;
-  gint  c;
+  gint  ch;
   gint  ent;
   gint  disp;
   gint  hsize_reg;
@@ -2293,32 +2335,31 @@ normal_compress (GOutputStream  *output,
   /*
    * Set up the globals:  g_init_bits - initial number of bits
    */
-  g_init_bits = init_bits;
+  c->g_init_bits = init_bits;
 
-  cur_bits = 0;
-  cur_accum = 0;
+  c->cur_bits = 0;
+  c->cur_accum = 0;
 
   /*
    * Set up the necessary values
    */
-  offset = 0;
-  out_count = 0;
-  clear_flg = 0;
-  in_count = 1;
+  c->out_count = 0;
+  c->clear_flg = 0;
+  c->in_count = 1;
 
-  ClearCode = (1 << (init_bits - 1));
-  EOFCode = ClearCode + 1;
-  free_ent = ClearCode + 2;
+  c->ClearCode = (1 << (init_bits - 1));
+  c->EOFCode = c->ClearCode + 1;
+  c->free_ent = c->ClearCode + 2;
 
 
   /* Had some problems here... should be okay now.  --Adam */
-  n_bits = g_init_bits;
-  maxcode = MAXCODE (n_bits);
+  c->n_bits = c->g_init_bits;
+  c->maxcode = MAXCODE (c->n_bits);
 
 
-  char_init();
+  char_init (c);
 
-  ent = gif_next_pixel (ReadValue);
+  ent = gif_next_pixel (c);
 
   hshift = 0;
   for (fcode = (long) hsize; fcode < 65536L; fcode *= 2L)
@@ -2326,18 +2367,17 @@ normal_compress (GOutputStream  *output,
   hshift = 8 - hshift;                /* set hash code range bound */
 
   hsize_reg = hsize;
-  cl_hash ((glong) hsize_reg);        /* clear hash table */
+  cl_hash (c, (glong) hsize_reg);        /* clear hash table */
 
-  if (! output_code (output, (gint) ClearCode, error))
-    return FALSE;
+  output_code (c, (gint) c->ClearCode);
 
 
-  while ((c = gif_next_pixel (ReadValue)) != EOF)
+  while ((ch = gif_next_pixel (c)) != EOF)
     {
-      ++in_count;
+      ++c->in_count;
 
-      fcode = (long) (((long) c << maxbits) + ent);
-      i = (((gint) c << hshift) ^ ent);        /* xor hashing */
+      fcode = (long) (((long) ch << maxbits) + ent);
+      i = (((gint) ch << hshift) ^ ent);        /* xor hashing */
 
       if (HashTabOf (i) == fcode)
         {
@@ -2361,35 +2401,29 @@ normal_compress (GOutputStream  *output,
       if ((long) HashTabOf (i) > 0)
         goto probe;
     nomatch:
-      if (! output_code (output, (gint) ent, error))
-        return FALSE;
+      output_code (c, (gint) ent);
 
-      ++out_count;
-      ent = c;
-      if (free_ent < maxmaxcode)
+      ++c->out_count;
+      ent = ch;
+      if (c->free_ent < maxmaxcode)
         {
-          CodeTabOf (i) = free_ent++;        /* code -> hashtable */
+          CodeTabOf (i) = c->free_ent++;        /* code -> hashtable */
           HashTabOf (i) = fcode;
         }
       else
         {
-          if (! cl_block (output, error))
-            return FALSE;
+          cl_block (c);
         }
     }
 
   /*
    * Put out the final code.
    */
-  if (! output_code (output, (gint) ent, error))
-    return FALSE;
+  output_code (c, (gint) ent);
 
-  ++out_count;
+  ++c->out_count;
 
-  if (! output_code (output, (gint) EOFCode, error))
-    return FALSE;
-
-  return TRUE;
+  output_code (c, (gint) c->EOFCode);
 }
 
 
@@ -2401,7 +2435,7 @@ normal_compress (GOutputStream  *output,
  *      code:   A n_bits-bit integer.  If == -1, then EOF.  This assumes
  *              that n_bits =< (long)wordsize - 1.
  * Outputs:
- *      Outputs code to the file.
+ *      Outputs code to the compressor's data.
  * Assumptions:
  *      Chars are 8 bits long.
  * Algorithm:
@@ -2410,89 +2444,83 @@ normal_compress (GOutputStream  *output,
  * code in turn.  When the buffer fills up empty it and start over.
  */
 
-static gboolean
-output_code (GOutputStream  *output,
-             gint            code,
-             GError        **error)
+static void
+output_code (GifCompressor *c,
+             gint           code)
 {
-  cur_accum &= masks[cur_bits];
+  c->cur_accum &= masks[c->cur_bits];
 
-  if (cur_bits > 0)
-    cur_accum |= ((long) code << cur_bits);
+  if (c->cur_bits > 0)
+    c->cur_accum |= ((long) code << c->cur_bits);
   else
-    cur_accum = code;
+    c->cur_accum = code;
 
-  cur_bits += n_bits;
+  c->cur_bits += c->n_bits;
 
-  while (cur_bits >= 8)
+  while (c->cur_bits >= 8)
     {
-      if (! char_out (output, (guchar) (cur_accum & 0xff), error))
-        return FALSE;
+      char_out (c, (guchar) (c->cur_accum & 0xff));
 
-      cur_accum >>= 8;
-      cur_bits -= 8;
+      c->cur_accum >>= 8;
+      c->cur_bits -= 8;
     }
 
   /*
    * If the next entry is going to be too big for the code size,
    * then increase it, if possible.
    */
-  if (free_ent > maxcode || clear_flg)
+  if (c->free_ent > c->maxcode || c->clear_flg)
     {
-      if (clear_flg)
+      if (c->clear_flg)
         {
-          maxcode = MAXCODE (n_bits = g_init_bits);
-          clear_flg = 0;
+          c->maxcode = MAXCODE (c->n_bits = c->g_init_bits);
+          c->clear_flg = 0;
         }
       else
         {
-          ++n_bits;
-          if (n_bits == maxbits)
-            maxcode = maxmaxcode;
+          ++c->n_bits;
+          if (c->n_bits == maxbits)
+            c->maxcode = maxmaxcode;
           else
-            maxcode = MAXCODE (n_bits);
+            c->maxcode = MAXCODE (c->n_bits);
         }
     }
 
-  if (code == EOFCode)
+  if (code == c->EOFCode)
     {
       /*
        * At EOF, write the rest of the buffer.
        */
-      while (cur_bits > 0)
+      while (c->cur_bits > 0)
         {
-          if (! char_out (output, (guchar) (cur_accum & 0xff), error))
-            return FALSE;
+          char_out (c, (guchar) (c->cur_accum & 0xff));
 
-          cur_accum >>= 8;
-          cur_bits -= 8;
+          c->cur_accum >>= 8;
+          c->cur_bits -= 8;
         }
 
-      if (! char_flush (output, error))
-        return FALSE;
+      char_flush (c);
     }
-
-  return TRUE;
 }
 
 /*
  * Clear out the hash table
  */
-static gboolean
-cl_block (GOutputStream  *output,
-          GError        **error) /* table clear for block compress */
+static void
+cl_block (GifCompressor *c) /* table clear for block compress */
 {
-  cl_hash ((glong) hsize);
-  free_ent = ClearCode + 2;
-  clear_flg = 1;
+  cl_hash (c, (glong) hsize);
+  c->free_ent = c->ClearCode + 2;
+  c->clear_flg = 1;
 
-  return output_code (output, (gint) ClearCode, error);
+  output_code (c, (gint) c->ClearCode);
 }
 
 static void
-cl_hash (glong hsize)        /* reset code table */
+cl_hash (GifCompressor *c,
+         glong          hsize)        /* reset code table */
 {
-  glong *htab_p = htab + hsize;
+  glong *htab_p = c->htab + hsize;
 
   long i;
   long m1 = -1;
@@ -2529,60 +2557,42 @@ cl_hash (glong hsize)        /* reset code table */
  * GIF Specific routines
  ******************************************************************************/
 
-/*
- * Number of characters so far in this 'packet'
- */
-static int a_count;
-
 /*
  * Set up the 'byte output' routine
  */
 static void
-char_init (void)
+char_init (GifCompressor *c)
 {
-  a_count = 0;
+  c->a_count = 0;
 }
 
-/*
- * Define the storage for the packet accumulator
- */
-static char accum[256];
-
 /*
  * Add a character to the end of the current packet, and if it is 254
- * characters, flush the packet to disk.
+ * characters, flush the packet to the data.
  */
-static gboolean
-char_out (GOutputStream  *output,
-          gint            c,
-          GError        **error)
+static void
+char_out (GifCompressor *c,
+          gint           ch)
 {
-  accum[a_count++] = c;
+  c->accum[c->a_count++] = ch;
 
-  if (a_count >= 254)
-    return char_flush (output, error);
-
-  return TRUE;
+  if (c->a_count >= 254)
+    char_flush (c);
 }
 
 /*
- * Flush the packet to disk, and reset the accumulator
+ * Flush the packet to the data, and reset the accumulator
  */
-static gboolean
-char_flush (GOutputStream  *output,
-            GError        **error)
+static void
+char_flush (GifCompressor *c)
 {
-  if (a_count > 0)
+  if (c->a_count > 0)
     {
-      if (! put_byte (output, a_count, error))
-        return FALSE;
+      guchar count = c->a_count;
 
-      if (! g_output_stream_write_all (output, accum, a_count,
-                                       NULL, NULL, error))
-        return FALSE;
+      g_byte_array_append (c->data, &count, 1);
+      g_byte_array_append (c->data, c->accum, c->a_count);
 
-      a_count = 0;
+      c->a_count = 0;
     }
-
-  return TRUE;
 }
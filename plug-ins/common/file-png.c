@@ -33,6 +33,7 @@
 #include <libgimp/gimpui.h>
 
 #include <png.h>
+#include <zlib.h>
 
 #include "libgimp/stdplugins-intl.h"
 
@@ -47,6 +48,14 @@
 
 #define DEFAULT_GAMMA   2.20
 
+/* With parallel compression, rows are filtered and deflated in batches
+ * of about PNG_BATCH_SIZE bytes, each cut into blocks of at least
+ * PNG_BLOCK_SIZE bytes which are deflated on separate threads.
+ */
+#define PNG_BATCH_SIZE  (16 << 20)
+#define PNG_BLOCK_SIZE  (128 << 10)
+#define PNG_WINDOW_SIZE 32768
+
 
 typedef enum _PngExportformat
 {
@@ -61,6 +70,8 @@ typedef enum _PngExportformat
   PNG_FORMAT_GRAYA16
 } PngExportFormat;
 
+typedef struct _PngDeflater PngDeflater;
+
 static GSList *safe_to_copy_chunks;
 
 typedef struct _Png      Png;
@@ -138,6 +149,14 @@ static gint        find_unused_ia_color      (GeglBuffer            *buffer,
 static gint        read_unknown_chunk        (png_structp            png_ptr,
                                               png_unknown_chunkp     chunk);
 
+static PngDeflater * png_deflater_new        (png_structp            pp,
+                                              png_infop              info,
+                                              gint                   level);
+static void        png_deflater_free         (PngDeflater           *deflater);
+static void        png_deflater_add_rows     (PngDeflater           *deflater,
+                                              guchar               **rows,
+                                              gint                   n_rows);
+
 
 G_DEFINE_TYPE (Png, png, GIMP_TYPE_PLUG_IN)
 
@@ -307,6 +326,15 @@ png_create_procedure (GimpPlugIn  *plug_in,
                                                                        NULL),
                                           "auto", G_PARAM_READWRITE);
 
+      gimp_procedure_add_boolean_argument (procedure, "parallel-compression",
+                                           _("Compress in _parallel"),
+                                           _("Filter and deflate bands of rows "
+                                             "on several threads. Not used "
+                                             "for interlaced or low bit depth "
+                                             "images"),
+                                           TRUE,
+                                           G_PARAM_READWRITE);
+
       gimp_export_procedure_set_support_exif      (GIMP_EXPORT_PROCEDURE (procedure), TRUE);
       gimp_export_procedure_set_support_iptc      (GIMP_EXPORT_PROCEDURE (procedure), TRUE);
       gimp_export_procedure_set_support_xmp       (GIMP_EXPORT_PROCEDURE (procedure), TRUE);
@@ -1307,6 +1335,7 @@ export_image (GFile        *file,
   png_time          mod_time;         /* Modification time (ie NOW) */
   time_t            cutime;           /* Time since epoch */
   struct tm        *gmt;              /* GMT broken down */
+  PngDeflater      *deflater;         /* Parallel compression */
   gint              color_type;       /* PNG color type */
   gint              bit_depth;        /* Default to bit depth 16 */
 
@@ -1324,6 +1353,7 @@ export_image (GFile        *file,
   gboolean        save_transp_pixels;
   gboolean        optimize_palette;
   gint            compression_level;
+  gboolean        parallel_compression;
   PngExportFormat export_format;
   gboolean        save_profile;
 
@@ -1334,17 +1364,18 @@ export_image (GFile        *file,
 #endif
 
   g_object_get (config,
-                "interlaced",         &save_interlaced,
-                "bkgd",               &save_bkgd,
-                "offs",               &save_offs,
-                "phys",               &save_phys,
-                "time",               &save_time,
-                "save-comment",       &save_comment,
-                "gimp-comment",       &comment,
-                "save-transparent",   &save_transp_pixels,
-                "optimize-palette",   &optimize_palette,
-                "compression",        &compression_level,
-                "save-color-profile", &save_profile,
+                "interlaced",           &save_interlaced,
+                "bkgd",                 &save_bkgd,
+                "offs",                 &save_offs,
+                "phys",                 &save_phys,
+                "time",                 &save_time,
+                "save-comment",         &save_comment,
+                "gimp-comment",         &comment,
+                "save-transparent",     &save_transp_pixels,
+                "optimize-palette",     &optimize_palette,
+                "compression",          &compression_level,
+                "parallel-compression", &parallel_compression,
+                "save-color-profile",   &save_profile,
                 NULL);
 
   export_format = gimp_procedure_config_get_choice_id (GIMP_PROCEDURE_CONFIG (config), "format");
@@ -2003,6 +2034,16 @@ export_image (GFile        *file,
       bit_depth < 8)
     png_set_packing (pp);
 
+  /*
+   * Compress on several threads unless libpng must do the interlacing
+   * or packing...
+   */
+
+  deflater = NULL;
+
+  if (parallel_compression)
+    deflater = png_deflater_new (pp, info, compression_level);
+
   /*
    * Allocate memory for "tile_height" rows and export the image...
    */
@@ -2100,7 +2141,10 @@ export_image (GFile        *file,
                 }
             }
 
-          png_write_rows (pp, pixels, num);
+          if (deflater)
+            png_deflater_add_rows (deflater, pixels, num);
+          else
+            png_write_rows (pp, pixels, num);
 
           if (report_progress)
             gimp_progress_update (((double) pass + (double) end /
@@ -2112,7 +2156,11 @@ export_image (GFile        *file,
   if (report_progress)
     gimp_progress_update (1.0);
 
-  png_write_end (pp, info);
+  if (deflater)
+    png_deflater_free (deflater);
+  else
+    png_write_end (pp, info);
+
   png_destroy_write_struct (&pp, &info);
 
   g_free (pixel);
@@ -2357,6 +2405,443 @@ read_unknown_chunk (png_structp        png_ptr,
   return 0;
 }
 
+/*
+ * Parallel compression.
+ *
+ * The image data of a PNG file is a single zlib stream, which libpng
+ * fills from one thread. Instead, each block of filtered rows is
+ * deflated as a raw stream primed with the 32 KiB of filtered data
+ * preceding it, and ending on a sync flush (or the final block).
+ * Concatenated, the blocks make a standard deflate stream, which is
+ * wrapped in a zlib header and the adler32 of all data, combined from
+ * the checksums of the blocks.
+ */
+
+typedef struct
+{
+  gsize     start;             /* Offset of the block in the batch */
+  gsize     size;
+  gboolean  last;              /* Last block of the image */
+  guchar   *out;
+  gsize     out_size;
+  guint32   adler;
+  gboolean  failed;
+} PngBlock;
+
+struct _PngDeflater
+{
+  png_structp  pp;
+  gint         level;
+  gsize        rowbytes;       /* Bytes of a row, without filter type */
+  gsize        bpp;            /* Bytes per pixel, at least 1 */
+  gboolean     swap;           /* 16-bit samples are in host order */
+  gboolean     adaptive;       /* Choose the filter of each row */
+  gint         height;
+  gint         rows_done;
+
+  guchar      *raw;            /* Previous row, then the rows of the batch */
+  gint         batch_rows;
+  gint         n_rows;
+
+  guchar      *filtered;       /* History, then the filtered rows */
+  gsize        window;         /* Bytes of history before the batch */
+
+  PngBlock    *blocks;
+  gint         max_blocks;
+  gint         n_blocks;
+
+  guint32      adler;
+  gboolean     started;
+};
+
+
+static inline guchar
+png_predict (gint   type,
+             guchar a,
+             guchar b,
+             guchar c)
+{
+  gint p, pa, pb, pc;
+
+  switch (type)
+    {
+    case PNG_FILTER_VALUE_SUB:
+      return a;
+
+    case PNG_FILTER_VALUE_UP:
+      return b;
+
+    case PNG_FILTER_VALUE_AVG:
+      return (a + b) >> 1;
+
+    case PNG_FILTER_VALUE_PAETH:
+      p  = a + b - c;
+      pa = abs (p - a);
+      pb = abs (p - b);
+      pc = abs (p - c);
+
+      if (pa <= pb && pa <= pc)
+        return a;
+      else if (pb <= pc)
+        return b;
+      else
+        return c;
+    }
+
+  return 0;
+}
+
+static void
+png_filter_row (const guchar *row,
+                const guchar *prev,
+                gsize         rowbytes,
+                gsize         bpp,
+                gboolean      adaptive,
+                guchar       *out)
+{
+  gint  best = PNG_FILTER_VALUE_NONE;
+  gsize k;
+
+  /* Like libpng, pick the filter with the smallest sum of absolute
+   * differences, seen as signed bytes.
+   */
+  if (adaptive)
+    {
+      guint64 best_sum = G_MAXUINT64;
+      gint    type;
+
+      for (type = PNG_FILTER_VALUE_NONE; type <= PNG_FILTER_VALUE_PAETH; type++)
+        {
+          guint64 sum = 0;
+
+          for (k = 0; k < rowbytes && sum < best_sum; k++)
+            {
+              guchar a = k >= bpp ? row[k - bpp]  : 0;
+              guchar c = k >= bpp ? prev[k - bpp] : 0;
+              guchar d = row[k] - png_predict (type, a, prev[k], c);
+
+              sum += d < 128 ? d : 256 - d;
+            }
+
+          if (sum < best_sum)
+            {
+              best_sum = sum;
+              best     = type;
+            }
+        }
+    }
+
+  out[0] = best;
+
+  for (k = 0; k < rowbytes; k++)
+    {
+      guchar a = k >= bpp ? row[k - bpp]  : 0;
+      guchar c = k >= bpp ? prev[k - bpp] : 0;
+
+      out[k + 1] = row[k] - png_predict (best, a, prev[k], c);
+    }
+}
+
+static void
+png_deflater_swap_rows (gsize        offset,
+                        gsize        size,
+                        PngDeflater *deflater)
+{
+  guchar *data = deflater->raw + (offset + 1) * deflater->rowbytes;
+  gsize   k;
+
+  for (k = 0; k + 1 < size * deflater->rowbytes; k += 2)
+    {
+      guchar tmp = data[k];
+
+      data[k]     = data[k + 1];
+      data[k + 1] = tmp;
+    }
+}
+
+static void
+png_deflater_filter_rows (gsize        offset,
+                          gsize        size,
+                          PngDeflater *deflater)
+{
+  gsize r;
+
+  for (r = offset; r < offset + size; r++)
+    {
+      const guchar *row = deflater->raw + (r + 1) * deflater->rowbytes;
+
+      png_filter_row (row, row - deflater->rowbytes,
+                      deflater->rowbytes, deflater->bpp, deflater->adaptive,
+                      deflater->filtered + PNG_WINDOW_SIZE +
+                      r * (deflater->rowbytes + 1));
+    }
+}
+
+static void
+png_deflater_deflate_blocks (gint         i,
+                             gint         n,
+                             PngDeflater *deflater)
+{
+  gint slot;
+
+  for (slot = i; slot < deflater->n_blocks; slot += n)
+    {
+      PngBlock     *block = &deflater->blocks[slot];
+      const guchar *data  = deflater->filtered + PNG_WINDOW_SIZE + block->start;
+      gsize         dict_size;
+      z_stream      zs  = { 0, };
+      gint          ret;
+
+      block->adler = adler32 (adler32 (0L, Z_NULL, 0), data, block->size);
+      block->out   = NULL;
+
+      if (deflateInit2 (&zs, deflater->level, Z_DEFLATED, -MAX_WBITS, 8,
+                        Z_DEFAULT_STRATEGY) != Z_OK)
+        {
+          block->failed = TRUE;
+          continue;
+        }
+
+      /* The history may reach back into the previous batch. */
+      dict_size = MIN (PNG_WINDOW_SIZE, deflater->window + block->start);
+
+      if (dict_size > 0)
+        deflateSetDictionary (&zs, data - dict_size, dict_size);
+
+      /* Room for the sync flush marker and the final empty block. */
+      block->out_size = deflateBound (&zs, block->size) + 16;
+      block->out      = g_malloc (block->out_size);
+
+      zs.next_in   = (Bytef *) data;
+      zs.avail_in  = block->size;
+      zs.next_out  = block->out;
+      zs.avail_out = block->out_size;
+
+      ret = deflate (&zs, block->last ? Z_FINISH : Z_SYNC_FLUSH);
+
+      if (ret != (block->last ? Z_STREAM_END : Z_OK) ||
+          zs.avail_in > 0 || zs.avail_out == 0)
+        block->failed = TRUE;
+
+      block->out_size -= zs.avail_out;
+
+      deflateEnd (&zs);
+    }
+}
+
+static void
+png_deflater_write_blocks (PngDeflater *deflater)
+{
+  gint i;
+
+  for (i = 0; i < deflater->n_blocks; i++)
+    {
+      PngBlock *block  = &deflater->blocks[i];
+      guchar    header[2];
+      guchar    trailer[4];
+      gsize     length = block->out_size;
+
+      if (! deflater->started)
+        {
+          /* The zlib header zlib itself would write at this level. */
+          header[0] = 0x78;
+          header[1] = (deflater->level < 2 ? 0 :
+                       deflater->level < 6 ? 1 :
+                       deflater->level == 6 ? 2 : 3) << 6;
+          header[1] += 31 - (header[0] * 256 + header[1]) % 31;
+
+          length += sizeof (header);
+        }
+
+      deflater->adler = adler32_combine (deflater->adler, block->adler,
+                                         block->size);
+
+      if (block->last)
+        {
+          trailer[0] = deflater->adler >> 24;
+          trailer[1] = deflater->adler >> 16;
+          trailer[2] = deflater->adler >> 8;
+          trailer[3] = deflater->adler;
+
+          length += sizeof (trailer);
+        }
+
+      png_write_chunk_start (deflater->pp, (png_const_bytep) "IDAT", length);
+
+      if (! deflater->started)
+        {
+          png_write_chunk_data (deflater->pp, header, sizeof (header));
+          deflater->started = TRUE;
+        }
+
+      png_write_chunk_data (deflater->pp, block->out, block->out_size);
+
+      if (block->last)
+        png_write_chunk_data (deflater->pp, trailer, sizeof (trailer));
+
+      png_write_chunk_end (deflater->pp);
+
+      g_clear_pointer (&block->out, g_free);
+    }
+}
+
+static void
+png_deflater_flush (PngDeflater *deflater)
+{
+  gsize     row_size   = deflater->rowbytes + 1;
+  gsize     size       = deflater->n_rows * row_size;
+  gint      block_rows = MAX (1, PNG_BLOCK_SIZE / row_size);
+  gboolean  last;
+  gsize     keep;
+  gint      i;
+
+  deflater->rows_done += deflater->n_rows;
+  last = (deflater->rows_done == deflater->height);
+
+  if (deflater->swap)
+    gegl_parallel_distribute_range (
+      deflater->n_rows, 64,
+      (GeglParallelDistributeRangeFunc) png_deflater_swap_rows,
+      deflater);
+
+  gegl_parallel_distribute_range (
+    deflater->n_rows, 16,
+    (GeglParallelDistributeRangeFunc) png_deflater_filter_rows,
+    deflater);
+
+  deflater->n_blocks = (deflater->n_rows + block_rows - 1) / block_rows;
+
+  for (i = 0; i < deflater->n_blocks; i++)
+    {
+      PngBlock *block = &deflater->blocks[i];
+
+      block->start  = (gsize) i * block_rows * row_size;
+      block->size   = MIN (size - block->start, block_rows * row_size);
+      block->last   = last && (i == deflater->n_blocks - 1);
+      block->failed = FALSE;
+    }
+
+  gegl_parallel_distribute (
+    deflater->n_blocks,
+    (GeglParallelDistributeFunc) png_deflater_deflate_blocks,
+    deflater);
+
+  for (i = 0; i < deflater->n_blocks; i++)
+    {
+      if (deflater->blocks[i].failed)
+        {
+          png_structp pp = deflater->pp;
+
+          png_deflater_free (deflater);
+          png_error (pp, "Could not compress image data");
+        }
+    }
+
+  png_deflater_write_blocks (deflater);
+
+  /* Keep the end of the batch as history for the next one, and its
+   * last row for the filters of the next row.
+   */
+  keep = MIN (PNG_WINDOW_SIZE, deflater->window + size);
+
+  memmove (deflater->filtered + PNG_WINDOW_SIZE - keep,
+           deflater->filtered + PNG_WINDOW_SIZE + size - keep,
+           keep);
+  deflater->window = keep;
+
+  memcpy (deflater->raw,
+          deflater->raw + deflater->n_rows * deflater->rowbytes,
+          deflater->rowbytes);
+  deflater->n_rows = 0;
+
+  if (last)
+    png_write_chunk (deflater->pp, (png_const_bytep) "IEND", NULL, 0);
+}
+
+/* Returns a deflater writing the image data of @pp, once png_write_info()
+ * was called, or NULL if the image can only be compressed by libpng.
+ */
+static PngDeflater *
+png_deflater_new (png_structp pp,
+                  png_infop   info,
+                  gint        level)
+{
+  PngDeflater *deflater;
+  gint         bit_depth = png_get_bit_depth (pp, info);
+  gint         row_size;
+
+  if (bit_depth < 8 ||
+      png_get_interlace_type (pp, info) != PNG_INTERLACE_NONE)
+    return NULL;
+
+  deflater = g_slice_new0 (PngDeflater);
+
+  deflater->pp       = pp;
+  deflater->level    = level;
+  deflater->bpp      = png_get_channels (pp, info) * bit_depth / 8;
+  deflater->rowbytes = (gsize) png_get_image_width (pp, info) * deflater->bpp;
+  deflater->swap     = (bit_depth == 16 && G_BYTE_ORDER == G_LITTLE_ENDIAN);
+  deflater->adaptive = (png_get_color_type (pp, info) != PNG_COLOR_TYPE_PALETTE);
+  deflater->height   = png_get_image_height (pp, info);
+  deflater->adler    = adler32 (0L, Z_NULL, 0);
+
+  row_size = deflater->rowbytes + 1;
+
+  deflater->batch_rows = MIN (MAX (PNG_BATCH_SIZE / row_size,
+                                   gimp_tile_height ()),
+                              deflater->height);
+  deflater->max_blocks = (deflater->batch_rows +
+                          MAX (1, PNG_BLOCK_SIZE / row_size) - 1) /
+                         MAX (1, PNG_BLOCK_SIZE / row_size);
+
+  /* The row before the first one is all zeros. */
+  deflater->raw      = g_malloc0 ((deflater->batch_rows + 1) *
+                                  deflater->rowbytes);
+  deflater->filtered = g_malloc (PNG_WINDOW_SIZE +
+                                 deflater->batch_rows * row_size);
+  deflater->blocks   = g_new0 (PngBlock, deflater->max_blocks);
+
+  return deflater;
+}
+
+static void
+png_deflater_free (PngDeflater *deflater)
+{
+  gint i;
+
+  for (i = 0; i < deflater->max_blocks; i++)
+    g_free (deflater->blocks[i].out);
+
+  g_free (deflater->blocks);
+  g_free (deflater->filtered);
+  g_free (deflater->raw);
+
+  g_slice_free (PngDeflater, deflater);
+}
+
+/* Adds @n_rows rows, in the pixel format of the file, compressing and
+ * writing them once a batch is complete. After the last row of the
+ * image, also writes the IEND chunk: png_write_end() must not be called.
+ */
+static void
+png_deflater_add_rows (PngDeflater  *deflater,
+                       guchar      **rows,
+                       gint          n_rows)
+{
+  gint i;
+
+  for (i = 0; i < n_rows; i++)
+    {
+      memcpy (deflater->raw + (deflater->n_rows + 1) * deflater->rowbytes,
+              rows[i], deflater->rowbytes);
+      deflater->n_rows++;
+
+      if (deflater->n_rows == deflater->batch_rows ||
+          deflater->rows_done + deflater->n_rows == deflater->height)
+        png_deflater_flush (deflater);
+    }
+}
+
 static gboolean
 export_dialog (GimpImage     *image,
                GimpProcedure *procedure,
@@ -2390,6 +2875,7 @@ export_dialog (GimpImage     *image,
   gimp_export_procedure_dialog_add_metadata (GIMP_EXPORT_PROCEDURE_DIALOG (dialog), "time");
   gimp_procedure_dialog_fill (GIMP_PROCEDURE_DIALOG (dialog),
                               "format", "compression",
+                              "parallel-compression",
                               "interlaced", "save-transparent",
                               "optimize-palette",
                               NULL);
@@ -114,6 +114,9 @@ struct _PNMRowInfo
   guchar        *blu;           /* Colormap blue               */
   guchar        *alpha;         /* Colormap alpha (PAM only)   */
   gboolean       zero_is_black; /* index zero is black (PBM only) */
+  PNMExportrowFunc saverow;     /* Routine to write out a row  */
+  gint           bpp;           /* Bytes per pixel of the data */
+  GError       **error;         /* Where to report write errors */
 };
 
 #define BUFLEN 512              /* The input buffer size for data returned
@@ -219,6 +222,16 @@ static gboolean     pnmsaverow_ascii_indexed (PNMRowInfo             *ri,
 static gboolean     pnmsaverow_raw_indexed   (PNMRowInfo             *ri,
                                               guchar                 *data,
                                               GError                **error);
+static gboolean     export_band              (guchar                 *pixels,
+                                              gint                    y,
+                                              gint                    width,
+                                              gint                    n_rows,
+                                              gpointer                user_data);
+static gboolean     export_band_float        (guchar                 *pixels,
+                                              gint                    y,
+                                              gint                    width,
+                                              gint                    n_rows,
+                                              gpointer                user_data);
 
 static PNMScanner * pnmscanner_create        (GInputStream           *input);
 static void         pnmscanner_destroy       (PNMScanner             *s);
@@ -1564,6 +1577,50 @@ pnmsaverow_ascii_indexed (PNMRowInfo    *ri,
                        error);
 }
 
+/* Writes out the rows of a band with the row routine */
+static gboolean
+export_band (guchar   *pixels,
+             gint      y,
+             gint      width,
+             gint      n_rows,
+             gpointer  user_data)
+{
+  PNMRowInfo *ri = user_data;
+  gint        row;
+
+  for (row = 0; row < n_rows; row++)
+    {
+      if (! ri->saverow (ri, pixels, ri->error))
+        return FALSE;
+
+      pixels += width * ri->bpp;
+    }
+
+  return TRUE;
+}
+
+/* Writes out the rows of a band of float data, bottom to top */
+static gboolean
+export_band_float (guchar   *pixels,
+                   gint      y,
+                   gint      width,
+                   gint      n_rows,
+                   gpointer  user_data)
+{
+  PNMRowInfo *ri = user_data;
+  gint        row;
+
+  for (row = n_rows - 1; row >= 0; row--)
+    {
+      if (! pnmsaverow_float (ri, (const float *) (pixels +
+                                                   row * width * ri->bpp),
+                              ri->error))
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
 static gboolean
 export_image (GFile         *file,
               GimpImage     *image,
@@ -1587,7 +1644,6 @@ export_image (GFile         *file,
   gchar            buf[BUFLEN];
   gint             np = 0;
   gint             xres, yres;
-  gint             ypos, yend;
   gint             rowbufsize = 0;
   gchar           *comment    = NULL;
   gboolean         config_raw = TRUE;
@@ -1875,89 +1931,37 @@ export_image (GFile         *file,
     if (! output_write (output, buf, strlen (buf), error))
       goto out;
 
+  rowinfo.output = output;
+  rowinfo.xres   = xres;
+  rowinfo.np     = np;
+  rowinfo.bpp    = babl_format_get_bytes_per_pixel (format);
+  rowinfo.error  = error;
+
   if (file_type != FILE_TYPE_PFM)
     {
-      guchar *data;
-      guchar *d;
-      gchar  *rowbuf = NULL;
-
-      /* allocate a buffer for retrieving information from the pixel region  */
-      data = g_new (guchar,
-                    gimp_tile_height () * xres *
-                    babl_format_get_bytes_per_pixel (format));
-
-      rowbuf = g_new (gchar, rowbufsize + 1);
+      gboolean success;
 
-      rowinfo.output = output;
-      rowinfo.rowbuf = rowbuf;
-      rowinfo.xres   = xres;
-      rowinfo.np     = np;
-
-      d = NULL; /* only to please the compiler */
+      rowinfo.rowbuf  = g_new (gchar, rowbufsize + 1);
+      rowinfo.saverow = saverow;
 
       /* Write the body out */
-      for (ypos = 0; ypos < yres; ypos++)
-        {
-          if ((ypos % gimp_tile_height ()) == 0)
-            {
-              yend = ypos + gimp_tile_height ();
-              yend = MIN (yend, yres);
-
-              gegl_buffer_get (buffer,
-                               GEGL_RECTANGLE (0, ypos, xres, yend - ypos), 1.0,
-                               format, data,
-                               GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+      success = gimp_drawable_foreach_band (drawable, format, FALSE,
+                                            export_band, &rowinfo);
 
-              d = data;
-            }
+      g_free (rowinfo.rowbuf);
 
-          if (! saverow (&rowinfo, d, error))
-            {
-              g_free (rowbuf);
-              g_free (data);
-              goto out;
-            }
-
-          d += xres * (np ? np : 1) * rowinfo.bpc;
-
-          if (ypos % 32 == 0)
-            gimp_progress_update ((double) ypos / (double) yres);
-        }
-
-      g_free (rowbuf);
-      g_free (data);
+      if (! success)
+        goto out;
     }
   else
     {
-      /* allocate a buffer for retrieving information from the pixel
-       * region
-       */
-      gfloat *data = g_new (gfloat, xres * np);
-
-      rowinfo.output = output;
-      rowinfo.rowbuf = NULL;
-      rowinfo.xres   = xres;
-      rowinfo.np     = np;
+      rowinfo.rowbuf  = NULL;
+      rowinfo.saverow = NULL;
 
       /* Write the body out in reverse row order */
-      for (ypos = yres - 1; ypos >= 0; ypos--)
-        {
-          gegl_buffer_get (buffer,
-                           GEGL_RECTANGLE (0, ypos, xres, 1), 1.0,
-                           format, data,
-                           GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
-
-          if (! pnmsaverow_float (&rowinfo, data, error))
-            {
-              g_free (data);
-              goto out;
-            }
-
-          if (ypos % 32 == 0)
-            gimp_progress_update ((double) (yres - ypos) / (double) yres);
-        }
-
-      g_free (data);
+      if (! gimp_drawable_foreach_band (drawable, format, TRUE,
+                                        export_band_float, &rowinfo))
+        goto out;
     }
 
   gimp_progress_update (1.0);
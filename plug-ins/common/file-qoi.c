@@ -44,6 +44,19 @@
 typedef struct _Qoi      Qoi;
 typedef struct _QoiClass QoiClass;
 
+/* The state of qoi_encode(), kept from one band of the image to the
+ * next, so that the image is encoded as it is read.
+ */
+typedef struct
+{
+  FILE       *fp;
+  gint        channels;
+  qoi_rgba_t  index[64];
+  qoi_rgba_t  px_prev;
+  gint        run;
+  guchar     *bytes;
+} QoiEncoder;
+
 struct _Qoi
 {
   GimpPlugIn      parent_instance;
@@ -89,6 +102,11 @@ static gboolean         export_image         (GFile                 *file,
                                               GimpImage             *image,
                                               GimpDrawable          *drawable,
                                               GError               **error);
+static gboolean         encode_band          (guchar                *pixels,
+                                              gint                   y,
+                                              gint                   width,
+                                              gint                   n_rows,
+                                              gpointer               user_data);
 
 
 G_DEFINE_TYPE (Qoi, qoi, GIMP_TYPE_PLUG_IN)
@@ -317,20 +335,21 @@ export_image (GFile         *file,
               GimpDrawable  *drawable,
               GError       **error)
 {
-  GeglBuffer *buffer;
+  QoiEncoder  encoder = { 0, };
   const Babl *format;
-  qoi_desc    desc;
-  void       *pixels = NULL;
+  guchar      header[QOI_HEADER_SIZE];
+  gint        p = 0;
+  guint32     width;
+  guint32     height;
+  guchar      colorspace;
   gboolean    has_alpha;
-  gint        success;
+  gboolean    success;
 
   has_alpha = gimp_drawable_has_alpha (drawable);
 
-  buffer = gimp_drawable_get_buffer (drawable);
+  width  = gimp_drawable_get_width  (drawable);
+  height = gimp_drawable_get_height (drawable);
 
-  desc.width    = gegl_buffer_get_width  (buffer);
-  desc.height   = gegl_buffer_get_height (buffer);
-  desc.channels = has_alpha ? 4 : 3;
   switch (gimp_image_get_precision (image))
     {
       case GIMP_PRECISION_U8_LINEAR:
@@ -339,29 +358,59 @@ export_image (GFile         *file,
       case GIMP_PRECISION_HALF_LINEAR:
       case GIMP_PRECISION_FLOAT_LINEAR:
       case GIMP_PRECISION_DOUBLE_LINEAR:
-        desc.colorspace = QOI_LINEAR;
+        colorspace = QOI_LINEAR;
         break;
 
       default:
-        desc.colorspace = QOI_SRGB;
+        colorspace = QOI_SRGB;
         break;
     }
 
   gimp_progress_init_printf (_("Exporting '%s'"),
                              gimp_file_get_utf8_name (file));
 
+  encoder.fp = g_fopen (g_file_peek_path (file), "wb");
+
+  if (! encoder.fp)
+    {
+      g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
+                   _("Could not open '%s' for writing: %s"),
+                   gimp_file_get_utf8_name (file), g_strerror (errno));
+      return FALSE;
+    }
+
   format = babl_format (has_alpha ? "R'G'B'A u8" : "R'G'B' u8");
 
-  pixels = (guchar *) g_malloc (desc.width * desc.height * desc.channels);
+  encoder.channels       = has_alpha ? 4 : 3;
+  encoder.px_prev.rgba.a = 255;
+  /* a pixel takes at most one byte more than its channels */
+  encoder.bytes          = g_malloc ((gsize) width * gimp_tile_height () *
+                                     (encoder.channels + 1));
 
-  gegl_buffer_get (buffer, GEGL_RECTANGLE (0, 0, desc.width, desc.height),
-                   1.0, format, pixels,
-                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+  qoi_write_32 (header, &p, QOI_MAGIC);
+  qoi_write_32 (header, &p, width);
+  qoi_write_32 (header, &p, height);
+  header[p++] = encoder.channels;
+  header[p++] = colorspace;
 
-  success = qoi_write (g_file_peek_path (file), pixels, &desc);
+  success = (fwrite (header, QOI_HEADER_SIZE, 1, encoder.fp) == 1 &&
+             gimp_drawable_foreach_band (drawable, format, FALSE,
+                                         encode_band, &encoder));
 
-  g_object_unref (buffer);
-  g_free (pixels);
+  if (success)
+    {
+      if (encoder.run > 0)
+        success = (fputc (QOI_OP_RUN | (encoder.run - 1), encoder.fp) != EOF);
+
+      success = (success &&
+                 fwrite (qoi_padding, sizeof (qoi_padding), 1,
+                         encoder.fp) == 1);
+    }
+
+  if (fclose (encoder.fp) != 0)
+    success = FALSE;
+
+  g_free (encoder.bytes);
 
   if (! success)
     {
@@ -373,3 +422,104 @@ export_image (GFile         *file,
 
   return TRUE;
 }
+
+/* Encodes a band of the image the way qoi_encode() encodes a whole
+ * image; only the final run is left for export_image() to write.
+ */
+static gboolean
+encode_band (guchar   *pixels,
+             gint      y,
+             gint      width,
+             gint      n_rows,
+             gpointer  user_data)
+{
+  QoiEncoder   *encoder = user_data;
+  const guchar *end;
+  gsize         p       = 0;
+
+  end = pixels + (gsize) width * n_rows * encoder->channels;
+
+  for (; pixels < end; pixels += encoder->channels)
+    {
+      qoi_rgba_t px;
+      gint       index_pos;
+
+      px.rgba.r = pixels[0];
+      px.rgba.g = pixels[1];
+      px.rgba.b = pixels[2];
+      px.rgba.a = encoder->channels == 4 ? pixels[3] : encoder->px_prev.rgba.a;
+
+      if (px.v == encoder->px_prev.v)
+        {
+          if (++encoder->run == 62)
+            {
+              encoder->bytes[p++] = QOI_OP_RUN | (encoder->run - 1);
+              encoder->run = 0;
+            }
+
+          continue;
+        }
+
+      if (encoder->run > 0)
+        {
+          encoder->bytes[p++] = QOI_OP_RUN | (encoder->run - 1);
+          encoder->run = 0;
+        }
+
+      index_pos = QOI_COLOR_HASH (px) % 64;
+
+      if (encoder->index[index_pos].v == px.v)
+        {
+          encoder->bytes[p++] = QOI_OP_INDEX | index_pos;
+        }
+      else
+        {
+          encoder->index[index_pos] = px;
+
+          if (px.rgba.a == encoder->px_prev.rgba.a)
+            {
+              gint8 vr   = px.rgba.r - encoder->px_prev.rgba.r;
+              gint8 vg   = px.rgba.g - encoder->px_prev.rgba.g;
+              gint8 vb   = px.rgba.b - encoder->px_prev.rgba.b;
+              gint8 vg_r = vr - vg;
+              gint8 vg_b = vb - vg;
+
+              if (vr > -3 && vr < 2 &&
+                  vg > -3 && vg < 2 &&
+                  vb > -3 && vb < 2)
+                {
+                  encoder->bytes[p++] = (QOI_OP_DIFF   |
+                                         (vr + 2) << 4 |
+                                         (vg + 2) << 2 |
+                                         (vb + 2));
+                }
+              else if (vg_r >  -9 && vg_r <  8 &&
+                       vg   > -33 && vg   < 32 &&
+                       vg_b >  -9 && vg_b <  8)
+                {
+                  encoder->bytes[p++] = QOI_OP_LUMA | (vg + 32);
+                  encoder->bytes[p++] = (vg_r + 8) << 4 | (vg_b + 8);
+                }
+              else
+                {
+                  encoder->bytes[p++] = QOI_OP_RGB;
+                  encoder->bytes[p++] = px.rgba.r;
+                  encoder->bytes[p++] = px.rgba.g;
+                  encoder->bytes[p++] = px.rgba.b;
+                }
+            }
+          else
+            {
+              encoder->bytes[p++] = QOI_OP_RGBA;
+              encoder->bytes[p++] = px.rgba.r;
+              encoder->bytes[p++] = px.rgba.g;
+              encoder->bytes[p++] = px.rgba.b;
+              encoder->bytes[p++] = px.rgba.a;
+            }
+        }
+
+      encoder->px_prev = px;
+    }
+
+  return fwrite (encoder->bytes, 1, p, encoder->fp) == p;
+}
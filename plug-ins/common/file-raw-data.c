@@ -140,6 +140,14 @@ typedef struct
   guchar        cmap[768]; /* color map for indexed images     */
 } RawGimpData;
 
+typedef struct
+{
+  FILE         *fp;        /* pointer to the already open file */
+  gint          bpp;       /* bytes per pixel of the drawable  */
+  gint          bpc;       /* bytes per component              */
+  gint          component; /* component to export, or -1       */
+} RawExportData;
+
 
 typedef struct _Raw      Raw;
 typedef struct _RawClass RawClass;
@@ -241,6 +249,11 @@ static gboolean         export_image         (GFile                    *file,
                                               GimpDrawable             *drawable,
                                               GimpProcedureConfig      *config,
                                               GError                  **error);
+static gboolean         export_band          (guchar                   *pixels,
+                                              gint                      y,
+                                              gint                      width,
+                                              gint                      n_rows,
+                                              gpointer                  user_data);
 
 static void            get_bpp               (GimpProcedureConfig      *config,
                                               gint                     *bpp,
@@ -1328,13 +1341,11 @@ export_image (GFile                *file,
               GimpProcedureConfig  *config,
               GError              **error)
 {
-  GeglBuffer             *buffer;
+  RawExportData           data;
   const Babl             *format = NULL;
   guchar                 *cmap   = NULL;  /* colormap for indexed images */
-  guchar                 *buf;
-  guchar                 *components[4] = { 0, };
   gint                    n_components;
-  gint32                  width, height, bpp;
+  gint32                  bpp;
   gint                    bpc;
   FILE                   *fp;
   gint                    i, j, c;
@@ -1346,8 +1357,6 @@ export_image (GFile                *file,
   planar_conf  = gimp_procedure_config_get_choice_id (config, "planar-configuration");
   palette_type = gimp_procedure_config_get_choice_id (config, "palette-type");
 
-  buffer = gimp_drawable_get_buffer (drawable);
-
   format = gimp_drawable_get_format (drawable);
 
   n_components = babl_format_get_n_components (format);
@@ -1359,16 +1368,8 @@ export_image (GFile                *file,
   if (gimp_drawable_is_indexed (drawable))
     cmap = gimp_palette_get_colormap (gimp_image_get_palette (image), babl_format ("R'G'B' u8"), &palsize, NULL);
 
-  width  = gegl_buffer_get_width  (buffer);
-  height = gegl_buffer_get_height (buffer);
-
-  buf = g_new (guchar, width * height * bpp);
-
-  gegl_buffer_get (buffer, GEGL_RECTANGLE (0, 0, width, height), 1.0,
-                   format, buf,
-                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
-
-  g_object_unref (buffer);
+  gimp_progress_init_printf (_("Exporting '%s'"),
+                             gimp_file_get_utf8_name (file));
 
   fp = g_fopen (g_file_peek_path (file), "wb");
 
@@ -1382,10 +1383,17 @@ export_image (GFile                *file,
 
   ret = TRUE;
 
+  data.fp  = fp;
+  data.bpp = bpp;
+  data.bpc = bpc;
+
   switch (planar_conf)
     {
     case RAW_PLANAR_CONTIGUOUS:
-      if (! fwrite (buf, width * height * bpp, 1, fp))
+      data.component = -1;
+
+      if (! gimp_drawable_foreach_band (drawable, format, FALSE,
+                                        export_band, &data))
         {
           fclose (fp);
           return FALSE;
@@ -1436,29 +1444,15 @@ export_image (GFile                *file,
       break;
 
     case RAW_PLANAR_SEPARATE:
-      for (c = 0; c < n_components; c++)
-        components[c] = g_new (guchar, width * height * bpc);
-
-      for (i = 0; i < width * height; i++)
-        {
-          for (c = 0; c < n_components; c++)
-            {
-              if (bpc == 1)
-                components[c][i] = buf[i * n_components + c];
-              else if (bpc == 2)
-                ((guint16 **) components)[c][i] = ((guint16 *) buf)[i * n_components + c];
-              else /* if (bpc == 4) */
-                ((guint32 **) components)[c][i] = ((guint32 *) buf)[i * n_components + c];
-            }
-        }
-
-      ret = TRUE;
-      for (c = 0; c < n_components; c++)
+      /* the planes follow each other in the file, so the drawable is
+       * read once for each of them
+       */
+      for (c = 0; c < n_components && ret; c++)
         {
-          if (! fwrite (components[c], width * height * bpc, 1, fp))
-            ret = FALSE;
+          data.component = c;
 
-          g_free (components[c]);
+          ret = gimp_drawable_foreach_band (drawable, format, FALSE,
+                                            export_band, &data);
         }
 
       fclose (fp);
@@ -1472,6 +1466,41 @@ export_image (GFile                *file,
   return ret;
 }
 
+/* Writes out a band of the drawable, either all of its components or,
+ * for planar files, only data->component.
+ */
+static gboolean
+export_band (guchar   *pixels,
+             gint      y,
+             gint      width,
+             gint      n_rows,
+             gpointer  user_data)
+{
+  RawExportData *data     = user_data;
+  gint           n_pixels = width * n_rows;
+  gint           c        = data->component;
+  gint           n        = data->bpp / data->bpc;
+  gint           i;
+
+  if (c < 0)
+    return fwrite (pixels, (gsize) n_pixels * data->bpp, 1, data->fp) == 1;
+
+  /* pack the component at the start of the band, in place: each
+   * component is written at or before where it is read
+   */
+  for (i = 0; i < n_pixels; i++)
+    {
+      if (data->bpc == 1)
+        pixels[i] = pixels[i * n + c];
+      else if (data->bpc == 2)
+        ((guint16 *) pixels)[i] = ((guint16 *) pixels)[i * n + c];
+      else /* if (data->bpc == 4) */
+        ((guint32 *) pixels)[i] = ((guint32 *) pixels)[i * n + c];
+    }
+
+  return fwrite (pixels, (gsize) n_pixels * data->bpc, 1, data->fp) == 1;
+}
+
 static void
 get_bpp (GimpProcedureConfig *config,
          gint                *bpp,
@@ -150,6 +150,18 @@ typedef struct tga_info_struct
   gdouble gamma;
 } tga_info;
 
+/* What export_band() needs to write out the rows of the image */
+typedef struct
+{
+  FILE          *fp;
+  GimpImageType  dtype;
+  gint           out_bpp;
+  gint           num_colors;
+  gboolean       rle;
+  gboolean       bottom_up;
+  guchar        *data;
+} TgaWriter;
+
 
 typedef struct _Tga      Tga;
 typedef struct _TgaClass TgaClass;
@@ -197,6 +209,11 @@ static gboolean         export_image         (GFile                 *file,
                                               GimpDrawable          *drawable,
                                               GObject               *config,
                                               GError               **error);
+static gboolean         export_band          (guchar                *pixels,
+                                              gint                   y,
+                                              gint                   width,
+                                              gint                   n_rows,
+                                              gpointer               user_data);
 
 static gboolean         save_dialog          (GimpImage             *image,
                                               GimpProcedure         *procedure,
@@ -1183,7 +1200,7 @@ export_image (GFile         *file,
               GObject       *config,
               GError       **error)
 {
-  GeglBuffer    *buffer;
+  TgaWriter      writer;
   const Babl    *format = NULL;
   GimpImageType  dtype;
   gint           width;
@@ -1191,12 +1208,10 @@ export_image (GFile         *file,
   FILE          *fp;
   gint           out_bpp = 0;
   gboolean       status  = TRUE;
-  gint           i, row;
+  gint           i;
   guchar         header[18];
   guchar         footer[26];
-  guchar        *pixels;
-  guchar        *data;
-  gint           num_colors;
+  gint           num_colors = 0;
   guchar        *gimp_cmap = NULL;
   gboolean       rle;
   TgaOrigin      origin;
@@ -1207,12 +1222,10 @@ export_image (GFile         *file,
   origin = gimp_procedure_config_get_choice_id (GIMP_PROCEDURE_CONFIG (config),
                                                 "origin");
 
-  buffer = gimp_drawable_get_buffer (drawable);
-
   dtype = gimp_drawable_type (drawable);
 
-  width  = gegl_buffer_get_width  (buffer);
-  height = gegl_buffer_get_height (buffer);
+  width  = gimp_drawable_get_width  (drawable);
+  height = gimp_drawable_get_height (drawable);
 
   gimp_progress_init_printf (_("Exporting '%s'"),
                              gimp_file_get_utf8_name (file));
@@ -1347,80 +1360,98 @@ export_image (GFile         *file,
       fputc (0, fp);
     }
 
-  if (dtype == GIMP_INDEXEDA_IMAGE)
-    pixels = g_new (guchar, width * 2);
-  else
-    pixels = g_new (guchar, width * out_bpp);
-  data   = g_new (guchar, width * out_bpp);
+  writer.fp         = fp;
+  writer.dtype      = dtype;
+  writer.out_bpp    = out_bpp;
+  writer.num_colors = num_colors;
+  writer.rle        = rle;
+  writer.bottom_up  = (origin == ORIGIN_BOTTOM_LEFT);
+  writer.data       = g_new (guchar, width * out_bpp);
+
+  /* a bottom-left origin means the rows are stored bottom to top */
+  if (! gimp_drawable_foreach_band (drawable, format, writer.bottom_up,
+                                    export_band, &writer))
+    {
+      g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
+                   _("Could not write to '%s': %s"),
+                   gimp_file_get_utf8_name (file), g_strerror (errno));
+
+      g_free (writer.data);
+      fclose (fp);
+
+      return FALSE;
+    }
+
+  g_free (writer.data);
+
+  /* footer must be the last thing written to file */
+  memset (footer, 0, 8); /* No extensions, no developer directory */
+  memcpy (footer + 8, magic, sizeof (magic)); /* magic signature */
+  fwrite (footer, sizeof (footer), 1, fp);
+
+  fclose (fp);
+
+  gimp_progress_update (1.0);
+
+  return status;
+}
+
+static gboolean
+export_band (guchar   *pixels,
+             gint      y,
+             gint      width,
+             gint      n_rows,
+             gpointer  user_data)
+{
+  TgaWriter *writer = user_data;
+  gint       bpp;
+  gint       row;
+  gint       i;
 
-  for (row = 0; row < height; ++row)
+  /* the drawable is read as indexed-alpha, but written as indexed */
+  bpp = writer->dtype == GIMP_INDEXEDA_IMAGE ? 2 : writer->out_bpp;
+
+  for (row = 0; row < n_rows; row++)
     {
-      if (origin)
-        {
-          gegl_buffer_get (buffer,
-                           GEGL_RECTANGLE (0, height - (row + 1), width, 1), 1.0,
-                           format, pixels,
-                           GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
-        }
-      else
-        {
-          gegl_buffer_get (buffer,
-                           GEGL_RECTANGLE (0, row, width, 1), 1.0,
-                           format, pixels,
-                           GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
-        }
+      guchar *src  = pixels + (writer->bottom_up ? n_rows - 1 - row : row) *
+                              width * bpp;
+      guchar *data = writer->data;
 
-      if (dtype == GIMP_RGB_IMAGE)
+      if (writer->dtype == GIMP_RGB_IMAGE)
         {
-          bgr2rgb (data, pixels, width, out_bpp, 0);
+          bgr2rgb (data, src, width, writer->out_bpp, 0);
         }
-      else if (dtype == GIMP_RGBA_IMAGE)
+      else if (writer->dtype == GIMP_RGBA_IMAGE)
         {
-          bgr2rgb (data, pixels, width, out_bpp, 1);
+          bgr2rgb (data, src, width, writer->out_bpp, 1);
         }
-      else if (dtype == GIMP_INDEXEDA_IMAGE)
+      else if (writer->dtype == GIMP_INDEXEDA_IMAGE)
         {
           for (i = 0; i < width; ++i)
             {
-              if (pixels[i * 2 + 1] > 127)
-                data[i] = pixels[i * 2];
+              if (src[i * 2 + 1] > 127)
+                data[i] = src[i * 2];
               else
-                data[i] = num_colors;
+                data[i] = writer->num_colors;
             }
         }
       else
         {
-          memcpy (data, pixels, width * out_bpp);
+          data = src;
         }
 
-      if (rle)
+      if (writer->rle)
         {
-          rle_write (fp, data, width, out_bpp);
+          rle_write (writer->fp, data, width, writer->out_bpp);
         }
       else
         {
-          fwrite (data, width * out_bpp, 1, fp);
+          fwrite (data, width * writer->out_bpp, 1, writer->fp);
         }
-
-      if (row % 16 == 0)
-        gimp_progress_update ((gdouble) row / (gdouble) height);
     }
 
-  g_object_unref (buffer);
-
-  g_free (data);
-  g_free (pixels);
-
-  /* footer must be the last thing written to file */
-  memset (footer, 0, 8); /* No extensions, no developer directory */
-  memcpy (footer + 8, magic, sizeof (magic)); /* magic signature */
-  fwrite (footer, sizeof (footer), 1, fp);
-
-  fclose (fp);
-
-  gimp_progress_update (1.0);
-
-  return status;
+  /* stop at the first write error */
+  return ! ferror (writer->fp);
 }
 
 static gboolean
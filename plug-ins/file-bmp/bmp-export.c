@@ -42,10 +42,25 @@
 #include "libgimp/stdplugins-intl.h"
 
 
+typedef struct
+{
+  FILE     *f;
+  gint      width;
+  gboolean  use_run_length_encoding;
+  gint      channels;
+  gint      bpp;
+  gint      bytes_per_row;
+  RGBMode   rgb_format;
+  guchar   *row;
+  guchar   *chains;
+  gint      length;
+} BmpWriter;
+
+
 static  gboolean  write_image     (FILE          *f,
-                                   guchar        *src,
+                                   GimpDrawable  *drawable,
+                                   const Babl    *format,
                                    gint           width,
-                                   gint           height,
                                    gboolean       use_run_length_encoding,
                                    gint           channels,
                                    gint           bpp,
@@ -54,6 +69,13 @@ static  gboolean  write_image     (FILE          *f,
                                    RGBMode        rgb_format,
                                    gint           mask_info_size,
                                    gint           color_space_size);
+static  gboolean  write_band      (guchar        *pixels,
+                                   gint           y,
+                                   gint           width,
+                                   gint           n_rows,
+                                   gpointer       user_data);
+static  gboolean  write_row       (BmpWriter     *writer,
+                                   guchar        *src);
 
 static  gboolean  save_dialog     (GimpProcedure *procedure,
                                    GObject       *config,
@@ -129,8 +151,6 @@ export_image (GFile         *file,
   gint            bytes_per_row;
   glong           BitsPerPixel;
   gint            colors;
-  guchar         *pixels = NULL;
-  GeglBuffer     *buffer;
   const Babl     *format;
   GimpImageType   drawable_type;
   gint            drawable_width;
@@ -143,8 +163,6 @@ export_image (GFile         *file,
   gboolean        write_color_space;
   RGBMode         rgb_format;
 
-  buffer = gimp_drawable_get_buffer (drawable);
-
   drawable_type   = gimp_drawable_type   (drawable);
   drawable_width  = gimp_drawable_get_width  (drawable);
   drawable_height = gimp_drawable_get_height (drawable);
@@ -338,16 +356,6 @@ export_image (GFile         *file,
       return GIMP_PDB_EXECUTION_ERROR;
     }
 
-  /* fetch the image */
-  pixels = g_new (guchar, (gsize) drawable_width * drawable_height * channels);
-
-  gegl_buffer_get (buffer,
-                   GEGL_RECTANGLE (0, 0, drawable_width, drawable_height), 1.0,
-                   format, pixels,
-                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
-
-  g_object_unref (buffer);
-
   /* Now, we need some further information ... */
   cols = drawable_width;
   rows = drawable_height;
@@ -574,7 +582,7 @@ export_image (GFile         *file,
   /* After that is done, we write the image ... */
 
   if (! write_image (outfile,
-                     pixels, cols, rows,
+                     drawable, format, cols,
                      use_rle,
                      channels, BitsPerPixel, bytes_per_row,
                      MapSize, rgb_format,
@@ -584,14 +592,12 @@ export_image (GFile         *file,
   /* ... and exit normally */
 
   fclose (outfile);
-  g_free (pixels);
 
   return GIMP_PDB_SUCCESS;
 
 abort:
   if (outfile)
     fclose (outfile);
-  g_free(pixels);
 
   g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
                _("Error writing to file."));
@@ -634,345 +640,354 @@ Make5551 (guchar  r,
 }
 
 static gboolean
-write_image (FILE     *f,
-             guchar   *src,
-             gint      width,
-             gint      height,
-             gboolean  use_run_length_encoding,
-             gint      channels,
-             gint      bpp,
-             gint      bytes_per_row,
-             gint      MapSize,
-             RGBMode   rgb_format,
-             gint      mask_info_size,
-             gint      color_space_size)
+write_image (FILE         *f,
+             GimpDrawable *drawable,
+             const Babl   *format,
+             gint          width,
+             gboolean      use_run_length_encoding,
+             gint          channels,
+             gint          bpp,
+             gint          bytes_per_row,
+             gint          MapSize,
+             RGBMode       rgb_format,
+             gint          mask_info_size,
+             gint          color_space_size)
 {
+  BmpWriter writer = { 0, };
+  guint32   uint32buf;
+  gint      length;
+
+  writer.f                       = f;
+  writer.width                   = width;
+  writer.use_run_length_encoding = use_run_length_encoding && bpp > 1;
+  writer.channels                = channels;
+  writer.bpp                     = bpp;
+  writer.bytes_per_row           = bytes_per_row;
+  writer.rgb_format              = rgb_format;
+
+  if (bpp <= 8 && writer.use_run_length_encoding)
+    {
+      writer.row    = g_new (guchar, width / (8 / bpp) + 10);
+      writer.chains = g_new (guchar, width / (8 / bpp) + 10);
+    }
+
+  /* BMP rows are stored bottom to top */
+  if (! gimp_drawable_foreach_band (drawable, format, TRUE,
+                                    write_band, &writer))
+    goto abort;
+
+  if (bpp <= 8 && writer.use_run_length_encoding)
+    {
+      length = writer.length;
+
+      if (fseek (f, -2, SEEK_CUR))                  /* Overwrite last End of row ... */
+        goto abort;
+      if (EOF == putc (0, f) || EOF == putc (1, f))   /* ... with End of file */
+        goto abort;
+
+      if (fseek (f, 0x22, SEEK_SET))                /* Write length of image */
+        goto abort;
+      uint32buf = GUINT32_TO_LE (length);
+      if (fwrite (&uint32buf, 4, 1, f) != 1)
+        goto abort;
+
+      if (fseek (f, 0x02, SEEK_SET))                /* Write length of file */
+        goto abort;
+      length += (0x36 + MapSize + mask_info_size + color_space_size);
+      uint32buf = GUINT32_TO_LE (length);
+      if (fwrite (&uint32buf, 4, 1, f) != 1)
+        goto abort;
+    }
+
+  g_free (writer.chains);
+  g_free (writer.row);
+
+  gimp_progress_update (1.0);
+  return TRUE;
+
+abort:
+  g_free (writer.chains);
+  g_free (writer.row);
+
+  return FALSE;
+}
+
+static gboolean
+write_band (guchar   *pixels,
+            gint      y,
+            gint      width,
+            gint      n_rows,
+            gpointer  user_data)
+{
+  BmpWriter *writer = user_data;
+  gint       ypos;
+
+  for (ypos = n_rows - 1; ypos >= 0; ypos--)
+    {
+      if (! write_row (writer, pixels + ypos * width * writer->channels))
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+static gboolean
+write_row (BmpWriter *writer,
+           guchar    *src)
+{
+  FILE   *f        = writer->f;
+  gint    width    = writer->width;
+  gint    channels = writer->channels;
+  gint    bpp      = writer->bpp;
   guchar  buf[16];
-  guint32 uint32buf;
   guchar *temp, v;
-  guchar *row    = NULL;
-  guchar *chains = NULL;
-  gint    xpos, ypos, i, j, rowstride, length, thiswidth;
+  guchar *row      = writer->row;
+  guchar *chains   = writer->chains;
+  gint    xpos, i, j, thiswidth;
   gint    breite, k;
   guchar  n, r, g, b, a;
-  gint    cur_progress;
-  gint    max_progress;
   gint    padding;
 
-  xpos = 0;
-  rowstride = width * channels;
-
-  cur_progress = 0;
-  max_progress = height;
-
   /* We'll begin with the 16/24/32 bit Bitmaps, they are easy :-) */
 
   if (bpp > 8)
     {
-      padding = bytes_per_row - (width * (bpp / 8));
-      for (ypos = height - 1; ypos >= 0; ypos--)  /* for each row   */
+      padding = writer->bytes_per_row - (width * (bpp / 8));
+
+      for (xpos = 0; xpos < width; xpos++)  /* for each pixel */
         {
-          for (i = 0; i < width; i++)  /* for each pixel */
+          temp = src + (xpos * channels);
+          switch (writer->rgb_format)
             {
-              temp = src + (ypos * rowstride) + (xpos * channels);
-              switch (rgb_format)
-                {
-                default:
-                case RGB_888:
-                  buf[2] = *temp++;
-                  buf[1] = *temp++;
-                  buf[0] = *temp++;
-                  xpos++;
-                  if (channels > 3 && (guchar) *temp == 0)
-                    buf[0] = buf[1] = buf[2] = 0xff;
-
-                  if (fwrite (buf, 1, 3, f) != 3)
-                    goto abort;
-                  break;
-                case RGBX_8888:
-                  buf[2] = *temp++;
-                  buf[1] = *temp++;
-                  buf[0] = *temp++;
-                  buf[3] = 0;
-                  xpos++;
-                  if (channels > 3 && (guchar) *temp == 0)
-                    buf[0] = buf[1] = buf[2] = 0xff;
-
-                  if (fwrite (buf, 1, 4, f) != 4)
-                    goto abort;
-                  break;
-                case RGBA_8888:
-                  buf[2] = *temp++;
-                  buf[1] = *temp++;
-                  buf[0] = *temp++;
-                  buf[3] = *temp;
-                  xpos++;
-
-                  if (fwrite (buf, 1, 4, f) != 4)
-                    goto abort;
-                  break;
-                case RGB_565:
-                  r = *temp++;
-                  g = *temp++;
-                  b = *temp++;
-                  if (channels > 3 && (guchar) *temp == 0)
-                    r = g = b = 0xff;
-                  Make565 (r, g, b, buf);
-                  xpos++;
-
-                  if (fwrite (buf, 1, 2, f) != 2)
-                    goto abort;
-                  break;
-                case RGB_555:
-                  r = *temp++;
-                  g = *temp++;
-                  b = *temp++;
-                  if (channels > 3 && (guchar) *temp == 0)
-                    r = g = b = 0xff;
-                  Make5551 (r, g, b, 0x0, buf);
-                  xpos++;
-
-                  if (fwrite (buf, 1, 2, f) != 2)
-                    goto abort;
-                  break;
-                case RGBA_5551:
-                  r = *temp++;
-                  g = *temp++;
-                  b = *temp++;
-                  a = *temp;
-                  Make5551 (r, g, b, a, buf);
-                  xpos++;
-
-                  if (fwrite (buf, 1, 2, f) != 2)
-                    goto abort;
-                  break;
-                }
+            default:
+            case RGB_888:
+              buf[2] = *temp++;
+              buf[1] = *temp++;
+              buf[0] = *temp++;
+              if (channels > 3 && (guchar) *temp == 0)
+                buf[0] = buf[1] = buf[2] = 0xff;
+
+              if (fwrite (buf, 1, 3, f) != 3)
+                return FALSE;
+              break;
+            case RGBX_8888:
+              buf[2] = *temp++;
+              buf[1] = *temp++;
+              buf[0] = *temp++;
+              buf[3] = 0;
+              if (channels > 3 && (guchar) *temp == 0)
+                buf[0] = buf[1] = buf[2] = 0xff;
+
+              if (fwrite (buf, 1, 4, f) != 4)
+                return FALSE;
+              break;
+            case RGBA_8888:
+              buf[2] = *temp++;
+              buf[1] = *temp++;
+              buf[0] = *temp++;
+              buf[3] = *temp;
+
+              if (fwrite (buf, 1, 4, f) != 4)
+                return FALSE;
+              break;
+            case RGB_565:
+              r = *temp++;
+              g = *temp++;
+              b = *temp++;
+              if (channels > 3 && (guchar) *temp == 0)
+                r = g = b = 0xff;
+              Make565 (r, g, b, buf);
+
+              if (fwrite (buf, 1, 2, f) != 2)
+                return FALSE;
+              break;
+            case RGB_555:
+              r = *temp++;
+              g = *temp++;
+              b = *temp++;
+              if (channels > 3 && (guchar) *temp == 0)
+                r = g = b = 0xff;
+              Make5551 (r, g, b, 0x0, buf);
+
+              if (fwrite (buf, 1, 2, f) != 2)
+                return FALSE;
+              break;
+            case RGBA_5551:
+              r = *temp++;
+              g = *temp++;
+              b = *temp++;
+              a = *temp;
+              Make5551 (r, g, b, a, buf);
+
+              if (fwrite (buf, 1, 2, f) != 2)
+                return FALSE;
+              break;
             }
+        }
 
-          for (int j = 0; j < padding; j++)
+      for (int j = 0; j < padding; j++)
+        {
+          if (EOF == putc (0, f))
+            return FALSE;
+        }
+    }
+  else if (! writer->use_run_length_encoding)
+    {
+      /* now it gets more difficult */
+
+      /* uncompressed 1,4 and 8 bit */
+
+      thiswidth = (width * bpp + 7) / 8;
+      padding = writer->bytes_per_row - thiswidth;
+
+      for (xpos = 0; xpos < width;)  /* for each _byte_ */
+        {
+          v = 0;
+          for (i = 1;
+               (i <= (8 / bpp)) && (xpos < width);
+               i++, xpos++)  /* for each pixel */
             {
-              if (EOF == putc (0, f))
-                goto abort;
+              temp = src + (xpos * channels);
+              if (channels > 1 && *(temp+1) == 0) *temp = 0x0;
+              v=v | ((guchar) *temp << (8 - (i * bpp)));
             }
 
-          cur_progress++;
-          if ((cur_progress % 5) == 0)
-            gimp_progress_update ((gdouble) cur_progress /
-                                  (gdouble) max_progress);
+          if (fwrite (&v, 1, 1, f) != 1)
+            return FALSE;
+        }
 
-          xpos = 0;
+      for (int j = 0; j < padding; j++)
+        {
+          if (EOF == putc (0, f))
+            return FALSE;
         }
     }
   else
     {
-      /* now it gets more difficult */
-      if (! use_run_length_encoding || bpp == 1)
-        {
-          /* uncompressed 1,4 and 8 bit */
+      /* Save RLE encoded file, quite difficult */
 
-          thiswidth = (width * bpp + 7) / 8;
-          padding = bytes_per_row - thiswidth;
+      /* each row separately */
+      j = 0;
 
-          for (ypos = height - 1; ypos >= 0; ypos--) /* for each row */
+      /* first copy the pixels to a buffer, making one byte
+       * from two 4bit pixels
+       */
+      for (xpos = 0; xpos < width;)
+        {
+          v = 0;
+
+          for (i = 1;
+               (i <= (8 / bpp)) && (xpos < width);
+               i++, xpos++)
             {
-              for (xpos = 0; xpos < width;)  /* for each _byte_ */
-                {
-                  v = 0;
-                  for (i = 1;
-                       (i <= (8 / bpp)) && (xpos < width);
-                       i++, xpos++)  /* for each pixel */
-                    {
-                      temp = src + (ypos * rowstride) + (xpos * channels);
-                      if (channels > 1 && *(temp+1) == 0) *temp = 0x0;
-                      v=v | ((guchar) *temp << (8 - (i * bpp)));
-                    }
+              /* for each pixel */
 
-                  if (fwrite (&v, 1, 1, f) != 1)
-                    goto abort;
-                }
+              temp = src + (xpos * channels);
+              if (channels > 1 && *(temp+1) == 0) *temp = 0x0;
+              v = v | ((guchar) * temp << (8 - (i * bpp)));
+            }
 
-              for (int j = 0; j < padding; j++)
-                {
-                  if (EOF == putc (0, f))
-                    goto abort;
-                }
+          row[j++] = v;
+        }
 
-              xpos = 0;
+      breite = width / (8 / bpp);
+      if (width % (8 / bpp))
+        breite++;
 
-              cur_progress++;
-              if ((cur_progress % 5) == 0)
-                gimp_progress_update ((gdouble) cur_progress /
-                                        (gdouble) max_progress);
-            }
-        }
-      else
+      /* then check for strings of equal bytes */
+      for (i = 0; i < breite; i += j)
         {
-          /* Save RLE encoded file, quite difficult */
+          j = 0;
 
-          length = 0;
+          while ((i + j < breite) &&
+                 (j < (255 / (8 / bpp))) &&
+                 (row[i + j] == row[i]))
+            j++;
 
-          row    = g_new (guchar, width / (8 / bpp) + 10);
-          chains = g_new (guchar, width / (8 / bpp) + 10);
+          chains[i] = j;
+        }
 
-          for (ypos = height - 1; ypos >= 0; ypos--)
+      /* then write the strings and the other pixels to the file */
+      for (i = 0; i < breite;)
+        {
+          if (chains[i] < 3)
             {
-              /* each row separately */
-              j = 0;
-
-              /* first copy the pixels to a buffer, making one byte
-               * from two 4bit pixels
-               */
-              for (xpos = 0; xpos < width;)
-                {
-                  v = 0;
-
-                  for (i = 1;
-                       (i <= (8 / bpp)) && (xpos < width);
-                       i++, xpos++)
-                    {
-                      /* for each pixel */
+              /* strings of different pixels ... */
 
-                      temp = src + (ypos * rowstride) + (xpos * channels);
-                      if (channels > 1 && *(temp+1) == 0) *temp = 0x0;
-                      v = v | ((guchar) * temp << (8 - (i * bpp)));
-                    }
+              j = 0;
 
-                  row[j++] = v;
-                }
+              while ((i + j < breite) &&
+                     (j < (255 / (8 / bpp))) &&
+                     (chains[i + j] < 3))
+                j += chains[i + j];
 
-              breite = width / (8 / bpp);
-              if (width % (8 / bpp))
-                breite++;
+              /* this can only happen if j jumps over the end
+               * with a 2 in chains[i+j]
+               */
+              if (j > (255 / (8 / bpp)))
+                j -= 2;
 
-              /* then check for strings of equal bytes */
-              for (i = 0; i < breite; i += j)
+              /* 00 01 and 00 02 are reserved */
+              if (j > 2)
                 {
-                  j = 0;
+                  n = j * (8 / bpp);
+                  if (n + i * (8 / bpp) > width)
+                    n--;
 
-                  while ((i + j < breite) &&
-                         (j < (255 / (8 / bpp))) &&
-                         (row[i + j] == row[i]))
-                    j++;
+                  if (EOF == putc (0, f) || EOF == putc (n, f))
+                    return FALSE;
 
-                  chains[i] = j;
-                }
+                  writer->length += 2;
 
-              /* then write the strings and the other pixels to the file */
-              for (i = 0; i < breite;)
-                {
-                  if (chains[i] < 3)
+                  if (fwrite (&row[i], 1, j, f) != j)
+                    return FALSE;
+
+                  writer->length += j;
+                  if ((j) % 2)
                     {
-                      /* strings of different pixels ... */
-
-                      j = 0;
-
-                      while ((i + j < breite) &&
-                             (j < (255 / (8 / bpp))) &&
-                             (chains[i + j] < 3))
-                        j += chains[i + j];
-
-                      /* this can only happen if j jumps over the end
-                       * with a 2 in chains[i+j]
-                       */
-                      if (j > (255 / (8 / bpp)))
-                        j -= 2;
-
-                      /* 00 01 and 00 02 are reserved */
-                      if (j > 2)
-                        {
-                          n = j * (8 / bpp);
-                          if (n + i * (8 / bpp) > width)
-                            n--;
-
-                          if (EOF == putc (0, f) || EOF == putc (n, f))
-                            goto abort;
-
-                          length += 2;
-
-                          if (fwrite (&row[i], 1, j, f) != j)
-                            goto abort;
-
-                          length += j;
-                          if ((j) % 2)
-                            {
-                              if (EOF == putc (0, f))
-                                goto abort;
-                              length++;
-                            }
-                        }
-                      else
-                        {
-                          for (k = i; k < i + j; k++)
-                            {
-                              n = (8 / bpp);
-                              if (n + i * (8 / bpp) > width)
-                                n--;
-
-                              if (EOF == putc (n, f) || EOF == putc (row[k], f))
-                                goto abort;
-                              length += 2;
-                            }
-                        }
-
-                      i += j;
+                      if (EOF == putc (0, f))
+                        return FALSE;
+                      writer->length++;
                     }
-                  else
+                }
+              else
+                {
+                  for (k = i; k < i + j; k++)
                     {
-                      /* strings of equal pixels */
-
-                      n = chains[i] * (8 / bpp);
+                      n = (8 / bpp);
                       if (n + i * (8 / bpp) > width)
                         n--;
 
-                      if (EOF == putc (n, f) || EOF == putc (row[i], f))
-                        goto abort;
-
-                      i += chains[i];
-                      length += 2;
+                      if (EOF == putc (n, f) || EOF == putc (row[k], f))
+                        return FALSE;
+                      writer->length += 2;
                     }
                 }
 
-              if (EOF == putc (0, f) || EOF == putc (0, f))  /* End of row */
-                goto abort;
-              length += 2;
-
-              cur_progress++;
-              if ((cur_progress % 5) == 0)
-                gimp_progress_update ((gdouble) cur_progress /
-                                      (gdouble) max_progress);
+              i += j;
             }
+          else
+            {
+              /* strings of equal pixels */
+
+              n = chains[i] * (8 / bpp);
+              if (n + i * (8 / bpp) > width)
+                n--;
 
-          if (fseek (f, -2, SEEK_CUR))                  /* Overwrite last End of row ... */
-            goto abort;
-          if (EOF == putc (0, f) || EOF == putc (1, f))   /* ... with End of file */
-            goto abort;
-
-          if (fseek (f, 0x22, SEEK_SET))                /* Write length of image */
-            goto abort;
-          uint32buf = GUINT32_TO_LE (length);
-          if (fwrite (&uint32buf, 4, 1, f) != 1)
-            goto abort;
-
-          if (fseek (f, 0x02, SEEK_SET))                /* Write length of file */
-            goto abort;
-          length += (0x36 + MapSize + mask_info_size + color_space_size);
-          uint32buf = GUINT32_TO_LE (length);
-          if (fwrite (&uint32buf, 4, 1, f) != 1)
-            goto abort;
-
-          g_free (chains);
-          g_free (row);
+              if (EOF == putc (n, f) || EOF == putc (row[i], f))
+                return FALSE;
+
+              i += chains[i];
+              writer->length += 2;
+            }
         }
+
+      if (EOF == putc (0, f) || EOF == putc (0, f))  /* End of row */
+        return FALSE;
+      writer->length += 2;
     }
 
-  gimp_progress_update (1.0);
   return TRUE;
-
-abort:
-  g_free (chains);
-  g_free (row);
-
-  return FALSE;
 }
 
 static gboolean
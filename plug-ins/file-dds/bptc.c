@@ -0,0 +1,673 @@
+/*
+ * DDS GIMP plugin
+ *
+ * Copyright (C) 2004-2012 Shawn Kirst <skirst@gmail.com>,
+ * with parts (C) 2003 Arne Reuter <homepage@arnereuter.de> where specified.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * BC6H and BC7 (BPTC) block encoders.
+ *
+ * Only the single subset modes are used: mode 11 for BC6H, and modes 6
+ * and 5 for BC7.  Endpoints are found along the principal axis of the
+ * block and refined by least squares, in the same way as the BC1-BC3
+ * encoder in dxt.c does it.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <float.h>
+#include <math.h>
+#include <glib.h>
+
+#include "bptc.h"
+#include "dxt.h"
+#include "vec.h"
+
+#define SWAP(a, b)  do { typeof(a) t; t = a; a = b; b = t; } while(0)
+
+/* SIMD constants */
+static const vec4_t V4ZERO   = VEC4_CONST1(0.0f);
+static const vec4_t V4ONE    = VEC4_CONST1(1.0f);
+static const vec4_t V4HALF   = VEC4_CONST1(0.5f);
+static const vec4_t V4RGB    = VEC4_CONST3(1.0f, 1.0f, 1.0f);
+static const vec4_t V4ALPHA  = VEC4_CONST4(0.0f, 0.0f, 0.0f, 1.0f);
+
+/* interpolation weights for 2 and 4 bit indices */
+static const int weights2[4]  = { 0, 21, 43, 64 };
+static const int weights4[16] = { 0,  4,  9, 13, 17, 21, 26, 30,
+                                 34, 38, 43, 47, 51, 55, 60, 64 };
+
+typedef struct
+{
+  vec4_t points[16];
+  vec4_t metric;
+  int    iterations;
+  int    flags;
+} bptcblock_t;
+
+typedef struct
+{
+  unsigned char data[16];
+  int           pos;
+} bitwriter_t;
+
+static void
+put_bits (bitwriter_t  *bw,
+          unsigned int  value,
+          int           count)
+{
+  int i;
+
+  for (i = 0; i < count; ++i, ++bw->pos)
+    {
+      if (value & (1 << i))
+        bw->data[bw->pos >> 3] |= 1 << (bw->pos & 7);
+    }
+}
+
+static void
+bptcblock_init (bptcblock_t *b,
+                int          flags)
+{
+  b->flags = flags;
+
+  if (flags & DXT_FAST)
+    b->iterations = 0;
+  else if (flags & DXT_HIGH)
+    b->iterations = 4;
+  else
+    b->iterations = 2;
+}
+
+/*
+ * Find the principal axis of the masked channels by power iteration,
+ * and return the extent of the points along it.
+ */
+static void
+fit_line (const vec4_t *points,
+          const vec4_t  mask,
+          float         limit,
+          vec4_t       *start,
+          vec4_t       *end)
+{
+  vec4_t mean, min, max, axis, t;
+  vec4_t cov[4];
+  float tmin = FLT_MAX, tmax = -FLT_MAX, d;
+  int i;
+
+  mean = vec4_zero();
+  min = vec4_set1(FLT_MAX);
+  max = vec4_set1(-FLT_MAX);
+  for (i = 0; i < 16; ++i)
+    {
+      mean += points[i];
+      min = vec4_min(min, points[i]);
+      max = vec4_max(max, points[i]);
+    }
+  mean = mean * vec4_set1(1.0f / 16.0f) * mask;
+
+  cov[0] = cov[1] = cov[2] = cov[3] = vec4_zero();
+  for (i = 0; i < 16; ++i)
+    {
+      t = (points[i] * mask) - mean;
+      cov[0] += t * vec4_splatx(t);
+      cov[1] += t * vec4_splaty(t);
+      cov[2] += t * vec4_splatz(t);
+      cov[3] += t * vec4_splatw(t);
+    }
+
+  // start from the bounding box diagonal
+  axis = (max - min) * mask;
+  for (i = 0; i < 8; ++i)
+    {
+      t = cov[0] * vec4_splatx(axis) + cov[1] * vec4_splaty(axis) +
+          cov[2] * vec4_splatz(axis) + cov[3] * vec4_splatw(axis);
+      d = vec4_dot(t, t);
+      if (d < 1e-12f)
+        break;
+      axis = t * vec4_set1(1.0f / sqrtf(d));
+    }
+
+  if (i == 0)
+    {
+      *start = *end = mean;
+      return;
+    }
+
+  for (i = 0; i < 16; ++i)
+    {
+      d = vec4_dot((points[i] * mask) - mean, axis);
+      tmin = MIN(tmin, d);
+      tmax = MAX(tmax, d);
+    }
+
+  *start = vec4_min(vec4_set1(limit), vec4_max(V4ZERO, mean + axis * vec4_set1(tmin)));
+  *end   = vec4_min(vec4_set1(limit), vec4_max(V4ZERO, mean + axis * vec4_set1(tmax)));
+}
+
+/*
+ * Least squares fit of the endpoints to the points, given the indices.
+ * Based on optimize_endpoints4 in dxt.c.
+ */
+static void
+refine_line (const vec4_t        *points,
+             const unsigned char *indices,
+             const int           *weights,
+             float                limit,
+             vec4_t              *start,
+             vec4_t              *end)
+{
+  float alpha, beta, factor;
+  float alpha2_sum = 0, beta2_sum = 0, alphabeta_sum = 0;
+  vec4_t alphax_sum, betax_sum, a, b;
+  int i;
+
+  alphax_sum = betax_sum = vec4_zero();
+
+  for (i = 0; i < 16; ++i)
+    {
+      beta = (float)weights[indices[i]] / 64.0f;
+      alpha = 1.0f - beta;
+
+      alpha2_sum += alpha * alpha;
+      beta2_sum += beta * beta;
+      alphabeta_sum += alpha * beta;
+      alphax_sum += points[i] * vec4_set1(alpha);
+      betax_sum  += points[i] * vec4_set1(beta);
+    }
+
+  factor = alpha2_sum * beta2_sum - alphabeta_sum * alphabeta_sum;
+  if (factor < 1e-4f)
+    return;
+  factor = 1.0f / factor;
+
+  a = (alphax_sum * vec4_set1(beta2_sum) - betax_sum * vec4_set1(alphabeta_sum)) *
+      vec4_set1(factor);
+  b = (betax_sum * vec4_set1(alpha2_sum) - alphax_sum * vec4_set1(alphabeta_sum)) *
+      vec4_set1(factor);
+
+  *start = vec4_min(vec4_set1(limit), vec4_max(V4ZERO, a));
+  *end   = vec4_min(vec4_set1(limit), vec4_max(V4ZERO, b));
+}
+
+/* interpolate as the decoder does, with integer rounding */
+static void
+build_palette (const vec4_t  e0,
+               const vec4_t  e1,
+               const int    *weights,
+               int           count,
+               vec4_t       *palette)
+{
+  int i;
+
+  for (i = 0; i < count; ++i)
+    palette[i] = vec4_trunc((e0 * vec4_set1(64 - weights[i]) +
+                             e1 * vec4_set1(weights[i]) + vec4_set1(32.0f)) *
+                            vec4_set1(1.0f / 64.0f));
+}
+
+/*
+ * Pick the closest palette entry for each point.  The palette lies on a
+ * line, so only the entries around the projection of the point are tried.
+ */
+static float
+match_indices (const vec4_t  *points,
+               const vec4_t  *palette,
+               int            count,
+               const vec4_t   metric,
+               unsigned char *indices)
+{
+  vec4_t dir, t;
+  float len2, d, best, error = 0;
+  int i, k, first, last;
+
+  dir = (palette[count - 1] - palette[0]) * metric;
+  len2 = vec4_dot(dir, dir);
+  if (len2 > 0.0f)
+    len2 = (float)(count - 1) / len2;
+
+  for (i = 0; i < 16; ++i)
+    {
+      d = vec4_dot((points[i] - palette[0]) * metric, dir) * len2;
+      k = (int)(d + 0.5f);
+      first = CLAMP(k - 1, 0, count - 1);
+      last  = CLAMP(k + 1, 0, count - 1);
+
+      best = FLT_MAX;
+      for (k = first; k <= last; ++k)
+        {
+          t = (points[i] - palette[k]) * metric;
+          d = vec4_dot(t, t);
+          if (d < best)
+            {
+              best = d;
+              indices[i] = k;
+            }
+        }
+
+      error += best;
+    }
+
+  return error;
+}
+
+/*
+ * BC7 mode 6: one subset, RGBA endpoints of 7 bits and a p-bit each,
+ * 4 bit indices.
+ */
+static void
+quantize_mode6 (const vec4_t  v,
+                int           pbit,
+                vec4_t       *c,
+                vec4_t       *e)
+{
+  vec4_t p = vec4_set1((float)pbit);
+
+  *c = vec4_min(vec4_set1(127.0f),
+                vec4_max(V4ZERO, vec4_trunc((v - p) * V4HALF + V4HALF)));
+  *e = *c + *c + p;
+}
+
+static int
+select_pbit (const vec4_t v,
+             const vec4_t metric)
+{
+  vec4_t c, e0, e1, t0, t1;
+
+  quantize_mode6(v, 0, &c, &e0);
+  quantize_mode6(v, 1, &c, &e1);
+  t0 = (v - e0) * metric;
+  t1 = (v - e1) * metric;
+
+  return vec4_dot(t1, t1) < vec4_dot(t0, t0);
+}
+
+static float
+encode_bc7_mode6 (const bptcblock_t *b,
+                  unsigned char     *dst)
+{
+  vec4_t start, end, c0, c1, e0, e1, best_c0, best_c1;
+  vec4_t palette[16];
+  unsigned char indices[16], best_indices[16];
+  float error, best_error = FLT_MAX;
+  int p0, p1, best_p0 = 0, best_p1 = 0;
+  int pbit0, pbit1;
+  int i, iter, combo;
+  bitwriter_t bw;
+
+  best_c0 = best_c1 = vec4_zero();
+
+  fit_line(b->points, V4ONE, 255.0f, &start, &end);
+
+  for (iter = 0; ; ++iter)
+    {
+      pbit0 = select_pbit(start, b->metric);
+      pbit1 = select_pbit(end,   b->metric);
+
+      for (combo = 0; combo < 4; ++combo)
+        {
+          p0 = combo & 1;
+          p1 = combo >> 1;
+
+          /* unless asked for the best quality, only try the p-bits
+           * closest to each endpoint
+           */
+          if (! (b->flags & DXT_HIGH) &&
+              ((p0 != pbit0) || (p1 != pbit1)))
+            continue;
+
+          quantize_mode6(start, p0, &c0, &e0);
+          quantize_mode6(end,   p1, &c1, &e1);
+          build_palette(e0, e1, weights4, 16, palette);
+          error = match_indices(b->points, palette, 16, b->metric, indices);
+
+          if (error < best_error)
+            {
+              best_error = error;
+              best_c0 = c0;
+              best_c1 = c1;
+              best_p0 = p0;
+              best_p1 = p1;
+              memcpy(best_indices, indices, 16);
+            }
+        }
+
+      if (iter == b->iterations || best_error == 0.0f)
+        break;
+
+      refine_line(b->points, best_indices, weights4, 255.0f, &start, &end);
+    }
+
+  // the anchor index has an implicit high bit of zero
+  if (best_indices[0] & 8)
+    {
+      SWAP(best_c0, best_c1);
+      SWAP(best_p0, best_p1);
+      for (i = 0; i < 16; ++i)
+        best_indices[i] = 15 - best_indices[i];
+    }
+
+  memset(&bw, 0, sizeof(bw));
+  put_bits(&bw, 1 << 6, 7);
+  for (i = 0; i < 4; ++i)
+    {
+      put_bits(&bw, (unsigned int)best_c0[i], 7);
+      put_bits(&bw, (unsigned int)best_c1[i], 7);
+    }
+  put_bits(&bw, best_p0, 1);
+  put_bits(&bw, best_p1, 1);
+  put_bits(&bw, best_indices[0], 3);
+  for (i = 1; i < 16; ++i)
+    put_bits(&bw, best_indices[i], 4);
+
+  memcpy(dst, bw.data, 16);
+
+  return best_error;
+}
+
+/*
+ * BC7 mode 5: one subset, RGB endpoints of 7 bits and alpha endpoints of
+ * 8 bits, with separate 2 bit indices for color and alpha.  The rotation
+ * swaps alpha with one of the color channels.
+ */
+static vec4_t
+rotate_channels (const vec4_t v,
+                 int          rotation)
+{
+  vec4_t r = v;
+
+  if (rotation > 0)
+    {
+      r[rotation - 1] = v[3];
+      r[3] = v[rotation - 1];
+    }
+
+  return r;
+}
+
+static void
+quantize_mode5 (const vec4_t  v,
+                vec4_t       *c,
+                vec4_t       *e)
+{
+  const vec4_t scale = VEC4_CONST4(127.0f / 255.0f, 127.0f / 255.0f,
+                                   127.0f / 255.0f, 1.0f);
+  const vec4_t limit = VEC4_CONST4(127.0f, 127.0f, 127.0f, 255.0f);
+  const vec4_t shift = VEC4_CONST3(1.0f / 64.0f, 1.0f / 64.0f, 1.0f / 64.0f);
+
+  *c = vec4_min(limit, vec4_max(V4ZERO, vec4_trunc(v * scale + V4HALF)));
+  // replicate the high bit of the 7 bit colors
+  *e = *c * V4RGB + *c + vec4_trunc(*c * shift);
+}
+
+static float
+encode_bc7_mode5 (const bptcblock_t *b,
+                  int                rotation,
+                  unsigned char     *dst)
+{
+  vec4_t points[16], palette[4];
+  vec4_t metric, color_metric, alpha_metric;
+  vec4_t start, end, cstart, cend, astart, aend;
+  vec4_t c0, c1, e0, e1, best_c0, best_c1;
+  unsigned char cindices[16], aindices[16];
+  unsigned char best_cindices[16], best_aindices[16];
+  float error, best_error = FLT_MAX;
+  float amin = 255.0f, amax = 0.0f;
+  int i, iter;
+  bitwriter_t bw;
+
+  best_c0 = best_c1 = vec4_zero();
+
+  for (i = 0; i < 16; ++i)
+    {
+      points[i] = rotate_channels(b->points[i], rotation);
+      amin = MIN(amin, points[i][3]);
+      amax = MAX(amax, points[i][3]);
+    }
+
+  metric = rotate_channels(b->metric, rotation);
+  color_metric = metric * V4RGB;
+  alpha_metric = metric * V4ALPHA;
+
+  fit_line(points, V4RGB, 255.0f, &start, &end);
+  start[3] = amin;
+  end[3] = amax;
+
+  for (iter = 0; ; ++iter)
+    {
+      quantize_mode5(start, &c0, &e0);
+      quantize_mode5(end,   &c1, &e1);
+      build_palette(e0, e1, weights2, 4, palette);
+      error = match_indices(points, palette, 4, color_metric, cindices) +
+              match_indices(points, palette, 4, alpha_metric, aindices);
+
+      if (error < best_error)
+        {
+          best_error = error;
+          best_c0 = c0;
+          best_c1 = c1;
+          memcpy(best_cindices, cindices, 16);
+          memcpy(best_aindices, aindices, 16);
+        }
+
+      if (iter == b->iterations || best_error == 0.0f)
+        break;
+
+      cstart = astart = start;
+      cend = aend = end;
+      refine_line(points, best_cindices, weights2, 255.0f, &cstart, &cend);
+      refine_line(points, best_aindices, weights2, 255.0f, &astart, &aend);
+      start = cstart * V4RGB + astart * V4ALPHA;
+      end   = cend   * V4RGB + aend   * V4ALPHA;
+    }
+
+  // the anchor indices have an implicit high bit of zero
+  if (best_cindices[0] & 2)
+    {
+      c0 = best_c1 * V4RGB + best_c0 * V4ALPHA;
+      c1 = best_c0 * V4RGB + best_c1 * V4ALPHA;
+      best_c0 = c0;
+      best_c1 = c1;
+      for (i = 0; i < 16; ++i)
+        best_cindices[i] = 3 - best_cindices[i];
+    }
+  if (best_aindices[0] & 2)
+    {
+      c0 = best_c0 * V4RGB + best_c1 * V4ALPHA;
+      c1 = best_c1 * V4RGB + best_c0 * V4ALPHA;
+      best_c0 = c0;
+      best_c1 = c1;
+      for (i = 0; i < 16; ++i)
+        best_aindices[i] = 3 - best_aindices[i];
+    }
+
+  memset(&bw, 0, sizeof(bw));
+  put_bits(&bw, 1 << 5, 6);
+  put_bits(&bw, rotation, 2);
+  for (i = 0; i < 3; ++i)
+    {
+      put_bits(&bw, (unsigned int)best_c0[i], 7);
+      put_bits(&bw, (unsigned int)best_c1[i], 7);
+    }
+  put_bits(&bw, (unsigned int)best_c0[3], 8);
+  put_bits(&bw, (unsigned int)best_c1[3], 8);
+  put_bits(&bw, best_cindices[0], 1);
+  for (i = 1; i < 16; ++i)
+    put_bits(&bw, best_cindices[i], 2);
+  put_bits(&bw, best_aindices[0], 1);
+  for (i = 1; i < 16; ++i)
+    put_bits(&bw, best_aindices[i], 2);
+
+  memcpy(dst, bw.data, 16);
+
+  return best_error;
+}
+
+/* encode a 4x4 BGRA block */
+void
+encode_bc7_block (unsigned char       *dst,
+                  const unsigned char *block,
+                  int                  flags)
+{
+  bptcblock_t b;
+  unsigned char trial[16];
+  float error, best_error;
+  int i, rotations;
+
+  bptcblock_init(&b, flags);
+
+  for (i = 0; i < 16; ++i)
+    b.points[i] = vec4_set(block[4 * i + 2], block[4 * i + 1],
+                           block[4 * i + 0], block[4 * i + 3]);
+
+  if (flags & DXT_PERCEPTUAL)
+    /* ITU-R BT.709 luma coefficients, relative to green */
+    b.metric = vec4_set(0.2973f, 1.0f, 0.1010f, 1.0f);
+  else
+    b.metric = V4ONE;
+
+  best_error = encode_bc7_mode6(&b, dst);
+
+  if (flags & DXT_FAST)
+    return;
+
+  rotations = (flags & DXT_HIGH) ? 4 : 1;
+  for (i = 0; i < rotations && best_error > 0.0f; ++i)
+    {
+      error = encode_bc7_mode5(&b, i, trial);
+      if (error < best_error)
+        {
+          best_error = error;
+          memcpy(dst, trial, 16);
+        }
+    }
+}
+
+/*
+ * BC6H mode 11: one subset, unsigned RGB endpoints of 10 bits, 4 bit
+ * indices.  The encoder works on the unquantized 16 bit scale of the
+ * decoder, where half floats are stored as 31/64th of their value.
+ */
+static float
+unquantize_bc6h (int q)
+{
+  if (q == 0)
+    return 0.0f;
+  else if (q == 1023)
+    return 65535.0f;
+
+  return (float)(q * 64 + 32);
+}
+
+static void
+quantize_bc6h (const vec4_t  v,
+               int          *q,
+               vec4_t       *e)
+{
+  int i;
+
+  *e = vec4_zero();
+  for (i = 0; i < 3; ++i)
+    {
+      q[i] = CLAMP((int)((v[i] - 32.0f) / 64.0f + 0.5f), 0, 1023);
+      (*e)[i] = unquantize_bc6h(q[i]);
+    }
+}
+
+/* encode a 4x4 block of RGB half floats */
+void
+encode_bc6h_block (unsigned char        *dst,
+                   const unsigned short *block,
+                   int                   flags)
+{
+  bptcblock_t b;
+  vec4_t start, end, e0, e1;
+  vec4_t palette[16];
+  unsigned char indices[16], best_indices[16];
+  float error, best_error = FLT_MAX;
+  int q0[3], q1[3], best_q0[3] = { 0 }, best_q1[3] = { 0 };
+  int i, c, h, iter;
+  bitwriter_t bw;
+
+  bptcblock_init(&b, flags);
+
+  for (i = 0; i < 16; ++i)
+    {
+      b.points[i] = vec4_zero();
+      for (c = 0; c < 3; ++c)
+        {
+          h = block[3 * i + c];
+          // negative values are clamped to zero, infinities and NaNs
+          // to the largest finite half
+          if (h & 0x8000)
+            h = 0;
+          else if (h > 0x7bff)
+            h = 0x7bff;
+          b.points[i][c] = (float)h * (64.0f / 31.0f);
+        }
+    }
+
+  if (flags & DXT_PERCEPTUAL)
+    /* ITU-R BT.709 luma coefficients */
+    b.metric = vec4_set(0.2126f, 0.7152f, 0.0722f, 0.0f);
+  else
+    b.metric = V4RGB;
+
+  fit_line(b.points, V4RGB, 65535.0f, &start, &end);
+
+  for (iter = 0; ; ++iter)
+    {
+      quantize_bc6h(start, q0, &e0);
+      quantize_bc6h(end,   q1, &e1);
+      build_palette(e0, e1, weights4, 16, palette);
+      error = match_indices(b.points, palette, 16, b.metric, indices);
+
+      if (error < best_error)
+        {
+          best_error = error;
+          memcpy(best_q0, q0, sizeof(q0));
+          memcpy(best_q1, q1, sizeof(q1));
+          memcpy(best_indices, indices, 16);
+        }
+
+      if (iter == b.iterations || best_error == 0.0f)
+        break;
+
+      refine_line(b.points, best_indices, weights4, 65535.0f, &start, &end);
+    }
+
+  // the anchor index has an implicit high bit of zero
+  if (best_indices[0] & 8)
+    {
+      for (c = 0; c < 3; ++c)
+        SWAP(best_q0[c], best_q1[c]);
+      for (i = 0; i < 16; ++i)
+        best_indices[i] = 15 - best_indices[i];
+    }
+
+  memset(&bw, 0, sizeof(bw));
+  put_bits(&bw, 0x03, 5);
+  for (c = 0; c < 3; ++c)
+    put_bits(&bw, best_q0[c], 10);
+  for (c = 0; c < 3; ++c)
+    put_bits(&bw, best_q1[c], 10);
+  put_bits(&bw, best_indices[0], 3);
+  for (i = 1; i < 16; ++i)
+    put_bits(&bw, best_indices[i], 4);
+
+  memcpy(dst, bw.data, 16);
+}
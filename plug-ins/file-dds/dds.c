@@ -206,6 +206,8 @@ dds_create_procedure (GimpPlugIn  *plug_in,
                                                                        "aexp",   DDS_COMPRESS_AEXP,   _("Alpha Exponent (DXT5)"), NULL,
                                                                       "ycocg",  DDS_COMPRESS_YCOCG,  _("YCoCg (DXT5)"),          NULL,
                                                                        "ycocgs", DDS_COMPRESS_YCOCGS, _("YCoCg scaled (DXT5)"),   NULL,
+                                                                       "bc6h",   DDS_COMPRESS_BC6H,   _("BC6H (HDR)"),            NULL,
+                                                                       "bc7",    DDS_COMPRESS_BC7,    _("BC7"),                   NULL,
                                                                        NULL),
                                           "none",
                                           G_PARAM_READWRITE);
@@ -338,6 +340,16 @@ dds_create_procedure (GimpPlugIn  *plug_in,
                                             "coverage should be preserved"),
                                           0.0, 1.0, 0.5,
                                           G_PARAM_READWRITE);
+
+      gimp_procedure_add_choice_argument (procedure, "compression-quality",
+                                          _("_Quality"),
+                                          _("Trade compression speed for quality"),
+                                          gimp_choice_new_with_values ("fast",   DDS_QUALITY_FAST,   _("Fast"),   NULL,
+                                                                       "normal", DDS_QUALITY_NORMAL, _("Normal"), NULL,
+                                                                       "high",   DDS_QUALITY_HIGH,   _("High"),   NULL,
+                                                                       NULL),
+                                          "normal",
+                                          G_PARAM_READWRITE);
     }
 
   return procedure;
@@ -52,9 +52,19 @@ typedef enum
   DDS_COMPRESS_AEXP,       /* DXT5  */
   DDS_COMPRESS_YCOCG,      /* DXT5  */
   DDS_COMPRESS_YCOCGS,     /* DXT5  */
+  DDS_COMPRESS_BC6H,       /* DX10  */
+  DDS_COMPRESS_BC7,        /* DX10  */
   DDS_COMPRESS_MAX
 } DDS_COMPRESSION_TYPE;
 
+typedef enum
+{
+  DDS_QUALITY_FAST = 0,
+  DDS_QUALITY_NORMAL,
+  DDS_QUALITY_HIGH,
+  DDS_QUALITY_MAX
+} DDS_COMPRESSION_QUALITY;
+
 typedef enum
 {
   DDS_SAVE_SELECTED_LAYER = 0,
@@ -767,6 +767,8 @@ get_mipmap_chain (guchar       *dst,
     format = babl_format ("Y'A u8");
   else if (bpp == 3)
     format = babl_format ("R'G'B' u8");
+  else if (bpp == 6)
+    format = babl_format ("RGB half");
   else
     format = babl_format ("R'G'B'A u8");
 
@@ -805,7 +807,7 @@ get_mipmap_chain (guchar       *dst,
       g_object_unref (buffer);
 
       /* BGRX or BGRA needed */
-      if (bpp >= 3)
+      if (bpp == 3 || bpp == 4)
         swap_rb (dst + offset, mipw * miph, bpp);
 
       offset += (mipw * miph * bpp);
@@ -814,6 +816,74 @@ get_mipmap_chain (guchar       *dst,
     }
 }
 
+/* BC6H compresses linear RGB half floats, whatever the image precision */
+static void
+write_layer_bc6h (FILE         *fp,
+                  GimpImage    *image,
+                  GimpDrawable *drawable,
+                  gint          w,
+                  gint          h,
+                  gint          mipmaps,
+                  gint          num_mipmaps,
+                  gint          flags)
+{
+  GeglBuffer *buffer;
+  const Babl *format = babl_format ("RGB half");
+  guchar     *src;
+  guchar     *dst;
+  gint        size;
+  gint        offset;
+  gint        mipw, miph;
+  gint        i;
+
+  buffer = gimp_drawable_get_buffer (drawable);
+
+  size = get_mipmapped_size (w, h, 6, 0, num_mipmaps, DDS_COMPRESS_NONE);
+  src = g_malloc (size);
+
+  gegl_buffer_get (buffer, GEGL_RECTANGLE (0, 0, w, h), 1.0, format, src,
+                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+  if (num_mipmaps > 1)
+    {
+      if (mipmaps == DDS_MIPMAP_GENERATE)
+        {
+          /* The 8-bit mipmap filters do not apply here, let GEGL
+           * downscale the layer for each level instead.
+           */
+          offset = w * h * 6;
+
+          for (i = 1; i < num_mipmaps; ++i)
+            {
+              mipw = MAX (1, w >> i);
+              miph = MAX (1, h >> i);
+
+              gegl_buffer_get (buffer, GEGL_RECTANGLE (0, 0, mipw, miph),
+                               1.0 / (1 << i), format, src + offset,
+                               GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_CLAMP);
+
+              offset += mipw * miph * 6;
+            }
+        }
+      else
+        {
+          get_mipmap_chain (src + (w * h * 6), w, h, 6, image, drawable);
+        }
+    }
+
+  size = get_mipmapped_size (w, h, 0, 0, num_mipmaps, DDS_COMPRESS_BC6H);
+  dst = g_malloc (size);
+
+  dxt_compress (dst, src, DDS_COMPRESS_BC6H, w, h, 6, num_mipmaps, flags);
+
+  fwrite (dst, 1, size, fp);
+
+  g_free (dst);
+  g_free (src);
+
+  g_object_unref (buffer);
+}
+
 static void
 write_layer (FILE                *fp,
              GimpImage           *image,
@@ -843,6 +913,7 @@ write_layer (FILE                *fp,
   gint               compression;
   gint               mipmaps;
   gint               pixel_format;
+  gint               quality;
   gboolean           perceptual_metric;
   gint               flags   = 0;
 
@@ -852,6 +923,22 @@ write_layer (FILE                *fp,
   compression  = gimp_procedure_config_get_choice_id (config, "compression-format");
   pixel_format = gimp_procedure_config_get_choice_id (config, "format");
   mipmaps      = gimp_procedure_config_get_choice_id (config, "mipmaps");
+  quality      = gimp_procedure_config_get_choice_id (config, "compression-quality");
+
+  if (perceptual_metric)
+    flags |= DXT_PERCEPTUAL;
+
+  if (quality == DDS_QUALITY_FAST)
+    flags |= DXT_FAST;
+  else if (quality == DDS_QUALITY_HIGH)
+    flags |= DXT_HIGH;
+
+  if (compression == DDS_COMPRESS_BC6H)
+    {
+      write_layer_bc6h (fp, image, drawable, w, h, mipmaps, num_mipmaps,
+                        flags);
+      return;
+    }
 
   basetype = gimp_image_get_base_type (image);
   type = gimp_drawable_type (drawable);
@@ -1127,10 +1214,6 @@ write_layer (FILE                *fp,
           src = fmtdst;
         }
 
-      flags = 0;
-      if (perceptual_metric)
-        flags |= DXT_PERCEPTUAL;
-
       dxt_compress (dst, src, compression, w, h, bpp, num_mipmaps, flags);
 
       fwrite (dst, 1, size, fp);
@@ -1577,6 +1660,17 @@ write_image (FILE                *fp,
           dxgi_format = DXGI_FORMAT_BC5_UNORM;
           /*is_dx10 = TRUE;*/
           break;
+
+        /* BPTC formats have no FourCC of their own */
+        case DDS_COMPRESS_BC6H:
+          dxgi_format = DXGI_FORMAT_BC6H_UF16;
+          is_dx10 = TRUE;
+          break;
+
+        case DDS_COMPRESS_BC7:
+          dxgi_format = DXGI_FORMAT_BC7_UNORM;
+          is_dx10 = TRUE;
+          break;
         }
 
       if ((compression == DDS_COMPRESS_BC3N) ||
@@ -1744,6 +1838,11 @@ config_notify (GimpProcedureConfig *config,
                                            "perceptual-metric",
                                            compression != DDS_COMPRESS_NONE,
                                            NULL, NULL, FALSE);
+
+      gimp_procedure_dialog_set_sensitive (GIMP_PROCEDURE_DIALOG (dialog),
+                                           "compression-quality",
+                                           compression != DDS_COMPRESS_NONE,
+                                           NULL, NULL, FALSE);
     }
   else if (! strcmp (pspec->name, "save-type"))
     {
@@ -1969,7 +2068,8 @@ save_dialog (GimpImage           *image,
                              ! (is_volume || is_cubemap) && is_mipmap_chain_valid);
 
   gimp_procedure_dialog_fill (GIMP_PROCEDURE_DIALOG (dialog),
-                              "compression-format", "perceptual-metric",
+                              "compression-format", "compression-quality",
+                              "perceptual-metric",
                               "format", "save-type", "flip-image",
                               "mipmaps", "transparency-frame",
                               "mipmap-options-frame", NULL);
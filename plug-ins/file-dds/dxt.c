@@ -36,6 +36,7 @@
 
 #include <libgimp/gimp.h>
 
+#include "bptc.h"
 #include "dds.h"
 #include "dxt.h"
 #include "endian_rw.h"
@@ -616,10 +617,91 @@ compute_error4 (dxtblock_t   *dxtb,
   return error;
 }
 
+/*
+ * Try moving each endpoint channel by one step on the 565 grid, and keep
+ * the moves that lower the error.
+ */
 static unsigned int
-compress3 (dxtblock_t *dxtb)
+search_endpoints (dxtblock_t   *dxtb,
+                  int           three,
+                  unsigned int  indices)
 {
-  const int MAX_ITERATIONS = 8;
+  const int MAX_PASSES = 4;
+  const vec4_t steps[3] =
+  {
+    VEC4_CONST3(1.0f / 31.0f, 0.0f, 0.0f),
+    VEC4_CONST3(0.0f, 1.0f / 63.0f, 0.0f),
+    VEC4_CONST3(0.0f, 0.0f, 1.0f / 31.0f)
+  };
+  vec4_t *endpoint, old;
+  unsigned int trial;
+  float error, besterror;
+  int pass, e, c, s, improved = 1;
+
+  if (three)
+    {
+      construct_palette3(dxtb);
+      besterror = compute_error3(dxtb, indices);
+    }
+  else
+    {
+      construct_palette4(dxtb);
+      besterror = compute_error4(dxtb, indices);
+    }
+
+  for (pass = 0; pass < MAX_PASSES && improved; ++pass)
+    {
+      improved = 0;
+
+      for (e = 0; e < 2; ++e)
+        {
+          endpoint = e ? &dxtb->min : &dxtb->max;
+
+          for (c = 0; c < 3; ++c)
+            {
+              for (s = -1; s <= 1; s += 2)
+                {
+                  old = *endpoint;
+                  *endpoint = old + steps[c] * vec4_set1((float)s);
+                  *endpoint = vec4_min(V4ONE, vec4_max(V4ZERO, *endpoint));
+                  *endpoint = vec4_trunc(V4GRID * *endpoint + V4HALF) * V4GRIDRCP;
+
+                  if (three)
+                    {
+                      construct_palette3(dxtb);
+                      trial = match_colors3(dxtb);
+                      error = compute_error3(dxtb, trial);
+                    }
+                  else
+                    {
+                      construct_palette4(dxtb);
+                      trial = match_colors4(dxtb);
+                      error = compute_error4(dxtb, trial);
+                    }
+
+                  if (error < besterror)
+                    {
+                      besterror = error;
+                      indices = trial;
+                      improved = 1;
+                    }
+                  else
+                    {
+                      *endpoint = old;
+                    }
+                }
+            }
+        }
+    }
+
+  return indices;
+}
+
+static unsigned int
+compress3 (dxtblock_t *dxtb,
+           int         flags)
+{
+  const int MAX_ITERATIONS = (flags & DXT_FAST) ? 0 : 8;
   int i;
   unsigned int indices, bestindices;
   float error, besterror = FLT_MAX;
@@ -653,13 +735,17 @@ compress3 (dxtblock_t *dxtb)
         }
     }
 
+  if (flags & DXT_HIGH)
+    bestindices = search_endpoints(dxtb, 1, bestindices);
+
   return bestindices;
 }
 
 static unsigned int
-compress4 (dxtblock_t *dxtb)
+compress4 (dxtblock_t *dxtb,
+           int         flags)
 {
-  const int MAX_ITERATIONS = 8;
+  const int MAX_ITERATIONS = (flags & DXT_FAST) ? 0 : 8;
   int i;
   unsigned int indices, bestindices;
   float error, besterror = FLT_MAX;
@@ -693,6 +779,9 @@ compress4 (dxtblock_t *dxtb)
         }
     }
 
+  if (flags & DXT_HIGH)
+    bestindices = search_endpoints(dxtb, 0, bestindices);
+
   return bestindices;
 }
 
@@ -733,7 +822,7 @@ encode_color_block (unsigned char *dst,
     }
   else if ((flags & DXT_BC1) && dxtb.alphamask) // DXT1 compression, non-opaque block
     {
-      indices = compress3(&dxtb);
+      indices = compress3(&dxtb, flags);
 
       vec4_endpoints_to_565(&max16, &min16, dxtb.max, dxtb.min);
 
@@ -748,7 +837,7 @@ encode_color_block (unsigned char *dst,
     }
   else
     {
-      indices = compress4(&dxtb);
+      indices = compress4(&dxtb, flags);
 
       vec4_endpoints_to_565(&max16, &min16, dxtb.max, dxtb.min);
 
@@ -845,164 +934,88 @@ encode_alpha_block_BC3 (unsigned char       *dst,
     }
 }
 
-#define BLOCK_COUNT(w, h)          ((((h) + 3) >> 2) * (((w) + 3) >> 2))
-#define BLOCK_OFFSET(x, y, w, bs)  (((y) >> 2) * ((bs) * (((w) + 3) >> 2)) + ((bs) * ((x) >> 2)))
+#define BLOCK_COUNT(w, h)  ((((h) + 3) >> 2) * (((w) + 3) >> 2))
 
-static void
-compress_BC1 (unsigned char       *dst,
-              const unsigned char *src,
-              int                  w,
-              int                  h,
-              int                  flags)
+typedef struct
 {
-  const unsigned int block_count = BLOCK_COUNT(w, h);
-  unsigned int i;
-  unsigned char block[64], *p;
-  int x, y;
-
-#ifdef _OPENMP
-#pragma omp parallel for schedule(dynamic, 256) private(block, p, x, y)
-#endif
-  for (i = 0; i < block_count; ++i)
-    {
-      x = (i % ((w + 3) >> 2)) << 2;
-      y = (i / ((w + 3) >> 2)) << 2;
-      p = dst + BLOCK_OFFSET(x, y, w, 8);
-      extract_block(src, x, y, w, h, block);
-      encode_color_block(p, block, DXT_BC1 | flags);
-    }
-}
-
+  const unsigned char *src;
+  unsigned char       *dst;
+  int                  width;
+  int                  height;
+  unsigned int         first_block;
+} dxtlevel_t;
+
+/* extract 4x4 block of RGB half floats */
 static void
-compress_BC2 (unsigned char       *dst,
-              const unsigned char *src,
-              int                  w,
-              int                  h,
-              int                  flags)
+extract_block_half (const unsigned short *src,
+                    int                   x,
+                    int                   y,
+                    int                   w,
+                    int                   h,
+                    unsigned short       *block)
 {
-  const unsigned int block_count = BLOCK_COUNT(w, h);
-  unsigned int i;
-  unsigned char block[64], *p;
-  int x, y;
+  int i, j, bx, by;
 
-#ifdef _OPENMP
-#pragma omp parallel for schedule(dynamic, 256) private(block, p, x, y)
-#endif
-  for (i = 0; i < block_count; ++i)
+  /* repeat the last row and column for partial blocks */
+  for (i = 0; i < 4; ++i)
     {
-      x = (i % ((w + 3) >> 2)) << 2;
-      y = (i / ((w + 3) >> 2)) << 2;
-      p = dst + BLOCK_OFFSET(x, y, w, 16);
-      extract_block(src, x, y, w, h, block);
-      encode_alpha_block_BC2(p, block);
-      encode_color_block(p + 8, block, DXT_BC2 | flags);
+      by = MIN(y + i, h - 1);
+      for (j = 0; j < 4; ++j)
+        {
+          bx = MIN(x + j, w - 1);
+          memcpy(block + (i * 4 + j) * 3, src + (by * w + bx) * 3,
+                 3 * sizeof(unsigned short));
+        }
     }
 }
 
 static void
-compress_BC3 (unsigned char       *dst,
-              const unsigned char *src,
-              int                  w,
-              int                  h,
+encode_block (unsigned char       *p,
+              const unsigned char *block,
+              int                  format,
               int                  flags)
 {
-  const unsigned int block_count = BLOCK_COUNT(w, h);
-  unsigned int i;
-  unsigned char block[64], *p;
-  int x, y;
-
-#ifdef _OPENMP
-#pragma omp parallel for schedule(dynamic, 256) private(block, p, x, y)
-#endif
-  for (i = 0; i < block_count; ++i)
-    {
-      x = (i % ((w + 3) >> 2)) << 2;
-      y = (i / ((w + 3) >> 2)) << 2;
-      p = dst + BLOCK_OFFSET(x, y, w, 16);
-      extract_block(src, x, y, w, h, block);
-      encode_alpha_block_BC3(p, block, 0);
-      encode_color_block(p + 8, block, DXT_BC3 | flags);
-    }
-}
-
-static void
-compress_BC4 (unsigned char       *dst,
-              const unsigned char *src,
-              int                  w,
-              int                  h)
-{
-  const unsigned int block_count = BLOCK_COUNT(w, h);
-  unsigned int i;
-  unsigned char block[64], *p;
-  int x, y;
-
-#ifdef _OPENMP
-#pragma omp parallel for schedule(dynamic, 256) private(block, p, x, y)
-#endif
-  for (i = 0; i < block_count; ++i)
+  switch (format)
     {
-      x = (i % ((w + 3) >> 2)) << 2;
-      y = (i / ((w + 3) >> 2)) << 2;
-      p = dst + BLOCK_OFFSET(x, y, w, 8);
-      extract_block(src, x, y, w, h, block);
+    case DDS_COMPRESS_BC1:
+      encode_color_block(p, (unsigned char *)block, DXT_BC1 | flags);
+      break;
+    case DDS_COMPRESS_BC2:
+      encode_alpha_block_BC2(p, block);
+      encode_color_block(p + 8, (unsigned char *)block, DXT_BC2 | flags);
+      break;
+    case DDS_COMPRESS_BC4:
       encode_alpha_block_BC3(p, block, -1);
-    }
-}
-
-static void
-compress_BC5 (unsigned char       *dst,
-              const unsigned char *src,
-              int                  w,
-              int                  h)
-{
-  const unsigned int block_count = BLOCK_COUNT(w, h);
-  unsigned int i;
-  unsigned char block[64], *p;
-  int x, y;
-
-#ifdef _OPENMP
-#pragma omp parallel for schedule(dynamic, 256) private(block, p, x, y)
-#endif
-  for (i = 0; i < block_count; ++i)
-    {
-      x = (i % ((w + 3) >> 2)) << 2;
-      y = (i / ((w + 3) >> 2)) << 2;
-      p = dst + BLOCK_OFFSET(x, y, w, 16);
-      extract_block(src, x, y, w, h, block);
+      break;
+    case DDS_COMPRESS_BC5:
       /* Pixels are ordered as BGRA (see write_layer)
        * First we encode red  -1+3: channel 2;
        * then we encode green -2+3: channel 1.
        */
       encode_alpha_block_BC3(p, block, -1);
       encode_alpha_block_BC3(p + 8, block, -2);
-    }
-}
-
-static void
-compress_YCoCg (unsigned char       *dst,
-                const unsigned char *src,
-                int                  w,
-                int                  h)
-{
-  const unsigned int block_count = BLOCK_COUNT(w, h);
-  unsigned int i;
-  unsigned char block[64], *p;
-  int x, y;
-
-#ifdef _OPENMP
-#pragma omp parallel for schedule(dynamic, 256) private(block, p, x, y)
-#endif
-  for (i = 0; i < block_count; ++i)
-    {
-      x = (i % ((w + 3) >> 2)) << 2;
-      y = (i / ((w + 3) >> 2)) << 2;
-      p = dst + BLOCK_OFFSET(x, y, w, 16);
-      extract_block(src, x, y, w, h, block);
+      break;
+    case DDS_COMPRESS_YCOCGS:
+      encode_alpha_block_BC3(p, block, 0);
+      encode_YCoCg_block(p + 8, (unsigned char *)block);
+      break;
+    case DDS_COMPRESS_BC6H:
+      encode_bc6h_block(p, (const unsigned short *)block, flags);
+      break;
+    case DDS_COMPRESS_BC7:
+      encode_bc7_block(p, block, flags);
+      break;
+    default:
       encode_alpha_block_BC3(p, block, 0);
-      encode_YCoCg_block(p + 8, block);
+      encode_color_block(p + 8, (unsigned char *)block, DXT_BC3 | flags);
+      break;
     }
 }
 
+/*
+ * Compress all mipmap levels at once.  For BC6H, bpp is 6 and src holds
+ * RGB half floats; otherwise it holds BGRA pixels.
+ */
 int
 dxt_compress (unsigned char *dst,
               unsigned char *src,
@@ -1013,11 +1026,13 @@ dxt_compress (unsigned char *dst,
               int            mipmaps,
               int            flags)
 {
-  int i, size, w, h;
-  unsigned int offset;
+  int i, size, w, h, x, y, level;
+  unsigned int offset, n, block_count, block_size;
   unsigned char *tmp = NULL;
   int j;
   unsigned char *s;
+  unsigned char block[96] __attribute__((aligned(16)));
+  dxtlevel_t *levels;
 
   if (bpp == 1)
     {
@@ -1072,6 +1087,9 @@ dxt_compress (unsigned char *dst,
       bpp = 4;
     }
 
+  levels = g_new(dxtlevel_t, mipmaps);
+  block_size = get_mipmapped_size(4, 4, 0, 0, 1, format);
+  block_count = 0;
   offset = 0;
   w = width;
   h = height;
@@ -1079,40 +1097,47 @@ dxt_compress (unsigned char *dst,
 
   for (i = 0; i < mipmaps; ++i)
     {
-      switch (format)
-        {
-        case DDS_COMPRESS_BC1:
-          compress_BC1(dst + offset, s, w, h, flags);
-          break;
-        case DDS_COMPRESS_BC2:
-          compress_BC2(dst + offset, s, w, h, flags);
-          break;
-        case DDS_COMPRESS_BC3:
-        case DDS_COMPRESS_BC3N:
-        case DDS_COMPRESS_RXGB:
-        case DDS_COMPRESS_AEXP:
-        case DDS_COMPRESS_YCOCG:
-          compress_BC3(dst + offset, s, w, h, flags);
-          break;
-        case DDS_COMPRESS_BC4:
-          compress_BC4(dst + offset, s, w, h);
-          break;
-        case DDS_COMPRESS_BC5:
-          compress_BC5(dst + offset, s, w, h);
-          break;
-        case DDS_COMPRESS_YCOCGS:
-          compress_YCoCg(dst + offset, s, w, h);
-          break;
-        default:
-          compress_BC3(dst + offset, s, w, h, flags);
-          break;
-        }
+      levels[i].src = s;
+      levels[i].dst = dst + offset;
+      levels[i].width = w;
+      levels[i].height = h;
+      levels[i].first_block = block_count;
+
+      block_count += BLOCK_COUNT(w, h);
       s += (w * h * bpp);
       offset += get_mipmapped_size(w, h, 0, 0, 1, format);
       w = MAX(1, w >> 1);
       h = MAX(1, h >> 1);
     }
 
+  /* A single loop over the blocks of all levels keeps every thread busy,
+   * down to the smallest mipmaps.
+   */
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 256) private(block, level, w, h, x, y)
+#endif
+  for (n = 0; n < block_count; ++n)
+    {
+      for (level = mipmaps - 1; levels[level].first_block > n; --level);
+
+      w = levels[level].width;
+      h = levels[level].height;
+      x = ((n - levels[level].first_block) % ((w + 3) >> 2)) << 2;
+      y = ((n - levels[level].first_block) / ((w + 3) >> 2)) << 2;
+
+      if (format == DDS_COMPRESS_BC6H)
+        extract_block_half((const unsigned short *)levels[level].src,
+                           x, y, w, h, (unsigned short *)block);
+      else
+        extract_block(levels[level].src, x, y, w, h, block);
+
+      encode_block(levels[level].dst +
+                   (n - levels[level].first_block) * block_size,
+                   block, format, flags);
+    }
+
+  g_free(levels);
+
   if (tmp)
     g_free(tmp);
 
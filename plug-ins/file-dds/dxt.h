@@ -27,6 +27,8 @@ typedef enum dxt_flags_e
   DXT_BC2           = 1 << 1,
   DXT_BC3           = 1 << 2,
   DXT_PERCEPTUAL    = 1 << 3,
+  DXT_FAST          = 1 << 4,
+  DXT_HIGH          = 1 << 5,
 } dxt_flags_t;
 
 int dxt_compress   (unsigned char *dst,
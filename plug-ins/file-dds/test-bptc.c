@@ -0,0 +1,381 @@
+/*
+ * DDS GIMP plugin
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Tests of the BC6H and BC7 block encoders of bptc.c.
+ *
+ * The DDS loader does not decode BPTC, so this has its own reference
+ * decoder, written from the format specification, for the modes the
+ * encoders emit: BC7 mode 6, BC7 mode 5 with each rotation, and BC6H
+ * mode 11.  Each test encodes a block, checks the mode the encoder
+ * chose, decodes the block and checks it against the source pixels.
+ */
+
+#include <string.h>
+#include <glib.h>
+
+#include "bptc.h"
+#include "dxt.h"
+
+
+static const int weights2[4]  = { 0, 21, 43, 64 };
+static const int weights4[16] = { 0,  4,  9, 13, 17, 21, 26, 30,
+                                 34, 38, 43, 47, 51, 55, 60, 64 };
+
+/* the levels a 2 bit index interpolates between endpoints of 0 and 255 */
+static const int levels2[4]   = { 0, 84, 171, 255 };
+
+
+typedef struct
+{
+  const unsigned char *data;
+  int                  pos;
+} BitReader;
+
+static unsigned int
+get_bits (BitReader *br,
+          int        count)
+{
+  unsigned int value = 0;
+  int          i;
+
+  for (i = 0; i < count; ++i, ++br->pos)
+    {
+      if (br->data[br->pos >> 3] & (1 << (br->pos & 7)))
+        value |= 1 << i;
+    }
+
+  return value;
+}
+
+static int
+interpolate (int e0,
+             int e1,
+             int weight)
+{
+  return ((64 - weight) * e0 + weight * e1 + 32) >> 6;
+}
+
+/* the BC7 mode of a block: the position of its lowest set bit */
+static int
+bc7_mode (const unsigned char *block)
+{
+  int mode;
+
+  for (mode = 0; mode < 8; ++mode)
+    {
+      if (block[0] & (1 << mode))
+        return mode;
+    }
+
+  return -1;
+}
+
+/* decode a BC7 mode 5 or 6 block to RGBA */
+static void
+decode_bc7_block (const unsigned char *block,
+                  unsigned char       *rgba,
+                  int                 *rotation)
+{
+  BitReader br = { block, 0 };
+  int       mode = bc7_mode (block);
+  int       e[2][4];
+  int       c, i, tmp;
+
+  get_bits (&br, mode + 1);
+  *rotation = 0;
+
+  if (mode == 6)
+    {
+      int p[2];
+      int index;
+
+      for (c = 0; c < 4; ++c)
+        {
+          e[0][c] = get_bits (&br, 7);
+          e[1][c] = get_bits (&br, 7);
+        }
+      p[0] = get_bits (&br, 1);
+      p[1] = get_bits (&br, 1);
+      for (c = 0; c < 4; ++c)
+        {
+          e[0][c] = (e[0][c] << 1) | p[0];
+          e[1][c] = (e[1][c] << 1) | p[1];
+        }
+
+      for (i = 0; i < 16; ++i)
+        {
+          index = get_bits (&br, i == 0 ? 3 : 4);
+          for (c = 0; c < 4; ++c)
+            rgba[4 * i + c] = interpolate (e[0][c], e[1][c], weights4[index]);
+        }
+    }
+  else
+    {
+      int cindices[16];
+      int aindices[16];
+
+      g_assert_cmpint (mode, ==, 5);
+
+      *rotation = get_bits (&br, 2);
+      for (c = 0; c < 3; ++c)
+        {
+          e[0][c] = get_bits (&br, 7);
+          e[1][c] = get_bits (&br, 7);
+          e[0][c] = (e[0][c] << 1) | (e[0][c] >> 6);
+          e[1][c] = (e[1][c] << 1) | (e[1][c] >> 6);
+        }
+      e[0][3] = get_bits (&br, 8);
+      e[1][3] = get_bits (&br, 8);
+
+      for (i = 0; i < 16; ++i)
+        cindices[i] = get_bits (&br, i == 0 ? 1 : 2);
+      for (i = 0; i < 16; ++i)
+        aindices[i] = get_bits (&br, i == 0 ? 1 : 2);
+
+      for (i = 0; i < 16; ++i)
+        {
+          for (c = 0; c < 3; ++c)
+            rgba[4 * i + c] = interpolate (e[0][c], e[1][c],
+                                           weights2[cindices[i]]);
+          rgba[4 * i + 3] = interpolate (e[0][3], e[1][3],
+                                         weights2[aindices[i]]);
+
+          if (*rotation > 0)
+            {
+              tmp = rgba[4 * i + *rotation - 1];
+              rgba[4 * i + *rotation - 1] = rgba[4 * i + 3];
+              rgba[4 * i + 3] = tmp;
+            }
+        }
+    }
+}
+
+static int
+unquantize_bc6h (int q)
+{
+  if (q == 0)
+    return 0;
+  else if (q == 1023)
+    return 0xffff;
+
+  return ((q << 16) + 0x8000) >> 10;
+}
+
+/* the BC6H mode of a block, as its 2 or 5 mode bits */
+static int
+bc6h_mode (const unsigned char *block)
+{
+  BitReader br = { block, 0 };
+  int       mode = get_bits (&br, 2);
+
+  if (mode > 1)
+    mode |= get_bits (&br, 3) << 2;
+
+  return mode;
+}
+
+/* decode a BC6H mode 11 block to RGB half floats */
+static void
+decode_bc6h_block (const unsigned char *block,
+                   unsigned short      *rgb)
+{
+  BitReader br = { block, 5 };
+  int       e[2][3];
+  int       c, i, index;
+
+  for (i = 0; i < 2; ++i)
+    for (c = 0; c < 3; ++c)
+      e[i][c] = unquantize_bc6h (get_bits (&br, 10));
+
+  for (i = 0; i < 16; ++i)
+    {
+      index = get_bits (&br, i == 0 ? 3 : 4);
+      for (c = 0; c < 3; ++c)
+        rgb[3 * i + c] = (interpolate (e[0][c], e[1][c],
+                                       weights4[index]) * 31) >> 6;
+    }
+}
+
+
+/* encode and decode an RGBA block, and return the largest error */
+static int
+round_trip_bc7 (const unsigned char *rgba,
+                int                  flags,
+                int                 *mode,
+                int                 *rotation)
+{
+  unsigned char bgra[64];
+  unsigned char block[16];
+  unsigned char decoded[64];
+  int           i, error = 0;
+
+  for (i = 0; i < 16; ++i)
+    {
+      bgra[4 * i + 0] = rgba[4 * i + 2];
+      bgra[4 * i + 1] = rgba[4 * i + 1];
+      bgra[4 * i + 2] = rgba[4 * i + 0];
+      bgra[4 * i + 3] = rgba[4 * i + 3];
+    }
+
+  encode_bc7_block (block, bgra, flags);
+
+  *mode = bc7_mode (block);
+  if (*mode != 5 && *mode != 6)
+    return 256;
+
+  decode_bc7_block (block, decoded, rotation);
+
+  for (i = 0; i < 64; ++i)
+    error = MAX (error, ABS (decoded[i] - rgba[i]));
+
+  return error;
+}
+
+static void
+test_bc7_mode6 (void)
+{
+  unsigned char rgba[64];
+  int           mode, rotation, error;
+  int           i;
+
+  /* a gradient with alpha, as mode 6 is meant for */
+  for (i = 0; i < 16; ++i)
+    {
+      rgba[4 * i + 0] = 40 + 8 * i;
+      rgba[4 * i + 1] = 200 - 6 * i;
+      rgba[4 * i + 2] = 90 + 5 * i;
+      rgba[4 * i + 3] = 255 - 4 * i;
+    }
+
+  error = round_trip_bc7 (rgba, DXT_FAST, &mode, &rotation);
+  g_assert_cmpint (mode, ==, 6);
+  g_assert_cmpint (error, <=, 4);
+
+  error = round_trip_bc7 (rgba, DXT_HIGH, &mode, &rotation);
+  g_assert_cmpint (error, <=, 4);
+
+  /* a solid color is exact when its values have the right p-bits */
+  for (i = 0; i < 16; ++i)
+    {
+      rgba[4 * i + 0] = 255;
+      rgba[4 * i + 1] = 129;
+      rgba[4 * i + 2] = 3;
+      rgba[4 * i + 3] = 255;
+    }
+
+  error = round_trip_bc7 (rgba, DXT_FAST, &mode, &rotation);
+  g_assert_cmpint (mode, ==, 6);
+  g_assert_cmpint (error, ==, 0);
+}
+
+/*
+ * One channel varies independently of the three others, which vary
+ * together.  Only mode 5, with the rotation that moves the independent
+ * channel to the alpha indices, encodes such a block exactly.
+ */
+static void
+test_bc7_mode5_rotation (gconstpointer data)
+{
+  unsigned char rgba[64];
+  int           expected = GPOINTER_TO_INT (data);
+  int           independent = (expected + 3) % 4;
+  int           mode, rotation, error;
+  int           i, c;
+
+  for (i = 0; i < 16; ++i)
+    for (c = 0; c < 4; ++c)
+      {
+        if (c == independent)
+          rgba[4 * i + c] = levels2[(i >> 2) & 3];
+        else
+          rgba[4 * i + c] = levels2[i & 3];
+      }
+
+  error = round_trip_bc7 (rgba, DXT_HIGH, &mode, &rotation);
+  g_assert_cmpint (mode, ==, 5);
+  g_assert_cmpint (rotation, ==, expected);
+  g_assert_cmpint (error, ==, 0);
+}
+
+static void
+test_bc6h_mode11 (void)
+{
+  unsigned short rgb[48];
+  unsigned short decoded[48];
+  unsigned char  block[16];
+  int            i, c, error = 0;
+
+  /* a gradient of halves between 0.25 and 4.0 */
+  for (i = 0; i < 16; ++i)
+    {
+      rgb[3 * i + 0] = 0x3400 + 0x80 * i;
+      rgb[3 * i + 1] = 0x3800 + 0x40 * i;
+      rgb[3 * i + 2] = 0x4000 + 0x38 * i;
+    }
+
+  encode_bc6h_block (block, rgb, 0);
+
+  g_assert_cmpint (bc6h_mode (block), ==, 0x03);
+
+  decode_bc6h_block (block, decoded);
+
+  for (i = 0; i < 16; ++i)
+    for (c = 0; c < 3; ++c)
+      error = MAX (error, ABS (decoded[3 * i + c] - rgb[3 * i + c]));
+
+  /* the halves lie on a line, apart from the curve of their exponents */
+  g_assert_cmpint (error, <=, 0x40);
+
+  /* negative values clamp to zero, infinities to the largest half */
+  for (i = 0; i < 16; ++i)
+    {
+      rgb[3 * i + 0] = 0xbc00;
+      rgb[3 * i + 1] = 0x7c00;
+      rgb[3 * i + 2] = 0x0000;
+    }
+
+  encode_bc6h_block (block, rgb, 0);
+  decode_bc6h_block (block, decoded);
+
+  for (i = 0; i < 16; ++i)
+    {
+      g_assert_cmpint (decoded[3 * i + 0], ==, 0);
+      g_assert_cmpint (decoded[3 * i + 1], ==, 0x7bff);
+      g_assert_cmpint (decoded[3 * i + 2], ==, 0);
+    }
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/bptc/bc7-mode6", test_bc7_mode6);
+  g_test_add_data_func ("/bptc/bc7-mode5-rotation0", GINT_TO_POINTER (0),
+                        test_bc7_mode5_rotation);
+  g_test_add_data_func ("/bptc/bc7-mode5-rotation1", GINT_TO_POINTER (1),
+                        test_bc7_mode5_rotation);
+  g_test_add_data_func ("/bptc/bc7-mode5-rotation2", GINT_TO_POINTER (2),
+                        test_bc7_mode5_rotation);
+  g_test_add_data_func ("/bptc/bc7-mode5-rotation3", GINT_TO_POINTER (3),
+                        test_bc7_mode5_rotation);
+  g_test_add_func ("/bptc/bc6h-mode11", test_bc6h_mode11);
+
+  return g_test_run ();
+}
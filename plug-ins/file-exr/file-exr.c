@@ -63,8 +63,16 @@ static GimpValueArray * exr_load             (GimpProcedure         *procedure,
 static GimpImage      * load_image           (GFile                 *file,
                                               GimpMetadata          *metadata,
                                               GimpMetadataLoadFlags *flags,
+                                              gint                   mipmap_level,
                                               gboolean               interactive,
                                               GError               **error);
+static gboolean         load_layer           (EXRLoader             *loader,
+                                              gint                   index,
+                                              GimpImage             *image,
+                                              GFile                 *file,
+                                              gdouble                progress_start,
+                                              gdouble                progress_end,
+                                              GError               **error);
 static void             sanitize_comment     (gchar                 *comment);
 void                    load_dialog          (EXRImageType           image_type);
 
@@ -127,6 +135,14 @@ exr_create_procedure (GimpPlugIn  *plug_in,
                                           "exr");
       gimp_file_procedure_set_magics (GIMP_FILE_PROCEDURE (procedure),
                                       "0,long,0x762f3101");
+
+      gimp_procedure_add_int_argument (procedure, "mipmap-level",
+                                       _("_Mipmap level"),
+                                       _("Mipmap level of tiled files to "
+                                         "load, 0 being the full size. "
+                                         "Ignored in interactive mode"),
+                                       0, 31, 0,
+                                       G_PARAM_READWRITE);
     }
 
   return procedure;
@@ -143,12 +159,19 @@ exr_load (GimpProcedure         *procedure,
 {
   GimpValueArray *return_vals;
   GimpImage      *image;
-  GError         *error  = NULL;
+  gint            mipmap_level = 0;
+  GError         *error        = NULL;
 
   gegl_init (NULL, NULL);
 
-  image = load_image (file, metadata, flags, run_mode == GIMP_RUN_INTERACTIVE,
-                      &error);
+  /* There is no dialog to pick a level, and last values must not
+   * silently open a later file at a lower resolution.
+   */
+  if (run_mode != GIMP_RUN_INTERACTIVE)
+    g_object_get (config, "mipmap-level", &mipmap_level, NULL);
+
+  image = load_image (file, metadata, flags, mipmap_level,
+                      run_mode == GIMP_RUN_INTERACTIVE, &error);
 
   if (! image)
     return gimp_procedure_new_return_values (procedure,
@@ -168,24 +191,19 @@ static GimpImage *
 load_image (GFile                 *file,
             GimpMetadata          *metadata,
             GimpMetadataLoadFlags *flags,
+            gint                   mipmap_level,
             gboolean               interactive,
             GError               **error)
 {
   EXRLoader        *loader;
+  gint              n_layers;
   gint              width;
   gint              height;
-  gboolean          has_alpha;
   GimpImageBaseType image_type;
   GimpPrecision     image_precision;
+  EXRPrecision      precision;
   GimpImage        *image = NULL;
-  GimpImageType     layer_type;
-  GimpLayer        *layer;
-  const Babl       *format;
-  GeglBuffer       *buffer = NULL;
-  gint              bpp;
-  gint              tile_height;
-  gchar            *pixels = NULL;
-  gint              begin;
+  gint              i;
   gint32            success = FALSE;
   gchar            *comment = NULL;
   GimpColorProfile *profile = NULL;
@@ -197,6 +215,9 @@ load_image (GFile                 *file,
   gimp_progress_init_printf (_("Opening '%s'"),
                              gimp_file_get_utf8_name (file));
 
+  /* OpenEXR decodes chunks of scanlines and tiles in parallel */
+  exr_set_thread_count (gimp_get_num_processors ());
+
   loader = exr_loader_new (g_file_peek_path (file));
 
   if (! loader)
@@ -207,8 +228,14 @@ load_image (GFile                 *file,
       goto out;
     }
 
-  width  = exr_loader_get_width (loader);
-  height = exr_loader_get_height (loader);
+  if (mipmap_level > 0)
+    exr_loader_set_level (loader, mipmap_level);
+
+  n_layers = exr_loader_get_n_layers (loader);
+
+  /* the first layer sets the image size */
+  width  = exr_loader_get_width (loader, 0);
+  height = exr_loader_get_height (loader, 0);
 
   if ((width < 1) || (height < 1))
     {
@@ -218,9 +245,35 @@ load_image (GFile                 *file,
       goto out;
     }
 
-  has_alpha = exr_loader_has_alpha (loader) ? TRUE : FALSE;
+  /* layers of different precisions all fit in float, and gray layers
+   * go in an RGB image if any layer is RGB
+   */
+  precision  = exr_loader_get_precision (loader, 0);
+  image_type = GIMP_GRAY;
 
-  switch (exr_loader_get_precision (loader))
+  for (i = 0; i < n_layers; i++)
+    {
+      if (exr_loader_get_precision (loader, i) != precision)
+        precision = PREC_FLOAT;
+
+      switch (exr_loader_get_image_type (loader, i))
+        {
+        case IMAGE_TYPE_RGB:
+          image_type = GIMP_RGB;
+          break;
+        case IMAGE_TYPE_YUV:
+        case IMAGE_TYPE_GRAY:
+        case IMAGE_TYPE_UNKNOWN_1_CHANNEL:
+          break;
+        default:
+          g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                       _("Error querying image type from '%s'"),
+                       gimp_file_get_utf8_name (file));
+          goto out;
+        }
+    }
+
+  switch (precision)
     {
     case PREC_UINT:
       image_precision = GIMP_PRECISION_U32_LINEAR;
@@ -238,25 +291,6 @@ load_image (GFile                 *file,
       goto out;
     }
 
-  switch (exr_loader_get_image_type (loader))
-    {
-    case IMAGE_TYPE_RGB:
-      image_type = GIMP_RGB;
-      layer_type = has_alpha ? GIMP_RGBA_IMAGE : GIMP_RGB_IMAGE;
-      break;
-    case IMAGE_TYPE_YUV:
-    case IMAGE_TYPE_GRAY:
-    case IMAGE_TYPE_UNKNOWN_1_CHANNEL:
-      image_type = GIMP_GRAY;
-      layer_type = has_alpha ? GIMP_GRAYA_IMAGE : GIMP_GRAY_IMAGE;
-      break;
-    default:
-      g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
-                   _("Error querying image type from '%s'"),
-                   gimp_file_get_utf8_name (file));
-      goto out;
-    }
-
   image = gimp_image_new_with_precision (width, height,
                                          image_type, image_precision);
   if (! image)
@@ -268,10 +302,20 @@ load_image (GFile                 *file,
       goto out;
     }
 
-  if (interactive                                                         &&
-      (exr_loader_get_image_type (loader) == IMAGE_TYPE_UNKNOWN_1_CHANNEL ||
-       exr_loader_get_image_type (loader) == IMAGE_TYPE_YUV))
-    load_dialog (exr_loader_get_image_type (loader));
+  if (interactive)
+    {
+      for (i = 0; i < n_layers; i++)
+        {
+          EXRImageType layer_type = exr_loader_get_image_type (loader, i);
+
+          if (layer_type == IMAGE_TYPE_UNKNOWN_1_CHANNEL ||
+              layer_type == IMAGE_TYPE_YUV)
+            {
+              load_dialog (layer_type);
+              break;
+            }
+        }
+    }
 
   /* try to load an icc profile, it will be generated on the fly if
    * chromaticities are given
@@ -284,47 +328,13 @@ load_image (GFile                 *file,
         gimp_image_set_color_profile (image, profile);
     }
 
-  layer = gimp_layer_new (image, _("Background"), width, height,
-                          layer_type, 100,
-                          gimp_image_get_default_new_layer_mode (image));
-  gimp_image_insert_layer (image, layer, NULL, 0);
-
-  buffer = gimp_drawable_get_buffer (GIMP_DRAWABLE (layer));
-  format = gimp_drawable_get_format (GIMP_DRAWABLE (layer));
-  bpp = babl_format_get_bytes_per_pixel (format);
-
-  tile_height = gimp_tile_height ();
-  pixels = g_new0 (gchar, tile_height * width * bpp);
-
-  for (begin = 0; begin < height; begin += tile_height)
+  for (i = 0; i < n_layers; i++)
     {
-      gint end;
-      gint num;
-      gint i;
-
-      end = MIN (begin + tile_height, height);
-      num = end - begin;
-
-      for (i = 0; i < num; i++)
-        {
-          gint retval;
-
-          retval = exr_loader_read_pixel_row (loader,
-                                              pixels + (i * width * bpp),
-                                              bpp, begin + i);
-          if (retval < 0)
-            {
-              g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
-                           _("Error reading pixel data from '%s'"),
-                           gimp_file_get_utf8_name (file));
-              goto out;
-            }
-        }
-
-      gegl_buffer_set (buffer, GEGL_RECTANGLE (0, begin, width, num),
-                       0, NULL, pixels, GEGL_AUTO_ROWSTRIDE);
-
-      gimp_progress_update ((gdouble) begin / (gdouble) height);
+      if (! load_layer (loader, i, image, file,
+                        (gdouble) i / n_layers,
+                        (gdouble) (i + 1) / n_layers,
+                        error))
+        goto out;
     }
 
   /* try to read the file comment */
@@ -389,8 +399,6 @@ load_image (GFile                 *file,
 
  out:
   g_clear_object (&profile);
-  g_clear_object (&buffer);
-  g_clear_pointer (&pixels, g_free);
   g_clear_pointer (&comment, g_free);
   g_clear_pointer (&loader, exr_loader_unref);
 
@@ -403,6 +411,127 @@ load_image (GFile                 *file,
   return NULL;
 }
 
+/* Each part, and each channel name prefix of a part, is loaded as a
+ * layer of its own, the first one at the bottom.
+ */
+static gboolean
+load_layer (EXRLoader  *loader,
+            gint        index,
+            GimpImage  *image,
+            GFile      *file,
+            gdouble     progress_start,
+            gdouble     progress_end,
+            GError    **error)
+{
+  const gchar   *name;
+  gchar         *default_name = NULL;
+  gint           width;
+  gint           height;
+  gint           offset_x;
+  gint           offset_y;
+  gboolean       has_alpha;
+  GimpImageType  layer_type;
+  GimpLayer     *layer;
+  const Babl    *format;
+  GeglBuffer    *buffer;
+  gint           bpp;
+  gint           tile_height;
+  gint           band_height;
+  gchar         *pixels;
+  gint           begin;
+  gboolean       success = TRUE;
+
+  width     = exr_loader_get_width (loader, index);
+  height    = exr_loader_get_height (loader, index);
+  has_alpha = exr_loader_has_alpha (loader, index) ? TRUE : FALSE;
+
+  if ((width < 1) || (height < 1))
+    {
+      g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                   _("Error querying image dimensions from '%s'"),
+                   gimp_file_get_utf8_name (file));
+      return FALSE;
+    }
+
+  if (gimp_image_get_base_type (image) == GIMP_RGB)
+    layer_type = has_alpha ? GIMP_RGBA_IMAGE : GIMP_RGB_IMAGE;
+  else
+    layer_type = has_alpha ? GIMP_GRAYA_IMAGE : GIMP_GRAY_IMAGE;
+
+  name = exr_loader_get_layer_name (loader, index);
+  if (! name)
+    {
+      if (index == 0)
+        default_name = g_strdup (_("Background"));
+      else
+        default_name = g_strdup_printf (_("Layer %d"), index + 1);
+
+      name = default_name;
+    }
+
+  layer = gimp_layer_new (image, name, width, height,
+                          layer_type, 100,
+                          gimp_image_get_default_new_layer_mode (image));
+  g_free (default_name);
+
+  exr_loader_get_offsets (loader, index, &offset_x, &offset_y);
+  gimp_layer_set_offsets (layer, offset_x, offset_y);
+
+  gimp_image_insert_layer (image, layer, NULL, 0);
+
+  /* read in the layer's own format, GEGL converts gray layers of an
+   * RGB image, and other precisions, to the drawable's
+   */
+  buffer = gimp_drawable_get_buffer (GIMP_DRAWABLE (layer));
+  format = babl_format_with_space (exr_loader_get_format (loader, index),
+                                   gimp_drawable_get_format (GIMP_DRAWABLE (layer)));
+  bpp = babl_format_get_bytes_per_pixel (format);
+
+  /* read bands of several tiles or scanline chunks at once, so that
+   * OpenEXR has work for all its threads, within 64 MB of memory;
+   * tiled layers are read in whole rows of tiles
+   */
+  band_height = gimp_tile_height () * gimp_get_num_processors ();
+  band_height = MIN (band_height,
+                     MAX (gimp_tile_height (),
+                          (64 << 20) / ((gsize) width * bpp)));
+
+  tile_height = exr_loader_get_tile_height (loader, index);
+  if (tile_height > 0)
+    band_height = MAX (1, band_height / tile_height) * tile_height;
+
+  band_height = MIN (band_height, height);
+
+  pixels = g_new0 (gchar, (gsize) band_height * width * bpp);
+
+  for (begin = 0; begin < height; begin += band_height)
+    {
+      gint num = MIN (band_height, height - begin);
+
+      if (exr_loader_read_pixels (loader, index, pixels, bpp,
+                                  begin, num) < 0)
+        {
+          g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                       _("Error reading pixel data from '%s'"),
+                       gimp_file_get_utf8_name (file));
+          success = FALSE;
+          break;
+        }
+
+      gegl_buffer_set (buffer, GEGL_RECTANGLE (0, begin, width, num),
+                       0, format, pixels, GEGL_AUTO_ROWSTRIDE);
+
+      gimp_progress_update (progress_start +
+                            (progress_end - progress_start) *
+                            (gdouble) (begin + num) / (gdouble) height);
+    }
+
+  g_free (pixels);
+  g_object_unref (buffer);
+
+  return success;
+}
+
 /* copy & pasted from file-jpeg/jpeg-load.c */
 static void
 sanitize_comment (gchar *comment)
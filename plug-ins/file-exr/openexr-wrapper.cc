@@ -17,7 +17,12 @@
 
 #include "config.h"
 
+#include <algorithm>
+#include <cstddef>
+#include <set>
+#include <stdexcept>
 #include <string>
+#include <vector>
 
 #include <lcms2.h>
 
@@ -51,11 +56,15 @@
 /* ignore deprecated warnings from OpenEXR headers */
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wdeprecated"
-#include <ImfInputFile.h>
+#include <ImfMultiPartInputFile.h>
+#include <ImfInputPart.h>
+#include <ImfTiledInputPart.h>
+#include <ImfPartType.h>
 #include <ImfChannelList.h>
 #include <ImfRgbaFile.h>
 #include <ImfRgbaYca.h>
 #include <ImfStandardAttributes.h>
+#include <ImfThreading.h>
 #pragma GCC diagnostic pop
 
 #include "exr-attribute-blob.h"
@@ -74,163 +83,354 @@ static bool XYZ_equal(cmsCIEXYZ *a, cmsCIEXYZ *b)
          fabs ((a->Z / a->Y * b->Y) - b->Z) < epsilon;
 }
 
+/* One GIMP layer: the channels of a part sharing a name prefix */
+struct EXRLayer
+{
+  int          part_;
+  std::string  name_;
+  std::string  prefix_;
+  std::string  channels_[4];
+  PixelType    pt_;
+  int          bpc_;
+  EXRImageType image_type_;
+  bool         has_alpha_;
+  std::string  format_string_;
+  bool         tiled_;
+  int          tile_height_;
+  int          n_x_levels_;
+  int          n_y_levels_;
+  int          level_x_;
+  int          level_y_;
+  Box2i        data_window_;
+  Box2i        level_data_window_;
+};
+
 struct _EXRLoader
 {
   _EXRLoader(const char* filename) :
     refcount_(1),
-    file_(filename),
-    data_window_(file_.header().dataWindow()),
-    channels_(file_.header().channels())
+    file_(filename, globalThreadCount())
   {
-    const Channel* chan;
-
-    if (channels_.findChannel("R") ||
-        channels_.findChannel("G") ||
-        channels_.findChannel("B"))
+    for (int part = 0; part < file_.parts(); part++)
       {
-        format_string_ = "RGB";
-        image_type_ = IMAGE_TYPE_RGB;
+        const Header &header = file_.header(part);
+
+        if (header.hasType() && isDeepData(header.type()))
+          continue;
 
-        if ((chan = channels_.findChannel("R")))
-          pt_ = chan->type;
-        else if ((chan = channels_.findChannel("G")))
-          pt_ = chan->type;
+        std::set<std::string> prefixes;
+        std::string           part_name;
+
+        if (header.hasName())
+          part_name = header.name();
+
+        addLayer(part, part_name, "");
+
+        header.channels().layers(prefixes);
+        for (std::set<std::string>::const_iterator i = prefixes.begin();
+             i != prefixes.end(); ++i)
+          {
+            addLayer(part,
+                     part_name.empty() ? *i : part_name + "." + *i,
+                     *i + ".");
+          }
+      }
+
+    if (layers_.empty())
+      throw std::runtime_error("no loadable channels");
+  }
+
+  void addLayer(int                part,
+                const std::string &name,
+                const std::string &prefix)
+  {
+    const Header      &header   = file_.header(part);
+    const ChannelList &channels = header.channels();
+    const Channel     *chan;
+    EXRLayer           layer;
+
+    layer.part_ = part;
+    layer.name_ = name;
+    layer.prefix_ = prefix;
+
+    if (channels.findChannel(prefix + "R") ||
+        channels.findChannel(prefix + "G") ||
+        channels.findChannel(prefix + "B"))
+      {
+        layer.format_string_ = "RGB";
+        layer.image_type_ = IMAGE_TYPE_RGB;
+        layer.channels_[0] = prefix + "R";
+        layer.channels_[1] = prefix + "G";
+        layer.channels_[2] = prefix + "B";
+
+        if ((chan = channels.findChannel(prefix + "R")))
+          layer.pt_ = chan->type;
+        else if ((chan = channels.findChannel(prefix + "G")))
+          layer.pt_ = chan->type;
         else
-          pt_ = channels_.findChannel("B")->type;
+          layer.pt_ = channels.findChannel(prefix + "B")->type;
       }
-    else if (channels_.findChannel("Y") &&
-             (channels_.findChannel("RY") ||
-              channels_.findChannel("BY")))
+    else if (channels.findChannel(prefix + "Y") &&
+             (channels.findChannel(prefix + "RY") ||
+              channels.findChannel(prefix + "BY")))
       {
-        format_string_ = "Y'CbCr";
-        image_type_ = IMAGE_TYPE_YUV;
+        /* Only the luminance is read, see below */
+        layer.format_string_ = "Y";
+        layer.image_type_ = IMAGE_TYPE_YUV;
+        layer.channels_[0] = prefix + "Y";
 
         /* TODO: Use RGBA interface to incorporate
          * RY/BY chroma channels */
-        pt_ = channels_.findChannel("Y")->type;
+        layer.pt_ = channels.findChannel(prefix + "Y")->type;
       }
-    else if (channels_.findChannel("Y"))
+    else if (channels.findChannel(prefix + "Y"))
       {
-        format_string_ = "Y";
-        image_type_ = IMAGE_TYPE_GRAY;
+        layer.format_string_ = "Y";
+        layer.image_type_ = IMAGE_TYPE_GRAY;
+        layer.channels_[0] = prefix + "Y";
 
-        pt_ = channels_.findChannel("Y")->type;
+        layer.pt_ = channels.findChannel(prefix + "Y")->type;
       }
     else
       {
         int         channel_count = 0;
-        const char *channel_name  = NULL;
+        std::string channel_name;
 
-        for (ChannelList::ConstIterator i = channels_.begin();
-             i != channels_.end(); ++i)
+        /* Only the channels directly under the prefix, the others
+         * belong to nested layers. */
+        for (ChannelList::ConstIterator i = channels.begin();
+             i != channels.end(); ++i)
           {
+            std::string full_name = i.name();
+
+            if (full_name.compare(0, prefix.size(), prefix) != 0 ||
+                full_name.find('.', prefix.size()) != std::string::npos ||
+                full_name == prefix + "A")
+              continue;
+
             channel_count++;
 
-            pt_ = i.channel().type;
-            channel_name = i.name();
+            layer.pt_ = i.channel().type;
+            channel_name = full_name;
           }
 
        /* Assume single channel images are grayscale,
         * no matter what the channel name is. */
         if (channel_count == 1)
           {
-            format_string_ = channel_name;
-            image_type_ = IMAGE_TYPE_UNKNOWN_1_CHANNEL;
-            unknown_channel_name_ = channel_name;
+            layer.format_string_ = "Y";
+            layer.image_type_ = IMAGE_TYPE_UNKNOWN_1_CHANNEL;
+            layer.channels_[0] = channel_name;
 
             /* TODO: Pass this information back so it can be displayed
              * in the UI. */
             printf ("OpenEXR Warning: Single channel image with unknown "
-                    "channel %s, loading as grayscale\n", channel_name);
+                    "channel %s, loading as grayscale\n",
+                    channel_name.c_str());
           }
         else
           {
-            throw;
+            /* Nothing GIMP can show, e.g. a prefix of nested layers */
+            return;
           }
       }
 
-    if (channels_.findChannel("A"))
+    if (channels.findChannel(prefix + "A"))
       {
-        format_string_.append("A");
-        has_alpha_ = true;
+        layer.format_string_.append("A");
+        layer.has_alpha_ = true;
       }
     else
       {
-        has_alpha_ = false;
+        layer.has_alpha_ = false;
       }
 
-    switch (pt_)
+    switch (layer.pt_)
       {
       case UINT:
-        format_string_.append(" u32");
-        bpc_ = 4;
+        layer.format_string_.append(" u32");
+        layer.bpc_ = 4;
         break;
       case HALF:
-        format_string_.append(" half");
-        bpc_ = 2;
+        layer.format_string_.append(" half");
+        layer.bpc_ = 2;
         break;
       case FLOAT:
       default:
-        format_string_.append(" float");
-        bpc_ = 4;
+        layer.format_string_.append(" float");
+        layer.bpc_ = 4;
+      }
+
+    layer.data_window_ = header.dataWindow();
+    layer.level_data_window_ = layer.data_window_;
+    layer.level_x_ = 0;
+    layer.level_y_ = 0;
+    layer.tiled_ = header.hasTileDescription();
+
+    if (layer.tiled_)
+      {
+        TiledInputPart tiled(file_, part);
+
+        layer.tile_height_ = tiled.tileYSize();
+        layer.n_x_levels_ = tiled.numXLevels();
+        layer.n_y_levels_ = tiled.numYLevels();
+      }
+    else
+      {
+        layer.tile_height_ = 0;
+        layer.n_x_levels_ = 1;
+        layer.n_y_levels_ = 1;
       }
+
+    layers_.push_back(layer);
+  }
+
+  int getNLevels() const {
+    return std::max(layers_[0].n_x_levels_, layers_[0].n_y_levels_);
   }
 
-  int readPixelRow(char *pixels,
-                   int   bpp,
-                   int   row)
+  void setLevel(int level) {
+    for (size_t i = 0; i < layers_.size(); i++)
+      {
+        EXRLayer &layer = layers_[i];
+
+        layer.level_x_ = std::min(level, layer.n_x_levels_ - 1);
+        layer.level_y_ = std::min(level, layer.n_y_levels_ - 1);
+
+        if (layer.tiled_)
+          {
+            TiledInputPart tiled(file_, layer.part_);
+
+            layer.level_data_window_ =
+              tiled.dataWindowForLevel(layer.level_x_, layer.level_y_);
+          }
+      }
+  }
+
+  int readPixels(int   index,
+                 char *pixels,
+                 int   bpp,
+                 int   row,
+                 int   n_rows)
   {
-    const int actual_row = data_window_.min.y + row;
-    FrameBuffer fb;
+    const EXRLayer &layer  = layers_.at(index);
+    const Box2i    &dw     = layer.level_data_window_;
+    const size_t    stride = (size_t) getWidth(index) * bpp;
+    FrameBuffer     fb;
     // This is necessary because OpenEXR expects the buffer to begin at
     // (0, 0). Though it probably results in some unmapped address,
     // hopefully OpenEXR will not make use of it. :/
-    char* base = pixels - (data_window_.min.x * bpp);
+    char* base = pixels -
+                 (ptrdiff_t) dw.min.x * bpp -
+                 (ptrdiff_t) (dw.min.y + row) * stride;
 
-    switch (image_type_)
+    switch (layer.image_type_)
       {
       case IMAGE_TYPE_UNKNOWN_1_CHANNEL:
-        fb.insert(unknown_channel_name_, Slice(pt_, base, bpp, 0, 1, 1, 0.5));
-        break;
-
       case IMAGE_TYPE_YUV:
       case IMAGE_TYPE_GRAY:
-        fb.insert("Y", Slice(pt_, base, bpp, 0, 1, 1, 0.5));
-        if (hasAlpha())
+        fb.insert(layer.channels_[0],
+                  Slice(layer.pt_, base, bpp, stride, 1, 1, 0.5));
+        if (layer.has_alpha_)
           {
-            fb.insert("A", Slice(pt_, base + bpc_, bpp, 0, 1, 1, 1.0));
+            fb.insert(layer.prefix_ + "A",
+                      Slice(layer.pt_, base + layer.bpc_, bpp, stride,
+                            1, 1, 1.0));
           }
         break;
 
       case IMAGE_TYPE_RGB:
       default:
-        fb.insert("R", Slice(pt_, base + (bpc_ * 0), bpp, 0, 1, 1, 0.0));
-        fb.insert("G", Slice(pt_, base + (bpc_ * 1), bpp, 0, 1, 1, 0.0));
-        fb.insert("B", Slice(pt_, base + (bpc_ * 2), bpp, 0, 1, 1, 0.0));
-        if (hasAlpha())
+        fb.insert(layer.channels_[0],
+                  Slice(layer.pt_, base + (layer.bpc_ * 0), bpp, stride,
+                        1, 1, 0.0));
+        fb.insert(layer.channels_[1],
+                  Slice(layer.pt_, base + (layer.bpc_ * 1), bpp, stride,
+                        1, 1, 0.0));
+        fb.insert(layer.channels_[2],
+                  Slice(layer.pt_, base + (layer.bpc_ * 2), bpp, stride,
+                        1, 1, 0.0));
+        if (layer.has_alpha_)
           {
-            fb.insert("A", Slice(pt_, base + (bpc_ * 3), bpp, 0, 1, 1, 1.0));
+            fb.insert(layer.prefix_ + "A",
+                      Slice(layer.pt_, base + (layer.bpc_ * 3), bpp, stride,
+                            1, 1, 1.0));
           }
       }
 
-    file_.setFrameBuffer(fb);
-    file_.readPixels(actual_row);
+    if (layer.tiled_)
+      {
+        // Whole rows of tiles are decoded at once, which spreads their
+        // decompression over OpenEXR's threads, and writes every tile
+        // straight into the band.
+        TiledInputPart tiled(file_, layer.part_);
+        const int      last_row = row + n_rows - 1;
+
+        if (row % layer.tile_height_ != 0 ||
+            (n_rows % layer.tile_height_ != 0 &&
+             last_row != getHeight(index) - 1))
+          throw std::invalid_argument("rows not aligned to tiles");
+
+        tiled.setFrameBuffer(fb);
+        tiled.readTiles(0, tiled.numXTiles(layer.level_x_) - 1,
+                        row / layer.tile_height_,
+                        last_row / layer.tile_height_,
+                        layer.level_x_, layer.level_y_);
+      }
+    else
+      {
+        // Likewise, a range of scanlines is decoded by several threads
+        InputPart scanlines(file_, layer.part_);
+
+        scanlines.setFrameBuffer(fb);
+        scanlines.readPixels(dw.min.y + row, dw.min.y + row + n_rows - 1);
+      }
 
     return 0;
   }
 
-  int getWidth() const {
-    return data_window_.max.x - data_window_.min.x + 1;
+  int getNLayers() const {
+    return layers_.size();
   }
 
-  int getHeight() const {
-    return data_window_.max.y - data_window_.min.y + 1;
+  const char *getLayerName(int index) const {
+    const EXRLayer &layer = layers_.at(index);
+
+    return layer.name_.empty() ? NULL : layer.name_.c_str();
   }
 
-  EXRPrecision getPrecision() const {
+  int getWidth(int index) const {
+    const Box2i &dw = layers_.at(index).level_data_window_;
+
+    return dw.max.x - dw.min.x + 1;
+  }
+
+  int getHeight(int index) const {
+    const Box2i &dw = layers_.at(index).level_data_window_;
+
+    return dw.max.y - dw.min.y + 1;
+  }
+
+  // Offsets from the first layer, which sets the image size. Levels
+  // keep the origin of the data window, so they scale with the level.
+  void getOffsets(int  index,
+                  int *offset_x,
+                  int *offset_y) const {
+    const EXRLayer &layer = layers_.at(index);
+    const Box2i    &first = layers_[0].data_window_;
+
+    *offset_x = (layer.data_window_.min.x - first.min.x) >> layer.level_x_;
+    *offset_y = (layer.data_window_.min.y - first.min.y) >> layer.level_y_;
+  }
+
+  int getTileHeight(int index) const {
+    return layers_.at(index).tile_height_;
+  }
+
+  EXRPrecision getPrecision(int index) const {
     EXRPrecision prec;
 
-    switch (pt_)
+    switch (layers_.at(index).pt_)
       {
       case UINT:
         prec = PREC_UINT;
@@ -246,12 +446,16 @@ struct _EXRLoader
     return prec;
   }
 
-  EXRImageType getImageType() const {
-    return image_type_;
+  EXRImageType getImageType(int index) const {
+    return layers_.at(index).image_type_;
+  }
+
+  int hasAlpha(int index) const {
+    return layers_.at(index).has_alpha_ ? 1 : 0;
   }
 
-  int hasAlpha() const {
-    return has_alpha_ ? 1 : 0;
+  const char *getFormat(int index) const {
+    return layers_.at(index).format_string_.c_str();
   }
 
   GimpColorProfile *getProfile() const {
@@ -268,22 +472,22 @@ struct _EXRLoader
     cmsCIEXYZ exr_r_XYZ, exr_g_XYZ, exr_b_XYZ, exr_w_XYZ;
 
     // get the color information from the EXR
-    if (hasChromaticities (file_.header ()))
-      chromaticities = Imf::chromaticities (file_.header ());
+    if (hasChromaticities (file_.header (0)))
+      chromaticities = Imf::chromaticities (file_.header (0));
     else
       return NULL;
 
-    if (Imf::hasWhiteLuminance (file_.header ()))
-      whiteLuminance = Imf::whiteLuminance (file_.header ());
+    if (Imf::hasWhiteLuminance (file_.header (0)))
+      whiteLuminance = Imf::whiteLuminance (file_.header (0));
     else
       return NULL;
 
 #if 0
     std::cout << "hasChromaticities: "
-              << hasChromaticities (file_.header ())
+              << hasChromaticities (file_.header (0))
               << std::endl;
     std::cout << "hasWhiteLuminance: "
-              << hasWhiteLuminance (file_.header ())
+              << hasWhiteLuminance (file_.header (0))
               << std::endl;
     std::cout << whiteLuminance << std::endl;
     std::cout << chromaticities.red << std::endl;
@@ -366,7 +570,7 @@ struct _EXRLoader
 
   gchar *getComment() const {
     char *result = NULL;
-    const Imf::StringAttribute *comment = file_.header().findTypedAttribute<Imf::StringAttribute>("comment");
+    const Imf::StringAttribute *comment = file_.header(0).findTypedAttribute<Imf::StringAttribute>("comment");
     if (comment)
       result = g_strdup (comment->value().c_str());
     return result;
@@ -377,7 +581,7 @@ struct _EXRLoader
     guchar *exif_data = NULL;
     *size = 0;
 
-    const Imf::BlobAttribute *exif = file_.header().findTypedAttribute<Imf::BlobAttribute>("exif");
+    const Imf::BlobAttribute *exif = file_.header(0).findTypedAttribute<Imf::BlobAttribute>("exif");
 
     if (exif)
       {
@@ -399,7 +603,7 @@ struct _EXRLoader
   guchar *getXmp(guint *size) const {
     guchar *result = NULL;
     *size = 0;
-    const Imf::StringAttribute *xmp = file_.header().findTypedAttribute<Imf::StringAttribute>("xmp");
+    const Imf::StringAttribute *xmp = file_.header(0).findTypedAttribute<Imf::StringAttribute>("xmp");
     if (xmp)
       {
         *size = xmp->value().size();
@@ -409,17 +613,23 @@ struct _EXRLoader
   }
 
   size_t refcount_;
-  InputFile file_;
-  const Box2i data_window_;
-  const ChannelList& channels_;
-  PixelType pt_;
-  int bpc_;
-  EXRImageType image_type_;
-  bool has_alpha_;
-  std::string format_string_;
-  std::string unknown_channel_name_;
+  MultiPartInputFile file_;
+  std::vector<EXRLayer> layers_;
 };
 
+void
+exr_set_thread_count (int n_threads)
+{
+  // Don't let any exceptions propagate to the C layer.
+  try
+    {
+      setGlobalThreadCount (n_threads);
+    }
+  catch (...)
+    {
+    }
+}
+
 EXRLoader*
 exr_loader_new (const char *filename)
 {
@@ -456,13 +666,60 @@ exr_loader_unref (EXRLoader *loader)
 }
 
 int
-exr_loader_get_width (EXRLoader *loader)
+exr_loader_get_n_layers (EXRLoader *loader)
+{
+  // This does not throw.
+  return loader->getNLayers();
+}
+
+const char *
+exr_loader_get_layer_name (EXRLoader *loader,
+                           int layer)
+{
+  const char *name;
+  // Don't let any exceptions propagate to the C layer.
+  try
+    {
+      name = loader->getLayerName(layer);
+    }
+  catch (...)
+    {
+      name = NULL;
+    }
+
+  return name;
+}
+
+int
+exr_loader_get_n_levels (EXRLoader *loader)
+{
+  // This does not throw.
+  return loader->getNLevels();
+}
+
+void
+exr_loader_set_level (EXRLoader *loader,
+                      int level)
+{
+  // Don't let any exceptions propagate to the C layer.
+  try
+    {
+      loader->setLevel(level);
+    }
+  catch (...)
+    {
+    }
+}
+
+int
+exr_loader_get_width (EXRLoader *loader,
+                      int layer)
 {
   int width;
   // Don't let any exceptions propagate to the C layer.
   try
     {
-      width = loader->getWidth();
+      width = loader->getWidth(layer);
     }
   catch (...)
     {
@@ -473,13 +730,14 @@ exr_loader_get_width (EXRLoader *loader)
 }
 
 int
-exr_loader_get_height (EXRLoader *loader)
+exr_loader_get_height (EXRLoader *loader,
+                       int layer)
 {
   int height;
   // Don't let any exceptions propagate to the C layer.
   try
     {
-      height = loader->getHeight();
+      height = loader->getHeight(layer);
     }
   catch (...)
     {
@@ -489,25 +747,112 @@ exr_loader_get_height (EXRLoader *loader)
   return height;
 }
 
+void
+exr_loader_get_offsets (EXRLoader *loader,
+                        int layer,
+                        int *offset_x,
+                        int *offset_y)
+{
+  // Don't let any exceptions propagate to the C layer.
+  try
+    {
+      loader->getOffsets(layer, offset_x, offset_y);
+    }
+  catch (...)
+    {
+      *offset_x = 0;
+      *offset_y = 0;
+    }
+}
+
+int
+exr_loader_get_tile_height (EXRLoader *loader,
+                            int layer)
+{
+  int tile_height;
+  // Don't let any exceptions propagate to the C layer.
+  try
+    {
+      tile_height = loader->getTileHeight(layer);
+    }
+  catch (...)
+    {
+      tile_height = 0;
+    }
+
+  return tile_height;
+}
+
 EXRImageType
-exr_loader_get_image_type (EXRLoader *loader)
+exr_loader_get_image_type (EXRLoader *loader,
+                           int layer)
 {
-  // This does not throw.
-  return loader->getImageType();
+  EXRImageType image_type;
+  // Don't let any exceptions propagate to the C layer.
+  try
+    {
+      image_type = loader->getImageType(layer);
+    }
+  catch (...)
+    {
+      image_type = (EXRImageType) -1;
+    }
+
+  return image_type;
 }
 
 EXRPrecision
-exr_loader_get_precision (EXRLoader *loader)
+exr_loader_get_precision (EXRLoader *loader,
+                          int layer)
 {
-  // This does not throw.
-  return loader->getPrecision();
+  EXRPrecision precision;
+  // Don't let any exceptions propagate to the C layer.
+  try
+    {
+      precision = loader->getPrecision(layer);
+    }
+  catch (...)
+    {
+      precision = (EXRPrecision) -1;
+    }
+
+  return precision;
 }
 
 int
-exr_loader_has_alpha (EXRLoader *loader)
+exr_loader_has_alpha (EXRLoader *loader,
+                      int layer)
 {
-  // This does not throw.
-  return loader->hasAlpha();
+  int has_alpha;
+  // Don't let any exceptions propagate to the C layer.
+  try
+    {
+      has_alpha = loader->hasAlpha(layer);
+    }
+  catch (...)
+    {
+      has_alpha = 0;
+    }
+
+  return has_alpha;
+}
+
+const char *
+exr_loader_get_format (EXRLoader *loader,
+                       int layer)
+{
+  const char *format;
+  // Don't let any exceptions propagate to the C layer.
+  try
+    {
+      format = loader->getFormat(layer);
+    }
+  catch (...)
+    {
+      format = NULL;
+    }
+
+  return format;
 }
 
 GimpColorProfile *
@@ -537,16 +882,18 @@ exr_loader_get_xmp (EXRLoader *loader,
 }
 
 int
-exr_loader_read_pixel_row (EXRLoader *loader,
-                           char *pixels,
-                           int bpp,
-                           int row)
+exr_loader_read_pixels (EXRLoader *loader,
+                        int layer,
+                        char *pixels,
+                        int bpp,
+                        int row,
+                        int n_rows)
 {
   int retval = -1;
   // Don't let any exceptions propagate to the C layer.
   try
     {
-      retval = loader->readPixelRow(pixels, bpp, row);
+      retval = loader->readPixels(layer, pixels, bpp, row, n_rows);
     }
   catch (...)
     {
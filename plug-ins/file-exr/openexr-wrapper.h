@@ -41,29 +41,65 @@ typedef enum
 } EXRImageType;
 
 
-EXRLoader        * exr_loader_new            (const char *filename);
+void               exr_set_thread_count       (int         n_threads);
 
-EXRLoader        * exr_loader_ref            (EXRLoader  *loader);
-void               exr_loader_unref          (EXRLoader  *loader);
+EXRLoader        * exr_loader_new             (const char *filename);
 
-int                exr_loader_get_width      (EXRLoader  *loader);
-int                exr_loader_get_height     (EXRLoader  *loader);
+EXRLoader        * exr_loader_ref             (EXRLoader  *loader);
+void               exr_loader_unref           (EXRLoader  *loader);
 
-EXRPrecision       exr_loader_get_precision  (EXRLoader  *loader);
-EXRImageType       exr_loader_get_image_type (EXRLoader  *loader);
-int                exr_loader_has_alpha      (EXRLoader  *loader);
+/* A loader has one layer per part of a multi-part file, and one per
+ * channel name prefix ("diffuse.R", "diffuse.G", ...) of each part.
+ * Layer 0 is the first loadable layer of the first part.
+ */
+int                exr_loader_get_n_layers    (EXRLoader  *loader);
+const char       * exr_loader_get_layer_name  (EXRLoader  *loader,
+                                               int         layer);
+
+/* Selects the mipmap level read from tiled parts, clamped to the
+ * levels each part has. Parts without levels are read in full.
+ */
+int                exr_loader_get_n_levels    (EXRLoader  *loader);
+void               exr_loader_set_level       (EXRLoader  *loader,
+                                               int         level);
 
-GimpColorProfile * exr_loader_get_profile    (EXRLoader  *loader);
-gchar            * exr_loader_get_comment    (EXRLoader  *loader);
-guchar           * exr_loader_get_exif       (EXRLoader  *loader,
-                                              guint      *size);
-guchar           * exr_loader_get_xmp        (EXRLoader  *loader,
-                                              guint      *size);
+int                exr_loader_get_width       (EXRLoader  *loader,
+                                               int         layer);
+int                exr_loader_get_height      (EXRLoader  *loader,
+                                               int         layer);
+void               exr_loader_get_offsets     (EXRLoader  *loader,
+                                               int         layer,
+                                               int        *offset_x,
+                                               int        *offset_y);
+int                exr_loader_get_tile_height (EXRLoader  *loader,
+                                               int         layer);
 
-int                exr_loader_read_pixel_row (EXRLoader *loader,
-                                              char      *pixels,
-                                              int        bpp,
-                                              int        row);
+EXRPrecision       exr_loader_get_precision   (EXRLoader  *loader,
+                                               int         layer);
+EXRImageType       exr_loader_get_image_type  (EXRLoader  *loader,
+                                               int         layer);
+int                exr_loader_has_alpha       (EXRLoader  *loader,
+                                               int         layer);
+const char       * exr_loader_get_format      (EXRLoader  *loader,
+                                               int         layer);
+
+GimpColorProfile * exr_loader_get_profile     (EXRLoader  *loader);
+gchar            * exr_loader_get_comment     (EXRLoader  *loader);
+guchar           * exr_loader_get_exif        (EXRLoader  *loader,
+                                               guint      *size);
+guchar           * exr_loader_get_xmp         (EXRLoader  *loader,
+                                               guint      *size);
+
+/* Reads n_rows full rows, starting at row, into pixels. For tiled
+ * layers, row must be a multiple of the tile height, and so must
+ * n_rows unless the rows reach the bottom of the layer.
+ */
+int                exr_loader_read_pixels     (EXRLoader  *loader,
+                                               int         layer,
+                                               char       *pixels,
+                                               int         bpp,
+                                               int         row,
+                                               int         n_rows);
 
 G_END_DECLS
 
@@ -46,6 +46,11 @@ static gboolean  jpeg_load_resolution       (GimpImage *image,
 
 static void      jpeg_load_sanitize_comment (gchar    *comment);
 
+static void      jpeg_load_scanlines        (struct jpeg_decompress_struct
+                                                       *cinfo,
+                                             guchar   **rows,
+                                             gint       n_rows);
+
 
 GimpImage * volatile  preview_image;
 GimpLayer *           preview_layer;
@@ -54,6 +59,7 @@ GimpImage *
 load_image (GFile        *file,
             GimpRunMode   runmode,
             gboolean      preview,
+            gint          scale_denom,
             gboolean     *resolution_loaded,
             gboolean     *ps_metadata_loaded,
             GError      **error)
@@ -166,6 +172,17 @@ load_image (GFile        *file,
 
   cinfo.dct_method = JDCT_FLOAT;
 
+  /* In draft mode, let the DCT scale the image down, and favor speed
+   * over quality.
+   */
+  if (scale_denom > 1)
+    {
+      cinfo.scale_num           = 1;
+      cinfo.scale_denom         = scale_denom;
+      cinfo.dct_method          = JDCT_IFAST;
+      cinfo.do_fancy_upsampling = FALSE;
+    }
+
   /* Step 5: Start decompressor */
 
   jpeg_start_decompress (&cinfo);
@@ -294,6 +311,23 @@ load_image (GFile        *file,
             *resolution_loaded = TRUE;
         }
 
+      /* A draft keeps the physical size of the image. */
+      if (scale_denom > 1)
+        {
+          gdouble xresolution;
+          gdouble yresolution;
+
+          gimp_image_get_resolution (image, &xresolution, &yresolution);
+          gimp_image_set_resolution (image,
+                                     xresolution * cinfo.output_width /
+                                     cinfo.image_width,
+                                     yresolution * cinfo.output_height /
+                                     cinfo.image_height);
+
+          if (resolution_loaded)
+            *resolution_loaded = TRUE;
+        }
+
       /* if we found any comments, then make a parasite for them */
       if (comment_buffer && comment_buffer->len)
         {
@@ -407,8 +441,7 @@ load_image (GFile        *file,
           goto set_buffer;
         }
 
-      for (i = 0; i < scanlines; i++)
-        jpeg_read_scanlines (&cinfo, (JSAMPARRAY) &rowbuf[i], 1);
+      jpeg_load_scanlines (&cinfo, rowbuf, scanlines);
 
     set_buffer:
       gegl_buffer_set (buffer,
@@ -560,6 +593,30 @@ jpeg_load_resolution (GimpImage                     *image,
   return FALSE;
 }
 
+/* Reads @n_rows scanlines. libjpeg returns at most a few rows per call,
+ * as many as it decodes at once, so this asks for all remaining rows
+ * until the band is full.
+ */
+static void
+jpeg_load_scanlines (struct jpeg_decompress_struct  *cinfo,
+                     guchar                        **rows,
+                     gint                            n_rows)
+{
+  gint n = 0;
+
+  while (n < n_rows)
+    {
+      gint read = jpeg_read_scanlines (cinfo, (JSAMPARRAY) rows + n,
+                                       n_rows - n);
+
+      /* Only a suspending data source can return no rows. */
+      if (read == 0)
+        break;
+
+      n += read;
+    }
+}
+
 /*
  * A number of JPEG files have comments written in a local character set
  * instead of UTF-8.  Some of these files may have been saved by older
@@ -588,6 +645,7 @@ jpeg_load_sanitize_comment (gchar *comment)
 
 GimpImage *
 load_thumbnail_image (GFile         *file,
+                      gint           size,
                       gint          *width,
                       gint          *height,
                       GimpImageType *type,
@@ -597,13 +655,15 @@ load_thumbnail_image (GFile         *file,
   struct jpeg_decompress_struct cinfo;
   struct my_error_mgr           jerr;
   FILE                         *infile   = NULL;
+  guchar * volatile             buf      = NULL;
+  guchar ** volatile            rowbuf   = NULL;
+  GimpImageBaseType             image_type;
 
   gimp_progress_init_printf (_("Opening thumbnail for '%s'"),
                              g_file_get_parse_name (file));
 
-  image = gimp_image_metadata_load_thumbnail (file, error);
-  if (! image)
-    return NULL;
+  /* Without an Exif thumbnail, the image itself is decoded, scaled down */
+  image = gimp_image_metadata_load_thumbnail (file, NULL);
 
   cinfo.err = jpeg_std_error (&jerr.pub);
   jerr.pub.error_exit     = my_error_exit;
@@ -629,10 +689,18 @@ load_thumbnail_image (GFile         *file,
        * and return.
        */
       jpeg_destroy_decompress (&cinfo);
+      fclose (infile);
+
+      g_free (rowbuf);
+      g_free (buf);
 
       if (image)
         gimp_image_delete (image);
 
+      g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                   _("Could not load thumbnail for '%s'"),
+                   g_file_get_parse_name (file));
+
       return NULL;
     }
 
@@ -647,25 +715,47 @@ load_thumbnail_image (GFile         *file,
 
   jpeg_read_header (&cinfo, TRUE);
 
-  jpeg_start_decompress (&cinfo);
+  *width  = cinfo.image_width;
+  *height = cinfo.image_height;
+
+  /* Step 4: without a thumbnail, let the DCT scale the image to the
+   * smallest size still covering the requested one, 1/2 to 1/8, and
+   * decode it as fast as possible.
+   */
+  if (! image)
+    {
+      cinfo.scale_num   = 1;
+      cinfo.scale_denom = 8;
+
+      while (cinfo.scale_denom > 1 &&
+             (gint) (MAX (cinfo.image_width,
+                          cinfo.image_height) / cinfo.scale_denom) < size)
+        cinfo.scale_denom /= 2;
 
-  *width  = cinfo.output_width;
-  *height = cinfo.output_height;
+      cinfo.dct_method          = JDCT_IFAST;
+      cinfo.do_fancy_upsampling = FALSE;
+      cinfo.do_block_smoothing  = FALSE;
+    }
+
+  jpeg_start_decompress (&cinfo);
 
   switch (cinfo.output_components)
     {
     case 1:
-      *type = GIMP_GRAY_IMAGE;
+      image_type = GIMP_GRAY;
+      *type      = GIMP_GRAY_IMAGE;
       break;
 
     case 3:
-      *type = GIMP_RGB_IMAGE;
+      image_type = GIMP_RGB;
+      *type      = GIMP_RGB_IMAGE;
       break;
 
     case 4:
       if (cinfo.out_color_space == JCS_CMYK)
         {
-          *type = GIMP_RGB_IMAGE;
+          image_type = GIMP_RGB;
+          *type      = GIMP_RGB_IMAGE;
           break;
         }
       /*fallthrough*/
@@ -676,12 +766,70 @@ load_thumbnail_image (GFile         *file,
                  cinfo.output_components, cinfo.out_color_space,
                  cinfo.jpeg_color_space);
 
-      gimp_image_delete (image);
-      image = NULL;
-      break;
+      if (image)
+        gimp_image_delete (image);
+
+      jpeg_destroy_decompress (&cinfo);
+      fclose (infile);
+
+      return NULL;
+    }
+
+  if (! image)
+    {
+      GimpLayer  *layer;
+      GeglBuffer *buffer;
+      const Babl *format;
+      gsize       rowstride;
+      guint       i;
+
+      /* Step 5: decode the scaled image in one go */
+      rowstride = cinfo.output_width * cinfo.output_components;
+      buf       = g_new (guchar, rowstride * cinfo.output_height);
+      rowbuf    = g_new (guchar *, cinfo.output_height);
+
+      for (i = 0; i < cinfo.output_height; i++)
+        rowbuf[i] = buf + rowstride * i;
+
+      jpeg_load_scanlines (&cinfo, rowbuf, cinfo.output_height);
+      jpeg_finish_decompress (&cinfo);
+
+      g_free (rowbuf);
+      rowbuf = NULL;
+
+      image = gimp_image_new (cinfo.output_width, cinfo.output_height,
+                              image_type);
+      gimp_image_undo_disable (image);
+
+      layer = gimp_layer_new (image, _("Background"),
+                              cinfo.output_width,
+                              cinfo.output_height,
+                              *type,
+                              100,
+                              gimp_image_get_default_new_layer_mode (image));
+      gimp_image_insert_layer (image, layer, NULL, 0);
+
+      if (cinfo.out_color_space == JCS_CMYK)
+        format = babl_format ("cmyk u8");
+      else
+        format = gimp_drawable_get_format (GIMP_DRAWABLE (layer));
+
+      buffer = gimp_drawable_get_buffer (GIMP_DRAWABLE (layer));
+
+      gegl_buffer_set (buffer,
+                       GEGL_RECTANGLE (0, 0,
+                                       cinfo.output_width,
+                                       cinfo.output_height),
+                       0,
+                       format,
+                       buf,
+                       GEGL_AUTO_ROWSTRIDE);
+
+      g_object_unref (buffer);
+      g_free (buf);
     }
 
-  /* Step 4: Release JPEG decompression object */
+  /* Step 6: Release JPEG decompression object */
 
   /* This is an important step since it will release a good deal
    * of memory.
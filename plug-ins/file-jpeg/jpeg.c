@@ -152,6 +152,17 @@ jpeg_create_procedure (GimpPlugIn  *plug_in,
 
       gimp_load_procedure_set_thumbnail_loader (GIMP_LOAD_PROCEDURE (procedure),
                                                 LOAD_THUMB_PROC);
+
+      gimp_procedure_add_choice_argument (procedure, "draft",
+                                          _("_Draft"),
+                                          _("Decode at a reduced size, with a fast "
+                                            "lower-quality DCT, to preview huge images"),
+                                          gimp_choice_new_with_values ("none",    1, _("Full size"),    NULL,
+                                                                       "half",    2, _("Half size"),    NULL,
+                                                                       "quarter", 4, _("Quarter size"), NULL,
+                                                                       "eighth",  8, _("Eighth size"),  NULL,
+                                                                       NULL),
+                                          "none", G_PARAM_READWRITE);
     }
   else if (! strcmp (name, LOAD_THUMB_PROC))
     {
@@ -161,8 +172,9 @@ jpeg_create_procedure (GimpPlugIn  *plug_in,
 
       gimp_procedure_set_documentation (procedure,
                                         _("Loads a thumbnail from a JPEG image"),
-                                        _("Loads a thumbnail from a JPEG image, "
-                                          "if one exists"),
+                                        _("Loads the Exif thumbnail of a JPEG "
+                                          "image if it has one, or else the image "
+                                          "decoded at a reduced size"),
                                         name);
       gimp_procedure_set_attribution (procedure,
                                       "Mukund Sivaraman <muks@mukund.org>, "
@@ -353,6 +365,7 @@ jpeg_load (GimpProcedure         *procedure,
     }
 
   image = load_image (file, run_mode, FALSE,
+                      gimp_procedure_config_get_choice_id (config, "draft"),
                       &resolution_loaded, &ps_metadata_loaded, &error);
 
   if (image)
@@ -394,7 +407,7 @@ jpeg_load_thumb (GimpProcedure       *procedure,
   preview_image = NULL;
   preview_layer = NULL;
 
-  image = load_thumbnail_image (file, &width, &height, &type,
+  image = load_thumbnail_image (file, size, &width, &height, &type,
                                 &error);
 
 
@@ -69,6 +69,7 @@
 #include <string.h>
 
 #include <glib/gstdio.h>
+#include <zlib.h>
 
 #include "libgimp/gimp.h"
 #include "libgimp/gimpui.h"
@@ -85,6 +86,11 @@
 #define PSD_UNIT_INCH 1
 #define PSD_UNIT_CM   2
 
+/* Channel data is read and compressed in batches of rows of about this
+ * many pixels.
+ */
+#define BATCH_PIXELS  (1 << 20)
+
 
 /* Local types etc
  */
@@ -104,7 +110,7 @@ typedef struct PsdLayer
 
 typedef struct PsdImageData
 {
-  gboolean           compression;
+  guint16            compression; /* Compression of the layer channels */
 
   gint32             image_height;
   gint32             image_width;
@@ -130,6 +136,32 @@ typedef struct PsdResourceOptions
   gdouble   clipping_path_flatness;
 } PSD_Resource_Options;
 
+typedef struct PsdBand
+{
+  guchar   *packed;       /* Compressed data of the band */
+  gsize     packed_len;
+  gsize     raw_len;      /* Length of the uncompressed data */
+  guint32   adler;        /* Checksum of the uncompressed data (ZIP) */
+  gboolean  failed;
+} PSDBand;
+
+typedef struct PsdBatch
+{
+  const guchar *data;        /* Pixels of the batch rows, all components */
+  gint          width;
+  gint          n_rows;
+  gint          bytes;       /* Bytes per pixel */
+  gint          bpc;
+  gint          chan;        /* Component to compress */
+  guint16       compression;
+  gint          band_height;
+  gint          n_bands;
+  gboolean      last;        /* Whether the batch ends the channel */
+  gint16       *lengths;     /* RLE lengths of the batch rows */
+  gsize         packed_size; /* Size of the compressed data buffers */
+  PSDBand      *bands;
+} PSDBatch;
+
 static PSD_Image_Data PSDImageData;
 
 /* Declare some local functions.
@@ -1033,90 +1065,314 @@ save_resources (GOutputStream        *output,
                    NULL, NULL /*FIXME: error*/);
 }
 
-static int
-get_compress_channel_data (guchar  *channel_data,
-                           gint32   channel_cols,
-                           gint32   channel_rows,
-                           gint32   stride,
-                           gint32   bpc,
-                           gint16  *LengthsTable,
-                           guchar  *remdata)
+static void
+get_channel_data (const guchar *src,
+                  guchar       *dest,
+                  gint          n_pixels,
+                  gint          bytes,
+                  gint          bpc)
 {
-  gint    i;
-  gint32  len;                 /* Length of compressed data */
-  guchar *start;               /* Starting position of a row in channel_data */
-
-  stride /= bpc;
+  gint i;
 
-  /* Pack channel data, and perform byte-order conversion */
+  /* Extract one component, and perform byte-order conversion */
   switch (bpc)
     {
     case 1:
-      {
-        if (stride > 1)
-          {
-            const guint8 *src  = (const guint8 *) channel_data;
-            guint8       *dest = (guint8       *) channel_data;
-
-            for (i = 0; i < channel_rows * channel_cols; i++)
-              {
-                *dest = *src;
+      for (i = 0; i < n_pixels; i++)
+        {
+          *dest++ = *src;
 
-                dest++;
-                src += stride;
-              }
-          }
-      }
+          src += bytes;
+        }
       break;
 
     case 2:
       {
-        const guint16 *src  = (const guint16 *) channel_data;
-        guint16       *dest = (guint16       *) channel_data;
+        guint16 *d = (guint16 *) dest;
 
-        for (i = 0; i < channel_rows * channel_cols; i++)
+        for (i = 0; i < n_pixels; i++)
           {
-            *dest = GUINT16_TO_BE (*src);
+            *d++ = GUINT16_TO_BE (*(const guint16 *) src);
 
-            dest++;
-            src += stride;
+            src += bytes;
           }
       }
       break;
 
     case 4:
       {
-        const guint32 *src  = (const guint32 *) channel_data;
-        guint32       *dest = (guint32       *) channel_data;
+        guint32 *d = (guint32 *) dest;
 
-        for (i = 0; i < channel_rows * channel_cols; i++)
+        for (i = 0; i < n_pixels; i++)
           {
-            *dest = GUINT32_TO_BE (*src);
+            *d++ = GUINT32_TO_BE (*(const guint32 *) src);
 
-            dest++;
-            src += stride;
+            src += bytes;
           }
       }
       break;
 
     default:
-      g_return_val_if_reached (0);
+      g_return_if_reached ();
+    }
+}
+
+/* The reverse of the predictor decoding of psd-load.c, on big endian
+ * data.
+ */
+static void
+encode_predictor (guchar *data,
+                  gint    width,
+                  gint    height,
+                  gint    bpc)
+{
+  gint x, y;
+
+  for (y = 0; y < height; y++)
+    {
+      switch (bpc)
+        {
+        case 1:
+          {
+            guchar *row = data + (gsize) y * width;
+
+            for (x = width - 1; x > 0; x--)
+              row[x] -= row[x - 1];
+          }
+          break;
+
+        case 2:
+          {
+            guint16 *row = (guint16 *) data + (gsize) y * width;
+
+            for (x = width - 1; x > 0; x--)
+              row[x] = GUINT16_TO_BE (GUINT16_FROM_BE (row[x]) -
+                                      GUINT16_FROM_BE (row[x - 1]));
+          }
+          break;
+
+        case 4:
+          {
+            /* 32 bit values are split into byte planes, and the
+             * whole row is then delta encoded byte by byte.
+             */
+            guchar *row    = data + (gsize) y * width * 4;
+            guchar *planes = gegl_scratch_alloc (width * 4);
+            gint    k;
+
+            for (x = 0; x < width; x++)
+              for (k = 0; k < 4; k++)
+                planes[k * width + x] = row[x * 4 + k];
+
+            for (x = width * 4 - 1; x > 0; x--)
+              planes[x] -= planes[x - 1];
+
+            memcpy (row, planes, width * 4);
+            gegl_scratch_free (planes);
+          }
+          break;
+
+        default:
+          g_return_if_reached ();
+        }
     }
+}
 
-  /* For every row in the channel */
+static void
+compress_band (PSDBatch *batch,
+               gint      b)
+{
+  PSDBand *band    = &batch->bands[b];
+  gint     row0    = b * batch->band_height;
+  gint     n_rows  = MIN (batch->band_height, batch->n_rows - row0);
+  gint     row_len = batch->width * batch->bpc;
+  guchar  *data;
+  gint     y;
+
+  band->raw_len = (gsize) n_rows * row_len;
+
+  data = gegl_scratch_alloc (band->raw_len);
+
+  get_channel_data (batch->data +
+                    ((gsize) row0 * batch->width * batch->bytes +
+                     batch->chan * batch->bpc),
+                    data, batch->width * n_rows,
+                    batch->bytes, batch->bpc);
 
-  len = 0;
-  for (i = 0; i < channel_rows; i++)
+  if (batch->compression == PSD_COMP_RLE)
     {
-      start = channel_data + i * channel_cols * bpc;
+      band->packed_len = 0;
+
+      for (y = 0; y < n_rows; y++)
+        {
+          gint32 packed_len;
+
+          packed_len = pack_pb_line (data + y * row_len, row_len,
+                                     band->packed + band->packed_len);
 
-      /* Create packed data for this row */
-      LengthsTable[i] = pack_pb_line (start, channel_cols * bpc,
-                                      &remdata[len]);
-      len += LengthsTable[i];
+          batch->lengths[row0 + y] = packed_len;
+          band->packed_len += packed_len;
+        }
     }
+  else
+    {
+      z_stream zs   = { 0, };
+      gboolean last = batch->last && b == batch->n_bands - 1;
+      gint     ret;
+
+      if (batch->compression == PSD_COMP_ZIP_PRED)
+        encode_predictor (data, batch->width, n_rows, batch->bpc);
+
+      band->adler = adler32 (adler32 (0L, Z_NULL, 0), data, band->raw_len);
+
+      /* Each band is a raw deflate stream ending on a byte boundary, so
+       * that the bands can be concatenated into a single zlib stream.
+       */
+      if (deflateInit2 (&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                        -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        {
+          band->failed = TRUE;
+          gegl_scratch_free (data);
+          return;
+        }
+
+      zs.next_in   = data;
+      zs.avail_in  = band->raw_len;
+      zs.next_out  = band->packed;
+      zs.avail_out = batch->packed_size;
+
+      ret = deflate (&zs, last ? Z_FINISH : Z_SYNC_FLUSH);
+
+      if (last)
+        band->failed = (ret != Z_STREAM_END);
+      else
+        band->failed = (ret != Z_OK || zs.avail_in > 0 || zs.avail_out == 0);
+
+      band->packed_len = batch->packed_size - zs.avail_out;
+
+      deflateEnd (&zs);
+    }
+
+  gegl_scratch_free (data);
+}
+
+static void
+compress_bands (gint      i,
+                gint      n,
+                PSDBatch *batch)
+{
+  for (; i < batch->n_bands; i += n)
+    compress_band (batch, i);
+}
+
+/* Writes the compressed data of one component of the buffer, and fills
+ * LengthsTable for RLE.  The data is read and compressed one batch of
+ * rows at a time, the bands of a batch being compressed in parallel.
+ * Returns the length of the written data.
+ */
+static gsize
+write_channel_data (GOutputStream *output,
+                    GeglBuffer    *buffer,
+                    const Babl    *format,
+                    gint           chan,
+                    gint           width,
+                    gint           height,
+                    guint16        compression,
+                    gint16        *LengthsTable)
+{
+  PSDBatch  batch       = { 0, };
+  gint      tile_height = gimp_tile_height ();
+  gint      batch_height;
+  gint      max_bands;
+  guchar   *data;
+  gsize     len         = 0;
+  guint32   adler       = adler32 (0L, Z_NULL, 0);
+  gint      y, b;
+
+  if (width == 0 || height == 0)
+    return 0;
+
+  batch.width       = width;
+  batch.bytes       = babl_format_get_bytes_per_pixel (format);
+  batch.bpc         = batch.bytes / babl_format_get_n_components (format);
+  batch.chan        = chan;
+  batch.compression = compression;
+  batch.band_height = tile_height;
+
+  batch_height = MAX (BATCH_PIXELS / width / tile_height, 1) * tile_height;
+  batch_height = MIN (batch_height, height);
+  max_bands    = (batch_height + tile_height - 1) / tile_height;
+
+  if (compression == PSD_COMP_RLE)
+    batch.packed_size = tile_height * (width + 10 + (width / 100)) * batch.bpc;
+  else
+    batch.packed_size = compressBound (tile_height * width * batch.bpc) + 16;
+
+  data        = g_new (guchar, (gsize) batch_height * width * batch.bytes);
+  batch.data  = data;
+  batch.bands = g_new0 (PSDBand, max_bands);
+
+  for (b = 0; b < max_bands; b++)
+    batch.bands[b].packed = g_malloc (batch.packed_size);
+
+  if (compression != PSD_COMP_RLE)
+    {
+      static const guchar zlib_header[2] = { 0x78, 0x9c };
+
+      xfwrite (output, zlib_header, sizeof (zlib_header), "zlib header");
+      len += sizeof (zlib_header);
+    }
+
+  for (y = 0; y < height; y += batch_height)
+    {
+      batch.n_rows  = MIN (batch_height, height - y);
+      batch.n_bands = (batch.n_rows + tile_height - 1) / tile_height;
+      batch.last    = (y + batch.n_rows == height);
+      batch.lengths = &LengthsTable[y];
+
+      gegl_buffer_get (buffer,
+                       GEGL_RECTANGLE (0, y, width, batch.n_rows),
+                       1.0, format, data,
+                       GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+      gegl_parallel_distribute (batch.n_bands,
+                                (GeglParallelDistributeFunc) compress_bands,
+                                &batch);
+
+      for (b = 0; b < batch.n_bands; b++)
+        {
+          PSDBand *band = &batch.bands[b];
+
+          if (band->failed)
+            {
+              g_printerr ("%s: Error while compressing channel data\n",
+                          G_STRFUNC);
+              gimp_quit ();
+            }
+
+          xfwrite (output, band->packed, band->packed_len,
+                   "Compressed pixel data");
+          len += band->packed_len;
+
+          if (compression != PSD_COMP_RLE)
+            adler = adler32_combine (adler, band->adler, band->raw_len);
+
+          IFDBG(3) g_debug ("\t\t\t\t. Writing compressed pixels, stream of %"
+                            G_GSIZE_FORMAT, band->packed_len);
+        }
+    }
+
+  if (compression != PSD_COMP_RLE)
+    {
+      write_gint32 (output, adler, "zlib checksum");
+      len += 4;
+    }
+
+  for (b = 0; b < max_bands; b++)
+    g_free (batch.bands[b].packed);
+  g_free (batch.bands);
+  g_free (data);
 
-  /*  return((len + channel_rows * sizeof (gint16)) + sizeof (gint16));*/
   return len;
 }
 
@@ -1706,19 +1962,16 @@ write_pixel_data (GOutputStream  *output,
   const Babl       *type;
   GimpColorProfile *profile;
   GimpLayerMask    *mask;
-  gint32            tile_height = gimp_tile_height ();
   gint32            height = gegl_buffer_get_height (buffer);
   gint32            width  = gegl_buffer_get_width (buffer);
   gint32            bytes;
   gint32            components;
   gint32            bpc;
   gint32            colors;
-  gint32            y;
+  guint16           compression;
   gsize             len;                  /* Length of compressed data */
   gint16           *LengthsTable;         /* Lengths of every compressed row */
-  guchar           *rledata;              /* Compressed data from a region */
-  guchar           *data;                 /* Temporary copy of pixel data */
-  goffset           length_table_pos;     /* position in file of the length table */
+  goffset           length_table_pos = 0; /* position in file of the length table */
   int               i, j;
 
   IFDBG(1) g_debug ("Function: write_pixel_data, drw %d, lto %" G_GOFFSET_FORMAT,
@@ -1788,11 +2041,14 @@ write_pixel_data (GOutputStream  *output,
       ! gimp_drawable_is_indexed (drawable))
     colors -= 1;
 
-  LengthsTable = g_new (gint16, height);
-  rledata = g_new (guchar, (MIN (height, tile_height) *
-                            (width + 10 + (width / 100))) * bpc);
+  /* The image data section is always RLE compressed. ZIP is used with
+   * prediction for 16 and 32 bit data.
+   */
+  compression = (ltable_offset > 0) ? PSD_COMP_RLE : PSDImageData.compression;
+  if (compression == PSD_COMP_ZIP && bpc > 1)
+    compression = PSD_COMP_ZIP_PRED;
 
-  data = g_new (guchar, MIN (height, tile_height) * width * bytes);
+  LengthsTable = g_new (gint16, height);
 
   /* groups have empty channel data */
   if (gimp_item_is_group (GIMP_ITEM (drawable)))
@@ -1825,11 +2081,15 @@ write_pixel_data (GOutputStream  *output,
 
       if (ChanLenPosition)
         {
-          write_gint16 (output, 1, "Compression type (RLE)");
+          write_gint16 (output, compression, "Compression type");
           len += 2;
         }
 
-      if (ltable_offset > 0)
+      if (compression != PSD_COMP_RLE)
+        {
+          IFDBG(3) g_debug ("\t\t\t\t. ZIP compression, no ltable");
+        }
+      else if (ltable_offset > 0)
         {
           length_table_pos = ltable_offset + 2 * chan * height;
         }
@@ -1845,33 +2105,20 @@ write_pixel_data (GOutputStream  *output,
                             length_table_pos, len);
         }
 
-      for (y = 0; y < height; y += tile_height)
+      len += write_channel_data (output, buffer, format, chan,
+                                 width, height, compression,
+                                 LengthsTable);
+
+      if (compression == PSD_COMP_RLE)
         {
-          int tlen;
-          gegl_buffer_get (buffer,
-                           GEGL_RECTANGLE (0, y,
-                                           width,
-                                           MIN (height - y, tile_height)),
-                           1.0, format, data,
-                           GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
-          tlen = get_compress_channel_data (&data[chan * bpc],
-                                            width,
-                                            MIN(height - y, tile_height),
-                                            bytes, bpc,
-                                            &LengthsTable[y],
-                                            rledata);
-          len += tlen;
-          xfwrite (output, rledata, tlen, "Compressed pixel data");
-          IFDBG(3) g_debug ("\t\t\t\t. Writing compressed pixels, stream of %d", tlen);
+          /* Write compressed lengths table */
+          g_seekable_seek (G_SEEKABLE (output),
+                           length_table_pos, G_SEEK_SET,
+                           NULL, NULL /*FIXME: error*/);
+          for (j = 0; j < height; j++) /* write real length table */
+            write_gint16 (output, LengthsTable[j], "RLE length");
         }
 
-      /* Write compressed lengths table */
-      g_seekable_seek (G_SEEKABLE (output),
-                       length_table_pos, G_SEEK_SET,
-                       NULL, NULL /*FIXME: error*/);
-      for (j = 0; j < height; j++) /* write real length table */
-        write_gint16 (output, LengthsTable[j], "RLE length");
-
       if (ChanLenPosition)    /* Update total compressed length */
         {
           g_seekable_seek (G_SEEKABLE (output),
@@ -1899,12 +2146,16 @@ write_pixel_data (GOutputStream  *output,
 
       if (ChanLenPosition)
         {
-          write_gint16 (output, 1, "Compression type (RLE)");
+          write_gint16 (output, compression, "Compression type");
           len += 2;
           IFDBG(3) g_debug ("\t\t\t\t. ChanLenPos, len %" G_GSIZE_FORMAT, len);
         }
 
-      if (ltable_offset > 0)
+      if (compression != PSD_COMP_RLE)
+        {
+          IFDBG(3) g_debug ("\t\t\t\t. ZIP compression, no ltable");
+        }
+      else if (ltable_offset > 0)
         {
           length_table_pos = ltable_offset + 2 * (components+1) * height;
           IFDBG(3) g_debug ("\t\t\t\t. ltable, pos %" G_GOFFSET_FORMAT,
@@ -1922,35 +2173,22 @@ write_pixel_data (GOutputStream  *output,
                             length_table_pos, len);
         }
 
-      for (y = 0; y < height; y += tile_height)
-        {
-          int tlen;
-          gegl_buffer_get (mbuffer,
-                           GEGL_RECTANGLE (0, y,
-                                           width,
-                                           MIN (height - y, tile_height)),
-                           1.0, mformat, data,
-                           GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
-          tlen = get_compress_channel_data (&data[0],
-                                            width,
-                                            MIN(height - y, tile_height),
-                                            bpc, bpc,
-                                            &LengthsTable[y],
-                                            rledata);
-          len += tlen;
-          xfwrite (output, rledata, tlen, "Compressed mask data");
-          IFDBG(3) g_debug ("\t\t\t\t. Writing compressed mask, stream of %d", tlen);
-        }
+      len += write_channel_data (output, mbuffer, mformat, 0,
+                                 width, height, compression,
+                                 LengthsTable);
 
-      /* Write compressed lengths table */
-      g_seekable_seek (G_SEEKABLE (output),
-                       length_table_pos, G_SEEK_SET,
-                       NULL, NULL /*FIXME: error*/);
-      for (j = 0; j < height; j++) /* write real length table */
+      if (compression == PSD_COMP_RLE)
         {
-          write_gint16 (output, LengthsTable[j], "RLE length");
-          IFDBG(3) g_debug ("\t\t\t\t. Updating RLE len %d",
-                            LengthsTable[j]);
+          /* Write compressed lengths table */
+          g_seekable_seek (G_SEEKABLE (output),
+                           length_table_pos, G_SEEK_SET,
+                           NULL, NULL /*FIXME: error*/);
+          for (j = 0; j < height; j++) /* write real length table */
+            {
+              write_gint16 (output, LengthsTable[j], "RLE length");
+              IFDBG(3) g_debug ("\t\t\t\t. Updating RLE len %d",
+                                LengthsTable[j]);
+            }
         }
 
       if (ChanLenPosition)    /* Update total compressed length */
@@ -1976,8 +2214,6 @@ write_pixel_data (GOutputStream  *output,
 
   g_object_unref (buffer);
 
-  g_free (data);
-  g_free (rledata);
   g_free (LengthsTable);
 }
 
@@ -2092,7 +2328,7 @@ get_image_data (GimpImage *image)
 {
   IFDBG(1) g_debug ("Function: get_image_data");
 
-  PSDImageData.compression = FALSE;
+  PSDImageData.compression = PSD_COMP_RLE;
 
   PSDImageData.image_height = gimp_image_get_height (image);
   IFDBG(1) g_debug ("\tGot number of rows: %d", PSDImageData.image_height);
@@ -2184,6 +2420,10 @@ export_image (GFile      *file,
 
   get_image_data (image);
 
+  PSDImageData.compression =
+    gimp_procedure_config_get_choice_id (GIMP_PROCEDURE_CONFIG (config),
+                                         "compression");
+
   /* Need to check each of the layers size individually also */
   for (iter = PSDImageData.lLayers; iter; iter = iter->next)
     {
@@ -2658,11 +2898,13 @@ save_dialog (GimpImage     *image,
 
   if (has_duotone_data)
     gimp_procedure_dialog_fill (GIMP_PROCEDURE_DIALOG (dialog),
+                                "compression",
                                 "cmyk-frame",
                                 "duotone-frame",
                                 NULL);
   else
     gimp_procedure_dialog_fill (GIMP_PROCEDURE_DIALOG (dialog),
+                                "compression",
                                 "cmyk-frame",
                                 NULL);
 
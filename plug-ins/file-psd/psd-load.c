@@ -39,12 +39,45 @@
 
 #define COMP_MODE_SIZE sizeof(guint16)
 
+/* Layer channels are read and decoded in bands of rows of about this
+ * many pixels, rounded to the tile height.
+ */
+#define BAND_PIXELS    (1 << 20)
+
+/* Minimum amount of compressed data read at once for ZIP channels */
+#define ZIP_READ_SIZE  65536
+
 typedef struct
 {
   gint32  group_index; /* first layer from the top that has clipping */
   gint32  last_index;  /* last layer that will be part of the clipping group */
 } ClippingInfo;
 
+/* A layer channel being read band by band */
+typedef struct
+{
+  PSDchannel *channel;
+  guint16     bps;
+  guint16     compression;
+  gboolean    has_data;       /* TRUE if there is pixel data to decode */
+  guint32     readline_len;   /* length of a row in the file, unpacked */
+  guint32     row_len;        /* length of a decoded row */
+  guint64     offset;         /* file offset of the next data to read */
+  guint64     remaining;      /* compressed data left to read (ZIP) */
+  guint32    *rle_pack_len;
+  gint        row;            /* first row of the current band */
+  gint        n_rows;         /* number of rows in the current band */
+  gchar      *packed;         /* compressed data of the band */
+  gsize       packed_size;
+  gchar      *raw;            /* unpacked rows, when not decoded in place */
+  gchar      *band;           /* decoded rows of the band */
+  gsize       band_size;
+  z_stream    zs;
+  gboolean    zs_active;
+  gboolean    needs_input;    /* ZIP data ran out before the band end */
+  gboolean    failed;
+} PSDChannelStream;
+
 
 /*  Local function prototypes  */
 static gint             read_header_block          (PSDimage       *img_a,
@@ -117,12 +150,6 @@ static void             free_lyr_a                 (PSDlayer      **lyr_a,
 static void             free_lyr_chn               (PSDchannel    **lyr_chn,
                                                     gint            channel_count);
 
-static gboolean         read_RLE_channel           (PSDimage       *img_a,
-                                                    PSDchannel     *lyr_chn,
-                                                    guint64         channel_data_len,
-                                                    GInputStream   *input,
-                                                    GError        **error);
-
 static gint             read_channel_data          (PSDchannel     *channel,
                                                     guint16         bps,
                                                     guint16         compression,
@@ -141,6 +168,25 @@ static void             convert_1_bit              (const gchar    *src,
                                                     guint32         rows,
                                                     guint32         columns);
 
+static gboolean         init_channel_stream        (PSDChannelStream *stream,
+                                                    PSDimage         *img_a,
+                                                    PSDchannel       *channel,
+                                                    guint64           offset,
+                                                    guint64           data_len,
+                                                    GInputStream     *input,
+                                                    GError          **error);
+
+static gboolean         read_channel_band          (PSDChannelStream **streams,
+                                                    gint               n_streams,
+                                                    gint               n_rows,
+                                                    GInputStream      *input,
+                                                    GError           **error);
+
+static void             free_channel_streams       (PSDChannelStream *streams,
+                                                    gint              n_streams);
+
+static gint             get_band_height            (gint              columns);
+
 static const Babl*      get_layer_format           (PSDimage       *img_a,
                                                     gboolean        alpha);
 static const Babl*      get_channel_format         (PSDimage       *img_a);
@@ -1765,57 +1811,6 @@ psd_convert_lab_to_srgb (PSDimage *img_a,
   return (guchar*) dst;
 }
 
-static gboolean
-read_RLE_channel (PSDimage      *img_a,
-                  PSDchannel    *lyr_chn,
-                  guint64        channel_data_len,
-                  GInputStream  *input,
-                  GError       **error)
-{
-  gint      rle_count_size = (img_a->version == 1 ? 2 : 4);
-  gint      rle_row_size   = lyr_chn->rows * rle_count_size;
-  guint32  *rle_pack_len;
-  gint      rowi;
-
-  IFDBG(4) g_debug ("RLE channel length %" G_GSIZE_FORMAT
-                    ", RLE length data: %d, "
-                    "RLE data block: %" G_GSIZE_FORMAT,
-                    channel_data_len - 2,
-                    rle_row_size,
-                    (channel_data_len - 2 - rle_row_size));
-  rle_pack_len = g_malloc (lyr_chn->rows * 4); /* Always 4 since this is the data size in memory. */
-  for (rowi = 0; rowi < lyr_chn->rows; ++rowi)
-    {
-      if (psd_read (input, &rle_pack_len[rowi], rle_count_size,
-                    error) < rle_count_size)
-        {
-          psd_set_error (error);
-          g_free (rle_pack_len);
-          return FALSE;
-        }
-      if (img_a->version == 1)
-        rle_pack_len[rowi] = img_a->ibm_pc_format                 ?
-                             GUINT16_FROM_LE (rle_pack_len[rowi]) :
-                             GUINT16_FROM_BE (rle_pack_len[rowi]);
-      else
-        rle_pack_len[rowi] = img_a->ibm_pc_format                 ?
-                             GUINT32_FROM_LE (rle_pack_len[rowi]) :
-                             GUINT32_FROM_BE (rle_pack_len[rowi]);
-    }
-
-  if (read_channel_data (lyr_chn, img_a->bps,
-                         PSD_COMP_RLE, rle_pack_len, input, 0,
-                         error) < 1)
-    {
-      psd_set_error (error);
-      g_free (rle_pack_len);
-      return FALSE;
-    }
-
-  g_free (rle_pack_len);
-  return TRUE;
-}
-
 static void
 free_lyr_chn (PSDchannel **lyr_chn, gint channel_count)
 {
@@ -2014,6 +2009,8 @@ add_layers (GimpImage     *image,
             GError       **error)
 {
   PSDchannel          **lyr_chn;
+  PSDChannelStream     *chn_stream;
+  PSDChannelStream     *band_chn[MAX_CHANNELS];
   GArray               *parent_group_stack;
   GimpLayer            *parent_group = NULL;
   guint16               alpha_chn;
@@ -2021,6 +2018,7 @@ add_layers (GimpImage     *image,
   guint16               layer_channels, base_channels;
   guint16               channel_idx[MAX_CHANNELS];
   guint16               bps;
+  guint64               chn_offset;            /* Channel data offset */
   gint32                l_x;                   /* Layer x */
   gint32                l_y;                   /* Layer y */
   gint32                l_w;                   /* Layer width */
@@ -2052,11 +2050,7 @@ add_layers (GimpImage     *image,
     }
 
   /* Layered image - Photoshop 3 style */
-  if (! psd_seek (input, img_a->layer_data_start, G_SEEK_SET, error))
-    {
-      psd_set_error (error);
-      return -1;
-    }
+  chn_offset = img_a->layer_data_start;
 
   mark_clipping_groups (img_a, lyr_a);
 
@@ -2090,9 +2084,12 @@ add_layers (GimpImage     *image,
       IFDBG(2) g_debug ("Number of channels: %d", lyr_a[lidx]->num_channels);
       /* Create pointer array for the channel records */
       lyr_chn = g_new0 (PSDchannel *, lyr_a[lidx]->num_channels);
+      chn_stream = g_new0 (PSDChannelStream, lyr_a[lidx]->num_channels);
       for (cidx = 0; cidx < lyr_a[lidx]->num_channels; ++cidx)
         {
-          guint16 comp_mode = PSD_COMP_RAW;
+          guint64 data_offset = chn_offset;
+
+          chn_offset += lyr_a[lidx]->chn_info[cidx].data_len;
 
           /* Allocate channel record */
           lyr_chn[cidx] = g_malloc (sizeof (PSDchannel) );
@@ -2103,17 +2100,7 @@ add_layers (GimpImage     *image,
           lyr_chn[cidx]->data = NULL;
 
           if (lyr_chn[cidx]->id == PSD_CHANNEL_EXTRA_MASK)
-            {
-              if (! psd_seek (input, lyr_a[lidx]->chn_info[cidx].data_len,
-                              G_SEEK_CUR, error))
-                {
-                  psd_set_error (error);
-                  free_lyr_chn (lyr_chn, lyr_a[lidx]->num_channels);
-                  return -1;
-                }
-
-              continue;
-            }
+            continue;
           else if (lyr_chn[cidx]->id == PSD_CHANNEL_MASK)
             {
               /* Works around a bug in panotools psd files where the layer mask
@@ -2144,73 +2131,18 @@ add_layers (GimpImage     *image,
                             lyr_chn[cidx]->columns,
                             lyr_chn[cidx]->rows);
 
-          /* Only read channel data if there is any channel
-           * data. Note that the channel data can contain a
-           * compression method but no actual data.
+          /* Only the compression mode and the RLE row lengths are
+           * read here; the pixel data is read band by band when the
+           * layer is drawn.
            */
-          if (lyr_a[lidx]->chn_info[cidx].data_len >= COMP_MODE_SIZE)
+          if (! init_channel_stream (&chn_stream[cidx], img_a, lyr_chn[cidx],
+                                     data_offset,
+                                     lyr_a[lidx]->chn_info[cidx].data_len,
+                                     input, error))
             {
-              if (psd_read (input, &comp_mode, COMP_MODE_SIZE, error) < COMP_MODE_SIZE)
-                {
-                  psd_set_error (error);
-                  free_lyr_chn (lyr_chn, lyr_a[lidx]->num_channels);
-                  return -1;
-                }
-
-              if (! img_a->ibm_pc_format)
-                comp_mode = GUINT16_FROM_BE (comp_mode);
-              else
-                comp_mode = GUINT16_FROM_LE (comp_mode);
-              IFDBG(3) g_debug ("Compression mode: %d", comp_mode);
-            }
-          if (lyr_a[lidx]->chn_info[cidx].data_len > COMP_MODE_SIZE)
-            {
-              switch (comp_mode)
-                {
-                  case PSD_COMP_RAW:        /* Planar raw data */
-                    IFDBG(3) g_debug ("Raw data length: %" G_GSIZE_FORMAT,
-                                      lyr_a[lidx]->chn_info[cidx].data_len - 2);
-                    if (read_channel_data (lyr_chn[cidx], img_a->bps,
-                                           PSD_COMP_RAW, NULL, input, 0,
-                                           error) < 1)
-                      {
-                        psd_set_error (error);
-                        free_lyr_chn (lyr_chn, lyr_a[lidx]->num_channels);
-                        return -1;
-                      }
-                    break;
-
-                  case PSD_COMP_RLE:        /* Packbits */
-                    if (! read_RLE_channel (img_a, lyr_chn[cidx],
-                                            lyr_a[lidx]->chn_info[cidx].data_len,
-                                            input, error))
-                      {
-                        psd_set_error (error);
-                        free_lyr_chn (lyr_chn, lyr_a[lidx]->num_channels);
-                        return -1;
-                      }
-                    break;
-
-                  case PSD_COMP_ZIP:                 /* ? */
-                  case PSD_COMP_ZIP_PRED:
-                    if (read_channel_data (lyr_chn[cidx], img_a->bps,
-                                           comp_mode, NULL, input,
-                                           lyr_a[lidx]->chn_info[cidx].data_len - 2,
-                                           error) < 1)
-                      {
-                        psd_set_error (error);
-                        free_lyr_chn (lyr_chn, lyr_a[lidx]->num_channels);
-                        return -1;
-                      }
-                    break;
-
-                  default:
-                    g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
-                                 _("Unsupported compression mode: %d"), comp_mode);
-                    free_lyr_chn (lyr_chn, lyr_a[lidx]->num_channels);
-                    return -1;
-                    break;
-                }
+              free_channel_streams (chn_stream, lyr_a[lidx]->num_channels);
+              free_lyr_chn (lyr_chn, lyr_a[lidx]->num_channels);
+              return -1;
             }
         }
 
@@ -2256,18 +2188,13 @@ add_layers (GimpImage     *image,
                   user_mask = TRUE;
                   user_mask_chn = cidx;
                 }
-              else
-                {
-                  /* Not using this mask, make sure it gets freed. */
-                  g_free (lyr_chn[cidx]->data);
-                }
             }
           else if (lyr_chn[cidx]->id == PSD_CHANNEL_ALPHA)
             {
               alpha = TRUE;
               alpha_chn = cidx;
             }
-          else if (lyr_chn[cidx]->data)
+          else if (chn_stream[cidx].has_data)
             {
               if (layer_channels < base_channels)
                 {
@@ -2549,92 +2476,96 @@ add_layers (GimpImage     *image,
                 }
               else
                 {
-                  GeglBufferIterator *iter;
+                  const Babl *format    = get_layer_format (img_a, alpha);
+                  gint        band_h    = get_band_height (l_w);
+                  gint        n_band    = MIN (base_channels, layer_channels);
+                  guint8     *pixels;
+                  guint8     *converted = NULL;
+                  gint        dst_step;
+                  gint        y;
 
                   bps = img_a->bps / 8;
                   if (bps == 0)
                     bps++;
 
+                  dst_step = bps * base_channels;
+
+                  for (cidx = 0; cidx < n_band; ++cidx)
+                    band_chn[cidx] = &chn_stream[channel_idx[cidx]];
+
                   buffer = gimp_drawable_get_buffer (GIMP_DRAWABLE (layer));
 
-                  iter = gegl_buffer_iterator_new (
-                    buffer, NULL, 0, get_layer_format (img_a, alpha),
-                    GEGL_ACCESS_WRITE, GEGL_ABYSS_NONE, 1);
+                  pixels = g_malloc ((gsize) l_w * band_h * dst_step);
 
-                  while (gegl_buffer_iterator_next (iter))
+                  if (img_a->color_mode == PSD_CMYK || img_a->color_mode == PSD_LAB)
+                    converted = g_malloc ((gsize) l_w * band_h *
+                                          babl_format_get_bytes_per_pixel (format));
+
+                  for (y = 0; y < l_h; y += band_h)
                     {
-                      const GeglRectangle *roi      = &iter->items[0].roi;
-                      guint8              *dst0     = iter->items[0].data;
-                      gint                 src_step = bps;
-                      gint                 dst_step = bps * base_channels;
+                      gint n_rows = MIN (band_h, l_h - y);
 
-                      if (img_a->color_mode == PSD_CMYK || img_a->color_mode == PSD_LAB)
+                      if (! read_channel_band (band_chn, n_band, n_rows,
+                                               input, error))
                         {
-                          dst0 = gegl_scratch_alloc (base_channels * bps *
-                                                     iter->length);
+                          g_free (pixels);
+                          g_free (converted);
+                          g_object_unref (buffer);
+                          free_channel_streams (chn_stream, lyr_a[lidx]->num_channels);
+                          free_lyr_chn (lyr_chn, lyr_a[lidx]->num_channels);
+                          return -1;
                         }
 
                       for (cidx = 0; cidx < base_channels; ++cidx)
                         {
-                          gint b;
+                          const guint8 *src = NULL;
+                          gint          b;
 
-                          if (roi->x == 0 && roi->y == 0)
+                          if (y == 0)
                             IFDBG(3) g_debug ("Start channel %d", channel_idx[cidx]);
 
+                          /* a missing channel is left black */
+                          if (cidx < n_band && band_chn[cidx]->has_data)
+                            src = (const guint8 *) band_chn[cidx]->band;
+
                           for (b = 0; b < bps; ++b)
                             {
-                              guint8 *dst;
-                              gint    y;
+                              guint8 *dst = &pixels[cidx * bps + b];
+                              gsize   i;
 
-                              dst = &dst0[cidx * bps + b];
-
-                              for (y = 0; y < roi->height; y++)
+                              for (i = 0; i < (gsize) l_w * n_rows; ++i)
                                 {
-                                  const guint8 *src;
-                                  gint          x;
-
-                                  src = (const guint8 *)
-                                    &lyr_chn[channel_idx[cidx]]->data[
-                                      ((roi->y + y) * l_w +
-                                        roi->x)      * bps +
-                                      b];
-
-                                  for (x = 0; x < roi->width; ++x)
-                                    {
-                                      *dst = *src;
-
-                                      src += src_step;
-                                      dst += dst_step;
-                                    }
+                                  *dst = src ? src[i * bps + b] : 0;
+
+                                  dst += dst_step;
                                 }
                             }
                         }
 
                       if (img_a->color_mode == PSD_CMYK)
                         {
-                          psd_convert_cmyk_to_srgb (
-                            img_a,
-                            iter->items[0].data, dst0,
-                            roi->width, roi->height,
-                            alpha, error);
-
-                          gegl_scratch_free (dst0);
+                          psd_convert_cmyk_to_srgb (img_a,
+                                                    converted, pixels,
+                                                    l_w, n_rows,
+                                                    alpha, error);
                         }
                       else if (img_a->color_mode == PSD_LAB)
                         {
-                          psd_convert_lab_to_srgb (
-                            img_a,
-                            iter->items[0].data, dst0,
-                            roi->width, roi->height,
-                            alpha);
-
-                          gegl_scratch_free (dst0);
+                          psd_convert_lab_to_srgb (img_a,
+                                                   converted, pixels,
+                                                   l_w, n_rows,
+                                                   alpha);
                         }
-                    }
 
-                  for (cidx = 0; cidx < layer_channels; ++cidx)
-                    g_free (lyr_chn[channel_idx[cidx]]->data);
+                      gegl_buffer_set (buffer,
+                                       GEGL_RECTANGLE (0, y, l_w, n_rows), 0,
+                                       format,
+                                       converted ? converted : pixels,
+                                       GEGL_AUTO_ROWSTRIDE);
+                    }
 
+                  g_free (pixels);
+                  g_free (converted);
                   g_object_unref (buffer);
                 }
             }
@@ -2692,19 +2623,54 @@ add_layers (GimpImage     *image,
 
                       IFDBG(3) g_debug ("New layer mask %d", gimp_item_get_id (GIMP_ITEM (mask)));
                       gimp_layer_add_mask (layer, mask);
-                      buffer = gimp_drawable_get_buffer (GIMP_DRAWABLE (mask));
-                      gegl_buffer_set (buffer,
-                                        &mask_rect,
-                                        0, get_mask_format (img_a),
-                                        lyr_chn[user_mask_chn]->data + (
-                                          (mask_rect.y - lm_y)  * lm_w +
-                                          (mask_rect.x - lm_x)) * bps,
-                                        lm_w * bps);
-                      g_object_unref (buffer);
+
+                      band_chn[0] = &chn_stream[user_mask_chn];
+
+                      if (band_chn[0]->has_data)
+                        {
+                          gint band_h = get_band_height (lm_w);
+                          gint y;
+
+                          buffer = gimp_drawable_get_buffer (GIMP_DRAWABLE (mask));
+
+                          /* Rows above the layer are read and dropped,
+                           * rows below it are not read at all.
+                           */
+                          for (y = 0; y < mask_rect.y + mask_rect.height - lm_y;
+                               y += band_h)
+                            {
+                              GeglRectangle band_rect;
+                              gint          n_rows = MIN (band_h, lm_h - y);
+
+                              if (! read_channel_band (band_chn, 1, n_rows,
+                                                       input, error))
+                                {
+                                  g_object_unref (buffer);
+                                  free_channel_streams (chn_stream, lyr_a[lidx]->num_channels);
+                                  free_lyr_chn (lyr_chn, lyr_a[lidx]->num_channels);
+                                  return -1;
+                                }
+
+                              if (gegl_rectangle_intersect (
+                                    &band_rect, &mask_rect,
+                                    GEGL_RECTANGLE (lm_x, lm_y + y, lm_w, n_rows)))
+                                {
+                                  gegl_buffer_set (buffer,
+                                                   &band_rect,
+                                                   0, get_mask_format (img_a),
+                                                   band_chn[0]->band + (
+                                                     (band_rect.y - lm_y - y) * lm_w +
+                                                     (band_rect.x - lm_x)) * bps,
+                                                   lm_w * bps);
+                                }
+                            }
+
+                          g_object_unref (buffer);
+                        }
+
                       gimp_layer_set_apply_mask (layer,
                                                  ! lyr_a[lidx]->layer_mask.mask_flags.disabled);
                     }
-                  g_free (lyr_chn[user_mask_chn]->data);
                 }
             }
 
@@ -2716,6 +2682,7 @@ add_layers (GimpImage     *image,
               }
         }
 
+      free_channel_streams (chn_stream, lyr_a[lidx]->num_channels);
       free_lyr_chn (lyr_chn, lyr_a[lidx]->num_channels);
 
       g_free (lyr_a[lidx]->chn_info);
@@ -3465,6 +3432,475 @@ read_channel_data (PSDchannel     *channel,
   return 1;
 }
 
+/*
+ * Layer channels are streamed: instead of loading each channel whole,
+ * the channels of a layer are read one band of rows at a time, and the
+ * channels of a band are decoded in parallel.
+ */
+
+static gboolean
+init_channel_stream (PSDChannelStream  *stream,
+                     PSDimage          *img_a,
+                     PSDchannel        *channel,
+                     guint64            offset,
+                     guint64            data_len,
+                     GInputStream      *input,
+                     GError           **error)
+{
+  guint16 comp_mode = PSD_COMP_RAW;
+
+  stream->channel = channel;
+  stream->bps     = img_a->bps;
+
+  /* Only read channel data if there is any channel
+   * data. Note that the channel data can contain a
+   * compression method but no actual data.
+   */
+  if (data_len < COMP_MODE_SIZE)
+    return TRUE;
+
+  if (! psd_seek (input, offset, G_SEEK_SET, error) ||
+      psd_read (input, &comp_mode, COMP_MODE_SIZE, error) < COMP_MODE_SIZE)
+    {
+      psd_set_error (error);
+      return FALSE;
+    }
+
+  if (! img_a->ibm_pc_format)
+    comp_mode = GUINT16_FROM_BE (comp_mode);
+  else
+    comp_mode = GUINT16_FROM_LE (comp_mode);
+  IFDBG(3) g_debug ("Compression mode: %d", comp_mode);
+
+  if (data_len == COMP_MODE_SIZE)
+    return TRUE;
+
+  switch (comp_mode)
+    {
+      case PSD_COMP_RAW:
+      case PSD_COMP_RLE:
+      case PSD_COMP_ZIP:
+      case PSD_COMP_ZIP_PRED:
+        break;
+
+      default:
+        g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                     _("Unsupported compression mode: %d"), comp_mode);
+        return FALSE;
+        break;
+    }
+
+  /* sanity check, int overflow check (avoid divisions by zero) */
+  if ((channel->rows == 0) || (channel->columns == 0) ||
+      (channel->rows > G_MAXINT32 / channel->columns / MAX (stream->bps / 8, 1)))
+    {
+      g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                   _("Unsupported or invalid channel size"));
+      return FALSE;
+    }
+
+  if (stream->bps == 1)
+    {
+      stream->readline_len = (channel->columns + 7) / 8;
+      stream->row_len      = channel->columns;
+    }
+  else
+    {
+      stream->readline_len = channel->columns * stream->bps / 8;
+      stream->row_len      = stream->readline_len;
+    }
+
+  offset   += COMP_MODE_SIZE;
+  data_len -= COMP_MODE_SIZE;
+
+  if (comp_mode == PSD_COMP_RLE)
+    {
+      gint rle_count_size = (img_a->version == 1 ? 2 : 4);
+      gint rowi;
+
+      IFDBG(4) g_debug ("RLE channel length %" G_GSIZE_FORMAT
+                        ", RLE length data: %d",
+                        data_len, channel->rows * rle_count_size);
+
+      /* Always 4 since this is the data size in memory. */
+      stream->rle_pack_len = g_malloc (channel->rows * 4);
+      for (rowi = 0; rowi < channel->rows; ++rowi)
+        {
+          if (psd_read (input, &stream->rle_pack_len[rowi], rle_count_size,
+                        error) < rle_count_size)
+            {
+              psd_set_error (error);
+              return FALSE;
+            }
+          if (img_a->version == 1)
+            stream->rle_pack_len[rowi] = img_a->ibm_pc_format                         ?
+                                         GUINT16_FROM_LE (stream->rle_pack_len[rowi]) :
+                                         GUINT16_FROM_BE (stream->rle_pack_len[rowi]);
+          else
+            stream->rle_pack_len[rowi] = img_a->ibm_pc_format                         ?
+                                         GUINT32_FROM_LE (stream->rle_pack_len[rowi]) :
+                                         GUINT32_FROM_BE (stream->rle_pack_len[rowi]);
+        }
+
+      offset += (guint64) channel->rows * rle_count_size;
+    }
+
+  stream->compression = comp_mode;
+  stream->offset      = offset;
+  stream->remaining   = data_len;
+  stream->has_data    = TRUE;
+
+  return TRUE;
+}
+
+static gboolean
+fill_zip_stream (PSDChannelStream  *stream,
+                 gsize              size,
+                 GInputStream      *input,
+                 GError           **error)
+{
+  gsize avail = stream->zs.avail_in;
+
+  size = MIN (size, stream->remaining);
+  if (size == 0)
+    return TRUE;
+
+  /* keep the data that was not inflated yet */
+  if (avail > 0 && stream->zs.next_in != (Bytef *) stream->packed)
+    memmove (stream->packed, stream->zs.next_in, avail);
+
+  if (avail + size > stream->packed_size)
+    {
+      stream->packed_size = avail + size;
+      stream->packed      = g_realloc (stream->packed, stream->packed_size);
+    }
+
+  if (! psd_seek (input, stream->offset, G_SEEK_SET, error) ||
+      psd_read (input, stream->packed + avail, size, error) < (gint) size)
+    {
+      psd_set_error (error);
+      return FALSE;
+    }
+
+  stream->offset    += size;
+  stream->remaining -= size;
+
+  stream->zs.next_in  = (Bytef *) stream->packed;
+  stream->zs.avail_in = avail + size;
+
+  return TRUE;
+}
+
+/* Reads the data of the next n_rows rows of the channel.  Runs on the
+ * main thread, since the input stream is not thread safe.
+ */
+static gboolean
+read_channel_stream (PSDChannelStream  *stream,
+                     gint               n_rows,
+                     GInputStream      *input,
+                     GError           **error)
+{
+  gsize  raw_size  = (gsize) n_rows * stream->readline_len;
+  gsize  band_size = (gsize) n_rows * stream->row_len;
+  gchar *dst;
+  gsize  size      = 0;
+  gint   i;
+
+  stream->n_rows = n_rows;
+
+  if (! stream->has_data)
+    return TRUE;
+
+  if (stream->band_size < band_size)
+    {
+      stream->band_size = band_size;
+      stream->band      = g_realloc (stream->band, band_size);
+
+      /* 1 bit data and 32 bit predictor data are not decoded in place */
+      if (stream->bps == 1 ||
+          (stream->bps == 32 && stream->compression == PSD_COMP_ZIP_PRED))
+        stream->raw = g_realloc (stream->raw, raw_size);
+    }
+
+  switch (stream->compression)
+    {
+      case PSD_COMP_RAW:
+        dst  = stream->raw ? stream->raw : stream->band;
+        size = raw_size;
+        break;
+
+      case PSD_COMP_RLE:
+        for (i = 0; i < n_rows; ++i)
+          size += stream->rle_pack_len[stream->row + i];
+
+        if (size > G_MAXINT32)
+          {
+            g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                         _("Unsupported or invalid channel size"));
+            return FALSE;
+          }
+
+        if (stream->packed_size < size)
+          {
+            stream->packed_size = size;
+            stream->packed      = g_realloc (stream->packed, size);
+          }
+        dst = stream->packed;
+        break;
+
+      case PSD_COMP_ZIP:
+      case PSD_COMP_ZIP_PRED:
+        if (! stream->zs_active)
+          {
+            stream->zs.zalloc = zzalloc;
+            stream->zs.zfree  = zzfree;
+
+            if (inflateInit (&stream->zs) != Z_OK)
+              {
+                g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                             _("Failed to decompress data"));
+                return FALSE;
+              }
+
+            stream->zs_active = TRUE;
+          }
+
+        /* compressed data is usually smaller than the unpacked rows */
+        if (stream->zs.avail_in < raw_size)
+          return fill_zip_stream (stream,
+                                  MAX (raw_size - stream->zs.avail_in,
+                                       ZIP_READ_SIZE),
+                                  input, error);
+        return TRUE;
+
+      default:
+        g_return_val_if_reached (FALSE);
+    }
+
+  if (! psd_seek (input, stream->offset, G_SEEK_SET, error) ||
+      psd_read (input, dst, size, error) < (gint) size)
+    {
+      psd_set_error (error);
+      return FALSE;
+    }
+
+  stream->offset += size;
+
+  return TRUE;
+}
+
+/* Decodes the rows read by read_channel_stream().  Runs on any thread. */
+static void
+decode_channel_stream (PSDChannelStream *stream)
+{
+  PSDchannel *channel  = stream->channel;
+  gsize       raw_size = (gsize) stream->n_rows * stream->readline_len;
+  gchar      *raw      = stream->raw ? stream->raw : stream->band;
+  gint        i, j;
+
+  if (! stream->has_data || stream->failed)
+    return;
+
+  switch (stream->compression)
+    {
+      case PSD_COMP_RLE:
+        {
+          const gchar *src = stream->packed;
+
+          for (i = 0; i < stream->n_rows; ++i)
+            {
+              guint32 len = stream->rle_pack_len[stream->row + i];
+
+              /* FIXME check for errors returned from decode packbits */
+              decode_packbits (src, raw + i * stream->readline_len,
+                               len, stream->readline_len);
+              src += len;
+            }
+        }
+        break;
+
+      case PSD_COMP_ZIP:
+      case PSD_COMP_ZIP_PRED:
+        if (! stream->needs_input)
+          {
+            stream->zs.next_out  = (Bytef *) raw;
+            stream->zs.avail_out = raw_size;
+          }
+        stream->needs_input = FALSE;
+
+        while (stream->zs.avail_out > 0)
+          {
+            gint ret = inflate (&stream->zs, Z_NO_FLUSH);
+
+            if (ret == Z_STREAM_END)
+              {
+                /* the data ended early, like a single inflate() would
+                 * leave the rest of the channel undefined.
+                 */
+                memset (stream->zs.next_out, 0, stream->zs.avail_out);
+                break;
+              }
+            else if (ret == Z_BUF_ERROR && stream->zs.avail_in == 0 &&
+                     stream->remaining > 0)
+              {
+                /* read_channel_band() feeds more data and calls us again */
+                stream->needs_input = TRUE;
+                return;
+              }
+            else if (ret != Z_OK)
+              {
+                stream->failed = TRUE;
+                return;
+              }
+          }
+        break;
+
+      default:
+        break;
+    }
+
+  /* Convert channel data to GIMP format */
+  switch (stream->bps)
+    {
+      case 32:
+        {
+          guint32 *data = (guint32 *) stream->band;
+          gsize    pos;
+
+          if (stream->compression == PSD_COMP_ZIP_PRED)
+            decode_32_bit_predictor (raw, stream->band,
+                                     stream->n_rows, channel->columns);
+
+          for (pos = 0; pos < (gsize) stream->n_rows * channel->columns; ++pos)
+            data[pos] = GUINT32_FROM_BE (data[pos]);
+        }
+        break;
+
+      case 16:
+        {
+          guint16 *data = (guint16 *) stream->band;
+          gsize    pos;
+
+          for (pos = 0; pos < (gsize) stream->n_rows * channel->columns; ++pos)
+            data[pos] = GUINT16_FROM_BE (data[pos]);
+
+          if (stream->compression == PSD_COMP_ZIP_PRED)
+            for (i = 0; i < stream->n_rows; ++i)
+              for (j = 1; j < channel->columns; ++j)
+                data[i * channel->columns + j] += data[i * channel->columns + j - 1];
+        }
+        break;
+
+      case 8:
+        if (stream->compression == PSD_COMP_ZIP_PRED)
+          for (i = 0; i < stream->n_rows; ++i)
+            for (j = 1; j < channel->columns; ++j)
+              stream->band[i * channel->columns + j] += stream->band[i * channel->columns + j - 1];
+        break;
+
+      case 1:
+        convert_1_bit (raw, stream->band, stream->n_rows, channel->columns);
+        break;
+
+      default:
+        stream->failed = TRUE;
+        return;
+    }
+
+  stream->row += stream->n_rows;
+}
+
+typedef struct
+{
+  PSDChannelStream **streams;
+  gint               n_streams;
+} DecodeBandData;
+
+static void
+decode_channel_band (gint            i,
+                     gint            n,
+                     DecodeBandData *data)
+{
+  for (; i < data->n_streams; i += n)
+    decode_channel_stream (data->streams[i]);
+}
+
+/* Reads and decodes the next n_rows rows of each of the streams into
+ * their band.  Streams without data are skipped.
+ */
+static gboolean
+read_channel_band (PSDChannelStream **streams,
+                   gint               n_streams,
+                   gint               n_rows,
+                   GInputStream      *input,
+                   GError           **error)
+{
+  DecodeBandData data = { streams, n_streams };
+  gint           i;
+
+  for (i = 0; i < n_streams; ++i)
+    {
+      if (! read_channel_stream (streams[i], n_rows, input, error))
+        return FALSE;
+    }
+
+  gegl_parallel_distribute (n_streams,
+                            (GeglParallelDistributeFunc) decode_channel_band,
+                            &data);
+
+  for (i = 0; i < n_streams; ++i)
+    {
+      PSDChannelStream *stream = streams[i];
+
+      while (stream->needs_input && ! stream->failed)
+        {
+          if (! fill_zip_stream (stream, ZIP_READ_SIZE, input, error))
+            return FALSE;
+
+          decode_channel_stream (stream);
+        }
+
+      if (stream->failed)
+        {
+          g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                       _("Failed to decompress data"));
+          return FALSE;
+        }
+    }
+
+  return TRUE;
+}
+
+static void
+free_channel_streams (PSDChannelStream *streams,
+                      gint              n_streams)
+{
+  gint i;
+
+  for (i = 0; i < n_streams; ++i)
+    {
+      if (streams[i].zs_active)
+        inflateEnd (&streams[i].zs);
+
+      g_free (streams[i].rle_pack_len);
+      g_free (streams[i].packed);
+      g_free (streams[i].raw);
+      g_free (streams[i].band);
+    }
+  g_free (streams);
+}
+
+static gint
+get_band_height (gint columns)
+{
+  gint tile_height = gimp_tile_height ();
+  gint n_tiles;
+
+  n_tiles = BAND_PIXELS / MAX (columns, 1) / tile_height;
+
+  return MAX (n_tiles, 1) * tile_height;
+}
+
 /*
  * For reference on zip predictor see:
  * - TIFFTN3d1.pdf
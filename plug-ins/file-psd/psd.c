@@ -276,6 +276,16 @@ psd_create_procedure (GimpPlugIn  *plug_in,
                                            "was attached to the image when originally imported."),
                                            FALSE,
                                            G_PARAM_READWRITE);
+
+      gimp_procedure_add_choice_argument (procedure, "compression",
+                                          _("Co_mpression"),
+                                          _("Compression of the layer data. "
+                                            "ZIP uses prediction for 16 and "
+                                            "32 bit data"),
+                                          gimp_choice_new_with_values ("rle", PSD_COMP_RLE, _("RLE (PackBits)"), NULL,
+                                                                       "zip", PSD_COMP_ZIP, _("ZIP"),            NULL,
+                                                                       NULL),
+                                          "rle", G_PARAM_READWRITE);
     }
   else if (! strcmp (name, LOAD_METADATA_PROC))
     {
@@ -62,6 +62,60 @@
 
 #define PLUG_IN_ROLE "gimp-file-tiff-export"
 
+/* Bound on the pixel data of a batch of strips or tiles */
+#define MAX_BATCH_SIZE (64 << 20)
+
+
+/* The fields which strips or tiles are encoded with, and which the
+ * overviews of a layer repeat
+ */
+typedef struct
+{
+  gushort   compression;
+  gshort    predictor;
+  gshort    photometric;
+  gshort    samplesperpixel;
+  gshort    bitspersample;
+  gshort    sampleformat;
+  gboolean  alpha;
+  gushort   extra_sample;
+  gboolean  cmyk;
+} TiffFields;
+
+typedef struct
+{
+  /* set by the caller */
+  TIFF         *tif;
+  GeglBuffer   *buffer;
+  const Babl   *format;
+  gint          level;          /* 0, or that of an overview */
+  gint          width;          /* of the directory */
+  gint          height;
+  gint          tile_size;      /* 0 for strips */
+  gint          rows_per_strip;
+  gboolean      is_bw;
+  gboolean      invert;
+
+  /* set up by write_chunks() */
+  gint          chunk_width;
+  gint          chunk_height;
+  gint          chunks_across;
+  gint          n_chunks;
+  gsize         row_size;
+  gsize         chunk_size;
+  gint          max_batch;
+  gint          n_batch;
+  guchar      **pixels;
+  gsize        *sizes;
+  guchar       *bytes;          /* unpacked monochrome pixels */
+  TIFF        **scratch;
+  gint          n_scratch;
+  guchar      **encoded;
+  gsize        *encoded_sizes;
+  gsize        *encoded_allocated;
+  gboolean     *failed;
+} TiffChunkWriter;
+
 
 static gboolean  save_paths             (TIFF          *tif,
                                          GimpImage     *image,
@@ -75,6 +129,33 @@ static void      byte2bit               (const guchar  *byteline,
                                          guchar        *bitline,
                                          gboolean       invert);
 
+static void      set_encoding_fields    (TIFF             *tif,
+                                         const TiffFields *fields);
+static void      set_layout_fields      (TIFF          *tif,
+                                         gint           width,
+                                         gint           height,
+                                         gint           tile_size,
+                                         gint           rows_per_strip);
+static gboolean  compression_is_parallel (gushort       compression);
+static gboolean  write_chunks           (TiffChunkWriter  *writer,
+                                         const TiffFields *fields,
+                                         gdouble           progress_start,
+                                         gdouble           progress_end,
+                                         GError          **error);
+static gboolean  save_overviews         (TIFF             *tif,
+                                         GeglBuffer       *buffer,
+                                         const Babl       *format,
+                                         const TiffFields *fields,
+                                         gint              n_levels,
+                                         gint              tile_size,
+                                         gint              rows_per_strip,
+                                         gdouble           xresolution,
+                                         gdouble           yresolution,
+                                         gushort           save_unit,
+                                         gdouble           progress_start,
+                                         gdouble           progress_end,
+                                         GError          **error);
+
 
 static void
 double_to_psd_fixed (gdouble  value,
@@ -246,6 +327,458 @@ save_paths (TIFF      *tif,
   return TRUE;
 }
 
+static void
+set_encoding_fields (TIFF             *tif,
+                     const TiffFields *fields)
+{
+  TIFFSetField (tif, TIFFTAG_BITSPERSAMPLE, fields->bitspersample);
+  TIFFSetField (tif, TIFFTAG_SAMPLEFORMAT, fields->sampleformat);
+  TIFFSetField (tif, TIFFTAG_COMPRESSION, fields->compression);
+
+  if ((fields->compression == COMPRESSION_LZW ||
+       fields->compression == COMPRESSION_ADOBE_DEFLATE) &&
+      (fields->predictor != 0))
+    {
+      TIFFSetField (tif, TIFFTAG_PREDICTOR, fields->predictor);
+    }
+
+  if (fields->alpha)
+    TIFFSetField (tif, TIFFTAG_EXTRASAMPLES, 1, &fields->extra_sample);
+
+  TIFFSetField (tif, TIFFTAG_PHOTOMETRIC, fields->photometric);
+  TIFFSetField (tif, TIFFTAG_SAMPLESPERPIXEL, fields->samplesperpixel);
+  TIFFSetField (tif, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+}
+
+static void
+set_layout_fields (TIFF *tif,
+                   gint  width,
+                   gint  height,
+                   gint  tile_size,
+                   gint  rows_per_strip)
+{
+  TIFFSetField (tif, TIFFTAG_IMAGEWIDTH, width);
+  TIFFSetField (tif, TIFFTAG_IMAGELENGTH, height);
+
+  if (tile_size > 0)
+    {
+      TIFFSetField (tif, TIFFTAG_TILEWIDTH, tile_size);
+      TIFFSetField (tif, TIFFTAG_TILELENGTH, tile_size);
+    }
+  else
+    {
+      TIFFSetField (tif, TIFFTAG_ROWSPERSTRIP, rows_per_strip);
+    }
+}
+
+/* Whether strips or tiles of @compression can be compressed on their
+ * own, in worker threads.  JPEG shares its tables between them, and
+ * the fax compressions are cheap enough.
+ */
+static gboolean
+compression_is_parallel (gushort compression)
+{
+  switch (compression)
+    {
+    case COMPRESSION_LZW:
+    case COMPRESSION_PACKBITS:
+    case COMPRESSION_DEFLATE:
+    case COMPRESSION_ADOBE_DEFLATE:
+#ifdef COMPRESSION_ZSTD
+    case COMPRESSION_ZSTD:
+#endif
+      return TRUE;
+
+    default:
+      return FALSE;
+    }
+}
+
+static void
+chunk_writer_get_chunk (TiffChunkWriter *writer,
+                        gint             chunk,
+                        gint            *x,
+                        gint            *y,
+                        gint            *cols,
+                        gint            *rows)
+{
+  *x = (chunk % writer->chunks_across) * writer->chunk_width;
+  *y = (chunk / writer->chunks_across) * writer->chunk_height;
+
+  *cols = MIN (writer->width  - *x, writer->chunk_width);
+  *rows = MIN (writer->height - *y, writer->chunk_height);
+}
+
+/* Fetches the pixels of @chunk, which can be downscaled from the GEGL
+ * mipmap of the buffer for an overview, and packs them as they are
+ * written.  Tiles at the right and bottom edges are padded.
+ */
+static void
+chunk_writer_get_pixels (TiffChunkWriter *writer,
+                         gint             chunk,
+                         gint             slot)
+{
+  guchar  *pixels = writer->pixels[slot];
+  gint     bpp    = babl_format_get_bytes_per_pixel (writer->format);
+  gdouble  scale  = 1.0 / (gdouble) (1 << writer->level);
+  gint     x, y;
+  gint     cols, rows;
+
+  chunk_writer_get_chunk (writer, chunk, &x, &y, &cols, &rows);
+
+  if (writer->tile_size > 0)
+    {
+      if (cols < writer->chunk_width || rows < writer->chunk_height)
+        memset (pixels, 0, writer->chunk_size);
+
+      writer->sizes[slot] = writer->chunk_size;
+    }
+  else
+    {
+      writer->sizes[slot] = writer->row_size * rows;
+    }
+
+  if (writer->is_bw)
+    {
+      gint row;
+
+      gegl_buffer_get (writer->buffer,
+                       GEGL_RECTANGLE (x, y, cols, rows), scale,
+                       writer->format, writer->bytes,
+                       writer->chunk_width * bpp, GEGL_ABYSS_NONE);
+
+      for (row = 0; row < rows; row++)
+        byte2bit (writer->bytes + row * writer->chunk_width * bpp,
+                  cols * bpp,
+                  pixels + row * writer->row_size,
+                  writer->invert);
+    }
+  else
+    {
+      gegl_buffer_get (writer->buffer,
+                       GEGL_RECTANGLE (x, y, cols, rows), scale,
+                       writer->format, pixels,
+                       writer->row_size, GEGL_ABYSS_NONE);
+    }
+}
+
+static void
+chunk_writer_encode (gint             i,
+                     gint             n,
+                     TiffChunkWriter *writer)
+{
+  TIFF *scratch = writer->scratch[i];
+  gint  slot;
+
+  for (slot = i; slot < writer->n_batch; slot += n)
+    {
+      const guchar *data = NULL;
+      gsize         size = 0;
+      tmsize_t      written;
+
+      tiff_scratch_rewind (scratch);
+
+      if (writer->tile_size > 0)
+        written = TIFFWriteEncodedTile (scratch, 0, writer->pixels[slot],
+                                        writer->sizes[slot]);
+      else
+        written = TIFFWriteEncodedStrip (scratch, 0, writer->pixels[slot],
+                                         writer->sizes[slot]);
+
+      if (written >= 0)
+        data = tiff_scratch_get_chunk (scratch, &size);
+
+      writer->failed[slot] = (data == NULL);
+
+      if (! data)
+        continue;
+
+      if (size > writer->encoded_allocated[slot])
+        {
+          writer->encoded[slot]           = g_realloc (writer->encoded[slot],
+                                                       size);
+          writer->encoded_allocated[slot] = size;
+        }
+
+      memcpy (writer->encoded[slot], data, size);
+      writer->encoded_sizes[slot] = size;
+    }
+}
+
+static TIFF *
+chunk_writer_open_scratch (TiffChunkWriter  *writer,
+                           const TiffFields *fields)
+{
+  TIFF *scratch = tiff_scratch_open ();
+
+  if (! scratch)
+    return NULL;
+
+  set_encoding_fields (scratch, fields);
+
+  if (writer->tile_size > 0)
+    set_layout_fields (scratch, writer->tile_size, writer->tile_size,
+                       writer->tile_size, 0);
+  else
+    set_layout_fields (scratch, writer->width, writer->rows_per_strip,
+                       0, writer->rows_per_strip);
+
+  return scratch;
+}
+
+/* Writes the pixels of the current directory of the writer's TIFF, in
+ * strips or tiles.  They are fetched in batches of at most
+ * MAX_BATCH_SIZE bytes by the main thread.  With compressions which
+ * allow it, the strips or tiles of a batch are then compressed by
+ * worker threads, each into its own scratch TIFF in memory, and the
+ * main thread writes them to the file in order with
+ * TIFFWriteRawStrip() or TIFFWriteRawTile().
+ */
+static gboolean
+write_chunks (TiffChunkWriter  *writer,
+              const TiffFields *fields,
+              gdouble           progress_start,
+              gdouble           progress_end,
+              GError          **error)
+{
+  gint     bpp       = babl_format_get_bytes_per_pixel (writer->format);
+  gboolean tiled     = (writer->tile_size > 0);
+  gboolean success   = TRUE;
+  gint     chunks_down;
+  gint     n_threads;
+  gint     first;
+  gint     i;
+
+  if (tiled)
+    {
+      writer->chunk_width  = writer->tile_size;
+      writer->chunk_height = writer->tile_size;
+    }
+  else
+    {
+      writer->chunk_width  = writer->width;
+      writer->chunk_height = writer->rows_per_strip;
+    }
+
+  if (writer->is_bw)
+    writer->row_size = (writer->chunk_width * bpp + 7) / 8;
+  else
+    writer->row_size = writer->chunk_width * bpp;
+
+  writer->chunk_size    = writer->row_size * writer->chunk_height;
+  writer->chunks_across = ((writer->width + writer->chunk_width - 1) /
+                           writer->chunk_width);
+  chunks_down           = ((writer->height + writer->chunk_height - 1) /
+                           writer->chunk_height);
+  writer->n_chunks      = writer->chunks_across * chunks_down;
+
+  writer->max_batch = CLAMP (MAX_BATCH_SIZE / writer->chunk_size,
+                             1, writer->n_chunks);
+
+  writer->pixels            = g_new0 (guchar *, writer->max_batch);
+  writer->sizes             = g_new0 (gsize, writer->max_batch);
+  writer->encoded           = g_new0 (guchar *, writer->max_batch);
+  writer->encoded_sizes     = g_new0 (gsize, writer->max_batch);
+  writer->encoded_allocated = g_new0 (gsize, writer->max_batch);
+  writer->failed            = g_new0 (gboolean, writer->max_batch);
+  writer->scratch           = NULL;
+  writer->n_scratch         = 0;
+  writer->bytes             = NULL;
+
+  for (i = 0; i < writer->max_batch; i++)
+    writer->pixels[i] = g_malloc (writer->chunk_size);
+
+  if (writer->is_bw)
+    writer->bytes = g_malloc ((gsize) writer->chunk_width *
+                              writer->chunk_height * bpp);
+
+  g_object_get (gegl_config (), "threads", &n_threads, NULL);
+
+  if (n_threads > 1 && compression_is_parallel (fields->compression))
+    {
+      writer->scratch = g_new0 (TIFF *, MIN (n_threads, writer->max_batch));
+
+      for (i = 0; i < MIN (n_threads, writer->max_batch); i++)
+        {
+          writer->scratch[i] = chunk_writer_open_scratch (writer, fields);
+
+          if (! writer->scratch[i])
+            break;
+
+          writer->n_scratch++;
+        }
+
+      /* Compressing on a single thread needs no scratch TIFF */
+      if (writer->n_scratch < 2)
+        {
+          for (i = 0; i < writer->n_scratch; i++)
+            tiff_scratch_close (writer->scratch[i]);
+
+          g_clear_pointer (&writer->scratch, g_free);
+          writer->n_scratch = 0;
+        }
+    }
+
+  for (first = 0; success && first < writer->n_chunks; first += writer->max_batch)
+    {
+      gint slot;
+
+      writer->n_batch = MIN (writer->max_batch, writer->n_chunks - first);
+
+      for (slot = 0; slot < writer->n_batch; slot++)
+        chunk_writer_get_pixels (writer, first + slot, slot);
+
+      if (writer->scratch)
+        gegl_parallel_distribute (MIN (writer->n_scratch, writer->n_batch),
+                                  (GeglParallelDistributeFunc) chunk_writer_encode,
+                                  writer);
+
+      for (slot = 0; slot < writer->n_batch; slot++)
+        {
+          gint chunk = first + slot;
+          gint x, y;
+          gint cols, rows;
+
+          if (writer->scratch && writer->failed[slot])
+            success = FALSE;
+          else if (writer->scratch && tiled)
+            success = (TIFFWriteRawTile (writer->tif, chunk,
+                                         writer->encoded[slot],
+                                         writer->encoded_sizes[slot]) >= 0);
+          else if (writer->scratch)
+            success = (TIFFWriteRawStrip (writer->tif, chunk,
+                                          writer->encoded[slot],
+                                          writer->encoded_sizes[slot]) >= 0);
+          else if (tiled)
+            success = (TIFFWriteEncodedTile (writer->tif, chunk,
+                                             writer->pixels[slot],
+                                             writer->sizes[slot]) >= 0);
+          else
+            success = (TIFFWriteEncodedStrip (writer->tif, chunk,
+                                              writer->pixels[slot],
+                                              writer->sizes[slot]) >= 0);
+
+          if (! success)
+            {
+              chunk_writer_get_chunk (writer, chunk, &x, &y, &cols, &rows);
+
+              if (tiled)
+                g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                             _("Failed a tile write at row %d, column %d"),
+                             y, x);
+              else
+                g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                             _("Failed a scanline write on row %d"), y);
+              break;
+            }
+        }
+
+      gimp_progress_update (progress_start +
+                            (progress_end - progress_start) *
+                            (gdouble) (first + writer->n_batch) /
+                            (gdouble) writer->n_chunks);
+    }
+
+  for (i = 0; i < writer->n_scratch; i++)
+    tiff_scratch_close (writer->scratch[i]);
+
+  for (i = 0; i < writer->max_batch; i++)
+    {
+      g_free (writer->pixels[i]);
+      g_free (writer->encoded[i]);
+    }
+
+  g_free (writer->scratch);
+  g_free (writer->pixels);
+  g_free (writer->sizes);
+  g_free (writer->encoded);
+  g_free (writer->encoded_sizes);
+  g_free (writer->encoded_allocated);
+  g_free (writer->failed);
+  g_free (writer->bytes);
+
+  return success;
+}
+
+/* Writes @n_levels overviews of the layer, each half the size of the
+ * previous one, as reduced images right after its directory.  It stops
+ * early once a level fits in a single tile.
+ */
+static gboolean
+save_overviews (TIFF             *tif,
+                GeglBuffer       *buffer,
+                const Babl       *format,
+                const TiffFields *fields,
+                gint              n_levels,
+                gint              tile_size,
+                gint              rows_per_strip,
+                gdouble           xresolution,
+                gdouble           yresolution,
+                gushort           save_unit,
+                gdouble           progress_start,
+                gdouble           progress_end,
+                GError          **error)
+{
+  gint width    = gegl_buffer_get_width (buffer);
+  gint height   = gegl_buffer_get_height (buffer);
+  gint min_size = (tile_size > 0) ? tile_size : 256;
+  gint level;
+
+  for (level = 1; level <= n_levels; level++)
+    {
+      TiffChunkWriter writer = { 0, };
+      gdouble         start;
+      gdouble         end;
+
+      if (MAX (width, height) <= min_size)
+        break;
+
+      width  = (width  + 1) / 2;
+      height = (height + 1) / 2;
+
+      /* Each level is about a quarter of the previous one */
+      start = progress_start + (progress_end - progress_start) *
+              (1.0 - 1.0 / (gdouble) (1 << (2 * (level - 1))));
+      end   = progress_start + (progress_end - progress_start) *
+              (1.0 - 1.0 / (gdouble) (1 << (2 * level)));
+
+      TIFFSetField (tif, TIFFTAG_SUBFILETYPE, FILETYPE_REDUCEDIMAGE);
+      TIFFSetField (tif, TIFFTAG_ORIENTATION, ORIENTATION_TOPLEFT);
+
+      set_layout_fields (tif, width, height, tile_size, rows_per_strip);
+      set_encoding_fields (tif, fields);
+
+      if (fields->cmyk)
+        {
+          TIFFSetField (tif, TIFFTAG_INKSET, INKSET_CMYK);
+          TIFFSetField (tif, TIFFTAG_NUMBEROFINKS, 4);
+        }
+
+      if (xresolution > 1e-5 && yresolution > 1e-5)
+        {
+          TIFFSetField (tif, TIFFTAG_XRESOLUTION, xresolution / (1 << level));
+          TIFFSetField (tif, TIFFTAG_YRESOLUTION, yresolution / (1 << level));
+          TIFFSetField (tif, TIFFTAG_RESOLUTIONUNIT, save_unit);
+        }
+
+      writer.tif            = tif;
+      writer.buffer         = buffer;
+      writer.format         = format;
+      writer.level          = level;
+      writer.width          = width;
+      writer.height         = height;
+      writer.tile_size      = tile_size;
+      writer.rows_per_strip = rows_per_strip;
+
+      if (! write_chunks (&writer, fields, start, end, error))
+        return FALSE;
+
+      TIFFWriteDirectory (tif);
+    }
+
+  return TRUE;
+}
+
 /*
  * pnmtotiff.c - converts a portable anymap to a Tagged Image File
  *
@@ -283,7 +816,7 @@ save_layer (TIFF        *tif,
   gushort           red[256];
   gushort           grn[256];
   gushort           blu[256];
-  gint              cols, rows, row, i;
+  gint              cols, rows, i;
   glong             rowsperstrip;
   gushort           compression;
   gushort           extra_samples[1];
@@ -295,17 +828,16 @@ save_layer (TIFF        *tif,
   gshort            samplesperpixel;
   gshort            bitspersample;
   gshort            sampleformat;
-  gint              bytesperrow;
-  guchar           *src = NULL;
-  guchar           *data = NULL;
   GimpPalette      *palette;
   guchar           *cmap;
   gint              num_colors;
-  gint              success;
   GimpImageType     drawable_type;
   GeglBuffer       *buffer = NULL;
   gint              tile_height;
-  gint              y, yend;
+  TiffFields        fields;
+  TiffChunkWriter   writer   = { 0, };
+  gdouble           image_progress;
+  gboolean          is_indexed;
   gboolean          is_bw    = FALSE;
   gboolean          invert   = TRUE;
   const guchar      bw_map[] = { 0, 0, 0, 255, 255, 255 };
@@ -324,6 +856,8 @@ save_layer (TIFF        *tif,
   gboolean          config_save_geotiff_tags;
   gboolean          config_save_profile;
   gboolean          config_cmyk;
+  gint              config_tile_size;
+  gint              config_overview_levels;
 
   g_object_get (config,
                 "gimp-comment",            &config_comment,
@@ -332,8 +866,13 @@ save_layer (TIFF        *tif,
                 "save-geotiff",            &config_save_geotiff_tags,
                 "save-color-profile",      &config_save_profile,
                 "cmyk",                    &config_cmyk,
+                "tile-size",               &config_tile_size,
+                "overview-levels",         &config_overview_levels,
                 NULL);
 
+  /* TIFF requires tile dimensions to be multiples of 16 */
+  config_tile_size = (config_tile_size + 15) / 16 * 16;
+
   config_compression = gimp_procedure_config_get_choice_id (GIMP_PROCEDURE_CONFIG (config), "compression");
   compression = gimp_compression_to_tiff_compression (config_compression);
 
@@ -353,6 +892,8 @@ save_layer (TIFF        *tif,
 
   drawable_type = gimp_drawable_type (GIMP_DRAWABLE (layer));
   buffer        = gimp_drawable_get_buffer (GIMP_DRAWABLE (layer));
+  is_indexed    = (drawable_type == GIMP_INDEXED_IMAGE ||
+                   drawable_type == GIMP_INDEXEDA_IMAGE);
 
   format = gegl_buffer_get_format (buffer);
   type   = babl_format_get_type (format, 0);
@@ -601,7 +1142,6 @@ save_layer (TIFF        *tif,
         }
 
       samplesperpixel = (drawable_type == GIMP_INDEXEDA_IMAGE) ? 2 : 1;
-      bytesperrow     = cols;
       alpha           = (drawable_type == GIMP_INDEXEDA_IMAGE);
 
       g_free (cmap);
@@ -641,8 +1181,6 @@ save_layer (TIFF        *tif,
                                        space ? space : gegl_buffer_get_format (buffer));
     }
 
-  bytesperrow = cols * babl_format_get_bytes_per_pixel (format);
-
   if (compression == COMPRESSION_CCITTFAX3 ||
       compression == COMPRESSION_CCITTFAX4)
     {
@@ -740,8 +1278,7 @@ save_layer (TIFF        *tif,
       TIFFSetField (tif, TIFFTAG_PAGENUMBER, page, num_pages);
     }
   TIFFSetField (tif, TIFFTAG_PAGENAME, layer_name);
-  TIFFSetField (tif, TIFFTAG_IMAGEWIDTH, cols);
-  TIFFSetField (tif, TIFFTAG_IMAGELENGTH, rows);
+  set_layout_fields (tif, cols, rows, config_tile_size, rowsperstrip);
   TIFFSetField (tif, TIFFTAG_BITSPERSAMPLE, bitspersample);
   TIFFSetField (tif, TIFFTAG_SAMPLEFORMAT, sampleformat);
   TIFFSetField (tif, TIFFTAG_ORIENTATION, ORIENTATION_TOPLEFT);
@@ -773,8 +1310,6 @@ save_layer (TIFF        *tif,
 
   TIFFSetField (tif, TIFFTAG_PHOTOMETRIC, photometric);
   TIFFSetField (tif, TIFFTAG_SAMPLESPERPIXEL, samplesperpixel);
-  TIFFSetField (tif, TIFFTAG_ROWSPERSTRIP, rowsperstrip);
-  /* TIFFSetField( tif, TIFFTAG_STRIPBYTECOUNTS, rows / rowsperstrip ); */
   TIFFSetField (tif, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
 
   /* resolution fields */
@@ -814,64 +1349,37 @@ save_layer (TIFF        *tif,
   if (page == 0)
     save_paths (tif, orig_image, cols, rows, offset_x, offset_y);
 
-  /* array to rearrange data */
-  src  = g_new (guchar, bytesperrow * tile_height);
-  data = g_new (guchar, bytesperrow);
+  fields.compression     = compression;
+  fields.predictor       = predictor;
+  fields.photometric     = photometric;
+  fields.samplesperpixel = samplesperpixel;
+  fields.bitspersample   = bitspersample;
+  fields.sampleformat    = sampleformat;
+  fields.alpha           = alpha;
+  fields.extra_sample    = alpha ? extra_samples[0] : EXTRASAMPLE_UNSPECIFIED;
+  fields.cmyk            = config_cmyk;
+
+  /* Overviews take about a third of the time of the image */
+  image_progress = progress_fraction;
+  if (config_overview_levels > 0 && ! is_indexed)
+    image_progress = progress_fraction * 3.0 / 4.0;
 
   /* Now write the TIFF data. */
-  for (y = 0; y < rows; y = yend)
-    {
-      yend = y + tile_height;
-      yend = MIN (yend, rows);
-
-      gegl_buffer_get (buffer,
-                       GEGL_RECTANGLE (0, y, cols, yend - y), 1.0,
-                       format, src,
-                       GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
-
-      for (row = y; row < yend; row++)
-        {
-          guchar *t = src + bytesperrow * (row - y);
-
-          switch (drawable_type)
-            {
-            case GIMP_INDEXED_IMAGE:
-            case GIMP_INDEXEDA_IMAGE:
-              if (is_bw)
-                {
-                  byte2bit (t, bytesperrow, data, invert);
-                  success = (TIFFWriteScanline (tif, data, row, 0) >= 0);
-                }
-              else
-                {
-                  success = (TIFFWriteScanline (tif, t, row, 0) >= 0);
-                }
-              break;
-
-            case GIMP_GRAY_IMAGE:
-            case GIMP_GRAYA_IMAGE:
-            case GIMP_RGB_IMAGE:
-            case GIMP_RGBA_IMAGE:
-              success = (TIFFWriteScanline (tif, t, row, 0) >= 0);
-              break;
-
-            default:
-              success = FALSE;
-              break;
-            }
-
-          if (!success)
-            {
-              g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
-                           _("Failed a scanline write on row %d"), row);
-              goto out;
-            }
-        }
-
-      if ((row % 32) == 0)
-        gimp_progress_update (progress_base + progress_fraction
-                              * (gdouble) row / (gdouble) rows);
-    }
+  writer.tif            = tif;
+  writer.buffer         = buffer;
+  writer.format         = format;
+  writer.level          = 0;
+  writer.width          = cols;
+  writer.height         = rows;
+  writer.tile_size      = config_tile_size;
+  writer.rows_per_strip = rowsperstrip;
+  writer.is_bw          = is_bw;
+  writer.invert         = invert;
+
+  if (! write_chunks (&writer, &fields,
+                      progress_base, progress_base + image_progress,
+                      error))
+    goto out;
 
   /* Save GeoTIFF tags to file, if available */
   if (config_save_geotiff_tags)
@@ -950,6 +1458,18 @@ save_layer (TIFF        *tif,
 
   TIFFWriteDirectory (tif);
 
+  /* Averaging palette indices makes no sense, so indexed layers get no
+   * overviews.
+   */
+  if (config_overview_levels > 0 && ! is_indexed &&
+      ! save_overviews (tif, buffer, format, &fields,
+                        config_overview_levels, config_tile_size,
+                        rowsperstrip, xresolution, yresolution, save_unit,
+                        progress_base + image_progress,
+                        progress_base + progress_fraction,
+                        error))
+    goto out;
+
   gimp_progress_update (progress_base + progress_fraction);
 
   status = TRUE;
@@ -958,8 +1478,6 @@ out:
   if (buffer)
     g_object_unref (buffer);
 
-  g_free (data);
-  g_free (src);
   g_free (layer_name);
 
   return status;
@@ -1355,6 +1873,8 @@ save_dialog (GimpImage     *image,
                                 "big-tif-warning",
                                 "compression",
                                 "bigtiff",
+                                "tile-size",
+                                "overview-levels",
                                 "layers-frame",
                                 "save-transparent-pixels",
                                 "cmyk-frame",
@@ -1363,6 +1883,8 @@ save_dialog (GimpImage     *image,
     gimp_procedure_dialog_fill (GIMP_PROCEDURE_DIALOG (dialog),
                                 "compression",
                                 "bigtiff",
+                                "tile-size",
+                                "overview-levels",
                                 "layers-frame",
                                 "save-transparent-pixels",
                                 "cmyk-frame",
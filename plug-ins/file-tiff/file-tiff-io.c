@@ -33,6 +33,9 @@
 
 static gboolean tiff_file_size_error = FALSE;
 
+/* The thread which opened the first file, see tiff_io_from_worker() */
+static GThread *main_thread = NULL;
+
 typedef struct
 {
   GFile         *file;
@@ -47,6 +50,16 @@ typedef struct
   gsize          position;
 } TiffIO;
 
+/* An in-memory file, holding a single strip or tile at a time */
+typedef struct
+{
+  guchar *data;
+  gsize   size;
+  gsize   allocated;
+  gsize   position;
+  gsize   header_size;
+} TiffScratch;
+
 static TIFFExtendProc parent_extender;
 
 static void      tiff_io_warning       (const gchar *module,
@@ -66,8 +79,24 @@ static toff_t    tiff_io_seek          (thandle_t    handle,
                                         gint         whence);
 static gint      tiff_io_close         (thandle_t    handle);
 static toff_t    tiff_io_get_file_size (thandle_t    handle);
+static gboolean  tiff_io_from_worker   (const gchar *prefix,
+                                        const gchar *module,
+                                        const gchar *fmt,
+                                        va_list      ap) G_GNUC_PRINTF (3, 0);
 static void      register_geotags      (TIFF        *tif);
 
+static tsize_t   tiff_scratch_read     (thandle_t    handle,
+                                        tdata_t      buffer,
+                                        tsize_t      size);
+static tsize_t   tiff_scratch_write    (thandle_t    handle,
+                                        tdata_t      buffer,
+                                        tsize_t      size);
+static toff_t    tiff_scratch_seek     (thandle_t    handle,
+                                        toff_t       offset,
+                                        gint         whence);
+static gint      tiff_scratch_close_io (thandle_t    handle);
+static toff_t    tiff_scratch_get_size (thandle_t    handle);
+
 static void
 register_geotags (TIFF *tif)
 {
@@ -85,50 +114,67 @@ register_geotags (TIFF *tif)
 }
 
 
-static TiffIO tiff_io = { 0, };
-
-
 TIFF *
 tiff_open (GFile        *file,
            const gchar  *mode,
            GError      **error)
 {
+  TiffIO *io;
+  TIFF   *tif;
+
+  if (! main_thread)
+    main_thread = g_thread_self ();
+
   TIFFSetWarningHandler ((TIFFErrorHandler) tiff_io_warning);
   TIFFSetErrorHandler ((TIFFErrorHandler) tiff_io_error);
 
   parent_extender = TIFFSetTagExtender (register_geotags);
 
-  tiff_io.file = file;
+  io = g_new0 (TiffIO, 1);
+
+  io->file = g_object_ref (file);
 
   if (! strcmp (mode, "r"))
     {
-      tiff_io.input = G_INPUT_STREAM (g_file_read (file, NULL, error));
-      if (! tiff_io.input)
-        return NULL;
+      io->input = G_INPUT_STREAM (g_file_read (file, NULL, error));
+      if (! io->input)
+        {
+          g_object_unref (io->file);
+          g_free (io);
+          return NULL;
+        }
 
-      tiff_io.stream = G_OBJECT (tiff_io.input);
+      io->stream = G_OBJECT (io->input);
     }
   else if(! strcmp (mode, "w") || ! strcmp (mode, "w8"))
     {
-      tiff_io.output = G_OUTPUT_STREAM (g_file_replace (file,
-                                                        NULL, FALSE,
-                                                        G_FILE_CREATE_NONE,
-                                                        NULL, error));
-      if (! tiff_io.output)
-        return NULL;
+      io->output = G_OUTPUT_STREAM (g_file_replace (file,
+                                                    NULL, FALSE,
+                                                    G_FILE_CREATE_NONE,
+                                                    NULL, error));
+      if (! io->output)
+        {
+          g_object_unref (io->file);
+          g_free (io);
+          return NULL;
+        }
 
-      tiff_io.stream = G_OBJECT (tiff_io.output);
+      io->stream = G_OBJECT (io->output);
     }
   else if(! strcmp (mode, "a"))
     {
       GIOStream *iostream = G_IO_STREAM (g_file_open_readwrite (file, NULL,
                                                                 error));
       if (! iostream)
-        return NULL;
+        {
+          g_object_unref (io->file);
+          g_free (io);
+          return NULL;
+        }
 
-      tiff_io.input  = g_io_stream_get_input_stream (iostream);
-      tiff_io.output = g_io_stream_get_output_stream (iostream);
-      tiff_io.stream = G_OBJECT (iostream);
+      io->input  = g_io_stream_get_input_stream (iostream);
+      io->output = g_io_stream_get_output_stream (iostream);
+      io->stream = G_OBJECT (iostream);
     }
   else
     {
@@ -137,18 +183,133 @@ tiff_open (GFile        *file,
 
 #if 0
 #warning FIXME !can_seek code is broken
-  tiff_io.can_seek = g_seekable_can_seek (G_SEEKABLE (tiff_io.stream));
+  io->can_seek = g_seekable_can_seek (G_SEEKABLE (io->stream));
 #endif
-  tiff_io.can_seek = TRUE;
-
-  return TIFFClientOpen ("file-tiff", mode,
-                         (thandle_t) &tiff_io,
-                         tiff_io_read,
-                         tiff_io_write,
-                         tiff_io_seek,
-                         tiff_io_close,
-                         tiff_io_get_file_size,
-                         NULL, NULL);
+  io->can_seek = TRUE;
+
+  tif = TIFFClientOpen ("file-tiff", mode,
+                        (thandle_t) io,
+                        tiff_io_read,
+                        tiff_io_write,
+                        tiff_io_seek,
+                        tiff_io_close,
+                        tiff_io_get_file_size,
+                        NULL, NULL);
+
+  /* libtiff does not call the close procedure when opening fails */
+  if (! tif)
+    tiff_io_close ((thandle_t) io);
+
+  return tif;
+}
+
+/* Opens another read-only handle on the file of @tif, set to the same
+ * directory, so that strips or tiles can be decoded from several
+ * threads at once. Returns NULL if that fails.
+ */
+TIFF *
+tiff_reopen (TIFF *tif)
+{
+  TiffIO *io = (TiffIO *) TIFFClientdata (tif);
+  TIFF   *new_tif;
+
+  new_tif = tiff_open (io->file, "r", NULL);
+
+  if (new_tif &&
+      ! TIFFSetSubDirectory (new_tif, TIFFCurrentDirOffset (tif)))
+    {
+      TIFFClose (new_tif);
+      new_tif = NULL;
+    }
+
+  return new_tif;
+}
+
+/* Opens a TIFF in memory, which is used to compress strips or tiles in
+ * worker threads with libtiff's own codecs, to then write them to the
+ * actual file with TIFFWriteRawStrip() or TIFFWriteRawTile().  Its
+ * fields must be set up like those of the actual file, with a single
+ * strip or tile.
+ */
+TIFF *
+tiff_scratch_open (void)
+{
+  TiffScratch *scratch = g_new0 (TiffScratch, 1);
+  TIFF        *tif;
+
+  tif = TIFFClientOpen ("file-tiff-scratch", "w",
+                        (thandle_t) scratch,
+                        tiff_scratch_read,
+                        tiff_scratch_write,
+                        tiff_scratch_seek,
+                        tiff_scratch_close_io,
+                        tiff_scratch_get_size,
+                        NULL, NULL);
+
+  if (! tif)
+    {
+      g_free (scratch->data);
+      g_free (scratch);
+      return NULL;
+    }
+
+  scratch->header_size = scratch->size;
+
+  return tif;
+}
+
+void
+tiff_scratch_close (TIFF *tif)
+{
+  TiffScratch *scratch = (TiffScratch *) TIFFClientdata (tif);
+
+  /* Nothing needs to be flushed */
+  TIFFCleanup (tif);
+
+  g_free (scratch->data);
+  g_free (scratch);
+}
+
+/* Drops the previous strip or tile, so that the next one is written
+ * right after the header again.
+ */
+void
+tiff_scratch_rewind (TIFF *tif)
+{
+  TiffScratch *scratch = (TiffScratch *) TIFFClientdata (tif);
+
+  scratch->size     = scratch->header_size;
+  scratch->position = scratch->header_size;
+}
+
+/* Returns the compressed data of the last strip or tile written */
+const guchar *
+tiff_scratch_get_chunk (TIFF  *tif,
+                        gsize *size)
+{
+  TiffScratch *scratch = (TiffScratch *) TIFFClientdata (tif);
+  uint64_t    *offsets;
+  uint64_t    *byte_counts;
+
+  if (TIFFIsTiled (tif))
+    {
+      if (! TIFFGetField (tif, TIFFTAG_TILEOFFSETS,    &offsets) ||
+          ! TIFFGetField (tif, TIFFTAG_TILEBYTECOUNTS, &byte_counts))
+        return NULL;
+    }
+  else
+    {
+      if (! TIFFGetField (tif, TIFFTAG_STRIPOFFSETS,    &offsets) ||
+          ! TIFFGetField (tif, TIFFTAG_STRIPBYTECOUNTS, &byte_counts))
+        return NULL;
+    }
+
+  if (offsets[0] + byte_counts[0] > scratch->size)
+    return NULL;
+
+  *size = byte_counts[0];
+
+  return scratch->data + offsets[0];
 }
 
 gboolean
@@ -165,6 +326,28 @@ tiff_reset_file_size_error (void)
 
 static gint max_msgs_per_instance = 3;
 
+/* Messages from the handles of tiff_reopen(), which are used from
+ * other threads, can't be passed on to GIMP and only go to stderr. The
+ * main thread reports the strip or tile which failed on its own.
+ */
+static gboolean
+tiff_io_from_worker (const gchar *prefix,
+                     const gchar *module,
+                     const gchar *fmt,
+                     va_list      ap)
+{
+  gchar *msg;
+
+  if (g_thread_self () == main_thread)
+    return FALSE;
+
+  msg = g_strdup_vprintf (fmt, ap);
+  g_printerr ("%s: [%s] %s\n", prefix, module, msg);
+  g_free (msg);
+
+  return TRUE;
+}
+
 static void
 tiff_io_warning (const gchar *module,
                  const gchar *fmt,
@@ -172,6 +355,9 @@ tiff_io_warning (const gchar *module,
 {
   gint tag = 0;
 
+  if (tiff_io_from_worker ("LibTiff warning", module, fmt, ap))
+    return;
+
   if (max_msgs_per_instance > 0)
     max_msgs_per_instance--;
   else
@@ -287,6 +473,9 @@ tiff_io_error (const gchar *module,
 {
   gchar *msg;
 
+  if (tiff_io_from_worker ("LibTiff error", module, fmt, ap))
+    return;
+
   if (max_msgs_per_instance > 0)
     max_msgs_per_instance--;
   else
@@ -550,16 +739,9 @@ tiff_io_close (thandle_t handle)
     }
 
   g_object_unref (io->stream);
-  io->stream = NULL;
-  io->input  = NULL;
-  io->output = NULL;
-
+  g_object_unref (io->file);
   g_free (io->buffer);
-  io->buffer = NULL;
-
-  io->allocated = 0;
-  io->used      = 0;
-  io->position  = 0;
+  g_free (io);
 
   return closed ? 0 : -1;
 }
@@ -589,3 +771,88 @@ tiff_io_get_file_size (thandle_t handle)
 
   return (toff_t) size;
 }
+
+static tsize_t
+tiff_scratch_read (thandle_t handle,
+                   tdata_t   buffer,
+                   tsize_t   size)
+{
+  TiffScratch *scratch = (TiffScratch *) handle;
+  gsize        read;
+
+  if (scratch->position >= scratch->size)
+    return 0;
+
+  read = MIN ((gsize) size, scratch->size - scratch->position);
+
+  memcpy (buffer, scratch->data + scratch->position, read);
+  scratch->position += read;
+
+  return (tsize_t) read;
+}
+
+static tsize_t
+tiff_scratch_write (thandle_t handle,
+                    tdata_t   buffer,
+                    tsize_t   size)
+{
+  TiffScratch *scratch = (TiffScratch *) handle;
+  gsize        end     = scratch->position + size;
+
+  if (end > scratch->allocated)
+    {
+      scratch->allocated = MAX (end, 2 * scratch->allocated);
+      scratch->data      = g_realloc (scratch->data, scratch->allocated);
+    }
+
+  if (scratch->position > scratch->size)
+    memset (scratch->data + scratch->size, 0,
+            scratch->position - scratch->size);
+
+  memcpy (scratch->data + scratch->position, buffer, size);
+
+  scratch->position = end;
+  scratch->size     = MAX (scratch->size, end);
+
+  return size;
+}
+
+static toff_t
+tiff_scratch_seek (thandle_t handle,
+                   toff_t    offset,
+                   gint      whence)
+{
+  TiffScratch *scratch = (TiffScratch *) handle;
+
+  switch (whence)
+    {
+    default:
+    case SEEK_SET:
+      scratch->position = offset;
+      break;
+
+    case SEEK_CUR:
+      scratch->position += offset;
+      break;
+
+    case SEEK_END:
+      scratch->position = scratch->size + offset;
+      break;
+    }
+
+  return (toff_t) scratch->position;
+}
+
+static gint
+tiff_scratch_close_io (thandle_t handle)
+{
+  return 0;
+}
+
+static toff_t
+tiff_scratch_get_size (thandle_t handle)
+{
+  TiffScratch *scratch = (TiffScratch *) handle;
+
+  return (toff_t) scratch->size;
+}
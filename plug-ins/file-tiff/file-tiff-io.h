@@ -44,6 +44,14 @@ static const TIFFFieldInfo geotifftags_fieldinfo[] = {
 TIFF     * tiff_open                  (GFile        *file,
                                        const gchar  *mode,
                                        GError      **error);
+TIFF     * tiff_reopen                (TIFF         *tif);
+
+TIFF         * tiff_scratch_open      (void);
+void           tiff_scratch_close     (TIFF         *tif);
+void           tiff_scratch_rewind    (TIFF         *tif);
+const guchar * tiff_scratch_get_chunk (TIFF         *tif,
+                                       gsize        *size);
+
 gboolean   tiff_got_file_size_error   (void);
 void       tiff_reset_file_size_error (void);
 
@@ -64,6 +64,9 @@
 
 #define PLUG_IN_ROLE "gimp-file-tiff-load"
 
+/* Bound on the decoded data of a batch of strips or tiles */
+#define MAX_BATCH_SIZE (64 << 20)
+
 
 typedef struct
 {
@@ -89,10 +92,73 @@ typedef enum
   GIMP_TIFF_GRAY_MINISWHITE,
 } TiffColorMode;
 
+typedef struct
+{
+  TIFF          **handles;      /* handles[0] is the caller's */
+  gint            n_handles;
+  gboolean        tiled;
+  gboolean        by_scanline;
+  guint32         image_width;
+  guint32         image_height;
+  guint32         tile_width;   /* of a tile, strip or scanline */
+  guint32         tile_height;
+  guint32         tiles_across;
+  gint            n_units;      /* tiles, strips or scanlines in a plane */
+  tmsize_t        unit_size;
+  tmsize_t        row_size;
+  gushort         bps;
+  gushort         spp;
+  TiffColorMode   tiff_mode;
+  gboolean        is_signed;
+  gboolean        needs_upscale;
+  gint            max_batch;
+
+  /* the batch being decoded */
+  gint            sample;
+  gint            first;
+  gint            n_batch;
+  guchar        **buffers;
+  guchar        **bw_buffers;
+  gboolean       *failed;
+} TiffDecoder;
+
 /* Declare some local functions */
 
 static GimpColorProfile * load_profile     (TIFF                *tif);
 
+static gint        tiff_set_reduced_level  (TIFF                *tif,
+                                            gint                 page,
+                                            gint                 level);
+static gboolean         is_reduced_image   (TIFF                *tif);
+
+static gboolean         tiff_decoder_init  (TiffDecoder         *decoder,
+                                            TIFF                *tif,
+                                            gushort              bps,
+                                            gushort              spp,
+                                            TiffColorMode        tiff_mode,
+                                            gboolean             is_signed);
+static void            tiff_decoder_clear  (TiffDecoder         *decoder);
+static void          tiff_decoder_get_unit (TiffDecoder         *decoder,
+                                            gint                 unit,
+                                            guint32             *x,
+                                            guint32             *y,
+                                            guint32             *cols,
+                                            guint32             *rows);
+static gboolean   tiff_decoder_decode_unit (TiffDecoder         *decoder,
+                                            TIFF                *tif,
+                                            gint                 slot);
+static void      tiff_decoder_decode_units (gint                 i,
+                                            gint                 n,
+                                            TiffDecoder         *decoder);
+static gint      tiff_decoder_decode_batch (TiffDecoder         *decoder,
+                                            gint                 sample,
+                                            gint                 first);
+static const guchar * tiff_decoder_get_data (TiffDecoder        *decoder,
+                                            gint                 unit,
+                                            gint                *rowstride);
+static void    tiff_decoder_report_failure (TiffDecoder         *decoder,
+                                            guint32              y);
+
 static void               load_rgba        (TIFF                *tif,
                                             ChannelData         *channel);
 static void               load_contiguous  (TIFF                *tif,
@@ -262,6 +328,62 @@ get_extra_channels_count (gushort photomet, gushort spp, gboolean alpha)
     }
 }
 
+/* Moves @tif from page @page to its reduced-resolution version at
+ * pyramid level @level, 1 being the largest one, or to the smallest
+ * one if the pyramid has fewer levels.  The levels are the SubIFDs of
+ * the page if they are reduced images, as in tiled pyramidal TIFF, or
+ * else the reduced images which follow the page in the main chain.
+ * Returns the level which was selected, or 0 if there is none, in which
+ * case @tif is left on @page.
+ */
+static gint
+tiff_set_reduced_level (TIFF *tif,
+                        gint  page,
+                        gint  level)
+{
+  gint     n_pages = TIFFNumberOfDirectories (tif);
+  guint16  n_subifds;
+  toff_t  *subifds;
+  gint     found   = 0;
+
+  if (TIFFGetField (tif, TIFFTAG_SUBIFD, &n_subifds, &subifds) &&
+      n_subifds > 0)
+    {
+      toff_t offsets[n_subifds];
+
+      memcpy (offsets, subifds, n_subifds * sizeof (offsets[0]));
+
+      while (found < MIN (level, n_subifds)            &&
+             TIFFSetSubDirectory (tif, offsets[found]) &&
+             is_reduced_image (tif))
+        found++;
+
+      if (found > 0 && TIFFSetSubDirectory (tif, offsets[found - 1]))
+        return found;
+
+      found = 0;
+    }
+
+  while (found < level                            &&
+         page + found + 1 < n_pages               &&
+         TIFFSetDirectory (tif, page + found + 1) &&
+         is_reduced_image (tif))
+    found++;
+
+  TIFFSetDirectory (tif, page + found);
+
+  return found;
+}
+
+static gboolean
+is_reduced_image (TIFF *tif)
+{
+  guint32 file_type;
+
+  return (TIFFGetField (tif, TIFFTAG_SUBFILETYPE, &file_type) &&
+          (file_type & FILETYPE_REDUCEDIMAGE));
+}
+
 GimpPDBStatusType
 load_image (GimpProcedure        *procedure,
             GFile                *file,
@@ -294,6 +416,7 @@ load_image (GimpProcedure        *procedure,
   gchar             *sketchbook_info;
   gint               sketchbook_len;
   gboolean           sketchbook_layers  = FALSE;
+  gint               reduced_level;
 
   *image = NULL;
   gimp_progress_init_printf (_("Opening '%s'"),
@@ -494,10 +617,13 @@ load_image (GimpProcedure        *procedure,
   if (pages.n_reducedimage_pages - pages.n_filtered_pages > 1)
     pages.show_reduced = TRUE;
 
+  pages.n_reduced_levels = tiff_set_reduced_level (tif, 0, G_MAXINT);
+  TIFFSetDirectory (tif, 0);
+
   pages.tif = tif;
 
-  if (run_mode == GIMP_RUN_INTERACTIVE     &&
-      (pages.n_pages > 1 || extra_message) &&
+  if (run_mode == GIMP_RUN_INTERACTIVE                                  &&
+      (pages.n_pages > 1 || extra_message || pages.n_reduced_levels > 0) &&
       ! load_dialog (procedure, config, &pages, extra_message,
                      &default_extra))
     {
@@ -535,6 +661,7 @@ load_image (GimpProcedure        *procedure,
 
   g_object_set (config, "target", pages.target, NULL);
   g_object_set (config, "keep-empty-space", pages.keep_empty_space, NULL);
+  g_object_get (config, "reduced-level", &reduced_level, NULL);
 
   /* We will loop through the all pages in case of multipage TIFF
    * and load every page as a separate layer.
@@ -582,6 +709,9 @@ load_image (GimpProcedure        *procedure,
         }
       ilayer = pages.pages[li];
 
+      if (reduced_level > 0)
+        tiff_set_reduced_level (tif, pages.pages[li], reduced_level);
+
       gimp_progress_update (0.0);
 
       TIFFGetFieldDefaulted (tif, TIFFTAG_BITSPERSAMPLE, &bps);
@@ -1096,6 +1226,9 @@ load_image (GimpProcedure        *procedure,
               case COMPRESSION_JPEG:
               case COMPRESSION_CCITTFAX3:
               case COMPRESSION_CCITTFAX4:
+#ifdef COMPRESSION_ZSTD
+              case COMPRESSION_ZSTD:
+#endif
                 break;
 
               case COMPRESSION_OJPEG:
@@ -1937,59 +2070,307 @@ load_rgba (TIFF        *tif,
   g_free (buffer);
 }
 
-static void
-load_contiguous (TIFF         *tif,
-                 ChannelData  *channel,
-                 const Babl   *type,
-                 gushort       bps,
-                 gushort       spp,
-                 TiffColorMode tiff_mode,
-                 gboolean      is_signed,
-                 gint          extra)
+/* Decodes the strips or tiles of the current directory of @tif, in
+ * batches of at most MAX_BATCH_SIZE bytes, each batch spread over as
+ * many handles on the file as there are threads.  The conversions to
+ * GIMP's pixel formats are done in the same threads, while the pixels
+ * are copied into the layer by the main thread, in order.
+ */
+static gboolean
+tiff_decoder_init (TiffDecoder   *decoder,
+                   TIFF          *tif,
+                   gushort        bps,
+                   gushort        spp,
+                   TiffColorMode  tiff_mode,
+                   gboolean       is_signed)
 {
-  guint32     image_width;
-  guint32     image_height;
-  guint32     tile_width;
-  guint32     tile_height;
-  gint        bytes_per_pixel;
-  const Babl *src_format;
-  guchar     *buffer;
-  guchar     *bw_buffer = NULL;
-  gdouble     progress  = 0.0;
-  gdouble     one_row;
-  guint32     y;
-  gint        i;
-  gboolean    needs_upscale = FALSE;
+  guint32 tiles_down;
+  gint    n_threads;
+  gint    i;
 
-  g_printerr ("%s\n", __func__);
+  memset (decoder, 0, sizeof (TiffDecoder));
 
-  TIFFGetField (tif, TIFFTAG_IMAGEWIDTH,  &image_width);
-  TIFFGetField (tif, TIFFTAG_IMAGELENGTH, &image_height);
+  TIFFGetField (tif, TIFFTAG_IMAGEWIDTH,  &decoder->image_width);
+  TIFFGetField (tif, TIFFTAG_IMAGELENGTH, &decoder->image_height);
 
-  tile_width = image_width;
+  decoder->tiled     = TIFFIsTiled (tif);
+  decoder->bps       = bps;
+  decoder->spp       = spp;
+  decoder->tiff_mode = tiff_mode;
+  decoder->is_signed = is_signed;
 
-  if (TIFFIsTiled (tif))
+  if (decoder->tiled)
     {
-      TIFFGetField (tif, TIFFTAG_TILEWIDTH,  &tile_width);
-      TIFFGetField (tif, TIFFTAG_TILELENGTH, &tile_height);
+      TIFFGetField (tif, TIFFTAG_TILEWIDTH,  &decoder->tile_width);
+      TIFFGetField (tif, TIFFTAG_TILELENGTH, &decoder->tile_height);
 
-      buffer = g_malloc (TIFFTileSize (tif));
+      decoder->unit_size = TIFFTileSize (tif);
+      decoder->row_size  = TIFFTileRowSize (tif);
     }
   else
     {
-      tile_width  = image_width;
-      tile_height = 1;
+      guint32 rows_per_strip;
+
+      TIFFGetFieldDefaulted (tif, TIFFTAG_ROWSPERSTRIP, &rows_per_strip);
 
-      buffer = g_malloc (TIFFScanlineSize (tif));
+      decoder->tile_width  = decoder->image_width;
+      decoder->tile_height = MIN (rows_per_strip, decoder->image_height);
+      decoder->unit_size   = TIFFStripSize (tif);
+      decoder->row_size    = TIFFScanlineSize (tif);
+
+      /* Strips too large for a batch are read a scanline at a time */
+      if (decoder->unit_size <= 0 || decoder->unit_size > MAX_BATCH_SIZE)
+        {
+          decoder->by_scanline = TRUE;
+          decoder->tile_height = 1;
+          decoder->unit_size   = decoder->row_size;
+        }
+    }
+
+  if (decoder->tile_width == 0 || decoder->tile_height == 0 ||
+      decoder->unit_size <= 0  || decoder->row_size <= 0)
+    return FALSE;
+
+  decoder->tiles_across = ((decoder->image_width + decoder->tile_width - 1) /
+                           decoder->tile_width);
+  tiles_down            = ((decoder->image_height + decoder->tile_height - 1) /
+                           decoder->tile_height);
+  decoder->n_units      = decoder->tiles_across * tiles_down;
+
+  decoder->max_batch = CLAMP (MAX_BATCH_SIZE / decoder->unit_size,
+                              1, decoder->n_units);
+
+  g_object_get (gegl_config (), "threads", &n_threads, NULL);
+
+  /* Scanlines can only be read in order, from a single handle */
+  if (decoder->by_scanline)
+    n_threads = 1;
+
+  decoder->n_handles  = MIN (n_threads, decoder->max_batch);
+  decoder->handles    = g_new0 (TIFF *, decoder->n_handles);
+  decoder->handles[0] = tif;
+
+  for (i = 1; i < decoder->n_handles; i++)
+    {
+      decoder->handles[i] = tiff_reopen (tif);
+
+      if (! decoder->handles[i])
+        {
+          decoder->n_handles = i;
+          break;
+        }
     }
 
   if (tiff_mode != GIMP_TIFF_DEFAULT && bps < 8)
+    decoder->needs_upscale = TRUE;
+
+  decoder->buffers = g_new0 (guchar *, decoder->max_batch);
+  decoder->failed  = g_new0 (gboolean, decoder->max_batch);
+
+  if (decoder->needs_upscale)
+    decoder->bw_buffers = g_new0 (guchar *, decoder->max_batch);
+
+  for (i = 0; i < decoder->max_batch; i++)
+    {
+      decoder->buffers[i] = g_malloc (decoder->unit_size);
+
+      if (decoder->needs_upscale)
+        decoder->bw_buffers[i] = g_malloc ((gsize) decoder->tile_width *
+                                           decoder->tile_height * spp);
+    }
+
+  return TRUE;
+}
+
+static void
+tiff_decoder_clear (TiffDecoder *decoder)
+{
+  gint i;
+
+  for (i = 1; i < decoder->n_handles; i++)
+    TIFFClose (decoder->handles[i]);
+
+  for (i = 0; i < decoder->max_batch; i++)
+    {
+      if (decoder->buffers)
+        g_free (decoder->buffers[i]);
+
+      if (decoder->bw_buffers)
+        g_free (decoder->bw_buffers[i]);
+    }
+
+  g_free (decoder->handles);
+  g_free (decoder->buffers);
+  g_free (decoder->bw_buffers);
+  g_free (decoder->failed);
+}
+
+static void
+tiff_decoder_get_unit (TiffDecoder *decoder,
+                       gint         unit,
+                       guint32     *x,
+                       guint32     *y,
+                       guint32     *cols,
+                       guint32     *rows)
+{
+  *x = (unit % decoder->tiles_across) * decoder->tile_width;
+  *y = (unit / decoder->tiles_across) * decoder->tile_height;
+
+  *cols = MIN (decoder->image_width  - *x, decoder->tile_width);
+  *rows = MIN (decoder->image_height - *y, decoder->tile_height);
+}
+
+static gboolean
+tiff_decoder_decode_unit (TiffDecoder *decoder,
+                          TIFF        *tif,
+                          gint         slot)
+{
+  guchar  *buffer = decoder->buffers[slot];
+  guint32  x, y;
+  guint32  cols, rows;
+  guint32  r;
+
+  tiff_decoder_get_unit (decoder, decoder->first + slot, &x, &y, &cols, &rows);
+
+  if (decoder->tiled)
+    {
+      if (TIFFReadTile (tif, buffer, x, y, 0, decoder->sample) == -1)
+        return FALSE;
+    }
+  else if (decoder->by_scanline)
     {
-      needs_upscale = TRUE;
-      bw_buffer = g_malloc (tile_width * tile_height);
+      if (TIFFReadScanline (tif, buffer, y, decoder->sample) == -1)
+        return FALSE;
+    }
+  else
+    {
+      if (TIFFReadEncodedStrip (tif,
+                                TIFFComputeStrip (tif, y, decoder->sample),
+                                buffer, -1) == -1)
+        return FALSE;
     }
 
-  one_row = (gdouble) tile_height / (gdouble) image_height;
+  for (r = 0; r < rows; r++)
+    {
+      guchar *src = buffer + r * decoder->row_size;
+
+      if (decoder->needs_upscale)
+        {
+          guchar *dest = (decoder->bw_buffers[slot] +
+                          r * decoder->tile_width * decoder->spp);
+
+          if (decoder->bps == 1)
+            convert_bit2byte (src, dest, cols * decoder->spp, 1);
+          else if (decoder->bps == 2)
+            convert_2bit2byte (src, dest, cols * decoder->spp, 1);
+          else if (decoder->bps == 4)
+            convert_4bit2byte (src, dest, cols * decoder->spp, 1);
+        }
+      else if (decoder->is_signed)
+        {
+          convert_int2uint (src, decoder->bps, decoder->spp, cols, 1,
+                            decoder->row_size);
+        }
+
+      if (decoder->tiff_mode == GIMP_TIFF_GRAY_MINISWHITE && decoder->bps == 8)
+        {
+          convert_miniswhite (src, cols, 1);
+        }
+    }
+
+  return TRUE;
+}
+
+static void
+tiff_decoder_decode_units (gint         i,
+                           gint         n,
+                           TiffDecoder *decoder)
+{
+  TIFF *tif = decoder->handles[i];
+  gint  slot;
+
+  for (slot = i; slot < decoder->n_batch; slot += n)
+    decoder->failed[slot] = ! tiff_decoder_decode_unit (decoder, tif, slot);
+}
+
+/* Decodes the batch of strips or tiles of sample plane @sample which
+ * starts at @first.  Returns the first of them which could not be
+ * read, or -1.
+ */
+static gint
+tiff_decoder_decode_batch (TiffDecoder *decoder,
+                           gint         sample,
+                           gint         first)
+{
+  gint slot;
+
+  decoder->sample  = sample;
+  decoder->first   = first;
+  decoder->n_batch = MIN (decoder->max_batch, decoder->n_units - first);
+
+  gegl_parallel_distribute (MIN (decoder->n_handles, decoder->n_batch),
+                            (GeglParallelDistributeFunc) tiff_decoder_decode_units,
+                            decoder);
+
+  for (slot = 0; slot < decoder->n_batch; slot++)
+    {
+      if (decoder->failed[slot])
+        return first + slot;
+    }
+
+  return -1;
+}
+
+/* Returns the decoded pixels of @unit, which must be part of the
+ * current batch.
+ */
+static const guchar *
+tiff_decoder_get_data (TiffDecoder *decoder,
+                       gint         unit,
+                       gint        *rowstride)
+{
+  gint slot = unit - decoder->first;
+
+  if (decoder->needs_upscale)
+    {
+      *rowstride = decoder->tile_width * decoder->spp;
+
+      return decoder->bw_buffers[slot];
+    }
+
+  *rowstride = decoder->row_size;
+
+  return decoder->buffers[slot];
+}
+
+static void
+tiff_decoder_report_failure (TiffDecoder *decoder,
+                             guint32      y)
+{
+  if (decoder->tiled)
+    g_message (_("Reading tile failed. Image may be corrupt at line %d."), y);
+  else
+    g_message (_("Reading scanline failed. Image may be corrupt at line %d."), y);
+}
+
+static void
+load_contiguous (TIFF         *tif,
+                 ChannelData  *channel,
+                 const Babl   *type,
+                 gushort       bps,
+                 gushort       spp,
+                 TiffColorMode tiff_mode,
+                 gboolean      is_signed,
+                 gint          extra)
+{
+  TiffDecoder  decoder;
+  gint         bytes_per_pixel;
+  const Babl  *src_format;
+  gint         failed = -1;
+  gint         unit;
+  gint         i;
+
+  g_printerr ("%s\n", __func__);
 
   src_format = babl_format_n (type, spp);
 
@@ -2002,116 +2383,90 @@ load_contiguous (TIFF         *tif,
               bytes_per_pixel,
               babl_format_get_bytes_per_pixel (src_format));
 
-  for (y = 0; y < image_height; y += tile_height)
+  if (! tiff_decoder_init (&decoder, tif, bps, spp, tiff_mode, is_signed))
     {
-      guint32 x;
+      tiff_decoder_report_failure (&decoder, 0);
+      tiff_decoder_clear (&decoder);
+      return;
+    }
 
-      for (x = 0; x < image_width; x += tile_width)
+  for (unit = 0; unit < decoder.n_units; unit++)
+    {
+      GeglBuffer   *src_buf;
+      const guchar *data;
+      gint          rowstride;
+      guint32       x, y;
+      guint32       rows;
+      guint32       cols;
+      gint          offset;
+
+      if (unit % decoder.max_batch == 0)
         {
-          GeglBuffer *src_buf;
-          guint32     rows;
-          guint32     cols;
-          gint        offset;
+          gimp_progress_update ((gdouble) unit / (gdouble) decoder.n_units);
 
-          gimp_progress_update (progress + one_row *
-                                ((gdouble) x / (gdouble) image_width));
-
-          if (TIFFIsTiled (tif))
-            {
-              if (TIFFReadTile (tif, buffer, x, y, 0, 0) == -1)
-                {
-                  g_message (_("Reading tile failed. Image may be corrupt at line %d."), y);
-                  g_free (buffer);
-                  g_free (bw_buffer);
-                  return;
-                }
-            }
-          else if (TIFFReadScanline (tif, buffer, y, 0) == -1)
-            {
-              /* Error reading scanline, stop loading */
-              g_message (_("Reading scanline failed. Image may be corrupt at line %d."), y);
-              g_free (buffer);
-              g_free (bw_buffer);
-              return;
-            }
+          failed = tiff_decoder_decode_batch (&decoder, 0, unit);
+        }
 
-          cols = MIN (image_width  - x, tile_width);
-          rows = MIN (image_height - y, tile_height);
+      tiff_decoder_get_unit (&decoder, unit, &x, &y, &cols, &rows);
 
-          if (needs_upscale)
-            {
-              if (bps == 1)
-                convert_bit2byte (buffer, bw_buffer, cols, rows);
-              else if (bps == 2)
-                convert_2bit2byte (buffer, bw_buffer, cols, rows);
-              else if (bps == 4)
-                convert_4bit2byte (buffer, bw_buffer, cols, rows);
-            }
-          else if (is_signed)
-            {
-              convert_int2uint (buffer, bps, spp, cols, rows,
-                                tile_width * bytes_per_pixel);
-            }
+      if (unit == failed)
+        {
+          tiff_decoder_report_failure (&decoder, y);
+          break;
+        }
 
-          if (tiff_mode == GIMP_TIFF_GRAY_MINISWHITE && bps == 8)
-            {
-              convert_miniswhite (buffer, cols, rows);
-            }
+      data = tiff_decoder_get_data (&decoder, unit, &rowstride);
 
-          src_buf = gegl_buffer_linear_new_from_data (needs_upscale ? bw_buffer : buffer,
-                                                      src_format,
-                                                      GEGL_RECTANGLE (0, 0, cols, rows),
-                                                      tile_width * bytes_per_pixel,
-                                                      NULL, NULL);
+      src_buf = gegl_buffer_linear_new_from_data ((gpointer) data,
+                                                   src_format,
+                                                   GEGL_RECTANGLE (0, 0, cols, rows),
+                                                   rowstride,
+                                                   NULL, NULL);
 
-          offset = 0;
+      offset = 0;
 
-          for (i = 0; i <= extra; i++)
+      for (i = 0; i <= extra; i++)
+        {
+          GeglBufferIterator *iter;
+          gint                src_bpp;
+          gint                dest_bpp;
+
+          src_bpp  = babl_format_get_bytes_per_pixel (src_format);
+          dest_bpp = babl_format_get_bytes_per_pixel (channel[i].format);
+
+          iter = gegl_buffer_iterator_new (src_buf,
+                                           GEGL_RECTANGLE (0, 0, cols, rows),
+                                           0, NULL,
+                                           GEGL_ACCESS_READ,
+                                           GEGL_ABYSS_NONE, 2);
+          gegl_buffer_iterator_add (iter, channel[i].buffer,
+                                    GEGL_RECTANGLE (x, y, cols, rows),
+                                    0, channel[i].format,
+                                    GEGL_ACCESS_WRITE, GEGL_ABYSS_NONE);
+
+          while (gegl_buffer_iterator_next (iter))
             {
-              GeglBufferIterator *iter;
-              gint                src_bpp;
-              gint                dest_bpp;
+              guchar *s      = iter->items[0].data;
+              guchar *d      = iter->items[1].data;
+              gint    length = iter->length;
 
-              src_bpp  = babl_format_get_bytes_per_pixel (src_format);
-              dest_bpp = babl_format_get_bytes_per_pixel (channel[i].format);
+              s += offset;
 
-              iter = gegl_buffer_iterator_new (src_buf,
-                                               GEGL_RECTANGLE (0, 0, cols, rows),
-                                               0, NULL,
-                                               GEGL_ACCESS_READ,
-                                               GEGL_ABYSS_NONE, 2);
-              gegl_buffer_iterator_add (iter, channel[i].buffer,
-                                        GEGL_RECTANGLE (x, y, cols, rows),
-                                        0, channel[i].format,
-                                        GEGL_ACCESS_WRITE, GEGL_ABYSS_NONE);
-
-              while (gegl_buffer_iterator_next (iter))
+              while (length--)
                 {
-                  guchar *s      = iter->items[0].data;
-                  guchar *d      = iter->items[1].data;
-                  gint    length = iter->length;
-
-                  s += offset;
-
-                  while (length--)
-                    {
-                      memcpy (d, s, dest_bpp);
-                      d += dest_bpp;
-                      s += src_bpp;
-                    }
+                  memcpy (d, s, dest_bpp);
+                  d += dest_bpp;
+                  s += src_bpp;
                 }
-
-              offset += dest_bpp;
             }
 
-          g_object_unref (src_buf);
+          offset += dest_bpp;
         }
 
-      progress += one_row;
+      g_object_unref (src_buf);
     }
 
-  g_free (buffer);
-  g_free (bw_buffer);
+  tiff_decoder_clear (&decoder);
 }
 
 
@@ -2125,49 +2480,13 @@ load_separate (TIFF         *tif,
                gboolean      is_signed,
                gint          extra)
 {
-  guint32     image_width;
-  guint32     image_height;
-  guint32     tile_width;
-  guint32     tile_height;
-  gint        bytes_per_pixel;
-  const Babl *src_format;
-  guchar     *buffer;
-  guchar     *bw_buffer = NULL;
-  gdouble     progress  = 0.0;
-  gdouble     one_row;
-  gint        i, compindex;
-  gboolean    needs_upscale = FALSE;
+  TiffDecoder  decoder;
+  gint         bytes_per_pixel;
+  const Babl  *src_format;
+  gint         i, compindex;
 
   g_printerr ("%s\n", __func__);
 
-  TIFFGetField (tif, TIFFTAG_IMAGEWIDTH,  &image_width);
-  TIFFGetField (tif, TIFFTAG_IMAGELENGTH, &image_height);
-
-  tile_width = image_width;
-
-  if (TIFFIsTiled (tif))
-    {
-      TIFFGetField (tif, TIFFTAG_TILEWIDTH,  &tile_width);
-      TIFFGetField (tif, TIFFTAG_TILELENGTH, &tile_height);
-
-      buffer = g_malloc (TIFFTileSize (tif));
-    }
-  else
-    {
-      tile_width  = image_width;
-      tile_height = 1;
-
-      buffer = g_malloc (TIFFScanlineSize (tif));
-    }
-
-  if (tiff_mode != GIMP_TIFF_DEFAULT && bps < 8)
-    {
-      needs_upscale = TRUE;
-      bw_buffer = g_malloc (tile_width * tile_height);
-    }
-
-  one_row = (gdouble) tile_height / (gdouble) image_height;
-
   src_format = babl_format_n (type, 1);
 
   /* consistency check */
@@ -2179,6 +2498,13 @@ load_separate (TIFF         *tif,
               bytes_per_pixel,
               babl_format_get_bytes_per_pixel (src_format));
 
+  if (! tiff_decoder_init (&decoder, tif, bps, 1, tiff_mode, is_signed))
+    {
+      tiff_decoder_report_failure (&decoder, 0);
+      tiff_decoder_clear (&decoder);
+      return;
+    }
+
   compindex = 0;
 
   for (i = 0; i <= extra; i++)
@@ -2197,110 +2523,80 @@ load_separate (TIFF         *tif,
 
       for (j = 0; j < n_comps; j++)
         {
-          guint32 y;
+          gint failed = -1;
+          gint unit;
 
-          for (y = 0; y < image_height; y += tile_height)
+          for (unit = 0; unit < decoder.n_units; unit++)
             {
-              guint32 x;
+              GeglBuffer         *src_buf;
+              GeglBufferIterator *iter;
+              const guchar       *data;
+              gint                rowstride;
+              guint32             x, y;
+              guint32             rows;
+              guint32             cols;
 
-              for (x = 0; x < image_width; x += tile_width)
+              if (unit % decoder.max_batch == 0)
                 {
-                  GeglBuffer         *src_buf;
-                  GeglBufferIterator *iter;
-                  guint32             rows;
-                  guint32             cols;
+                  gimp_progress_update ((gdouble) (compindex * decoder.n_units + unit) /
+                                        (gdouble) (spp * decoder.n_units));
 
-                  gimp_progress_update (progress + one_row *
-                                        ((gdouble) x / (gdouble) image_width));
+                  failed = tiff_decoder_decode_batch (&decoder, compindex, unit);
+                }
 
-                  if (TIFFIsTiled (tif))
-                    {
-                      if (TIFFReadTile (tif, buffer, x, y, 0, compindex) == -1)
-                        {
-                          g_message (_("Reading tile failed. Image may be corrupt at line %d."), y);
-                          g_free (buffer);
-                          g_free (bw_buffer);
-                          return;
-                        }
-                    }
-                  else if (TIFFReadScanline (tif, buffer, y, compindex) == -1)
-                    {
-                      /* Error reading scanline, stop loading */
-                      g_message (_("Reading scanline failed. Image may be corrupt at line %d."), y);
-                      g_free (buffer);
-                      g_free (bw_buffer);
-                      return;
-                    }
+              tiff_decoder_get_unit (&decoder, unit, &x, &y, &cols, &rows);
 
-                  cols = MIN (image_width  - x, tile_width);
-                  rows = MIN (image_height - y, tile_height);
+              if (unit == failed)
+                {
+                  tiff_decoder_report_failure (&decoder, y);
+                  tiff_decoder_clear (&decoder);
+                  return;
+                }
 
-                  if (needs_upscale)
-                    {
-                      if (bps == 1)
-                        convert_bit2byte (buffer, bw_buffer, cols, rows);
-                      else if (bps == 2)
-                        convert_2bit2byte (buffer, bw_buffer, cols, rows);
-                      else if (bps == 4)
-                        convert_4bit2byte (buffer, bw_buffer, cols, rows);
-                    }
-                  else if (is_signed)
-                    {
-                      convert_int2uint (buffer, bps, 1, cols, rows,
-                                        tile_width * bytes_per_pixel);
-                    }
+              data = tiff_decoder_get_data (&decoder, unit, &rowstride);
 
-                  if (tiff_mode == GIMP_TIFF_GRAY_MINISWHITE && bps == 8)
-                    {
-                      convert_miniswhite (buffer, cols, rows);
-                    }
+              src_buf = gegl_buffer_linear_new_from_data ((gpointer) data,
+                                                           src_format,
+                                                           GEGL_RECTANGLE (0, 0, cols, rows),
+                                                           rowstride,
+                                                           NULL, NULL);
 
-                  src_buf = gegl_buffer_linear_new_from_data (needs_upscale ? bw_buffer : buffer,
-                                                              src_format,
-                                                              GEGL_RECTANGLE (0, 0, cols, rows),
-                                                              GEGL_AUTO_ROWSTRIDE,
-                                                              NULL, NULL);
+              iter = gegl_buffer_iterator_new (src_buf,
+                                               GEGL_RECTANGLE (0, 0, cols, rows),
+                                               0, NULL,
+                                               GEGL_ACCESS_READ,
+                                               GEGL_ABYSS_NONE, 2);
+              gegl_buffer_iterator_add (iter, channel[i].buffer,
+                                        GEGL_RECTANGLE (x, y, cols, rows),
+                                        0, channel[i].format,
+                                        GEGL_ACCESS_READWRITE,
+                                        GEGL_ABYSS_NONE);
 
-                  iter = gegl_buffer_iterator_new (src_buf,
-                                                   GEGL_RECTANGLE (0, 0, cols, rows),
-                                                   0, NULL,
-                                                   GEGL_ACCESS_READ,
-                                                   GEGL_ABYSS_NONE, 2);
-                  gegl_buffer_iterator_add (iter, channel[i].buffer,
-                                            GEGL_RECTANGLE (x, y, cols, rows),
-                                            0, channel[i].format,
-                                            GEGL_ACCESS_READWRITE,
-                                            GEGL_ABYSS_NONE);
-
-                  while (gegl_buffer_iterator_next (iter))
+              while (gegl_buffer_iterator_next (iter))
+                {
+                  guchar *s      = iter->items[0].data;
+                  guchar *d      = iter->items[1].data;
+                  gint    length = iter->length;
+
+                  d += offset;
+
+                  while (length--)
                     {
-                      guchar *s      = iter->items[0].data;
-                      guchar *d      = iter->items[1].data;
-                      gint    length = iter->length;
-
-                      d += offset;
-
-                      while (length--)
-                        {
-                          memcpy (d, s, src_bpp);
-                          d += dest_bpp;
-                          s += src_bpp;
-                        }
+                      memcpy (d, s, src_bpp);
+                      d += dest_bpp;
+                      s += src_bpp;
                     }
-
-                  g_object_unref (src_buf);
                 }
+
+              g_object_unref (src_buf);
             }
 
           offset += src_bpp;
           compindex++;
         }
-
-      progress += one_row;
     }
 
-  g_free (buffer);
-  g_free (bw_buffer);
+  tiff_decoder_clear (&decoder);
 }
 
 /* Loads layers stored by the Alias/AutoDesk Sketchbook program */
@@ -2788,6 +3084,17 @@ load_dialog (GimpProcedure       *procedure,
   gimp_procedure_dialog_fill (GIMP_PROCEDURE_DIALOG (dialog),
                               "tiff-vbox", NULL);
 
+  if (pages->n_reduced_levels > 0)
+    {
+      GtkWidget *spin;
+
+      spin = gimp_procedure_dialog_get_widget (GIMP_PROCEDURE_DIALOG (dialog),
+                                               "reduced-level", G_TYPE_NONE);
+      gtk_widget_set_margin_bottom (spin, 6);
+      gtk_box_pack_start (GTK_BOX (vbox), spin, FALSE, FALSE, 0);
+      gtk_widget_set_visible (spin, TRUE);
+    }
+
   toggle = gtk_check_button_new_with_mnemonic (_("_Show reduced images"));
   gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON (toggle),
                                 pages->show_reduced);
@@ -2896,6 +3203,10 @@ tiff_dialog_show_reduced (GtkWidget *toggle,
   TiffSelectedPages *pages = (TiffSelectedPages *) data;
   pages->show_reduced = gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (toggle));
 
+  /* Only a single page with a pyramid */
+  if (! pages->selector)
+    return;
+
   /* Clear current pages from selection */
   gimp_page_selector_set_n_pages (GIMP_PAGE_SELECTOR (pages->selector), 0);
   /* Jump back to start of the TIFF file */
@@ -43,6 +43,7 @@ typedef struct
   GimpPageSelectorTarget  target;
   gboolean                keep_empty_space;
   gboolean                show_reduced;
+  gint                    n_reduced_levels;
 } TiffSelectedPages;
 
 
@@ -154,6 +154,7 @@ tiff_create_procedure (GimpPlugIn  *plug_in,
                       const gchar *name)
 {
   GimpProcedure *procedure = NULL;
+  GimpChoice    *compression;
 
   if (! strcmp (name, LOAD_PROC))
     {
@@ -198,6 +199,15 @@ tiff_create_procedure (GimpPlugIn  *plug_in,
       gimp_procedure_add_boolean_aux_argument (procedure, "keep-empty-space",
                                                _("_Keep empty space around imported layers"),
                                                NULL, TRUE, GIMP_PARAM_READWRITE);
+
+      gimp_procedure_add_int_argument (procedure, "reduced-level",
+                                       _("_Reduced resolution level"),
+                                       _("Load this level of the reduced-resolution "
+                                         "pyramid of each page, for a fast preview, "
+                                         "or the smallest one if there are fewer "
+                                         "(0 loads the full resolution)"),
+                                       0, 32, 0,
+                                       G_PARAM_READWRITE);
     }
   else if (! strcmp (name, EXPORT_PROC))
     {
@@ -241,19 +251,45 @@ tiff_create_procedure (GimpPlugIn  *plug_in,
                                            FALSE,
                                            G_PARAM_READWRITE);
 
+      compression = gimp_choice_new_with_values ("none",          GIMP_COMPRESSION_NONE,          _("None"),              NULL,
+                                                 "lzw",           GIMP_COMPRESSION_LZW,           _("LZW"),               NULL,
+                                                 "packbits",      GIMP_COMPRESSION_PACKBITS,      _("Pack Bits"),         NULL,
+                                                 "adobe_deflate", GIMP_COMPRESSION_ADOBE_DEFLATE, _("Deflate"),           NULL,
+                                                 "jpeg",          GIMP_COMPRESSION_JPEG,          _("JPEG"),              NULL,
+                                                 "ccittfax3",     GIMP_COMPRESSION_CCITTFAX3,     _("CCITT Group 3 fax"), NULL,
+                                                 "ccittfax4",     GIMP_COMPRESSION_CCITTFAX4,     _("CCITT Group 4 fax"), NULL,
+                                                 NULL);
+#ifdef COMPRESSION_ZSTD
+      if (TIFFIsCODECConfigured (COMPRESSION_ZSTD))
+        gimp_choice_add (compression, "zstd", GIMP_COMPRESSION_ZSTD,
+                         _("Zstandard"), NULL);
+#endif
+
       gimp_procedure_add_choice_argument (procedure, "compression",
                                           _("Co_mpression"),
                                           _("Compression type"),
-                                          gimp_choice_new_with_values ("none",          GIMP_COMPRESSION_NONE,          _("None"),              NULL,
-                                                                       "lzw",           GIMP_COMPRESSION_LZW,           _("LZW"),               NULL,
-                                                                       "packbits",      GIMP_COMPRESSION_PACKBITS,      _("Pack Bits"),         NULL,
-                                                                       "adobe_deflate", GIMP_COMPRESSION_ADOBE_DEFLATE, _("Deflate"),           NULL,
-                                                                       "jpeg",          GIMP_COMPRESSION_JPEG,          _("JPEG"),              NULL,
-                                                                       "ccittfax3",     GIMP_COMPRESSION_CCITTFAX3,     _("CCITT Group 3 fax"), NULL,
-                                                                       "ccittfax4",     GIMP_COMPRESSION_CCITTFAX4,     _("CCITT Group 4 fax"), NULL,
-                                                                       NULL),
+                                          compression,
                                           "none", G_PARAM_READWRITE);
 
+      gimp_procedure_add_int_argument (procedure, "tile-size",
+                                       _("_Tile size"),
+                                       _("Write square tiles of this size, rounded up "
+                                         "to a multiple of 16, instead of strips "
+                                         "(0 writes strips)"),
+                                       0, 4096, 0,
+                                       G_PARAM_READWRITE);
+
+      gimp_procedure_add_int_argument (procedure, "overview-levels",
+                                       _("O_verview levels"),
+                                       _("Number of reduced-resolution images, each "
+                                         "half the size of the previous one, to write "
+                                         "after each page, for viewers to open large "
+                                         "images quickly. Fewer levels are written "
+                                         "once a level fits in a single tile. "
+                                         "Indexed images get none"),
+                                       0, 16, 0,
+                                       G_PARAM_READWRITE);
+
       gimp_procedure_add_boolean_argument (procedure, "save-transparent-pixels",
                                            _("Save color _values from transparent pixels"),
                                            _("Keep the color data masked by an alpha channel "
@@ -557,6 +593,11 @@ gimp_compression_to_tiff_compression (GimpCompression compression)
     case GIMP_COMPRESSION_JPEG:          return COMPRESSION_JPEG;
     case GIMP_COMPRESSION_CCITTFAX3:     return COMPRESSION_CCITTFAX3;
     case GIMP_COMPRESSION_CCITTFAX4:     return COMPRESSION_CCITTFAX4;
+#ifdef COMPRESSION_ZSTD
+    case GIMP_COMPRESSION_ZSTD:          return COMPRESSION_ZSTD;
+#else
+    case GIMP_COMPRESSION_ZSTD:          break;
+#endif
     }
 
   return COMPRESSION_NONE;
@@ -576,6 +617,9 @@ tiff_compression_to_gimp_compression (gint compression)
     case COMPRESSION_JPEG:          return GIMP_COMPRESSION_JPEG;
     case COMPRESSION_CCITTFAX3:     return GIMP_COMPRESSION_CCITTFAX3;
     case COMPRESSION_CCITTFAX4:     return GIMP_COMPRESSION_CCITTFAX4;
+#ifdef COMPRESSION_ZSTD
+    case COMPRESSION_ZSTD:          return GIMP_COMPRESSION_ZSTD;
+#endif
     }
 
   return GIMP_COMPRESSION_NONE;
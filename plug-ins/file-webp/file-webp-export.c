@@ -52,10 +52,62 @@ int           webp_file_progress    (int                percent,
                                      const WebPPicture *picture);
 gchar *       webp_error_string     (WebPEncodingError  error_code);
 
-static void   webp_decide_output    (GimpImage         *image,
-                                     GObject           *config,
-                                     GimpColorProfile **profile,
-                                     gboolean          *out_linear);
+/* Frames in flight per processor: rendered, and not yet encoded */
+#define FRAMES_PER_THREAD 2
+
+typedef struct
+{
+  guchar            *pixels;
+  gint               width;
+  gint               height;
+  gint               bpp;
+  gboolean           has_alpha;
+  gint               timestamp;
+  gint               duration;
+  WebPMemoryWriter   mw;
+  WebPEncodingError  error_code;
+  gboolean           failed;
+} AnimFrame;
+
+/* Frames encoded on their own, in parallel, when all are keyframes */
+typedef struct
+{
+  const WebPConfig  *config;
+  AnimFrame         *frames;
+  gint               n_frames;
+} AnimWindow;
+
+/* Frames added in order to a WebPAnimEncoder on a thread of its own,
+ * while the next frames are rendered.
+ */
+typedef struct
+{
+  const WebPConfig  *config;
+  WebPAnimEncoder   *enc;
+  GAsyncQueue       *frames;
+  GAsyncQueue       *slots;
+  gint               failed;
+  gint               n_encoded;
+} AnimPipeline;
+
+
+static void     webp_decide_output   (GimpImage         *image,
+                                      GObject           *config,
+                                      GimpColorProfile **profile,
+                                      gboolean          *out_linear);
+
+static gboolean webp_import_frame    (WebPPicture       *picture,
+                                      const AnimFrame   *frame);
+static void     webp_encode_frames   (gint               i,
+                                      gint               n,
+                                      AnimWindow        *window);
+static gboolean webp_mux_frames      (WebPMux           *mux,
+                                      AnimWindow        *window);
+static gpointer webp_encode_thread   (AnimPipeline      *pipeline);
+
+
+/* Tells the encoder thread there are no more frames */
+static AnimFrame end_of_frames;
 
 int
 webp_anim_file_writer (FILE          *outfile,
@@ -502,6 +554,151 @@ combine_buffers (GeglBuffer *layer_buffer,
   return buffer;
 }
 
+static gboolean
+webp_import_frame (WebPPicture     *picture,
+                   const AnimFrame *frame)
+{
+  WebPPictureInit (picture);
+  picture->use_argb = 1;
+  picture->width    = frame->width;
+  picture->height   = frame->height;
+
+  /* Use the appropriate function to import the data from the buffer */
+  if (! frame->has_alpha)
+    return WebPPictureImportRGB (picture, frame->pixels,
+                                 frame->width * frame->bpp);
+  else
+    return WebPPictureImportRGBA (picture, frame->pixels,
+                                  frame->width * frame->bpp);
+}
+
+static void
+webp_encode_frames (gint        i,
+                    gint        n,
+                    AnimWindow *window)
+{
+  gint f;
+
+  for (f = i; f < window->n_frames; f += n)
+    {
+      AnimFrame   *frame = &window->frames[f];
+      WebPPicture  picture;
+
+      WebPMemoryWriterInit (&frame->mw);
+
+      if (! webp_import_frame (&picture, frame))
+        {
+          frame->error_code = VP8_ENC_ERROR_OUT_OF_MEMORY;
+          frame->failed     = TRUE;
+        }
+      else
+        {
+          picture.custom_ptr = &frame->mw;
+          picture.writer     = WebPMemoryWrite;
+
+          if (! WebPEncode (window->config, &picture))
+            {
+              frame->error_code = picture.error_code;
+              frame->failed     = TRUE;
+            }
+        }
+
+      WebPPictureFree (&picture);
+      g_clear_pointer (&frame->pixels, g_free);
+    }
+}
+
+/* Adds the encoded frames of the window to the mux in order, as
+ * full-canvas frames which replace the previous one.
+ */
+static gboolean
+webp_mux_frames (WebPMux    *mux,
+                 AnimWindow *window)
+{
+  gboolean status = TRUE;
+  gint     f;
+
+  for (f = 0; f < window->n_frames; f++)
+    {
+      AnimFrame *frame = &window->frames[f];
+
+      if (status && frame->failed)
+        {
+          gchar *error_str = webp_error_string (frame->error_code);
+          g_printerr ("ERROR[%d]: line %d: %s\n",
+                      frame->error_code, __LINE__,
+                      error_str);
+          g_free (error_str);
+          status = FALSE;
+        }
+      else if (status)
+        {
+          WebPMuxFrameInfo info = { 0 };
+
+          info.bitstream.bytes = frame->mw.mem;
+          info.bitstream.size  = frame->mw.size;
+          info.id              = WEBP_CHUNK_ANMF;
+          info.duration        = frame->duration;
+          info.dispose_method  = WEBP_MUX_DISPOSE_NONE;
+          info.blend_method    = WEBP_MUX_NO_BLEND;
+
+          if (WebPMuxPushFrame (mux, &info, 1) != WEBP_MUX_OK)
+            {
+              g_printerr ("ERROR: could not add frame %d\n", f);
+              status = FALSE;
+            }
+        }
+
+      WebPMemoryWriterClear (&frame->mw);
+    }
+
+  window->n_frames = 0;
+
+  return status;
+}
+
+static gpointer
+webp_encode_thread (AnimPipeline *pipeline)
+{
+  AnimFrame *frame;
+
+  while ((frame = g_async_queue_pop (pipeline->frames)) != &end_of_frames)
+    {
+      if (! g_atomic_int_get (&pipeline->failed))
+        {
+          WebPPicture picture;
+
+          if (! webp_import_frame (&picture, frame))
+            {
+              g_printerr ("%s: memory error in WebPPictureImportRGB(A)().",
+                          G_STRFUNC);
+              g_atomic_int_set (&pipeline->failed, TRUE);
+            }
+          /* Perform the actual encode */
+          else if (! WebPAnimEncoderAdd (pipeline->enc, &picture,
+                                         frame->timestamp, pipeline->config))
+            {
+              gchar *error_str = webp_error_string (picture.error_code);
+              g_printerr ("ERROR[%d]: line %d: %s\n",
+                          picture.error_code, __LINE__,
+                          error_str);
+              g_free (error_str);
+              g_atomic_int_set (&pipeline->failed, TRUE);
+            }
+
+          WebPPictureFree (&picture);
+        }
+
+      g_free (frame->pixels);
+      g_free (frame);
+
+      g_atomic_int_inc (&pipeline->n_encoded);
+      g_async_queue_push (pipeline->slots, GINT_TO_POINTER (1));
+    }
+
+  return NULL;
+}
+
 gboolean
 save_animation (GFile         *file,
                 GimpImage     *image,
@@ -514,8 +711,6 @@ save_animation (GFile         *file,
   gint32                 n_layers;
   gboolean               status      = TRUE;
   FILE                  *outfile     = NULL;
-  guchar                *buffer      = NULL;
-  gint                   buffer_size = 0;
   gint                   w, h;
   gint                   bpp;
   gboolean               has_alpha;
@@ -524,9 +719,15 @@ save_animation (GFile         *file,
   const Babl            *space   = NULL;
   GimpColorProfile      *profile = NULL;
   WebPAnimEncoderOptions enc_options;
+  WebPConfig             webp_config;
   WebPData               webp_data;
   int                    frame_timestamp = 0;
   WebPAnimEncoder       *enc             = NULL;
+  WebPMux               *frames_mux      = NULL;
+  GThread               *encode_thread   = NULL;
+  AnimPipeline           pipeline        = { 0, };
+  AnimWindow             window          = { 0, };
+  gint                   window_size;
   GeglBuffer            *prev_frame      = NULL;
   gboolean               out_linear      = FALSE;
   WebPPreset             preset;
@@ -535,6 +736,7 @@ save_animation (GFile         *file,
   gboolean               loop;
   gboolean               minimize_size;
   gint                   keyframe_distance;
+  gboolean               all_keyframes;
   gdouble                quality;
   gdouble                alpha_quality;
   gint                   default_delay;
@@ -566,6 +768,14 @@ save_animation (GFile         *file,
   layers   = g_list_reverse (layers);
   n_layers = g_list_length (layers);
 
+  /* When every frame is a keyframe, frames do not depend on each other:
+   * they are encoded in parallel, and put together with the mux API.
+   * Otherwise the animation encoder, which compares each frame with the
+   * previous ones, encodes while the next frames are rendered.
+   */
+  all_keyframes = (! minimize_size && keyframe_distance == 1);
+  window_size   = MAX (1, gimp_get_num_processors ()) * FRAMES_PER_THREAD;
+
   webp_decide_output (image, config, &profile, &out_linear);
   if (profile)
     {
@@ -633,6 +843,59 @@ save_animation (GFile         *file,
           enc_options.kmin = keyframe_distance - 1;
         }
 
+      /* The same settings for every frame */
+      WebPConfigPreset (&webp_config, preset, quality);
+
+      webp_config.lossless      = lossless;
+      webp_config.method        = 6;  /* better quality */
+      webp_config.alpha_quality = alpha_quality;
+      webp_config.exact         = 1;
+      webp_config.use_sharp_yuv = use_sharp_yuv ? 1 : 0;
+      /* frames encoded in parallel already use all processors */
+      webp_config.thread_level  = all_keyframes ? 0 : 1;
+
+      /* fix layers to avoid offset errors, so every frame has the
+       * size of the image
+       */
+      w = gimp_image_get_width (image);
+      h = gimp_image_get_height (image);
+
+      if (all_keyframes)
+        {
+          frames_mux = WebPMuxNew ();
+          if (! frames_mux)
+            {
+              g_printerr ("ERROR: could not create muxing object\n");
+              status = FALSE;
+              break;
+            }
+
+          window.config = &webp_config;
+          window.frames = g_new0 (AnimFrame, window_size);
+        }
+      else
+        {
+          enc = WebPAnimEncoderNew (w, h, &enc_options);
+          if (! enc)
+            {
+              g_printerr ("ERROR: enc == null\n");
+              status = FALSE;
+              break;
+            }
+
+          pipeline.config = &webp_config;
+          pipeline.enc    = enc;
+          pipeline.frames = g_async_queue_new ();
+          pipeline.slots  = g_async_queue_new ();
+
+          for (i = 0; i < window_size; i++)
+            g_async_queue_push (pipeline.slots, GINT_TO_POINTER (1));
+
+          encode_thread = g_thread_new ("webp-encode",
+                                        (GThreadFunc) webp_encode_thread,
+                                        &pipeline);
+        }
+
       for (list = layers, i = 0;
            list;
            list = g_list_next (list), i++)
@@ -640,9 +903,7 @@ save_animation (GFile         *file,
           GeglBuffer       *geglbuffer;
           GeglBuffer       *current_frame;
           GeglRectangle     extent;
-          WebPConfig        webp_config;
-          WebPPicture       picture;
-          WebPMemoryWriter  mw       = { 0 };
+          AnimFrame        *frame;
           GimpDrawable     *drawable = list->data;
           gint              delay;
           gboolean          needs_combine;
@@ -677,55 +938,6 @@ save_animation (GFile         *file,
           /* Retrieve the buffer for the layer */
           geglbuffer = gimp_drawable_get_buffer (drawable);
           extent = *gegl_buffer_get_extent (geglbuffer);
-          w = extent.width;
-          h = extent.height;
-
-          if (i == 0)
-            {
-              enc = WebPAnimEncoderNew (w, h, &enc_options);
-              if (! enc)
-                {
-                  g_printerr ("ERROR: enc == null\n");
-                  status = FALSE;
-                  break;
-                }
-            }
-
-          /* Attempt to allocate a buffer of the appropriate size */
-          if (! buffer || buffer_size < w * h * bpp)
-            {
-              buffer = g_try_realloc (buffer, w * h * bpp);
-
-              if (! buffer)
-                {
-                  g_printerr ("Buffer error: 'buffer null'\n");
-                  status = FALSE;
-                  break;
-                }
-              else
-                {
-                  buffer_size = w * h * bpp;
-                }
-            }
-
-          WebPConfigPreset (&webp_config, preset, quality);
-
-          webp_config.lossless      = lossless;
-          webp_config.method        = 6;  /* better quality */
-          webp_config.alpha_quality = alpha_quality;
-          webp_config.exact         = 1;
-          webp_config.use_sharp_yuv = use_sharp_yuv ? 1 : 0;
-
-          WebPMemoryWriterInit (&mw);
-
-          /* Prepare the WebP structure */
-          WebPPictureInit (&picture);
-          picture.use_argb      = 1;
-          picture.argb_stride   = w * bpp;
-          picture.width         = w;
-          picture.height        = h;
-          picture.custom_ptr    = &mw;
-          picture.writer        = WebPMemoryWrite;
 
           if (i == 0 || ! needs_combine)
             {
@@ -742,60 +954,110 @@ save_animation (GFile         *file,
             }
           prev_frame = current_frame;
 
-          /* Read the region into the buffer */
-          gegl_buffer_get (current_frame, &extent, 1.0, format, buffer,
-                           GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
-
-          /* Use the appropriate function to import the data from the buffer */
-          if (! has_alpha)
+          /* Wait for a frame of the window to be encoded */
+          if (! all_keyframes)
             {
-              status = WebPPictureImportRGB (&picture, buffer, w * bpp);
+              g_async_queue_pop (pipeline.slots);
+
+              if (g_atomic_int_get (&pipeline.failed))
+                {
+                  status = FALSE;
+                  break;
+                }
+
+              frame = g_new0 (AnimFrame, 1);
             }
           else
             {
-              status = WebPPictureImportRGBA (&picture, buffer, w * bpp);
+              frame = &window.frames[window.n_frames++];
             }
 
-          if (! status)
-            {
-              g_printerr ("%s: memory error in WebPPictureImportRGB(A)().",
-                          G_STRFUNC);
-            }
-          /* Perform the actual encode */
-          else if (! WebPAnimEncoderAdd (enc, &picture, frame_timestamp,
-                                         &webp_config))
+          frame->width     = extent.width;
+          frame->height    = extent.height;
+          frame->bpp       = bpp;
+          frame->has_alpha = has_alpha;
+          frame->timestamp = frame_timestamp;
+          frame->duration  = (delay <= 0 || force_delay) ? default_delay : delay;
+
+          /* Attempt to allocate a buffer of the appropriate size */
+          frame->pixels = g_try_malloc ((gsize) frame->width *
+                                        frame->height * bpp);
+
+          if (! frame->pixels)
             {
-              gchar *error_str = webp_error_string (picture.error_code);
-              g_printerr ("ERROR[%d]: line %d: %s\n",
-                          picture.error_code, __LINE__,
-                          error_str);
-              g_free (error_str);
+              g_printerr ("Buffer error: 'buffer null'\n");
+
+              if (! all_keyframes)
+                g_free (frame);
               status = FALSE;
+              break;
             }
 
-          WebPMemoryWriterClear (&mw);
-          WebPPictureFree (&picture);
+          /* Read the region into the buffer */
+          gegl_buffer_get (current_frame, &extent, 1.0, format, frame->pixels,
+                           GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+          frame_timestamp += frame->duration;
 
-          if (status == FALSE)
-            break;
+          if (! all_keyframes)
+            {
+              g_async_queue_push (pipeline.frames, frame);
 
-          gimp_progress_update ((i + 1.0) / n_layers);
-          frame_timestamp += (delay <= 0 || force_delay) ? default_delay : delay;
+              gimp_progress_update ((gdouble) g_atomic_int_get (&pipeline.n_encoded) /
+                                    n_layers);
+            }
+          else if (window.n_frames == window_size || ! list->next)
+            {
+              gegl_parallel_distribute (window.n_frames,
+                                        (GeglParallelDistributeFunc) webp_encode_frames,
+                                        &window);
+
+              if (! webp_mux_frames (frames_mux, &window))
+                {
+                  status = FALSE;
+                  break;
+                }
+
+              gimp_progress_update ((i + 1.0) / n_layers);
+            }
         }
 
-      g_free (buffer);
+      if (encode_thread)
+        {
+          g_async_queue_push (pipeline.frames, &end_of_frames);
+          g_thread_join (encode_thread);
+          encode_thread = NULL;
+
+          if (g_atomic_int_get (&pipeline.failed))
+            status = FALSE;
+        }
 
       if (status == FALSE)
         break;
 
-      WebPAnimEncoderAdd (enc, NULL, frame_timestamp, NULL);
-
-      if (! WebPAnimEncoderAssemble (enc, &webp_data))
+      if (all_keyframes)
         {
-          g_printerr ("ERROR: %s\n",
-                      WebPAnimEncoderGetError (enc));
-          status = FALSE;
-          break;
+          if (WebPMuxSetCanvasSize (frames_mux, w, h) != WEBP_MUX_OK ||
+              WebPMuxSetAnimationParams (frames_mux,
+                                         &enc_options.anim_params) != WEBP_MUX_OK ||
+              WebPMuxAssemble (frames_mux, &webp_data) != WEBP_MUX_OK)
+            {
+              g_printerr ("ERROR: could not assemble the animation\n");
+              status = FALSE;
+              break;
+            }
+        }
+      else
+        {
+          WebPAnimEncoderAdd (enc, NULL, frame_timestamp, NULL);
+
+          if (! WebPAnimEncoderAssemble (enc, &webp_data))
+            {
+              g_printerr ("ERROR: %s\n",
+                          WebPAnimEncoderGetError (enc));
+              status = FALSE;
+              break;
+            }
         }
 
       /* Create a mux object if profile is present */
@@ -834,6 +1096,26 @@ save_animation (GFile         *file,
   while (0);
 
   /* Free any resources */
+  if (encode_thread)
+    {
+      g_async_queue_push (pipeline.frames, &end_of_frames);
+      g_thread_join (encode_thread);
+    }
+
+  if (window.frames)
+    {
+      gint f;
+
+      /* frames of a window which was not encoded */
+      for (f = 0; f < window.n_frames; f++)
+        g_free (window.frames[f].pixels);
+
+      g_free (window.frames);
+    }
+
+  g_clear_pointer (&pipeline.frames, g_async_queue_unref);
+  g_clear_pointer (&pipeline.slots, g_async_queue_unref);
+  WebPMuxDelete (frames_mux);
   WebPDataClear (&webp_data);
   WebPAnimEncoderDelete (enc);
   g_clear_object (&profile);
@@ -90,18 +90,40 @@ static pointer  script_fu_use_v2_call                       (scheme    *sc,
                                                              pointer    a);
 static pointer  script_fu_quit_call                         (scheme    *sc,
                                                              pointer    a);
+static pointer  script_fu_pdb_batch_begin_call              (scheme    *sc,
+                                                             pointer    a);
+static pointer  script_fu_pdb_batch_run_call                (scheme    *sc,
+                                                             pointer    a);
+static pointer  script_fu_pdb_batch_abort_call              (scheme    *sc,
+                                                             pointer    a);
 static pointer  script_fu_nil_call                          (scheme    *sc,
                                                              pointer    a);
 
 static gboolean ts_load_file                                (const gchar *dirname,
                                                              const gchar *basename);
 
+static void     script_fu_pdb_batch_clear                   (void);
+static gboolean script_fu_pdb_batch_get_ref                 (scheme      *sc,
+                                                             pointer      arg,
+                                                             gint        *call,
+                                                             gint        *value);
+
 typedef struct
 {
   const gchar *name;
   gint         value;
 } NamedConstant;
 
+/* An argument of a deferred PDB call which refers to a return value of
+ * an earlier call of the same batch.
+ */
+typedef struct
+{
+  const gchar *arg_name;
+  gint         call;
+  gint         value;
+} BatchRef;
+
 /* LHS is text in a script, RHS is constant defined in C. */
 static const NamedConstant script_constants[] =
 {
@@ -195,6 +217,15 @@ static scheme sc;
 static TsCallbackFunc post_command_callback = NULL;
 static TsCallbackFunc quit_callback         = NULL;
 
+/* Non-NULL inside (script-fu-pdb-batch), where PDB calls are deferred,
+ * with the names of the deferred procedures.
+ */
+static GimpPDBBatch  *pdb_batch             = NULL;
+static GPtrArray     *pdb_batch_names       = NULL;
+
+/* Whether script-fu-register and friends register scripts in the PDB. */
+static gboolean       registers_scripts     = FALSE;
+
 void
 tinyscheme_init (GList    *path,
                  gboolean  register_scripts)
@@ -231,10 +262,21 @@ tinyscheme_init (GList    *path,
   /* register in the interpreter the gimp functions and types. */
   ts_init_constants (&sc, repo);
   ts_init_procedures (&sc, register_scripts);
+  registers_scripts = register_scripts;
 
   ts_load_init_and_compatibility_scripts (path);
 }
 
+/* Whether the interpreter was initialized to register scripts in the PDB.
+ * When not, script-fu-register and friends do nothing,
+ * and callers call the run functions of scripts directly.
+ */
+gboolean
+ts_registers_scripts (void)
+{
+  return registers_scripts;
+}
+
 /* Create an SF-RUN-MODE constant for use in scripts.
  * It is set to the run mode state determined by GIMP.
  */
@@ -280,6 +322,9 @@ ts_interpret_string (const gchar *expr)
   sc.tracing = 1;
 #endif
 
+  /* Drop a batch left open by a previous command. */
+  script_fu_pdb_batch_clear ();
+
   sc.vptr->load_string (&sc, (char *) expr);
 
   result = sc.retcode;
@@ -538,6 +583,38 @@ ts_define_procedure (sc, "load-extension", scm_load_ext);
   ts_define_procedure (sc, "script-fu-use-v2",    script_fu_use_v2_call);
   ts_define_procedure (sc, "script-fu-quit",      script_fu_quit_call);
 
+  /* Run the PDB calls of a thunk in one round trip to GIMP, e.g.
+   * (script-fu-pdb-batch (lambda () (gimp-item-set-visible layer #f) ...))
+   *
+   * The calls are deferred until the thunk returns, so their values are
+   * not available to it: a deferred call returns the index of the call
+   * in the batch instead.  An argument of a later call can refer to a
+   * return value of the call with (script-fu-pdb-batch-ref index) for
+   * the first one, or (script-fu-pdb-batch-ref index n) for the n-th.
+   *
+   * The result is the list of the results of the calls, in order, as
+   * they would have returned them.  An error in the thunk drops the
+   * batch, so no call of it runs.
+   */
+  ts_define_procedure (sc, "-script-fu-pdb-batch-begin", script_fu_pdb_batch_begin_call);
+  ts_define_procedure (sc, "-script-fu-pdb-batch-run",   script_fu_pdb_batch_run_call);
+  ts_define_procedure (sc, "-script-fu-pdb-batch-abort", script_fu_pdb_batch_abort_call);
+  sc->vptr->load_string (sc,
+                         " (define (script-fu-pdb-batch thunk)"
+                         "   (let ((hook *error-hook*))"
+                         "     (-script-fu-pdb-batch-begin)"
+                         "     (set! *error-hook*"
+                         "           (lambda args"
+                         "             (set! *error-hook* hook)"
+                         "             (-script-fu-pdb-batch-abort)"
+                         "             (apply hook args)))"
+                         "     (thunk)"
+                         "     (set! *error-hook* hook)"
+                         "     (-script-fu-pdb-batch-run)))"
+                         " (define (script-fu-pdb-batch-ref call . value)"
+                         "   (list '-script-fu-pdb-batch-ref call"
+                         "         (if (null? value) 1 (car value))))");
+
   /* Define wrapper functions, not used in scripts.
    * FUTURE: eliminate all but one, deprecated and permissive is obsolete.
    */
@@ -711,6 +788,7 @@ script_fu_marshal_procedure_call (scheme   *sc,
   gint                  n_arg_specs;
   gint                  actual_arg_count;
   gint                  consumed_arg_count = 0;
+  GArray               *batch_refs = NULL;
   gchar                 error_str[1024];
   gint                  i;
   pointer               return_val = sc->NIL;
@@ -811,6 +889,42 @@ script_fu_marshal_procedure_call (scheme   *sc,
 
       debug_in_arg (sc, a, i, g_type_name (G_VALUE_TYPE (&value)));
 
+      /* A reference to a return value of an earlier call of the batch,
+       * the core fills it in when it runs the call.
+       */
+      {
+        BatchRef ref;
+
+        if (script_fu_pdb_batch_get_ref (sc, sc->vptr->pair_car (a),
+                                         &ref.call, &ref.value))
+          {
+            if (! pdb_batch)
+              return script_error (sc, "script-fu-pdb-batch-ref used "
+                                   "outside script-fu-pdb-batch", 0);
+
+            if (ref.call < 0 ||
+                ref.call >= gimp_pdb_batch_get_n_calls (pdb_batch) ||
+                ref.value < 1)
+              {
+                g_snprintf (error_str, sizeof (error_str),
+                            "Argument %d for %s refers to return value %d "
+                            "of the call at index %d, which is not an "
+                            "earlier call of the batch",
+                            i + 1, proc_name, ref.value, ref.call);
+                return script_error (sc, error_str, 0);
+              }
+
+            ref.arg_name = g_param_spec_get_name (arg_spec);
+
+            if (! batch_refs)
+              batch_refs = g_array_new (FALSE, FALSE, sizeof (BatchRef));
+
+            g_array_append_val (batch_refs, ref);
+            g_value_unset (&value);
+            continue;
+          }
+      }
+
       if (G_VALUE_HOLDS_INT (&value))
         {
           if (! sc->vptr->is_number (sc->vptr->pair_car (a)))
@@ -1429,6 +1543,28 @@ script_fu_marshal_procedure_call (scheme   *sc,
   if (strcmp (proc_name, "script-fu-refresh") == 0)
       return script_error (sc, "A script cannot refresh scripts", 0);
 
+  if (pdb_batch)
+    {
+      gint call;
+
+      /* Inside script-fu-pdb-batch: only queue the call. */
+      call = gimp_pdb_batch_add (pdb_batch, config);
+      g_clear_object (&config);
+
+      for (i = 0; batch_refs && i < batch_refs->len; i++)
+        {
+          BatchRef *ref = &g_array_index (batch_refs, BatchRef, i);
+
+          gimp_pdb_batch_add_reference (pdb_batch, call, ref->arg_name,
+                                        ref->call, ref->value);
+        }
+
+      g_clear_pointer (&batch_refs, g_array_unref);
+      g_ptr_array_add (pdb_batch_names, proc_name);
+
+      return sc->vptr->mk_integer (sc, call);
+    }
+
   g_debug ("calling %s", proc_name);
   values = gimp_procedure_run_config (procedure, config);
   g_debug ("done.");
@@ -1557,9 +1693,144 @@ script_fu_quit_call (scheme  *sc,
   return sc->NIL;
 }
 
+static pointer
+script_fu_pdb_batch_begin_call (scheme  *sc,
+                                pointer  a)
+{
+  if (pdb_batch)
+    return script_error (sc, "script-fu-pdb-batch cannot be nested", 0);
+
+  pdb_batch       = gimp_pdb_batch_new (gimp_get_pdb ());
+  pdb_batch_names = g_ptr_array_new_with_free_func (g_free);
+
+  return sc->NIL;
+}
+
+static pointer
+script_fu_pdb_batch_run_call (scheme  *sc,
+                              pointer  a)
+{
+  GimpPDBBatch *batch = pdb_batch;
+  GPtrArray    *names = pdb_batch_names;
+  pointer       result;
+  gchar         error_str[1024];
+  gint          n_calls;
+  gint          n_results;
+  gboolean      success;
+  gint          i;
+
+  if (! batch)
+    return script_error (sc, "in script-fu-pdb-batch, the batch was "
+                         "dropped by an error", 0);
+
+  /* Calls are run normally again from here on. */
+  pdb_batch       = NULL;
+  pdb_batch_names = NULL;
+
+  n_calls   = gimp_pdb_batch_get_n_calls (batch);
+  success   = gimp_pdb_batch_run (batch);
+  n_results = gimp_pdb_batch_get_n_results (batch);
+
+  if (post_command_callback != NULL)
+    post_command_callback ();
+
+  if (! success)
+    {
+      if (n_results > 0 && n_results <= n_calls)
+        g_snprintf (error_str, sizeof (error_str),
+                    "in script-fu-pdb-batch, the call of %s at index %d "
+                    "failed: %s",
+                    (gchar *) g_ptr_array_index (names, n_results - 1),
+                    n_results - 1,
+                    gimp_pdb_get_last_error (gimp_get_pdb ()));
+      else
+        g_snprintf (error_str, sizeof (error_str),
+                    "in script-fu-pdb-batch, the batch failed: %s",
+                    gimp_pdb_get_last_error (gimp_get_pdb ()));
+
+      result = script_error (sc, error_str, 0);
+    }
+  else
+    {
+      /* Counting down, to build the list from its end. */
+      result = sc->NIL;
+
+      for (i = n_results - 1; i >= 0; i--)
+        {
+          GimpValueArray *values;
+          pointer         value;
+          pointer         calling_error;
+
+          values = gimp_pdb_batch_get_return_values (batch, i);
+          value  = marshal_PDB_return (sc, values,
+                                       g_ptr_array_index (names, i),
+                                       &calling_error);
+
+          if (calling_error != NULL)
+            {
+              result = calling_error;
+              break;
+            }
+
+          result = sc->vptr->cons (sc, value, result);
+        }
+    }
+
+  g_object_unref (batch);
+  g_ptr_array_unref (names);
+
+  return result;
+}
+
+static pointer
+script_fu_pdb_batch_abort_call (scheme  *sc,
+                                pointer  a)
+{
+  script_fu_pdb_batch_clear ();
+
+  return sc->NIL;
+}
+
 static pointer
 script_fu_nil_call (scheme  *sc,
                     pointer  a)
 {
   return sc->NIL;
 }
+
+static void
+script_fu_pdb_batch_clear (void)
+{
+  g_clear_object (&pdb_batch);
+  g_clear_pointer (&pdb_batch_names, g_ptr_array_unref);
+}
+
+/* Whether @arg is made by (script-fu-pdb-batch-ref call value). */
+static gboolean
+script_fu_pdb_batch_get_ref (scheme  *sc,
+                             pointer  arg,
+                             gint    *call,
+                             gint    *value)
+{
+  pointer tag;
+
+  if (! sc->vptr->is_pair (arg) || sc->vptr->list_length (sc, arg) != 3)
+    return FALSE;
+
+  tag = sc->vptr->pair_car (arg);
+
+  if (! sc->vptr->is_symbol (tag) ||
+      strcmp (sc->vptr->symname (tag), "-script-fu-pdb-batch-ref"))
+    return FALSE;
+
+  arg = sc->vptr->pair_cdr (arg);
+
+  if (! sc->vptr->is_integer (sc->vptr->pair_car (arg)) ||
+      ! sc->vptr->is_integer (sc->vptr->pair_car (sc->vptr->pair_cdr (arg))))
+    return FALSE;
+
+  *call  = sc->vptr->ivalue (sc->vptr->pair_car (arg));
+  *value = sc->vptr->ivalue (sc->vptr->pair_car (sc->vptr->pair_cdr (arg)));
+
+  return TRUE;
+}
@@ -26,6 +26,7 @@ typedef pointer (*TsWrapperFunc) (scheme*, pointer);
 
 void          tinyscheme_init         (GList        *path,
                                        gboolean      register_scripts);
+gboolean      ts_registers_scripts    (void);
 
 void          ts_set_run_mode         (GimpRunMode   run_mode);
 
@@ -0,0 +1,651 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <math.h>
+#include <string.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include <libgimp/gimp.h>
+
+#include "tinyscheme/scheme-private.h"
+
+#include "script-fu-scripts.h"
+#include "script-fu-utils.h"
+#include "script-fu-command.h"
+
+#include "script-fu-scripts-cache.h"
+
+#include "script-fu-intl.h"
+
+
+/* A cache of the registrations made by script files.
+ *
+ * Loading a script file evaluates all of it, just to collect its calls to
+ * script-fu-register and friends.  For each file that only defines things
+ * and registers procedures, we remember the evaluated arguments of those
+ * calls, keyed by the file's path, modification time and size.
+ *
+ * On the next startup, an unchanged file is not evaluated.  Instead we
+ * replay its registrations, which is enough to create the SFScripts and
+ * install the PDB procedures, and defer loading the file until one of the
+ * procedures actually runs.
+ *
+ * Registrations carry translated strings and enum values, so the whole
+ * cache is dropped when the GIMP version or the user's languages change.
+ *
+ * Only used by script_fu_find_scripts, i.e. by extension-script-fu.
+ */
+
+
+#define CACHE_VERSION      1
+#define CACHE_HEADER_GROUP "script-fu-cache"
+
+
+typedef struct
+{
+  gchar     *path;
+  gint64     mtime;
+  gint64     size;
+  GString   *registrations;
+  GPtrArray *names;
+  gboolean   cacheable;
+} CacheRecording;
+
+
+static gchar    * script_fu_scripts_cache_get_filename  (void);
+static gchar    * script_fu_scripts_cache_get_languages (void);
+static gboolean   script_fu_scripts_cache_stat          (GFile          *file,
+                                                         gint64         *mtime,
+                                                         gint64         *size);
+static void       script_fu_scripts_cache_copy_entry    (const gchar    *group);
+static gboolean   script_fu_scripts_cache_serialize     (scheme         *sc,
+                                                         pointer         datum,
+                                                         GString        *string);
+static void       script_fu_scripts_cache_clear_deferred (void);
+
+
+static GKeyFile       *old_cache        = NULL;
+static GHashTable     *old_entries      = NULL;  /* path -> group in old_cache */
+static GKeyFile       *new_cache        = NULL;
+static gint            n_new_entries    = 0;
+static guint           n_carried        = 0;
+static gboolean        cache_changed    = FALSE;
+
+static CacheRecording *recording        = NULL;
+
+static GHashTable     *deferred_names   = NULL;
+static GList          *deferred_files   = NULL;
+static gboolean        loading_deferred = FALSE;
+
+
+/*  public functions  */
+
+/* Start a scan of the script directories.
+ * Forgets any files deferred by an earlier scan, they will be
+ * replayed again or loaded normally.
+ */
+void
+script_fu_scripts_cache_open (void)
+{
+  gchar  *filename;
+  gchar  *languages;
+  GError *error = NULL;
+
+  g_return_if_fail (new_cache == NULL);
+
+  script_fu_scripts_cache_clear_deferred ();
+
+  languages = script_fu_scripts_cache_get_languages ();
+
+  new_cache = g_key_file_new ();
+  g_key_file_set_integer (new_cache, CACHE_HEADER_GROUP, "version",
+                          CACHE_VERSION);
+  g_key_file_set_string (new_cache, CACHE_HEADER_GROUP, "gimp-version",
+                         GIMP_VERSION);
+  g_key_file_set_string (new_cache, CACHE_HEADER_GROUP, "languages",
+                         languages);
+
+  n_new_entries = 0;
+  n_carried     = 0;
+  cache_changed = FALSE;
+
+  old_entries = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                       g_free, g_free);
+
+  filename  = script_fu_scripts_cache_get_filename ();
+  old_cache = g_key_file_new ();
+
+  if (g_key_file_load_from_file (old_cache, filename,
+                                 G_KEY_FILE_NONE, &error))
+    {
+      gchar *old_version   = g_key_file_get_string (old_cache,
+                                                    CACHE_HEADER_GROUP,
+                                                    "gimp-version", NULL);
+      gchar *old_languages = g_key_file_get_string (old_cache,
+                                                    CACHE_HEADER_GROUP,
+                                                    "languages", NULL);
+
+      if (g_key_file_get_integer (old_cache, CACHE_HEADER_GROUP,
+                                  "version", NULL) == CACHE_VERSION &&
+          g_strcmp0 (old_version,   GIMP_VERSION) == 0 &&
+          g_strcmp0 (old_languages, languages)    == 0)
+        {
+          gchar **groups = g_key_file_get_groups (old_cache, NULL);
+          gint    i;
+
+          for (i = 0; groups[i]; i++)
+            {
+              gchar *path;
+
+              if (! strcmp (groups[i], CACHE_HEADER_GROUP))
+                continue;
+
+              path = g_key_file_get_string (old_cache, groups[i], "file", NULL);
+
+              if (path)
+                g_hash_table_insert (old_entries, path, g_strdup (groups[i]));
+            }
+
+          g_strfreev (groups);
+        }
+      else
+        {
+          g_debug ("%s: discarding stale script cache", G_STRFUNC);
+          cache_changed = TRUE;
+        }
+
+      g_free (old_version);
+      g_free (old_languages);
+    }
+  else
+    {
+      if (! g_error_matches (error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+        g_debug ("%s: %s", G_STRFUNC, error->message);
+
+      g_clear_error (&error);
+      cache_changed = TRUE;
+    }
+
+  g_free (languages);
+  g_free (filename);
+}
+
+/* Finish a scan, writing the cache back if any entry was added,
+ * dropped or invalidated.
+ */
+void
+script_fu_scripts_cache_close (void)
+{
+  if (! new_cache)
+    return;
+
+  if (n_carried != g_hash_table_size (old_entries))
+    cache_changed = TRUE;
+
+  if (cache_changed)
+    {
+      gchar  *filename = script_fu_scripts_cache_get_filename ();
+      gchar  *dirname  = g_path_get_dirname (filename);
+      GError *error    = NULL;
+
+      g_mkdir_with_parents (dirname, 0700);
+
+      if (! g_key_file_save_to_file (new_cache, filename, &error))
+        {
+          g_debug ("%s: %s", G_STRFUNC, error->message);
+          g_clear_error (&error);
+        }
+
+      g_free (dirname);
+      g_free (filename);
+    }
+
+  g_clear_pointer (&old_entries, g_hash_table_unref);
+  g_clear_pointer (&old_cache,   g_key_file_free);
+  g_clear_pointer (&new_cache,   g_key_file_free);
+}
+
+/* Replay the cached registrations of file, if it didn't change since
+ * they were recorded.  Returns TRUE when the file need not be loaded.
+ */
+gboolean
+script_fu_scripts_cache_replay (GFile *file)
+{
+  const gchar  *group;
+  gchar        *path;
+  gchar        *registrations;
+  gchar       **names;
+  gint64        mtime;
+  gint64        size;
+  GError       *error   = NULL;
+  gboolean      success = FALSE;
+
+  if (! new_cache)
+    return FALSE;
+
+  path  = g_file_get_path (file);
+  group = g_hash_table_lookup (old_entries, path);
+
+  if (! group ||
+      ! script_fu_scripts_cache_stat (file, &mtime, &size) ||
+      g_key_file_get_int64 (old_cache, group, "mtime", NULL) != mtime ||
+      g_key_file_get_int64 (old_cache, group, "size",  NULL) != size)
+    {
+      g_free (path);
+      return FALSE;
+    }
+
+  registrations = g_key_file_get_string (old_cache, group,
+                                         "registrations", NULL);
+  names         = g_key_file_get_string_list (old_cache, group,
+                                              "procedures", NULL, NULL);
+
+  if (registrations && names)
+    {
+      if (script_fu_run_command (registrations, &error))
+        {
+          gint i;
+
+          for (i = 0; names[i]; i++)
+            g_hash_table_add (deferred_names, g_strdup (names[i]));
+
+          deferred_files = g_list_prepend (deferred_files, g_strdup (path));
+
+          script_fu_scripts_cache_copy_entry (group);
+          success = TRUE;
+        }
+      else
+        {
+          g_debug ("%s: replaying %s failed: %s",
+                   G_STRFUNC, path, error->message);
+          g_clear_error (&error);
+        }
+    }
+
+  g_strfreev (names);
+  g_free (registrations);
+  g_free (path);
+
+  return success;
+}
+
+/* Start recording the registrations made while loading file. */
+void
+script_fu_scripts_cache_record_begin (GFile *file)
+{
+  if (! new_cache)
+    return;
+
+  g_return_if_fail (recording == NULL);
+
+  recording = g_slice_new0 (CacheRecording);
+
+  recording->path          = g_file_get_path (file);
+  recording->registrations = g_string_new (NULL);
+  recording->names         = g_ptr_array_new_with_free_func (g_free);
+  recording->cacheable     = script_fu_scripts_cache_stat (file,
+                                                           &recording->mtime,
+                                                           &recording->size);
+}
+
+/* Record one call to a registering function, with its evaluated
+ * arguments a.  A call whose arguments can't be written back as a
+ * literal makes the whole file uncacheable.
+ */
+void
+script_fu_scripts_cache_record (scheme      *sc,
+                                const gchar *func_name,
+                                pointer      a,
+                                gboolean     defines_procedure)
+{
+  GString *datum;
+
+  if (! recording || ! recording->cacheable)
+    return;
+
+  datum = g_string_new (NULL);
+
+  if (script_fu_scripts_cache_serialize (sc, a, datum))
+    {
+      g_string_append_printf (recording->registrations,
+                              "(apply %s '%s)\n", func_name, datum->str);
+
+      if (defines_procedure)
+        {
+          pointer name = sc->vptr->pair_car (a);
+
+          if (sc->vptr->is_string (name))
+            g_ptr_array_add (recording->names,
+                             g_strdup (sc->vptr->string_value (name)));
+          else
+            recording->cacheable = FALSE;
+        }
+    }
+  else
+    {
+      recording->cacheable = FALSE;
+    }
+
+  g_string_free (datum, TRUE);
+}
+
+/* Stop recording.  The file is cached only if it loaded without error,
+ * registered at least one procedure, and defined the run function of
+ * every procedure it registered.  Other files, e.g. libraries of helper
+ * functions, are loaded on every startup.
+ */
+void
+script_fu_scripts_cache_record_end (gboolean success)
+{
+  CacheRecording *rec = recording;
+
+  if (! rec)
+    return;
+
+  recording = NULL;
+
+  if (success && rec->cacheable && rec->names->len > 0)
+    {
+      guint i;
+
+      for (i = 0; i < rec->names->len; i++)
+        {
+          if (! script_fu_is_defined (g_ptr_array_index (rec->names, i)))
+            {
+              success = FALSE;
+              break;
+            }
+        }
+
+      if (success)
+        {
+          gchar *group = g_strdup_printf ("script %d", n_new_entries++);
+
+          g_key_file_set_string (new_cache, group, "file", rec->path);
+          g_key_file_set_int64 (new_cache, group, "mtime", rec->mtime);
+          g_key_file_set_int64 (new_cache, group, "size",  rec->size);
+          g_key_file_set_string_list (new_cache, group, "procedures",
+                                      (const gchar * const *) rec->names->pdata,
+                                      rec->names->len);
+          g_key_file_set_string (new_cache, group, "registrations",
+                                 rec->registrations->str);
+
+          cache_changed = TRUE;
+
+          g_free (group);
+        }
+    }
+
+  g_ptr_array_unref (rec->names);
+  g_string_free (rec->registrations, TRUE);
+  g_free (rec->path);
+  g_slice_free (CacheRecording, rec);
+}
+
+/* Whether name was registered from the cache, and its run function
+ * is not yet defined in the interpreter.
+ */
+gboolean
+script_fu_scripts_cache_is_deferred (const gchar *name)
+{
+  return deferred_names && g_hash_table_contains (deferred_names, name);
+}
+
+/* Whether deferred files are being loaded.  Their registrations were
+ * already replayed, so the registering functions must ignore them.
+ */
+gboolean
+script_fu_scripts_cache_is_loading (void)
+{
+  return loading_deferred;
+}
+
+/* Load the files whose loading was deferred, in the order they were
+ * found.  Called before running any script.
+ *
+ * All deferred files are loaded at once, not only the one defining the
+ * script being run: scripts may use functions defined in other files.
+ */
+void
+script_fu_scripts_cache_load_deferred (void)
+{
+  GList *files;
+  GList *list;
+
+  if (! deferred_files || loading_deferred)
+    return;
+
+  files          = g_list_reverse (deferred_files);
+  deferred_files = NULL;
+
+  loading_deferred = TRUE;
+
+  for (list = files; list; list = g_list_next (list))
+    {
+      gchar  *escaped = script_fu_strescape (list->data);
+      gchar  *command = g_strdup_printf ("(load \"%s\")", escaped);
+      GError *error   = NULL;
+
+      if (! script_fu_run_command (command, &error))
+        {
+          gchar *message = g_strdup_printf (_("Error while loading %s:"),
+                                            (const gchar *) list->data);
+
+          g_message ("%s\n\n%s", message, error->message);
+
+          g_clear_error (&error);
+          g_free (message);
+        }
+
+      g_free (command);
+      g_free (escaped);
+    }
+
+  loading_deferred = FALSE;
+
+  g_list_free_full (files, g_free);
+  g_clear_pointer (&deferred_names, g_hash_table_unref);
+}
+
+
+/*  private functions  */
+
+static gchar *
+script_fu_scripts_cache_get_filename (void)
+{
+  return g_build_filename (gimp_cache_directory (), "script-fu-cache", NULL);
+}
+
+static gchar *
+script_fu_scripts_cache_get_languages (void)
+{
+  return g_strjoinv (":", (gchar **) g_get_language_names ());
+}
+
+static gboolean
+script_fu_scripts_cache_stat (GFile  *file,
+                              gint64 *mtime,
+                              gint64 *size)
+{
+  GFileInfo *info;
+
+  info = g_file_query_info (file,
+                            G_FILE_ATTRIBUTE_TIME_MODIFIED ","
+                            G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC ","
+                            G_FILE_ATTRIBUTE_STANDARD_SIZE,
+                            G_FILE_QUERY_INFO_NONE,
+                            NULL, NULL);
+
+  if (! info)
+    return FALSE;
+
+  *mtime = (gint64) g_file_info_get_attribute_uint64 (info,
+                                                      G_FILE_ATTRIBUTE_TIME_MODIFIED) *
+           G_USEC_PER_SEC +
+           g_file_info_get_attribute_uint32 (info,
+                                             G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC);
+  *size  = g_file_info_get_size (info);
+
+  g_object_unref (info);
+
+  return TRUE;
+}
+
+static void
+script_fu_scripts_cache_copy_entry (const gchar *group)
+{
+  static const gchar *keys[] = { "file", "mtime", "size",
+                                 "procedures", "registrations" };
+  gchar *new_group = g_strdup_printf ("script %d", n_new_entries++);
+  guint  i;
+
+  for (i = 0; i < G_N_ELEMENTS (keys); i++)
+    {
+      gchar *value = g_key_file_get_value (old_cache, group, keys[i], NULL);
+
+      if (value)
+        g_key_file_set_value (new_cache, new_group, keys[i], value);
+
+      g_free (value);
+    }
+
+  n_carried++;
+
+  g_free (new_group);
+}
+
+/* Write datum as Scheme text that reads back as an equal datum.
+ * Only handles what registration arguments evaluate to.
+ */
+static gboolean
+script_fu_scripts_cache_serialize (scheme  *sc,
+                                   pointer  datum,
+                                   GString *string)
+{
+  if (datum == sc->NIL)
+    {
+      g_string_append (string, "()");
+    }
+  else if (datum == sc->T)
+    {
+      g_string_append (string, "#t");
+    }
+  else if (datum == sc->F)
+    {
+      g_string_append (string, "#f");
+    }
+  else if (sc->vptr->is_string (datum))
+    {
+      const gchar *s;
+
+      g_string_append_c (string, '"');
+
+      for (s = sc->vptr->string_value (datum); *s; s++)
+        {
+          switch (*s)
+            {
+            case '"':
+            case '\\':
+              g_string_append_c (string, '\\');
+              g_string_append_c (string, *s);
+              break;
+
+            case '\n':
+              g_string_append (string, "\\n");
+              break;
+
+            default:
+              g_string_append_c (string, *s);
+              break;
+            }
+        }
+
+      g_string_append_c (string, '"');
+    }
+  else if (sc->vptr->is_integer (datum))
+    {
+      g_string_append_printf (string, "%ld", sc->vptr->ivalue (datum));
+    }
+  else if (sc->vptr->is_real (datum))
+    {
+      gchar  buffer[G_ASCII_DTOSTR_BUF_SIZE];
+      double value = sc->vptr->rvalue (datum);
+
+      if (! isfinite (value))
+        return FALSE;
+
+      g_ascii_dtostr (buffer, sizeof (buffer), value);
+      g_string_append (string, buffer);
+
+      /* Keep it a real when read back. */
+      if (! strpbrk (buffer, ".eE"))
+        g_string_append (string, ".0");
+    }
+  else if (sc->vptr->is_symbol (datum))
+    {
+      g_string_append (string, sc->vptr->symname (datum));
+    }
+  else if (sc->vptr->is_pair (datum))
+    {
+      g_string_append_c (string, '(');
+
+      while (sc->vptr->is_pair (datum))
+        {
+          if (! script_fu_scripts_cache_serialize (sc,
+                                                   sc->vptr->pair_car (datum),
+                                                   string))
+            return FALSE;
+
+          datum = sc->vptr->pair_cdr (datum);
+
+          if (datum != sc->NIL)
+            g_string_append_c (string, ' ');
+        }
+
+      if (datum != sc->NIL)
+        {
+          g_string_append (string, ". ");
+
+          if (! script_fu_scripts_cache_serialize (sc, datum, string))
+            return FALSE;
+        }
+
+      g_string_append_c (string, ')');
+    }
+  else
+    {
+      /* Vectors, characters, closures... */
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+static void
+script_fu_scripts_cache_clear_deferred (void)
+{
+  g_list_free_full (deferred_files, g_free);
+  deferred_files = NULL;
+
+  g_clear_pointer (&deferred_names, g_hash_table_unref);
+  deferred_names = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                          g_free, NULL);
+}
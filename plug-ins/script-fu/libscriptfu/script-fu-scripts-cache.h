@@ -0,0 +1,39 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __SCRIPT_FU_SCRIPTS_CACHE_H__
+#define __SCRIPT_FU_SCRIPTS_CACHE_H__
+
+
+void      script_fu_scripts_cache_open          (void);
+void      script_fu_scripts_cache_close         (void);
+
+gboolean  script_fu_scripts_cache_replay        (GFile       *file);
+
+void      script_fu_scripts_cache_record_begin  (GFile       *file);
+void      script_fu_scripts_cache_record        (scheme      *sc,
+                                                 const gchar *func_name,
+                                                 pointer      a,
+                                                 gboolean     defines_procedure);
+void      script_fu_scripts_cache_record_end    (gboolean     success);
+
+gboolean  script_fu_scripts_cache_is_deferred   (const gchar *name);
+gboolean  script_fu_scripts_cache_is_loading    (void);
+void      script_fu_scripts_cache_load_deferred (void);
+
+
+#endif /*  __SCRIPT_FU_SCRIPTS_CACHE_H__  */
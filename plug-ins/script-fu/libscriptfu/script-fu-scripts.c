@@ -29,10 +29,12 @@
 
 #include "tinyscheme/scheme-private.h"
 
+#include "scheme-wrapper.h"
 #include "script-fu-lib.h"
 #include "script-fu-types.h"
 #include "script-fu-script.h"
 #include "script-fu-scripts.h"
+#include "script-fu-scripts-cache.h"
 #include "script-fu-utils.h"
 #include "script-fu-register.h"
 #include "script-fu-command.h"
@@ -138,7 +140,15 @@ void
 script_fu_find_scripts (GimpPlugIn *plug_in,
                         GList      *path)
 {
+  /* Unchanged scripts register from the cache, and load on first use.
+   * Only when scripts register in the PDB: otherwise, as in the console,
+   * eval and server, the caller calls their run functions directly,
+   * so every script must be loaded now.
+   */
+  if (ts_registers_scripts ())
+    script_fu_scripts_cache_open ();
   script_fu_find_scripts_into_tree (plug_in, path);
+  script_fu_scripts_cache_close ();
 
   /*  Now that all scripts are read in and sorted, tell gimp about them  */
   g_tree_foreach (script_tree,
@@ -169,6 +179,12 @@ script_fu_add_script (scheme  *sc,
   SFScript    *script;
   pointer      args_error;
 
+  /* Already registered from the cache. */
+  if (script_fu_scripts_cache_is_loading ())
+    return sc->NIL;
+
+  script_fu_scripts_cache_record (sc, "script-fu-register", a, TRUE);
+
   /*  Check metadata args args are present */
   if (sc->vptr->list_length (sc, a) < 7)
     return foreign_error (sc, "script-fu-register: Not enough arguments", 0);
@@ -221,6 +237,12 @@ script_fu_add_script_filter (scheme  *sc,
   SFScript    *script;
   pointer      args_error;  /* a foreign_error or NIL. */
 
+  /* Already registered from the cache. */
+  if (script_fu_scripts_cache_is_loading ())
+    return sc->NIL;
+
+  script_fu_scripts_cache_record (sc, "script-fu-register-filter", a, TRUE);
+
   /* Check metadata args args are present.
    * Has one more arg than script-fu-register.
    */
@@ -265,6 +287,12 @@ script_fu_add_script_regular (scheme  *sc,
   SFScript    *script;
   pointer      args_error;  /* a foreign_error or NIL. */
 
+  /* Already registered from the cache. */
+  if (script_fu_scripts_cache_is_loading ())
+    return sc->NIL;
+
+  script_fu_scripts_cache_record (sc, "script-fu-register-procedure", a, TRUE);
+
   /* Check metadata args args are present.
    * Has two less arg than script-fu-register.
    * Last metadata arg is "copyright date"
@@ -300,6 +328,12 @@ script_fu_add_menu (scheme  *sc,
   const gchar *name;
   const gchar *path;
 
+  /* Already registered from the cache. */
+  if (script_fu_scripts_cache_is_loading ())
+    return sc->NIL;
+
+  script_fu_scripts_cache_record (sc, "script-fu-menu-register", a, FALSE);
+
   /*  Check the length of a  */
   if (sc->vptr->list_length (sc, a) != 2)
     return foreign_error (sc, "Incorrect number of arguments for script-fu-menu-register", 0);
@@ -408,11 +442,23 @@ script_fu_load_script (GFile *file)
       gchar  *escaped = script_fu_strescape (path);
       gchar  *command;
       GError *error   = NULL;
+      gboolean success;
+
+      if (script_fu_scripts_cache_replay (file))
+        {
+          g_free (escaped);
+          g_free (path);
+          return;
+        }
 
       command = g_strdup_printf ("(load \"%s\")", escaped);
       g_free (escaped);
 
-      if (! script_fu_run_command (command, &error))
+      script_fu_scripts_cache_record_begin (file);
+      success = script_fu_run_command (command, &error);
+      script_fu_scripts_cache_record_end (success);
+
+      if (! success)
         {
           gchar *message = g_strdup_printf (_("Error while loading %s:"),
                                             gimp_file_get_utf8_name (file));
@@ -453,7 +499,9 @@ script_fu_install_script (gpointer  foo G_GNUC_UNUSED,
       SFScript *script = list->data;
 
       const gchar* name = script->name;
-      if (script_fu_is_defined (name))
+      /* A script registered from the cache is defined when first run. */
+      if (script_fu_scripts_cache_is_deferred (name) ||
+          script_fu_is_defined (name))
         script_fu_script_install_proc (plug_in, script);
       else
         g_warning ("Run function not defined, or does not match PDB procedure name: %s", name);
@@ -67,6 +67,15 @@ struct cell {
   } _object;
 };
 
+/* A segment is an arena of cells, allocated in one block.
+ * Segments grow with the heap, see alloc_cellseg.
+ */
+struct cell_segment {
+  char    *alloc;        /* as returned by malloc */
+  pointer  cells;        /* aligned start of the cells */
+  long     n_cells;
+};
+
 struct scheme {
 /* arrays for segments */
 func_alloc malloc;
@@ -78,14 +87,15 @@ int tracing;
 
 
 #ifndef CELL_SEGSIZE
-#define CELL_SEGSIZE    25000 /* # of cells in one segment */
+#define CELL_SEGSIZE     25000   /* # of cells in the smallest segment */
 #endif
-#ifndef CELL_NSEGMENT
-#define CELL_NSEGMENT   50    /* # of segments for cells */
+#ifndef CELL_SEGSIZE_MAX
+#define CELL_SEGSIZE_MAX 4194304 /* # of cells in the largest segment */
 #endif
-char *alloc_seg[CELL_NSEGMENT];
-pointer cell_seg[CELL_NSEGMENT];
-int     last_cell_seg;
+struct cell_segment *cell_seg; /* segments, in address order */
+int     n_cell_segs;
+int     max_cell_segs;          /* allocated length of cell_seg */
+long    total_cells;            /* # of cells in all segments */
 
 /* We use 5 registers. */
 pointer args;            /* register for arguments of function */
@@ -112,6 +122,12 @@ pointer global_env;      /* pointer to global environment */
 
 pointer c_nest;          /* stack for nested calls from C */
 
+/* Recent allocs the interpreter doesn't know about yet, marked by gc. */
+pointer *recent_allocs;
+long    n_recent_allocs;
+long    max_recent_allocs;
+long    recent_allocs_base;  /* # of those belonging to outer C calls */
+
 /* global pointers to special symbols */
 pointer LAMBDA;          /* pointer to syntax lambda */
 pointer QUOTE;           /* pointer to syntax quote */
@@ -143,6 +159,9 @@ int file_i;
 int nesting;
 
 char    gc_verbose;      /* if gc_verbose is not zero, print gc status */
+long    gc_count;        /* # of collections */
+gint64  gc_time;         /* microseconds spent collecting */
+gint64  start_time;      /* monotonic time of scheme_init */
 char    no_memory;       /* Whether mem. alloc. has failed */
 
 #ifndef LINESIZE
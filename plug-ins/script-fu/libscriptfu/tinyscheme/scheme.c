@@ -182,6 +182,10 @@ static int utf8_stricmp(const char *s1, const char *s2)
 # define FIRST_CELLSEGS 3
 #endif
 
+#ifndef GC_HEAP_RATIO
+# define GC_HEAP_RATIO 3 /* heap size to keep after gc, in live sizes */
+#endif
+
 enum scheme_types {
   T_STRING=1,
   T_NUMBER=2,
@@ -414,6 +418,7 @@ static void file_pop(scheme *sc);
 static int file_interactive(scheme *sc);
 static INLINE int is_one_of(char *s, gunichar c);
 static int alloc_cellseg(scheme *sc, int n);
+static int alloc_cellseg_cells(scheme *sc, long n_cells);
 static long binary_decode(const char *s);
 static INLINE pointer get_cell(scheme *sc, pointer a, pointer b);
 static pointer _get_cell(scheme *sc, pointer a, pointer b);
@@ -651,62 +656,117 @@ static long binary_decode(const char *s) {
  return x;
 }
 
-/* allocate new cell segment */
-static int alloc_cellseg(scheme *sc, int n) {
+/* allocate a new cell segment of at least min_cells cells.
+ *
+ * Segments are sized in proportion to the heap, so that a growing heap
+ * takes few segments, and there is no limit on their number.
+ */
+static int alloc_cellseg_sized(scheme *sc, long min_cells) {
+     long n_cells;
+
+     n_cells = sc->total_cells / 2;
+     if (n_cells > CELL_SEGSIZE_MAX)
+          n_cells = CELL_SEGSIZE_MAX;
+     if (n_cells < CELL_SEGSIZE)
+          n_cells = CELL_SEGSIZE;
+     if (n_cells < min_cells)
+          n_cells = min_cells;
+
+     return alloc_cellseg_cells(sc, n_cells);
+}
+
+/* allocate a new cell segment of exactly n_cells cells */
+static int alloc_cellseg_cells(scheme *sc, long n_cells) {
      pointer newp;
      pointer last;
      pointer p;
      char *cp;
-     long i;
-     int k;
+     int i;
      int adj=ADJ;
 
      if(adj<sizeof(struct cell)) {
        adj=sizeof(struct cell);
      }
 
+     if (sc->n_cell_segs == sc->max_cell_segs) {
+          int max_segs = sc->max_cell_segs ? sc->max_cell_segs * 2 : 16;
+          struct cell_segment *segs;
+
+          segs = (struct cell_segment*) sc->malloc(max_segs * sizeof(struct cell_segment));
+          if (segs == 0)
+               return 0;
+          if (sc->cell_seg) {
+               memcpy(segs, sc->cell_seg, sc->n_cell_segs * sizeof(struct cell_segment));
+               sc->free(sc->cell_seg);
+          }
+          sc->cell_seg = segs;
+          sc->max_cell_segs = max_segs;
+     }
+
+     cp = (char*) sc->malloc(n_cells * sizeof(struct cell)+adj);
+     if (cp == 0)
+          return 0;
+     i = sc->n_cell_segs++;
+     sc->cell_seg[i].alloc = cp;
+     /* adjust in TYPE_BITS-bit boundary */
+     if(((uintptr_t)cp)%adj!=0) {
+       cp=(char*)(adj*((uintptr_t)cp/adj+1));
+     }
+     /* insert new segment in address order */
+     newp=(pointer)cp;
+     sc->cell_seg[i].cells = newp;
+     sc->cell_seg[i].n_cells = n_cells;
+     while (i > 0 && sc->cell_seg[i - 1].cells > sc->cell_seg[i].cells) {
+          struct cell_segment seg = sc->cell_seg[i];
+          sc->cell_seg[i] = sc->cell_seg[i - 1];
+          sc->cell_seg[--i] = seg;
+     }
+     sc->fcells += n_cells;
+     sc->total_cells += n_cells;
+     last = newp + n_cells - 1;
+     for (p = newp; p <= last; p++) {
+          typeflag(p) = 0;
+          cdr(p) = p + 1;
+          car(p) = sc->NIL;
+     }
+     /* insert new cells in address order on free list */
+     if (sc->free_cell == sc->NIL || p < sc->free_cell) {
+          cdr(last) = sc->free_cell;
+          sc->free_cell = newp;
+     } else {
+          p = sc->free_cell;
+          while (cdr(p) != sc->NIL && newp > cdr(p))
+               p = cdr(p);
+          cdr(last) = cdr(p);
+          cdr(p) = newp;
+     }
+     return 1;
+}
+
+/* allocate n new cell segments */
+static int alloc_cellseg(scheme *sc, int n) {
+     int k;
+
      for (k = 0; k < n; k++) {
-          if (sc->last_cell_seg >= CELL_NSEGMENT - 1)
-               return k;
-          cp = (char*) sc->malloc(CELL_SEGSIZE * sizeof(struct cell)+adj);
-          if (cp == 0)
+          if (!alloc_cellseg_sized(sc, 0))
                return k;
-          i = ++sc->last_cell_seg ;
-          sc->alloc_seg[i] = cp;
-          /* adjust in TYPE_BITS-bit boundary */
-          if(((uintptr_t)cp)%adj!=0) {
-            cp=(char*)(adj*((uintptr_t)cp/adj+1));
-          }
-        /* insert new segment in address order */
-          newp=(pointer)cp;
-        sc->cell_seg[i] = newp;
-        while (i > 0 && sc->cell_seg[i - 1] > sc->cell_seg[i]) {
-              p = sc->cell_seg[i];
-            sc->cell_seg[i] = sc->cell_seg[i - 1];
-            sc->cell_seg[--i] = p;
-        }
-          sc->fcells += CELL_SEGSIZE;
-        last = newp + CELL_SEGSIZE - 1;
-          for (p = newp; p <= last; p++) {
-               typeflag(p) = 0;
-               cdr(p) = p + 1;
-               car(p) = sc->NIL;
-          }
-        /* insert new cells in address order on free list */
-        if (sc->free_cell == sc->NIL || p < sc->free_cell) {
-             cdr(last) = sc->free_cell;
-             sc->free_cell = newp;
-        } else {
-              p = sc->free_cell;
-              while (cdr(p) != sc->NIL && newp > cdr(p))
-                   p = cdr(p);
-              cdr(last) = cdr(p);
-              cdr(p) = newp;
-        }
      }
      return n;
 }
 
+/* After a collection, grow the heap to GC_HEAP_RATIO times the live
+ * cells.  Otherwise a heap nearly full of live cells is collected again
+ * after only a few allocations, and a script building a large list
+ * spends most of its time in gc.  Keeping the heap proportional to the
+ * live size bounds the cost of gc per allocated cell.
+ */
+static void grow_cells(scheme *sc) {
+     while (sc->total_cells - sc->fcells > sc->total_cells / GC_HEAP_RATIO) {
+          if (!alloc_cellseg(sc,1))
+               break;
+     }
+}
+
 static INLINE pointer get_cell_x(scheme *sc, pointer a, pointer b) {
   if (sc->free_cell != sc->NIL) {
     pointer x = sc->free_cell;
@@ -727,16 +787,13 @@ static pointer _get_cell(scheme *sc, pointer a, pointer b) {
   }
 
   if (sc->free_cell == sc->NIL) {
-    const int min_to_be_recovered = sc->last_cell_seg*8;
     gc(sc,a, b);
-    if (sc->fcells < min_to_be_recovered
-        || sc->free_cell == sc->NIL) {
-      /* if only a few recovered, get more to avoid fruitless gc's */
-      if (!alloc_cellseg(sc,1) && sc->free_cell == sc->NIL) {
-        g_warning ("%s", G_STRFUNC);
-        sc->no_memory=1;
-        return sc->sink;
-      }
+    /* if only a few recovered, get more to avoid fruitless gc's */
+    grow_cells(sc);
+    if (sc->free_cell == sc->NIL) {
+      g_warning ("%s", G_STRFUNC);
+      sc->no_memory=1;
+      return sc->sink;
     }
   }
   x = sc->free_cell;
@@ -755,9 +812,10 @@ static pointer reserve_cells(scheme *sc, int n) {
        if (sc->fcells < n) {
                /* If not, try gc'ing some */
                gc(sc, sc->NIL, sc->NIL);
+               grow_cells(sc);
                if (sc->fcells < n) {
                        /* If there still aren't, try getting more heap */
-                       if (!alloc_cellseg(sc,1)) {
+                       if (!alloc_cellseg_sized(sc,n)) {
                                g_warning ("%s", G_STRFUNC);
                                sc->no_memory=1;
                                return sc->NIL;
@@ -784,11 +842,12 @@ static pointer get_consecutive_cells(scheme *sc, int n) {
 
   /* If not, try gc'ing some */
   gc(sc, sc->NIL, sc->NIL);
+  grow_cells(sc);
   x=find_consecutive_cells(sc,n);
   if (x != sc->NIL) { return x; }
 
-  /* If there still aren't, try getting more heap */
-  if (!alloc_cellseg(sc,1))
+  /* If there still aren't, get a segment large enough */
+  if (!alloc_cellseg_sized(sc,n))
     {
       g_warning ("%s", G_STRFUNC);
       sc->no_memory=1;
@@ -835,13 +894,28 @@ static pointer find_consecutive_cells(scheme *sc, int n) {
 /* To retain recent allocs before interpreter knows about them -
    Tehom */
 
+/* They are kept in an array rather than in a list of holder cells,
+   which doubled the number of cells allocated, and so of gc's. */
 static void push_recent_alloc(scheme *sc, pointer recent, pointer extra)
 {
-  pointer holder = get_cell_x(sc, recent, extra);
-  typeflag(holder) = T_PAIR | T_IMMUTABLE;
-  car(holder) = recent;
-  cdr(holder) = car(sc->sink);
-  car(sc->sink) = holder;
+  if (sc->n_recent_allocs == sc->max_recent_allocs) {
+    long     max_allocs = sc->max_recent_allocs ? sc->max_recent_allocs * 2 : 1024;
+    pointer *allocs;
+
+    allocs = (pointer*) sc->malloc(max_allocs * sizeof(pointer));
+    if (allocs == 0) {
+      g_warning ("%s", G_STRFUNC);
+      sc->no_memory=1;
+      return;
+    }
+    if (sc->recent_allocs) {
+      memcpy(allocs, sc->recent_allocs, sc->n_recent_allocs * sizeof(pointer));
+      sc->free(sc->recent_allocs);
+    }
+    sc->recent_allocs = allocs;
+    sc->max_recent_allocs = max_allocs;
+  }
+  sc->recent_allocs[sc->n_recent_allocs++] = recent;
 }
 
 
@@ -873,7 +947,7 @@ static pointer get_vector_object(scheme *sc, int len, pointer init)
 
 static INLINE void ok_to_freely_gc(scheme *sc)
 {
-  car(sc->sink) = sc->NIL;
+  sc->n_recent_allocs = sc->recent_allocs_base;
 }
 
 
@@ -1441,6 +1515,7 @@ E6:   /* up.  Undo the link switching from steps E4 and E5. */
 static void gc(scheme *sc, pointer a, pointer b) {
   pointer p;
   int i;
+  gint64 start_time = g_get_monotonic_time();
 
   if(sc->gc_verbose) {
     putstr(sc, "gc...");
@@ -1462,7 +1537,9 @@ static void gc(scheme *sc, pointer a, pointer b) {
   mark(sc->loadport);
 
   /* Mark recent objects the interpreter doesn't know about yet. */
-  mark(car(sc->sink));
+  for (i = 0; i < sc->n_recent_allocs; i++) {
+    mark(sc->recent_allocs[i]);
+  }
   /* Mark any older stuff above nested C calls */
   mark(sc->c_nest);
 
@@ -1479,9 +1556,9 @@ static void gc(scheme *sc, pointer a, pointer b) {
      (which are also kept sorted by address) downwards to build the
      free-list in sorted order.
   */
-  for (i = sc->last_cell_seg; i >= 0; i--) {
-    p = sc->cell_seg[i] + CELL_SEGSIZE;
-    while (--p >= sc->cell_seg[i]) {
+  for (i = sc->n_cell_segs - 1; i >= 0; i--) {
+    p = sc->cell_seg[i].cells + sc->cell_seg[i].n_cells;
+    while (--p >= sc->cell_seg[i].cells) {
       if (is_mark(p)) {
         clrmark(p);
       } else {
@@ -1498,9 +1575,13 @@ static void gc(scheme *sc, pointer a, pointer b) {
     }
   }
 
+  sc->gc_count++;
+  sc->gc_time += g_get_monotonic_time() - start_time;
+
   if (sc->gc_verbose) {
     char msg[80];
-    snprintf(msg,80,"done: %ld cells were recovered.\n", sc->fcells);
+    snprintf(msg,80,"done: %ld of %ld cells were recovered.\n",
+             sc->fcells, sc->total_cells);
     putstr(sc,msg);
   }
 }
@@ -4368,11 +4449,38 @@ static pointer opexe_4(scheme *sc, enum scheme_opcodes op) {
           s_retbool(was);
      }
 
+     case OP_GCSTATS:    /* gc-stats */
+     {    pointer x = sc->NIL;
+
+          x = cons(sc, cons(sc, mk_symbol(sc, "cell-segments"),
+                            mk_integer(sc, sc->n_cell_segs)), x);
+          x = cons(sc, cons(sc, mk_symbol(sc, "free-cells"),
+                            mk_integer(sc, sc->fcells)), x);
+          x = cons(sc, cons(sc, mk_symbol(sc, "heap-cells"),
+                            mk_integer(sc, sc->total_cells)), x);
+          x = cons(sc, cons(sc, mk_symbol(sc, "run-time"),
+                            mk_integer(sc, g_get_monotonic_time() - sc->start_time)), x);
+          x = cons(sc, cons(sc, mk_symbol(sc, "gc-time"),
+                            mk_integer(sc, sc->gc_time)), x);
+          x = cons(sc, cons(sc, mk_symbol(sc, "collections"),
+                            mk_integer(sc, sc->gc_count)), x);
+          s_return(sc,x);
+     }
+
      case OP_NEWSEGMENT: /* new-segment */
           if (!is_pair(sc->args) || !is_number(car(sc->args))) {
                Error_0(sc,"new-segment: argument must be a number");
           }
-          alloc_cellseg(sc, (int) ivalue(car(sc->args)));
+          {    long i;
+
+               /* segments of the smallest size, unlike those the heap
+                * grows by
+                */
+               for (i = 0; i < ivalue(car(sc->args)); i++) {
+                    if (!alloc_cellseg_cells(sc, CELL_SEGSIZE))
+                         break;
+               }
+          }
           s_return(sc,sc->T);
 
      case OP_OBLIST: /* oblist */
@@ -5190,7 +5298,17 @@ int scheme_init_custom_alloc(scheme *sc, func_alloc malloc, func_dealloc free) {
   sc->gensym_cnt=0;
   sc->malloc=malloc;
   sc->free=free;
-  sc->last_cell_seg = -1;
+  sc->cell_seg = 0;
+  sc->n_cell_segs = 0;
+  sc->max_cell_segs = 0;
+  sc->total_cells = 0;
+  sc->gc_count = 0;
+  sc->gc_time = 0;
+  sc->start_time = g_get_monotonic_time();
+  sc->recent_allocs = 0;
+  sc->n_recent_allocs = 0;
+  sc->max_recent_allocs = 0;
+  sc->recent_allocs_base = 0;
   sc->sink = &sc->_sink;
   sc->NIL = &sc->_NIL;
   sc->T = &sc->_HASHT;
@@ -5321,9 +5439,11 @@ void scheme_deinit(scheme *sc) {
   sc->gc_verbose=0;
   gc(sc,sc->NIL,sc->NIL);
 
-  for(i=0; i<=sc->last_cell_seg; i++) {
-    sc->free(sc->alloc_seg[i]);
+  for(i=0; i<sc->n_cell_segs; i++) {
+    sc->free(sc->cell_seg[i].alloc);
   }
+  sc->free(sc->cell_seg);
+  sc->free(sc->recent_allocs);
 
 #if SHOW_ERROR_LINE
   for(i=0; i<sc->file_i; i++) {
@@ -5428,12 +5548,14 @@ static void save_from_C_call(scheme *sc)
 {
   pointer saved_data =
     cons(sc,
-        car(sc->sink),
+        mk_integer(sc, sc->recent_allocs_base),
         cons(sc,
              sc->envir,
              sc->dump));
   /* Push */
   sc->c_nest = cons(sc, saved_data, sc->c_nest);
+  /* Keep the recent allocs of the caller during the call. */
+  sc->recent_allocs_base = sc->n_recent_allocs;
   /* Truncate the dump stack so TS will return here when done, not
      directly resume pre-C-call operations. */
   dump_stack_reset(sc);
@@ -5441,7 +5563,8 @@ static void save_from_C_call(scheme *sc)
 
 static void restore_from_C_call(scheme *sc)
 {
-  car(sc->sink) = caar(sc->c_nest);
+  sc->n_recent_allocs = sc->recent_allocs_base;
+  sc->recent_allocs_base = ivalue_unchecked(caar(sc->c_nest));
   sc->envir = cadar(sc->c_nest);
   sc->dump = cdr(cdar(sc->c_nest));
   /* Pop */
@@ -102,6 +102,15 @@ typedef short sa_family_t; /* Not defined by winsock */
 #define RESPONSE_HEADER 4
 #define MAGIC           'G'
 
+/*  A request with exactly this text is answered by the server itself  */
+#define STATS_COMMAND   "(script-fu-server-stats)"
+
+/*  Number of recent requests the latency percentiles are computed from  */
+#define LATENCY_SAMPLES 1024
+
+#define WORKERS_ENV     "GIMP_SCRIPT_FU_SERVER_WORKERS"
+#define WORKER_GIMP_ENV "GIMP_SCRIPT_FU_SERVER_GIMP"
+
 #ifndef HAVE_DIFFTIME
 #define difftime(a,b) (((gdouble)(a)) - ((gdouble)(b)))
 #endif
@@ -147,11 +156,59 @@ typedef short sa_family_t; /* Not defined by winsock */
 
 typedef struct
 {
-  gchar *command;
-  gint   filedes;
-  gint   request_no;
+  gchar  *command;
+  gint    filedes;
+  gint    request_no;
+  gint64  queue_time;
 } SFCommand;
 
+typedef struct _SFClient  SFClient;
+typedef struct _SFRequest SFRequest;
+typedef struct _SFWorker  SFWorker;
+
+struct _SFClient
+{
+  gint        filedes;      /*  -1 once the client disconnected       */
+  gchar      *name;
+  GByteArray *input;        /*  received bytes, not yet a full command */
+  GQueue      requests;     /*  outstanding requests, in arrival order */
+  SFWorker   *worker;       /*  interpreter of all its requests, or
+                             *  NULL until its first one starts       */
+};
+
+struct _SFRequest
+{
+  SFClient *client;
+  gint      request_no;
+  gchar    *command;
+  gint64    queue_time;
+  gint64    start_time;
+
+  gboolean  done;
+  gboolean  is_error;
+  GString  *response;
+};
+
+struct _SFWorker
+{
+  gint        port;         /*  0 for the server's own interpreter  */
+  gint        filedes;      /*  -1 while not connected              */
+  gint64      connect_time; /*  time of the next connection attempt */
+  GByteArray *input;        /*  received bytes, not yet a response  */
+  SFRequest  *request;      /*  request being evaluated, or NULL    */
+  gint        n_clients;    /*  connections bound to the worker     */
+};
+
+typedef struct
+{
+  gint     n_received;
+  gint     n_completed;
+  gint     n_errors;
+  gdouble  wait_total;
+  gdouble  run_total;
+  gdouble  latencies[LATENCY_SAMPLES];
+} ServerStats;
+
 typedef struct
 {
   GtkWidget *ip_entry;
@@ -197,6 +254,20 @@ static void      print_socket_api_error (const gchar *api_name);
 
 static void      script_fu_server_listen (gint        timeout);
 
+static gboolean  send_response      (gint         filedes,
+                                     gboolean     is_error,
+                                     GString     *response);
+
+static void      stats_record       (gdouble      wait_time,
+                                     gdouble      run_time,
+                                     gboolean     is_error);
+static GString * stats_get_response (gint         queue_depth,
+                                     gint         in_flight,
+                                     gint         n_workers,
+                                     gint         n_connected);
+
+static void      pool_run           (gint         n_workers);
+
 /*
  *  Local variables
  */
@@ -209,7 +280,19 @@ static gint         queue_length    = 0;
 static gint         request_no      = 0;
 static FILE        *server_log_file = NULL;
 static GHashTable  *clients         = NULL;
-static gboolean     script_fu_done  = FALSE;
+static gint         script_fu_done  = FALSE;
+static ServerStats  stats           = { 0, };
+
+/*  pool mode, see pool_run()  */
+static gboolean     pool_mode       = FALSE;
+static GHashTable  *pool_clients    = NULL;
+static GQueue       pool_queue      = G_QUEUE_INIT;
+static SFWorker    *pool_workers    = NULL;
+static gint         pool_n_workers  = 0;
+static GThread     *pool_thread     = NULL;
+static GAsyncQueue *pool_run_queue  = NULL;
+static GAsyncQueue *pool_done_queue = NULL;
+static SFRequest    pool_stop_request;
 
 static ServerInterface sint =
 {
@@ -238,7 +321,7 @@ script_fu_server_quit (void)
    * We just processed a command, and the loop will now terminate.
    */
   server_log ("quit callback\n");
-  script_fu_done = TRUE;
+  g_atomic_int_set (&script_fu_done, TRUE);
 }
 
 static void
@@ -257,7 +340,12 @@ script_fu_server_post_command (void)
    * script_fu_server_listen (10) in the loop on the queue?
    */
   server_log ("post command callback\n");
-  script_fu_server_listen (10);
+
+  /*  In pool mode, the interpreter runs on its own thread, and the
+   *  main thread keeps servicing the connections anyway.
+   */
+  if (! pool_mode)
+    script_fu_server_listen (10);
 }
 
 GimpValueArray *
@@ -340,7 +428,7 @@ script_fu_server_read_fd (gpointer key,
               from the disconnected client.  */
           for (list = command_queue; list; list = list->next)
             {
-              SFCommand *cmd = (SFCommand *) command_queue->data;
+              SFCommand *cmd = (SFCommand *) list->data;
 
               if (cmd->filedes == fd)
                 cmd->filedes = -1;
@@ -505,6 +593,7 @@ server_start (const gchar *listen_ip,
   gint             sockno;
   gchar           *port_s;
   const gchar     *progress;
+  const gchar     *workers;
 
   memset (&hints, 0, sizeof (hints));
   hints.ai_flags = AI_PASSIVE | AI_ADDRCONFIG;
@@ -555,25 +644,34 @@ server_start (const gchar *listen_ip,
 
   server_log ("initialized and listening...\n");
 
-  /*  Loop until the server is finished  */
-  while (! script_fu_done)
-    {
-      script_fu_server_listen (0);
+  workers = g_getenv (WORKERS_ENV);
 
-      while (command_queue)
+  if (workers)
+    {
+      pool_run (CLAMP (atoi (workers), 0, 64));
+    }
+  else
+    {
+      /*  Loop until the server is finished  */
+      while (! g_atomic_int_get (&script_fu_done))
         {
-          SFCommand *cmd = (SFCommand *) command_queue->data;
+          script_fu_server_listen (0);
 
-          execute_command (cmd);
+          while (command_queue)
+            {
+              SFCommand *cmd = (SFCommand *) command_queue->data;
 
-          /*  Remove the command from the list  */
-          command_queue = g_list_remove (command_queue, cmd);
-          queue_length--;
+              execute_command (cmd);
 
-          /*  Free the request  */
-          g_free (cmd->command);
-          g_free (cmd);
-      }
+              /*  Remove the command from the list  */
+              command_queue = g_list_remove (command_queue, cmd);
+              queue_length--;
+
+              /*  Free the request  */
+              g_free (cmd->command);
+              g_free (cmd);
+            }
+        }
     }
 
   server_progress_uninstall (progress);
@@ -602,7 +700,7 @@ server_start (const gchar *listen_ip,
  * and not for what they write to stdout.
  */
 static gboolean
-get_interpretation_result (SFCommand *cmd, GString **script_stdout)
+get_interpretation_result (const gchar *command, GString **script_stdout)
 {
   gboolean is_script_error = FALSE;
 
@@ -611,7 +709,7 @@ get_interpretation_result (SFCommand *cmd, GString **script_stdout)
   script_fu_redirect_output_to_gstr (*script_stdout);
 
   /* Returns non-zero on error. */
-  if (script_fu_interpret_string (cmd->command) != 0)
+  if (script_fu_interpret_string (command) != 0)
     {
       /* Substitute error message for output in script_stdout.
        * What the script wrote to stdout before error is lost.
@@ -636,18 +734,26 @@ get_interpretation_result (SFCommand *cmd, GString **script_stdout)
 static void
 execute_command (SFCommand *cmd)
 {
-  guchar      buffer[RESPONSE_HEADER];
   GString    *response = NULL;
   time_t      clocknow;
   gdouble     total_time;
   GTimer     *timer;
   gboolean    is_script_error;
 
+  if (! strcmp (cmd->command, STATS_COMMAND))
+    {
+      response = stats_get_response (queue_length - 1, 0, 1, 1);
+
+      send_response (cmd->filedes, FALSE, response);
+      g_string_free (response, TRUE);
+      return;
+    }
+
   server_log ("Processing request #%d\n", cmd->request_no);
 
   timer = g_timer_new ();
 
-  is_script_error = get_interpretation_result (cmd, &response);
+  is_script_error = get_interpretation_result (cmd->command, &response);
   /* Require interpretation set response to a valid GString. */
   if (response == NULL)
     return;
@@ -661,34 +767,52 @@ execute_command (SFCommand *cmd)
 
   g_timer_destroy (timer);
 
+  stats_record ((gdouble) (g_get_monotonic_time () - cmd->queue_time) /
+                G_TIME_SPAN_SECOND - total_time,
+                total_time, is_script_error);
+
+  send_response (cmd->filedes, is_script_error, response);
+
+  g_string_free (response, TRUE);
+}
+
+/* Relay a response to the client.
+ * Returns FALSE on IO errors, which are logged but otherwise ignored.
+ */
+static gboolean
+send_response (gint      filedes,
+               gboolean  is_error,
+               GString  *response)
+{
+  guchar buffer[RESPONSE_HEADER];
+
+  if (filedes <= 0)
+    return FALSE;
+
   buffer[MAGIC_BYTE]     = MAGIC;
-  buffer[ERROR_BYTE]     = is_script_error ? TRUE : FALSE;
+  buffer[ERROR_BYTE]     = is_error ? TRUE : FALSE;
   buffer[RSP_LEN_H_BYTE] = (guchar) (response->len >> 8);
   buffer[RSP_LEN_L_BYTE] = (guchar) (response->len & 0xFF);
 
   /*  Write a header to the client, as one message. */
-  if (cmd->filedes > 0 &&
-      send (cmd->filedes, (const void *) (buffer), RESPONSE_HEADER, 0) < 0)
+  if (send (filedes, (const void *) (buffer), RESPONSE_HEADER, 0) < 0)
     {
       /*  Write error  */
       g_debug ("%s error sending header", G_STRFUNC);
       print_socket_api_error ("send");
-      g_string_free (response, TRUE);
-      return;
+      return FALSE;
     }
 
   /*  Write the script response to the client, as one message. */
-  if (cmd->filedes > 0 &&
-      send (cmd->filedes, response->str, response->len, 0) < 0)
+  if (send (filedes, response->str, response->len, 0) < 0)
     {
       /*  Write error.  A client may have closed before taking all bytes.  */
       g_debug ("%s error sending response", G_STRFUNC);
       print_socket_api_error ("send");
-      g_string_free (response, TRUE);
-      return;
+      return FALSE;
     }
 
-  g_string_free (response, TRUE);
+  return TRUE;
 }
 
 static gint
@@ -757,6 +881,9 @@ read_from_client (gint filedes)
   cmd->filedes    = filedes;
   cmd->command    = command;
   cmd->request_no = request_no ++;
+  cmd->queue_time = g_get_monotonic_time ();
+
+  stats.n_received++;
 
   /*  Add the command to the queue  */
   command_queue = g_list_append (command_queue, cmd);
@@ -777,6 +904,830 @@ read_from_client (gint filedes)
   return 0;
 }
 
+/*
+ * Statistics, answered to STATS_COMMAND in either mode.
+ *
+ * The response is a Scheme association list, e.g.
+ * ((queue-depth . 2) (in-flight . 4) ... (latency-p90 . 1.250))
+ * where wait and latency are in seconds; latency is the time from
+ * receiving a request to having its result.
+ */
+
+static void
+stats_record (gdouble  wait_time,
+              gdouble  run_time,
+              gboolean is_error)
+{
+  stats.latencies[stats.n_completed % LATENCY_SAMPLES] = wait_time + run_time;
+
+  stats.n_completed++;
+  stats.wait_total += wait_time;
+  stats.run_total  += run_time;
+
+  if (is_error)
+    stats.n_errors++;
+}
+
+static gint
+stats_compare_latency (gconstpointer a,
+                       gconstpointer b)
+{
+  gdouble latency_a = *(const gdouble *) a;
+  gdouble latency_b = *(const gdouble *) b;
+
+  return (latency_a > latency_b) - (latency_a < latency_b);
+}
+
+static GString *
+stats_get_response (gint queue_depth,
+                    gint in_flight,
+                    gint n_workers,
+                    gint n_connected)
+{
+  GString *response = g_string_new (NULL);
+  gdouble  latencies[LATENCY_SAMPLES];
+  gint     n_latencies = MIN (stats.n_completed, LATENCY_SAMPLES);
+  gdouble  p50         = 0.0;
+  gdouble  p90         = 0.0;
+  gdouble  p99         = 0.0;
+  gdouble  max         = 0.0;
+
+  if (n_latencies > 0)
+    {
+      memcpy (latencies, stats.latencies, n_latencies * sizeof (gdouble));
+
+      qsort (latencies, n_latencies, sizeof (gdouble), stats_compare_latency);
+
+      p50 = latencies[(n_latencies - 1) * 50 / 100];
+      p90 = latencies[(n_latencies - 1) * 90 / 100];
+      p99 = latencies[(n_latencies - 1) * 99 / 100];
+      max = latencies[n_latencies - 1];
+    }
+
+  g_string_printf (response,
+                   "((queue-depth . %d) (in-flight . %d) "
+                   "(workers . %d) (workers-connected . %d) "
+                   "(received . %d) (completed . %d) (errors . %d) "
+                   "(wait-mean . %.3f) (run-mean . %.3f) "
+                   "(latency-p50 . %.3f) (latency-p90 . %.3f) "
+                   "(latency-p99 . %.3f) (latency-max . %.3f))",
+                   queue_depth, in_flight,
+                   n_workers, n_connected,
+                   stats.n_received, stats.n_completed, stats.n_errors,
+                   stats.n_completed ?
+                   stats.wait_total / stats.n_completed : 0.0,
+                   stats.n_completed ?
+                   stats.run_total  / stats.n_completed : 0.0,
+                   p50, p90, p99, max);
+
+  return response;
+}
+
+
+/*
+ * Pool mode.
+ *
+ * Enabled by setting GIMP_SCRIPT_FU_SERVER_WORKERS to the number N of
+ * additional interpreters.  Requests are read from every connection as
+ * they arrive, so a client may send several requests without waiting
+ * for the responses (pipelining), and go into one queue.  Connections
+ * are served concurrently by:
+ *
+ *  - the server's own interpreter, on a separate thread, so that the
+ *    connections keep being serviced while it evaluates;
+ *  - N worker servers, each a headless GIMP running this plug-in in
+ *    the normal mode on port+1 ... port+N, which are spawned by the
+ *    server (see GIMP_SCRIPT_FU_SERVER_GIMP) and fed over the same
+ *    protocol.  Interpreters can't share a process: both TinyScheme
+ *    and the PDB connection are process-wide.
+ *
+ * A connection is bound to one interpreter when its first request
+ * starts, and all of its requests are evaluated there, one at a time,
+ * in the order they were sent: a request may use what the earlier ones
+ * defined or opened.  Only separate connections run concurrently, and
+ * a slow script thus only holds up its own connection.  Note that the
+ * workers are separate GIMP instances; they don't see the images of
+ * the server's GIMP, or of each other.  If a worker is lost, its
+ * connections move to another interpreter, without their state.
+ */
+
+static gint64
+pool_now (void)
+{
+  return g_get_monotonic_time ();
+}
+
+static void
+pool_request_free (SFRequest *request)
+{
+  g_free (request->command);
+
+  if (request->response)
+    g_string_free (request->response, TRUE);
+
+  g_slice_free (SFRequest, request);
+}
+
+static void
+pool_client_free (SFClient *client)
+{
+  g_byte_array_free (client->input, TRUE);
+  g_free (client->name);
+
+  g_slice_free (SFClient, client);
+}
+
+/* Send the responses of a client's finished requests, in order. */
+static void
+pool_client_flush (SFClient *client)
+{
+  SFRequest *request;
+
+  while ((request = g_queue_peek_head (&client->requests)) &&
+         request->done)
+    {
+      g_queue_pop_head (&client->requests);
+
+      if (client->filedes >= 0 && request->response)
+        send_response (client->filedes, request->is_error, request->response);
+
+      pool_request_free (request);
+    }
+
+  if (client->filedes < 0 && g_queue_is_empty (&client->requests))
+    pool_client_free (client);
+}
+
+static void
+pool_request_finish (SFRequest *request)
+{
+  gint64 now = pool_now ();
+
+  request->done = TRUE;
+
+  if (request->start_time)
+    {
+      gdouble wait_time;
+      gdouble run_time;
+
+      wait_time = (gdouble) (request->start_time - request->queue_time) /
+                  G_TIME_SPAN_SECOND;
+      run_time  = (gdouble) (now - request->start_time) /
+                  G_TIME_SPAN_SECOND;
+
+      stats_record (wait_time, run_time, request->is_error);
+
+      server_log ("%s\n", request->response->str);
+      server_log ("Request #%d processed in %.3f seconds "
+                  "(%.3f seconds in queue)\n",
+                  request->request_no, run_time, wait_time);
+    }
+
+  pool_client_flush (request->client);
+}
+
+static void
+pool_client_close (SFClient *client)
+{
+  GList *list;
+
+  server_log ("disconnect from host %s.\n", client->name);
+
+  g_hash_table_remove (pool_clients, GINT_TO_POINTER (client->filedes));
+
+  CLOSESOCKET (client->filedes);
+  client->filedes = -1;
+
+  if (client->worker)
+    {
+      client->worker->n_clients--;
+      client->worker = NULL;
+    }
+
+  /*  Drop the client's requests that didn't start yet; the ones being
+   *  evaluated finish, and the client is freed after the last one.
+   */
+  for (list = client->requests.head; list; list = g_list_next (list))
+    {
+      SFRequest *request = list->data;
+
+      if (! request->start_time && ! request->done)
+        {
+          g_queue_remove (&pool_queue, request);
+
+          request->done = TRUE;
+        }
+    }
+
+  pool_client_flush (client);
+}
+
+static void
+pool_request_new (SFClient *client,
+                  gchar    *command)
+{
+  SFRequest *request = g_slice_new0 (SFRequest);
+  time_t     clock;
+
+  request->client     = client;
+  request->request_no = request_no++;
+  request->command    = command;
+  request->queue_time = pool_now ();
+
+  g_queue_push_tail (&client->requests, request);
+
+  stats.n_received++;
+
+  if (! strcmp (command, STATS_COMMAND))
+    {
+      gint in_flight = 0;
+      gint connected = 0;
+      gint i;
+
+      for (i = 0; i < pool_n_workers; i++)
+        {
+          if (pool_workers[i].request)
+            in_flight++;
+
+          if (i == 0 || pool_workers[i].filedes >= 0)
+            connected++;
+        }
+
+      request->response = stats_get_response (pool_queue.length, in_flight,
+                                              pool_n_workers, connected);
+
+      pool_request_finish (request);
+      return;
+    }
+
+  g_queue_push_tail (&pool_queue, request);
+
+  time (&clock);
+  /* ! ctime has trailing newline so put it last. */
+  server_log ("received request #%d from IP address %s: %s,"
+              "[queue length: %d] on %s",
+              request->request_no, client->name, command,
+              pool_queue.length, ctime (&clock));
+}
+
+/* Read what is available from a client, and queue all the complete
+ * requests in it.  Returns FALSE when the connection is done.
+ */
+static gboolean
+pool_client_read (SFClient *client)
+{
+  guchar buffer[4096];
+  gint   nbytes;
+
+  nbytes = recv (client->filedes, (void *) buffer, sizeof (buffer), 0);
+
+  if (nbytes < 0)
+    {
+#ifndef G_OS_WIN32
+      if (errno == EINTR)
+        return TRUE;
+#endif
+      server_log ("Error reading command.\n");
+      return FALSE;
+    }
+
+  if (nbytes == 0)
+    return FALSE;  /* EOF */
+
+  g_byte_array_append (client->input, buffer, nbytes);
+
+  while (client->input->len >= COMMAND_HEADER)
+    {
+      const guchar *data = client->input->data;
+      gint          command_len;
+
+      if (data[MAGIC_BYTE] != MAGIC)
+        {
+          server_log ("Error in script-fu command transmission.\n");
+          return FALSE;
+        }
+
+      command_len = (data[CMD_LEN_H_BYTE] << 8) | data[CMD_LEN_L_BYTE];
+
+      if (client->input->len < COMMAND_HEADER + command_len)
+        break;
+
+      pool_request_new (client,
+                        g_strndup ((const gchar *) data + COMMAND_HEADER,
+                                   command_len));
+
+      g_byte_array_remove_range (client->input,
+                                 0, COMMAND_HEADER + command_len);
+    }
+
+  return TRUE;
+}
+
+static void
+pool_worker_lost (SFWorker *worker)
+{
+  GHashTableIter  iter;
+  SFClient       *client;
+
+  server_log ("lost worker on port %d.\n", worker->port);
+
+  CLOSESOCKET (worker->filedes);
+  worker->filedes      = -1;
+  worker->connect_time = pool_now () + G_TIME_SPAN_SECOND;
+
+  g_byte_array_set_size (worker->input, 0);
+
+  /*  the worker's connections continue on other interpreters  */
+  g_hash_table_iter_init (&iter, pool_clients);
+
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &client))
+    {
+      if (client->worker == worker)
+        client->worker = NULL;
+    }
+
+  worker->n_clients = 0;
+
+  if (worker->request)
+    {
+      SFRequest *request = worker->request;
+
+      worker->request = NULL;
+
+      request->is_error = TRUE;
+      request->response = g_string_new ("Worker lost while evaluating "
+                                        "the request");
+
+      pool_request_finish (request);
+    }
+}
+
+static void
+pool_worker_read (SFWorker *worker)
+{
+  guchar buffer[4096];
+  gint   nbytes;
+
+  nbytes = recv (worker->filedes, (void *) buffer, sizeof (buffer), 0);
+
+  if (nbytes <= 0)
+    {
+#ifndef G_OS_WIN32
+      if (nbytes < 0 && errno == EINTR)
+        return;
+#endif
+      pool_worker_lost (worker);
+      return;
+    }
+
+  g_byte_array_append (worker->input, buffer, nbytes);
+
+  if (worker->input->len >= RESPONSE_HEADER)
+    {
+      const guchar *data = worker->input->data;
+      SFRequest    *request;
+      gint          response_len;
+
+      if (data[MAGIC_BYTE] != MAGIC || ! worker->request)
+        {
+          pool_worker_lost (worker);
+          return;
+        }
+
+      response_len = (data[RSP_LEN_H_BYTE] << 8) | data[RSP_LEN_L_BYTE];
+
+      if (worker->input->len < RESPONSE_HEADER + response_len)
+        return;
+
+      request = worker->request;
+      worker->request = NULL;
+
+      request->is_error = data[ERROR_BYTE] ? TRUE : FALSE;
+      request->response = g_string_new_len ((const gchar *) data +
+                                            RESPONSE_HEADER,
+                                            response_len);
+
+      g_byte_array_remove_range (worker->input,
+                                 0, RESPONSE_HEADER + response_len);
+
+      pool_request_finish (request);
+    }
+}
+
+static gboolean
+pool_worker_send (SFWorker  *worker,
+                  SFRequest *request)
+{
+  guchar buffer[COMMAND_HEADER];
+  gsize  command_len = strlen (request->command);
+
+  buffer[MAGIC_BYTE]     = MAGIC;
+  buffer[CMD_LEN_H_BYTE] = (guchar) (command_len >> 8);
+  buffer[CMD_LEN_L_BYTE] = (guchar) (command_len & 0xFF);
+
+  return (send (worker->filedes, (const void *) buffer,
+                COMMAND_HEADER, 0) >= 0 &&
+          send (worker->filedes, request->command,
+                command_len, 0) >= 0);
+}
+
+static void
+pool_worker_connect (SFWorker *worker)
+{
+  struct sockaddr_in addr;
+  gint               sock;
+
+  memset (&addr, 0, sizeof (addr));
+  addr.sin_family      = AF_INET;
+  addr.sin_port        = g_htons (worker->port);
+  addr.sin_addr.s_addr = g_htonl (INADDR_LOOPBACK);
+
+  sock = socket (AF_INET, SOCK_STREAM, 0);
+
+  if (sock >= 0 &&
+      connect (sock, (struct sockaddr *) &addr, sizeof (addr)) == 0)
+    {
+      server_log ("connected to worker on port %d.\n", worker->port);
+
+      worker->filedes = sock;
+      return;
+    }
+
+  /*  the worker may still be starting up  */
+  if (sock >= 0)
+    CLOSESOCKET (sock);
+
+  worker->connect_time = pool_now () + G_TIME_SPAN_SECOND / 2;
+}
+
+static void
+pool_worker_spawn (SFWorker *worker)
+{
+  const gchar  *gimp = g_getenv (WORKER_GIMP_ENV);
+  gchar        *batch;
+  gchar       **envp;
+  gchar        *argv[6];
+  GError       *error = NULL;
+
+  if (! gimp)
+    gimp = "gimp-console-" GIMP_APP_VERSION;
+
+  batch = g_strdup_printf ("(plug-in-script-fu-server RUN-NONINTERACTIVE "
+                           "\"127.0.0.1\" %d \"\")", worker->port);
+
+  argv[0] = (gchar *) gimp;
+  argv[1] = "--no-interface";
+  argv[2] = "--quit";
+  argv[3] = "--batch";
+  argv[4] = batch;
+  argv[5] = NULL;
+
+  /*  the worker serves in the normal mode  */
+  envp = g_environ_unsetenv (g_get_environ (), WORKERS_ENV);
+
+  if (! g_spawn_async (NULL, argv, envp, G_SPAWN_SEARCH_PATH,
+                       NULL, NULL, NULL, &error))
+    {
+      server_log ("could not start worker on port %d: %s\n",
+                  worker->port, error->message);
+      g_clear_error (&error);
+    }
+
+  g_strfreev (envp);
+  g_free (batch);
+}
+
+static gpointer
+pool_interpreter_thread (gpointer data)
+{
+  SFRequest *request;
+
+  while ((request = g_async_queue_pop (pool_run_queue)) != &pool_stop_request)
+    {
+      request->is_error = get_interpretation_result (request->command,
+                                                     &request->response);
+
+      g_async_queue_push (pool_done_queue, request);
+    }
+
+  return NULL;
+}
+
+/* The free interpreter with the fewest connections, or NULL. */
+static SFWorker *
+pool_worker_pick (void)
+{
+  SFWorker *best = NULL;
+  gint      i;
+
+  for (i = 0; i < pool_n_workers; i++)
+    {
+      SFWorker *worker = &pool_workers[i];
+
+      if (worker->request || (worker->port && worker->filedes < 0))
+        continue;
+
+      if (! best || worker->n_clients < best->n_clients)
+        best = worker;
+    }
+
+  return best;
+}
+
+/* Start the queued requests whose interpreter is free.  The first
+ * queued request of a connection goes to the connection's interpreter,
+ * so its later requests can't overtake it: they wait for the same
+ * interpreter.
+ */
+static void
+pool_dispatch (void)
+{
+  GList *list = pool_queue.head;
+
+  while (list)
+    {
+      SFRequest *request = list->data;
+      SFClient  *client  = request->client;
+      SFWorker  *worker  = client->worker;
+      GList     *next    = g_list_next (list);
+
+      if (! worker)
+        {
+          worker = pool_worker_pick ();
+
+          if (worker)
+            {
+              client->worker = worker;
+              worker->n_clients++;
+            }
+        }
+
+      if (! worker ||
+          worker->request || (worker->port && worker->filedes < 0))
+        {
+          list = next;
+          continue;
+        }
+
+      g_queue_delete_link (&pool_queue, list);
+
+      request->start_time = pool_now ();
+      worker->request     = request;
+
+      server_log ("Processing request #%d on %s %d\n",
+                  request->request_no,
+                  worker->port ? "worker on port" : "server, queue length",
+                  worker->port ? worker->port : (gint) pool_queue.length);
+
+      if (! worker->port)
+        {
+          g_async_queue_push (pool_run_queue, request);
+        }
+      else if (! pool_worker_send (worker, request))
+        {
+          pool_worker_lost (worker);
+        }
+
+      list = next;
+    }
+}
+
+static void
+pool_listen (gint timeout)
+{
+  struct timeval  tv;
+  struct timeval *tvp = NULL;
+  SELECT_MASK     fds;
+  GList          *list;
+  GList          *iter;
+  gint            sockno;
+  gint            i;
+
+  if (timeout >= 0)
+    {
+      tv.tv_sec  = timeout / 1000;
+      tv.tv_usec = (timeout % 1000) * 1000;
+      tvp = &tv;
+    }
+
+  FD_ZERO (&fds);
+
+  for (sockno = 0; sockno < server_socks_used; sockno++)
+    FD_SET (server_socks[sockno], &fds);
+
+  for (i = 1; i < pool_n_workers; i++)
+    {
+      if (pool_workers[i].filedes >= 0)
+        FD_SET (pool_workers[i].filedes, &fds);
+    }
+
+  list = g_hash_table_get_values (pool_clients);
+
+  for (iter = list; iter; iter = g_list_next (iter))
+    FD_SET (((SFClient *) iter->data)->filedes, &fds);
+
+  if (select (FD_SETSIZE, &fds, NULL, NULL, tvp) < 0)
+    {
+#ifndef G_OS_WIN32
+      if (errno != EINTR)
+#endif
+        print_socket_api_error ("select");
+
+      g_list_free (list);
+      return;
+    }
+
+  for (sockno = 0; sockno < server_socks_used; sockno++)
+    {
+      sa_union   client;
+      socklen_t  size = sizeof (client);
+      gchar      clientname[NI_MAXHOST];
+      SFClient  *sf_client;
+      gint       new;
+
+      if (! FD_ISSET (server_socks[sockno], &fds))
+        continue;
+
+      new = accept (server_socks[sockno], &(client.sa), &size);
+
+      if (new < 0)
+        {
+          print_socket_api_error ("accept");
+          continue;
+        }
+
+      g_strlcpy (clientname, "(error during host address lookup)", NI_MAXHOST);
+
+      (void) getnameinfo (&(client.sa), size, clientname, sizeof (clientname),
+                          NULL, 0, NI_NUMERICHOST);
+
+      sf_client = g_slice_new0 (SFClient);
+
+      sf_client->filedes = new;
+      sf_client->name    = g_strdup (clientname);
+      sf_client->input   = g_byte_array_new ();
+
+      g_hash_table_insert (pool_clients, GINT_TO_POINTER (new), sf_client);
+
+      server_log ("connect from host %s.\n", clientname);
+    }
+
+  for (i = 1; i < pool_n_workers; i++)
+    {
+      if (pool_workers[i].filedes >= 0 &&
+          FD_ISSET (pool_workers[i].filedes, &fds))
+        {
+          pool_worker_read (&pool_workers[i]);
+        }
+    }
+
+  for (iter = list; iter; iter = g_list_next (iter))
+    {
+      SFClient *client = iter->data;
+
+      if (FD_ISSET (client->filedes, &fds) &&
+          ! pool_client_read (client))
+        {
+          pool_client_close (client);
+        }
+    }
+
+  g_list_free (list);
+}
+
+static void
+pool_run (gint n_workers)
+{
+  SFRequest *request;
+  GList     *list;
+  GList     *iter;
+  gint       port;
+  gint       i;
+
+  pool_mode      = TRUE;
+  pool_n_workers = n_workers + 1;
+  pool_workers   = g_new0 (SFWorker, pool_n_workers);
+  pool_clients   = g_hash_table_new (g_direct_hash, NULL);
+
+  port = sint.port;
+
+  if (server_socks_used > 0)
+    {
+      sa_union  addr;
+      socklen_t size = sizeof (addr);
+
+      if (getsockname (server_socks[0], &(addr.sa), &size) == 0)
+        {
+          if (addr.family == AF_INET)
+            port = g_ntohs (addr.sa_in.sin_port);
+          else if (addr.family == AF_INET6)
+            port = g_ntohs (addr.sa_in6.sin6_port);
+        }
+    }
+
+  for (i = 0; i < pool_n_workers; i++)
+    {
+      pool_workers[i].port    = i ? port + i : 0;
+      pool_workers[i].filedes = -1;
+      pool_workers[i].input   = g_byte_array_new ();
+
+      if (i)
+        pool_worker_spawn (&pool_workers[i]);
+    }
+
+  pool_run_queue  = g_async_queue_new ();
+  pool_done_queue = g_async_queue_new ();
+
+  pool_thread = g_thread_new ("script-fu-server", pool_interpreter_thread,
+                              NULL);
+
+  server_log ("pool mode, %d worker(s) on ports %d-%d\n",
+              n_workers, port + 1, port + n_workers);
+
+  while (! g_atomic_int_get (&script_fu_done))
+    {
+      gint64 now     = pool_now ();
+      gint   timeout = -1;
+
+      for (i = 1; i < pool_n_workers; i++)
+        {
+          if (pool_workers[i].filedes < 0)
+            {
+              if (now >= pool_workers[i].connect_time)
+                pool_worker_connect (&pool_workers[i]);
+
+              if (pool_workers[i].filedes < 0)
+                timeout = 100;
+            }
+        }
+
+      /*  poll for our own interpreter's result  */
+      if (pool_workers[0].request)
+        timeout = 10;
+
+      pool_listen (timeout);
+
+      while ((request = g_async_queue_try_pop (pool_done_queue)))
+        {
+          pool_workers[0].request = NULL;
+
+          pool_request_finish (request);
+        }
+
+      pool_dispatch ();
+    }
+
+  /*  stop our interpreter, and the workers  */
+  g_async_queue_push (pool_run_queue, &pool_stop_request);
+  g_thread_join (pool_thread);
+  pool_thread = NULL;
+
+  while ((request = g_async_queue_try_pop (pool_done_queue)))
+    pool_request_finish (request);
+
+  for (i = 1; i < pool_n_workers; i++)
+    {
+      SFWorker *worker = &pool_workers[i];
+
+      if (worker->filedes >= 0)
+        {
+          SFRequest quit = { 0, };
+
+          quit.command = (gchar *) "(gimp-quit 0)";
+
+          pool_worker_send (worker, &quit);
+
+          worker->request = NULL;
+          CLOSESOCKET (worker->filedes);
+        }
+
+      g_byte_array_free (worker->input, TRUE);
+    }
+
+  g_clear_pointer (&pool_workers, g_free);
+  pool_n_workers = 0;
+
+  list = g_hash_table_get_values (pool_clients);
+
+  for (iter = list; iter; iter = g_list_next (iter))
+    {
+      SFClient *client = iter->data;
+
+      shutdown (client->filedes, 2);
+      pool_client_close (client);
+    }
+
+  g_list_free (list);
+
+  /*  requests still held by closed clients are abandoned  */
+  g_queue_clear (&pool_queue);
+  g_clear_pointer (&pool_clients, g_hash_table_destroy);
+  g_clear_pointer (&pool_run_queue, g_async_queue_unref);
+  g_clear_pointer (&pool_done_queue, g_async_queue_unref);
+
+  pool_mode = FALSE;
+}
+
 static gint
 make_socket (const struct addrinfo *ai)
 {
@@ -888,9 +1839,10 @@ server_quit (void)
 
       g_free (cmd->command);
       g_free (cmd);
+
+      command_queue = g_list_delete_link (command_queue, command_queue);
     }
 
-  g_list_free (command_queue);
   command_queue = NULL;
   queue_length  = 0;
 
@@ -5,84 +5,170 @@
 # A simple client app to the ScriptFu server.
 # Usually for testing.
 # CLI, a REPL: submits each entered line to the server, then prints response.
+#
+# Non-interactive checks, mostly for the server's pool mode
+# (GIMP_SCRIPT_FU_SERVER_WORKERS):
+#
+#   --pipeline N   send N requests at once, check the responses come in order
+#   --stats        print the server's statistics
+#   --concurrent   check a fast request on another connection isn't held
+#                  up by a slow one
 
-import readline, socket, sys
-
-if len(sys.argv) < 1 or len(sys.argv) > 3:
-   print >>sys.stderr, "Usage: %s <host> <port>" % sys.argv[0]
-   print >>sys.stderr, "       (if omitted connect to localhost, port 10008)"
-   sys.exit(1)
+import readline, socket, sys, threading, time
 
 HOST = "localhost"
 PORT = 10008
 
-try:
-    HOST = sys.argv[1]
-    try:
-        PORT = int(sys.argv[2])
-    except IndexError:
-        pass
-except IndexError:
-    pass
-
-addresses = socket.getaddrinfo(HOST, PORT, socket.AF_UNSPEC, socket.SOCK_STREAM)
-
-connected = False
-
-for addr in addresses:
-    (family, socktype, proto, canonname, sockaddr) = addr
-
-    numeric_addr = sockaddr[0]
-
-    if canonname:
-        print ("Trying %s ('%s')." % (numeric_addr, canonname))
-    else:
-        print ("Trying %s." % numeric_addr)
-
-    try:
-        sock = socket.socket(family, socket.SOCK_STREAM)
-        sock.connect((HOST, PORT))
-        connected = True
-        break
-    except:
-        pass
-
-if not connected:
-    print ("Failed.")
-    sys.exit(1)
-
-try:
-   cmd = input("Script-Fu-Remote - Testclient\n> ")
-
-   while len(cmd) > 0:
-      my_bytes = bytearray()
-      my_bytes.append(71) # G=71
-      my_bytes.append((len(cmd)) >> 8)
-      my_bytes.append((len(cmd)) % 0xFF)
-      my_bytes.extend(bytearray(cmd,"UTF-8"))
-      sock.send(my_bytes)
-
-      data = bytearray()
-      while len(data) < 4:
-         data.extend(sock.recv(4 - len(data)))
-
-      if len(data) >= 4:
-         if data[0] == 71: # MAGIC_BYTE 'G'=71
-            l = (data[2] << 8) + data[3]
-            msg = ""
-            while len(msg) < l:
-               msg += (sock.recv(l - len(msg))).decode("utf-8")
-            if data[1]: # ERROR_BYTE
-               print ("(ERR):", msg)
-            else:
-               print (" (OK):", msg)
-            cmd = input("> ")
+def usage():
+   print ("Usage: %s [--pipeline N | --stats | --concurrent] [<host> [<port>]]"
+          % sys.argv[0], file=sys.stderr)
+   print ("       (if omitted connect to localhost, port 10008)", file=sys.stderr)
+   sys.exit(1)
+
+def connect(verbose=True):
+   addresses = socket.getaddrinfo(HOST, PORT, socket.AF_UNSPEC, socket.SOCK_STREAM)
+
+   for addr in addresses:
+      (family, socktype, proto, canonname, sockaddr) = addr
+
+      numeric_addr = sockaddr[0]
+
+      if verbose:
+         if canonname:
+            print ("Trying %s ('%s')." % (numeric_addr, canonname))
          else:
-            print ("invalid magic: %s\n" % data)
-      else:
-         print ("short response: %s\n" % data)
+            print ("Trying %s." % numeric_addr)
 
-except EOFError:
-   print
+      try:
+         sock = socket.socket(family, socket.SOCK_STREAM)
+         sock.connect((HOST, PORT))
+         return sock
+      except:
+         pass
 
-sock.close()
\ No newline at end of file
+   print ("Failed.")
+   sys.exit(1)
+
+def recv_exactly(sock, n):
+   data = bytearray()
+   while len(data) < n:
+      chunk = sock.recv(n - len(data))
+      if not chunk:
+         raise EOFError
+      data.extend(chunk)
+   return data
+
+def send_command(sock, cmd):
+   cmd_bytes = cmd.encode("UTF-8")
+   my_bytes = bytearray()
+   my_bytes.append(71) # G=71
+   my_bytes.append(len(cmd_bytes) >> 8)
+   my_bytes.append(len(cmd_bytes) & 0xFF)
+   my_bytes.extend(cmd_bytes)
+   sock.sendall(my_bytes)
+
+def read_response(sock):
+   data = recv_exactly(sock, 4)
+   if data[0] != 71: # MAGIC_BYTE 'G'=71
+      raise ValueError("invalid magic: %s" % data)
+   l = (data[2] << 8) + data[3]
+   msg = recv_exactly(sock, l).decode("utf-8")
+   return (bool(data[1]), msg) # ERROR_BYTE
+
+def run_repl(sock):
+   try:
+      cmd = input("Script-Fu-Remote - Testclient\n> ")
+
+      while len(cmd) > 0:
+         send_command(sock, cmd)
+         is_error, msg = read_response(sock)
+         if is_error:
+            print ("(ERR):", msg)
+         else:
+            print (" (OK):", msg)
+         cmd = input("> ")
+
+   except EOFError:
+      print ()
+
+def run_pipeline(sock, n):
+   start = time.time()
+   for i in range(n):
+      send_command(sock, "(display %d)" % i)
+   for i in range(n):
+      is_error, msg = read_response(sock)
+      if is_error or msg != str(i):
+         print ("request %d: unexpected response: %s" % (i, msg))
+         return 1
+   print ("%d pipelined requests in %.3f seconds" % (n, time.time() - start))
+   return 0
+
+def run_stats(sock):
+   send_command(sock, "(script-fu-server-stats)")
+   is_error, msg = read_response(sock)
+   print (msg)
+   return 1 if is_error else 0
+
+def run_concurrent():
+   slow = connect(False)
+   fast = connect(False)
+   done = []
+
+   def wait(sock, name):
+      read_response(sock)
+      done.append(name)
+
+   # a busy loop, so as not to depend on any PDB procedure
+   send_command(slow, "(let loop ((i 0)) (if (< i 2000000) (loop (+ i 1))))")
+   time.sleep(0.1)
+   send_command(fast, "(display \"fast\")")
+
+   threads = [threading.Thread(target=wait, args=(slow, "slow")),
+              threading.Thread(target=wait, args=(fast, "fast"))]
+   for t in threads:
+      t.start()
+   for t in threads:
+      t.join()
+
+   slow.close()
+   fast.close()
+
+   print ("completion order: %s" % ", ".join(done))
+   return 0 if done[0] == "fast" else 1
+
+mode = None
+args = sys.argv[1:]
+
+if args and args[0] == "--pipeline":
+   if len(args) < 2:
+      usage()
+   mode = "pipeline"
+   count = int(args[1])
+   args = args[2:]
+elif args and args[0] in ("--stats", "--concurrent"):
+   mode = args[0][2:]
+   args = args[1:]
+
+if len(args) > 2:
+   usage()
+
+if len(args) > 0:
+   HOST = args[0]
+if len(args) > 1:
+   PORT = int(args[1])
+
+if mode == "concurrent":
+   sys.exit(run_concurrent())
+
+sock = connect(mode is None)
+
+if mode == "pipeline":
+   status = run_pipeline(sock, count)
+elif mode == "stats":
+   status = run_stats(sock)
+else:
+   run_repl(sock)
+   status = 0
+
+sock.close()
+sys.exit(status)
@@ -451,6 +451,25 @@
       (* epsilon (max (abs a) (abs b)))))
 
 
+; pixel comparison utility
+
+; Do drawables a and b have the same size and the same pixels,
+; when both are read in the Babl format, e.g. "R'G'B'A u8"?
+; Compares a band of rows at a time, to keep the vectors small.
+; Uses v3 binding: no car
+(define (testing:drawables-equal-v3? a b format)
+  (let ((width  (gimp-drawable-get-width a))
+        (height (gimp-drawable-get-height a)))
+    (and (= width  (gimp-drawable-get-width b))
+         (= height (gimp-drawable-get-height b))
+         (let loop ((y 0))
+           (or (>= y height)
+               (let ((rows (min 16 (- height y))))
+                 (and (equal? (gimp-drawable-get-pixels a 0 y width rows format)
+                              (gimp-drawable-get-pixels b 0 y width rows format))
+                      (loop (+ y rows)))))))))
+
+
 ; graphical result utility
 
 ; When testing is in the GUI environment and not in batch mode,
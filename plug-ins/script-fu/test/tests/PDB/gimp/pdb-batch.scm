@@ -0,0 +1,110 @@
+; Test script-fu-pdb-batch, which runs PDB calls in one round trip
+
+; A deferred call yields its index in the batch.
+; The batch yields the results of its calls, in order.
+
+
+(script-fu-use-v3)
+
+; setup
+(define testImage (gimp-image-new 21 22 RGB))
+
+
+
+(test! "results of a batch")
+
+; an empty batch yields an empty list
+(assert `(null? (script-fu-pdb-batch (lambda () #t))))
+
+; the results are as the calls would return them, in order
+(assert `(equal? (script-fu-pdb-batch
+                   (lambda ()
+                     (gimp-image-get-width ,testImage)
+                     (gimp-image-get-height ,testImage)))
+                 '(21 22)))
+
+; calls in the batch are deferred: they yield their index
+(define testIndexes '())
+(script-fu-pdb-batch
+  (lambda ()
+    (let* ((first  (gimp-image-get-width testImage))
+           (second (gimp-image-get-height testImage)))
+      (set! testIndexes (list first second)))))
+(assert `(equal? ',testIndexes '(0 1)))
+
+
+
+(test! "references to return values of earlier calls")
+
+; a layer is created, inserted and renamed in one batch
+(define testResults
+  (script-fu-pdb-batch
+    (lambda ()
+      (let ((new (gimp-layer-new testImage 7 8 RGBA-IMAGE "Batched"
+                                 100.0 LAYER-MODE-NORMAL)))
+        (gimp-image-insert-layer testImage (script-fu-pdb-batch-ref new) 0 0)
+        (gimp-item-set-name (script-fu-pdb-batch-ref new 1) "Renamed")))))
+(define testLayer (car testResults))
+
+(assert `(= (length ',testResults) 3))
+(assert `(gimp-item-id-is-layer ,testLayer))
+(assert `(= (vector-length (gimp-image-get-layers ,testImage))
+            1))
+(assert `(string=? (gimp-item-get-name ,testLayer)
+                   "Renamed"))
+
+; a reference must be to an earlier call of the batch
+(assert-error `(script-fu-pdb-batch
+                 (lambda ()
+                   (gimp-item-set-name (script-fu-pdb-batch-ref 0) "Later")))
+              "Argument 1 for gimp-item-set-name refers to return value 1")
+
+; a reference is only valid in a batch
+(assert-error `(gimp-item-set-name (script-fu-pdb-batch-ref 0) "Outside")
+              "script-fu-pdb-batch-ref used outside script-fu-pdb-batch")
+
+
+
+(test! "a failing call")
+
+; the calls before the failing one take effect, the calls after it don't
+(assert-error `(script-fu-pdb-batch
+                 (lambda ()
+                   (gimp-item-set-name ,testLayer "First")
+                   (gimp-image-insert-layer ,testImage ,testLayer 0 0)
+                   (gimp-item-set-name ,testLayer "Third")))
+              "in script-fu-pdb-batch, the call of gimp-image-insert-layer at index 1 failed")
+(assert `(string=? (gimp-item-get-name ,testLayer)
+                   "First"))
+
+
+
+(test! "an error in the thunk")
+
+; no call of the batch runs
+(assert-error `(script-fu-pdb-batch
+                 (lambda ()
+                   (gimp-item-set-name ,testLayer "Dropped")
+                   (car '())))
+              "car: argument 1 must be")
+(assert `(string=? (gimp-item-get-name ,testLayer)
+                   "First"))
+
+; calls are made normally again afterwards
+(assert `(gimp-item-set-name ,testLayer "Unbatched"))
+(assert `(string=? (gimp-item-get-name ,testLayer)
+                   "Unbatched"))
+
+; and batches can be made again
+(assert `(equal? (script-fu-pdb-batch
+                   (lambda ()
+                     (gimp-image-get-width ,testImage)))
+                 '(21)))
+
+
+
+; teardown
+(gimp-image-delete testImage)
+
+; Restore dialect binding state so SF Console remains binding v2
+(script-fu-use-v2)
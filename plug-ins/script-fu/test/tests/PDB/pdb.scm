@@ -86,6 +86,8 @@
 (testing:load-test "refresh.scm")
 ; test methods on PDBProcedure
 (testing:load-test "procedures.scm")
+; test batched calls to the PDB
+(testing:load-test "pdb-batch.scm")
 
 ; Only run when not headless
 ; (testing:load-test "display.scm")
@@ -103,4 +103,34 @@
 ; Sometimes???  '(71 71 71 0)))
 
 
+
+(test! "get-pixels and set-pixels of a region")
+
+; pixels are returned as a vector of bytes, row by row
+(assert `(= (vector-length (gimp-drawable-get-pixels ,testDrawable 0 0 4 2 "R'G'B'A u8"))
+            (* 4 2 4)))
+
+; set a 2x1 region, then get it back
+(assert `(gimp-drawable-set-pixels ,testDrawable 0 0 2 1 "R'G'B'A u8"
+                                   #(1 2 3 255 4 5 6 255)))
+(assert `(equal? (gimp-drawable-get-pixels ,testDrawable 0 0 2 1 "R'G'B'A u8")
+                 #(1 2 3 255 4 5 6 255)))
+
+; an empty format is the drawable's format, GRAYA u8 has two bytes per pixel
+(assert `(= (vector-length (gimp-drawable-get-pixels ,testDrawableGray 0 0 3 3 ""))
+            (* 3 3 2)))
+
+; the size of the pixels must match the region
+(assert-error `(gimp-drawable-set-pixels ,testDrawable 0 0 2 1 "R'G'B'A u8" #(1 2 3))
+              "Procedure execution of gimp-drawable-set-pixels failed")
+
+; the region must be inside the drawable
+(assert-error `(gimp-drawable-get-pixels ,testDrawable 0 0 100000 1 "R'G'B'A u8")
+              "Procedure execution of gimp-drawable-get-pixels failed")
+
+; the format must be a Babl format
+(assert-error `(gimp-drawable-get-pixels ,testDrawable 0 0 1 1 "not a format")
+              "Procedure execution of gimp-drawable-get-pixels failed")
+
+
 (script-fu-use-v2)
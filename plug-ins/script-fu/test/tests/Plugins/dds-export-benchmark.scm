@@ -0,0 +1,108 @@
+; Benchmark the DDS exporter
+
+; This is not a test: it asserts nothing, and no other test loads it.
+; Load it in the SF Console:
+;    (testing:load-test "dds-export-benchmark.scm")
+; Exports the same image, with generated mipmaps,
+; in each block compression format and at each quality,
+; and displays the time each export took and its throughput.
+; For the formats the DDS loader can decode, also displays the PSNR
+; of the reloaded top level against the image.
+
+; The image is a large photo-like RGB image, the size of a game texture:
+; plasma has about as much detail as a photograph.
+
+
+(script-fu-use-v3)
+
+(define (dds-export-benchmark:now)
+  (cdr (assq 'run-time (gc-stats))))
+
+(define (dds-export-benchmark:image width height)
+  (let* ((image (gimp-image-new width height RGB))
+         (layer (gimp-layer-new image width height RGB-IMAGE
+                                "Plasma" 100.0 LAYER-MODE-NORMAL)))
+    (gimp-image-insert-layer image layer 0 0)
+    (plug-in-plasma RUN-NONINTERACTIVE image layer 1 1.0)
+    image))
+
+; mean squared error of one channel of a difference layer:
+; the mean of the squares is the squared mean plus the variance
+(define (dds-export-benchmark:mse layer channel)
+  (let* ((stats   (gimp-drawable-histogram layer channel 0.0 1.0))
+         (mean    (car stats))
+         (std-dev (cadr stats)))
+    (+ (* mean mean) (* std-dev std-dev))))
+
+(define (dds-export-benchmark:psnr image file)
+  (let* ((reloaded (file-dds-load RUN-NONINTERACTIVE file #f #f))
+         (layer    (gimp-layer-new-from-drawable
+                     (vector-ref (gimp-image-get-layers reloaded) 0)
+                     image)))
+    (gimp-image-insert-layer image layer 0 0)
+    ; legacy difference works on the stored 8-bit values
+    (gimp-layer-set-mode layer LAYER-MODE-DIFFERENCE-LEGACY)
+    (let* ((difference (gimp-layer-new-from-visible image image "Difference"))
+           (mse        (/ (+ (dds-export-benchmark:mse difference HISTOGRAM-RED)
+                             (dds-export-benchmark:mse difference HISTOGRAM-GREEN)
+                             (dds-export-benchmark:mse difference HISTOGRAM-BLUE))
+                          3)))
+      (gimp-item-delete difference)
+      (gimp-image-remove-layer image layer)
+      (gimp-image-delete reloaded)
+      (if (> mse 0)
+          (/ (round (* 100 (/ (log (/ (* 255 255) mse)) (log 10)))) 10)
+          "lossless"))))
+
+(define (dds-export-benchmark:run image compression quality reloads)
+  (let* ((file   (gimp-temp-file "dds"))
+         (pixels (* (gimp-image-get-width image)
+                    (gimp-image-get-height image)))
+         (start  (dds-export-benchmark:now)))
+    ; options, then compression-format perceptual-metric format save-type
+    ; flip-image transparent-color transparent-index mipmaps mipmap-filter
+    ; mipmap-wrap gamma-correct srgb gamma preserve-alpha-coverage
+    ; alpha-test-threshold compression-quality
+    (file-dds-export RUN-NONINTERACTIVE image file -1
+                     compression #f "default" "layer"
+                     #f #f 0 "generate" "default"
+                     "default" #f #f 0.0 #f
+                     0.5 quality)
+    (let ((elapsed (max 1 (- (dds-export-benchmark:now) start))))
+      (display compression)
+      (display " ")
+      (display quality)
+      (display ": ")
+      (display (quotient elapsed 1000))
+      (display " ms, ")
+      ; pixels per microsecond are megapixels per second
+      (display (/ (round (/ (* 10.0 pixels) elapsed)) 10))
+      (display " MP/s")
+      (if reloads
+          (begin
+            (display ", PSNR ")
+            (display (dds-export-benchmark:psnr image file))
+            (display " dB")))
+      (newline))))
+
+
+(define dds-export-benchmark:image-4mp
+  (dds-export-benchmark:image 2048 2048))
+
+; the loader does not decode BC6H and BC7,
+; and BC4 and BC5 do not keep all of the color channels
+(for-each
+  (lambda (format)
+    (for-each
+      (lambda (quality)
+        (dds-export-benchmark:run dds-export-benchmark:image-4mp
+                                  (car format) quality (cadr format)))
+      '("fast" "normal" "high")))
+  '(("bc1"  #t)
+    ("bc2"  #t)
+    ("bc4"  #f)
+    ("bc5"  #f)
+    ("bc6h" #f)
+    ("bc7"  #f)))
+
+(gimp-image-delete dds-export-benchmark:image-4mp)
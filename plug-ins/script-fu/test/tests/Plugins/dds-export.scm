@@ -0,0 +1,98 @@
+; Test the DDS exporter by a round trip
+
+; Exports an image, with generated mipmaps, uncompressed
+; and in the BC1 and BC2 block compression formats, at each quality,
+; and loads the file back.
+; Asserts the loaded top level has the pixels of the image
+; when uncompressed, and a PSNR above a floor when compressed.
+
+; The loader does not decode BC6H and BC7:
+; plug-ins/file-dds/test-bptc.c tests their encoders.
+
+
+(script-fu-use-v3)
+
+; plasma has about as much detail as a photograph
+(define (dds-export:image width height)
+  (let* ((image (gimp-image-new width height RGB))
+         (layer (gimp-layer-new image width height RGB-IMAGE
+                                "Plasma" 100.0 LAYER-MODE-NORMAL)))
+    (gimp-image-insert-layer image layer 0 0)
+    (plug-in-plasma RUN-NONINTERACTIVE image layer 1 1.0)
+    image))
+
+; Export image, and return the image loaded back
+(define (dds-export:round-trip image compression quality)
+  (let ((file (gimp-temp-file "dds")))
+    ; options, then compression-format perceptual-metric format save-type
+    ; flip-image transparent-color transparent-index mipmaps mipmap-filter
+    ; mipmap-wrap gamma-correct srgb gamma preserve-alpha-coverage
+    ; alpha-test-threshold compression-quality
+    (file-dds-export RUN-NONINTERACTIVE image file -1
+                     compression #f "default" "layer"
+                     #f #f 0 "generate" "default"
+                     "default" #f #f 0.0 #f
+                     0.5 quality)
+    (file-dds-load RUN-NONINTERACTIVE file #f #f)))
+
+(define (dds-export:lossless? image)
+  (let* ((loaded (dds-export:round-trip image "none" "normal"))
+         (result (testing:drawables-equal-v3?
+                   (vector-ref (gimp-image-get-layers image) 0)
+                   (vector-ref (gimp-image-get-layers loaded) 0)
+                   "R'G'B' u8")))
+    (gimp-image-delete loaded)
+    result))
+
+; mean squared error of one channel of a difference layer:
+; the mean of the squares is the squared mean plus the variance
+(define (dds-export:mse layer channel)
+  (let* ((stats   (gimp-drawable-histogram layer channel 0.0 1.0))
+         (mean    (car stats))
+         (std-dev (cadr stats)))
+    (+ (* mean mean) (* std-dev std-dev))))
+
+; PSNR in dB of the loaded top level against the image,
+; over the color channels
+(define (dds-export:psnr image compression quality)
+  (let* ((loaded (dds-export:round-trip image compression quality))
+         (layer  (gimp-layer-new-from-drawable
+                   (vector-ref (gimp-image-get-layers loaded) 0)
+                   image)))
+    (gimp-image-insert-layer image layer 0 0)
+    ; legacy difference works on the stored 8-bit values
+    (gimp-layer-set-mode layer LAYER-MODE-DIFFERENCE-LEGACY)
+    (let* ((difference (gimp-layer-new-from-visible image image "Difference"))
+           (mse        (/ (+ (dds-export:mse difference HISTOGRAM-RED)
+                             (dds-export:mse difference HISTOGRAM-GREEN)
+                             (dds-export:mse difference HISTOGRAM-BLUE))
+                          3)))
+      (gimp-item-delete difference)
+      (gimp-image-remove-layer image layer)
+      (gimp-image-delete loaded)
+      (if (> mse 0)
+          (* 10 (/ (log (/ (* 255 255) mse)) (log 10)))
+          100))))
+
+
+; several blocks wide and high, and not a power of two
+(define testImage (dds-export:image 200 120))
+
+(test! "DDS export round trip, uncompressed")
+(assert `(dds-export:lossless? ,testImage))
+
+; the error of block compression stays well above
+; what an encoding or decoding bug would leave
+(for-each
+  (lambda (compression)
+    (test! (string-append "DDS export round trip, " compression))
+    (for-each
+      (lambda (quality)
+        (assert `(> (dds-export:psnr ,testImage ,compression ,quality) 25)))
+      '("fast" "normal" "high")))
+  '("bc1" "bc2"))
+
+(gimp-image-delete testImage)
+
+; Restore dialect binding state so SF Console remains binding v2
+(script-fu-use-v2)
@@ -0,0 +1,58 @@
+; Benchmark the PNG exporter
+
+; This is not a test: it asserts nothing, and no other test loads it.
+; Load it in the SF Console:
+;    (testing:load-test "png-export-benchmark.scm")
+; Exports the same image at each compression level,
+; compressing with libpng on one thread, then in parallel,
+; and displays the time each export took and its throughput.
+
+; The image is a large photo-like RGB image:
+; plasma has about as much detail as a photograph.
+
+
+(script-fu-use-v3)
+
+(define (png-export-benchmark:now)
+  (cdr (assq 'run-time (gc-stats))))
+
+(define (png-export-benchmark:image width height)
+  (let* ((image (gimp-image-new width height RGB))
+         (layer (gimp-layer-new image width height RGB-IMAGE
+                                "Plasma" 100.0 LAYER-MODE-NORMAL)))
+    (gimp-image-insert-layer image layer 0 0)
+    (plug-in-plasma RUN-NONINTERACTIVE image layer 1 1.0)
+    image))
+
+(define (png-export-benchmark:run image compression parallel)
+  (let* ((file   (gimp-temp-file "png"))
+         (pixels (* (gimp-image-get-width image)
+                    (gimp-image-get-height image)))
+         (start  (png-export-benchmark:now)))
+    ; options, then interlaced compression bkgd offs phys time
+    ; save-transparent optimize-palette format parallel-compression
+    (file-png-export RUN-NONINTERACTIVE image file -1
+                     #f compression #t #f #t #t
+                     #f #f "auto" parallel)
+    (let ((elapsed (max 1 (- (png-export-benchmark:now) start))))
+      (display compression)
+      (display (if parallel " parallel: " " libpng: "))
+      (display (quotient elapsed 1000))
+      (display " ms, ")
+      ; pixels per microsecond are megapixels per second
+      (display (/ (round (/ (* 10.0 pixels) elapsed)) 10))
+      (display " MP/s")
+      (newline))))
+
+
+(define png-export-benchmark:image-12mp
+  (png-export-benchmark:image 4000 3000))
+
+(let loop ((compression 0))
+  (if (<= compression 9)
+      (begin
+        (png-export-benchmark:run png-export-benchmark:image-12mp compression #f)
+        (png-export-benchmark:run png-export-benchmark:image-12mp compression #t)
+        (loop (+ compression 1)))))
+
+(gimp-image-delete png-export-benchmark:image-12mp)
@@ -0,0 +1,61 @@
+; Test the PNG exporter by a round trip
+
+; Exports an image at several compression levels,
+; compressing with libpng on one thread, then in parallel,
+; loads the file back,
+; and asserts the loaded layer has the pixels of the image.
+
+; The images are large enough that parallel compression
+; splits their pixels in several blocks.
+
+
+(script-fu-use-v3)
+
+(define (png-export:image width height precision type)
+  (let* ((image (gimp-image-new-with-precision width height RGB precision))
+         (layer (gimp-layer-new image width height type
+                                "Plasma" 100.0 LAYER-MODE-NORMAL)))
+    (gimp-image-insert-layer image layer 0 0)
+    (plug-in-plasma RUN-NONINTERACTIVE image layer 1 1.0)
+    image))
+
+; Export image, load it back,
+; and return whether its layer round tripped, read in format
+(define (png-export:round-trip? image compression parallel format)
+  (let ((file (gimp-temp-file "png")))
+    ; options, then interlaced compression bkgd offs phys time
+    ; save-transparent optimize-palette format parallel-compression
+    (file-png-export RUN-NONINTERACTIVE image file -1
+                     #f compression #t #f #t #t
+                     #t #f "auto" parallel)
+    (let* ((loaded (gimp-file-load RUN-NONINTERACTIVE file))
+           (result (testing:drawables-equal-v3?
+                     (vector-ref (gimp-image-get-layers image) 0)
+                     (vector-ref (gimp-image-get-layers loaded) 0)
+                     format)))
+      (gimp-image-delete loaded)
+      result)))
+
+
+(define testImage
+  (png-export:image 640 480 PRECISION-U8-NON-LINEAR RGB-IMAGE))
+
+(test! "PNG export round trip, 8-bit RGB")
+(assert `(png-export:round-trip? ,testImage 1 #f "R'G'B' u8"))
+(assert `(png-export:round-trip? ,testImage 1 #t "R'G'B' u8"))
+(assert `(png-export:round-trip? ,testImage 9 #f "R'G'B' u8"))
+(assert `(png-export:round-trip? ,testImage 9 #t "R'G'B' u8"))
+
+(gimp-image-delete testImage)
+
+(define testImage16
+  (png-export:image 640 480 PRECISION-U16-NON-LINEAR RGBA-IMAGE))
+
+(test! "PNG export round trip, 16-bit RGBA")
+(assert `(png-export:round-trip? ,testImage16 6 #f "R'G'B'A u16"))
+(assert `(png-export:round-trip? ,testImage16 6 #t "R'G'B'A u16"))
+
+(gimp-image-delete testImage16)
+
+; Restore dialect binding state so SF Console remains binding v2
+(script-fu-use-v2)
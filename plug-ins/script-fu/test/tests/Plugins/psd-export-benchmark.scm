@@ -0,0 +1,53 @@
+; Benchmark the PSD exporter
+
+; This is not a test: it asserts nothing, and no other test loads it.
+; Load it in the SF Console:
+;    (testing:load-test "psd-export-benchmark.scm")
+; Exports the same layered image with each compression,
+; and displays the time each export took.
+
+; The image is like those handed off to Photoshop users:
+; high bit depth, large, several layers with masks.
+
+
+(script-fu-use-v3)
+
+(define (psd-export-benchmark:now)
+  (cdr (assq 'run-time (gc-stats))))
+
+; A 16-bit image of plasma layers with masks
+(define (psd-export-benchmark:image width height n-layers)
+  (let ((image (gimp-image-new-with-precision width height
+                                              RGB PRECISION-U16-NON-LINEAR)))
+    (let loop ((i 0))
+      (if (< i n-layers)
+          (let ((layer (gimp-layer-new image width height RGBA-IMAGE
+                                       "Plasma" 100.0 LAYER-MODE-NORMAL)))
+            (gimp-image-insert-layer image layer 0 0)
+            (plug-in-plasma RUN-NONINTERACTIVE image layer i 1.0)
+            (gimp-layer-add-mask layer
+                                 (gimp-layer-create-mask layer ADD-MASK-COPY))
+            (loop (+ i 1)))))
+    image))
+
+(define (psd-export-benchmark:run image compression)
+  (let ((file  (gimp-temp-file "psd"))
+        (start (psd-export-benchmark:now)))
+    ; options, then clippingpath clippingpathname clippingpathflatness cmyk duotone
+    (file-psd-export RUN-NONINTERACTIVE image file -1
+                     #f "" 0.2 #f #f
+                     compression)
+    (display compression)
+    (display ": ")
+    (display (quotient (- (psd-export-benchmark:now) start) 1000))
+    (display " ms")
+    (newline)))
+
+
+(define psd-export-benchmark:image-4-layers
+  (psd-export-benchmark:image 4000 3000 4))
+
+(psd-export-benchmark:run psd-export-benchmark:image-4-layers "rle")
+(psd-export-benchmark:run psd-export-benchmark:image-4-layers "zip")
+
+(gimp-image-delete psd-export-benchmark:image-4-layers)
@@ -0,0 +1,66 @@
+; Test the PSD exporter by a round trip
+
+; Exports a layered image with each compression, loads the file back,
+; and asserts the loaded layers and masks have the pixels of the image.
+
+; The image is like those handed off to Photoshop users:
+; high bit depth, several layers with masks.
+; Its layers are large enough that each channel is compressed
+; in several pieces.
+
+
+(script-fu-use-v3)
+
+; A 16-bit image of plasma layers with masks
+(define (psd-export:image width height n-layers)
+  (let ((image (gimp-image-new-with-precision width height
+                                              RGB PRECISION-U16-NON-LINEAR)))
+    (let loop ((i 0))
+      (if (< i n-layers)
+          (let ((layer (gimp-layer-new image width height RGBA-IMAGE
+                                       "Plasma" 100.0 LAYER-MODE-NORMAL)))
+            (gimp-image-insert-layer image layer 0 0)
+            (plug-in-plasma RUN-NONINTERACTIVE image layer i 1.0)
+            (gimp-layer-add-mask layer
+                                 (gimp-layer-create-mask layer ADD-MASK-COPY))
+            (loop (+ i 1)))))
+    image))
+
+; Export image, load it back,
+; and return whether each layer and its mask round tripped
+(define (psd-export:round-trip? image compression)
+  (let ((file (gimp-temp-file "psd")))
+    ; options, then clippingpath clippingpathname clippingpathflatness cmyk duotone
+    (file-psd-export RUN-NONINTERACTIVE image file -1
+                     #f "" 0.2 #f #f
+                     compression)
+    (let* ((loaded   (gimp-file-load RUN-NONINTERACTIVE file))
+           (layers   (vector->list (gimp-image-get-layers image)))
+           (reloaded (vector->list (gimp-image-get-layers loaded)))
+           (result   (and (= (length layers) (length reloaded))
+                          (let loop ((layers layers) (reloaded reloaded))
+                            (or (null? layers)
+                                (and (testing:drawables-equal-v3?
+                                       (car layers) (car reloaded)
+                                       "R'G'B'A u16")
+                                     (testing:drawables-equal-v3?
+                                       (gimp-layer-get-mask (car layers))
+                                       (gimp-layer-get-mask (car reloaded))
+                                       "Y u16")
+                                     (loop (cdr layers) (cdr reloaded))))))))
+      (gimp-image-delete loaded)
+      result)))
+
+
+(define testImage (psd-export:image 640 480 3))
+
+(test! "PSD export round trip, RLE compression")
+(assert `(psd-export:round-trip? ,testImage "rle"))
+
+(test! "PSD export round trip, ZIP compression")
+(assert `(psd-export:round-trip? ,testImage "zip"))
+
+(gimp-image-delete testImage)
+
+; Restore dialect binding state so SF Console remains binding v2
+(script-fu-use-v2)
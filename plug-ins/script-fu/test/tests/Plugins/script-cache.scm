@@ -0,0 +1,60 @@
+; Test that scripts are loaded where they are called directly
+
+; extension-script-fu caches the registrations of the scripts in /scripts,
+; and loads an unchanged script only when one of its procedures first runs.
+; The console, eval and server do not register scripts:
+; they call the run functions of scripts directly,
+; so they must load every script, cache or not.
+
+; This works the same on the first startup and on later ones.
+; To test the cache, run this after GIMP restarted at least once.
+
+
+(script-fu-use-v3)
+
+
+(test! "run functions of scripts are defined in the console")
+
+; When testing from the SF Console, this is the console's interpreter.
+(assert '(procedure? script-fu-unsharp-mask))
+(assert '(procedure? script-fu-add-bevel))
+(assert '(procedure? script-fu-addborder))
+
+
+(test! "run functions of scripts are defined in eval")
+
+; plug-in-script-fu-eval is another process, with its own interpreter.
+; An unbound run function is an error, which fails the PDB call.
+(assert '(plug-in-script-fu-eval
+           RUN-NONINTERACTIVE
+           "(if (not (procedure? script-fu-unsharp-mask)) (error \"unbound\"))"))
+
+; Call a script through eval, as batch users do.
+(define testImage (testing:load-test-image-basic-v3))
+(define testImagesBefore (vector->list (gimp-get-images)))
+
+(assert `(plug-in-script-fu-eval
+           RUN-NONINTERACTIVE
+           (string-append
+             "(script-fu-use-v2)"
+             "(script-fu-unsharp-mask "
+             ,(number->string testImage)
+             " (vector "
+             ,(number->string (vector-ref (gimp-image-get-layers testImage) 0))
+             ") 8 50)")))
+
+; unsharp-mask renders into a new image
+(define testImagesNew
+  (let loop ((images (vector->list (gimp-get-images))) (new '()))
+    (cond ((null? images) new)
+          ((memv (car images) testImagesBefore) (loop (cdr images) new))
+          (else (loop (cdr images) (cons (car images) new))))))
+
+(assert `(= (length ',testImagesNew) 1))
+
+(for-each gimp-image-delete testImagesNew)
+(gimp-image-delete testImage)
+
+
+; Restore dialect binding state so SF Console remains binding v2
+(script-fu-use-v2)
@@ -0,0 +1,110 @@
+; Benchmark the garbage collector of TinyScheme
+
+; This is not a test: it asserts nothing, and tinyscheme.scm does not load it.
+; Load it in the SF Console:
+;    (testing:load-test "gc-benchmark.scm")
+; For each workload, displays the time it took,
+; the share of that time spent in gc, and the count of collections,
+; as reported by (gc-stats).
+
+; The workloads are like those of batch scripts:
+; collecting pixel values in a list, walking a tree of layers,
+; filling a pixel array, and building many short-lived strings.
+
+
+(define (gc-benchmark:stat stats key)
+  (cdr (assq key stats)))
+
+(define (gc-benchmark:run name thunk)
+  (gc)
+  (let* ((before      (gc-stats))
+         (result      (thunk))
+         (after       (gc-stats))
+         (run-time    (- (gc-benchmark:stat after  'run-time)
+                         (gc-benchmark:stat before 'run-time)))
+         (gc-time     (- (gc-benchmark:stat after  'gc-time)
+                         (gc-benchmark:stat before 'gc-time)))
+         (collections (- (gc-benchmark:stat after  'collections)
+                         (gc-benchmark:stat before 'collections))))
+    (display name)
+    (display ": ")
+    (display (quotient run-time 1000))
+    (display " ms, ")
+    (display (quotient (* 100 gc-time) (max run-time 1)))
+    (display "% in gc, ")
+    (display collections)
+    (display " collections, heap of ")
+    (display (gc-benchmark:stat after 'heap-cells))
+    (display " cells")
+    (newline)
+    result))
+
+
+; A list of (r g b) as from a loop over gimp-drawable-get-pixel
+(define (gc-benchmark:pixels n)
+  (let loop ((i 0)
+             (pixels '()))
+    (if (= i n)
+        pixels
+        (loop (+ i 1)
+              (cons (list (modulo i 256)
+                          (modulo (* i 3) 256)
+                          (modulo (* i 7) 256))
+                    pixels)))))
+
+; A tree of layer groups, depth deep, each group having width children
+(define (gc-benchmark:layer-tree depth width)
+  (if (= depth 0)
+      (list "layer" depth)
+      (let loop ((i 0)
+                 (children '()))
+        (if (= i width)
+            (cons "group" children)
+            (loop (+ i 1)
+                  (cons (gc-benchmark:layer-tree (- depth 1) width)
+                        children))))))
+
+(define (gc-benchmark:count-layers tree)
+  (if (string=? (car tree) "layer")
+      1
+      (apply + (map gc-benchmark:count-layers (cdr tree)))))
+
+
+(gc-benchmark:run "pixel list"
+  (lambda ()
+    (length (gc-benchmark:pixels 20000))))
+
+(define gc-benchmark:kept (gc-benchmark:pixels 20000))
+
+(gc-benchmark:run "map over a live pixel list"
+  (lambda ()
+    (let loop ((k 0))
+      (if (< k 5)
+          (begin
+            (map (lambda (pixel) (apply + pixel)) gc-benchmark:kept)
+            (loop (+ k 1)))))))
+
+(gc-benchmark:run "layer tree"
+  (lambda ()
+    (let ((tree (gc-benchmark:layer-tree 5 6)))
+      (gc-benchmark:count-layers tree))))
+
+(gc-benchmark:run "pixel vector"
+  (lambda ()
+    (let ((pixels (make-vector 100000)))
+      (let loop ((i 0))
+        (if (< i 100000)
+            (begin
+              (vector-set! pixels i (list i i i))
+              (loop (+ i 1)))))
+      (vector-length pixels))))
+
+(gc-benchmark:run "short-lived strings"
+  (lambda ()
+    (let loop ((i 0))
+      (if (< i 50000)
+          (begin
+            (string-append "layer " (number->string i))
+            (loop (+ i 1)))))))
+
+(set! gc-benchmark:kept '())
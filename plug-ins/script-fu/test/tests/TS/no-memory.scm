@@ -33,23 +33,50 @@
 
 ; A vector is contiguous cells.
 ; TS allocates in segments.
-
-
-; A vector can be no larger than two segments?
+; When no free cells are contiguous, TS allocates a segment large enough.
 
 ; succeeds
 (assert '(make-vector 25000))
 ; REPL shows as #(() () ... ()) i.e. a vector of NIL, not initialized
 
-; might not crash?
 (define testVector (make-vector 25001))
 
-; ????
 (assert `(vector-fill! ,testVector 1))
 
-; seems to hang
-; (assert '(make-vector 50001))
+; vectors larger than a segment succeed
+(assert '(make-vector 50001))
+(assert '(make-vector 200000))
+
+
+;                   Heap limits
+
+; The heap grows with the live cells, there is no fixed count of segments.
+; A list of more pixels than the initial heap has cells succeeds.
+(assert '(= (length (let loop ((i 0) (pixels '()))
+                      (if (= i 300000)
+                          pixels
+                          (loop (+ i 1) (cons i pixels)))))
+            300000))
+
+; gc-stats yields an association list
+(assert '(> (cdr (assq 'heap-cells (gc-stats))) 0))
+
+
+; The table of segments grows past its first 16 entries,
+; and a full gc afterwards keeps the cells that are still live.
+(define testLiveList
+  (let loop ((i 0) (pixels '()))
+    (if (= i 100000)
+        pixels
+        (loop (+ i 1) (cons i pixels)))))
 
-; seems to crash
-; (assert '(make-vector 200000))
+(new-segment 20)
+(assert '(> (cdr (assq 'cell-segments (gc-stats))) 16))
 
+(gc)
+(assert '(= (let loop ((pixels testLiveList) (sum 0))
+              (if (null? pixels)
+                  sum
+                  (loop (cdr pixels) (+ sum (car pixels)))))
+            4999950000))
+(assert '(= (length (vector->list (make-vector 100000 1))) 100000))